@@ -106,6 +106,7 @@ static int nsec_datatype = dns_rdatatype_nsec;
 
 #define BUFSIZE 2048
 #define MAXDSKEYS 8
+#define HASHBATCH 16	/* NSEC3 names hashed together */
 
 #define SIGNER_EVENTCLASS	ISC_EVENTCLASS(0x4453)
 #define SIGNER_EVENT_WRITE	(SIGNER_EVENTCLASS + 0)
@@ -698,6 +699,16 @@ struct hashlist {
 	size_t entries;
 	size_t size;
 	size_t length;
+	/*
+	 * Names waiting to be hashed together by hashlist_flush().
+	 */
+	dns_fixedname_t pending[HASHBATCH];
+	isc_boolean_t speculative[HASHBATCH];
+	unsigned int npending;
+	unsigned int hashalg;
+	unsigned int iterations;
+	const unsigned char *salt;
+	size_t salt_length;
 };
 
 static void
@@ -705,6 +716,7 @@ hashlist_init(hashlist_t *l, unsigned int nodes, unsigned int length) {
 
 	l->entries = 0;
 	l->length = length + 1;
+	l->npending = 0;
 
 	if (nodes != 0) {
 		l->size = nodes;
@@ -734,28 +746,72 @@ hashlist_add(hashlist_t *l, const unsigned char *hash, size_t len)
 	l->entries++;
 }
 
+static void
+hashlist_flush(hashlist_t *l) {
+	char nametext[DNS_NAME_FORMATSIZE];
+	unsigned char hashes[HASHBATCH][NSEC3_MAX_HASH_LENGTH + 1];
+	unsigned char *out[HASHBATCH];
+	const unsigned char *in[HASHBATCH];
+	int inlength[HASHBATCH];
+	dns_name_t *name;
+	unsigned int n, len;
+	size_t i;
+
+	if (l->npending == 0U)
+		return;
+
+	for (n = 0; n < l->npending; n++) {
+		name = dns_fixedname_name(&l->pending[n]);
+		out[n] = hashes[n];
+		in[n] = name->ndata;
+		inlength[n] = name->length;
+	}
+	len = isc_iterated_hash_batch(out, l->hashalg, l->iterations,
+				      l->salt, (int)l->salt_length,
+				      in, inlength, l->npending);
+
+	for (n = 0; n < l->npending; n++) {
+		if (verbose) {
+			name = dns_fixedname_name(&l->pending[n]);
+			dns_name_format(name, nametext, sizeof nametext);
+			for (i = 0 ; i < len; i++)
+				fprintf(stderr, "%02x", hashes[n][i]);
+			fprintf(stderr, " %s\n", nametext);
+		}
+		hashes[n][len] = l->speculative[n] ? 1 : 0;
+		hashlist_add(l, hashes[n], len + 1);
+	}
+	l->npending = 0;
+}
+
 static void
 hashlist_add_dns_name(hashlist_t *l, /*const*/ dns_name_t *name,
 		      unsigned int hashalg, unsigned int iterations,
 		      const unsigned char *salt, size_t salt_length,
 		      isc_boolean_t speculative)
 {
-	char nametext[DNS_NAME_FORMATSIZE];
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH + 1];
-	unsigned int len;
-	size_t i;
+	dns_fixedname_t *fixed;
 
-	len = isc_iterated_hash(hash, hashalg, iterations,
-				salt, (int)salt_length,
-				name->ndata, name->length);
-	if (verbose) {
-		dns_name_format(name, nametext, sizeof nametext);
-		for (i = 0 ; i < len; i++)
-			fprintf(stderr, "%02x", hash[i]);
-		fprintf(stderr, " %s\n", nametext);
-	}
-	hash[len++] = speculative ? 1 : 0;
-	hashlist_add(l, hash, len);
+	/*
+	 * Names are queued and hashed HASHBATCH at a time, which is
+	 * much faster than hashing them one by one.
+	 */
+	if (l->npending != 0U &&
+	    (hashalg != l->hashalg || iterations != l->iterations ||
+	     salt != l->salt || salt_length != l->salt_length))
+		hashlist_flush(l);
+
+	l->hashalg = hashalg;
+	l->iterations = iterations;
+	l->salt = salt;
+	l->salt_length = salt_length;
+
+	fixed = &l->pending[l->npending];
+	dns_fixedname_init(fixed);
+	dns_name_copy(name, dns_fixedname_name(fixed), NULL);
+	l->speculative[l->npending++] = speculative;
+	if (l->npending == HASHBATCH)
+		hashlist_flush(l);
 }
 
 static int
@@ -765,6 +821,7 @@ hashlist_comp(const void *a, const void *b) {
 
 static void
 hashlist_sort(hashlist_t *l) {
+	hashlist_flush(l);
 	qsort(l->hashbuf, l->entries, l->length, hashlist_comp);
 }
 
@@ -1873,60 +1930,107 @@ addnsec3param(const unsigned char *salt, size_t salt_length,
 	dns_db_detachnode(gdb, &node);
 }
 
+/*%
+ * Names whose NSEC3 records are waiting for addnsec3flush() to hash them.
+ */
+typedef struct nsec3batch {
+	dns_fixedname_t names[HASHBATCH];
+	dns_dbnode_t *nodes[HASHBATCH];
+	unsigned int count;
+} nsec3batch_t;
+
 static void
-addnsec3(dns_name_t *name, dns_dbnode_t *node,
-	 const unsigned char *salt, size_t salt_length,
-	 unsigned int iterations, hashlist_t *hashlist,
-	 dns_ttl_t ttl)
+addnsec3flush(nsec3batch_t *batch, const unsigned char *salt,
+	      size_t salt_length, unsigned int iterations,
+	      hashlist_t *hashlist, dns_ttl_t ttl)
 {
-	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char hashes[HASHBATCH][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *hash[HASHBATCH];
+	dns_name_t *names[HASHBATCH];
 	const unsigned char *nexthash;
 	unsigned char nsec3buffer[DNS_NSEC3_BUFFERSIZE];
-	dns_fixedname_t hashname;
+	dns_fixedname_t hashname[HASHBATCH];
 	dns_rdatalist_t rdatalist;
 	dns_rdataset_t rdataset;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
 	isc_result_t result;
 	dns_dbnode_t *nsec3node = NULL;
-	char namebuf[DNS_NAME_FORMATSIZE];
 	size_t hash_length;
+	unsigned int i;
 
-	dns_name_format(name, namebuf, sizeof(namebuf));
+	if (batch->count == 0U)
+		return;
 
-	dns_fixedname_init(&hashname);
-	dns_rdataset_init(&rdataset);
+	for (i = 0; i < batch->count; i++) {
+		names[i] = dns_fixedname_name(&batch->names[i]);
+		hash[i] = hashes[i];
+	}
+	result = dns_nsec3_hashnames(hashname, hash, &hash_length,
+				     names, batch->count, gorigin,
+				     dns_hash_sha1, iterations,
+				     salt, salt_length);
+	check_result(result, "addnsec3: dns_nsec3_hashnames()");
+
+	for (i = 0; i < batch->count; i++) {
+		dns_rdataset_init(&rdataset);
+		dns_rdata_reset(&rdata);
+		nexthash = hashlist_findnext(hashlist, hash[i]);
+		result = dns_nsec3_buildrdata(gdb, gversion, batch->nodes[i],
+					      unknownalg ?
+						  DNS_NSEC3_UNKNOWNALG :
+						  dns_hash_sha1,
+					      nsec3flags, iterations,
+					      salt, salt_length,
+					      nexthash, ISC_SHA1_DIGESTLENGTH,
+					      nsec3buffer, &rdata);
+		check_result(result, "addnsec3: dns_nsec3_buildrdata()");
+		rdatalist.rdclass = rdata.rdclass;
+		rdatalist.type = rdata.type;
+		rdatalist.covers = 0;
+		rdatalist.ttl = ttl;
+		ISC_LIST_INIT(rdatalist.rdata);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		check_result(result, "dns_rdatalist_tordataset()");
+		result = dns_db_findnsec3node(gdb,
+					      dns_fixedname_name(&hashname[i]),
+					      ISC_TRUE, &nsec3node);
+		check_result(result, "addnsec3: dns_db_findnode()");
+		result = dns_db_addrdataset(gdb, nsec3node, gversion, 0,
+					    &rdataset, 0, NULL);
+		if (result == DNS_R_UNCHANGED)
+			result = ISC_R_SUCCESS;
+		check_result(result, "addnsec3: dns_db_addrdataset()");
+		dns_db_detachnode(gdb, &nsec3node);
+		if (batch->nodes[i] != NULL)
+			dns_db_detachnode(gdb, &batch->nodes[i]);
+	}
+	batch->count = 0;
+}
+
+/*%
+ * Queue the NSEC3 record for 'name' on 'batch'; the owner names of
+ * HASHBATCH records are hashed together before they are added.
+ */
+static void
+addnsec3(nsec3batch_t *batch, dns_name_t *name, dns_dbnode_t *node,
+	 const unsigned char *salt, size_t salt_length,
+	 unsigned int iterations, hashlist_t *hashlist,
+	 dns_ttl_t ttl)
+{
+	dns_fixedname_t *fixed;
 
 	dns_name_downcase(name, name, NULL);
-	result = dns_nsec3_hashname(&hashname, hash, &hash_length,
-				    name, gorigin, dns_hash_sha1, iterations,
-				    salt, salt_length);
-	check_result(result, "addnsec3: dns_nsec3_hashname()");
-	nexthash = hashlist_findnext(hashlist, hash);
-	result = dns_nsec3_buildrdata(gdb, gversion, node,
-				      unknownalg ?
-					  DNS_NSEC3_UNKNOWNALG : dns_hash_sha1,
-				      nsec3flags, iterations,
-				      salt, salt_length,
-				      nexthash, ISC_SHA1_DIGESTLENGTH,
-				      nsec3buffer, &rdata);
-	check_result(result, "addnsec3: dns_nsec3_buildrdata()");
-	rdatalist.rdclass = rdata.rdclass;
-	rdatalist.type = rdata.type;
-	rdatalist.covers = 0;
-	rdatalist.ttl = ttl;
-	ISC_LIST_INIT(rdatalist.rdata);
-	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
-	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
-	check_result(result, "dns_rdatalist_tordataset()");
-	result = dns_db_findnsec3node(gdb, dns_fixedname_name(&hashname),
-				      ISC_TRUE, &nsec3node);
-	check_result(result, "addnsec3: dns_db_findnode()");
-	result = dns_db_addrdataset(gdb, nsec3node, gversion, 0, &rdataset,
-				    0, NULL);
-	if (result == DNS_R_UNCHANGED)
-		result = ISC_R_SUCCESS;
-	check_result(result, "addnsec3: dns_db_addrdataset()");
-	dns_db_detachnode(gdb, &nsec3node);
+
+	fixed = &batch->names[batch->count];
+	dns_fixedname_init(fixed);
+	dns_name_copy(name, dns_fixedname_name(fixed), NULL);
+	batch->nodes[batch->count] = NULL;
+	if (node != NULL)
+		dns_db_attachnode(gdb, node, &batch->nodes[batch->count]);
+	if (++batch->count == HASHBATCH)
+		addnsec3flush(batch, salt, salt_length, iterations,
+			      hashlist, ttl);
 }
 
 /*%
@@ -2147,7 +2251,9 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 	isc_result_t result;
 	isc_uint32_t nsttl = 0;
 	unsigned int count, nlabels;
+	nsec3batch_t batch;
 
+	batch.count = 0;
 	dns_rdataset_init(&rdataset);
 	dns_fixedname_init(&fname);
 	name = dns_fixedname_name(&fname);
@@ -2360,7 +2466,7 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 		 * We need to pause here to release the lock on the database.
 		 */
 		dns_dbiterator_pause(dbiter);
-		addnsec3(name, node, salt, salt_length, iterations,
+		addnsec3(&batch, name, node, salt, salt_length, iterations,
 			 hashlist, zone_soa_min_ttl);
 		dns_db_detachnode(gdb, &node);
 		/*
@@ -2371,11 +2477,13 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 		while (count > nlabels + 1) {
 			count--;
 			dns_name_split(nextname, count, NULL, nextname);
-			addnsec3(nextname, NULL, salt, salt_length,
+			addnsec3(&batch, nextname, NULL, salt, salt_length,
 				 iterations, hashlist, zone_soa_min_ttl);
 		}
 	}
 	dns_dbiterator_destroy(&dbiter);
+	addnsec3flush(&batch, salt, salt_length, iterations, hashlist,
+		      zone_soa_min_ttl);
 }
 
 /*%
@@ -3420,6 +3528,8 @@ main(int argc, char *argv[]) {
 			inputformat = dns_masterformat_text;
 		else if (strcasecmp(inputformatstr, "raw") == 0)
 			inputformat = dns_masterformat_raw;
+		else if (strcasecmp(inputformatstr, "map") == 0)
+			inputformat = dns_masterformat_map;
 		else if (strncasecmp(inputformatstr, "raw=", 4) == 0) {
 			inputformat = dns_masterformat_raw;
 			fprintf(stderr,
@@ -3437,6 +3547,8 @@ main(int argc, char *argv[]) {
 			masterstyle = &dns_master_style_full;
 		} else if (strcasecmp(outputformatstr, "raw") == 0) {
 			outputformat = dns_masterformat_raw;
+		} else if (strcasecmp(outputformatstr, "map") == 0) {
+			outputformat = dns_masterformat_map;
 		} else if (strncasecmp(outputformatstr, "raw=", 4) == 0) {
 			char *end;
 			outputformat = dns_masterformat_raw;
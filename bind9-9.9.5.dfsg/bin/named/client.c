@@ -866,12 +866,7 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 
 void
 ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
-	isc_result_t result;
-	unsigned char *data;
-	isc_buffer_t buffer;
-	isc_region_t r;
 	isc_region_t *mr;
-	unsigned char sendbuf[SEND_BUFFER_SIZE];
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -879,10 +874,26 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 
 	mr = dns_message_getrawmessage(message);
 	if (mr == NULL) {
-		result = ISC_R_UNEXPECTEDEND;
-		goto done;
+		ns_client_next(client, ISC_R_UNEXPECTEDEND);
+		return;
 	}
 
+	ns_client_sendwire(client, mr);
+}
+
+void
+ns_client_sendwire(ns_client_t *client, isc_region_t *mr) {
+	isc_result_t result;
+	unsigned char *data;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	unsigned char sendbuf[SEND_BUFFER_SIZE];
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(mr != NULL && mr->length >= DNS_MESSAGE_HEADERLEN);
+
+	CTRACE("sendwire");
+
 	result = client_allocsendbuf(client, &buffer, NULL, mr->length,
 				     sendbuf, &data);
 	if (result != ISC_R_SUCCESS)
@@ -1038,6 +1049,15 @@ ns_client_send(ns_client_t *client) {
 		cleanup_cctx = ISC_FALSE;
 	}
 
+	/*
+	 * Offer complete answers to the view's response cache.
+	 */
+	if (client->view != NULL && client->view->respcache != NULL &&
+	    (client->message->flags & DNS_MESSAGEFLAG_TC) == 0) {
+		isc_buffer_usedregion(&buffer, &r);
+		ns_query_saveresponse(client, &r);
+	}
+
 	if (TCP_CLIENT(client)) {
 		isc_buffer_usedregion(&buffer, &r);
 		isc_buffer_putuint16(&tcpbuffer, (isc_uint16_t) r.length);
@@ -81,6 +81,7 @@ options {\n\
 	bindkeys-file \"" NS_SYSCONFDIR "/bind.keys\";\n\
 	port 53;\n\
 	recursing-file \"named.recursing\";\n\
+	reuseport no;\n\
 	secroots-file \"named.secroots\";\n\
 "
 #ifdef PATH_RANDOMDEV
@@ -144,6 +145,11 @@ options {\n\
 	lame-ttl 600;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
 	max-cache-ttl 604800; /* 1 week */\n\
+	max-stale-ttl 604800; /* 1 week */\n\
+	stale-answer-enable false;\n\
+	stale-answer-ttl 1;\n\
+	prefetch 2 9;\n\
+	synth-from-dnssec yes;\n\
 	transfer-format many-answers;\n\
 	max-cache-size 0;\n\
 	check-names master fail;\n\
@@ -155,6 +161,7 @@ options {\n\
 	acache-enable no;\n\
 	acache-cleaning-interval 60;\n\
 	max-acache-size 16M;\n\
+	response-cache-size 0;\n\
 	dnssec-enable yes;\n\
 	dnssec-validation yes; \n\
 	dnssec-accept-expired no;\n\
@@ -212,6 +219,7 @@ options {\n\
 	check-srv-cname warn;\n\
 	zero-no-soa-ttl yes;\n\
 	update-check-ksk yes;\n\
+	update-group-commit no;\n\
 	serial-update-method increment;\n\
 	dnssec-update-mode maintain;\n\
 	dnssec-dnskey-kskonly no;\n\
@@ -46,6 +46,7 @@
  * \code
  *   ns_client_send()	(sending a non-error response)
  *   ns_client_sendraw() (sending a raw response)
+ *   ns_client_sendwire() (sending an already rendered response)
  *   ns_client_error()	(sending an error response)
  *   ns_client_next()	(sending no response)
  *\endcode
@@ -207,6 +208,14 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *msg);
  * send msg as a response using client->message->id for the id.
  */
 
+void
+ns_client_sendwire(ns_client_t *client, isc_region_t *wire);
+/*%
+ * Finish processing the current client request and send the
+ * rendered message in 'wire' as a response, using client->message->id
+ * for the id.
+ */
+
 void
 ns_client_error(ns_client_t *client, isc_result_t result);
 /*%
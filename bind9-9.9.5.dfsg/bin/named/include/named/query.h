@@ -27,6 +27,7 @@
 #include <isc/netaddr.h>
 
 #include <dns/rdataset.h>
+#include <dns/respcache.h>
 #include <dns/rpz.h>
 #include <dns/types.h>
 
@@ -57,6 +58,7 @@ struct ns_query {
 	isc_boolean_t			isreferral;
 	isc_mutex_t			fetchlock;
 	dns_fetch_t *			fetch;
+	dns_fetch_t *			prefetch;
 	dns_rpz_st_t *			rpz_st;
 	isc_bufferlist_t		namebufs;
 	ISC_LIST(ns_dbversion_t)	activeversions;
@@ -67,6 +69,9 @@ struct ns_query {
 	unsigned int			dns64_aaaaoklen;
 	unsigned int			dns64_options;
 	unsigned int			dns64_ttl;
+	unsigned int			respkeylen;
+	unsigned int			resptag;
+	unsigned char			respkey[DNS_RESPCACHE_MAXKEY];
 };
 
 #define NS_QUERYATTR_RECURSIONOK	0x0001
@@ -89,6 +94,9 @@ struct ns_query {
 #ifdef USE_RRL
 #define NS_QUERYATTR_RRL_CHECKED	0x10000
 #endif /* USE_RRL */
+#define NS_QUERYATTR_RESPCACHE		0x20000	/*%< respkey is valid */
+#define NS_QUERYATTR_NORESPCACHE	0x40000	/*%< used uncacheable data */
+#define NS_QUERYATTR_RESPSAVE		0x80000	/*%< response may be saved */
 
 
 isc_result_t
@@ -103,4 +111,11 @@ ns_query_start(ns_client_t *client);
 void
 ns_query_cancel(ns_client_t *client);
 
+void
+ns_query_saveresponse(ns_client_t *client, isc_region_t *wire);
+/*%<
+ * Add the rendered response 'wire' to the view's response cache if
+ * the query that produced it is cacheable.
+ */
+
 #endif /* NAMED_QUERY_H */
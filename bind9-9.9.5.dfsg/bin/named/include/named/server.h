@@ -49,6 +49,7 @@ struct ns_server {
 
 	/* Configurable data. */
 	isc_quota_t		xfroutquota;
+	unsigned int		xfroutbatch;	/*%< Messages per xfrout send */
 	isc_quota_t		tcpquota;
 	isc_quota_t		recursionquota;
 	dns_acl_t		*blackholeacl;
@@ -100,6 +101,7 @@ struct ns_server {
 	isc_stats_t *		zonestats;	/*% Zone management stats */
 	isc_stats_t  *		resolverstats;	/*% Resolver stats */
 	isc_stats_t *		sockstats;	/*%< Socket stats */
+	dns_sigcache_t *	sigcache;	/*%< Verified signatures */
 
 	ns_controls_t *		controls;	/*%< Control channels */
 	unsigned int		dispatchgen;
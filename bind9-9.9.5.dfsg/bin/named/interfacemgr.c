@@ -270,6 +270,14 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 	attrmask |= DNS_DISPATCHATTR_UDP | DNS_DISPATCHATTR_TCP;
 	attrmask |= DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_IPV6;
 
+	/*
+	 * With "reuseport", each listener gets a socket of its own bound
+	 * with SO_REUSEPORT so that the kernel, rather than a single shared
+	 * socket, spreads the incoming queries between the worker threads.
+	 */
+	if (ns_g_reuseport && ns_g_udpdisp > 1)
+		attrs |= DNS_DISPATCHATTR_REUSEPORT;
+
 	ifp->nudpdispatch = ISC_MIN(ns_g_udpdisp, MAX_UDP_DISPATCH);
 	for (disp = 0; disp < ifp->nudpdispatch; disp++) {
 		result = dns_dispatch_getudp_dup(ifp->mgr->dispatchmgr,
@@ -281,6 +289,20 @@ ns_interface_listenudp(ns_interface_t *ifp) {
 						 disp == 0
 						    ? NULL
 						    : ifp->udpdispatch[0]);
+		if (result == ISC_R_NOTIMPLEMENTED &&
+		    (attrs & DNS_DISPATCHATTR_REUSEPORT) != 0)
+		{
+			/*
+			 * Fall back to sharing the first listener's socket.
+			 */
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_WARNING,
+				      "SO_REUSEPORT is not supported; "
+				      "sharing one UDP socket between "
+				      "listeners");
+			attrs &= ~DNS_DISPATCHATTR_REUSEPORT;
+			disp--;
+			continue;
+		}
 		if (result != ISC_R_SUCCESS) {
 			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
 				      "could not listen on UDP socket: %s",
@@ -103,6 +103,7 @@ static char		absolute_conffile[ISC_DIR_PATHMAX];
 static char		saved_command_line[512];
 static char		version[512];
 static unsigned int	maxsocks = 0;
+static unsigned int	nwatchers = 1;
 static int		maxudp = 0;
 
 void
@@ -419,7 +420,7 @@ parse_command_line(int argc, char *argv[]) {
 	isc_commandline_errprint = ISC_FALSE;
 	while ((ch = isc_commandline_parse(argc, argv,
 					   "46c:C:d:E:fFgi:lm:n:N:p:P:"
-					   "sS:t:T:U:u:vVx:")) != -1) {
+					   "sS:t:T:U:u:vVW:x:")) != -1) {
 		switch (ch) {
 		case '4':
 			if (disable4)
@@ -578,6 +579,13 @@ parse_command_line(int argc, char *argv[]) {
 			       LIBXML_DOTTED_VERSION);
 #endif
 			exit(0);
+		case 'W':
+			nwatchers = parse_int(isc_commandline_argument,
+					      "number of socket watchers");
+			if (nwatchers == 0)
+				ns_main_earlyfatal("number of socket watchers "
+						   "must be at least 1");
+			break;
 		case 'F':
 			/* Reserved for FIPS mode */
 			/* FALLTHROUGH */
@@ -638,15 +646,20 @@ create_managers(void) {
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_timermgr_create(ns_g_mctx, &ns_g_timermgr);
+	/*
+	 * Every fetch and client arms and resets timers, so give each
+	 * worker thread's worth of them a timing wheel of its own.
+	 */
+	result = isc_timermgr_create2(ns_g_mctx, &ns_g_timermgr, ns_g_cpus);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_timermgr_create() failed: %s",
+				 "isc_timermgr_create2() failed: %s",
 				 isc_result_totext(result));
 		return (ISC_R_UNEXPECTED);
 	}
 
-	result = isc_socketmgr_create2(ns_g_mctx, &ns_g_socketmgr, maxsocks);
+	result = isc_socketmgr_create3(ns_g_mctx, &ns_g_socketmgr, maxsocks,
+				       nwatchers);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "isc_socketmgr_create() failed: %s",
@@ -660,6 +673,11 @@ create_managers(void) {
 			      NS_LOGMODULE_SERVER,
 			      ISC_LOG_INFO, "using up to %u sockets", socks);
 	}
+	if (nwatchers > 1) {
+		isc_log_write(ns_g_lctx, NS_LOGCATEGORY_GENERAL,
+			      NS_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "using %u socket watcher threads", nwatchers);
+	}
 
 	result = isc_entropy_create(ns_g_mctx, &ns_g_entropy);
 	if (result != ISC_R_SUCCESS) {
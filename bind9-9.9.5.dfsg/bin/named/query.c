@@ -29,6 +29,7 @@
 #include <isc/stats.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/adb.h>
 #include <dns/byaddr.h>
 #include <dns/db.h>
@@ -38,6 +39,7 @@
 #include <dns/events.h>
 #include <dns/message.h>
 #include <dns/ncache.h>
+#include <dns/nsec.h>
 #include <dns/nsec3.h>
 #include <dns/order.h>
 #include <dns/rdata.h>
@@ -48,6 +50,7 @@
 #include <dns/rdatastruct.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -139,6 +142,12 @@
 #define DNS_GETDB_PARTIAL 0x04U
 #define DNS_GETDB_IGNOREACL 0x08U
 
+/*%
+ * Flags kept with a cached response alongside its statistics counter.
+ */
+#define RESPTAG_AUTHANS	0x10000U
+#define RESPTAG_COUNTER	0x0ffffU
+
 #define PENDINGOK(x)	(((x) & DNS_DBFIND_PENDINGOK) != 0)
 
 typedef struct client_additionalctx {
@@ -158,7 +167,7 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		       dns_dbversion_t *version, ns_client_t *client,
 		       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
 		       dns_name_t *fname, isc_boolean_t exact,
-		       dns_name_t *found);
+		       dns_name_t *found, dns_name_t *hashed);
 
 static inline void
 log_queryerror(ns_client_t *client, isc_result_t result, int line, int level);
@@ -233,6 +242,19 @@ query_send(ns_client_t *client) {
 		counter = dns_nsstatscounter_failure;
 
 	inc_stats(client, counter);
+
+	/*
+	 * Remember how to count this response again if it is served
+	 * from the response cache.
+	 */
+	if ((client->query.attributes & NS_QUERYATTR_RESPCACHE) != 0 &&
+	    counter != dns_nsstatscounter_failure) {
+		client->query.resptag = counter;
+		if ((client->message->flags & DNS_MESSAGEFLAG_AA) != 0)
+			client->query.resptag |= RESPTAG_AUTHANS;
+		client->query.attributes |= NS_QUERYATTR_RESPSAVE;
+	}
+
 	ns_client_send(client);
 }
 
@@ -300,6 +322,11 @@ ns_query_cancel(ns_client_t *client) {
 
 		client->query.fetch = NULL;
 	}
+	if (client->query.prefetch != NULL) {
+		dns_resolver_cancelfetch(client->query.prefetch);
+
+		client->query.prefetch = NULL;
+	}
 	UNLOCK(&client->query.fetchlock);
 }
 
@@ -403,6 +430,8 @@ query_reset(ns_client_t *client, isc_boolean_t everything) {
 	client->query.isreferral = ISC_FALSE;
 	client->query.dns64_options = 0;
 	client->query.dns64_ttl = ISC_UINT32_MAX;
+	client->query.respkeylen = 0;
+	client->query.resptag = 0;
 }
 
 static void
@@ -618,6 +647,7 @@ ns_query_init(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	client->query.fetch = NULL;
+	client->query.prefetch = NULL;
 	client->query.authdb = NULL;
 	client->query.authzone = NULL;
 	client->query.authdbset = ISC_FALSE;
@@ -988,6 +1018,7 @@ query_getcachedb(ns_client_t *client, dns_name_t *name, dns_rdatatype_t qtype,
 	if (!USECACHE(client))
 		return (DNS_R_REFUSED);
 	dns_db_attach(client->view->cachedb, &db);
+	client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
 
 	if ((client->query.attributes & NS_QUERYATTR_CACHEACLOKVALID) != 0) {
 		/*
@@ -2968,9 +2999,9 @@ verify(dst_key_t *key, dns_name_t *name, dns_rdataset_t *rdataset,
 	dns_fixedname_init(&fixed);
 
 again:
-	result = dns_dnssec_verify3(name, rdataset, key, ignore,
+	result = dns_dnssec_verify4(name, rdataset, key, ignore,
 				    client->view->maxbits, client->mctx,
-				    rdata, NULL);
+				    rdata, NULL, client->view->sigcache);
 	if (result == DNS_R_SIGEXPIRED && client->view->acceptexpired) {
 		ignore = ISC_TRUE;
 		goto again;
@@ -3115,6 +3146,7 @@ query_addbestns(ns_client_t *client) {
 			version = NULL;
 			db = NULL;
 			dns_db_attach(client->view->cachedb, &db);
+			client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
 			is_zone = ISC_FALSE;
 			goto db_find;
 		}
@@ -3319,7 +3351,7 @@ query_addds(ns_client_t *client, dns_db_t *db, dns_dbnode_t *node,
 		dns_rdataset_disassociate(sigrdataset);
 	query_findclosestnsec3(name, db, version, client, rdataset,
 			       sigrdataset, fname, ISC_TRUE,
-			       dns_fixedname_name(&fixed));
+			       dns_fixedname_name(&fixed), NULL);
 	if (!dns_rdataset_isassociated(rdataset))
 		goto cleanup;
 	query_addrrset(client, &fname, &rdataset, &sigrdataset, dbuf,
@@ -3340,7 +3372,7 @@ query_addds(ns_client_t *client, dns_db_t *db, dns_dbnode_t *node,
 				goto cleanup;
 		query_findclosestnsec3(dns_fixedname_name(&fixed), db, version,
 				       client, rdataset, sigrdataset, fname,
-				       ISC_FALSE, NULL);
+				       ISC_FALSE, NULL, NULL);
 		if (!dns_rdataset_isassociated(rdataset))
 			goto cleanup;
 		query_addrrset(client, &fname, &rdataset, &sigrdataset, dbuf,
@@ -3356,6 +3388,60 @@ query_addds(ns_client_t *client, dns_db_t *db, dns_dbnode_t *node,
 		query_releasename(client, &fname);
 }
 
+/*
+ * Hash the first 'count' of the names an NSEC3 denial is built from in
+ * one go: the closest encloser 'cname', the next closer name of 'name'
+ * and the wildcard at the closest encloser.
+ */
+static isc_boolean_t
+query_hashnsec3proof(dns_db_t *db, dns_name_t *name, dns_name_t *cname,
+		     unsigned int count, dns_fixedname_t *hashed)
+{
+	unsigned char salt[256];
+	size_t salt_length;
+	isc_uint16_t iterations;
+	isc_result_t result;
+	dns_hash_t hash;
+	dns_fixedname_t nfixed, wfixed;
+	dns_name_t *names[3];
+	unsigned int labels;
+
+	REQUIRE(count <= 3U);
+
+	salt_length = sizeof(salt);
+	result = dns_db_getnsec3parameters(db, NULL, &hash, NULL,
+					   &iterations, salt, &salt_length);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+
+	/*
+	 * Map unknown algorithm to known value.
+	 */
+	if (hash == DNS_NSEC3_UNKNOWNALG)
+		hash = 1;
+
+	names[0] = cname;
+
+	dns_fixedname_init(&nfixed);
+	names[1] = dns_fixedname_name(&nfixed);
+	labels = dns_name_countlabels(cname) + 1;
+	if (dns_name_countlabels(name) == labels)
+		dns_name_copy(name, names[1], NULL);
+	else
+		dns_name_split(name, labels, NULL, names[1]);
+
+	dns_fixedname_init(&wfixed);
+	names[2] = dns_fixedname_name(&wfixed);
+	result = dns_name_concatenate(dns_wildcardname, cname, names[2], NULL);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+
+	result = dns_nsec3_hashnames(hashed, NULL, NULL, names, count,
+				     dns_db_origin(db), hash, iterations,
+				     salt, salt_length);
+	return (ISC_TF(result == ISC_R_SUCCESS));
+}
+
 static void
 query_addwildcardproof(ns_client_t *client, dns_db_t *db,
 		       dns_dbversion_t *version, dns_name_t *name,
@@ -3376,6 +3462,8 @@ query_addwildcardproof(ns_client_t *client, dns_db_t *db,
 	int order;
 	dns_fixedname_t cfixed;
 	dns_name_t *cname;
+	dns_fixedname_t hfixed[3];
+	isc_boolean_t hashed;
 	dns_clientinfomethods_t cm;
 	dns_clientinfo_t ci;
 
@@ -3476,13 +3564,28 @@ query_addwildcardproof(ns_client_t *client, dns_db_t *db,
 						options, 0, NULL, fname,
 						&cm, &ci, NULL, NULL);
 		}
+		/*
+		 * Hash the closest encloser, the next closer name and,
+		 * unless this is a wildcard answer, the wildcard together.
+		 */
+		labels = dns_name_countlabels(cname);
+		hashed = query_hashnsec3proof(db, name, cname,
+					      ispositive ? 2 : 3, hfixed);
 		/*
 		 * Add closest (provable) encloser NSEC3.
 		 */
 		query_findclosestnsec3(cname, db, NULL, client, rdataset,
-				       sigrdataset, fname, ISC_TRUE, cname);
+				       sigrdataset, fname, ISC_TRUE, cname,
+				       hashed ?
+				       dns_fixedname_name(&hfixed[0]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset))
 			goto cleanup;
+		/*
+		 * The other hashes are stale if opt-out moved us to a
+		 * closest provable encloser further up.
+		 */
+		if (dns_name_countlabels(cname) != labels)
+			hashed = ISC_FALSE;
 		if (!ispositive)
 			query_addrrset(client, &fname, &rdataset, &sigrdataset,
 				       dbuf, DNS_SECTION_AUTHORITY);
@@ -3519,7 +3622,9 @@ query_addwildcardproof(ns_client_t *client, dns_db_t *db,
 			dns_name_split(name, labels, NULL, wname);
 
 		query_findclosestnsec3(wname, db, NULL, client, rdataset,
-				       sigrdataset, fname, ISC_FALSE, NULL);
+				       sigrdataset, fname, ISC_FALSE, NULL,
+				       hashed ?
+				       dns_fixedname_name(&hfixed[1]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset))
 			goto cleanup;
 		query_addrrset(client, &fname, &rdataset, &sigrdataset,
@@ -3559,7 +3664,9 @@ query_addwildcardproof(ns_client_t *client, dns_db_t *db,
 			goto cleanup;
 
 		query_findclosestnsec3(wname, db, NULL, client, rdataset,
-				       sigrdataset, fname, nodata, NULL);
+				       sigrdataset, fname, nodata, NULL,
+				       hashed ?
+				       dns_fixedname_name(&hfixed[2]) : NULL);
 		if (!dns_rdataset_isassociated(rdataset))
 			goto cleanup;
 		query_addrrset(client, &fname, &rdataset, &sigrdataset,
@@ -3770,6 +3877,100 @@ query_resume(isc_task_t *task, isc_event_t *event) {
 	dns_resolver_destroyfetch(&fetch);
 }
 
+static void
+prefetch_done(isc_task_t *task, isc_event_t *event) {
+	dns_fetchevent_t *devent = (dns_fetchevent_t *)event;
+	ns_client_t *client;
+
+	UNUSED(task);
+
+	REQUIRE(event->ev_type == DNS_EVENT_FETCHDONE);
+	client = devent->ev_arg;
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(task == client->task);
+
+	LOCK(&client->query.fetchlock);
+	if (client->query.prefetch != NULL) {
+		INSIST(devent->fetch == client->query.prefetch);
+		client->query.prefetch = NULL;
+	}
+	UNLOCK(&client->query.fetchlock);
+
+	if (devent->node != NULL)
+		dns_db_detachnode(devent->db, &devent->node);
+	if (devent->db != NULL)
+		dns_db_detach(&devent->db);
+	query_putrdataset(client, &devent->rdataset);
+	if (devent->sigrdataset != NULL)
+		query_putrdataset(client, &devent->sigrdataset);
+	dns_resolver_destroyfetch(&devent->fetch);
+	isc_event_free(&event);
+
+	/*
+	 * This may destroy the client.
+	 */
+	ns_client_detach(&client);
+}
+
+/*
+ * If 'rdataset' came from the cache, is eligible for prefetching and
+ * is about to expire, start a background fetch to refresh it so that
+ * the next client does not have to wait for it.  At most one prefetch
+ * is started for each cached rdataset.
+ */
+static void
+query_prefetch(ns_client_t *client, dns_name_t *qname,
+	       dns_rdataset_t *rdataset)
+{
+	isc_result_t result;
+	isc_sockaddr_t *peeraddr;
+	dns_rdataset_t *tmprdataset;
+	ns_client_t *dummy = NULL;
+	unsigned int options;
+
+	if (client->query.prefetch != NULL ||
+	    client->view->prefetch_trigger == 0U ||
+	    rdataset->ttl > client->view->prefetch_trigger ||
+	    (rdataset->attributes & DNS_RDATASETATTR_PREFETCH) == 0 ||
+	    (rdataset->attributes & DNS_RDATASETATTR_STALE) != 0)
+		return;
+
+	if (client->recursionquota == NULL) {
+		result = isc_quota_attach(&ns_g_server->recursionquota,
+					  &client->recursionquota);
+		if (result == ISC_R_SUCCESS && !client->mortal &&
+		    (client->attributes & NS_CLIENTATTR_TCP) == 0)
+			result = ns_client_replace(client);
+		if (result != ISC_R_SUCCESS) {
+			if (client->recursionquota != NULL)
+				isc_quota_detach(&client->recursionquota);
+			return;
+		}
+	}
+
+	tmprdataset = query_newrdataset(client);
+	if (tmprdataset == NULL)
+		return;
+	if ((client->attributes & NS_CLIENTATTR_TCP) == 0)
+		peeraddr = &client->peeraddr;
+	else
+		peeraddr = NULL;
+	ns_client_attach(client, &dummy);
+	options = client->query.fetchoptions | DNS_FETCHOPT_PREFETCH;
+	result = dns_resolver_createfetch2(client->view->resolver,
+					   qname, rdataset->type, NULL, NULL,
+					   NULL, peeraddr, client->message->id,
+					   options, client->task,
+					   prefetch_done, client,
+					   tmprdataset, NULL,
+					   &client->query.prefetch);
+	if (result != ISC_R_SUCCESS) {
+		query_putrdataset(client, &tmprdataset);
+		ns_client_detach(&dummy);
+	}
+	dns_rdataset_clearprefetch(rdataset);
+}
+
 static isc_result_t
 query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	      dns_name_t *qdomain, dns_rdataset_t *nameservers,
@@ -3779,9 +3980,21 @@ query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	dns_rdataset_t *rdataset, *sigrdataset;
 	isc_sockaddr_t *peeraddr;
 
+	/*
+	 * We have already failed to resolve this and are only
+	 * looking for a stale answer; don't try again.
+	 */
+	if ((client->query.dboptions & DNS_DBFIND_STALEOK) != 0)
+		return (DNS_R_SERVFAIL);
+
 	if (!resuming)
 		inc_stats(client, dns_nsstatscounter_recursion);
 
+	/*
+	 * The answer will come from the cache.
+	 */
+	client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
+
 	/*
 	 * We are about to recurse, which means that this client will
 	 * be unavailable for serving new requests for an indeterminate
@@ -4045,6 +4258,7 @@ rpz_rrset_find(ns_client_t *client, dns_rpz_type_t rpz_type,
 		rpz_clean(NULL, dbp, &node, rdatasetp);
 		version = NULL;
 		dns_db_attach(client->view->cachedb, dbp);
+		client->query.attributes |= NS_QUERYATTR_NORESPCACHE;
 		result = dns_db_findext(*dbp, name, version, dns_rdatatype_ns,
 					0, client->now, &node, found,
 					&cm, &ci, *rdatasetp, NULL);
@@ -5251,7 +5465,7 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		       dns_dbversion_t *version, ns_client_t *client,
 		       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset,
 		       dns_name_t *fname, isc_boolean_t exact,
-		       dns_name_t *found)
+		       dns_name_t *found, dns_name_t *hashed)
 {
 	unsigned char salt[256];
 	size_t salt_length;
@@ -5287,15 +5501,21 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 		hash = 1;
 
  again:
-	dns_fixedname_init(&fixed);
-	result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
-				    dns_db_origin(db), hash,
-				    iterations, salt, salt_length);
-	if (result != ISC_R_SUCCESS)
-		return;
+	/*
+	 * 'hashed', when given, is the NSEC3 owner name of 'qname'.
+	 */
+	if (hashed == NULL || skip != 0U) {
+		dns_fixedname_init(&fixed);
+		result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
+					    dns_db_origin(db), hash,
+					    iterations, salt, salt_length);
+		if (result != ISC_R_SUCCESS)
+			return;
+		hashed = dns_fixedname_name(&fixed);
+	}
 
 	dboptions = client->query.dboptions | DNS_DBFIND_FORCENSEC3;
-	result = dns_db_findext(db, dns_fixedname_name(&fixed), version,
+	result = dns_db_findext(db, hashed, version,
 				dns_rdatatype_nsec3, dboptions, client->now,
 				NULL, fname, &cm, &ci, rdataset, sigrdataset);
 
@@ -5441,6 +5661,150 @@ dns64_aaaaok(ns_client_t *client, dns_rdataset_t *rdataset,
 	return (ISC_FALSE);
 }
 
+/*
+ * Log the reasoning of dns_nsec_noexistnodata().
+ */
+static void
+query_nseclog(void *arg, int level, const char *fmt, ...) {
+	ns_client_t *client = arg;
+	va_list ap;
+
+	if (!isc_log_wouldlog(ns_g_lctx, level))
+		return;
+
+	va_start(ap, fmt);
+	ns_client_logv(client, NS_LOGCATEGORY_CLIENT, NS_LOGMODULE_QUERY,
+		       level, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Add 'rdataset' (and 'sigrdataset' if not NULL) to the authority
+ * section under a copy of 'name' kept in 'buffer'.
+ */
+static void
+query_addsynthrrset(ns_client_t *client, dns_name_t **namep,
+		    dns_name_t *name, isc_buffer_t *buffer,
+		    dns_rdataset_t **rdatasetp, dns_rdataset_t **sigrdatasetp)
+{
+	isc_result_t result;
+
+	dns_name_init(*namep, NULL);
+	result = dns_name_copy(name, *namep, buffer);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	query_addrrset(client, namep, rdatasetp, sigrdatasetp, NULL,
+		       DNS_SECTION_AUTHORITY);
+}
+
+/*
+ * Try to answer a query for which the cache has no entry with an
+ * NXDOMAIN or NODATA response synthesized from validated NSEC records
+ * that the cache already holds (RFC 8198).  NXDOMAIN also needs an NSEC
+ * proving that there is no wildcard at the closest encloser, and both
+ * need the validated SOA of the signing zone.  Return ISC_TRUE if the
+ * response was built, in which case there is no need to recurse.
+ */
+static isc_boolean_t
+query_synthnegative(ns_client_t *client, dns_db_t *db, dns_rdatatype_t qtype)
+{
+	dns_fixedname_t fowner, fwowner, fsoaname;
+	dns_name_t *owner, *wowner, *soaname;
+	dns_name_t *names[3] = { NULL, NULL, NULL };
+	dns_rdataset_t *nsec = NULL, *nsecsig = NULL;
+	dns_rdataset_t *wnsec = NULL, *wnsecsig = NULL;
+	dns_rdataset_t *soa = NULL, *soasig = NULL;
+	isc_buffer_t *buffer = NULL;
+	isc_boolean_t nxdomain, answered = ISC_FALSE;
+	isc_result_t result;
+	unsigned int i;
+
+	CTRACE("query_synthnegative");
+
+	dns_fixedname_init(&fowner);
+	owner = dns_fixedname_name(&fowner);
+	dns_fixedname_init(&fwowner);
+	wowner = dns_fixedname_name(&fwowner);
+	dns_fixedname_init(&fsoaname);
+	soaname = dns_fixedname_name(&fsoaname);
+
+	nsec = query_newrdataset(client);
+	nsecsig = query_newrdataset(client);
+	wnsec = query_newrdataset(client);
+	wnsecsig = query_newrdataset(client);
+	soa = query_newrdataset(client);
+	soasig = query_newrdataset(client);
+	if (nsec == NULL || nsecsig == NULL || wnsec == NULL ||
+	    wnsecsig == NULL || soa == NULL || soasig == NULL)
+		goto cleanup;
+
+	result = dns_nsec_synthnegative(db, client->query.qname, qtype,
+					client->now, owner, nsec, nsecsig,
+					wowner, wnsec, wnsecsig,
+					soaname, soa, soasig,
+					query_nseclog, client);
+	if (result != DNS_R_NXDOMAIN && result != DNS_R_NXRRSET)
+		goto cleanup;
+	nxdomain = ISC_TF(result == DNS_R_NXDOMAIN);
+
+	/*
+	 * Leave NXDOMAIN redirection to the normal query path.
+	 */
+	if (nxdomain && client->view->redirect != NULL)
+		goto cleanup;
+
+	/*
+	 * Get everything that can fail before touching the message.
+	 */
+	for (i = 0; i < 3; i++) {
+		result = dns_message_gettempname(client->message, &names[i]);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+	result = isc_buffer_allocate(client->mctx, &buffer,
+				     3 * DNS_NAME_MAXWIRE);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	if (WANTDNSSEC(client)) {
+		query_addsynthrrset(client, &names[0], soaname, buffer,
+				    &soa, &soasig);
+		query_addsynthrrset(client, &names[1], owner, buffer,
+				    &nsec, &nsecsig);
+		if (nxdomain && !dns_name_equal(owner, wowner))
+			query_addsynthrrset(client, &names[2], wowner, buffer,
+					    &wnsec, &wnsecsig);
+	} else
+		query_addsynthrrset(client, &names[0], soaname, buffer,
+				    &soa, NULL);
+	dns_message_takebuffer(client->message, &buffer);
+
+	client->message->rcode = nxdomain ? dns_rcode_nxdomain
+					  : dns_rcode_noerror;
+	answered = ISC_TRUE;
+
+	if (isc_log_wouldlog(ns_g_lctx, ISC_LOG_DEBUG(3))) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(owner, namebuf, sizeof(namebuf));
+		ns_client_log(client, NS_LOGCATEGORY_CLIENT,
+			      NS_LOGMODULE_QUERY, ISC_LOG_DEBUG(3),
+			      "%s synthesized from cached NSEC at %s",
+			      nxdomain ? "NXDOMAIN" : "NODATA", namebuf);
+	}
+
+ cleanup:
+	for (i = 0; i < 3; i++)
+		if (names[i] != NULL)
+			dns_message_puttempname(client->message, &names[i]);
+	query_putrdataset(client, &nsec);
+	query_putrdataset(client, &nsecsig);
+	query_putrdataset(client, &wnsec);
+	query_putrdataset(client, &wnsecsig);
+	query_putrdataset(client, &soa);
+	query_putrdataset(client, &soasig);
+	return (answered);
+}
+
 /*
  * Look for the name and type in the redirection zone.  If found update
  * the arguments as appropriate.  Return ISC_TRUE if a update was
@@ -5868,6 +6232,29 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 				client->query.dboptions, client->now,
 				&node, fname, &cm, &ci, rdataset, sigrdataset);
 
+	if (!is_zone && dns_rdataset_isassociated(rdataset) &&
+	    (rdataset->attributes & DNS_RDATASETATTR_STALE) != 0) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		char typebuf[DNS_RDATATYPE_FORMATSIZE];
+
+		/*
+		 * This is an expired answer that we are returning
+		 * because the authoritative servers could not be
+		 * reached; give it a short TTL so that clients soon
+		 * come back for a fresh one.
+		 */
+		rdataset->ttl = client->view->staleanswerttl;
+		if (sigrdataset != NULL &&
+		    dns_rdataset_isassociated(sigrdataset))
+			sigrdataset->ttl = rdataset->ttl;
+		dns_name_format(client->query.qname, namebuf, sizeof(namebuf));
+		dns_rdatatype_format(type, typebuf, sizeof(typebuf));
+		ns_client_log(client, NS_LOGCATEGORY_QUERY_EERRORS,
+			      NS_LOGMODULE_QUERY, ISC_LOG_INFO,
+			      "%s/%s: resolver failure, serving stale answer",
+			      namebuf, typebuf);
+	}
+
  resume:
 	CTRACE("query_find: resume");
 
@@ -6329,6 +6716,8 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 				version = NULL;
 				db = NULL;
 				dns_db_attach(client->view->cachedb, &db);
+				client->query.attributes |=
+					NS_QUERYATTR_NORESPCACHE;
 				is_zone = ISC_FALSE;
 				goto db_find;
 			}
@@ -6378,6 +6767,19 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 				 */
 			}
 
+			/*
+			 * Validated NSEC records in the cache may already
+			 * prove that the answer does not exist.
+			 */
+			if (RECURSIONOK(client) && !dns64 &&
+			    client->view->synthfromdnssec &&
+			    client->view->cachedb != NULL &&
+			    (qtype != dns_rdatatype_aaaa ||
+			     ISC_LIST_EMPTY(client->view->dns64)) &&
+			    query_synthnegative(client, client->view->cachedb,
+						qtype))
+				goto cleanup;
+
 			if (RECURSIONOK(client)) {
 				/*
 				 * Recurse!
@@ -6541,7 +6943,7 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 				query_findclosestnsec3(qname, db, version,
 						       client, rdataset,
 						       sigrdataset, fname,
-						       ISC_TRUE, found);
+						       ISC_TRUE, found, NULL);
 				/*
 				 * Did we find the closest provable encloser
 				 * instead? If so add the nearest to the
@@ -6591,7 +6993,7 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 							       sigrdataset,
 							       fname,
 							       ISC_FALSE,
-							       NULL);
+							       NULL, NULL);
 				}
 			} else {
 				query_releasename(client, &fname);
@@ -6839,6 +7241,8 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 			noqname = rdataset;
 		else
 			noqname = NULL;
+		if (!is_zone && RECURSIONOK(client))
+			query_prefetch(client, fname, rdataset);
 		query_addrrset(client, &fname, &rdataset, sigrdatasetp, dbuf,
 			       DNS_SECTION_ANSWER);
 		if (noqname != NULL)
@@ -7326,6 +7730,9 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 		    dns_name_equal(client->query.qname, dns_rootname))
 			client->query.attributes &= ~NS_QUERYATTR_NOADDITIONAL;
 
+		if (!is_zone && RECURSIONOK(client))
+			query_prefetch(client, fname, rdataset);
+
 		if (dns64) {
 			qtype = type = dns_rdatatype_aaaa;
 			result = query_dns64(client, &fname, rdataset,
@@ -7443,6 +7850,20 @@ query_find(ns_client_t *client, dns_fetchevent_t *event, dns_rdatatype_t qtype)
 		client->message->flags &= ~DNS_MESSAGEFLAG_AA;
 	}
 
+	/*
+	 * If recursion failed, look again allowing expired answers
+	 * which the cache has kept for that purpose.
+	 */
+	if (eresult == DNS_R_SERVFAIL && !want_restart && !dns64 &&
+	    RECURSIONOK(client) && client->view->staleanswersok &&
+	    (client->query.dboptions & DNS_DBFIND_STALEOK) == 0)
+	{
+		client->query.dboptions |= DNS_DBFIND_STALEOK;
+		eresult = ISC_R_SUCCESS;
+		line = -1;
+		goto restart;
+	}
+
 	/*
 	 * Restart the query?
 	 */
@@ -7592,6 +8013,202 @@ log_queryerror(ns_client_t *client, isc_result_t result, int line, int level) {
 		      classp, sep2, typep, __FILE__, line);
 }
 
+/*%
+ * Decide whether the response to this query may come from, or be
+ * added to, the view's response cache and if so build its key.
+ *
+ * The key has to cover everything, other than the zone contents, that
+ * the rendered response depends on.  Features that make the response
+ * depend on the client's address or on per query state are simply
+ * excluded.
+ */
+static isc_boolean_t
+query_respcache_key(ns_client_t *client, dns_rdatatype_t qtype) {
+	dns_view_t *view = client->view;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_uint32_t attributes;
+
+	if (view->acache != NULL || view->sortlist != NULL ||
+	    view->dlzdatabase != NULL || !ISC_LIST_EMPTY(view->dns64) ||
+	    !ISC_LIST_EMPTY(view->rpz_zones))
+		return (ISC_FALSE);
+#ifdef USE_RRL
+	if (view->rrl != NULL)
+		return (ISC_FALSE);
+#endif /* USE_RRL */
+#ifdef ALLOW_FILTER_AAAA_ON_V4
+	if (view->v4_aaaa != dns_v4_aaaa_ok)
+		return (ISC_FALSE);
+#endif
+	if (client->message->tsigkey != NULL ||
+	    client->message->sig0key != NULL ||
+	    (client->attributes & NS_CLIENTATTR_WANTNSID) != 0 ||
+	    client->ednsversion > 0)
+		return (ISC_FALSE);
+
+	attributes = client->attributes & (NS_CLIENTATTR_TCP |
+					   NS_CLIENTATTR_RA |
+					   NS_CLIENTATTR_WANTDNSSEC |
+					   NS_CLIENTATTR_WANTAD);
+	if (client->opt != NULL)
+		attributes |= 0x80000000U;
+
+	isc_buffer_init(&b, client->query.respkey,
+			sizeof(client->query.respkey));
+	isc_buffer_putuint16(&b, qtype);
+	isc_buffer_putuint16(&b, client->message->rdclass);
+	isc_buffer_putuint16(&b, client->message->flags &
+			     (DNS_MESSAGEFLAG_RD | DNS_MESSAGEFLAG_AD |
+			      DNS_MESSAGEFLAG_CD));
+	isc_buffer_putuint16(&b, client->extflags & 0xffff);
+	isc_buffer_putuint16(&b, client->udpsize);
+	isc_buffer_putuint32(&b, attributes);
+	isc_buffer_putuint32(&b, client->query.attributes &
+			     (NS_QUERYATTR_RECURSIONOK |
+			      NS_QUERYATTR_CACHEOK |
+			      NS_QUERYATTR_WANTRECURSION |
+			      NS_QUERYATTR_SECURE |
+			      NS_QUERYATTR_NOAUTHORITY |
+			      NS_QUERYATTR_NOADDITIONAL));
+
+	/*
+	 * The name is compared as it appears on the wire, case included,
+	 * as it is echoed back in the response.
+	 */
+	dns_name_toregion(client->query.qname, &r);
+	if (r.length > isc_buffer_availablelength(&b))
+		return (ISC_FALSE);
+	isc_buffer_putmem(&b, r.base, r.length);
+
+	client->query.respkeylen = isc_buffer_usedlength(&b);
+	return (ISC_TRUE);
+}
+
+/*%
+ * Cached responses are shared by all clients, so they are only used
+ * for zones that anyone may query.
+ */
+static isc_boolean_t
+query_respcache_aclok(dns_view_t *view, dns_zone_t *zone) {
+	dns_acl_t *acl;
+
+	if (dns_zone_gettype(zone) == dns_zone_staticstub)
+		return (ISC_FALSE);
+	acl = dns_zone_getqueryacl(zone);
+	if (acl == NULL)
+		acl = view->queryacl;
+	if (acl != NULL && !dns_acl_isany(acl))
+		return (ISC_FALSE);
+	acl = dns_zone_getqueryonacl(zone);
+	if (acl == NULL)
+		acl = view->queryonacl;
+	if (acl != NULL && !dns_acl_isany(acl))
+		return (ISC_FALSE);
+	return (ISC_TRUE);
+}
+
+/*%
+ * Answer the query from the response cache.  Returns ISC_TRUE if a
+ * response has been sent.
+ */
+static isc_boolean_t
+query_respcache_send(ns_client_t *client, dns_rdatatype_t qtype) {
+	dns_view_t *view = client->view;
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_buffer_t buffer;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned int tag = 0;
+	isc_boolean_t answered = ISC_FALSE;
+	unsigned char data[DNS_RESPCACHE_MAXWIRE];
+
+	/*
+	 * Find the zone query_getdb() would.
+	 */
+	result = dns_zt_find(view->zonetable, client->query.qname,
+			     (qtype == dns_rdatatype_ds) ?
+			     DNS_ZTFIND_NOEXACT : 0, NULL, &zone);
+	if (result != ISC_R_SUCCESS && result != DNS_R_PARTIALMATCH)
+		return (ISC_FALSE);
+	if (!query_respcache_aclok(view, zone))
+		goto cleanup;
+
+	result = dns_zone_getdb(zone, &db);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	dns_db_currentversion(db, &version);
+
+	r.base = client->query.respkey;
+	r.length = client->query.respkeylen;
+	isc_buffer_init(&buffer, data, sizeof(data));
+	result = dns_respcache_find(view->respcache, &r, db, version,
+				    &buffer, &tag);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	/*
+	 * Count the response as query_send() and ns_client_send()
+	 * did when it was rendered.
+	 */
+	INSIST(client->query.authzone == NULL);
+	dns_zone_attach(zone, &client->query.authzone);
+	if ((tag & RESPTAG_AUTHANS) != 0)
+		inc_stats(client, dns_nsstatscounter_authans);
+	else
+		inc_stats(client, dns_nsstatscounter_nonauthans);
+	inc_stats(client, tag & RESPTAG_COUNTER);
+	isc_stats_increment(ns_g_server->nsstats, dns_nsstatscounter_response);
+	if (client->opt != NULL)
+		isc_stats_increment(ns_g_server->nsstats,
+				    dns_nsstatscounter_edns0out);
+
+	isc_buffer_usedregion(&buffer, &r);
+	ns_client_sendwire(client, &r);
+	answered = ISC_TRUE;
+
+ cleanup:
+	if (version != NULL)
+		dns_db_closeversion(db, &version, ISC_FALSE);
+	if (db != NULL)
+		dns_db_detach(&db);
+	dns_zone_detach(&zone);
+	return (answered);
+}
+
+void
+ns_query_saveresponse(ns_client_t *client, isc_region_t *wire) {
+	ns_dbversion_t *dbversion;
+	isc_region_t key;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(wire != NULL);
+
+	if ((client->query.attributes &
+	     (NS_QUERYATTR_RESPCACHE | NS_QUERYATTR_RESPSAVE |
+	      NS_QUERYATTR_NORESPCACHE)) !=
+	    (NS_QUERYATTR_RESPCACHE | NS_QUERYATTR_RESPSAVE))
+		return;
+
+	/*
+	 * The whole response must have come from a single zone database.
+	 */
+	dbversion = ISC_LIST_HEAD(client->query.activeversions);
+	if (dbversion == NULL || ISC_LIST_NEXT(dbversion, link) != NULL)
+		return;
+	if (client->query.authzone == NULL ||
+	    !query_respcache_aclok(client->view, client->query.authzone))
+		return;
+
+	key.base = client->query.respkey;
+	key.length = client->query.respkeylen;
+	(void)dns_respcache_add(client->view->respcache, &key,
+				dbversion->db, dbversion->version,
+				client->query.resptag, wire);
+}
+
 void
 ns_query_start(ns_client_t *client) {
 	isc_result_t result;
@@ -7769,6 +8386,16 @@ ns_query_start(ns_client_t *client) {
 	if ((message->flags & DNS_MESSAGEFLAG_AD) != 0)
 		client->attributes |= NS_CLIENTATTR_WANTAD;
 
+	/*
+	 * Answer from the response cache if we can.
+	 */
+	if (client->view->respcache != NULL &&
+	    query_respcache_key(client, qtype)) {
+		client->query.attributes |= NS_QUERYATTR_RESPCACHE;
+		if (query_respcache_send(client, qtype))
+			return;
+	}
+
 	/*
 	 * This is an ordinary query.
 	 */
@@ -81,8 +81,10 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/rootns.h>
 #include <dns/secalg.h>
+#include <dns/sigcache.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
 #include <dns/tkey.h>
@@ -170,6 +172,12 @@
  */
 #define MAX_ADB_SIZE_FOR_CACHESHARE	8388608U
 
+/*%
+ * Number of successful signature verifications remembered, across all
+ * views, so that the same RRSIG need not be verified again.
+ */
+#define SIGCACHE_SIZE			65536U
+
 struct ns_dispatch {
 	isc_sockaddr_t			addr;
 	unsigned int			dispatchgen;
@@ -2079,7 +2087,9 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	isc_result_t result;
 	unsigned int cleaning_interval;
 	size_t max_cache_size;
+	dns_ttl_t max_stale_ttl;
 	size_t max_acache_size;
+	size_t respcache_size;
 	size_t max_adb_size;
 	isc_uint32_t lame_ttl;
 	dns_tsig_keyring_t *ring = NULL;
@@ -2192,6 +2202,41 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 		dns_acache_setcachesize(view->acache, max_acache_size);
 	}
 
+	/*
+	 * Create the cache of rendered responses if it has been given
+	 * a size.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "response-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_isstring(obj)) {
+		str = cfg_obj_asstring(obj);
+		INSIST(strcasecmp(str, "unlimited") == 0);
+		respcache_size = ISC_UINT32_MAX;
+	} else {
+		isc_resourcevalue_t value;
+		value = cfg_obj_asuint64(obj);
+		if (value > SIZE_MAX) {
+			cfg_obj_log(obj, ns_g_lctx, ISC_LOG_WARNING,
+				    "'response-cache-size "
+				    "%" ISC_PRINT_QUADFORMAT "u' "
+				    "is too large for this "
+				    "system; reducing to %lu",
+				    value, (unsigned long)SIZE_MAX);
+			value = SIZE_MAX;
+		}
+		respcache_size = (size_t) value;
+	}
+	if (respcache_size != 0) {
+		cmctx = NULL;
+		CHECK(isc_mem_create(0, 0, &cmctx));
+		isc_mem_setname(cmctx, "respcache", NULL);
+		result = dns_respcache_create(cmctx, respcache_size,
+					      &view->respcache);
+		isc_mem_detach(&cmctx);
+		CHECK(result);
+	}
+
 	CHECK(configure_view_acl(vconfig, config, "allow-query", NULL, actx,
 				 ns_g_mctx, &view->queryacl));
 	if (view->queryacl == NULL) {
@@ -2541,6 +2586,56 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	if (view->maxncachettl > 7 * 24 * 3600)
 		view->maxncachettl = 7 * 24 * 3600;
 
+	/*
+	 * Prefetching: refresh cached answers with a TTL of at least
+	 * 'eligible' seconds when they are requested within 'trigger'
+	 * seconds of expiring.  The eligible TTL is kept at least six
+	 * seconds above the trigger.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "prefetch", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	{
+		const cfg_obj_t *trigger, *eligible;
+
+		trigger = cfg_tuple_get(obj, "trigger");
+		view->prefetch_trigger = cfg_obj_asuint32(trigger);
+		if (view->prefetch_trigger > 10)
+			view->prefetch_trigger = 10;
+		eligible = cfg_tuple_get(obj, "eligible");
+		if (cfg_obj_isvoid(eligible)) {
+			obj = NULL;
+			result = cfg_map_get(ns_g_defaults, "prefetch", &obj);
+			INSIST(result == ISC_R_SUCCESS);
+			eligible = cfg_tuple_get(obj, "eligible");
+		}
+		view->prefetch_eligible = cfg_obj_asuint32(eligible);
+		if (view->prefetch_eligible < view->prefetch_trigger + 6)
+			view->prefetch_eligible = view->prefetch_trigger + 6;
+	}
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-enable", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswersok = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "stale-answer-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->staleanswerttl = ISC_MAX(cfg_obj_asuint32(obj), 1);
+
+	obj = NULL;
+	result = ns_config_get(maps, "synth-from-dnssec", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	view->synthfromdnssec = cfg_obj_asboolean(obj);
+
+	obj = NULL;
+	result = ns_config_get(maps, "max-stale-ttl", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	max_stale_ttl = 0;
+	if (view->staleanswersok)
+		max_stale_ttl = ISC_MAX(cfg_obj_asuint32(obj), 1);
+
 	/*
 	 * Configure the view's cache.
 	 *
@@ -2666,12 +2761,20 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	result = ns_config_get(maps, "cache-file", &obj);
 	if (result == ISC_R_SUCCESS && strcmp(view->name, "_bind") != 0) {
 		CHECK(dns_cache_setfilename(cache, cfg_obj_asstring(obj)));
+		obj = NULL;
+		result = ns_config_get(maps, "cache-file-format", &obj);
+		if (result == ISC_R_SUCCESS &&
+		    strcasecmp(cfg_obj_asstring(obj), "raw") == 0)
+			dns_cache_setfileformat(cache, dns_masterformat_raw);
+		else
+			dns_cache_setfileformat(cache, dns_masterformat_text);
 		if (!reused_cache && !shared_cache)
 			CHECK(dns_cache_load(cache));
 	}
 
 	dns_cache_setcleaninginterval(cache, cleaning_interval);
 	dns_cache_setcachesize(cache, max_cache_size);
+	dns_cache_setservestalettl(cache, max_stale_ttl);
 
 	dns_cache_detach(&cache);
 
@@ -2708,6 +2811,7 @@ configure_view(dns_view_t *view, cfg_obj_t *config, cfg_obj_t *vconfig,
 	if (resquerystats == NULL)
 		CHECK(dns_rdatatypestats_create(mctx, &resquerystats));
 	dns_view_setresquerystats(view, resquerystats);
+	dns_view_setsigcache(view, ns_g_server->sigcache);
 
 	/*
 	 * Set the ADB cache size to 1/8th of the max-cache-size or
@@ -4903,6 +5007,8 @@ load_configuration(const char *filename, ns_server_t *server,
 	isc_uint32_t interface_interval;
 	isc_uint32_t reserved;
 	isc_uint32_t udpsize;
+	isc_uint32_t loadconcurrency;
+	isc_uint32_t signingworkers;
 	ns_cache_t *nsc;
 	ns_cachelist_t cachelist, tmpcachelist;
 	struct cfg_context *nzctx;
@@ -5065,6 +5171,21 @@ load_configuration(const char *filename, ns_server_t *server,
 	 * Configure various server options.
 	 */
 	configure_server_quota(maps, "transfers-out", &server->xfroutquota);
+
+	/*
+	 * Outgoing zone transfers may hand several messages to the
+	 * kernel in one send, up to the socket scatter/gather limit.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "transfer-message-batch", &obj);
+	if (result == ISC_R_SUCCESS)
+		server->xfroutbatch = cfg_obj_asuint32(obj);
+	else
+		server->xfroutbatch = 1;
+	if (server->xfroutbatch == 0)
+		server->xfroutbatch = 1;
+	if (server->xfroutbatch > ISC_SOCKET_MAXSCATTERGATHER)
+		server->xfroutbatch = ISC_SOCKET_MAXSCATTERGATHER;
 	configure_server_quota(maps, "tcp-clients", &server->tcpquota);
 	configure_server_quota(maps, "recursive-clients",
 			       &server->recursionquota);
@@ -5179,6 +5300,35 @@ load_configuration(const char *filename, ns_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_zonemgr_setserialqueryrate(server->zonemgr, cfg_obj_asuint32(obj));
 
+	/*
+	 * Zone files are loaded (and dumped) concurrently on up to this
+	 * many zones; by default one per worker thread.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "zone-load-concurrency", &obj);
+	if (result == ISC_R_SUCCESS)
+		loadconcurrency = cfg_obj_asuint32(obj);
+	else
+		loadconcurrency = ns_g_cpus;
+	if (loadconcurrency == 0)
+		loadconcurrency = 1;
+	dns_zonemgr_setiolimit(server->zonemgr, loadconcurrency);
+
+	/*
+	 * RRSIGs are computed by up to this many threads while a zone
+	 * is signed; by default one per worker thread.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "sig-signing-workers", &obj);
+	if (result == ISC_R_SUCCESS)
+		signingworkers = cfg_obj_asuint32(obj);
+	else
+		signingworkers = ns_g_cpus;
+	if (signingworkers == 0)
+		signingworkers = 1;
+	CHECKM(dns_zonemgr_setsigningworkers(server->zonemgr, signingworkers),
+	       "sig-signing-workers");
+
 	/*
 	 * Determine which port to use for listening for incoming connections.
 	 */
@@ -5197,6 +5347,15 @@ load_configuration(const char *filename, ns_server_t *server,
 	if ((ns_g_listen > 0) && (ns_g_listen < 10))
 		ns_g_listen = 10;
 
+	/*
+	 * Should each UDP listener have its own SO_REUSEPORT socket?
+	 * This only affects interfaces that are opened from now on.
+	 */
+	obj = NULL;
+	result = ns_config_get(maps, "reuseport", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_g_reuseport = cfg_obj_asboolean(obj);
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -6095,6 +6254,7 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 
 	result = isc_quota_init(&server->xfroutquota, 10);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	server->xfroutbatch = 1;
 	result = isc_quota_init(&server->tcpquota, 10);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 	result = isc_quota_init(&server->recursionquota, 100);
@@ -6220,6 +6380,11 @@ ns_server_create(isc_mem_t *mctx, ns_server_t **serverp) {
 				    dns_resstatscounter_max),
 		   "dns_stats_create (resolver)");
 
+	server->sigcache = NULL;
+	CHECKFATAL(dns_sigcache_create(ns_g_mctx, SIGCACHE_SIZE,
+				       &server->sigcache),
+		   "dns_sigcache_create");
+
 	server->flushonshutdown = ISC_FALSE;
 	server->log_queries = ISC_FALSE;
 
@@ -6256,6 +6421,7 @@ ns_server_destroy(ns_server_t **serverp) {
 	isc_stats_detach(&server->zonestats);
 	isc_stats_detach(&server->resolverstats);
 	isc_stats_detach(&server->sockstats);
+	dns_sigcache_detach(&server->sigcache);
 
 	isc_mem_free(server->mctx, server->statsfile);
 	isc_mem_free(server->mctx, server->bindkeysfile);
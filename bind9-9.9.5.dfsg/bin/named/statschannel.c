@@ -425,6 +425,14 @@ init_desc(void) {
 			 "UnixRecvErr");
 	SET_SOCKSTATDESC(fdwatchrecvfail, "FDwatch recv errors",
 			 "FDwatchRecvErr");
+	SET_SOCKSTATDESC(udp4recvbatch, "UDP/IPv4 batched recvs",
+			 "UDP4RecvBatch");
+	SET_SOCKSTATDESC(udp6recvbatch, "UDP/IPv6 batched recvs",
+			 "UDP6RecvBatch");
+	SET_SOCKSTATDESC(udp4sendbatch, "UDP/IPv4 batched sends",
+			 "UDP4SendBatch");
+	SET_SOCKSTATDESC(udp6sendbatch, "UDP/IPv6 batched sends",
+			 "UDP6SendBatch");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -452,6 +460,8 @@ init_desc(void) {
 	SET_DNSSECSTATDESC(wildcard, "dnssec validation of wildcard signature",
 			   "DNSSECwild");
 	SET_DNSSECSTATDESC(fail, "dnssec validation failures", "DNSSECfail");
+	SET_DNSSECSTATDESC(cached, "dnssec validation success from the "
+			   "signature cache", "DNSSECcached");
 	INSIST(i == dns_dnssecstats_max);
 
 	/* Sanity check */
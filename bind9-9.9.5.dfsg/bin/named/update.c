@@ -221,9 +221,17 @@ struct update_event {
 	ISC_EVENT_COMMON(update_event_t);
 	dns_zone_t		*zone;
 	isc_result_t		result;
+	isc_boolean_t		group;
 	dns_message_t		*answer;
 };
 
+/*%
+ * The most updates applied and synced to the journal together when
+ * group commit is enabled, so that a busy zone does not monopolize
+ * its task.
+ */
+#define UPDATE_BATCH	64
+
 /**************************************************************************/
 /*
  * Forward declarations.
@@ -1472,6 +1480,7 @@ send_update_event(ns_client_t *client, dns_zone_t *zone) {
 		FAIL(ISC_R_NOMEMORY);
 	event->zone = zone;
 	event->result = ISC_R_SUCCESS;
+	event->group = dns_zone_getgroupcommit(zone);
 
 	evclient = NULL;
 	ns_client_attach(client, &evclient);
@@ -1479,8 +1488,17 @@ send_update_event(ns_client_t *client, dns_zone_t *zone) {
 	client->nupdates++;
 	event->ev_arg = evclient;
 
-	dns_zone_gettask(zone, &zonetask);
-	isc_task_send(zonetask, ISC_EVENT_PTR(&event));
+	/*
+	 * With group commit the update joins the batch in progress, if
+	 * there is one, instead of being sent to the zone task.
+	 */
+	if (!event->group ||
+	    dns_zone_queueupdate(zone, (isc_event_t *)event))
+	{
+		dns_zone_gettask(zone, &zonetask);
+		isc_task_send(zonetask, ISC_EVENT_PTR(&event));
+	} else
+		event = NULL;
 
  failure:
 	if (event != NULL)
@@ -2429,12 +2447,31 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(isc_task_t *task, isc_event_t *event) {
-	update_event_t *uev = (update_event_t *) event;
-	dns_zone_t *zone = uev->zone;
-	ns_client_t *client = (ns_client_t *)event->ev_arg;
+/*%
+ * Return ISC_TRUE if 'journal' holds transactions but does not end at
+ * the serial of version 'ver' of 'db', so that a transaction starting
+ * from 'ver' could not be appended to it.
+ */
+static isc_boolean_t
+journal_behind(dns_journal_t *journal, dns_db_t *db, dns_dbversion_t *ver) {
+	isc_uint32_t serial;
+
+	if (dns_journal_first_serial(journal) ==
+	    dns_journal_last_serial(journal))
+		return (ISC_FALSE);
+	if (dns_db_getsoaserial(db, ver, &serial) != ISC_R_SUCCESS)
+		return (ISC_FALSE);
+	return (ISC_TF(dns_journal_last_serial(journal) != serial));
+}
 
+/*%
+ * Apply the update in 'client' to 'zone'.  If 'journalp' is NULL the
+ * journal is opened, written and synced here; otherwise the update is
+ * appended to '*journalp', which is opened for group commit if needed,
+ * and the caller syncs it.
+ */
+static isc_result_t
+do_update(ns_client_t *client, dns_zone_t *zone, dns_journal_t **journalp) {
 	isc_result_t result;
 	dns_db_t *db = NULL;
 	dns_dbversion_t *oldver = NULL;
@@ -2456,8 +2493,6 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	isc_boolean_t had_dnskey;
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 
-	INSIST(event->ev_type == DNS_EVENT_UPDATE);
-
 	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
 
@@ -3094,18 +3129,51 @@ update_action(isc_task_t *task, isc_event_t *event) {
 				   "writing journal %s", journalfile);
 
 			journal = NULL;
-			result = dns_journal_open(mctx, journalfile,
-						  DNS_JOURNAL_CREATE, &journal);
-			if (result != ISC_R_SUCCESS)
-				FAILS(result, "journal open failed");
+			if (journalp != NULL)
+				journal = *journalp;
+			if (journal == NULL) {
+				unsigned int mode = DNS_JOURNAL_CREATE;
+
+				if (journalp != NULL)
+					mode |= DNS_JOURNAL_GROUP;
+				result = dns_journal_open(mctx, journalfile,
+							  mode, &journal);
+				if (result != ISC_R_SUCCESS)
+					FAILS(result, "journal open failed");
+				if (journalp != NULL &&
+				    journal_behind(journal, db, oldver))
+				{
+					/*
+					 * An earlier batch was committed
+					 * but never synced, so nothing can
+					 * be appended to this journal.
+					 */
+					dns_journal_destroy(&journal);
+					result = dns_zone_resetjournal(zone);
+					if (result != ISC_R_SUCCESS)
+						FAILS(result,
+						      "journal reset failed");
+					result = dns_journal_open(mctx,
+								  journalfile,
+								  mode,
+								  &journal);
+					if (result != ISC_R_SUCCESS)
+						FAILS(result,
+						      "journal open failed");
+				}
+				if (journalp != NULL)
+					*journalp = journal;
+			}
 
 			result = dns_journal_write_transaction(journal, &diff);
 			if (result != ISC_R_SUCCESS) {
-				dns_journal_destroy(&journal);
+				if (journalp == NULL)
+					dns_journal_destroy(&journal);
 				FAILS(result, "journal write failed");
 			}
 
-			dns_journal_destroy(&journal);
+			if (journalp == NULL)
+				dns_journal_destroy(&journal);
 		}
 
 		/*
@@ -3225,16 +3293,109 @@ update_action(isc_task_t *task, isc_event_t *event) {
 	if (ssutable != NULL)
 		dns_ssutable_detach(&ssutable);
 
-	isc_task_detach(&task);
-	uev->result = result;
-	if (zone != NULL)
-		INSIST(uev->zone == zone); /* we use this later */
+	return (result);
+}
+
+static void
+update_done(isc_event_t *event) {
+	update_event_t *uev = (update_event_t *) event;
+	ns_client_t *client = (ns_client_t *)event->ev_arg;
+
 	uev->ev_type = DNS_EVENT_UPDATEDONE;
 	uev->ev_action = updatedone_action;
 	isc_task_send(client->task, &event);
 	INSIST(event == NULL);
 }
 
+static void
+update_action(isc_task_t *task, isc_event_t *event) {
+	update_event_t *uev = (update_event_t *) event;
+	dns_zone_t *zone = uev->zone;
+	dns_journal_t *journal = NULL;
+	isc_eventlist_t done;
+	isc_result_t result;
+	unsigned int n;
+
+	INSIST(event->ev_type == DNS_EVENT_UPDATE);
+
+	if (!uev->group) {
+		uev->result = do_update(uev->ev_arg, zone, NULL);
+		isc_task_detach(&task);
+		update_done(event);
+		return;
+	}
+
+	/*
+	 * Apply this update and those queued behind it while it was
+	 * waiting, append them all to the journal, and sync it once.
+	 * No response is sent until then.
+	 */
+	ISC_LIST_INIT(done);
+	for (n = 1; ; n++) {
+		uev = (update_event_t *) event;
+		INSIST(uev->zone == zone);
+		uev->result = do_update(uev->ev_arg, zone, &journal);
+		ISC_LIST_APPEND(done, event, ev_link);
+		if (n == UPDATE_BATCH)
+			break;
+		event = dns_zone_nextupdate(zone);
+		if (event == NULL)
+			break;
+	}
+
+	if (journal != NULL) {
+		result = dns_journal_sync(journal);
+		dns_journal_destroy(&journal);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "journal sync failed: %s",
+				     isc_result_totext(result));
+			/*
+			 * The batch is committed to the database, but the
+			 * journal on disk stops short of it and can no
+			 * longer be appended to.  Writing the zone out makes
+			 * the updates durable and lets the journal start
+			 * over.  If that fails too the updates are reported
+			 * as failed, and the next batch tries again.
+			 */
+			result = dns_zone_resetjournal(zone);
+		}
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "unable to write zone after journal "
+				     "sync failure: %s",
+				     isc_result_totext(result));
+			for (event = ISC_LIST_HEAD(done);
+			     event != NULL;
+			     event = ISC_LIST_NEXT(event, ev_link)) {
+				uev = (update_event_t *) event;
+				if (uev->result == ISC_R_SUCCESS)
+					uev->result = result;
+			}
+		}
+	}
+
+	/*
+	 * If the batch was cut short, hand the rest of the queue to a
+	 * new batch so that other zone events get a turn first.
+	 */
+	if (n == UPDATE_BATCH) {
+		event = dns_zone_nextupdate(zone);
+		if (event != NULL) {
+			isc_task_t *zonetask = NULL;
+
+			dns_zone_gettask(zone, &zonetask);
+			isc_task_send(zonetask, &event);
+		}
+	}
+	isc_task_detach(&task);
+
+	while ((event = ISC_LIST_HEAD(done)) != NULL) {
+		ISC_LIST_UNLINK(done, event, ev_link);
+		update_done(event);
+	}
+}
+
 static void
 updatedone_action(isc_task_t *task, isc_event_t *event) {
 	update_event_t *uev = (update_event_t *) event;
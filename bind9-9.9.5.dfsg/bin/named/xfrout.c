@@ -23,6 +23,7 @@
 #include <isc/mem.h>
 #include <isc/timer.h>
 #include <isc/print.h>
+#include <isc/socket.h>
 #include <isc/stats.h>
 #include <isc/util.h>
 
@@ -669,9 +670,11 @@ typedef struct {
 	rrstream_t 		*stream;	/* The XFR RR stream */
 	isc_boolean_t		end_of_stream;	/* EOS has been reached */
 	isc_buffer_t 		buf;		/* Buffer for message owner
-						   names and rdatas */
-	isc_buffer_t 		txlenbuf;	/* Transmit length buffer */
-	isc_buffer_t		txbuf;		/* Transmit message buffer */
+						   names and rdatas (UDP) */
+	isc_buffer_t		txbufs[ISC_SOCKET_MAXSCATTERGATHER];
+						/* Length prefixed messages */
+	isc_bufferlist_t	txlist;		/* Messages being sent */
+	unsigned int		txbatch;	/* Messages per send */
 	void 			*txmem;
 	unsigned int 		txmemlen;
 	unsigned int		nmsg;		/* Number of messages sent */
@@ -1127,7 +1130,7 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 {
 	xfrout_ctx_t *xfr;
 	isc_result_t result;
-	unsigned int len;
+	unsigned int i, len;
 	void *mem;
 
 	INSIST(xfrp != NULL && *xfrp == NULL);
@@ -1163,41 +1166,48 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 	xfr->buf.length = 0;
 	xfr->txmem = NULL;
 	xfr->txmemlen = 0;
+	ISC_LIST_INIT(xfr->txlist);
+	xfr->txbatch = 1;
 	xfr->stream = NULL;
 	xfr->quota = NULL;
 
-	/*
-	 * Allocate a temporary buffer for the uncompressed response
-	 * message data.  The size should be no more than 65535 bytes
-	 * so that the compressed data will fit in a TCP message,
-	 * and no less than 65535 bytes so that an almost maximum-sized
-	 * RR will fit.  Note that although 65535-byte RRs are allowed
-	 * in principle, they cannot be zone-transferred (at least not
-	 * if uncompressible), because the message and RR headers would
-	 * push the size of the TCP message over the 65536 byte limit.
-	 */
-	len = 65535;
-	mem = isc_mem_get(mctx, len);
-	if (mem == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto failure;
-	}
-	isc_buffer_init(&xfr->buf, mem, len);
-
-	/*
-	 * Allocate another temporary buffer for the compressed
-	 * response message and its TCP length prefix.
-	 */
-	len = 2 + 65535;
-	mem = isc_mem_get(mctx, len);
-	if (mem == NULL) {
-		result = ISC_R_NOMEMORY;
-		goto failure;
+	if ((client->attributes & NS_CLIENTATTR_TCP) == 0) {
+		/*
+		 * Allocate a temporary buffer for the uncompressed
+		 * response message data, which goes into the client
+		 * message.  Only a single SOA is ever sent over UDP.
+		 */
+		len = 65535;
+		mem = isc_mem_get(mctx, len);
+		if (mem == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto failure;
+		}
+		isc_buffer_init(&xfr->buf, mem, len);
+	} else {
+		/*
+		 * Allocate buffers for the compressed response messages
+		 * and their TCP length prefixes.  The records are rendered
+		 * straight from the database into these buffers, so a
+		 * message holds no more than 65535 bytes after compression.
+		 * Several messages may be sent at once.
+		 */
+		xfr->txbatch = ns_g_server->xfroutbatch;
+		INSIST(xfr->txbatch > 0 &&
+		       xfr->txbatch <= ISC_SOCKET_MAXSCATTERGATHER);
+		len = xfr->txbatch * (2 + 65535);
+		mem = isc_mem_get(mctx, len);
+		if (mem == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto failure;
+		}
+		for (i = 0; i < xfr->txbatch; i++)
+			isc_buffer_init(&xfr->txbufs[i],
+					(char *) mem + i * (2 + 65535),
+					2 + 65535);
+		xfr->txmem = mem;
+		xfr->txmemlen = len;
 	}
-	isc_buffer_init(&xfr->txlenbuf, mem, 2);
-	isc_buffer_init(&xfr->txbuf, (char *) mem + 2, len - 2);
-	xfr->txmem = mem;
-	xfr->txmemlen = len;
 
 	CHECK(dns_timer_setidle(xfr->client->timer,
 				maxtime, idletime, ISC_FALSE));
@@ -1226,117 +1236,74 @@ failure:
 
 
 /*
- * Arrange to send as much as we can of "stream" without blocking.
- *
- * Requires:
- *	The stream iterator is initialized and points at an RR,
- *      or possibly at the end of the stream (that is, the
- *      _first method of the iterator has been called).
+ * Render the next TCP message of the transfer into 'txbuf', preceded
+ * by its length.  The records are written straight from the stream,
+ * that is from the database's rdata slabs or the journal, into the
+ * message buffer; no message names, rdatasets or copies of the records
+ * are made.
  */
-static void
-sendstream(xfrout_ctx_t *xfr) {
-	dns_message_t *tcpmsg = NULL;
-	dns_message_t *msg = NULL; /* Client message if UDP, tcpmsg if TCP */
+static isc_result_t
+render_tcpmessage(xfrout_ctx_t *xfr, dns_message_t *msg, isc_buffer_t *txbuf)
+{
 	isc_result_t result;
+	isc_buffer_t msgbuf;
 	isc_region_t used;
-	isc_region_t region;
 	dns_rdataset_t *qrdataset;
-	dns_name_t *msgname = NULL;
-	dns_rdata_t *msgrdata = NULL;
-	dns_rdatalist_t *msgrdl = NULL;
-	dns_rdataset_t *msgrds = NULL;
+	dns_name_t *qname = NULL;
 	dns_compress_t cctx;
 	isc_boolean_t cleanup_cctx = ISC_FALSE;
-
 	int n_rrs;
 
-	isc_buffer_clear(&xfr->buf);
-	isc_buffer_clear(&xfr->txlenbuf);
-	isc_buffer_clear(&xfr->txbuf);
-
-	if ((xfr->client->attributes & NS_CLIENTATTR_TCP) == 0) {
-		/*
-		 * In the UDP case, we put the response data directly into
-		 * the client message.
-		 */
-		msg = xfr->client->message;
-		CHECK(dns_message_reply(msg, ISC_TRUE));
-	} else {
-		/*
-		 * TCP. Build a response dns_message_t, temporarily storing
-		 * the raw, uncompressed owner names and RR data contiguously
-		 * in xfr->buf.  We know that if the uncompressed data fits
-		 * in xfr->buf, the compressed data will surely fit in a TCP
-		 * message.
-		 */
-
-		CHECK(dns_message_create(xfr->mctx,
-					 DNS_MESSAGE_INTENTRENDER, &tcpmsg));
-		msg = tcpmsg;
-
-		msg->id = xfr->id;
-		msg->rcode = dns_rcode_noerror;
-		msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
-		if ((xfr->client->attributes & NS_CLIENTATTR_RA) != 0)
-			msg->flags |= DNS_MESSAGEFLAG_RA;
-		CHECK(dns_message_settsigkey(msg, xfr->tsigkey));
-		CHECK(dns_message_setquerytsig(msg, xfr->lasttsig));
-		if (xfr->lasttsig != NULL)
-			isc_buffer_free(&xfr->lasttsig);
-
-		/*
-		 * Account for reserved space.
-		 */
-		if (xfr->tsigkey != NULL)
-			INSIST(msg->reserved != 0U);
-		isc_buffer_add(&xfr->buf, msg->reserved);
+	isc_buffer_clear(txbuf);
+	isc_buffer_init(&msgbuf, (char *) isc_buffer_base(txbuf) + 2,
+			isc_buffer_length(txbuf) - 2);
+
+	msg->id = xfr->id;
+	msg->rcode = dns_rcode_noerror;
+	msg->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+	if ((xfr->client->attributes & NS_CLIENTATTR_RA) != 0)
+		msg->flags |= DNS_MESSAGEFLAG_RA;
+	CHECK(dns_message_settsigkey(msg, xfr->tsigkey));
+	CHECK(dns_message_setquerytsig(msg, xfr->lasttsig));
+	if (xfr->lasttsig != NULL)
+		isc_buffer_free(&xfr->lasttsig);
 
-		/*
-		 * Include a question section in the first message only.
-		 * BIND 8.2.1 will not recognize an IXFR if it does not
-		 * have a question section.
-		 */
-		if (xfr->nmsg == 0) {
-			dns_name_t *qname = NULL;
-			isc_region_t r;
+	/*
+	 * Account for reserved space.
+	 */
+	if (xfr->tsigkey != NULL)
+		INSIST(msg->reserved != 0U);
 
-			/*
-			 * Reserve space for the 12-byte message header
-			 * and 4 bytes of question.
-			 */
-			isc_buffer_add(&xfr->buf, 12 + 4);
+	CHECK(dns_compress_init(&cctx, -1, xfr->mctx));
+	dns_compress_setsensitive(&cctx, ISC_TRUE);
+	cleanup_cctx = ISC_TRUE;
+	CHECK(dns_message_renderbegin(msg, &cctx, &msgbuf));
 
-			qrdataset = NULL;
-			result = dns_message_gettemprdataset(msg, &qrdataset);
-			if (result != ISC_R_SUCCESS)
-				goto failure;
-			dns_rdataset_init(qrdataset);
-			dns_rdataset_makequestion(qrdataset,
-					xfr->client->message->rdclass,
-					xfr->qtype);
-
-			result = dns_message_gettempname(msg, &qname);
-			if (result != ISC_R_SUCCESS)
-				goto failure;
-			dns_name_init(qname, NULL);
-			isc_buffer_availableregion(&xfr->buf, &r);
-			INSIST(r.length >= xfr->qname->length);
-			r.length = xfr->qname->length;
-			isc_buffer_putmem(&xfr->buf, xfr->qname->ndata,
-					  xfr->qname->length);
-			dns_name_fromregion(qname, &r);
-			ISC_LIST_INIT(qname->list);
-			ISC_LIST_APPEND(qname->list, qrdataset, link);
-
-			dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
-		} else {
-			/*
-			 * Reserve space for the 12-byte message header
-			 */
-			isc_buffer_add(&xfr->buf, 12);
-			msg->tcp_continuation = 1;
+	/*
+	 * Include a question section in the first message only.
+	 * BIND 8.2.1 will not recognize an IXFR if it does not
+	 * have a question section.
+	 */
+	if (xfr->nmsg == 0) {
+		qrdataset = NULL;
+		CHECK(dns_message_gettemprdataset(msg, &qrdataset));
+		dns_rdataset_init(qrdataset);
+		dns_rdataset_makequestion(qrdataset,
+					  xfr->client->message->rdclass,
+					  xfr->qtype);
+
+		result = dns_message_gettempname(msg, &qname);
+		if (result != ISC_R_SUCCESS) {
+			dns_message_puttemprdataset(msg, &qrdataset);
+			goto failure;
 		}
-	}
+		dns_name_init(qname, NULL);
+		dns_name_clone(xfr->qname, qname);
+		ISC_LIST_APPEND(qname->list, qrdataset, link);
+		dns_message_addname(msg, qname, DNS_SECTION_QUESTION);
+		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
+	} else
+		msg->tcp_continuation = 1;
 
 	/*
 	 * Try to fit in as many RRs as possible, unless "one-answer"
@@ -1347,95 +1314,32 @@ sendstream(xfrout_ctx_t *xfr) {
 		isc_uint32_t ttl;
 		dns_rdata_t *rdata = NULL;
 
-		unsigned int size;
-		isc_region_t r;
-
-		msgname = NULL;
-		msgrdata = NULL;
-		msgrdl = NULL;
-		msgrds = NULL;
-
 		xfr->stream->methods->current(xfr->stream,
 					      &name, &ttl, &rdata);
-		size = name->length + 10 + rdata->length;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		if (size >= r.length) {
+		result = dns_message_renderrdata(msg, DNS_SECTION_ANSWER,
+						 name, ttl, rdata);
+		if (result == ISC_R_NOSPACE) {
 			/*
 			 * RR would not fit.  If there are other RRs in the
-			 * buffer, send them now and leave this RR to the
-			 * next message.  If this RR overflows the buffer
+			 * message, send them now and leave this RR to the
+			 * next message.  If this RR overflows the message
 			 * all by itself, fail.
-			 *
-			 * In theory some RRs might fit in a TCP message
-			 * when compressed even if they do not fit when
-			 * uncompressed, but surely we don't want
-			 * to send such monstrosities to an unsuspecting
-			 * slave.
 			 */
 			if (n_rrs == 0) {
 				xfrout_log(xfr, ISC_LOG_WARNING,
 					   "RR too large for zone transfer "
-					   "(%d bytes)", size);
+					   "(%d bytes)",
+					   name->length + 10 + rdata->length);
 				/* XXX DNS_R_RRTOOLARGE? */
-				result = ISC_R_NOSPACE;
 				goto failure;
 			}
 			break;
 		}
+		CHECK(result);
 
 		if (isc_log_wouldlog(ns_g_lctx, XFROUT_RR_LOGLEVEL))
 			log_rr(name, rdata, ttl); /* XXX */
 
-		result = dns_message_gettempname(msg, &msgname);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		dns_name_init(msgname, NULL);
-		isc_buffer_availableregion(&xfr->buf, &r);
-		INSIST(r.length >= name->length);
-		r.length = name->length;
-		isc_buffer_putmem(&xfr->buf, name->ndata, name->length);
-		dns_name_fromregion(msgname, &r);
-
-		/* Reserve space for RR header. */
-		isc_buffer_add(&xfr->buf, 10);
-
-		result = dns_message_gettemprdata(msg, &msgrdata);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		isc_buffer_availableregion(&xfr->buf, &r);
-		r.length = rdata->length;
-		isc_buffer_putmem(&xfr->buf, rdata->data, rdata->length);
-		dns_rdata_init(msgrdata);
-		dns_rdata_fromregion(msgrdata,
-				     rdata->rdclass, rdata->type, &r);
-
-		result = dns_message_gettemprdatalist(msg, &msgrdl);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		msgrdl->type = rdata->type;
-		msgrdl->rdclass = rdata->rdclass;
-		msgrdl->ttl = ttl;
-		if (rdata->type == dns_rdatatype_sig ||
-		    rdata->type == dns_rdatatype_rrsig)
-			msgrdl->covers = dns_rdata_covers(rdata);
-		else
-			msgrdl->covers = dns_rdatatype_none;
-		ISC_LINK_INIT(msgrdl, link);
-		ISC_LIST_INIT(msgrdl->rdata);
-		ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
-
-		result = dns_message_gettemprdataset(msg, &msgrds);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
-		dns_rdataset_init(msgrds);
-		result = dns_rdatalist_tordataset(msgrdl, msgrds);
-		INSIST(result == ISC_R_SUCCESS);
-
-		ISC_LIST_APPEND(msgname->list, msgrds, link);
-
-		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
-		msgname = NULL;
-
 		result = xfr->stream->methods->next(xfr->stream);
 		if (result == ISC_R_NOMORE) {
 			xfr->end_of_stream = ISC_TRUE;
@@ -1447,43 +1351,96 @@ sendstream(xfrout_ctx_t *xfr) {
 			break;
 	}
 
-	if ((xfr->client->attributes & NS_CLIENTATTR_TCP) != 0) {
-		CHECK(dns_compress_init(&cctx, -1, xfr->mctx));
-		dns_compress_setsensitive(&cctx, ISC_TRUE);
-		cleanup_cctx = ISC_TRUE;
-		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
-		CHECK(dns_message_renderend(msg));
-		dns_compress_invalidate(&cctx);
-		cleanup_cctx = ISC_FALSE;
-
-		isc_buffer_usedregion(&xfr->txbuf, &used);
-		isc_buffer_putuint16(&xfr->txlenbuf,
-				     (isc_uint16_t)used.length);
-		region.base = xfr->txlenbuf.base;
-		region.length = 2 + used.length;
-		xfrout_log(xfr, ISC_LOG_DEBUG(8),
-			   "sending TCP message of %d bytes",
-			   used.length);
-		CHECK(isc_socket_send(xfr->client->tcpsocket, /* XXX */
-				      &region, xfr->client->task,
-				      xfrout_senddone,
-				      xfr));
-		xfr->sends++;
-	} else {
-		xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
-		ns_client_send(xfr->client);
-		xfr->stream->methods->pause(xfr->stream);
-		xfrout_ctx_destroy(&xfr);
-		return;
-	}
+	CHECK(dns_message_renderend(msg));
+	dns_compress_invalidate(&cctx);
+	cleanup_cctx = ISC_FALSE;
+
+	isc_buffer_usedregion(&msgbuf, &used);
+	isc_buffer_putuint16(txbuf, (isc_uint16_t)used.length);
+	isc_buffer_add(txbuf, used.length);
+	xfrout_log(xfr, ISC_LOG_DEBUG(8),
+		   "sending TCP message of %d bytes",
+		   used.length);
 
 	/* Advance lasttsig to be the last TSIG generated */
 	CHECK(dns_message_getquerytsig(msg, xfr->mctx, &xfr->lasttsig));
 
 	xfr->nmsg++;
 
+ failure:
+	if (cleanup_cctx)
+		dns_compress_invalidate(&cctx);
+	return (result);
+}
+
+/*
+ * Send the answer to an IXFR over UDP, which is always a single SOA,
+ * in the client message.
+ */
+static void
+sendstream_udp(xfrout_ctx_t *xfr) {
+	dns_message_t *msg = xfr->client->message;
+	isc_result_t result;
+	dns_name_t *msgname = NULL;
+	dns_rdata_t *msgrdata = NULL;
+	dns_rdatalist_t *msgrdl = NULL;
+	dns_rdataset_t *msgrds = NULL;
+	dns_name_t *name = NULL;
+	isc_uint32_t ttl;
+	dns_rdata_t *rdata = NULL;
+	isc_region_t r;
+
+	isc_buffer_clear(&xfr->buf);
+	CHECK(dns_message_reply(msg, ISC_TRUE));
+
+	xfr->stream->methods->current(xfr->stream, &name, &ttl, &rdata);
+	isc_buffer_availableregion(&xfr->buf, &r);
+	INSIST(name->length + 10 + rdata->length < r.length);
+
+	if (isc_log_wouldlog(ns_g_lctx, XFROUT_RR_LOGLEVEL))
+		log_rr(name, rdata, ttl); /* XXX */
+
+	CHECK(dns_message_gettempname(msg, &msgname));
+	dns_name_init(msgname, NULL);
+	isc_buffer_availableregion(&xfr->buf, &r);
+	r.length = name->length;
+	isc_buffer_putmem(&xfr->buf, name->ndata, name->length);
+	dns_name_fromregion(msgname, &r);
+
+	CHECK(dns_message_gettemprdata(msg, &msgrdata));
+	isc_buffer_availableregion(&xfr->buf, &r);
+	r.length = rdata->length;
+	isc_buffer_putmem(&xfr->buf, rdata->data, rdata->length);
+	dns_rdata_init(msgrdata);
+	dns_rdata_fromregion(msgrdata, rdata->rdclass, rdata->type, &r);
+
+	CHECK(dns_message_gettemprdatalist(msg, &msgrdl));
+	msgrdl->type = rdata->type;
+	msgrdl->rdclass = rdata->rdclass;
+	msgrdl->ttl = ttl;
+	if (rdata->type == dns_rdatatype_sig ||
+	    rdata->type == dns_rdatatype_rrsig)
+		msgrdl->covers = dns_rdata_covers(rdata);
+	else
+		msgrdl->covers = dns_rdatatype_none;
+	ISC_LINK_INIT(msgrdl, link);
+	ISC_LIST_INIT(msgrdl->rdata);
+	ISC_LIST_APPEND(msgrdl->rdata, msgrdata, link);
+
+	CHECK(dns_message_gettemprdataset(msg, &msgrds));
+	dns_rdataset_init(msgrds);
+	result = dns_rdatalist_tordataset(msgrdl, msgrds);
+	INSIST(result == ISC_R_SUCCESS);
+
+	ISC_LIST_APPEND(msgname->list, msgrds, link);
+	dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
+
+	xfrout_log(xfr, ISC_LOG_DEBUG(8), "sending IXFR UDP response");
+	ns_client_send(xfr->client);
+	xfr->stream->methods->pause(xfr->stream);
+	xfrout_ctx_destroy(&xfr);
+	return;
+
  failure:
 	if (msgname != NULL) {
 		if (msgrds != NULL) {
@@ -1500,11 +1457,57 @@ sendstream(xfrout_ctx_t *xfr) {
 		dns_message_puttempname(msg, &msgname);
 	}
 
+	xfr->stream->methods->pause(xfr->stream);
+	xfrout_fail(xfr, result, "sending zone data");
+}
+
+/*
+ * Arrange to send as much as we can of "stream" without blocking.
+ * Over TCP, up to 'txbatch' messages are rendered and handed to the
+ * socket in one scatter/gather send.
+ *
+ * Requires:
+ *	The stream iterator is initialized and points at an RR,
+ *      or possibly at the end of the stream (that is, the
+ *      _first method of the iterator has been called).
+ */
+static void
+sendstream(xfrout_ctx_t *xfr) {
+	dns_message_t *tcpmsg = NULL;
+	isc_result_t result;
+	unsigned int nbufs;
+
+	if ((xfr->client->attributes & NS_CLIENTATTR_TCP) == 0) {
+		sendstream_udp(xfr);
+		return;
+	}
+
+	CHECK(dns_message_create(xfr->mctx, DNS_MESSAGE_INTENTRENDER,
+				 &tcpmsg));
+	for (nbufs = 0;
+	     nbufs < xfr->txbatch && (nbufs == 0 || !xfr->end_of_stream);
+	     nbufs++)
+	{
+		if (nbufs != 0)
+			dns_message_reset(tcpmsg, DNS_MESSAGE_INTENTRENDER);
+		CHECK(render_tcpmessage(xfr, tcpmsg, &xfr->txbufs[nbufs]));
+		ISC_LIST_APPEND(xfr->txlist, &xfr->txbufs[nbufs], link);
+	}
+
+	CHECK(isc_socket_sendv(xfr->client->tcpsocket, /* XXX */
+			       &xfr->txlist, xfr->client->task,
+			       xfrout_senddone, xfr));
+	xfr->sends++;
+
+ failure:
+	while (!ISC_LIST_EMPTY(xfr->txlist)) {
+		isc_buffer_t *b = ISC_LIST_HEAD(xfr->txlist);
+		ISC_LIST_DEQUEUE(xfr->txlist, b, link);
+	}
+
 	if (tcpmsg != NULL)
 		dns_message_destroy(&tcpmsg);
 
-	if (cleanup_cctx)
-		dns_compress_invalidate(&cctx);
 	/*
 	 * Make sure to release any locks held by database
 	 * iterators before returning from the event handler.
@@ -1566,6 +1569,10 @@ xfrout_senddone(isc_task_t *task, isc_event_t *event) {
 
 	INSIST(event->ev_type == ISC_SOCKEVENT_SENDDONE);
 
+	while (!ISC_LIST_EMPTY(sev->bufferlist)) {
+		isc_buffer_t *b = ISC_LIST_HEAD(sev->bufferlist);
+		ISC_LIST_DEQUEUE(sev->bufferlist, b, link);
+	}
 	isc_event_free(&event);
 	xfr->sends--;
 	INSIST(xfr->sends == 0);
@@ -931,6 +931,8 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			masterformat = dns_masterformat_text;
 		else if (strcasecmp(masterformatstr, "raw") == 0)
 			masterformat = dns_masterformat_raw;
+		else if (strcasecmp(masterformatstr, "map") == 0)
+			masterformat = dns_masterformat_map;
 		else
 			INSIST(0);
 	}
@@ -1499,6 +1501,11 @@ ns_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		else
 			dns_zone_setserialupdatemethod(zone,
 						  dns_updatemethod_increment);
+
+		obj = NULL;
+		result = ns_config_get(maps, "update-group-commit", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setgroupcommit(zone, cfg_obj_asboolean(obj));
 	}
 
 	/*
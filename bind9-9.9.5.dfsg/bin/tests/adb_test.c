@@ -27,10 +27,14 @@
 
 #include <isc/app.h>
 #include <isc/buffer.h>
+#include <isc/commandline.h>
 #include <isc/entropy.h>
 #include <isc/hash.h>
+#include <isc/random.h>
 #include <isc/socket.h>
 #include <isc/task.h>
+#include <isc/thread.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -38,9 +42,14 @@
 #include <dns/cache.h>
 #include <dns/dispatch.h>
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/log.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 #include <dns/rootns.h>
 #include <dns/result.h>
+#include <dns/view.h>
 
 typedef struct client client_t;
 struct client {
@@ -67,6 +76,13 @@ static isc_mutex_t client_lock;
 static isc_stdtime_t now;
 static dns_adb_t *adb;
 
+/*
+ * Benchmark state (-b).
+ */
+static dns_fixedname_t *bnames;
+static unsigned int bcount = 10000;
+static unsigned int biterations;
+
 static void
 check_result(isc_result_t result, const char *format, ...)
      ISC_FORMAT_PRINTF(2, 3);
@@ -222,6 +238,8 @@ create_view(void) {
 						      dispatchmgr,
 						      disp4, disp6) ==
 		      ISC_R_SUCCESS);
+		dns_dispatch_detach(&disp4);
+		dns_dispatch_detach(&disp6);
 	}
 
 	rootdb = NULL;
@@ -281,13 +299,172 @@ lookup(const char *target) {
 	}
 }
 
+/*
+ * Give 'bcount' names one A record each in the view's cache, so that
+ * the ADB can answer finds for them without going to the network.
+ */
+static void
+populate_cache(void) {
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata;
+	dns_dbnode_t *node;
+	dns_name_t *name;
+	isc_buffer_t b;
+	isc_result_t result;
+	unsigned char addr[4];
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int i;
+
+	bnames = isc_mem_get(mctx, bcount * sizeof(*bnames));
+	INSIST(bnames != NULL);
+
+	for (i = 0; i < bcount; i++) {
+		snprintf(text, sizeof(text), "ns%u.zone%u.example.", i,
+			 i % 97);
+		dns_fixedname_init(&bnames[i]);
+		name = dns_fixedname_name(&bnames[i]);
+		isc_buffer_constinit(&b, text, strlen(text));
+		isc_buffer_add(&b, strlen(text));
+		result = dns_name_fromtext(name, &b, dns_rootname, 0, NULL);
+		check_result(result, "dns_name_fromtext %s", text);
+
+		addr[0] = 10;
+		addr[1] = (i >> 16) & 0xff;
+		addr[2] = (i >> 8) & 0xff;
+		addr[3] = i & 0xff;
+		dns_rdata_init(&rdata);
+		rdata.data = addr;
+		rdata.length = sizeof(addr);
+		rdata.rdclass = dns_rdataclass_in;
+		rdata.type = dns_rdatatype_a;
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 3600;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+		dns_rdataset_init(&rdataset);
+		RUNTIME_CHECK(dns_rdatalist_tordataset(&rdatalist, &rdataset)
+			      == ISC_R_SUCCESS);
+		rdataset.trust = dns_trust_answer;
+
+		node = NULL;
+		result = dns_db_findnode(view->cachedb, name, ISC_TRUE, &node);
+		check_result(result, "dns_db_findnode %s", text);
+		result = dns_db_addrdataset(view->cachedb, node, NULL, now,
+					    &rdataset, 0, NULL);
+		check_result(result, "dns_db_addrdataset %s", text);
+		dns_db_detachnode(view->cachedb, &node);
+		dns_rdataset_disassociate(&rdataset);
+	}
+}
+
+/*
+ * Look up random names from the populated cache, touch the address
+ * returned as the resolver would, and release the find.
+ */
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+run_finds(void *arg) {
+	dns_adbfind_t *find;
+	dns_adbaddrinfo_t *ai;
+	isc_result_t result;
+	isc_uint32_t r;
+	unsigned int i, options;
+
+	UNUSED(arg);
+
+	options = DNS_ADBFIND_INET | DNS_ADBFIND_RETURNLAME;
+	for (i = 0; i < biterations; i++) {
+		isc_random_get(&r);
+		find = NULL;
+		result = dns_adb_createfind(adb, NULL, NULL, NULL,
+				    dns_fixedname_name(&bnames[r % bcount]),
+				    dns_rootname, 0, options, now, NULL,
+				    53, &find);
+		check_result(result, "dns_adb_createfind");
+		ai = ISC_LIST_HEAD(find->list);
+		INSIST(ai != NULL);
+		dns_adb_adjustsrtt(adb, ai, r % 100000, DNS_ADB_RTTADJDEFAULT);
+		dns_adb_destroyfind(&find);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+benchmark(unsigned int nthreads) {
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t workers[64];
+#endif
+	isc_time_t start, finish;
+	isc_uint64_t usecs;
+	unsigned int i;
+
+	populate_cache();
+
+	/* Warm the ADB so that the timed run measures lookups only. */
+	biterations = bcount;
+	(void)run_finds(NULL);
+
+	biterations = 100000;
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+#ifdef ISC_PLATFORM_USETHREADS
+	INSIST(nthreads > 0 && nthreads <= sizeof(workers)/sizeof(workers[0]));
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(run_finds, NULL,
+						&workers[i]) ==
+			      ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(workers[i], NULL);
+#else
+	nthreads = 1;
+	(void)run_finds(NULL);
+#endif
+	RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%u names, %u threads, %u finds each: %.3f seconds, "
+	       "%.0f finds/second\n", bcount, nthreads, biterations,
+	       (double)usecs / 1000000.0, (usecs == 0) ? 0.0 :
+	       (double)nthreads * biterations * 1000000.0 / (double)usecs);
+
+	for (i = 0; i < bcount; i++)
+		dns_adb_flushname(adb, dns_fixedname_name(&bnames[i]));
+	isc_mem_put(mctx, bnames, bcount * sizeof(*bnames));
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: adb_test [-b threads [-n names]]\n");
+	exit(1);
+}
+
 int
 main(int argc, char **argv) {
 	isc_result_t result;
 	isc_logdestination_t destination;
-
-	UNUSED(argc);
-	UNUSED(argv);
+	unsigned int nthreads = 0;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "b:n:")) != -1) {
+		switch (ch) {
+		case 'b':
+			nthreads = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			bcount = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc > isc_commandline_index || bcount == 0)
+		usage();
 
 	dns_result_register();
 	result = isc_app_start();
@@ -338,7 +515,7 @@ main(int argc, char **argv) {
 	/*
 	 * Set the initial debug level.
 	 */
-	isc_log_setdebuglevel(lctx, 2);
+	isc_log_setdebuglevel(lctx, nthreads == 0 ? 2 : 0);
 
 	create_managers();
 
@@ -356,6 +533,13 @@ main(int argc, char **argv) {
 
 	adb = view->adb;
 
+	if (nthreads != 0) {
+		benchmark(nthreads);
+		isc_task_detach(&t1);
+		isc_task_detach(&t2);
+		goto shutdown;
+	}
+
 	/*
 	 * Lock the entire client list here.  This will cause all events
 	 * for found names to block as well.
@@ -410,9 +594,11 @@ main(int argc, char **argv) {
 
 	dns_adb_dump(adb, stderr);
 
+ shutdown:
 	dns_view_detach(&view);
 	adb = NULL;
 
+	dns_dispatchmgr_destroy(&dispatchmgr);
 	fprintf(stderr, "Destroying socket manager\n");
 	isc_socketmgr_destroy(&socketmgr);
 	fprintf(stderr, "Destroying timer manager\n");
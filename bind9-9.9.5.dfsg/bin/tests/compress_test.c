@@ -21,16 +21,20 @@
 
 #include <config.h>
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <isc/buffer.h>
 #include <isc/commandline.h>
 #include <isc/mem.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/compress.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
+#include <dns/result.h>
 
 unsigned char plain1[] = "\003yyy\003foo";
 unsigned char plain2[] = "\003bar\003yyy\003foo";
@@ -48,16 +52,26 @@ void
 test(unsigned int, dns_name_t *, dns_name_t *, dns_name_t *,
      unsigned char *, unsigned int);
 
+void
+benchmark(unsigned int, unsigned int);
+
 int
 main(int argc, char *argv[]) {
 	dns_name_t name1;
 	dns_name_t name2;
 	dns_name_t name3;
 	isc_region_t region;
+	unsigned int iterations = 0, count = 2000;
 	int c;
 
-	while ((c = isc_commandline_parse(argc, argv, "rv")) != -1) {
+	while ((c = isc_commandline_parse(argc, argv, "b:n:rv")) != -1) {
 		switch (c) {
+		case 'b':
+			iterations = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			count = atoi(isc_commandline_argument);
+			break;
 		case 'r':
 			raw++;
 			break;
@@ -87,6 +101,9 @@ main(int argc, char *argv[]) {
 	     sizeof(plain));
 	test(DNS_COMPRESS_ALL, &name1, &name2, &name3, plain, sizeof(plain));
 
+	if (iterations != 0)
+		benchmark(iterations, count);
+
 	return (0);
 }
 
@@ -192,3 +209,102 @@ test(unsigned int allowed, dns_name_t *name1, dns_name_t *name2,
 	RUNTIME_CHECK(memcmp(target.base, result, target.used) == 0);
 	isc_mem_destroy(&mctx);
 }
+
+/*
+ * Render 'count' names, a mix of host names spread over a few zones and
+ * NSEC3 style hashed owner names, into a message sized buffer
+ * 'iterations' times and report the time taken.  The first pass is
+ * decompressed again and checked against the originals.
+ */
+void
+benchmark(unsigned int iterations, unsigned int count) {
+	static const char b32[] = "0123456789abcdefghijklmnopqrstuv";
+	isc_mem_t *mctx = NULL;
+	dns_compress_t cctx;
+	dns_decompress_t dctx;
+	dns_fixedname_t *names;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_buffer_t source, target, b;
+	isc_time_t start, finish;
+	unsigned char *wire;
+	unsigned char buf[DNS_NAME_MAXWIRE];
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int i, j, k, rendered = 0, bytes = 0;
+	isc_uint64_t usecs;
+	double rate;
+
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	names = isc_mem_get(mctx, count * sizeof(*names));
+	wire = isc_mem_get(mctx, 65535);
+	RUNTIME_CHECK(names != NULL && wire != NULL);
+
+	srandom(1);
+	for (i = 0; i < count; i++) {
+		if ((i % 2) == 0) {
+			snprintf(text, sizeof(text),
+				 "host%u.sub%u.zone%u.example.com.",
+				 i, i % 7, i % 13);
+		} else {
+			for (k = 0; k < 32; k++)
+				text[k] = b32[random() % 32];
+			snprintf(text + 32, sizeof(text) - 32,
+				 ".zone%u.example.com.", i % 13);
+		}
+		dns_fixedname_init(&names[i]);
+		name = dns_fixedname_name(&names[i]);
+		isc_buffer_init(&b, text, strlen(text));
+		isc_buffer_add(&b, strlen(text));
+		RUNTIME_CHECK(dns_name_fromtext(name, &b, dns_rootname, 0,
+						NULL) == ISC_R_SUCCESS);
+	}
+
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+	for (j = 0; j < iterations; j++) {
+		RUNTIME_CHECK(dns_compress_init(&cctx, -1, mctx) ==
+			      ISC_R_SUCCESS);
+		dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+		isc_buffer_init(&source, wire, 65535);
+		for (i = 0; i < count; i++) {
+			name = dns_fixedname_name(&names[i]);
+			if (dns_name_towire(name, &cctx, &source) !=
+			    ISC_R_SUCCESS)
+				break;
+		}
+		dns_compress_invalidate(&cctx);
+		if (j == 0) {
+			rendered = i;
+			bytes = isc_buffer_usedlength(&source);
+		}
+	}
+	RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+
+	/*
+	 * Check that the last pass decompresses to the original names.
+	 */
+	isc_buffer_setactive(&source, source.used);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	dns_fixedname_init(&fixed);
+	for (i = 0; i < rendered; i++) {
+		isc_buffer_init(&target, buf, sizeof(buf));
+		name = dns_fixedname_name(&fixed);
+		RUNTIME_CHECK(dns_name_fromwire(name, &source, &dctx,
+						ISC_FALSE, &target) ==
+			      ISC_R_SUCCESS);
+		RUNTIME_CHECK(dns_name_equal(name,
+				   dns_fixedname_name(&names[i])));
+	}
+	dns_decompress_invalidate(&dctx);
+
+	usecs = isc_time_microdiff(&finish, &start);
+	rate = (usecs == 0) ? 0.0 :
+		(double)rendered * iterations * 1000000.0 / (double)usecs;
+	fprintf(stdout, "%u names in %u bytes, %u iterations: "
+		"%.3f seconds, %.0f names/second\n", rendered, bytes,
+		iterations, (double)usecs / 1000000.0, rate);
+
+	isc_mem_put(mctx, wire, 65535);
+	isc_mem_put(mctx, names, count * sizeof(*names));
+	isc_mem_destroy(&mctx);
+}
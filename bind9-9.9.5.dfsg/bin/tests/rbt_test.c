@@ -22,8 +22,11 @@
 #include <stdlib.h>
 
 #include <isc/commandline.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
+#include <isc/random.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/rbt.h>
@@ -248,6 +251,89 @@ iterate(dns_rbt_t *rbt, isc_boolean_t forward) {
 }
 
 
+/*
+ * Fill a tree with 'count' names shaped like a large zone, "hN.zM.example."
+ * with 256 subzones, and report the memory used per name and the average
+ * time of an exact match lookup.
+ */
+#define BENCH_SAMPLES	16384
+#define BENCH_LOOKUPS	(BENCH_SAMPLES * 64)
+
+static void
+benchname(unsigned int i, dns_name_t *name) {
+	char text[64];
+	isc_buffer_t source;
+	isc_result_t result;
+
+	snprintf(text, sizeof(text), "h%u.z%u.example.", i, i % 256);
+	isc_buffer_init(&source, text, strlen(text));
+	isc_buffer_add(&source, strlen(text));
+	result = dns_name_fromtext(name, &source, dns_rootname, 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+}
+
+static void
+benchmark(unsigned int count) {
+	dns_fixedname_t *samples, fixed;
+	dns_rbtnode_t *node;
+	dns_rbt_t *rbt = NULL;
+	isc_time_t start, finish;
+	isc_uint32_t r;
+	size_t inuse;
+	isc_result_t result;
+	unsigned int i;
+	isc_uint64_t usecs;
+
+	result = dns_rbt_create(mctx, NULL, NULL, &rbt);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	inuse = isc_mem_inuse(mctx);
+	dns_fixedname_init(&fixed);
+	TIME_NOW(&start);
+	for (i = 0; i < count; i++) {
+		benchname(i, dns_fixedname_name(&fixed));
+		node = NULL;
+		result = dns_rbt_addnode(rbt, dns_fixedname_name(&fixed),
+					 &node);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	TIME_NOW(&finish);
+	inuse = isc_mem_inuse(mctx) - inuse;
+	usecs = isc_time_microdiff(&finish, &start);
+
+	printf("%u names in %u nodes, %lu bytes per name "
+	       "(node structure %lu bytes)\n",
+	       count, dns_rbt_nodecount(rbt),
+	       (unsigned long)(inuse / count),
+	       (unsigned long)sizeof(dns_rbtnode_t));
+	printf("add:    %8.1f ns per name\n", usecs * 1000.0 / count);
+
+	samples = malloc(BENCH_SAMPLES * sizeof(*samples));
+	RUNTIME_CHECK(samples != NULL);
+	for (i = 0; i < BENCH_SAMPLES; i++) {
+		isc_random_get(&r);
+		dns_fixedname_init(&samples[i]);
+		benchname(r % count, dns_fixedname_name(&samples[i]));
+	}
+
+	TIME_NOW(&start);
+	for (i = 0; i < BENCH_LOOKUPS; i++) {
+		node = NULL;
+		result = dns_rbt_findnode(rbt,
+				dns_fixedname_name(&samples[i % BENCH_SAMPLES]),
+				NULL, &node, NULL, DNS_RBTFIND_EMPTYDATA,
+				NULL, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	TIME_NOW(&finish);
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("lookup: %8.1f ns per name\n",
+	       usecs * 1000.0 / BENCH_LOOKUPS);
+
+	free(samples);
+	dns_rbt_destroy(&rbt);
+}
+
 #define CMDCHECK(s)	(strncasecmp(command, (s), length) == 0)
 #define PRINTERR(r)	if (r != ISC_R_SUCCESS) \
 				printf("... %s\n", dns_result_totext(r));
@@ -262,6 +348,7 @@ main(int argc, char **argv) {
 	int length, ch;
 	isc_boolean_t show_final_mem = ISC_FALSE;
 	isc_result_t result;
+	unsigned int bench = 0;
 	void *data;
 
 	progname = strrchr(*argv, '/');
@@ -270,8 +357,11 @@ main(int argc, char **argv) {
 	else
 		progname = *argv;
 
-	while ((ch = isc_commandline_parse(argc, argv, "m")) != -1) {
+	while ((ch = isc_commandline_parse(argc, argv, "b:m")) != -1) {
 		switch (ch) {
+		case 'b':
+			bench = atoi(isc_commandline_argument);
+			break;
 		case 'm':
 			show_final_mem = ISC_TRUE;
 			break;
@@ -283,7 +373,7 @@ main(int argc, char **argv) {
 	POST(argv);
 
 	if (argc > 1) {
-		printf("Usage: %s [-m]\n", progname);
+		printf("Usage: %s [-m] [-b count]\n", progname);
 		exit(1);
 	}
 
@@ -292,7 +382,8 @@ main(int argc, char **argv) {
 	/*
 	 * So isc_mem_stats() can report any allocation leaks.
 	 */
-	isc_mem_debugging = ISC_MEM_DEBUGRECORD;
+	if (bench == 0)
+		isc_mem_debugging = ISC_MEM_DEBUGRECORD;
 
 	result = isc_mem_create(0, 0, &mctx);
 	if (result != ISC_R_SUCCESS) {
@@ -301,6 +392,24 @@ main(int argc, char **argv) {
 		exit(1);
 	}
 
+	/*
+	 * The tree hashes the names of its nodes.
+	 */
+	result = isc_hash_create(mctx, NULL, DNS_NAME_MAXWIRE);
+	if (result != ISC_R_SUCCESS) {
+		printf("isc_hash_create: %s: exiting\n",
+		       dns_result_totext(result));
+		exit(1);
+	}
+
+	if (bench != 0) {
+		benchmark(bench);
+		isc_hash_destroy();
+		if (show_final_mem)
+			isc_mem_stats(mctx, stderr);
+		return (0);
+	}
+
 	result = dns_rbt_create(mctx, delete_name, NULL, &rbt);
 	if (result != ISC_R_SUCCESS) {
 		printf("dns_rbt_create: %s: exiting\n",
@@ -449,6 +558,7 @@ main(int argc, char **argv) {
 	}
 
 	dns_rbt_destroy(&rbt);
+	isc_hash_destroy();
 
 	if (show_final_mem)
 		isc_mem_stats(mctx, stderr);
@@ -0,0 +1,276 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+/*
+ * Drive dns_rrl() from several threads with a simulated clock and
+ * report the response rate and how many responses were allowed.
+ * Every thread answers the same clients and names, so the token buckets
+ * are shared.  The same responses are first fed through a fresh limiter
+ * from a single thread in round-robin order, and the allowed count of
+ * the threaded run is compared with that reference.
+ */
+
+#include <config.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/result.h>
+#include <dns/rrl.h>
+#include <dns/view.h>
+
+typedef struct worker {
+	unsigned int	id;
+	unsigned int	ok;
+	unsigned int	slip;
+	unsigned int	drop;
+} worker_t;
+
+static isc_mem_t *mctx = NULL;
+static dns_view_t *view = NULL;
+static dns_fixedname_t *qnames = NULL;
+static unsigned int nclients = 256;
+static unsigned int nqnames = 8;
+static unsigned int responses = 500000;
+static unsigned int seconds = 10;
+static unsigned int rate = 5;
+static isc_stdtime_t start_time;
+
+/*
+ * Make the i'th response of a worker.  The workers step through the
+ * clients and names in different orders so that they collide on entries.
+ */
+static void
+respond(worker_t *w, unsigned int i) {
+	char log_buf[DNS_RRL_LOG_BUF_LEN];
+	struct in_addr ina;
+	isc_sockaddr_t client;
+	isc_stdtime_t now;
+	dns_rrl_result_t result;
+	unsigned int c, q;
+
+	c = (i * 7919 + w->id) % nclients;
+	q = (i / nclients + w->id) % nqnames;
+	ina.s_addr = htonl(0x0a000000 | c);
+	isc_sockaddr_fromin(&client, &ina, 53);
+	now = start_time + (isc_stdtime_t)
+		(((isc_uint64_t)i * seconds) / responses);
+
+	result = dns_rrl(view, &client, ISC_FALSE,
+			 dns_rdataclass_in, dns_rdatatype_a,
+			 dns_fixedname_name(&qnames[q]),
+			 ISC_R_SUCCESS, now, ISC_FALSE,
+			 log_buf, sizeof(log_buf));
+	switch (result) {
+	case DNS_RRL_RESULT_OK:
+		w->ok++;
+		break;
+	case DNS_RRL_RESULT_SLIP:
+		w->slip++;
+		break;
+	case DNS_RRL_RESULT_DROP:
+		w->drop++;
+		break;
+	}
+}
+
+static isc_threadresult_t
+#ifdef WIN32
+WINAPI
+#endif
+run(void *arg) {
+	worker_t *w = arg;
+	unsigned int i;
+
+	for (i = 0; i < responses; i++)
+		respond(w, i);
+
+	return ((isc_threadresult_t)0);
+}
+
+static void
+new_rrl(void) {
+	dns_rrl_t *rrl = NULL;
+	int i;
+
+	if (view->rrl != NULL)
+		dns_rrl_view_destroy(view);
+	RUNTIME_CHECK(dns_rrl_init(&rrl, view, nclients * nqnames) ==
+		      ISC_R_SUCCESS);
+	rrl->responses_per_second.r = rate;
+	rrl->responses_per_second.scaled = rate;
+	rrl->responses_per_second.str = "responses-per-second";
+	rrl->slip.r = 2;
+	rrl->slip.scaled = 2;
+	rrl->slip.str = "slip";
+	rrl->window = 15;
+	rrl->ipv4_prefixlen = 32;
+	rrl->ipv4_mask = 0xffffffff;
+	rrl->ipv6_prefixlen = 56;
+	for (i = 0; i < 4; i++)
+		rrl->ipv6_mask[i] = 0xffffffff;
+	rrl->max_entries = 0;
+}
+
+static void
+total(worker_t *workers, unsigned int n, unsigned int *ok,
+      unsigned int *slip, unsigned int *drop)
+{
+	unsigned int i;
+
+	*ok = *slip = *drop = 0;
+	for (i = 0; i < n; i++) {
+		*ok += workers[i].ok;
+		*slip += workers[i].slip;
+		*drop += workers[i].drop;
+	}
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: rrl_test [-t threads] [-n responses] "
+		"[-c clients] [-q names] [-r rate] [-s seconds]\n");
+	exit(1);
+}
+
+int
+main(int argc, char **argv) {
+	worker_t workers[64];
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[64];
+#endif
+	isc_time_t start, finish;
+	isc_uint64_t usecs;
+	isc_buffer_t source;
+	char text[sizeof("name4294967295.example.")];
+	unsigned int nthreads = 4, ok, slip, drop, ref_ok, ref_slip, ref_drop;
+	unsigned int i, j;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "c:n:q:r:s:t:")) != -1) {
+		switch (ch) {
+		case 'c':
+			nclients = atoi(isc_commandline_argument);
+			break;
+		case 'n':
+			responses = atoi(isc_commandline_argument);
+			break;
+		case 'q':
+			nqnames = atoi(isc_commandline_argument);
+			break;
+		case 'r':
+			rate = atoi(isc_commandline_argument);
+			break;
+		case 's':
+			seconds = atoi(isc_commandline_argument);
+			break;
+		case 't':
+			nthreads = atoi(isc_commandline_argument);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (argc > isc_commandline_index || nclients == 0 || nqnames == 0 ||
+	    responses == 0 || seconds == 0 || rate == 0 || nthreads == 0 ||
+	    nthreads > sizeof(workers)/sizeof(workers[0]))
+		usage();
+
+	dns_result_register();
+	RUNTIME_CHECK(isc_mem_create(0, 0, &mctx) == ISC_R_SUCCESS);
+	RUNTIME_CHECK(dns_view_create(mctx, dns_rdataclass_in, "rrl",
+				      &view) == ISC_R_SUCCESS);
+
+	qnames = isc_mem_get(mctx, nqnames * sizeof(*qnames));
+	RUNTIME_CHECK(qnames != NULL);
+	for (i = 0; i < nqnames; i++) {
+		snprintf(text, sizeof(text), "name%u.example.", i);
+		isc_buffer_constinit(&source, text, strlen(text));
+		isc_buffer_add(&source, strlen(text));
+		dns_fixedname_init(&qnames[i]);
+		RUNTIME_CHECK(dns_name_fromtext(dns_fixedname_name(&qnames[i]),
+						&source, dns_rootname, 0,
+						NULL) == ISC_R_SUCCESS);
+	}
+
+	isc_stdtime_get(&start_time);
+#ifndef ISC_PLATFORM_USETHREADS
+	nthreads = 1;
+#endif
+
+	/*
+	 * The reference run interleaves the workers' responses in one thread.
+	 */
+	new_rrl();
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < nthreads; i++)
+		workers[i].id = i;
+	for (j = 0; j < responses; j++)
+		for (i = 0; i < nthreads; i++)
+			respond(&workers[i], j);
+	total(workers, nthreads, &ref_ok, &ref_slip, &ref_drop);
+
+	new_rrl();
+	memset(workers, 0, sizeof(workers));
+	for (i = 0; i < nthreads; i++)
+		workers[i].id = i;
+	RUNTIME_CHECK(isc_time_now(&start) == ISC_R_SUCCESS);
+#ifdef ISC_PLATFORM_USETHREADS
+	for (i = 0; i < nthreads; i++)
+		RUNTIME_CHECK(isc_thread_create(run, &workers[i],
+						&threads[i]) == ISC_R_SUCCESS);
+	for (i = 0; i < nthreads; i++)
+		(void)isc_thread_join(threads[i], NULL);
+#else
+	(void)run(&workers[0]);
+#endif
+	RUNTIME_CHECK(isc_time_now(&finish) == ISC_R_SUCCESS);
+	total(workers, nthreads, &ok, &slip, &drop);
+
+	usecs = isc_time_microdiff(&finish, &start);
+	printf("%u threads, %u responses each: %.3f seconds, "
+	       "%.0f responses/second\n", nthreads, responses,
+	       (double)usecs / 1000000.0, (usecs == 0) ? 0.0 :
+	       (double)nthreads * responses * 1000000.0 / (double)usecs);
+	printf("%u clients, %u names, %u per second for %u seconds:\n",
+	       nclients, nqnames, rate, seconds);
+	printf("    threaded  %u ok, %u slip, %u drop\n", ok, slip, drop);
+	printf("    reference %u ok, %u slip, %u drop (ok %+.2f%%)\n",
+	       ref_ok, ref_slip, ref_drop, (ref_ok == 0) ? 0.0 :
+	       100.0 * ((double)ok - ref_ok) / ref_ok);
+
+	dns_rrl_view_destroy(view);
+	dns_view_detach(&view);
+	isc_mem_put(mctx, qnames, nqnames * sizeof(*qnames));
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
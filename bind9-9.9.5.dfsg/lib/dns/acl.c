@@ -439,6 +439,13 @@ dns_aclelement_match(const isc_netaddr_t *reqaddr,
 	return (ISC_FALSE);
 }
 
+isc_result_t
+dns_acl_compile(dns_acl_t *acl) {
+	REQUIRE(DNS_ACL_VALID(acl));
+
+	return (isc_radix_compile(acl->iptable->radix));
+}
+
 void
 dns_acl_attach(dns_acl_t *source, dns_acl_t **target) {
 	REQUIRE(DNS_ACL_VALID(source));
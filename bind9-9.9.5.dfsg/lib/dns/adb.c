@@ -30,6 +30,7 @@
 
 #include <limits.h>
 
+#include <isc/atomic.h>
 #include <isc/mutexblock.h>
 #include <isc/netaddr.h>
 #include <isc/random.h>
@@ -91,6 +92,39 @@
 
 #define DNS_ADB_MINADBSIZE      (1024U*1024U)     /*%< 1 Megabyte */
 
+/*%
+ * Names and entries are spread over a fixed number of shards, each with
+ * its own lock.  Within a shard they are found through a hash table
+ * that is grown under the shard lock alone, so the ADB never has to be
+ * stopped to resize.  A shard's table is doubled when it holds more than
+ * ADB_HASHLOAD objects per chain.
+ */
+#define ADB_NAMESHARDS          1021
+#define ADB_ENTRYSHARDS         1021
+#define ADB_INITIALHASH         2       /*%< must be a power of 2 */
+#define ADB_MAXHASH             (1U << 16)
+#define ADB_HASHLOAD            2
+
+/*%
+ * Memory pools, each with its own lock.
+ */
+#define ADB_MP_NAME             0
+#define ADB_MP_NAMEHOOK         1
+#define ADB_MP_LAMEINFO         2
+#define ADB_MP_ENTRY            3
+#define ADB_MP_FIND             4
+#define ADB_MP_ADDRINFO         5
+#define ADB_MP_FETCH            6
+#define ADB_MP_COUNT            7
+
+/*%
+ * With atomic operations available, the internal reference count is only
+ * locked when it may drop to zero.
+ */
+#if defined(ISC_PLATFORM_HAVEXADD) && defined(ISC_PLATFORM_HAVECMPXCHG)
+#define ADB_ATOMIC_IREFCNT      1
+#endif
+
 typedef ISC_LIST(dns_adbname_t) dns_adbnamelist_t;
 typedef struct dns_adbnamehook dns_adbnamehook_t;
 typedef ISC_LIST(dns_adbnamehook_t) dns_adbnamehooklist_t;
@@ -104,22 +138,22 @@ struct dns_adb {
 	unsigned int                    magic;
 
 	isc_mutex_t                     lock;
-	isc_mutex_t                     reflock; /*%< Covers irefcnt, erefcnt */
+	isc_mutex_t                     reflock; /*%< Covers erefcnt and
+						      the last irefcnt */
 	isc_mutex_t                     overmemlock; /*%< Covers overmem */
 	isc_mem_t                      *mctx;
 	dns_view_t                     *view;
 
 	isc_taskmgr_t                  *taskmgr;
 	isc_task_t                     *task;
-	isc_task_t                     *excl;
 
 	isc_interval_t                  tick_interval;
 	int                             next_cleanbucket;
 
-	unsigned int                    irefcnt;
+	isc_int32_t                     irefcnt;
 	unsigned int                    erefcnt;
 
-	isc_mutex_t                     mplock;
+	isc_mutex_t                     mplocks[ADB_MP_COUNT];
 	isc_mempool_t                  *nmp;    /*%< dns_adbname_t */
 	isc_mempool_t                  *nhmp;   /*%< dns_adbnamehook_t */
 	isc_mempool_t                  *limp;   /*%< dns_adblameinfo_t */
@@ -129,41 +163,40 @@ struct dns_adb {
 	isc_mempool_t                  *afmp;   /*%< dns_adbfetch_t */
 
 	/*!
-	 * Bucketized locks and lists for names.
+	 * Sharded locks and lists for names.  'names' is kept in LRU
+	 * order; 'namehash' is the shard's lookup table.
 	 *
 	 * XXXRTH  Have a per-bucket structure that contains all of these?
 	 */
 	unsigned int			nnames;
-	isc_mutex_t                     namescntlock;
-	unsigned int			namescnt;
 	dns_adbnamelist_t               *names;
 	dns_adbnamelist_t               *deadnames;
 	isc_mutex_t                     *namelocks;
 	isc_boolean_t                   *name_sd;
 	unsigned int                    *name_refcnt;
+	dns_adbnamelist_t               **namehash;
+	unsigned int                    *namehashsize;
+	dns_adbnamelist_t               *namehash0;
 
 	/*!
-	 * Bucketized locks and lists for entries.
+	 * Sharded locks and lists for entries, as for names.
 	 *
 	 * XXXRTH  Have a per-bucket structure that contains all of these?
 	 */
 	unsigned int			nentries;
-	isc_mutex_t                     entriescntlock;
-	unsigned int			entriescnt;
 	dns_adbentrylist_t              *entries;
 	dns_adbentrylist_t              *deadentries;
 	isc_mutex_t                     *entrylocks;
 	isc_boolean_t                   *entry_sd; /*%< shutting down */
 	unsigned int                    *entry_refcnt;
+	dns_adbentrylist_t              **entryhash;
+	unsigned int                    *entryhashsize;
+	dns_adbentrylist_t              *entryhash0;
 
 	isc_event_t                     cevent;
 	isc_boolean_t                   cevent_sent;
 	isc_boolean_t                   shutting_down;
 	isc_eventlist_t                 whenshutdown;
-	isc_event_t			growentries;
-	isc_boolean_t			growentries_sent;
-	isc_event_t			grownames;
-	isc_boolean_t			grownames_sent;
 };
 
 /*
@@ -192,8 +225,10 @@ struct dns_adbname {
 	dns_adbfindlist_t               finds;
 	/* for LRU-based management */
 	isc_stdtime_t                   last_used;
+	unsigned int                    hashval;
 
 	ISC_LINK(dns_adbname_t)         plink;
+	ISC_LINK(dns_adbname_t)         hlink;
 };
 
 /*% The adbfetch structure */
@@ -254,8 +289,9 @@ struct dns_adbentry {
 	 */
 
 	ISC_LIST(dns_adblameinfo_t)     lameinfo;
+	unsigned int                    hashval;
 	ISC_LINK(dns_adbentry_t)        plink;
-
+	ISC_LINK(dns_adbentry_t)        hlink;
 };
 
 /*
@@ -390,6 +426,18 @@ static void dump_entry(FILE *, dns_adbentry_t *, isc_boolean_t, isc_stdtime_t);
 
 #define EXPIRE_OK(exp, now)     ((exp == INT_MAX) || (exp < now))
 
+/*
+ * A hash value selects a shard by its remainder and a chain within the
+ * shard's table by its quotient.
+ */
+#define SHARDHASH(n, h)         ((h) / (n))
+#define NAMECHAIN(adb, b, h) \
+	((adb)->namehash[b][SHARDHASH((adb)->nnames, h) & \
+			    ((adb)->namehashsize[b] - 1)])
+#define ENTRYCHAIN(adb, b, h) \
+	((adb)->entryhash[b][SHARDHASH((adb)->nentries, h) & \
+			     ((adb)->entryhashsize[b] - 1)])
+
 /*
  * Find out if the flags on a name (nf) indicate if it is a hint or
  * glue, and compare this to the appropriate bits set in o, to see if
@@ -485,328 +533,6 @@ ttlclamp(dns_ttl_t ttl) {
 	return (ttl);
 }
 
-/*
- * Hashing is most efficient if the number of buckets is prime.
- * The sequence below is the closest previous primes to 2^n and
- * 1.5 * 2^n, for values of n from 10 to 28.  (The tables will
- * no longer grow beyond 2^28 entries.)
- */
-static const unsigned nbuckets[] = { 1021, 1531, 2039, 3067, 4093, 6143,
-				     8191, 12281, 16381, 24571, 32749,
-				     49193, 65521, 98299, 131071, 199603,
-				     262139, 393209, 524287, 768431, 1048573,
-				     1572853, 2097143, 3145721, 4194301,
-				     6291449, 8388593, 12582893, 16777213,
-				     25165813, 33554393, 50331599, 67108859,
-				     100663291, 134217689, 201326557,
-				     268535431, 0 };
-
-static void
-grow_entries(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbentry_t *e;
-	dns_adbentrylist_t *newdeadentries = NULL;
-	dns_adbentrylist_t *newentries = NULL;
-	isc_boolean_t *newentry_sd = NULL;
-	isc_mutex_t *newentrylocks = NULL;
-	isc_result_t result;
-	unsigned int *newentry_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nentries >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_entries to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nentries; i++)
-		if (adb->entry_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newentries = isc_mem_get(adb->mctx, sizeof(*newentries) * n);
-	newdeadentries = isc_mem_get(adb->mctx, sizeof(*newdeadentries) * n);
-	newentrylocks = isc_mem_get(adb->mctx, sizeof(*newentrylocks) * n);
-	newentry_sd = isc_mem_get(adb->mctx, sizeof(*newentry_sd) * n);
-	newentry_refcnt = isc_mem_get(adb->mctx, sizeof(*newentry_refcnt) * n);
-	if (newentries == NULL || newdeadentries == NULL ||
-	    newentrylocks == NULL || newentry_sd == NULL ||
-	    newentry_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newentrylocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newentries[i]);
-		ISC_LIST_INIT(newdeadentries[i]);
-		newentry_sd[i] = ISC_FALSE;
-		newentry_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
-
-	/*
-	 * Move entries to new arrays.
-	 */
-	for (i = 0; i < adb->nentries; i++) {
-		e = ISC_LIST_HEAD(adb->entries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->entries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->entries[i]);
-		}
-		e = ISC_LIST_HEAD(adb->deadentries[i]);
-		while (e != NULL) {
-			ISC_LIST_UNLINK(adb->deadentries[i], e, plink);
-			bucket = isc_sockaddr_hash(&e->sockaddr, ISC_TRUE) % n;
-			e->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadentries[bucket], e, plink);
-			INSIST(adb->entry_refcnt[i] > 0);
-			adb->entry_refcnt[i]--;
-			newentry_refcnt[bucket]++;
-			e = ISC_LIST_HEAD(adb->deadentries[i]);
-		}
-		INSIST(adb->entry_refcnt[i] == 0);
-		adb->irefcnt--;
-	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->entries = newentries;
-	adb->deadentries = newdeadentries;
-	adb->entrylocks = newentrylocks;
-	adb->entry_sd = newentry_sd;
-	adb->entry_refcnt = newentry_refcnt;
-	adb->nentries = n;
-
-	/*
-	 * Only on success do we set adb->growentries_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->growentries_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newentries != NULL)
-		isc_mem_put(adb->mctx, newentries,
-			    sizeof(*newentries) * n);
-	if (newdeadentries != NULL)
-		isc_mem_put(adb->mctx, newdeadentries,
-			    sizeof(*newdeadentries) * n);
-	if (newentrylocks != NULL)
-		isc_mem_put(adb->mctx, newentrylocks,
-			    sizeof(*newentrylocks) * n);
-	if (newentry_sd != NULL)
-		isc_mem_put(adb->mctx, newentry_sd,
-			    sizeof(*newentry_sd) * n);
-	if (newentry_refcnt != NULL)
-		isc_mem_put(adb->mctx, newentry_refcnt,
-			     sizeof(*newentry_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_entries finished");
-}
-
-static void
-grow_names(isc_task_t *task, isc_event_t *ev) {
-	dns_adb_t *adb;
-	dns_adbname_t *name;
-	dns_adbnamelist_t *newdeadnames = NULL;
-	dns_adbnamelist_t *newnames = NULL;
-	isc_boolean_t *newname_sd = NULL;
-	isc_mutex_t *newnamelocks = NULL;
-	isc_result_t result;
-	unsigned int *newname_refcnt = NULL;
-	unsigned int i, n, bucket;
-
-	adb = ev->ev_arg;
-	INSIST(DNS_ADB_VALID(adb));
-
-	isc_event_free(&ev);
-
-	result = isc_task_beginexclusive(task);
-	if (result != ISC_R_SUCCESS)
-		goto check_exit;
-
-	i = 0;
-	while (nbuckets[i] != 0 && adb->nnames >= nbuckets[i])
-		i++;
-	if (nbuckets[i] != 0)
-		n = nbuckets[i];
-	else
-		goto done;
-
-	DP(ISC_LOG_INFO, "adb: grow_names to %u starting", n);
-
-	/*
-	 * Are we shutting down?
-	 */
-	for (i = 0; i < adb->nnames; i++)
-		if (adb->name_sd[i])
-			goto cleanup;
-
-	/*
-	 * Grab all the resources we need.
-	 */
-	newnames = isc_mem_get(adb->mctx, sizeof(*newnames) * n);
-	newdeadnames = isc_mem_get(adb->mctx, sizeof(*newdeadnames) * n);
-	newnamelocks = isc_mem_get(adb->mctx, sizeof(*newnamelocks) * n);
-	newname_sd = isc_mem_get(adb->mctx, sizeof(*newname_sd) * n);
-	newname_refcnt = isc_mem_get(adb->mctx, sizeof(*newname_refcnt) * n);
-	if (newnames == NULL || newdeadnames == NULL ||
-	    newnamelocks == NULL || newname_sd == NULL ||
-	    newname_refcnt == NULL)
-		goto cleanup;
-
-	/*
-	 * Initialise the new resources.
-	 */
-	result = isc_mutexblock_init(newnamelocks, n);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
-
-	for (i = 0; i < n; i++) {
-		ISC_LIST_INIT(newnames[i]);
-		ISC_LIST_INIT(newdeadnames[i]);
-		newname_sd[i] = ISC_FALSE;
-		newname_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
-
-	/*
-	 * Move names to new arrays.
-	 */
-	for (i = 0; i < adb->nnames; i++) {
-		name = ISC_LIST_HEAD(adb->names[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->names[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->names[i]);
-		}
-		name = ISC_LIST_HEAD(adb->deadnames[i]);
-		while (name != NULL) {
-			ISC_LIST_UNLINK(adb->deadnames[i], name, plink);
-			bucket = dns_name_fullhash(&name->name, ISC_TRUE) % n;
-			name->lock_bucket = bucket;
-			ISC_LIST_APPEND(newdeadnames[bucket], name, plink);
-			INSIST(adb->name_refcnt[i] > 0);
-			adb->name_refcnt[i]--;
-			newname_refcnt[bucket]++;
-			name = ISC_LIST_HEAD(adb->deadnames[i]);
-		}
-		INSIST(adb->name_refcnt[i] == 0);
-		adb->irefcnt--;
-	}
-
-	/*
-	 * Cleanup old resources.
-	 */
-	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
-
-	/*
-	 * Install new resources.
-	 */
-	adb->names = newnames;
-	adb->deadnames = newdeadnames;
-	adb->namelocks = newnamelocks;
-	adb->name_sd = newname_sd;
-	adb->name_refcnt = newname_refcnt;
-	adb->nnames = n;
-
-	/*
-	 * Only on success do we set adb->grownames_sent to ISC_FALSE.
-	 * This will prevent us being continuously being called on error.
-	 */
-	adb->grownames_sent = ISC_FALSE;
-	goto done;
-
- cleanup:
-	if (newnames != NULL)
-		isc_mem_put(adb->mctx, newnames, sizeof(*newnames) * n);
-	if (newdeadnames != NULL)
-		isc_mem_put(adb->mctx, newdeadnames, sizeof(*newdeadnames) * n);
-	if (newnamelocks != NULL)
-		isc_mem_put(adb->mctx, newnamelocks, sizeof(*newnamelocks) * n);
-	if (newname_sd != NULL)
-		isc_mem_put(adb->mctx, newname_sd, sizeof(*newname_sd) * n);
-	if (newname_refcnt != NULL)
-		isc_mem_put(adb->mctx, newname_refcnt,
-			     sizeof(*newname_refcnt) * n);
- done:
-	isc_task_endexclusive(task);
-
- check_exit:
-	LOCK(&adb->lock);
-	if (dec_adb_irefcnt(adb))
-		check_exit(adb);
-	UNLOCK(&adb->lock);
-	DP(ISC_LOG_INFO, "adb: grow_names finished");
-}
-
 /*
  * Requires the adbname bucket be locked and that no entry buckets be locked.
  *
@@ -1003,6 +729,8 @@ kill_name(dns_adbname_t **n, isc_eventtype_t ev) {
 		if (!NAME_DEAD(name)) {
 			bucket = name->lock_bucket;
 			ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+			ISC_LIST_UNLINK(NAMECHAIN(adb, bucket, name->hashval),
+					name, hlink);
 			ISC_LIST_APPEND(adb->deadnames[bucket], name, plink);
 			name->flags |= NAME_IS_DEAD;
 		}
@@ -1059,6 +787,39 @@ check_expire_namehooks(dns_adbname_t *name, isc_stdtime_t now) {
 	return (ISC_TF(result4 || result6));
 }
 
+/*
+ * Grow the hash table of name shard 'bucket', which must be locked.
+ * On failure the old table is kept; it only gets slower.
+ */
+static void
+grow_namehash(dns_adb_t *adb, int bucket) {
+	dns_adbnamelist_t *old, *new;
+	dns_adbname_t *name;
+	unsigned int i, size, newsize;
+
+	size = adb->namehashsize[bucket];
+	newsize = size * 2;
+	new = isc_mem_get(adb->mctx, sizeof(*new) * newsize);
+	if (new == NULL)
+		return;
+	for (i = 0; i < newsize; i++)
+		ISC_LIST_INIT(new[i]);
+
+	old = adb->namehash[bucket];
+	for (i = 0; i < size; i++) {
+		while ((name = ISC_LIST_HEAD(old[i])) != NULL) {
+			ISC_LIST_UNLINK(old[i], name, hlink);
+			ISC_LIST_APPEND(new[SHARDHASH(adb->nnames, name->hashval)
+					    & (newsize - 1)],
+					name, hlink);
+		}
+	}
+	if (size > ADB_INITIALHASH)
+		isc_mem_put(adb->mctx, old, sizeof(*old) * size);
+	adb->namehash[bucket] = new;
+	adb->namehashsize[bucket] = newsize;
+}
+
 /*
  * Requires the name's bucket be locked.
  */
@@ -1069,6 +830,11 @@ link_name(dns_adb_t *adb, int bucket, dns_adbname_t *name) {
 	ISC_LIST_PREPEND(adb->names[bucket], name, plink);
 	name->lock_bucket = bucket;
 	adb->name_refcnt[bucket]++;
+	if (adb->name_refcnt[bucket] >
+	    adb->namehashsize[bucket] * ADB_HASHLOAD &&
+	    adb->namehashsize[bucket] < ADB_MAXHASH)
+		grow_namehash(adb, bucket);
+	ISC_LIST_PREPEND(NAMECHAIN(adb, bucket, name->hashval), name, hlink);
 }
 
 /*
@@ -1084,8 +850,11 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 
 	if (NAME_DEAD(name))
 		ISC_LIST_UNLINK(adb->deadnames[bucket], name, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->names[bucket], name, plink);
+		ISC_LIST_UNLINK(NAMECHAIN(adb, bucket, name->hashval),
+				name, hlink);
+	}
 	name->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->name_refcnt[bucket] > 0);
 	adb->name_refcnt[bucket]--;
@@ -1094,6 +863,51 @@ unlink_name(dns_adb_t *adb, dns_adbname_t *name) {
 	return (result);
 }
 
+/*
+ * Grow the hash table of entry shard 'bucket', which must be locked.
+ */
+static void
+grow_entryhash(dns_adb_t *adb, int bucket) {
+	dns_adbentrylist_t *old, *new;
+	dns_adbentry_t *e;
+	unsigned int i, size, newsize;
+
+	size = adb->entryhashsize[bucket];
+	newsize = size * 2;
+	new = isc_mem_get(adb->mctx, sizeof(*new) * newsize);
+	if (new == NULL)
+		return;
+	for (i = 0; i < newsize; i++)
+		ISC_LIST_INIT(new[i]);
+
+	old = adb->entryhash[bucket];
+	for (i = 0; i < size; i++) {
+		while ((e = ISC_LIST_HEAD(old[i])) != NULL) {
+			ISC_LIST_UNLINK(old[i], e, hlink);
+			ISC_LIST_APPEND(new[SHARDHASH(adb->nentries, e->hashval)
+					    & (newsize - 1)],
+					e, hlink);
+		}
+	}
+	if (size > ADB_INITIALHASH)
+		isc_mem_put(adb->mctx, old, sizeof(*old) * size);
+	adb->entryhash[bucket] = new;
+	adb->entryhashsize[bucket] = newsize;
+}
+
+/*
+ * Requires the entry's bucket be locked.  Moves 'entry' to the dead
+ * list, where it can no longer be found.
+ */
+static inline void
+kill_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
+	INSIST((entry->flags & ENTRY_IS_DEAD) == 0);
+	entry->flags |= ENTRY_IS_DEAD;
+	ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+	ISC_LIST_UNLINK(ENTRYCHAIN(adb, bucket, entry->hashval), entry, hlink);
+	ISC_LIST_PREPEND(adb->deadentries[bucket], entry, plink);
+}
+
 /*
  * Requires the entry's bucket be locked.
  */
@@ -1112,16 +926,20 @@ link_entry(dns_adb_t *adb, int bucket, dns_adbentry_t *entry) {
 				free_adbentry(adb, &e);
 				continue;
 			}
-			INSIST((e->flags & ENTRY_IS_DEAD) == 0);
-			e->flags |= ENTRY_IS_DEAD;
-			ISC_LIST_UNLINK(adb->entries[bucket], e, plink);
-			ISC_LIST_PREPEND(adb->deadentries[bucket], e, plink);
+			kill_entry(adb, bucket, e);
 		}
 	}
 
+	entry->hashval = isc_sockaddr_hash(&entry->sockaddr, ISC_TRUE);
 	ISC_LIST_PREPEND(adb->entries[bucket], entry, plink);
 	entry->lock_bucket = bucket;
 	adb->entry_refcnt[bucket]++;
+	if (adb->entry_refcnt[bucket] >
+	    adb->entryhashsize[bucket] * ADB_HASHLOAD &&
+	    adb->entryhashsize[bucket] < ADB_MAXHASH)
+		grow_entryhash(adb, bucket);
+	ISC_LIST_PREPEND(ENTRYCHAIN(adb, bucket, entry->hashval), entry,
+			 hlink);
 }
 
 /*
@@ -1137,8 +955,11 @@ unlink_entry(dns_adb_t *adb, dns_adbentry_t *entry) {
 
 	if ((entry->flags & ENTRY_IS_DEAD) != 0)
 		ISC_LIST_UNLINK(adb->deadentries[bucket], entry, plink);
-	else
+	else {
 		ISC_LIST_UNLINK(adb->entries[bucket], entry, plink);
+		ISC_LIST_UNLINK(ENTRYCHAIN(adb, bucket, entry->hashval),
+				entry, hlink);
+	}
 	entry->lock_bucket = DNS_ADB_INVALIDBUCKET;
 	INSIST(adb->entry_refcnt[bucket] > 0);
 	adb->entry_refcnt[bucket]--;
@@ -1509,14 +1330,34 @@ static inline isc_boolean_t
 dec_adb_irefcnt(dns_adb_t *adb) {
 	isc_event_t *event;
 	isc_task_t *etask;
-	isc_boolean_t result = ISC_FALSE;
+	isc_boolean_t zero, result = ISC_FALSE;
+#ifdef ADB_ATOMIC_IREFCNT
+	isc_int32_t refs;
+
+	/*
+	 * Drop a reference that is not the last one without locking.
+	 * The last one is only ever dropped with 'reflock' held, so the
+	 * checks below cannot race with dns_adb_detach() or
+	 * dns_adb_whenshutdown().
+	 */
+	for (refs = adb->irefcnt; refs > 1; refs = adb->irefcnt)
+		if (isc_atomic_cmpxchg(&adb->irefcnt, refs, refs - 1) == refs)
+			return (ISC_FALSE);
+#endif
 
 	LOCK(&adb->reflock);
 
+#ifdef ADB_ATOMIC_IREFCNT
+	refs = isc_atomic_xadd(&adb->irefcnt, -1);
+	INSIST(refs > 0);
+	zero = ISC_TF(refs == 1);
+#else
 	INSIST(adb->irefcnt > 0);
 	adb->irefcnt--;
+	zero = ISC_TF(adb->irefcnt == 0);
+#endif
 
-	if (adb->irefcnt == 0) {
+	if (zero) {
 		event = ISC_LIST_HEAD(adb->whenshutdown);
 		while (event != NULL) {
 			ISC_LIST_UNLINK(adb->whenshutdown, event, ev_link);
@@ -1527,7 +1368,7 @@ dec_adb_irefcnt(dns_adb_t *adb) {
 		}
 	}
 
-	if (adb->irefcnt == 0 && adb->erefcnt == 0)
+	if (zero && adb->erefcnt == 0)
 		result = ISC_TRUE;
 	UNLOCK(&adb->reflock);
 	return (result);
@@ -1535,9 +1376,13 @@ dec_adb_irefcnt(dns_adb_t *adb) {
 
 static inline void
 inc_adb_irefcnt(dns_adb_t *adb) {
+#ifdef ADB_ATOMIC_IREFCNT
+	(void)isc_atomic_xadd(&adb->irefcnt, 1);
+#else
 	LOCK(&adb->reflock);
 	adb->irefcnt++;
 	UNLOCK(&adb->reflock);
+#endif
 }
 
 static inline void
@@ -1631,19 +1476,9 @@ new_adbname(dns_adb_t *adb, dns_name_t *dnsname) {
 	name->fetch_err = FIND_ERR_UNEXPECTED;
 	name->fetch6_err = FIND_ERR_UNEXPECTED;
 	ISC_LIST_INIT(name->finds);
+	name->hashval = dns_name_fullhash(&name->name, ISC_FALSE);
 	ISC_LINK_INIT(name, plink);
-
-	LOCK(&adb->namescntlock);
-	adb->namescnt++;
-	if (!adb->grownames_sent && adb->excl != NULL &&
-	    adb->namescnt > (adb->nnames * 8))
-	{
-		isc_event_t *event = &adb->grownames;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->excl, &event);
-		adb->grownames_sent = ISC_TRUE;
-	}
-	UNLOCK(&adb->namescntlock);
+	ISC_LINK_INIT(name, hlink);
 
 	return (name);
 }
@@ -1661,6 +1496,7 @@ free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	INSIST(!NAME_FETCH(n));
 	INSIST(ISC_LIST_EMPTY(n->finds));
 	INSIST(!ISC_LINK_LINKED(n, plink));
+	INSIST(!ISC_LINK_LINKED(n, hlink));
 	INSIST(n->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(n->adb == adb);
 
@@ -1668,9 +1504,6 @@ free_adbname(dns_adb_t *adb, dns_adbname_t **name) {
 	dns_name_free(&n->name, adb->mctx);
 
 	isc_mempool_put(adb->nmp, n);
-	LOCK(&adb->namescntlock);
-	adb->namescnt--;
-	UNLOCK(&adb->namescntlock);
 }
 
 static inline dns_adbnamehook_t *
@@ -1757,19 +1590,10 @@ new_adbentry(dns_adb_t *adb) {
 	isc_random_get(&r);
 	e->srtt = (r & 0x1f) + 1;
 	e->expires = 0;
+	e->hashval = 0;
 	ISC_LIST_INIT(e->lameinfo);
 	ISC_LINK_INIT(e, plink);
-	LOCK(&adb->entriescntlock);
-	adb->entriescnt++;
-	if (!adb->growentries_sent && adb->growentries_sent &&
-	    adb->entriescnt > (adb->nentries * 8))
-	{
-		isc_event_t *event = &adb->growentries;
-		inc_adb_irefcnt(adb);
-		isc_task_send(adb->task, &event);
-		adb->growentries_sent = ISC_TRUE;
-	}
-	UNLOCK(&adb->entriescntlock);
+	ISC_LINK_INIT(e, hlink);
 
 	return (e);
 }
@@ -1786,6 +1610,7 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	INSIST(e->lock_bucket == DNS_ADB_INVALIDBUCKET);
 	INSIST(e->refcnt == 0);
 	INSIST(!ISC_LINK_LINKED(e, plink));
+	INSIST(!ISC_LINK_LINKED(e, hlink));
 
 	e->magic = 0;
 
@@ -1797,9 +1622,6 @@ free_adbentry(dns_adb_t *adb, dns_adbentry_t **entry) {
 	}
 
 	isc_mempool_put(adb->emp, e);
-	LOCK(&adb->entriescntlock);
-	adb->entriescnt--;
-	UNLOCK(&adb->entriescntlock);
 }
 
 static inline dns_adbfind_t *
@@ -1951,9 +1773,11 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		   unsigned int options, int *bucketp)
 {
 	dns_adbname_t *adbname;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = dns_name_fullhash(name, ISC_FALSE) % adb->nnames;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucket = hashval % adb->nnames;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->namelocks[bucket]);
@@ -1964,15 +1788,15 @@ find_name_and_lock(dns_adb_t *adb, dns_name_t *name,
 		*bucketp = bucket;
 	}
 
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	adbname = ISC_LIST_HEAD(NAMECHAIN(adb, bucket, hashval));
 	while (adbname != NULL) {
-		if (!NAME_DEAD(adbname)) {
-			if (dns_name_equal(name, &adbname->name)
-			    && GLUEHINT_OK(adbname, options)
-			    && STARTATZONE_MATCHES(adbname, options))
-				return (adbname);
-		}
-		adbname = ISC_LIST_NEXT(adbname, plink);
+		INSIST(!NAME_DEAD(adbname));
+		if (adbname->hashval == hashval &&
+		    dns_name_equal(name, &adbname->name)
+		    && GLUEHINT_OK(adbname, options)
+		    && STARTATZONE_MATCHES(adbname, options))
+			return (adbname);
+		adbname = ISC_LIST_NEXT(adbname, hlink);
 	}
 
 	return (NULL);
@@ -1993,9 +1817,11 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 	isc_stdtime_t now)
 {
 	dns_adbentry_t *entry, *entry_next;
+	unsigned int hashval;
 	int bucket;
 
-	bucket = isc_sockaddr_hash(addr, ISC_TRUE) % adb->nentries;
+	hashval = isc_sockaddr_hash(addr, ISC_TRUE);
+	bucket = hashval % adb->nentries;
 
 	if (*bucketp == DNS_ADB_INVALIDBUCKET) {
 		LOCK(&adb->entrylocks[bucket]);
@@ -2006,11 +1832,19 @@ find_entry_and_lock(dns_adb_t *adb, isc_sockaddr_t *addr, int *bucketp,
 		*bucketp = bucket;
 	}
 
-	/* Search the list, while cleaning up expired entries. */
-	for (entry = ISC_LIST_HEAD(adb->entries[bucket]);
+	/*
+	 * The least recently used entry of the shard is checked for
+	 * expiry on every lookup, as are the entries on the chain.
+	 */
+	entry = ISC_LIST_TAIL(adb->entries[bucket]);
+	if (entry != NULL)
+		(void)check_expire_entry(adb, &entry, now);
+
+	/* Search the chain, while cleaning up expired entries. */
+	for (entry = ISC_LIST_HEAD(ENTRYCHAIN(adb, bucket, hashval));
 	     entry != NULL;
 	     entry = entry_next) {
-		entry_next = ISC_LIST_NEXT(entry, plink);
+		entry_next = ISC_LIST_NEXT(entry, hlink);
 		(void)check_expire_entry(adb, &entry, now);
 		if (entry != NULL &&
 		    isc_sockaddr_equal(addr, &entry->sockaddr)) {
@@ -2335,13 +2169,65 @@ cleanup_entries(dns_adb_t *adb, int bucket, isc_stdtime_t now) {
 	return (result);
 }
 
+/*
+ * Free the shard arrays and hash tables; used on destruction and when
+ * dns_adb_create() fails part way through.
+ */
+static void
+free_shards(dns_adb_t *adb) {
+	unsigned int i;
+
+	if (adb->namehash0 != NULL) {
+		for (i = 0; i < adb->nnames; i++)
+			if (adb->namehashsize[i] > ADB_INITIALHASH)
+				isc_mem_put(adb->mctx, adb->namehash[i],
+					    sizeof(*adb->namehash[i]) *
+					    adb->namehashsize[i]);
+		isc_mem_put(adb->mctx, adb->namehash0,
+			    sizeof(*adb->namehash0) * adb->nnames *
+			    ADB_INITIALHASH);
+	}
+	if (adb->entryhash0 != NULL) {
+		for (i = 0; i < adb->nentries; i++)
+			if (adb->entryhashsize[i] > ADB_INITIALHASH)
+				isc_mem_put(adb->mctx, adb->entryhash[i],
+					    sizeof(*adb->entryhash[i]) *
+					    adb->entryhashsize[i]);
+		isc_mem_put(adb->mctx, adb->entryhash0,
+			    sizeof(*adb->entryhash0) * adb->nentries *
+			    ADB_INITIALHASH);
+	}
+
+#define FREESHARDS(el, n) \
+	do { \
+		if (adb->el != NULL) \
+			isc_mem_put(adb->mctx, adb->el, \
+				    sizeof(*adb->el) * (n)); \
+	} while (0)
+	FREESHARDS(entries, adb->nentries);
+	FREESHARDS(deadentries, adb->nentries);
+	FREESHARDS(entrylocks, adb->nentries);
+	FREESHARDS(entry_sd, adb->nentries);
+	FREESHARDS(entry_refcnt, adb->nentries);
+	FREESHARDS(entryhash, adb->nentries);
+	FREESHARDS(entryhashsize, adb->nentries);
+	FREESHARDS(names, adb->nnames);
+	FREESHARDS(deadnames, adb->nnames);
+	FREESHARDS(namelocks, adb->nnames);
+	FREESHARDS(name_sd, adb->nnames);
+	FREESHARDS(name_refcnt, adb->nnames);
+	FREESHARDS(namehash, adb->nnames);
+	FREESHARDS(namehashsize, adb->nnames);
+#undef FREESHARDS
+}
+
 static void
 destroy(dns_adb_t *adb) {
+	unsigned int i;
+
 	adb->magic = 0;
 
 	isc_task_detach(&adb->task);
-	if (adb->excl != NULL)
-		isc_task_detach(&adb->excl);
 
 	isc_mempool_destroy(&adb->nmp);
 	isc_mempool_destroy(&adb->nhmp);
@@ -2352,35 +2238,14 @@ destroy(dns_adb_t *adb) {
 	isc_mempool_destroy(&adb->afmp);
 
 	DESTROYMUTEXBLOCK(adb->entrylocks, adb->nentries);
-	isc_mem_put(adb->mctx, adb->entries,
-		    sizeof(*adb->entries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->deadentries,
-		    sizeof(*adb->deadentries) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entrylocks,
-		    sizeof(*adb->entrylocks) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_sd,
-		    sizeof(*adb->entry_sd) * adb->nentries);
-	isc_mem_put(adb->mctx, adb->entry_refcnt,
-		    sizeof(*adb->entry_refcnt) * adb->nentries);
-
 	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
-	isc_mem_put(adb->mctx, adb->names,
-		    sizeof(*adb->names) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->deadnames,
-		    sizeof(*adb->deadnames) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->namelocks,
-		    sizeof(*adb->namelocks) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_sd,
-		    sizeof(*adb->name_sd) * adb->nnames);
-	isc_mem_put(adb->mctx, adb->name_refcnt,
-		    sizeof(*adb->name_refcnt) * adb->nnames);
+	free_shards(adb);
 
 	DESTROYLOCK(&adb->reflock);
 	DESTROYLOCK(&adb->lock);
-	DESTROYLOCK(&adb->mplock);
+	for (i = 0; i < ADB_MP_COUNT; i++)
+		DESTROYLOCK(&adb->mplocks[i]);
 	DESTROYLOCK(&adb->overmemlock);
-	DESTROYLOCK(&adb->entriescntlock);
-	DESTROYLOCK(&adb->namescntlock);
 
 	isc_mem_putanddetach(&adb->mctx, adb, sizeof(dns_adb_t));
 }
@@ -2396,7 +2261,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 {
 	dns_adb_t *adb;
 	isc_result_t result;
-	unsigned int i;
+	unsigned int i, j;
 
 	REQUIRE(mem != NULL);
 	REQUIRE(view != NULL);
@@ -2425,7 +2290,6 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->aimp = NULL;
 	adb->afmp = NULL;
 	adb->task = NULL;
-	adb->excl = NULL;
 	adb->mctx = NULL;
 	adb->view = view;
 	adb->taskmgr = taskmgr;
@@ -2437,39 +2301,25 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	adb->shutting_down = ISC_FALSE;
 	ISC_LIST_INIT(adb->whenshutdown);
 
-	adb->nentries = nbuckets[0];
-	adb->entriescnt = 0;
+	adb->nentries = ADB_ENTRYSHARDS;
 	adb->entries = NULL;
 	adb->deadentries = NULL;
 	adb->entry_sd = NULL;
 	adb->entry_refcnt = NULL;
 	adb->entrylocks = NULL;
-	ISC_EVENT_INIT(&adb->growentries, sizeof(adb->growentries), 0, NULL,
-		       DNS_EVENT_ADBGROWENTRIES, grow_entries, adb,
-		       adb, NULL, NULL);
-	adb->growentries_sent = ISC_FALSE;
+	adb->entryhash = NULL;
+	adb->entryhashsize = NULL;
+	adb->entryhash0 = NULL;
 
-	adb->nnames = nbuckets[0];
-	adb->namescnt = 0;
+	adb->nnames = ADB_NAMESHARDS;
 	adb->names = NULL;
 	adb->deadnames = NULL;
 	adb->name_sd = NULL;
 	adb->name_refcnt = NULL;
 	adb->namelocks = NULL;
-	ISC_EVENT_INIT(&adb->grownames, sizeof(adb->grownames), 0, NULL,
-		       DNS_EVENT_ADBGROWNAMES, grow_names, adb,
-		       adb, NULL, NULL);
-	adb->grownames_sent = ISC_FALSE;
-
-	result = isc_taskmgr_excltask(adb->taskmgr, &adb->excl);
-	if (result != ISC_R_SUCCESS) {
-		DP(ISC_LOG_INFO, "adb: task-exclusive mode unavailable, "
-				 "intializing table sizes to %u\n",
-				 nbuckets[11]);
-		adb->nentries = nbuckets[11];
-		adb->nnames= nbuckets[11];
-
-	}
+	adb->namehash = NULL;
+	adb->namehashsize = NULL;
+	adb->namehash0 = NULL;
 
 	isc_mem_attach(mem, &adb->mctx);
 
@@ -2477,7 +2327,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (result != ISC_R_SUCCESS)
 		goto fail0b;
 
-	result = isc_mutex_init(&adb->mplock);
+	result = isc_mutexblock_init(adb->mplocks, ADB_MP_COUNT);
 	if (result != ISC_R_SUCCESS)
 		goto fail0c;
 
@@ -2489,67 +2339,77 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (result != ISC_R_SUCCESS)
 		goto fail0e;
 
-	result = isc_mutex_init(&adb->entriescntlock);
-	if (result != ISC_R_SUCCESS)
-		goto fail0f;
-
-	result = isc_mutex_init(&adb->namescntlock);
-	if (result != ISC_R_SUCCESS)
-		goto fail0g;
-
-#define ALLOCENTRY(adb, el) \
+#define ALLOCENTRY(adb, el, n) \
 	do { \
 		(adb)->el = isc_mem_get((adb)->mctx, \
-				     sizeof(*(adb)->el) * (adb)->nentries); \
+				     sizeof(*(adb)->el) * (n)); \
 		if ((adb)->el == NULL) { \
 			result = ISC_R_NOMEMORY; \
 			goto fail1; \
 		}\
 	} while (0)
-	ALLOCENTRY(adb, entries);
-	ALLOCENTRY(adb, deadentries);
-	ALLOCENTRY(adb, entrylocks);
-	ALLOCENTRY(adb, entry_sd);
-	ALLOCENTRY(adb, entry_refcnt);
+	ALLOCENTRY(adb, entries, adb->nentries);
+	ALLOCENTRY(adb, deadentries, adb->nentries);
+	ALLOCENTRY(adb, entrylocks, adb->nentries);
+	ALLOCENTRY(adb, entry_sd, adb->nentries);
+	ALLOCENTRY(adb, entry_refcnt, adb->nentries);
+	ALLOCENTRY(adb, entryhash, adb->nentries);
+	ALLOCENTRY(adb, entryhashsize, adb->nentries);
+	ALLOCENTRY(adb, entryhash0, adb->nentries * ADB_INITIALHASH);
 #undef ALLOCENTRY
 
-#define ALLOCNAME(adb, el) \
+	/*
+	 * Initialize the entry shards here, before anything else can
+	 * fail, so that free_shards() always sees sized hash tables.
+	 */
+	for (i = 0; i < adb->nentries; i++) {
+		ISC_LIST_INIT(adb->entries[i]);
+		ISC_LIST_INIT(adb->deadentries[i]);
+		adb->entry_sd[i] = ISC_FALSE;
+		adb->entry_refcnt[i] = 0;
+		adb->entryhash[i] = &adb->entryhash0[i * ADB_INITIALHASH];
+		adb->entryhashsize[i] = ADB_INITIALHASH;
+		for (j = 0; j < ADB_INITIALHASH; j++)
+			ISC_LIST_INIT(adb->entryhash[i][j]);
+		adb->irefcnt++;
+	}
+
+#define ALLOCNAME(adb, el, n) \
 	do { \
 		(adb)->el = isc_mem_get((adb)->mctx, \
-				     sizeof(*(adb)->el) * (adb)->nnames); \
+				     sizeof(*(adb)->el) * (n)); \
 		if ((adb)->el == NULL) { \
 			result = ISC_R_NOMEMORY; \
 			goto fail1; \
 		}\
 	} while (0)
-	ALLOCNAME(adb, names);
-	ALLOCNAME(adb, deadnames);
-	ALLOCNAME(adb, namelocks);
-	ALLOCNAME(adb, name_sd);
-	ALLOCNAME(adb, name_refcnt);
+	ALLOCNAME(adb, names, adb->nnames);
+	ALLOCNAME(adb, deadnames, adb->nnames);
+	ALLOCNAME(adb, namelocks, adb->nnames);
+	ALLOCNAME(adb, name_sd, adb->nnames);
+	ALLOCNAME(adb, name_refcnt, adb->nnames);
+	ALLOCNAME(adb, namehash, adb->nnames);
+	ALLOCNAME(adb, namehashsize, adb->nnames);
+	ALLOCNAME(adb, namehash0, adb->nnames * ADB_INITIALHASH);
 #undef ALLOCNAME
 
 	/*
-	 * Initialize the bucket locks for names and elements.
-	 * May as well initialize the list heads, too.
+	 * Initialize the name shards.  The locks are initialized below.
 	 */
-	result = isc_mutexblock_init(adb->namelocks, adb->nnames);
-	if (result != ISC_R_SUCCESS)
-		goto fail1;
 	for (i = 0; i < adb->nnames; i++) {
 		ISC_LIST_INIT(adb->names[i]);
 		ISC_LIST_INIT(adb->deadnames[i]);
 		adb->name_sd[i] = ISC_FALSE;
 		adb->name_refcnt[i] = 0;
+		adb->namehash[i] = &adb->namehash0[i * ADB_INITIALHASH];
+		adb->namehashsize[i] = ADB_INITIALHASH;
+		for (j = 0; j < ADB_INITIALHASH; j++)
+			ISC_LIST_INIT(adb->namehash[i][j]);
 		adb->irefcnt++;
 	}
-	for (i = 0; i < adb->nentries; i++) {
-		ISC_LIST_INIT(adb->entries[i]);
-		ISC_LIST_INIT(adb->deadentries[i]);
-		adb->entry_sd[i] = ISC_FALSE;
-		adb->entry_refcnt[i] = 0;
-		adb->irefcnt++;
-	}
+	result = isc_mutexblock_init(adb->namelocks, adb->nnames);
+	if (result != ISC_R_SUCCESS)
+		goto fail1;
 	result = isc_mutexblock_init(adb->entrylocks, adb->nentries);
 	if (result != ISC_R_SUCCESS)
 		goto fail2;
@@ -2557,23 +2417,23 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	/*
 	 * Memory pools
 	 */
-#define MPINIT(t, p, n) do { \
+#define MPINIT(t, p, n, l) do { \
 	result = isc_mempool_create(mem, sizeof(t), &(p)); \
 	if (result != ISC_R_SUCCESS) \
 		goto fail3; \
 	isc_mempool_setfreemax((p), FREE_ITEMS); \
 	isc_mempool_setfillcount((p), FILL_COUNT); \
 	isc_mempool_setname((p), n); \
-	isc_mempool_associatelock((p), &adb->mplock); \
+	isc_mempool_associatelock((p), &adb->mplocks[l]); \
 } while (0)
 
-	MPINIT(dns_adbname_t, adb->nmp, "adbname");
-	MPINIT(dns_adbnamehook_t, adb->nhmp, "adbnamehook");
-	MPINIT(dns_adblameinfo_t, adb->limp, "adblameinfo");
-	MPINIT(dns_adbentry_t, adb->emp, "adbentry");
-	MPINIT(dns_adbfind_t, adb->ahmp, "adbfind");
-	MPINIT(dns_adbaddrinfo_t, adb->aimp, "adbaddrinfo");
-	MPINIT(dns_adbfetch_t, adb->afmp, "adbfetch");
+	MPINIT(dns_adbname_t, adb->nmp, "adbname", ADB_MP_NAME);
+	MPINIT(dns_adbnamehook_t, adb->nhmp, "adbnamehook", ADB_MP_NAMEHOOK);
+	MPINIT(dns_adblameinfo_t, adb->limp, "adblameinfo", ADB_MP_LAMEINFO);
+	MPINIT(dns_adbentry_t, adb->emp, "adbentry", ADB_MP_ENTRY);
+	MPINIT(dns_adbfind_t, adb->ahmp, "adbfind", ADB_MP_FIND);
+	MPINIT(dns_adbaddrinfo_t, adb->aimp, "adbaddrinfo", ADB_MP_ADDRINFO);
+	MPINIT(dns_adbfetch_t, adb->afmp, "adbfetch", ADB_MP_FETCH);
 
 #undef MPINIT
 
@@ -2604,36 +2464,7 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	DESTROYMUTEXBLOCK(adb->namelocks, adb->nnames);
 
  fail1: /* clean up only allocated memory */
-	if (adb->entries != NULL)
-		isc_mem_put(adb->mctx, adb->entries,
-			    sizeof(*adb->entries) * adb->nentries);
-	if (adb->deadentries != NULL)
-		isc_mem_put(adb->mctx, adb->deadentries,
-			    sizeof(*adb->deadentries) * adb->nentries);
-	if (adb->entrylocks != NULL)
-		isc_mem_put(adb->mctx, adb->entrylocks,
-			    sizeof(*adb->entrylocks) * adb->nentries);
-	if (adb->entry_sd != NULL)
-		isc_mem_put(adb->mctx, adb->entry_sd,
-			    sizeof(*adb->entry_sd) * adb->nentries);
-	if (adb->entry_refcnt != NULL)
-		isc_mem_put(adb->mctx, adb->entry_refcnt,
-			    sizeof(*adb->entry_refcnt) * adb->nentries);
-	if (adb->names != NULL)
-		isc_mem_put(adb->mctx, adb->names,
-			    sizeof(*adb->names) * adb->nnames);
-	if (adb->deadnames != NULL)
-		isc_mem_put(adb->mctx, adb->deadnames,
-			    sizeof(*adb->deadnames) * adb->nnames);
-	if (adb->namelocks != NULL)
-		isc_mem_put(adb->mctx, adb->namelocks,
-			    sizeof(*adb->namelocks) * adb->nnames);
-	if (adb->name_sd != NULL)
-		isc_mem_put(adb->mctx, adb->name_sd,
-			    sizeof(*adb->name_sd) * adb->nnames);
-	if (adb->name_refcnt != NULL)
-		isc_mem_put(adb->mctx, adb->name_refcnt,
-			    sizeof(*adb->name_refcnt) * adb->nnames);
+	free_shards(adb);
 	if (adb->nmp != NULL)
 		isc_mempool_destroy(&adb->nmp);
 	if (adb->nhmp != NULL)
@@ -2649,15 +2480,11 @@ dns_adb_create(isc_mem_t *mem, dns_view_t *view, isc_timermgr_t *timermgr,
 	if (adb->afmp != NULL)
 		isc_mempool_destroy(&adb->afmp);
 
-	DESTROYLOCK(&adb->namescntlock);
- fail0g:
-	DESTROYLOCK(&adb->entriescntlock);
- fail0f:
 	DESTROYLOCK(&adb->overmemlock);
  fail0e:
 	DESTROYLOCK(&adb->reflock);
  fail0d:
-	DESTROYLOCK(&adb->mplock);
+	DESTROYMUTEXBLOCK(adb->mplocks, ADB_MP_COUNT);
  fail0c:
 	DESTROYLOCK(&adb->lock);
  fail0b:
@@ -3151,16 +2978,16 @@ dns_adb_destroyfind(dns_adbfind_t **findp) {
 	}
 
 	/*
-	 * WARNING:  The find is freed with the adb locked.  This is done
-	 * to avoid a race condition where we free the find, some other
-	 * thread tests to see if it should be destroyed, detects it should
-	 * be, destroys it, and then we try to lock it for our check, but the
-	 * lock is destroyed.
+	 * The adb lock is only needed if this was the last reference.
+	 * free_adbfind() reports that to exactly one caller, since the
+	 * final internal reference is only dropped under 'reflock', and
+	 * nothing can release the adb before we send the control event.
 	 */
-	LOCK(&adb->lock);
-	if (free_adbfind(adb, &find))
+	if (free_adbfind(adb, &find)) {
+		LOCK(&adb->lock);
 		check_exit(adb);
-	UNLOCK(&adb->lock);
+		UNLOCK(&adb->lock);
+	}
 }
 
 void
@@ -3263,7 +3090,7 @@ dump_adb(dns_adb_t *adb, FILE *f, isc_boolean_t debug, isc_stdtime_t now) {
 
 	fprintf(f, ";\n; Address database dump\n;\n");
 	if (debug)
-		fprintf(f, "; addr %p, erefcnt %u, irefcnt %u, finds out %u\n",
+		fprintf(f, "; addr %p, erefcnt %u, irefcnt %d, finds out %u\n",
 			adb, adb->erefcnt, adb->irefcnt,
 			isc_mempool_getallocated(adb->nhmp));
 
@@ -4088,17 +3915,19 @@ void
 dns_adb_flushname(dns_adb_t *adb, dns_name_t *name) {
 	dns_adbname_t *adbname;
 	dns_adbname_t *nextname;
+	unsigned int hashval;
 	int bucket;
 
 	INSIST(DNS_ADB_VALID(adb));
 
 	LOCK(&adb->lock);
-	bucket = dns_name_hash(name, ISC_FALSE) % adb->nnames;
+	hashval = dns_name_fullhash(name, ISC_FALSE);
+	bucket = hashval % adb->nnames;
 	LOCK(&adb->namelocks[bucket]);
-	adbname = ISC_LIST_HEAD(adb->names[bucket]);
+	adbname = ISC_LIST_HEAD(NAMECHAIN(adb, bucket, hashval));
 	while (adbname != NULL) {
-		nextname = ISC_LIST_NEXT(adbname, plink);
-		if (!NAME_DEAD(adbname) &&
+		nextname = ISC_LIST_NEXT(adbname, hlink);
+		if (adbname->hashval == hashval &&
 		    dns_name_equal(name, &adbname->name)) {
 			RUNTIME_CHECK(kill_name(&adbname,
 						DNS_EVENT_ADBCANCELED) ==
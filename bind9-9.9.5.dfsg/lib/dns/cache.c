@@ -21,7 +21,10 @@
 
 #include <config.h>
 
+#include <isc/buffer.h>
+#include <isc/file.h>
 #include <isc/mem.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
 #include <isc/time.h>
@@ -29,13 +32,16 @@
 #include <isc/util.h>
 
 #include <dns/cache.h>
+#include <dns/compress.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
+#include <dns/fixedname.h>
 #include <dns/lib.h>
 #include <dns/log.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
 #include <dns/result.h>
@@ -58,6 +64,39 @@
  */
 #define DNS_CACHE_CLEANERINCREMENT	1000U	/*%< Number of nodes. */
 
+/*!
+ * The binary cache snapshot written when the cache file format is
+ * dns_masterformat_raw.  All integers are in network byte order.
+ *
+ * The file starts with a header:
+ *
+ *	magic (4), version (4), dump time (4), class (2), reserved (2)
+ *
+ * followed by one record per rdataset:
+ *
+ *	length of the rest of the record (4)
+ *	owner name length (1), owner name in uncompressed wire format
+ *	type (2), covers (2), expire time (4), trust (1), attributes (1)
+ *	number of rdatas (2), then for each: length (2), rdata
+ *
+ * The expire time is absolute, so nothing that expired while the server
+ * was down is loaded.  Negative cache entries are stored as the
+ * database holds them.  The format is private to the cache.
+ */
+#define CACHE_SNAPSHOT_MAGIC		0x424e4443U	/* "BNDC" */
+#define CACHE_SNAPSHOT_VERSION		1
+#define CACHE_SNAPSHOT_HEADERLEN	16
+#define CACHE_SNAPSHOT_RECORDLEN	(4 + 1 + DNS_NAME_MAXWIRE + 12)
+/*%
+ * The longest record, less its length field: an rdataset's rdata must
+ * have fitted in a message, so it is under 64k.
+ */
+#define CACHE_SNAPSHOT_MAXRECORD	(1 + DNS_NAME_MAXWIRE + 12 + 65535)
+
+#define CACHE_SNAPSHOT_NEGATIVE		0x01
+#define CACHE_SNAPSHOT_NXDOMAIN		0x02
+#define CACHE_SNAPSHOT_OPTOUT		0x04
+
 /***
  ***	Types
  ***/
@@ -137,9 +176,11 @@ struct dns_cache {
 	int			db_argc;
 	char			**db_argv;
 	size_t			size;
+	dns_ttl_t		serve_stale_ttl;
 
 	/* Locked by 'filelock'. */
 	char			*filename;
+	dns_masterformat_t	fileformat;
 	/* Access to the on-disk cache file is also locked by 'filelock'. */
 };
 
@@ -236,6 +277,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	cache->references = 1;
 	cache->live_tasks = 0;
 	cache->rdclass = rdclass;
+	cache->serve_stale_ttl = 0;
 
 	cache->db_type = isc_mem_strdup(cmctx, db_type);
 	if (cache->db_type == NULL) {
@@ -293,6 +335,7 @@ dns_cache_create3(isc_mem_t *cmctx, isc_mem_t *hmctx, isc_taskmgr_t *taskmgr,
 	}
 
 	cache->filename = NULL;
+	cache->fileformat = dns_masterformat_text;
 
 	cache->magic = CACHE_MAGIC;
 
@@ -487,7 +530,416 @@ dns_cache_setfilename(dns_cache_t *cache, const char *filename) {
 	return (ISC_R_SUCCESS);
 }
 
+void
+dns_cache_setfileformat(dns_cache_t *cache, dns_masterformat_t format) {
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(format == dns_masterformat_text ||
+		format == dns_masterformat_raw);
+
+	LOCK(&cache->filelock);
+	cache->fileformat = format;
+	UNLOCK(&cache->filelock);
+}
+
 #ifdef BIND9
+static isc_result_t
+snapshot_write(FILE *f, isc_buffer_t *buffer) {
+	isc_region_t r;
+
+	isc_buffer_usedregion(buffer, &r);
+	return (isc_stdio_write(r.base, 1, r.length, f, NULL));
+}
+
+static isc_result_t
+snapshot_rdataset(dns_name_t *name, dns_rdataset_t *rdataset,
+		  isc_stdtime_t now, FILE *f)
+{
+	unsigned char data[CACHE_SNAPSHOT_RECORDLEN];
+	isc_buffer_t buffer;
+	isc_region_t r;
+	isc_result_t result;
+	isc_uint32_t totallen;
+	unsigned int attributes = 0;
+
+	/*
+	 * Proofs attached to wildcard answers are not saved, so neither
+	 * are the answers.
+	 */
+	if ((rdataset->attributes &
+	     (DNS_RDATASETATTR_NOQNAME | DNS_RDATASETATTR_CLOSEST)) != 0)
+		return (ISC_R_SUCCESS);
+
+	if ((rdataset->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
+		attributes |= CACHE_SNAPSHOT_NEGATIVE;
+	if ((rdataset->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
+		attributes |= CACHE_SNAPSHOT_NXDOMAIN;
+	if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0)
+		attributes |= CACHE_SNAPSHOT_OPTOUT;
+
+	dns_name_toregion(name, &r);
+	totallen = 1 + r.length + 12;
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		totallen += 2 + rdata.length;
+	}
+	if (result != ISC_R_NOMORE)
+		return (result);
+	if (totallen > CACHE_SNAPSHOT_MAXRECORD)
+		return (ISC_R_SUCCESS);
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	isc_buffer_putuint32(&buffer, totallen);
+	isc_buffer_putuint8(&buffer, (isc_uint8_t)r.length);
+	isc_buffer_copyregion(&buffer, &r);
+	isc_buffer_putuint16(&buffer, rdataset->type);
+	isc_buffer_putuint16(&buffer, rdataset->covers);
+	isc_buffer_putuint32(&buffer, now + rdataset->ttl);
+	isc_buffer_putuint8(&buffer, (isc_uint8_t)rdataset->trust);
+	isc_buffer_putuint8(&buffer, (isc_uint8_t)attributes);
+	isc_buffer_putuint16(&buffer,
+			     (isc_uint16_t)dns_rdataset_count(rdataset));
+	result = snapshot_write(f, &buffer);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	for (result = dns_rdataset_first(rdataset);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset)) {
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		unsigned char len[2];
+
+		dns_rdataset_current(rdataset, &rdata);
+		isc_buffer_init(&buffer, len, sizeof(len));
+		isc_buffer_putuint16(&buffer, (isc_uint16_t)rdata.length);
+		result = snapshot_write(f, &buffer);
+		if (result == ISC_R_SUCCESS && rdata.length != 0)
+			result = isc_stdio_write(rdata.data, 1, rdata.length,
+						 f, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+	if (result == ISC_R_NOMORE)
+		result = ISC_R_SUCCESS;
+	return (result);
+}
+
+/*
+ * Write every active rdataset in the cache to 'f'.
+ */
+static isc_result_t
+snapshot_dump(dns_cache_t *cache, FILE *f) {
+	dns_dbiterator_t *dbiter = NULL;
+	dns_rdatasetiter_t *rdsiter;
+	dns_dbnode_t *node;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	isc_buffer_t buffer;
+	isc_result_t result;
+	isc_stdtime_t now;
+	unsigned char header[CACHE_SNAPSHOT_HEADERLEN];
+
+	isc_stdtime_get(&now);
+
+	isc_buffer_init(&buffer, header, sizeof(header));
+	isc_buffer_putuint32(&buffer, CACHE_SNAPSHOT_MAGIC);
+	isc_buffer_putuint32(&buffer, CACHE_SNAPSHOT_VERSION);
+	isc_buffer_putuint32(&buffer, now);
+	isc_buffer_putuint16(&buffer, cache->rdclass);
+	isc_buffer_putuint16(&buffer, 0);
+	result = snapshot_write(f, &buffer);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = dns_db_createiterator(cache->db, 0, &dbiter);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	for (result = dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter)) {
+		node = NULL;
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS)
+			break;
+		(void)dns_dbiterator_pause(dbiter);
+
+		rdsiter = NULL;
+		result = dns_db_allrdatasets(cache->db, node, NULL, now,
+					     &rdsiter);
+		if (result != ISC_R_SUCCESS) {
+			dns_db_detachnode(cache->db, &node);
+			break;
+		}
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter)) {
+			dns_rdataset_init(&rdataset);
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			result = snapshot_rdataset(name, &rdataset, now, f);
+			dns_rdataset_disassociate(&rdataset);
+			if (result != ISC_R_SUCCESS)
+				break;
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(cache->db, &node);
+		if (result != ISC_R_NOMORE)
+			break;
+	}
+	if (result == ISC_R_NOMORE)
+		result = ISC_R_SUCCESS;
+
+	dns_dbiterator_destroy(&dbiter);
+	return (result);
+}
+
+static isc_result_t
+snapshot_save(dns_cache_t *cache, const char *filename) {
+	FILE *f = NULL;
+	char *tempname;
+	size_t tempnamelen;
+	isc_result_t result;
+
+	tempnamelen = strlen(filename) + 20;
+	tempname = isc_mem_allocate(cache->mctx, tempnamelen);
+	if (tempname == NULL)
+		return (ISC_R_NOMEMORY);
+
+	result = isc_file_mktemplate(filename, tempname, tempnamelen);
+	if (result == ISC_R_SUCCESS)
+		result = isc_file_bopenunique(tempname, &f);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_free(cache->mctx, tempname);
+		return (result);
+	}
+
+	result = snapshot_dump(cache, f);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_flush(f);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_sync(f);
+	if (isc_stdio_close(f) != ISC_R_SUCCESS && result == ISC_R_SUCCESS)
+		result = ISC_R_UNEXPECTED;
+	if (result == ISC_R_SUCCESS)
+		result = isc_file_rename(tempname, filename);
+	if (result != ISC_R_SUCCESS)
+		(void)isc_file_remove(tempname);
+
+	isc_mem_free(cache->mctx, tempname);
+	return (result);
+}
+
+/*
+ * Add the rdataset described by the snapshot record in 'source' to the
+ * cache, unless it has expired.
+ */
+static isc_result_t
+snapshot_addrecord(dns_cache_t *cache, isc_buffer_t *source,
+		   isc_stdtime_t now, isc_boolean_t *addedp)
+{
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdatas[64], *rdata = rdatas;
+	dns_dbnode_t *node = NULL;
+	dns_decompress_t dctx;
+	isc_uint32_t expire;
+	unsigned int namelen, count, trust, attributes, i;
+	isc_result_t result;
+
+	*addedp = ISC_FALSE;
+
+	namelen = isc_buffer_getuint8(source);
+	if (isc_buffer_remaininglength(source) < namelen + 12)
+		return (ISC_R_RANGE);
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_NONE);
+	isc_buffer_setactive(source, namelen);
+	result = dns_name_fromwire(name, source, &dctx, 0, NULL);
+	dns_decompress_invalidate(&dctx);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = cache->rdclass;
+	rdatalist.type = isc_buffer_getuint16(source);
+	rdatalist.covers = isc_buffer_getuint16(source);
+	expire = isc_buffer_getuint32(source);
+	trust = isc_buffer_getuint8(source);
+	attributes = isc_buffer_getuint8(source);
+	count = isc_buffer_getuint16(source);
+	if (count == 0)
+		return (ISC_R_RANGE);
+	if (expire <= now)
+		return (ISC_R_SUCCESS);
+	rdatalist.ttl = expire - now;
+
+	if (count > sizeof(rdatas) / sizeof(rdatas[0])) {
+		rdata = isc_mem_get(cache->mctx, count * sizeof(*rdata));
+		if (rdata == NULL)
+			return (ISC_R_NOMEMORY);
+	}
+	for (i = 0; i < count; i++) {
+		isc_region_t r;
+
+		dns_rdata_init(&rdata[i]);
+		if (isc_buffer_remaininglength(source) < 2) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		r.length = isc_buffer_getuint16(source);
+		if (isc_buffer_remaininglength(source) < r.length) {
+			result = ISC_R_RANGE;
+			goto cleanup;
+		}
+		r.base = isc_buffer_current(source);
+		isc_buffer_forward(source, r.length);
+		dns_rdata_fromregion(&rdata[i], rdatalist.rdclass,
+				     rdatalist.type, &r);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+	if (isc_buffer_remaininglength(source) != 0) {
+		result = ISC_R_RANGE;
+		goto cleanup;
+	}
+
+	dns_rdataset_init(&rdataset);
+	RUNTIME_CHECK(dns_rdatalist_tordataset(&rdatalist, &rdataset) ==
+		      ISC_R_SUCCESS);
+	rdataset.trust = trust;
+	if ((attributes & CACHE_SNAPSHOT_NEGATIVE) != 0)
+		rdataset.attributes |= DNS_RDATASETATTR_NEGATIVE;
+	if ((attributes & CACHE_SNAPSHOT_NXDOMAIN) != 0)
+		rdataset.attributes |= DNS_RDATASETATTR_NXDOMAIN;
+	if ((attributes & CACHE_SNAPSHOT_OPTOUT) != 0)
+		rdataset.attributes |= DNS_RDATASETATTR_OPTOUT;
+
+	result = dns_db_findnode(cache->db, name, ISC_TRUE, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_addrdataset(cache->db, node, NULL, now,
+					    &rdataset, 0, NULL);
+		dns_db_detachnode(cache->db, &node);
+		if (result == DNS_R_UNCHANGED)
+			result = ISC_R_SUCCESS;
+		else if (result == ISC_R_SUCCESS)
+			*addedp = ISC_TRUE;
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+ cleanup:
+	if (rdata != rdatas)
+		isc_mem_put(cache->mctx, rdata, count * sizeof(*rdata));
+	return (result);
+}
+
+static isc_result_t
+snapshot_load(dns_cache_t *cache, const char *filename) {
+	FILE *f = NULL;
+	unsigned char header[CACHE_SNAPSHOT_HEADERLEN];
+	unsigned char *data = NULL;
+	unsigned int datalen = 0, added = 0;
+	isc_boolean_t wasadded;
+	isc_buffer_t buffer;
+	isc_uint32_t totallen;
+	isc_stdtime_t now;
+	isc_result_t result;
+	size_t n;
+
+	/*
+	 * There is no snapshot before the first shutdown.
+	 */
+	result = isc_stdio_open(filename, "rb", &f);
+	if (result == ISC_R_FILENOTFOUND)
+		return (ISC_R_SUCCESS);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	result = isc_stdio_read(header, 1, sizeof(header), f, NULL);
+	if (result == ISC_R_EOF)
+		result = ISC_R_UNEXPECTEDEND;
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	isc_buffer_init(&buffer, header, sizeof(header));
+	isc_buffer_add(&buffer, sizeof(header));
+	if (isc_buffer_getuint32(&buffer) != CACHE_SNAPSHOT_MAGIC ||
+	    isc_buffer_getuint32(&buffer) != CACHE_SNAPSHOT_VERSION) {
+		result = DNS_R_FORMERR;
+		goto cleanup;
+	}
+	(void)isc_buffer_getuint32(&buffer);	/* dump time */
+	if (isc_buffer_getuint16(&buffer) != cache->rdclass) {
+		result = DNS_R_BADCLASS;
+		goto cleanup;
+	}
+
+	isc_stdtime_get(&now);
+	for (;;) {
+		/*
+		 * Only a clean end of file between records ends the
+		 * snapshot; a partial length or record means it was cut.
+		 */
+		result = isc_stdio_read(header, 1, 4, f, &n);
+		if (result == ISC_R_EOF) {
+			result = (n == 0) ? ISC_R_SUCCESS
+					  : ISC_R_UNEXPECTEDEND;
+			break;
+		}
+		if (result != ISC_R_SUCCESS)
+			break;
+		isc_buffer_init(&buffer, header, 4);
+		isc_buffer_add(&buffer, 4);
+		totallen = isc_buffer_getuint32(&buffer);
+		if (totallen < 1 + 12 || totallen > CACHE_SNAPSHOT_MAXRECORD) {
+			result = ISC_R_RANGE;
+			break;
+		}
+
+		if (totallen > datalen) {
+			if (data != NULL)
+				isc_mem_put(cache->mctx, data, datalen);
+			datalen = ISC_MAX(totallen, 65536);
+			data = isc_mem_get(cache->mctx, datalen);
+			if (data == NULL) {
+				datalen = 0;
+				result = ISC_R_NOMEMORY;
+				break;
+			}
+		}
+		result = isc_stdio_read(data, 1, totallen, f, NULL);
+		if (result == ISC_R_EOF)
+			result = ISC_R_UNEXPECTEDEND;
+		if (result != ISC_R_SUCCESS)
+			break;
+		isc_buffer_init(&buffer, data, totallen);
+		isc_buffer_add(&buffer, totallen);
+		result = snapshot_addrecord(cache, &buffer, now, &wasadded);
+		if (result != ISC_R_SUCCESS)
+			break;
+		if (wasadded)
+			added++;
+	}
+
+	if (result == ISC_R_SUCCESS)
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_INFO,
+			      "loaded %u rdatasets from cache file '%s'",
+			      added, filename);
+
+ cleanup:
+	if (data != NULL)
+		isc_mem_put(cache->mctx, data, datalen);
+	(void)isc_stdio_close(f);
+	return (result);
+}
+
 isc_result_t
 dns_cache_load(dns_cache_t *cache) {
 	isc_result_t result;
@@ -498,7 +950,10 @@ dns_cache_load(dns_cache_t *cache) {
 		return (ISC_R_SUCCESS);
 
 	LOCK(&cache->filelock);
-	result = dns_db_load(cache->db, cache->filename);
+	if (cache->fileformat == dns_masterformat_raw)
+		result = snapshot_load(cache, cache->filename);
+	else
+		result = dns_db_load(cache->db, cache->filename);
 	UNLOCK(&cache->filelock);
 
 	return (result);
@@ -518,8 +973,12 @@ dns_cache_dump(dns_cache_t *cache) {
 
 #ifdef BIND9
 	LOCK(&cache->filelock);
-	result = dns_master_dump(cache->mctx, cache->db, NULL,
-				 &dns_master_style_cache, cache->filename);
+	if (cache->fileformat == dns_masterformat_raw)
+		result = snapshot_save(cache, cache->filename);
+	else
+		result = dns_master_dump(cache->mctx, cache->db, NULL,
+					 &dns_master_style_cache,
+					 cache->filename);
 	UNLOCK(&cache->filelock);
 	return (result);
 #else
@@ -1080,6 +1539,17 @@ dns_cache_getcachesize(dns_cache_t *cache) {
 	return (size);
 }
 
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl) {
+	REQUIRE(VALID_CACHE(cache));
+
+	LOCK(&cache->lock);
+	cache->serve_stale_ttl = ttl;
+	UNLOCK(&cache->lock);
+
+	(void)dns_db_setservestalettl(cache->db, ttl);
+}
+
 /*
  * The cleaner task is shutting down; do the necessary cleanup.
  */
@@ -1146,6 +1616,7 @@ dns_cache_flush(dns_cache_t *cache) {
 	}
 	dns_db_detach(&cache->db);
 	cache->db = db;
+	(void)dns_db_setservestalettl(cache->db, cache->serve_stale_ttl);
 	UNLOCK(&cache->cleaner.lock);
 	UNLOCK(&cache->lock);
 
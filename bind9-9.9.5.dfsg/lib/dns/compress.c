@@ -44,15 +44,19 @@
 
 isc_result_t
 dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
-	unsigned int i;
-
 	REQUIRE(cctx != NULL);
 	REQUIRE(mctx != NULL);	/* See: rdataset.c:towiresorted(). */
 
 	cctx->allowed = 0;
 	cctx->edns = edns;
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++)
-		cctx->table[i] = NULL;
+	cctx->nodes = cctx->initialnodes;
+	cctx->nodesize = DNS_COMPRESS_INITIALNODES;
+	cctx->table = cctx->initialtable;
+	cctx->tablesize = DNS_COMPRESS_INITIALSLOTS;
+	memset(cctx->initialtable, 0, sizeof(cctx->initialtable));
+	cctx->lastname = NULL;
+	cctx->lastlabels = 0;
+	cctx->lastnode = 0;
 	cctx->mctx = mctx;
 	cctx->count = 0;
 	cctx->magic = CCTX_MAGIC;
@@ -61,21 +65,18 @@ dns_compress_init(dns_compress_t *cctx, int edns, isc_mem_t *mctx) {
 
 void
 dns_compress_invalidate(dns_compress_t *cctx) {
-	dns_compressnode_t *node;
-	unsigned int i;
-
 	REQUIRE(VALID_CCTX(cctx));
 
 	cctx->magic = 0;
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		while (cctx->table[i] != NULL) {
-			node = cctx->table[i];
-			cctx->table[i] = cctx->table[i]->next;
-			if (node->count < DNS_COMPRESS_INITIALNODES)
-				continue;
-			isc_mem_put(cctx->mctx, node, sizeof(*node));
-		}
-	}
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->nodesize * sizeof(*cctx->nodes));
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*cctx->table));
+	cctx->nodes = NULL;
+	cctx->table = NULL;
+	cctx->count = 0;
 	cctx->allowed = 0;
 	cctx->edns = -1;
 }
@@ -117,13 +118,139 @@ dns_compress_getedns(dns_compress_t *cctx) {
 	return (cctx->edns);
 }
 
-#define NODENAME(node, name) \
-do { \
-	(name)->length = (node)->r.length; \
-	(name)->labels = (node)->labels; \
-	(name)->ndata = (node)->r.base; \
-	(name)->attributes = DNS_NAMEATTR_ABSOLUTE; \
-} while (0)
+/*
+ * Compression table.
+ *
+ * A node stands for one label of an added name; its parent is the node
+ * for the label to its right, and the top level labels have the root
+ * (0) as parent.  A suffix of a name is therefore found by walking its
+ * labels from the right, looking up (parent, label) in the hash table
+ * at each step.  The table holds node indices plus one, 0 marking an
+ * empty slot, and collisions are resolved by linear probing.
+ *
+ * Nodes whose suffix starts beyond the reach of a compression pointer
+ * are still added so that the trie below them stays connected, but
+ * are never returned as a match.
+ */
+
+#define MAXOFFSET	0x3fff
+
+static inline unsigned char
+tolower_label(unsigned char c) {
+	if (c >= 'A' && c <= 'Z')
+		return (c + ('a' - 'A'));
+	return (c);
+}
+
+static inline isc_uint32_t
+label_hash(unsigned int parent, const unsigned char *label) {
+	isc_uint32_t h;
+	unsigned int i, length;
+
+	/*
+	 * FNV-1a over the case folded label, seeded by the parent node.
+	 */
+	h = 2166136261U ^ (parent * 2654435761U);
+	length = label[0] + 1;
+	for (i = 0; i < length; i++) {
+		h ^= tolower_label(label[i]);
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static inline isc_boolean_t
+label_equal(const unsigned char *a, const unsigned char *b,
+	    isc_boolean_t sensitive)
+{
+	unsigned int i, length;
+
+	if (a[0] != b[0])
+		return (ISC_FALSE);
+	length = a[0] + 1;
+	if (sensitive)
+		return (ISC_TF(memcmp(a, b, length) == 0));
+	for (i = 1; i < length; i++)
+		if (tolower_label(a[i]) != tolower_label(b[i]))
+			return (ISC_FALSE);
+	return (ISC_TRUE);
+}
+
+/*
+ * Return the node for 'label' below 'parent', plus one, or 0.
+ */
+static inline unsigned int
+find_node(dns_compress_t *cctx, unsigned int parent, isc_uint32_t hash,
+	  const unsigned char *label, isc_boolean_t sensitive)
+{
+	dns_compressnode_t *node;
+	unsigned int mask, slot, idx;
+
+	mask = cctx->tablesize - 1;
+	for (slot = hash & mask; (idx = cctx->table[slot]) != 0;
+	     slot = (slot + 1) & mask)
+	{
+		node = &cctx->nodes[idx - 1];
+		if (node->hash == hash && node->parent == parent &&
+		    label_equal(node->label, label, sensitive))
+			return (idx);
+	}
+	return (0);
+}
+
+static inline void
+insert_slot(isc_uint16_t *table, unsigned int size, isc_uint32_t hash,
+	    unsigned int idx)
+{
+	unsigned int mask = size - 1;
+	unsigned int slot;
+
+	for (slot = hash & mask; table[slot] != 0; slot = (slot + 1) & mask)
+		;
+	table[slot] = (isc_uint16_t)idx;
+}
+
+static isc_boolean_t
+grow_nodes(dns_compress_t *cctx) {
+	dns_compressnode_t *nodes;
+	unsigned int size;
+
+	size = cctx->nodesize * 2;
+	nodes = isc_mem_get(cctx->mctx, size * sizeof(*nodes));
+	if (nodes == NULL)
+		return (ISC_FALSE);
+	memmove(nodes, cctx->nodes, cctx->count * sizeof(*nodes));
+	if (cctx->nodes != cctx->initialnodes)
+		isc_mem_put(cctx->mctx, cctx->nodes,
+			    cctx->nodesize * sizeof(*nodes));
+	cctx->nodes = nodes;
+	cctx->nodesize = size;
+	return (ISC_TRUE);
+}
+
+static isc_boolean_t
+grow_table(dns_compress_t *cctx) {
+	isc_uint16_t *table;
+	unsigned int i, size;
+
+	size = cctx->tablesize * 2;
+	table = isc_mem_get(cctx->mctx, size * sizeof(*table));
+	if (table == NULL)
+		return (ISC_FALSE);
+	memset(table, 0, size * sizeof(*table));
+	/*
+	 * Reinsert in insertion order so that rollback can keep
+	 * clearing slots from the most recent node backwards.
+	 */
+	for (i = 0; i < cctx->count; i++)
+		insert_slot(table, size, cctx->nodes[i].hash, i + 1);
+	if (cctx->table != cctx->initialtable)
+		isc_mem_put(cctx->mctx, cctx->table,
+			    cctx->tablesize * sizeof(*table));
+	cctx->table = table;
+	cctx->tablesize = size;
+	return (ISC_TRUE);
+}
 
 /*
  * Find the longest match of name in the table.
@@ -134,142 +261,184 @@ isc_boolean_t
 dns_compress_findglobal(dns_compress_t *cctx, const dns_name_t *name,
 			dns_name_t *prefix, isc_uint16_t *offset)
 {
-	dns_name_t tname, nname;
-	dns_compressnode_t *node = NULL;
-	unsigned int labels, hash, n;
+	dns_offsets_t odata;
+	unsigned char *offsets;
+	unsigned int labels, n, parent, idx, match;
+	isc_boolean_t sensitive;
+	isc_uint32_t hash;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name) == ISC_TRUE);
 	REQUIRE(offset != NULL);
 
+	cctx->lastname = NULL;
 	if (cctx->count == 0)
 		return (ISC_FALSE);
 
 	labels = dns_name_countlabels(name);
 	INSIST(labels > 0);
 
-	dns_name_init(&tname, NULL);
-	dns_name_init(&nname, NULL);
-
-	for (n = 0; n < labels - 1; n++) {
-		dns_name_getlabelsequence(name, n, labels - n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		for (node = cctx->table[hash]; node != NULL; node = node->next)
-		{
-			NODENAME(node, &nname);
-			if ((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0) {
-				if (dns_name_caseequal(&nname, &tname))
-					break;
-			} else {
-				if (dns_name_equal(&nname, &tname))
-					break;
-			}
-		}
-		if (node != NULL)
+	offsets = name->offsets;
+	if (offsets == NULL) {
+		dns_name_t clone;
+
+		dns_name_init(&clone, odata);
+		dns_name_clone(name, &clone);
+		offsets = odata;
+	}
+
+	sensitive = ISC_TF((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+	parent = 0;
+	match = 0;
+	n = labels - 1;
+	while (n > 0) {
+		const unsigned char *label = name->ndata + offsets[n - 1];
+
+		hash = label_hash(parent, label);
+		idx = find_node(cctx, parent, hash, label, sensitive);
+		if (idx == 0)
 			break;
+		parent = idx;
+		n--;
+		if (cctx->nodes[idx - 1].offset <= MAXOFFSET) {
+			match = idx;
+			cctx->lastlabels = n;
+		}
 	}
 
 	/*
-	 * If node == NULL, we found no match at all.
+	 * If match == 0, we found no usable match at all.
 	 */
-	if (node == NULL)
+	if (match == 0)
 		return (ISC_FALSE);
 
+	n = cctx->lastlabels;
 	if (n == 0)
 		dns_name_reset(prefix);
 	else
 		dns_name_getlabelsequence(name, 0, n, prefix);
 
-	*offset = node->offset;
+	cctx->lastname = name;
+	cctx->lastnode = match;
+	*offset = cctx->nodes[match - 1].offset;
 	return (ISC_TRUE);
 }
 
-static inline unsigned int
-name_length(const dns_name_t *name) {
-	isc_region_t r;
-	dns_name_toregion(name, &r);
-	return (r.length);
-}
-
 void
 dns_compress_add(dns_compress_t *cctx, const dns_name_t *name,
 		 const dns_name_t *prefix, isc_uint16_t offset)
 {
-	dns_name_t tname;
-	unsigned int start;
-	unsigned int n;
-	unsigned int count;
-	unsigned int hash;
+	dns_offsets_t odata;
+	unsigned char *offsets;
+	unsigned int n, count, parent, idx;
+	isc_boolean_t sensitive;
 	dns_compressnode_t *node;
-	unsigned int length;
-	unsigned int tlength;
-	isc_uint16_t toffset;
+	isc_uint32_t hash;
 
 	REQUIRE(VALID_CCTX(cctx));
 	REQUIRE(dns_name_isabsolute(name));
 
-	dns_name_init(&tname, NULL);
+	if (offset > MAXOFFSET)
+		return;
 
 	n = dns_name_countlabels(name);
 	count = dns_name_countlabels(prefix);
 	if (dns_name_isabsolute(prefix))
 		count--;
-	start = 0;
-	length = name_length(name);
-	while (count > 0) {
-		if (offset >= 0x4000)
-			break;
-		dns_name_getlabelsequence(name, start, n, &tname);
-		hash = dns_name_hash(&tname, ISC_FALSE) %
-		       DNS_COMPRESS_TABLESIZE;
-		tlength = name_length(&tname);
-		toffset = (isc_uint16_t)(offset + (length - tlength));
-		/*
-		 * Create a new node and add it.
-		 */
-		if (cctx->count < DNS_COMPRESS_INITIALNODES)
-			node = &cctx->initialnodes[cctx->count];
-		else {
-			node = isc_mem_get(cctx->mctx,
-					   sizeof(dns_compressnode_t));
-			if (node == NULL)
+	if (count == 0)
+		return;
+
+	offsets = name->offsets;
+	if (offsets == NULL) {
+		dns_name_t clone;
+
+		dns_name_init(&clone, odata);
+		dns_name_clone(name, &clone);
+		offsets = odata;
+	}
+
+	sensitive = ISC_TF((cctx->allowed & DNS_COMPRESS_CASESENSITIVE) != 0);
+
+	/*
+	 * Find the node for the compressed suffix: usually the match
+	 * just returned by dns_compress_findglobal(), otherwise walk
+	 * down from the root.
+	 */
+	parent = 0;
+	if (cctx->lastname == name && cctx->lastlabels == count) {
+		parent = cctx->lastnode;
+		n = count;
+	} else {
+		for (n--; n > count; n--) {
+			const unsigned char *label = name->ndata +
+						     offsets[n - 1];
+
+			hash = label_hash(parent, label);
+			parent = find_node(cctx, parent, hash, label,
+					   sensitive);
+			if (parent == 0)
 				return;
 		}
-		node->count = cctx->count++;
-		node->offset = toffset;
-		dns_name_toregion(&tname, &node->r);
-		node->labels = (isc_uint8_t)dns_name_countlabels(&tname);
-		node->next = cctx->table[hash];
-		cctx->table[hash] = node;
-		start++;
+	}
+	cctx->lastname = NULL;
+
+	/*
+	 * Add the prefix labels, which are rendered in full starting at
+	 * 'offset', reusing any nodes already present.
+	 */
+	while (n > 0) {
+		const unsigned char *label = name->ndata + offsets[n - 1];
+
 		n--;
-		count--;
+		hash = label_hash(parent, label);
+		idx = find_node(cctx, parent, hash, label, sensitive);
+		if (idx != 0) {
+			parent = idx;
+			continue;
+		}
+
+		if (cctx->count == cctx->nodesize && !grow_nodes(cctx))
+			return;
+		if ((cctx->count + 1) * 4 > cctx->tablesize * 3 &&
+		    !grow_table(cctx))
+			return;
+		INSIST(cctx->count < 0xffff);
+
+		node = &cctx->nodes[cctx->count++];
+		node->label = label;
+		node->hash = hash;
+		node->offset = (isc_uint16_t)(offset + offsets[n]);
+		node->parent = (isc_uint16_t)parent;
+		insert_slot(cctx->table, cctx->tablesize, hash, cctx->count);
+		parent = cctx->count;
 	}
 }
 
 void
 dns_compress_rollback(dns_compress_t *cctx, isc_uint16_t offset) {
-	unsigned int i;
 	dns_compressnode_t *node;
+	unsigned int mask, slot;
 
 	REQUIRE(VALID_CCTX(cctx));
 
-	for (i = 0; i < DNS_COMPRESS_TABLESIZE; i++) {
-		node = cctx->table[i];
-		/*
-		 * This relies on nodes with greater offsets being
-		 * closer to the beginning of the list, and the
-		 * items with the greatest offsets being at the end 
-		 * of the initialnodes[] array.
-		 */
-		while (node != NULL && node->offset >= offset) {
-			cctx->table[i] = node->next;
-			if (node->count >= DNS_COMPRESS_INITIALNODES)
-				isc_mem_put(cctx->mctx, node, sizeof(*node));
-			cctx->count--;
-			node = cctx->table[i];
-		}
+	/*
+	 * This relies on nodes with greater offsets being at the end
+	 * of the nodes[] array.  Slots are cleared in the reverse of
+	 * the order they were filled, so the probe sequences of the
+	 * remaining nodes are never broken.
+	 */
+	cctx->lastname = NULL;
+	mask = cctx->tablesize - 1;
+	while (cctx->count > 0) {
+		node = &cctx->nodes[cctx->count - 1];
+		if (node->offset < offset)
+			break;
+		for (slot = node->hash & mask;
+		     cctx->table[slot] != cctx->count;
+		     slot = (slot + 1) & mask)
+			INSIST(cctx->table[slot] != 0);
+		cctx->table[slot] = 0;
+		cctx->count--;
 	}
 }
 
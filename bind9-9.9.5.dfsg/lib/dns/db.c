@@ -303,29 +303,28 @@ dns_db_class(dns_db_t *db) {
 
 #ifdef BIND9
 isc_result_t
-dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
-		 dns_dbload_t **dbloadp) {
+dns_db_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	/*
 	 * Begin loading 'db'.
 	 */
 
 	REQUIRE(DNS_DB_VALID(db));
-	REQUIRE(addp != NULL && *addp == NULL);
-	REQUIRE(dbloadp != NULL && *dbloadp == NULL);
+	REQUIRE(callbacks != NULL);
 
-	return ((db->methods->beginload)(db, addp, dbloadp));
+	return ((db->methods->beginload)(db, callbacks));
 }
 
 isc_result_t
-dns_db_endload(dns_db_t *db, dns_dbload_t **dbloadp) {
+dns_db_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	/*
 	 * Finish loading 'db'.
 	 */
 
 	REQUIRE(DNS_DB_VALID(db));
-	REQUIRE(dbloadp != NULL && *dbloadp != NULL);
+	REQUIRE(callbacks != NULL);
+	REQUIRE(callbacks->add_private != NULL);
 
-	return ((db->methods->endload)(db, dbloadp));
+	return ((db->methods->endload)(db, callbacks));
 }
 
 isc_result_t
@@ -355,13 +354,13 @@ dns_db_load3(dns_db_t *db, const char *filename, dns_masterformat_t format,
 
 	dns_rdatacallbacks_init(&callbacks);
 
-	result = dns_db_beginload(db, &callbacks.add, &callbacks.add_private);
+	result = dns_db_beginload(db, &callbacks);
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	result = dns_master_loadfile2(filename, &db->origin, &db->origin,
 				      db->rdclass, options,
 				      &callbacks, db->mctx, format);
-	eresult = dns_db_endload(db, &callbacks.add_private);
+	eresult = dns_db_endload(db, &callbacks);
 	/*
 	 * We always call dns_db_endload(), but we only want to return its
 	 * result if dns_master_loadfile() succeeded.  If dns_master_loadfile()
@@ -393,6 +392,15 @@ dns_db_dump2(dns_db_t *db, dns_dbversion_t *version, const char *filename,
 
 	return ((db->methods->dump)(db, version, filename, masterformat));
 }
+
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->serialize == NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+	return ((db->methods->serialize)(db, version, file));
+}
 #endif /* BIND9 */
 
 /***
@@ -1007,6 +1015,29 @@ dns_db_resigned(dns_db_t *db, dns_rdataset_t *rdataset,
 		(db->methods->resigned)(db, rdataset, version);
 }
 
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) != 0);
+
+	if (db->methods->setservestalettl != NULL)
+		return ((db->methods->setservestalettl)(db, ttl));
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_getversionid(dns_db_t *db, dns_dbversion_t *version,
+		    isc_uint64_t *idp)
+{
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(version != NULL);
+	REQUIRE(idp != NULL);
+
+	if (db->methods->getversionid != NULL)
+		return ((db->methods->getversionid)(db, version, idp));
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_db_rpz_enabled(dns_db_t *db, dns_rpz_st_t *st)
 {
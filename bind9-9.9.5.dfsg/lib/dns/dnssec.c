@@ -29,6 +29,7 @@
 #include <isc/dir.h>
 #include <isc/mem.h>
 #include <isc/serial.h>
+#include <isc/sha2.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -44,6 +45,7 @@
 #include <dns/rdataset.h>
 #include <dns/rdatastruct.h>
 #include <dns/result.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>		/* for DNS_TSIG_FUDGE */
 
@@ -381,6 +383,85 @@ isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   isc_boolean_t ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild)
+{
+	return (dns_dnssec_verify4(name, set, key, ignoretime, maxbits, mctx,
+				   sigrdata, wild, NULL));
+}
+
+static inline void
+sha256_region(isc_sha256_t *sha256, isc_region_t *r) {
+	unsigned char len[2];
+
+	INSIST(r->length < 65536);
+	len[0] = (r->length >> 8) & 0xff;
+	len[1] = r->length & 0xff;
+	isc_sha256_update(sha256, len, sizeof(len));
+	isc_sha256_update(sha256, r->base, r->length);
+}
+
+/*
+ * Compute the signature cache digest for verifying 'sigrdata' over 'set'
+ * (owned by 'name', already lower cased and reduced to the wildcard's
+ * parent if need be) with 'key'.  Everything dst_context_verify2() would
+ * look at goes in: the whole RRSIG including the signature, the owner
+ * name, the RRset as it is, the key and the 'maxbits' limit.
+ */
+static isc_result_t
+sigcache_digest(dns_name_t *name, isc_boolean_t wildcard, dns_rdataset_t *set,
+		dst_key_t *key, unsigned int maxbits, dns_rdata_t *sigrdata,
+		unsigned char *digest)
+{
+	isc_sha256_t sha256;
+	isc_buffer_t keybuf;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char data[8];
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r;
+	isc_result_t result;
+
+	isc_buffer_init(&keybuf, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &keybuf);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	isc_sha256_init(&sha256);
+	isc_buffer_usedregion(&keybuf, &r);
+	sha256_region(&sha256, &r);
+	data[0] = (maxbits >> 24) & 0xff;
+	data[1] = (maxbits >> 16) & 0xff;
+	data[2] = (maxbits >> 8) & 0xff;
+	data[3] = maxbits & 0xff;
+	data[4] = wildcard ? 1 : 0;
+	isc_sha256_update(&sha256, data, 5);
+	dns_rdata_toregion(sigrdata, &r);
+	sha256_region(&sha256, &r);
+	dns_name_toregion(name, &r);
+	sha256_region(&sha256, &r);
+	data[0] = (set->type >> 8) & 0xff;
+	data[1] = set->type & 0xff;
+	data[2] = (set->rdclass >> 8) & 0xff;
+	data[3] = set->rdclass & 0xff;
+	isc_sha256_update(&sha256, data, 4);
+	for (result = dns_rdataset_first(set);
+	     result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(set))
+	{
+		dns_rdataset_current(set, &rdata);
+		dns_rdata_toregion(&rdata, &r);
+		sha256_region(&sha256, &r);
+		dns_rdata_reset(&rdata);
+	}
+	isc_sha256_final(digest, &sha256);
+	if (result != ISC_R_NOMORE)
+		return (result);
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   isc_boolean_t ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_sigcache_t *cache)
 {
 	dns_rdata_rrsig_t sig;
 	dns_fixedname_t fnewname;
@@ -395,6 +476,7 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	int labels = 0;
 	isc_uint32_t flags;
 	isc_boolean_t downcase = ISC_FALSE;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
 
 	REQUIRE(name != NULL);
 	REQUIRE(set != NULL);
@@ -469,6 +551,34 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		return (DNS_R_KEYUNAUTHORIZED);
 	}
 
+	/*
+	 * If the name is an expanded wildcard, use the wildcard name.
+	 */
+	dns_fixedname_init(&fnewname);
+	labels = dns_name_countlabels(name) - 1;
+	RUNTIME_CHECK(dns_name_downcase(name, dns_fixedname_name(&fnewname),
+					NULL) == ISC_R_SUCCESS);
+	if (labels - sig.labels > 0)
+		dns_name_split(dns_fixedname_name(&fnewname), sig.labels + 1,
+			       NULL, dns_fixedname_name(&fnewname));
+
+	/*
+	 * Has this exact signature already been verified with this key?
+	 * The checks above depend on the time and the caller, so they
+	 * are always made; only the public key operation is skipped.
+	 */
+	if (cache != NULL &&
+	    sigcache_digest(dns_fixedname_name(&fnewname),
+			    ISC_TF(labels - sig.labels > 0), set, key,
+			    maxbits, sigrdata, digest) != ISC_R_SUCCESS)
+		cache = NULL;
+	if (cache != NULL && dns_sigcache_find(cache, digest) == ISC_R_SUCCESS) {
+		inc_stat(dns_dnssecstats_cached);
+		ret = ISC_R_SUCCESS;
+		cache = NULL;
+		goto cleanup_struct;
+	}
+
  again:
 	ret = dst_context_create2(key, mctx, DNS_LOGCATEGORY_DNSSEC, &ctx);
 	if (ret != ISC_R_SUCCESS)
@@ -481,17 +591,6 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	if (ret != ISC_R_SUCCESS)
 		goto cleanup_context;
 
-	/*
-	 * If the name is an expanded wildcard, use the wildcard name.
-	 */
-	dns_fixedname_init(&fnewname);
-	labels = dns_name_countlabels(name) - 1;
-	RUNTIME_CHECK(dns_name_downcase(name, dns_fixedname_name(&fnewname),
-					NULL) == ISC_R_SUCCESS);
-	if (labels - sig.labels > 0)
-		dns_name_split(dns_fixedname_name(&fnewname), sig.labels + 1,
-			       NULL, dns_fixedname_name(&fnewname));
-
 	dns_name_toregion(dns_fixedname_name(&fnewname), &r);
 
 	/*
@@ -576,6 +675,8 @@ cleanup_context:
 		goto again;
 	}
 cleanup_struct:
+	if (ret == ISC_R_SUCCESS && cache != NULL)
+		dns_sigcache_add(cache, digest, sig.timeexpire);
 	dns_rdata_freestruct(&sig);
 
 	if (ret == DST_R_VERIFYFAILURE)
@@ -143,6 +143,23 @@ dns_acl_merge(dns_acl_t *dest, dns_acl_t *source, isc_boolean_t pos);
  * an unexpected positive match in the parent ACL.
  */
 
+isc_result_t
+dns_acl_compile(dns_acl_t *acl);
+/*%<
+ * Build lookup tables for the IP prefixes in 'acl', so that
+ * dns_acl_match() finds the first matching prefix without walking the
+ * radix tree.  Adding prefixes to the ACL afterwards discards the
+ * tables.  This must be done before the ACL is shared with other
+ * threads.
+ *
+ * Requires:
+ *\li	'acl' to be a valid acl.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
 void
 dns_acl_attach(dns_acl_t *source, dns_acl_t **target);
 /*%<
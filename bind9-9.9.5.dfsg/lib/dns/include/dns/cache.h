@@ -184,6 +184,19 @@ dns_cache_setfilename(dns_cache_t *cache, const char *filename);
  *\li	Various file-related failures
  */
 
+void
+dns_cache_setfileformat(dns_cache_t *cache, dns_masterformat_t format);
+/*%<
+ * Set the format of the cache file: dns_masterformat_text (the default)
+ * for a master file, or dns_masterformat_raw for a binary snapshot that
+ * also preserves the trust level and negative cache entries and can be
+ * loaded much faster.  A missing snapshot is loaded as an empty one.
+ *
+ * Requires:
+ *\li	'cache' is a valid cache.
+ *\li	'format' is dns_masterformat_text or dns_masterformat_raw.
+ */
+
 isc_result_t
 dns_cache_load(dns_cache_t *cache);
 /*%<
@@ -263,6 +276,17 @@ dns_cache_getcachesize(dns_cache_t *cache);
  * Get the maximum cache size.
  */
 
+void
+dns_cache_setservestalettl(dns_cache_t *cache, dns_ttl_t ttl);
+/*%<
+ * Set the maximum length of time expired records are retained in
+ * the cache so that they can be served as stale answers.  0 means
+ * expired records are discarded as usual.
+ *
+ * Requires:
+ *\li	'cache' is a valid cache.
+ */
+
 isc_result_t
 dns_cache_flush(dns_cache_t *cache);
 /*%<
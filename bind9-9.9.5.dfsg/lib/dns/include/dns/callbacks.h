@@ -49,6 +49,12 @@ struct dns_rdatacallbacks {
 	dns_rawdatafunc_t rawdata;
 	dns_zone_t *zone;
 
+	/*%
+	 * dns_master_load*() call this when loading a map format file;
+	 * the database maps the rest of the file in directly.
+	 */
+	dns_deserializefunc_t deserialize;
+
 	/*%
 	 * dns_load_master / dns_rdata_fromtext call this to issue a error.
 	 */
@@ -61,6 +67,7 @@ struct dns_rdatacallbacks {
 	 * Private data handles for use by the above callback functions.
 	 */
 	void	*add_private;
+	void	*deserialize_private;
 	void	*error_private;
 	void	*warn_private;
 };
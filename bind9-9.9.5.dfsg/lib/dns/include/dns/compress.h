@@ -36,28 +36,42 @@ ISC_LANG_BEGINDECLS
  *	Direct manipulation of the structures is strongly discouraged.
  */
 
-#define DNS_COMPRESS_TABLESIZE 64
-#define DNS_COMPRESS_INITIALNODES 16
+/*
+ * The global compression table is a trie of the names added so far,
+ * keyed on labels from the root down.  Each node is stored in a hash
+ * table indexed by its parent and its label, so the longest matching
+ * suffix of a name is found with one lookup per label.  Nodes are kept
+ * in the order they were added so that dns_compress_rollback() only
+ * has to drop them from the end.
+ */
+#define DNS_COMPRESS_INITIALNODES 32
+#define DNS_COMPRESS_INITIALSLOTS 64	/*%< Must be a power of 2. */
 
 typedef struct dns_compressnode dns_compressnode_t;
 
 struct dns_compressnode {
-	isc_region_t		r;
-	isc_uint16_t		offset;
-	isc_uint16_t		count;
-	isc_uint8_t		labels;
-	dns_compressnode_t	*next;
+	const unsigned char	*label;		/*%< Label in the added name. */
+	isc_uint32_t		hash;		/*%< Of parent and label. */
+	isc_uint16_t		offset;		/*%< Of the suffix in the message. */
+	isc_uint16_t		parent;		/*%< Parent node + 1, 0 for root. */
 };
 
 struct dns_compress {
 	unsigned int		magic;		/*%< Magic number. */
 	unsigned int		allowed;	/*%< Allowed methods. */
 	int			edns;		/*%< Edns version or -1. */
-	/*% Global compression table. */
-	dns_compressnode_t	*table[DNS_COMPRESS_TABLESIZE];
-	/*% Preallocated nodes for the table. */
+	dns_compressnode_t	*nodes;		/*%< Nodes in insertion order. */
+	isc_uint16_t		*table;		/*%< Hash table of node + 1. */
+	unsigned int		count;		/*%< Number of nodes. */
+	unsigned int		nodesize;	/*%< Size of 'nodes'. */
+	unsigned int		tablesize;	/*%< Size of 'table'. */
+	/*% Last match returned by dns_compress_findglobal(). */
+	const dns_name_t	*lastname;
+	unsigned int		lastlabels;
+	unsigned int		lastnode;
+	/*% Preallocated nodes and table. */
 	dns_compressnode_t	initialnodes[DNS_COMPRESS_INITIALNODES];
-	isc_uint16_t		count;		/*%< Number of nodes. */
+	isc_uint16_t		initialtable[DNS_COMPRESS_INITIALSLOTS];
 	isc_mem_t		*mctx;		/*%< Memory context. */
 };
 
@@ -76,9 +76,12 @@ ISC_LANG_BEGINDECLS
 typedef struct dns_dbmethods {
 	void		(*attach)(dns_db_t *source, dns_db_t **targetp);
 	void		(*detach)(dns_db_t **dbp);
-	isc_result_t	(*beginload)(dns_db_t *db, dns_addrdatasetfunc_t *addp,
-				     dns_dbload_t **dbloadp);
-	isc_result_t	(*endload)(dns_db_t *db, dns_dbload_t **dbloadp);
+	isc_result_t	(*beginload)(dns_db_t *db,
+				     dns_rdatacallbacks_t *callbacks);
+	isc_result_t	(*endload)(dns_db_t *db,
+				   dns_rdatacallbacks_t *callbacks);
+	isc_result_t	(*serialize)(dns_db_t *db,
+				     dns_dbversion_t *version, FILE *file);
 	isc_result_t	(*dump)(dns_db_t *db, dns_dbversion_t *version,
 				const char *filename,
 				dns_masterformat_t masterformat);
@@ -194,6 +197,10 @@ typedef struct dns_dbmethods {
 				   dns_clientinfo_t *clientinfo,
 				   dns_rdataset_t *rdataset,
 				   dns_rdataset_t *sigrdataset);
+	isc_result_t	(*setservestalettl)(dns_db_t *db, dns_ttl_t ttl);
+	isc_result_t	(*getversionid)(dns_db_t *db,
+					dns_dbversion_t *version,
+					isc_uint64_t *idp);
 } dns_dbmethods_t;
 
 typedef isc_result_t
@@ -241,6 +248,7 @@ struct dns_db {
 #define DNS_DBFIND_COVERINGNSEC		0x0040
 #define DNS_DBFIND_FORCENSEC3		0x0080
 #define DNS_DBFIND_ADDITIONALOK		0x0100
+#define DNS_DBFIND_STALEOK		0x0200
 /*@}*/
 
 /*@{*/
@@ -251,6 +259,7 @@ struct dns_db {
 #define DNS_DBADD_FORCE			0x02
 #define DNS_DBADD_EXACT			0x04
 #define DNS_DBADD_EXACTTTL		0x08
+#define DNS_DBADD_PREFETCH		0x10
 /*@}*/
 
 /*%
@@ -459,8 +468,7 @@ dns_db_class(dns_db_t *db);
  */
 
 isc_result_t
-dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
-		 dns_dbload_t **dbloadp);
+dns_db_beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks);
 /*%<
  * Begin loading 'db'.
  *
@@ -470,15 +478,18 @@ dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
  *
  * \li	This is the first attempt to load 'db'.
  *
- * \li	addp != NULL && *addp == NULL
- *
- * \li	dbloadp != NULL && *dbloadp == NULL
+ * \li	'callbacks' is a pointer to an initialized dns_rdatacallbacks_t
+ *	structure.
  *
  * Ensures:
  *
- * \li	On success, *addp will be a valid dns_addrdatasetfunc_t suitable
- *	for loading 'db'.  *dbloadp will be a valid DB load context which
- *	should be used as 'arg' when *addp is called.
+ * \li	On success, callbacks->add will be a valid dns_addrdatasetfunc_t
+ *	suitable for loading records into 'db' from a raw or text zone
+ *	file. callbacks->add_private will be a valid DB load context
+ *	which should be used as 'arg' when callbacks->add is called.
+ *	callbacks->deserialize will be a valid dns_deserializefunc_t
+ *	suitable for loading 'db' from a map format zone file, or NULL
+ *	if the database does not support the map format.
  *
  * Returns:
  *
@@ -490,7 +501,7 @@ dns_db_beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp,
  */
 
 isc_result_t
-dns_db_endload(dns_db_t *db, dns_dbload_t **dbloadp);
+dns_db_endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks);
 /*%<
  * Finish loading 'db'.
  *
@@ -498,11 +509,15 @@ dns_db_endload(dns_db_t *db, dns_dbload_t **dbloadp);
  *
  * \li	'db' is a valid database that is being loaded.
  *
- * \li	dbloadp != NULL and *dbloadp is a valid database load context.
+ * \li	'callbacks' is a valid dns_rdatacallbacks_t structure.
+ *
+ * \li	callbacks->add_private is not NULL and is a valid database load
+ *	context.
  *
  * Ensures:
  *
- * \li	*dbloadp == NULL
+ * \li	'callbacks' is returned to its state prior to calling
+ *	dns_db_beginload()
  *
  * Returns:
  *
@@ -573,6 +588,31 @@ dns_db_dump2(dns_db_t *db, dns_dbversion_t *version, const char *filename,
  *	implementation used, OS file errors, etc.
  */
 
+isc_result_t
+dns_db_serialize(dns_db_t *db, dns_dbversion_t *version, FILE *file);
+/*%<
+ * Write version 'version' of 'db' to 'file' as an image of the database
+ * that can be mapped into memory again when loading a "map" format file.
+ * This is the body of a map format master file; the file header is
+ * written by the caller (see dns_master_dump3()).
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * \li	'version' is a valid version.
+ *
+ * \li	'file' is open for writing and seekable.
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED if the database cannot be serialized.
+ *
+ * \li	Other results are possible, depending upon the database
+ *	implementation used, OS file errors, etc.
+ */
+
 /***
  *** Version Methods
  ***/
@@ -774,6 +814,12 @@ dns_db_findext(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
  *	in the NSEC3 tree and not the main tree.  Without this option being
  *	set NSEC3 records will not be found.
  *
+ * \li	If the #DNS_DBFIND_STALEOK option is set, then rdatasets which
+ *	have expired but are still within the database's serve-stale
+ *	window (see dns_db_setservestalettl()) may be returned.  Such
+ *	rdatasets have a TTL of zero and #DNS_RDATASETATTR_STALE set.
+ *	This only affects answers returned from the cache.
+ *
  * \li	To respond to a query for SIG records, the caller should create a
  *	rdataset iterator and extract the signatures from each rdataset.
  *
@@ -1192,7 +1238,16 @@ dns_db_addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
  *	any existing rdataset.  Forcing is only meaningful for cache databases.
  *	If #DNS_DBADD_EXACT is set then there must be no rdata in common between
  *	the old and new rdata sets.  If #DNS_DBADD_EXACTTTL is set then both
- *	the old and new rdata sets must have the same ttl.
+ *	the old and new rdata sets must have the same ttl.  If
+ *	#DNS_DBADD_PREFETCH is set, an identical A, AAAA or DS rdataset
+ *	already in a cache database is replaced, refreshing its ttl,
+ *	rather than being kept.
+ *
+ * \li	If the database has cache semantics and 'rdataset' has
+ *	#DNS_RDATASETATTR_PREFETCH set, the added rdataset is marked as
+ *	eligible for prefetching; rdatasets subsequently found in it will
+ *	have #DNS_RDATASETATTR_PREFETCH set until
+ *	dns_rdataset_clearprefetch() is called.
  *
  * \li	The 'now' field is ignored if 'db' is a zone database.  If 'db' is
  *	a cache database, then the added rdataset will expire no later than
@@ -1549,6 +1604,26 @@ dns_db_rpz_enabled(dns_db_t *db, dns_rpz_st_t *st);
  * or find which RPZ data is available.
  */
 
+isc_result_t
+dns_db_getversionid(dns_db_t *db, dns_dbversion_t *version,
+		    isc_uint64_t *idp);
+/*%<
+ * Set '*idp' to an identity of 'version' of 'db' that no other version
+ * of any database will have, even after 'version' has been closed and
+ * 'db' freed.  It lets a caller recognise a version it has seen before
+ * without keeping a reference to it.
+ *
+ * Requires:
+ * \li	'db' is a valid database.
+ * \li	'version' is a valid open version of 'db'.
+ * \li	'idp' is not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - the database's versions do not follow
+ *	its contents (caches, sdb and DLZ databases).
+ */
+
 void
 dns_db_rpz_findips(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		   dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
@@ -1568,6 +1643,23 @@ dns_db_rpz_findips(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
  *	    or NULL, an empty name, 0, DNS_RPZ_POLICY_MISS, and 0
  */
 
+isc_result_t
+dns_db_setservestalettl(dns_db_t *db, dns_ttl_t ttl);
+/*%<
+ * Sets the maximum length of time that cached answers may be retained
+ * past their normal TTL, so that they can be returned as stale answers
+ * with #DNS_DBFIND_STALEOK.  A value of zero disables the feature.
+ * The rbt cache caps 'ttl' at 4 weeks.
+ *
+ * Requires:
+ * \li	'db' is a valid cache database.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTIMPLEMENTED - the database does not support serving
+ *	stale answers.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* DNS_DB_H */
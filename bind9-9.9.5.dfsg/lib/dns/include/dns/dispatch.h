@@ -134,6 +134,11 @@ struct dns_dispatchset {
  *
  * _EXCLUSIVE
  *	A separate socket will be used on-demand for each transaction.
+ *
+ * _REUSEPORT
+ *	The dispatcher's socket is bound with SO_REUSEPORT, and dispatchers
+ *	created as duplicates of it open their own socket on the same
+ *	address rather than sharing this one.
  */
 #define DNS_DISPATCHATTR_PRIVATE	0x00000001U
 #define DNS_DISPATCHATTR_TCP		0x00000002U
@@ -145,6 +150,7 @@ struct dns_dispatchset {
 #define DNS_DISPATCHATTR_CONNECTED	0x00000080U
 /*#define DNS_DISPATCHATTR_RANDOMPORT	0x00000100U*/
 #define DNS_DISPATCHATTR_EXCLUSIVE	0x00000200U
+#define DNS_DISPATCHATTR_REUSEPORT	0x00000400U
 /*@}*/
 
 isc_result_t
@@ -271,6 +277,11 @@ dns_dispatch_getudp_dup(dns_dispatchmgr_t *mgr, isc_socketmgr_t *sockmgr,
  * Attach to existing dns_dispatch_t if one is found with dns_dispatchmgr_find,
  * otherwise create a new UDP dispatch.
  *
+ * dns_dispatch_getudp_dup() with a non-NULL 'dup' always creates a new
+ * dispatch listening on the same address as 'dup'.  The new dispatch uses
+ * a duplicate of dup's socket, or its own SO_REUSEPORT socket if
+ * 'attributes' includes #DNS_DISPATCHATTR_REUSEPORT.
+ *
  * Requires:
  *\li	All pointer parameters be valid for their respective types.
  *
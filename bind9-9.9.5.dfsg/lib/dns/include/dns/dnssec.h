@@ -137,6 +137,12 @@ isc_result_t
 dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		   isc_boolean_t ignoretime, unsigned int maxbits,
 		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild);
+
+isc_result_t
+dns_dnssec_verify4(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
+		   isc_boolean_t ignoretime, unsigned int maxbits,
+		   isc_mem_t *mctx, dns_rdata_t *sigrdata, dns_name_t *wild,
+		   dns_sigcache_t *cache);
 /*%<
  *	Verifies the RRSIG record covering this rdataset signed by a specific
  *	key.  This does not determine if the key's owner is authorized to sign
@@ -145,6 +151,12 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *
  *	'maxbits' specifies the maximum number of rsa exponent bits accepted.
  *
+ *	If 'cache' is non-NULL, a signature that it records as verified
+ *	with this key over this rdataset is accepted without repeating
+ *	the public key operation, and successful verifications are added
+ *	to it.  The time and signer checks are made either way.
+ *	dns_dnssec_verify4() only.
+ *
  *	Requires:
  *\li		'name' (the owner name of the record) is a valid name
  *\li		'set' is a valid rdataset
@@ -152,6 +164,7 @@ dns_dnssec_verify3(dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
  *\li		'mctx' is not NULL
  *\li		'sigrdata' is a valid rdata containing a SIG record
  *\li		'wild' if non-NULL then is a valid and has a buffer.
+ *\li		'cache' if non-NULL is a valid signature cache.
  *
  *	Returns:
  *\li		#ISC_R_SUCCESS
@@ -49,6 +49,7 @@
 #define DNS_JOURNAL_READ	0x00000000	/* ISC_FALSE */
 #define DNS_JOURNAL_CREATE	0x00000001	/* ISC_TRUE */
 #define DNS_JOURNAL_WRITE	0x00000002
+#define DNS_JOURNAL_GROUP	0x00000004
 
 /***
  *** Types
@@ -108,6 +109,11 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * DNS_JOURNAL_GROUP may be or'ed with DNS_JOURNAL_CREATE or
+ * DNS_JOURNAL_WRITE to group commit transactions: dns_journal_commit()
+ * then only appends the transaction, and it becomes durable and visible
+ * to other readers of the file when dns_journal_sync() is called.
  */
 
 void
@@ -157,6 +163,19 @@ dns_journal_commit(dns_journal_t *j);
  *      sequence.
  */
 
+isc_result_t
+dns_journal_sync(dns_journal_t *j);
+/*%<
+ * Commit the transactions appended to journal file 'j' since it was
+ * opened, or since the last call, to stable storage with a single pair
+ * of fsyncs.  Transactions that have not been synced when 'j' is
+ * destroyed are lost.
+ *
+ * Requires:
+ * \li     'j' is open for writing with DNS_JOURNAL_GROUP and has no
+ *	transaction in progress.
+ */
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
 /*%
@@ -29,6 +29,7 @@
 #include <stdio.h>
 
 #include <isc/lang.h>
+#include <isc/taskpool.h>
 
 #include <dns/types.h>
 
@@ -201,6 +202,19 @@ dns_master_loadfileinc3(const char *master_file,
 			dns_loadctx_t **ctxp, isc_mem_t *mctx,
 			dns_masterformat_t format);
 
+isc_result_t
+dns_master_loadfileinc4(const char *master_file,
+			dns_name_t *top,
+			dns_name_t *origin,
+			dns_rdataclass_t zclass,
+			unsigned int options,
+			isc_uint32_t resign,
+			dns_rdatacallbacks_t *callbacks,
+			isc_task_t *task,
+			dns_loaddonefunc_t done, void *done_arg,
+			dns_loadctx_t **ctxp, isc_mem_t *mctx,
+			dns_masterformat_t format, isc_taskpool_t *pool);
+
 isc_result_t
 dns_master_loadstreaminc(FILE *stream,
 			 dns_name_t *top,
@@ -254,6 +268,11 @@ dns_master_loadlexerinc(isc_lex_t *lex,
  * 'resign' the number of seconds before a RRSIG expires that it should
  * be re-signed.  0 is used if not provided.
  *
+ * If 'pool' is not NULL, a large text file may be split into chunks
+ * which are parsed concurrently on the tasks of 'pool'.  Calls to
+ * 'callbacks->add' are serialised, and 'done' is still called from
+ * 'task'.  Files using $INCLUDE or $DATE are always loaded serially.
+ *
  * Requires:
  *\li	'master_file' points to a valid string.
  *\li	'lexer' points to a valid lexer.
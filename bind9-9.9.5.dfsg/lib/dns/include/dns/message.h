@@ -570,6 +570,32 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderrdata(dns_message_t *msg, dns_section_t section,
+			dns_name_t *owner, dns_ttl_t ttl, dns_rdata_t *rdata);
+/*%<
+ * Render a single resource record with owner name 'owner' and TTL 'ttl'
+ * directly into 'section' of the message, without first adding it to
+ * the message as a name and rdataset.  This is for callers such as
+ * zone transfers that stream many records which they do not otherwise
+ * need to keep.  The record is counted in 'section', so the sections
+ * must be rendered in order.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section other than #DNS_SECTION_QUESTION.
+ *
+ *\li	'owner' and 'rdata' be valid.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the record was written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer to write
+ *				   the record.  Nothing was written.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
@@ -23,6 +23,7 @@
 /*! \file dns/nsec.h */
 
 #include <isc/lang.h>
+#include <isc/stdtime.h>
 
 #include <dns/types.h>
 #include <dns/name.h>
@@ -111,6 +112,44 @@ dns_nsec_noexistnodata(dns_rdatatype_t type, dns_name_t *name,
  * Return ISC_R_IGNORE when the NSEC is not the appropriate one.
  */
 
+isc_result_t
+dns_nsec_synthnegative(dns_db_t *db, dns_name_t *name, dns_rdatatype_t type,
+		       isc_stdtime_t now, dns_name_t *owner,
+		       dns_rdataset_t *nsecset, dns_rdataset_t *nsecsig,
+		       dns_name_t *wowner, dns_rdataset_t *wnsecset,
+		       dns_rdataset_t *wnsecsig, dns_name_t *soaname,
+		       dns_rdataset_t *soaset, dns_rdataset_t *soasig,
+		       dns_nseclog_t logit, void *arg);
+/*%<
+ * Use the validated NSEC and SOA records in the cache 'db' to prove that
+ * 'name' does not exist, or has no records of type 'type' (RFC 8198).
+ *
+ * The NSEC at or covering 'name' and its signature are returned in
+ * 'nsecset' and 'nsecsig', with their owner in 'owner'.  A proof that
+ * 'name' does not exist also needs an NSEC showing that there is no
+ * wildcard at the closest encloser; it is returned in 'wnsecset' and
+ * 'wnsecsig', with its owner in 'wowner'.  The SOA of the zone that
+ * signed them is returned in 'soaset' and 'soasig' with its owner in
+ * 'soaname'.  The TTLs of all of them are lowered to the negative TTL
+ * the answer may be cached for.
+ *
+ * Every record used must be secure, and the NSEC records must come
+ * from the zone that 'name' is in: NSEC records from the parent side
+ * of a delegation prove nothing about the names below it.
+ *
+ * Requires:
+ *\li	'db' to be a valid cache database.
+ *\li	'owner', 'wowner' and 'soaname' to be valid names with
+ *	dedicated buffers.
+ *\li	all the rdatasets to be valid and disassociated.
+ *
+ * Returns:
+ *\li	#DNS_R_NXDOMAIN		'name' does not exist.
+ *\li	#DNS_R_NXRRSET		'name' has no records of type 'type'.
+ *\li	#ISC_R_NOTFOUND		nothing could be proved; no rdataset is
+ *				associated.
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* DNS_NSEC_H */
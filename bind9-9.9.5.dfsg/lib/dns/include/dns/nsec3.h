@@ -88,6 +88,20 @@ dns_nsec3_hashname(dns_fixedname_t *result,
  * the raw hash is stored there.
  */
 
+isc_result_t
+dns_nsec3_hashnames(dns_fixedname_t *results, unsigned char **rethashes,
+		    size_t *hash_length, dns_name_t **names,
+		    unsigned int count, dns_name_t *origin,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength);
+/*%<
+ * Make the hashed domain names results[i] of the 'count' unhashed names
+ * names[i], as dns_nsec3_hashname() would.  The names are hashed
+ * together, which is considerably faster than hashing them one at a
+ * time.  If rethashes is not NULL each raw hash is stored in
+ * rethashes[i], which must hold NSEC3_MAX_HASH_LENGTH octets.
+ */
+
 unsigned int
 dns_nsec3_hashlength(dns_hash_t hash);
 /*%<
@@ -50,10 +50,10 @@ ISC_LANG_BEGINDECLS
 #endif
 
 /*
- * These should add up to 30.
+ * These should add up to 29.
  */
 #define DNS_RBT_LOCKLENGTH                      10
-#define DNS_RBT_REFLENGTH                       20
+#define DNS_RBT_REFLENGTH                       19
 
 #define DNS_RBTNODE_MAGIC               ISC_MAGIC('R','B','N','O')
 #if DNS_RBT_USEMAGIC
@@ -80,20 +80,57 @@ struct dns_rbtnode {
 #if DNS_RBT_USEMAGIC
 	unsigned int magic;
 #endif
+	/*%
+	 * Used for LRU cache.  This linked list is used to mark nodes which
+	 * have no data any longer, but we cannot unlink at that exact moment
+	 * because we did not or could not obtain a write lock on the tree.
+	 */
+	ISC_LINK(dns_rbtnode_t) deadlink;
+
+	/*@{*/
+	/*!
+	 * These values are used in the RBT DB implementation.  The appropriate
+	 * node lock must be held before accessing them.
+	 */
+	unsigned int dirty:1;
+	unsigned int wild:1;
+	/*%
+	 * Set for nodes that live in a mapped zone file rather than
+	 * in memory allocated from the tree's context; never changes.
+	 */
+	unsigned int is_mmapped:1;
+	unsigned int locknum:DNS_RBT_LOCKLENGTH;
+#ifndef DNS_RBT_USEISCREFCOUNT
+	unsigned int references:DNS_RBT_REFLENGTH;
+#else
+	isc_refcount_t references; /* note that this is not in the bitfield */
+#endif
+	void *data;
+	/*@}*/
+
+	/*%
+	 * Everything a lookup looks at from here on, up to and including
+	 * the name stored after the structure, is kept together so that
+	 * visiting a node touches as few cache lines as possible.
+	 */
 	dns_rbtnode_t *parent;
 	dns_rbtnode_t *left;
 	dns_rbtnode_t *right;
 	dns_rbtnode_t *down;
 #ifdef DNS_RBT_USEHASH
-	dns_rbtnode_t *hashnext;
-#endif
-
 	/*%
-	 * Used for LRU cache.  This linked list is used to mark nodes which
-	 * have no data any longer, but we cannot unlink at that exact moment
-	 * because we did not or could not obtain a write lock on the tree.
+	 * The node whose down pointer leads to the level this node is in,
+	 * which the hash lookup must check for every candidate; walking the
+	 * parent pointers up to the root of the level to find it cost a
+	 * cache miss per step in large levels.  It can't be packed into
+	 * the bitfields, so it costs 8 bytes per node on LP64; with 1M
+	 * names "rbt_test -b" measured 108 rather than 100 bytes per name
+	 * and 1.5us rather than 3.9us per lookup.
 	 */
-	ISC_LINK(dns_rbtnode_t) deadlink;
+	dns_rbtnode_t *uppernode;
+	dns_rbtnode_t *hashnext;
+	unsigned int hashval;
+#endif
 
 	/*@{*/
 	/*!
@@ -114,32 +151,33 @@ struct dns_rbtnode {
 	unsigned int offsetlen : 8;     /*%< range is 1..128 */
 	unsigned int oldnamelen : 8;    /*%< range is 1..255 */
 	/*@}*/
-
-#ifdef DNS_RBT_USEHASH
-	unsigned int hashval;
-#endif
-
-	/*@{*/
-	/*!
-	 * These values are used in the RBT DB implementation.  The appropriate
-	 * node lock must be held before accessing them.
-	 */
-	void *data;
-	unsigned int dirty:1;
-	unsigned int wild:1;
-	unsigned int locknum:DNS_RBT_LOCKLENGTH;
-#ifndef DNS_RBT_USEISCREFCOUNT
-	unsigned int references:DNS_RBT_REFLENGTH;
-#else
-	isc_refcount_t references; /* note that this is not in the bitfield */
-#endif
-	/*@}*/
 };
 
 typedef isc_result_t (*dns_rbtfindcallback_t)(dns_rbtnode_t *node,
 					      dns_name_t *name,
 					      void *callback_arg);
 
+/*%
+ * Writes the data of a node to a map file for dns_rbt_serialize_tree(),
+ * setting '*offsetp' to the file offset the data starts at (0 if none
+ * was written).
+ */
+typedef isc_result_t (*dns_rbtdatawriter_t)(FILE *file,
+					    unsigned char *data,
+					    void *arg,
+					    off_t *offsetp);
+
+/*%
+ * Called by dns_rbt_deserialize_tree() for each node, with or without
+ * data, after the node itself has been fixed up, so that the caller can
+ * set its own fields of the node and turn the file offsets stored in the
+ * data back into pointers.  'base' and 'filesize' describe the mapped
+ * file.
+ */
+typedef isc_result_t (*dns_rbtdatafixer_t)(dns_rbtnode_t *rbtnode,
+					   void *base, size_t filesize,
+					   void *arg);
+
 /*****
  *****  Chain Info
  *****/
@@ -658,6 +696,65 @@ dns_rbt_destroy2(dns_rbt_t **rbtp, unsigned int quantum);
  * \li  ISC_R_QUOTA if 'quantum' nodes have been destroyed.
  */
 
+off_t
+dns_rbt_serialize_align(off_t target);
+/*%<
+ * Return the smallest offset at or after 'target' that a node or its
+ * data may be written at in a map file.
+ */
+
+isc_result_t
+dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
+		       dns_rbtdatawriter_t datawriter, void *writer_arg,
+		       off_t *offset);
+/*%<
+ * Write an image of 'rbt' to 'file', starting at the current position,
+ * so that it can later be used in place by dns_rbt_deserialize_tree()
+ * after mapping the file into memory.  Pointers are written as offsets
+ * from the start of the file.  'datawriter' is called for every node
+ * with data and must write the data in the same relocatable form.
+ *
+ * Requires:
+ *\li   'file' is open for writing and seekable.
+ *\li   rbt is a valid rbt manager.
+ *\li   'datawriter' is not NULL.
+ *
+ * Ensures:
+ *\li   On success, '*offset' is the offset of the tree header, which is
+ *      to be passed to dns_rbt_deserialize_tree(); the file position is
+ *      at the end of the written data.
+ *
+ * Returns:
+ *\li   #ISC_R_SUCCESS
+ *\li   Any error returned by 'datawriter' or from writing the file.
+ */
+
+isc_result_t
+dns_rbt_deserialize_tree(void *base_address, size_t filesize,
+			 off_t header_offset, isc_mem_t *mctx,
+			 void (*deleter)(void *, void *), void *deleter_arg,
+			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			 dns_rbt_t **rbtp);
+/*%<
+ * Create a red-black tree of trees whose nodes are the ones written by
+ * dns_rbt_serialize_tree() to the file mapped at 'base_address'.  The
+ * nodes are used in place; the mapping must be private and writable, and
+ * must stay in place until the tree has been destroyed.  Nodes added
+ * later are allocated from 'mctx' as usual.
+ *
+ * Requires:
+ *\li   'base_address' is the start of a 'filesize' byte mapping.
+ *\li   rbtp != NULL && *rbtp == NULL
+ *\li   arg == NULL iff deleter == NULL
+ *
+ * Returns:
+ *\li   #ISC_R_SUCCESS
+ *\li   #ISC_R_INVALIDFILE  The image is damaged or was written by an
+ *                          incompatible build.
+ *\li   #ISC_R_NOMEMORY
+ *\li   Any error returned by 'datafixer'.
+ */
+
 void
 dns_rbt_printall(dns_rbt_t *rbt);
 /*%<
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_RESPCACHE_H
+#define DNS_RESPCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/respcache.h
+ * \brief
+ * A cache of rendered responses.
+ *
+ * The response cache holds complete wire format responses, keyed by an
+ * opaque byte string built by the caller from everything that can
+ * change the rendered answer (query name, type, class, flags, EDNS
+ * options, buffer size, ...).  Each entry also records the identity of
+ * the database version it was built from (dns_db_getversionid()); an
+ * entry is only returned while the caller is still looking at the same
+ * version, so zone updates and reloads make older entries unreachable.
+ * Entries hold no references, so they never keep an old version or
+ * database in memory.
+ *
+ * The cache is split into a number of independently locked stripes,
+ * each with its own LRU list and share of the memory budget.
+ *
+ * MP:
+ *\li	All functions are thread safe.
+ */
+
+#include <isc/lang.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+#define DNS_RESPCACHE_MAXWIRE	4096	/*%< Largest response kept. */
+#define DNS_RESPCACHE_MAXKEY	300	/*%< Largest key accepted. */
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t size, dns_respcache_t **rcp);
+/*%<
+ * Create a response cache using at most about 'size' bytes of memory.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'size' is not zero.
+ *\li	'rcp' is not NULL and '*rcp' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp);
+/*%<
+ * Flush and free the response cache.
+ *
+ * Requires:
+ *\li	'*rcp' is a valid response cache.
+ *
+ * Ensures:
+ *\li	'*rcp' is NULL.
+ */
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const isc_region_t *key,
+		   dns_db_t *db, dns_dbversion_t *version,
+		   isc_buffer_t *target, unsigned int *tagp);
+/*%<
+ * Look up 'key'.  If an entry exists and was added for 'version' of
+ * 'db', copy its wire data to the available space of 'target' and
+ * return the entry's tag in '*tagp'.  An entry added for any other
+ * database or version is removed.
+ *
+ * Requires:
+ *\li	'rc' is a valid response cache.
+ *\li	'key', 'db', 'version' and 'target' are not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ *\li	#ISC_R_NOSPACE		'target' is too small; nothing was copied.
+ */
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const isc_region_t *key,
+		  dns_db_t *db, dns_dbversion_t *version, unsigned int tag,
+		  const isc_region_t *wire);
+/*%<
+ * Add the response 'wire', built from 'version' of 'db', under 'key',
+ * replacing any existing entry for 'key'.  The least recently used
+ * entries are evicted as needed to stay within the memory budget.
+ * 'tag' is opaque to the cache and is returned by dns_respcache_find().
+ *
+ * The entry records the identity of 'version' but holds no reference
+ * to it or to 'db'.
+ *
+ * Requires:
+ *\li	'rc' is a valid response cache.
+ *\li	'key', 'db', 'version' and 'wire' are not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ *\li	#ISC_R_RANGE		'key' or 'wire' is too large to be cached.
+ *\li	#ISC_R_NOTIMPLEMENTED	'db' is a cache or a persistent database
+ *				(sdb, DLZ), whose versions do not change
+ *				with their contents, or its versions have
+ *				no identity (dns_db_getversionid()).
+ */
+
+void
+dns_respcache_flush(dns_respcache_t *rc);
+/*%<
+ * Remove all entries.
+ *
+ * Requires:
+ *\li	'rc' is a valid response cache.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_RESPCACHE_H */
@@ -198,8 +198,45 @@ struct dns_rrl_rate {
 	const char  *str;
 };
 
+/*
+ * The rate-limit entries are split by the hash of their keys into shards,
+ * each with its own lock, LRU list, hash table, and time stamp bases,
+ * so that responses for different clients or names do not all contend
+ * for one lock.  Entries for the same key always land in the same shard,
+ * so each token bucket is still debited exactly.
+ */
+#define DNS_RRL_SHARD_BITS	4
+#define DNS_RRL_SHARDS		(1<<DNS_RRL_SHARD_BITS)
+#define DNS_RRL_TS_BASES	(1<<DNS_RRL_TS_GEN_BITS)
+
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t	lock;
+
+	int		num_entries;
+
+	unsigned int	probes;
+	unsigned int	searches;
+
+	ISC_LIST(dns_rrl_block_t) blocks;
+	ISC_LIST(dns_rrl_entry_t) lru;
+
+	dns_rrl_hash_t	*hash;
+	dns_rrl_hash_t	*old_hash;
+	unsigned int	hash_gen;
+
+	unsigned int	ts_gen;
+	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
+
+	isc_stdtime_t	log_stops_time;
+	dns_rrl_entry_t	*last_logged;
+	int		num_logged;
+};
+
 /*
  * Per-view query rate limit parameters and a pointer to database.
+ * 'lock' protects the qps estimate and the logged qname buffers;
+ * everything else that changes is in the shards.
  */
 typedef struct dns_rrl dns_rrl_t;
 struct dns_rrl {
@@ -220,38 +257,21 @@ struct dns_rrl {
 
 	dns_acl_t	*exempt;
 
-	int		num_entries;
-
 	int		qps_responses;
 	isc_stdtime_t	qps_time;
 	double		qps;
 
-	unsigned int	probes;
-	unsigned int	searches;
-
-	ISC_LIST(dns_rrl_block_t) blocks;
-	ISC_LIST(dns_rrl_entry_t) lru;
-
-	dns_rrl_hash_t	*hash;
-	dns_rrl_hash_t	*old_hash;
-	unsigned int	hash_gen;
-
-	unsigned int	ts_gen;
-# define DNS_RRL_TS_BASES   (1<<DNS_RRL_TS_GEN_BITS)
-	isc_stdtime_t	ts_bases[DNS_RRL_TS_BASES];
-
 	int		ipv4_prefixlen;
 	isc_uint32_t	ipv4_mask;
 	int		ipv6_prefixlen;
 	isc_uint32_t	ipv6_mask[4];
 
-	isc_stdtime_t	log_stops_time;
-	dns_rrl_entry_t	*last_logged;
-	int		num_logged;
 	int		num_qnames;
 	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
 # define DNS_RRL_QNAMES	    (1<<DNS_RRL_QNAMES_BITS)
 	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
+
+	dns_rrl_shard_t	shards[DNS_RRL_SHARDS];
 };
 
 typedef enum {
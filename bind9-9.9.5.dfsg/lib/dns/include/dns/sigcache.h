@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef DNS_SIGCACHE_H
+#define DNS_SIGCACHE_H 1
+
+/*****
+ ***** Module Info
+ *****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * A cache of successful signature verifications.
+ *
+ * The signature cache remembers that a public key operation succeeded,
+ * so that an RRSIG seen again (by another client, another fetch or
+ * another view) need not be verified again.  Entries are identified
+ * only by a digest which the caller computes over everything the
+ * result depends on: the RRSIG, the key, the signed RRset and any
+ * limits applied to the key.  See dns_dnssec_verify4().
+ *
+ * The cache has a fixed number of entries, which are split into a
+ * number of independently locked stripes.  Within a stripe an entry
+ * may be stored in any of a small set of slots chosen by its digest;
+ * when all of them are in use the one holding an expired signature,
+ * or failing that the oldest, is replaced.
+ *
+ * MP:
+ *\li	All functions are thread safe.
+ */
+
+#include <isc/lang.h>
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+#include <isc/types.h>
+
+#include <dns/types.h>
+
+#define DNS_SIGCACHE_DIGESTLENGTH	ISC_SHA256_DIGESTLENGTH
+
+ISC_LANG_BEGINDECLS
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep);
+/*%<
+ * Create a signature cache holding about 'size' entries.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context.
+ *\li	'size' is not zero.
+ *\li	'cachep' is not NULL and '*cachep' is NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOMEMORY
+ */
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp);
+/*%<
+ * Attach '*targetp' to 'source'.
+ *
+ * Requires:
+ *\li	'source' is a valid signature cache.
+ *\li	'targetp' is not NULL and '*targetp' is NULL.
+ */
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep);
+/*%<
+ * Detach from a signature cache, freeing it when the last reference
+ * goes away.
+ *
+ * Requires:
+ *\li	'*cachep' is a valid signature cache.
+ *
+ * Ensures:
+ *\li	'*cachep' is NULL.
+ */
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest);
+/*%<
+ * Look for an entry for 'digest', which is DNS_SIGCACHE_DIGESTLENGTH
+ * bytes long.
+ *
+ * Requires:
+ *\li	'cache' is a valid signature cache.
+ *\li	'digest' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTFOUND
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest,
+		 isc_stdtime_t expire);
+/*%<
+ * Record a successful verification under 'digest', which is
+ * DNS_SIGCACHE_DIGESTLENGTH bytes long.  'expire' is the expiry time
+ * of the signature; once it has passed the entry is the first to be
+ * replaced.  The cache does not itself check signature times.
+ *
+ * Requires:
+ *\li	'cache' is a valid signature cache.
+ *\li	'digest' is not NULL.
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache);
+/*%<
+ * Remove all entries.
+ *
+ * Requires:
+ *\li	'cache' is a valid signature cache.
+ */
+
+ISC_LANG_ENDDECLS
+
+#endif /* DNS_SIGCACHE_H */
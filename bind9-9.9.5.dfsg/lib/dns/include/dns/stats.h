@@ -71,8 +71,9 @@ enum {
 	dns_dnssecstats_downcase = 1,
 	dns_dnssecstats_wildcard = 2,
 	dns_dnssecstats_fail = 3,
+	dns_dnssecstats_cached = 4,
 
-	dns_dnssecstats_max = 4,
+	dns_dnssecstats_max = 5,
 
 	/*%
 	 * Zone statistics counters.
@@ -29,6 +29,8 @@
  * include the appropriate .h file too.
  */
 
+#include <stdio.h>
+
 #include <isc/types.h>
 
 typedef struct dns_acache			dns_acache_t;
@@ -113,9 +115,11 @@ typedef isc_uint16_t				dns_rdatatype_t;
 typedef struct dns_request			dns_request_t;
 typedef struct dns_requestmgr			dns_requestmgr_t;
 typedef struct dns_resolver			dns_resolver_t;
+typedef struct dns_respcache			dns_respcache_t;
 typedef struct dns_sdbimplementation		dns_sdbimplementation_t;
 typedef isc_uint8_t				dns_secalg_t;
 typedef isc_uint8_t				dns_secproto_t;
+typedef struct dns_sigcache			dns_sigcache_t;
 typedef struct dns_signature			dns_signature_t;
 typedef struct dns_ssurule			dns_ssurule_t;
 typedef struct dns_ssutable			dns_ssutable_t;
@@ -189,7 +193,8 @@ typedef enum {
 typedef enum {
 	dns_masterformat_none = 0,
 	dns_masterformat_text = 1,
-	dns_masterformat_raw = 2
+	dns_masterformat_raw = 2,
+	dns_masterformat_map = 3
 } dns_masterformat_t;
 
 typedef enum {
@@ -364,6 +369,9 @@ typedef void
 typedef isc_result_t
 (*dns_addrdatasetfunc_t)(void *, dns_name_t *, dns_rdataset_t *);
 
+typedef isc_result_t
+(*dns_deserializefunc_t)(void *, FILE *, off_t);
+
 typedef isc_result_t
 (*dns_additionaldatafunc_t)(void *, dns_name_t *, dns_rdatatype_t);
 
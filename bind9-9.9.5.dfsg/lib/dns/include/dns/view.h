@@ -144,10 +144,17 @@ struct dns_view {
 	dns_rbt_t *			denyanswernames;
 	dns_rbt_t *			answernames_exclude;
 	dns_rrl_t *			rrl;
+	dns_respcache_t *		respcache;
+	dns_sigcache_t *		sigcache;
 	isc_boolean_t			provideixfr;
 	isc_boolean_t			requestnsid;
 	dns_ttl_t			maxcachettl;
 	dns_ttl_t			maxncachettl;
+	dns_ttl_t			prefetch_trigger;
+	dns_ttl_t			prefetch_eligible;
+	isc_boolean_t			staleanswersok;
+	dns_ttl_t			staleanswerttl;
+	isc_boolean_t			synthfromdnssec;
 	in_port_t			dstport;
 	dns_aclenv_t			aclenv;
 	dns_rdatatype_t			preferred_glue;
@@ -1010,6 +1017,19 @@ dns_view_getresquerystats(dns_view_t *view, dns_stats_t **statsp);
  *\li	'statsp' != NULL && '*statsp' != NULL
  */
 
+void
+dns_view_setsigcache(dns_view_t *view, dns_sigcache_t *cache);
+/*%<
+ * Set the cache of verified signatures used when validating answers in
+ * 'view', replacing any set before.  A cache may be shared by several
+ * views.  If 'cache' is NULL, signatures are always verified.
+ *
+ * Requires:
+ * \li	'view' is valid and is not frozen.
+ *
+ *\li	'cache' is NULL or a valid signature cache.
+ */
+
 isc_boolean_t
 dns_view_iscacheshared(dns_view_t *view);
 /*%<
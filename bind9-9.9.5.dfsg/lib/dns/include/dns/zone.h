@@ -1013,6 +1013,56 @@ dns_zone_setupdatedisabled(dns_zone_t *zone, isc_boolean_t state);
  * call has been made.
  */
 
+isc_boolean_t
+dns_zone_getgroupcommit(dns_zone_t *zone);
+void
+dns_zone_setgroupcommit(dns_zone_t *zone, isc_boolean_t state);
+/*%<
+ * Get or set whether dynamic updates to 'zone' are group committed:
+ * updates that arrive while others are being applied are applied
+ * together and written to the journal with a single sync.
+ */
+
+isc_boolean_t
+dns_zone_queueupdate(dns_zone_t *zone, isc_event_t *event);
+/*%<
+ * Start or join a batch of dynamic updates to 'zone'.  If no batch is
+ * being processed, one is started and ISC_TRUE is returned: the caller
+ * must then send 'event' to the zone's task itself.  Otherwise 'event'
+ * is queued for the running batch and ISC_FALSE is returned.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'event' is not NULL and not linked to any list.
+ */
+
+isc_event_t *
+dns_zone_nextupdate(dns_zone_t *zone);
+/*%<
+ * Remove and return the first update event queued by
+ * dns_zone_queueupdate().  If none is queued the batch is over and
+ * NULL is returned; the next dns_zone_queueupdate() starts a new one.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone with a batch in progress.
+ */
+
+isc_result_t
+dns_zone_resetjournal(dns_zone_t *zone);
+/*%<
+ * Write 'zone' to its master file and then remove its journal, which
+ * the master file supersedes.  This brings the files back in step with
+ * a zone that has moved ahead of its journal, as it does when the sync
+ * of a group committed batch of updates fails.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	The result of dumping the zone or removing the journal.
+ */
+
 isc_boolean_t
 dns_zone_getzeronosoattl(dns_zone_t *zone);
 /*%<
@@ -1180,6 +1230,17 @@ dns_zone_gettask(dns_zone_t *zone, isc_task_t **target);
  *\li	'target' to be != NULL && '*target' == NULL.
  */
 
+void
+dns_zone_getloadtask(dns_zone_t *zone, isc_task_t **target);
+/*%<
+ * Attach '*target' to the zone's load task, if it has one.  '*target'
+ * is left NULL for zones that are not managed by a zone manager.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ *\li	'target' to be != NULL && '*target' == NULL.
+ */
+
 void
 dns_zone_notify(dns_zone_t *zone);
 /*%<
@@ -1596,6 +1657,28 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr);
  *\li	'zmgr' to be a valid zone manager.
  */
 
+isc_result_t
+dns_zonemgr_setsigningworkers(dns_zonemgr_t *zmgr, unsigned int workers);
+/*%<
+ *	Set the number of tasks, including the zone's own task, that
+ *	share the work of generating the signatures of a zone being
+ *	signed or re-signed.  The limits set with dns_zone_setsignatures()
+ *	and dns_zone_setnodes() still apply to each quantum as a whole.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ *\li	'workers' to be positive.
+ */
+
+unsigned int
+dns_zonemgr_getsigningworkers(dns_zonemgr_t *zmgr);
+/*%<
+ *	Get the number of tasks that share the work of signing a zone.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager.
+ */
+
 void
 dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
@@ -41,6 +41,14 @@
 #include <dns/result.h>
 #include <dns/soa.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#else
+#define PROT_READ	0x01
+#define MAP_PRIVATE	0x0002
+#define MAP_FAILED	((void *)-1)
+#endif
+
 /*! \file
  * \brief Journaling.
  *
@@ -114,6 +122,7 @@ static isc_boolean_t bind8_compat = ISC_TRUE; /* XXX config */
 #define JOURNAL_SERIALSET	0x01U
 
 static isc_result_t index_to_disk(dns_journal_t *);
+static isc_result_t journal_write_header(dns_journal_t *);
 
 static inline isc_uint32_t
 decode_uint32(unsigned char *p) {
@@ -309,10 +318,14 @@ struct dns_journal {
 	journal_state_t		state;
 	char 			*filename;	/*%< Journal file name */
 	FILE *			fp;		/*%< File handle */
+	unsigned char		*map;		/*%< Mapping, when reading */
+	size_t			maplen;		/*%< Length of the mapping */
 	isc_offset_t		offset;		/*%< Current file offset */
 	journal_header_t 	header;		/*%< In-core journal header */
 	unsigned char		*rawindex;	/*%< In-core buffer for journal index in on-disk format */
 	journal_pos_t		*index;		/*%< In-core journal index */
+	isc_boolean_t		group;		/*%< Defer header updates */
+	unsigned int		pending;	/*%< Commits not yet synced */
 
 	/*% Current transaction state (when writing). */
 	struct {
@@ -383,10 +396,26 @@ journal_header_encode(journal_header_t *cooked, journal_rawheader_t *raw) {
 
 /*
  * Journal file I/O subroutines, with error checking and reporting.
+ *
+ * Journals opened for reading only are mapped into memory when
+ * possible, in which case seeking and reading just move j->offset
+ * within the mapping.
  */
 static isc_result_t
 journal_seek(dns_journal_t *j, isc_uint32_t offset) {
 	isc_result_t result;
+
+	if (j->map != NULL) {
+		if ((size_t)offset > j->maplen) {
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: seek: offset %u beyond end of file",
+				      j->filename, offset);
+			return (ISC_R_UNEXPECTED);
+		}
+		j->offset = offset;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_seek(j->fp, (long)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
@@ -402,6 +431,14 @@ static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		if (nbytes > j->maplen - (size_t)j->offset)
+			return (ISC_R_NOMORE);
+		memmove(mem, j->map + j->offset, nbytes);
+		j->offset += (isc_offset_t)nbytes;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF)
@@ -554,6 +591,41 @@ journal_file_create(isc_mem_t *mctx, const char *filename) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map the whole of a journal that is opened for reading.  Failure is
+ * not an error; the journal is then read through j->fp.
+ */
+static void
+journal_map(dns_journal_t *j) {
+	off_t filesize;
+	void *base;
+
+	if (isc_stdio_seek(j->fp, 0, SEEK_END) != ISC_R_SUCCESS ||
+	    isc_stdio_tell(j->fp, &filesize) != ISC_R_SUCCESS ||
+	    filesize < (off_t)sizeof(journal_rawheader_t) ||
+	    (off_t)(size_t)filesize != filesize)
+		return;
+
+	base = isc_file_mmap(NULL, (size_t)filesize, PROT_READ, MAP_PRIVATE,
+			     fileno(j->fp), 0);
+	if (base == NULL || base == MAP_FAILED) {
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+			      "%s: mmap failed, reading file", j->filename);
+		return;
+	}
+	j->map = base;
+	j->maplen = (size_t)filesize;
+}
+
+static void
+journal_unmap(dns_journal_t *j) {
+	if (j->map != NULL) {
+		(void)isc_file_munmap(j->map, j->maplen);
+		j->map = NULL;
+		j->maplen = 0;
+	}
+}
+
 static isc_result_t
 journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	     isc_boolean_t create, dns_journal_t **journalp)
@@ -572,6 +644,10 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	isc_mem_attach(mctx, &j->mctx);
 	j->state = JOURNAL_STATE_INVALID;
 	j->fp = NULL;
+	j->map = NULL;
+	j->maplen = 0;
+	j->group = ISC_FALSE;
+	j->pending = 0;
 	j->filename = isc_mem_strdup(mctx, filename);
 	j->index = NULL;
 	j->rawindex = NULL;
@@ -609,6 +685,9 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	 */
 	j->magic = DNS_JOURNAL_MAGIC;
 
+	if (!write)
+		journal_map(j);
+
 	CHECK(journal_seek(j, 0));
 	CHECK(journal_read(j, &rawheader, sizeof(rawheader)));
 
@@ -651,6 +730,15 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 		}
 		INSIST(p == j->rawindex + rawbytes);
 	}
+
+	/*
+	 * A writer may have extended the file after it was mapped.
+	 * Transactions beyond the mapping are not visible through it,
+	 * so read such a journal through the file instead.
+	 */
+	if (j->map != NULL && (size_t)j->header.end.offset > j->maplen)
+		journal_unmap(j);
+
 	j->offset = -1; /* Invalid, must seek explicitly. */
 
 	/*
@@ -683,6 +771,7 @@ journal_open(isc_mem_t *mctx, const char *filename, isc_boolean_t write,
 	}
 	if (j->filename != NULL)
 		isc_mem_free(j->mctx, j->filename);
+	journal_unmap(j);
 	if (j->fp != NULL)
 		(void)isc_stdio_close(j->fp);
 	isc_mem_putanddetach(&j->mctx, j, sizeof(*j));
@@ -713,6 +802,9 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 			return (result);
 		result = journal_open(mctx, backup, write, write, journalp);
 	}
+	if (result == ISC_R_SUCCESS && write &&
+	    (mode & DNS_JOURNAL_GROUP) != 0)
+		(*journalp)->group = ISC_TRUE;
 	return (result);
 }
 
@@ -1163,9 +1255,13 @@ dns_journal_commit(dns_journal_t *j) {
 #endif
 
 	/*
-	 * Commit the transaction data to stable storage.
+	 * Commit the transaction data to stable storage.  In group
+	 * mode that is left to dns_journal_sync(), which must also
+	 * do it before the header that makes the transaction visible
+	 * is written.
 	 */
-	CHECK(journal_fsync(j));
+	if (!j->group)
+		CHECK(journal_fsync(j));
 
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		isc_offset_t offset;
@@ -1185,15 +1281,43 @@ dns_journal_commit(dns_journal_t *j) {
 	if (JOURNAL_EMPTY(&j->header))
 		j->header.begin = j->x.pos[0];
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
 	 */
 	index_add(j, &j->x.pos[0]);
 
+	/*
+	 * We no longer have a transaction open.
+	 */
+	j->state = JOURNAL_STATE_WRITE;
+
+	if (j->group) {
+		j->pending++;
+		return (ISC_R_SUCCESS);
+	}
+
+	CHECK(journal_write_header(j));
+
+	result = ISC_R_SUCCESS;
+
+ failure:
+	return (result);
+}
+
+/*
+ * Write the in-core header and index to disk and commit them to
+ * stable storage.
+ */
+static isc_result_t
+journal_write_header(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+
 	/*
 	 * Convert the index into on-disk format and write
 	 * it to disk.
@@ -1205,10 +1329,31 @@ dns_journal_commit(dns_journal_t *j) {
 	 */
 	CHECK(journal_fsync(j));
 
+	result = ISC_R_SUCCESS;
+
+ failure:
+	return (result);
+}
+
+isc_result_t
+dns_journal_sync(dns_journal_t *j) {
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(j->state == JOURNAL_STATE_WRITE);
+
+	if (j->pending == 0)
+		return (ISC_R_SUCCESS);
+
 	/*
-	 * We no longer have a transaction open.
+	 * The transaction data must be on stable storage before the
+	 * header that refers to it.
 	 */
-	j->state = JOURNAL_STATE_WRITE;
+	CHECK(journal_fsync(j));
+	CHECK(journal_write_header(j));
+	isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+		      "%s: synced %u transactions", j->filename, j->pending);
+	j->pending = 0;
 
 	result = ISC_R_SUCCESS;
 
@@ -1225,6 +1370,14 @@ dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff) {
 	CHECK(dns_journal_commit(j));
 	result = ISC_R_SUCCESS;
  failure:
+	/*
+	 * In group mode the journal stays open after a failed
+	 * transaction.  Nothing of it is in the in-core header, so
+	 * the next one simply overwrites it.
+	 */
+	if (result != ISC_R_SUCCESS && j->group &&
+	    j->state == JOURNAL_STATE_TRANSACTION)
+		j->state = JOURNAL_STATE_WRITE;
 	return (result);
 }
 
@@ -1248,6 +1401,7 @@ dns_journal_destroy(dns_journal_t **journalp) {
 		isc_mem_put(j->mctx, j->it.source.base, j->it.source.length);
 	if (j->filename != NULL)
 		isc_mem_free(j->mctx, j->filename);
+	journal_unmap(j);
 	if (j->fp != NULL)
 		(void)isc_stdio_close(j->fp);
 	j->magic = 0;
@@ -1658,6 +1812,8 @@ dns_journal_first_rr(dns_journal_t *j) {
 static isc_result_t
 read_one_rr(dns_journal_t *j) {
 	isc_result_t result;
+	isc_buffer_t mapped;
+	isc_buffer_t *source;
 
 	dns_rdatatype_t rdtype;
 	dns_rdataclass_t rdclass;
@@ -1710,9 +1866,27 @@ read_one_rr(dns_journal_t *j) {
 		FAIL(ISC_R_UNEXPECTED);
 	}
 
-	CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
-	CHECK(journal_read(j, j->it.source.base, rrhdr.size));
-	isc_buffer_add(&j->it.source, rrhdr.size);
+	/*
+	 * A mapped journal is parsed where it lies; otherwise the
+	 * RR is read into j->it.source.
+	 */
+	if (j->map != NULL) {
+		if (rrhdr.size > j->maplen - (size_t)j->offset) {
+			isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "%s: journal corrupt: RR beyond "
+				      "end of file", j->filename);
+			FAIL(ISC_R_UNEXPECTED);
+		}
+		isc_buffer_init(&mapped, j->map + j->offset, rrhdr.size);
+		isc_buffer_add(&mapped, rrhdr.size);
+		j->offset += rrhdr.size;
+		source = &mapped;
+	} else {
+		CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
+		CHECK(journal_read(j, j->it.source.base, rrhdr.size));
+		isc_buffer_add(&j->it.source, rrhdr.size);
+		source = &j->it.source;
+	}
 
 	/*
 	 * The target buffer is made the same size
@@ -1727,31 +1901,30 @@ read_one_rr(dns_journal_t *j) {
 	 * ends yet, so we make the entire "remaining"
 	 * part of the buffer "active".
 	 */
-	isc_buffer_setactive(&j->it.source,
-			     j->it.source.used - j->it.source.current);
-	CHECK(dns_name_fromwire(&j->it.name, &j->it.source,
+	isc_buffer_setactive(source, source->used - source->current);
+	CHECK(dns_name_fromwire(&j->it.name, source,
 				&j->it.dctx, 0, &j->it.target));
 
 	/*
 	 * Check that the RR header is there, and parse it.
 	 */
-	if (isc_buffer_remaininglength(&j->it.source) < 10)
+	if (isc_buffer_remaininglength(source) < 10)
 		FAIL(DNS_R_FORMERR);
 
-	rdtype = isc_buffer_getuint16(&j->it.source);
-	rdclass = isc_buffer_getuint16(&j->it.source);
-	ttl = isc_buffer_getuint32(&j->it.source);
-	rdlen = isc_buffer_getuint16(&j->it.source);
+	rdtype = isc_buffer_getuint16(source);
+	rdclass = isc_buffer_getuint16(source);
+	ttl = isc_buffer_getuint32(source);
+	rdlen = isc_buffer_getuint16(source);
 
 	/*
 	 * Parse the rdata.
 	 */
-	if (isc_buffer_remaininglength(&j->it.source) != rdlen)
+	if (isc_buffer_remaininglength(source) != rdlen)
 		FAIL(DNS_R_FORMERR);
-	isc_buffer_setactive(&j->it.source, rdlen);
+	isc_buffer_setactive(source, rdlen);
 	dns_rdata_reset(&j->it.rdata);
 	CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass,
-				 rdtype, &j->it.source, &j->it.dctx,
+				 rdtype, source, &j->it.dctx,
 				 0, &j->it.target));
 	j->it.ttl = ttl;
 
@@ -1764,6 +1937,16 @@ read_one_rr(dns_journal_t *j) {
 	result = ISC_R_SUCCESS;
 
  failure:
+	/*
+	 * Running out of file before reaching j->it.epos means that the
+	 * journal is shorter than its header claims.
+	 */
+	if (result == ISC_R_NOMORE) {
+		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
+			      "%s: journal corrupt: unexpected end of file",
+			      j->filename);
+		result = ISC_R_UNEXPECTED;
+	}
 	j->it.result = result;
 	return (result);
 }
@@ -31,6 +31,7 @@
 #include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/taskpool.h>
 #include <isc/util.h>
 
 #include <dns/callbacks.h>
@@ -91,9 +92,16 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Text files at least twice this size are split into chunks of at
+ * least this size which are parsed on separate tasks.
+ */
+#define SPLIT_MINCHUNK (1024*1024)
+
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
 
 typedef struct dns_incctx dns_incctx_t;
+typedef struct dns_loadchunk dns_loadchunk_t;
 
 /*%
  * Master file load state.
@@ -135,6 +143,14 @@ struct dns_loadctx {
 	isc_boolean_t		first;
 	dns_masterrawheader_t	header;
 
+	/* Members used when a text file is loaded in parallel: */
+	dns_loadctx_t		*parent;		/*%< set in chunks */
+	isc_buffer_t		*buffer;		/*%< chunk text */
+	char			*filename;
+	dns_rdatacallbacks_t	chunkcallbacks;
+	unsigned int		chunks;			/*%< still loading,
+							 * locked by lock */
+
 	/* Which fixed buffers we are using? */
 	unsigned int		loop_cnt;		/*% records per quantum,
 							 * 0 => all. */
@@ -163,6 +179,25 @@ struct dns_incctx {
 	unsigned int		current_line;
 };
 
+/*%
+ * A piece of a text master file, found by split_text(), that starts
+ * with an owner name at the top level.  'origin' and 'ttl' are the
+ * $ORIGIN and $TTL in effect at that point.
+ */
+struct dns_loadchunk {
+	dns_loadctx_t		*parent;
+	off_t			offset;
+	size_t			length;
+	unsigned long		line;
+	isc_boolean_t		ttl_known;
+	isc_uint32_t		ttl;
+	dns_fixedname_t		origin;
+	isc_event_t		*event;
+	ISC_LINK(dns_loadchunk_t) link;
+};
+
+typedef ISC_LIST(dns_loadchunk_t) loadchunk_head_t;
+
 #define DNS_LCTX_MAGIC ISC_MAGIC('L','c','t','x')
 #define DNS_LCTX_VALID(lctx) ISC_MAGIC_VALID(lctx, DNS_LCTX_MAGIC)
 
@@ -180,6 +215,12 @@ load_text(dns_loadctx_t *lctx);
 static isc_result_t
 load_raw(dns_loadctx_t *lctx);
 
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file);
+
+static isc_result_t
+load_map(dns_loadctx_t *lctx);
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx);
 
@@ -464,6 +505,13 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 	if (lctx->lex != NULL && !lctx->keep_lex)
 		isc_lex_destroy(&lctx->lex);
 
+	if (lctx->buffer != NULL)
+		isc_buffer_free(&lctx->buffer);
+	if (lctx->filename != NULL)
+		isc_mem_free(lctx->mctx, lctx->filename);
+	if (lctx->parent != NULL)
+		dns_loadctx_detach(&lctx->parent);
+
 	if (lctx->task != NULL)
 		isc_task_detach(&lctx->task);
 	DESTROYLOCK(&lctx->lock);
@@ -558,6 +606,10 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 		lctx->openfile = openfile_raw;
 		lctx->load = load_raw;
 		break;
+	case dns_masterformat_map:
+		lctx->openfile = openfile_map;
+		lctx->load = load_map;
+		break;
 	}
 
 	if (lex != NULL) {
@@ -600,6 +652,11 @@ loadctx_create(dns_masterformat_t format, isc_mem_t *mctx,
 	lctx->first = ISC_TRUE;
 	dns_master_initrawheader(&lctx->header);
 
+	lctx->parent = NULL;
+	lctx->buffer = NULL;
+	lctx->filename = NULL;
+	lctx->chunks = 0;
+
 	lctx->loop_cnt = (done != NULL) ? 100 : 0;
 	lctx->callbacks = callbacks;
 	lctx->task = NULL;
@@ -784,6 +841,20 @@ openfile_raw(dns_loadctx_t *lctx, const char *master_file) {
 	return (result);
 }
 
+static isc_result_t
+openfile_map(dns_loadctx_t *lctx, const char *master_file) {
+	isc_result_t result;
+
+	result = isc_stdio_open(master_file, "rb", &lctx->f);
+	if (result != ISC_R_SUCCESS && result != ISC_R_FILENOTFOUND) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_stdio_open() failed: %s",
+				 isc_result_totext(result));
+	}
+
+	return (result);
+}
+
 static isc_result_t
 generate(dns_loadctx_t *lctx, char *range, char *lhs, char *gtype, char *rhs,
 	 const char *source, unsigned int line)
@@ -2090,6 +2161,74 @@ read_and_check(isc_boolean_t do_read, isc_buffer_t *buffer,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Read the header that starts both raw and map format files.
+ */
+static isc_result_t
+load_header(dns_loadctx_t *lctx, dns_masterrawheader_t *header) {
+	isc_result_t result;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	unsigned char data[sizeof(*header)];
+	size_t commonlen = sizeof(header->format) + sizeof(header->version);
+	size_t remainder;
+	isc_buffer_t target;
+
+	dns_master_initrawheader(header);
+
+	INSIST(commonlen <= sizeof(*header));
+	isc_buffer_init(&target, data, sizeof(data));
+
+	result = isc_stdio_read(data, 1, commonlen, lctx->f, NULL);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_stdio_read failed: %s",
+				 isc_result_totext(result));
+		return (result);
+	}
+	isc_buffer_add(&target, commonlen);
+	header->format = isc_buffer_getuint32(&target);
+	if (header->format != lctx->format) {
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "file format mismatch");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	header->version = isc_buffer_getuint32(&target);
+	switch (header->version) {
+	case 0:
+		remainder = sizeof(header->dumptime);
+		break;
+	case DNS_RAWFORMAT_VERSION:
+		remainder = sizeof(*header) - commonlen;
+		break;
+	default:
+		(*callbacks->error)(callbacks,
+				    "dns_master_load: "
+				    "unsupported file format version");
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	result = isc_stdio_read(data + commonlen, 1, remainder,
+				lctx->f, NULL);
+	if (result != ISC_R_SUCCESS) {
+		UNEXPECTED_ERROR(__FILE__, __LINE__,
+				 "isc_stdio_read failed: %s",
+				 isc_result_totext(result));
+		return (result);
+	}
+
+	isc_buffer_add(&target, remainder);
+	header->dumptime = isc_buffer_getuint32(&target);
+	if (header->version == DNS_RAWFORMAT_VERSION) {
+		header->flags = isc_buffer_getuint32(&target);
+		header->sourceserial = isc_buffer_getuint32(&target);
+		header->lastxfrin = isc_buffer_getuint32(&target);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 load_raw(dns_loadctx_t *lctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2117,62 +2256,9 @@ load_raw(dns_loadctx_t *lctx) {
 	dns_master_initrawheader(&header);
 
 	if (lctx->first) {
-		unsigned char data[sizeof(header)];
-		size_t commonlen =
-			sizeof(header.format) + sizeof(header.version);
-		size_t remainder;
-
-		INSIST(commonlen <= sizeof(header));
-		isc_buffer_init(&target, data, sizeof(data));
-
-		result = isc_stdio_read(data, 1, commonlen, lctx->f, NULL);
-		if (result != ISC_R_SUCCESS) {
-			UNEXPECTED_ERROR(__FILE__, __LINE__,
-					 "isc_stdio_read failed: %s",
-					 isc_result_totext(result));
-			return (result);
-		}
-		isc_buffer_add(&target, commonlen);
-		header.format = isc_buffer_getuint32(&target);
-		if (header.format != dns_masterformat_raw) {
-			(*callbacks->error)(callbacks,
-					    "dns_master_load: "
-					    "file format mismatch");
-			return (ISC_R_NOTIMPLEMENTED);
-		}
-
-		header.version = isc_buffer_getuint32(&target);
-		switch (header.version) {
-		case 0:
-			remainder = sizeof(header.dumptime);
-			break;
-		case DNS_RAWFORMAT_VERSION:
-			remainder = sizeof(header) - commonlen;
-			break;
-		default:
-			(*callbacks->error)(callbacks,
-					    "dns_master_load: "
-					    "unsupported file format version");
-			return (ISC_R_NOTIMPLEMENTED);
-		}
-
-		result = isc_stdio_read(data + commonlen, 1, remainder,
-					lctx->f, NULL);
-		if (result != ISC_R_SUCCESS) {
-			UNEXPECTED_ERROR(__FILE__, __LINE__,
-					 "isc_stdio_read failed: %s",
-					 isc_result_totext(result));
+		result = load_header(lctx, &header);
+		if (result != ISC_R_SUCCESS)
 			return (result);
-		}
-
-		isc_buffer_add(&target, remainder);
-		header.dumptime = isc_buffer_getuint32(&target);
-		if (header.version == DNS_RAWFORMAT_VERSION) {
-			header.flags = isc_buffer_getuint32(&target);
-			header.sourceserial = isc_buffer_getuint32(&target);
-			header.lastxfrin = isc_buffer_getuint32(&target);
-		}
-
 		lctx->first = ISC_FALSE;
 		lctx->header = header;
 	}
@@ -2425,6 +2511,541 @@ load_raw(dns_loadctx_t *lctx) {
 	return (result);
 }
 
+static isc_result_t
+load_map(dns_loadctx_t *lctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_rdatacallbacks_t *callbacks;
+	dns_masterrawheader_t header;
+	off_t offset;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+	callbacks = lctx->callbacks;
+
+	if (lctx->first) {
+		result = load_header(lctx, &header);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (header.version != DNS_RAWFORMAT_VERSION) {
+			(*callbacks->error)(callbacks,
+					    "dns_master_load: "
+					    "unsupported file format version");
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+		if (callbacks->deserialize == NULL) {
+			(*callbacks->error)(callbacks,
+					    "dns_master_load: "
+					    "map format not supported by "
+					    "this database");
+			return (ISC_R_NOTIMPLEMENTED);
+		}
+
+		lctx->first = ISC_FALSE;
+		lctx->header = header;
+
+		/*
+		 * The rest of the file is the database image, which the
+		 * database maps rather than reads.
+		 */
+		result = isc_stdio_tell(lctx->f, &offset);
+		if (result == ISC_R_SUCCESS)
+			result = (*callbacks->deserialize)
+				(callbacks->deserialize_private,
+				 lctx->f, offset);
+		if (result == ISC_R_SUCCESS && callbacks->rawdata != NULL)
+			(*callbacks->rawdata)(callbacks->zone, &header);
+		if (result != ISC_R_SUCCESS)
+			(*callbacks->error)(callbacks, "dns_master_load: %s",
+					    dns_result_totext(result));
+	}
+
+	return (result);
+}
+
+/*
+ * Parallel loading of large text files.
+ *
+ * split_text() makes one sequential pass over the file, tracking just
+ * enough of the master file syntax (quotes, escapes, comments and
+ * parentheses) to find lines which start a new owner name at the top
+ * level, and the $ORIGIN and $TTL in effect there.  Each chunk is then
+ * parsed by its own load context on a task from the pool, and the
+ * parent's done routine is called from the parent's task once the last
+ * chunk has completed.
+ *
+ * Files which use $INCLUDE or $DATE, or which do not establish a
+ * default TTL before the first split point, are loaded serially.
+ */
+
+static isc_result_t
+split_directive(char *line, dns_name_t *origin, isc_boolean_t *ttl_knownp,
+		isc_uint32_t *ttlp)
+{
+	char *directive, *arg;
+	isc_buffer_t buffer;
+	isc_textregion_t r;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+
+	/*
+	 * Multi-line directives are left to the serial loader.
+	 */
+	if (strchr(line, '(') != NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	directive = line;
+	arg = directive + strcspn(directive, " \t\r");
+	if (*arg != '\0')
+		*arg++ = '\0';
+	arg += strspn(arg, " \t\r");
+	arg[strcspn(arg, " \t\r;")] = '\0';
+
+	if (strcasecmp(directive, "$GENERATE") == 0)
+		return (ISC_R_SUCCESS);
+	if (*arg == '\0' || strpbrk(arg, "\\\"") != NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	if (strcasecmp(directive, "$ORIGIN") == 0) {
+		dns_fixedname_init(&fixed);
+		name = dns_fixedname_name(&fixed);
+		isc_buffer_init(&buffer, arg, strlen(arg));
+		isc_buffer_add(&buffer, strlen(arg));
+		result = dns_name_fromtext(name, &buffer, origin, 0, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (ISC_R_NOTIMPLEMENTED);
+		RUNTIME_CHECK(dns_name_copy(name, origin, NULL)
+			      == ISC_R_SUCCESS);
+		return (ISC_R_SUCCESS);
+	}
+
+	if (strcasecmp(directive, "$TTL") == 0) {
+		r.base = arg;
+		r.length = strlen(arg);
+		result = dns_ttl_fromtext(&r, ttlp);
+		if (result != ISC_R_SUCCESS)
+			return (ISC_R_NOTIMPLEMENTED);
+		if (*ttlp > 0x7fffffffUL)
+			*ttlp = 0;
+		*ttl_knownp = ISC_TRUE;
+		return (ISC_R_SUCCESS);
+	}
+
+	/* $INCLUDE, $DATE and anything we don't know about. */
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+static isc_result_t
+new_chunk(dns_loadctx_t *lctx, loadchunk_head_t *chunks, off_t offset,
+	  unsigned long line, dns_name_t *origin, isc_boolean_t ttl_known,
+	  isc_uint32_t ttl)
+{
+	dns_loadchunk_t *chunk, *last;
+
+	chunk = isc_mem_get(lctx->mctx, sizeof(*chunk));
+	if (chunk == NULL)
+		return (ISC_R_NOMEMORY);
+	chunk->parent = lctx;
+	chunk->offset = offset;
+	chunk->length = 0;
+	chunk->line = line;
+	chunk->ttl_known = ttl_known;
+	chunk->ttl = ttl;
+	dns_fixedname_init(&chunk->origin);
+	RUNTIME_CHECK(dns_name_copy(origin, dns_fixedname_name(&chunk->origin),
+				    NULL) == ISC_R_SUCCESS);
+	chunk->event = NULL;
+	ISC_LINK_INIT(chunk, link);
+
+	last = ISC_LIST_TAIL(*chunks);
+	if (last != NULL)
+		last->length = (size_t)(offset - last->offset);
+	ISC_LIST_APPEND(*chunks, chunk, link);
+	return (ISC_R_SUCCESS);
+}
+
+static void
+free_chunks(isc_mem_t *mctx, loadchunk_head_t *chunks) {
+	dns_loadchunk_t *chunk;
+
+	while ((chunk = ISC_LIST_HEAD(*chunks)) != NULL) {
+		ISC_LIST_UNLINK(*chunks, chunk, link);
+		if (chunk->event != NULL)
+			isc_event_free(&chunk->event);
+		isc_mem_put(mctx, chunk, sizeof(*chunk));
+	}
+}
+
+/*%
+ * Find the chunks 'master_file' can be split into.  '*chunks' is left
+ * empty if the file is too small, or cannot be split.
+ */
+static isc_result_t
+split_text(dns_loadctx_t *lctx, const char *master_file,
+	   unsigned int ntasks, loadchunk_head_t *chunks)
+{
+	FILE *f = NULL;
+	unsigned char *buf = NULL;
+	char directive[1024];
+	size_t dirlen = 0, i, n;
+	off_t size, pos, next, chunksize;
+	unsigned long line = 1;
+	unsigned int paren = 0;
+	isc_boolean_t quote = ISC_FALSE, comment = ISC_FALSE;
+	isc_boolean_t escape = ISC_FALSE, indirective = ISC_FALSE;
+	isc_boolean_t bol = ISC_TRUE, eof = ISC_FALSE;
+	isc_boolean_t ttl_known;
+	isc_uint32_t ttl = 0;
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	isc_result_t result;
+	int c;
+
+	REQUIRE(ISC_LIST_EMPTY(*chunks));
+
+	result = isc_stdio_open(master_file, "rb", &f);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = isc_stdio_seek(f, 0, SEEK_END);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_tell(f, &size);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_seek(f, 0, SEEK_SET);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	if (size < 2 * SPLIT_MINCHUNK)
+		goto cleanup;
+
+	chunksize = size / (4 * ntasks);
+	if (chunksize < SPLIT_MINCHUNK)
+		chunksize = SPLIT_MINCHUNK;
+
+	buf = isc_mem_get(lctx->mctx, TSIZ);
+	if (buf == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	RUNTIME_CHECK(dns_name_copy(lctx->inc->origin, origin, NULL)
+		      == ISC_R_SUCCESS);
+	ttl_known = lctx->default_ttl_known;
+
+	/*
+	 * The first chunk starts with the loader's own initial state.
+	 */
+	result = new_chunk(lctx, chunks, 0, 1, origin, ISC_FALSE, 0);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	pos = 0;
+	next = chunksize;
+	while (!eof) {
+		result = isc_stdio_read(buf, 1, TSIZ, f, &n);
+		if (result == ISC_R_EOF)
+			eof = ISC_TRUE;
+		else if (result != ISC_R_SUCCESS)
+			goto cleanup;
+		for (i = 0; i < n; i++, pos++) {
+			c = buf[i];
+			if (indirective) {
+				if (c != '\n') {
+					if (dirlen == sizeof(directive) - 1)
+						goto nosplit;
+					directive[dirlen++] = c;
+					continue;
+				}
+				directive[dirlen] = '\0';
+				indirective = ISC_FALSE;
+				result = split_directive(directive, origin,
+							 &ttl_known, &ttl);
+				if (result != ISC_R_SUCCESS)
+					goto nosplit;
+			} else if (comment) {
+				if (c != '\n')
+					continue;
+				comment = ISC_FALSE;
+			} else if (escape) {
+				escape = ISC_FALSE;
+				if (c == '\n')
+					line++;
+				continue;
+			} else if (bol) {
+				bol = ISC_FALSE;
+				if (c == '$') {
+					indirective = ISC_TRUE;
+					directive[0] = c;
+					dirlen = 1;
+					continue;
+				}
+				if (pos >= next && ttl_known &&
+				    c != ' ' && c != '\t' && c != '\r' &&
+				    c != '\n' && c != ';' && c != '(' &&
+				    c != ')' && c != '"')
+				{
+					result = new_chunk(lctx, chunks, pos,
+							   line, origin,
+							   ISC_TRUE, ttl);
+					if (result != ISC_R_SUCCESS)
+						goto cleanup;
+					next = pos + chunksize;
+				}
+			}
+
+			switch (c) {
+			case '\n':
+				line++;
+				if (paren == 0 && !quote)
+					bol = ISC_TRUE;
+				break;
+			case ';':
+				if (!quote)
+					comment = ISC_TRUE;
+				break;
+			case '\\':
+				escape = ISC_TRUE;
+				break;
+			case '"':
+				quote = ISC_TF(!quote);
+				break;
+			case '(':
+				if (!quote)
+					paren++;
+				break;
+			case ')':
+				if (!quote && paren > 0)
+					paren--;
+				break;
+			}
+		}
+	}
+
+	/* A file ending in the middle of a directive is left as is. */
+	if (indirective || ISC_LIST_HEAD(*chunks) == ISC_LIST_TAIL(*chunks))
+		goto nosplit;
+	ISC_LIST_TAIL(*chunks)->length =
+		(size_t)(pos - ISC_LIST_TAIL(*chunks)->offset);
+	result = ISC_R_SUCCESS;
+	goto cleanup;
+
+ nosplit:
+	result = ISC_R_SUCCESS;
+	free_chunks(lctx->mctx, chunks);
+
+ cleanup:
+	if (result != ISC_R_SUCCESS)
+		free_chunks(lctx->mctx, chunks);
+	if (buf != NULL)
+		isc_mem_put(lctx->mctx, buf, TSIZ);
+	if (f != NULL)
+		(void)isc_stdio_close(f);
+	return (result);
+}
+
+/*%
+ * Add callback given to the chunks: the real one need not be
+ * thread-safe, so calls to it are serialised.
+ */
+static isc_result_t
+chunk_add(void *arg, dns_name_t *owner, dns_rdataset_t *rdataset) {
+	dns_loadctx_t *lctx = arg;
+	isc_result_t result;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	LOCK(&lctx->lock);
+	result = (*lctx->callbacks->add)(lctx->callbacks->add_private,
+					 owner, rdataset);
+	UNLOCK(&lctx->lock);
+	return (result);
+}
+
+/*%
+ * 'load' method of the parent once all the chunks are done.
+ */
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	return (lctx->result);
+}
+
+static void
+chunk_done(void *arg, isc_result_t result) {
+	dns_loadctx_t *lctx = arg;
+	isc_boolean_t last;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	LOCK(&lctx->lock);
+	if (result != ISC_R_SUCCESS && lctx->result == ISC_R_SUCCESS)
+		lctx->result = result;
+	INSIST(lctx->chunks > 0);
+	last = ISC_TF(--lctx->chunks == 0);
+	UNLOCK(&lctx->lock);
+
+	if (!last)
+		return;
+
+	/*
+	 * Finish on the parent's task, like a serial load would.
+	 */
+	result = task_send(lctx);
+	if (result != ISC_R_SUCCESS) {
+		(lctx->done)(lctx->done_arg, result);
+		dns_loadctx_detach(&lctx);
+	}
+}
+
+/*%
+ * Read a chunk and start loading it on 'task'.
+ */
+static void
+load_chunk(isc_task_t *task, isc_event_t *event) {
+	dns_loadchunk_t *chunk;
+	dns_loadctx_t *parent, *lctx = NULL;
+	isc_buffer_t *buffer = NULL;
+	FILE *f = NULL;
+	isc_result_t result;
+
+	REQUIRE(event != NULL);
+	chunk = event->ev_arg;
+	parent = chunk->parent;
+	REQUIRE(DNS_LCTX_VALID(parent));
+	isc_event_free(&event);
+
+	if (parent->canceled) {
+		result = ISC_R_CANCELED;
+		goto cleanup;
+	}
+
+	result = isc_buffer_allocate(parent->mctx, &buffer,
+				     (unsigned int)chunk->length);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_stdio_open(parent->filename, "rb", &f);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	result = isc_stdio_seek(f, chunk->offset, SEEK_SET);
+	if (result == ISC_R_SUCCESS)
+		result = isc_stdio_read(isc_buffer_base(buffer), 1,
+					chunk->length, f, NULL);
+	(void)isc_stdio_close(f);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	isc_buffer_add(buffer, (unsigned int)chunk->length);
+
+	result = loadctx_create(dns_masterformat_text, parent->mctx,
+				parent->options, parent->resign, parent->top,
+				parent->zclass,
+				dns_fixedname_name(&chunk->origin),
+				&parent->chunkcallbacks, task, chunk_done,
+				parent, NULL, &lctx);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	dns_loadctx_attach(parent, &lctx->parent);
+	if (chunk->ttl_known) {
+		lctx->ttl_known = ISC_TRUE;
+		lctx->ttl = chunk->ttl;
+		lctx->default_ttl_known = ISC_TRUE;
+		lctx->default_ttl = chunk->ttl;
+	}
+
+	result = isc_lex_openbuffer(lctx->lex, buffer);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+	lctx->buffer = buffer;
+	buffer = NULL;
+	RUNTIME_CHECK(isc_lex_setsourcename(lctx->lex, parent->filename)
+		      == ISC_R_SUCCESS);
+	RUNTIME_CHECK(isc_lex_setsourceline(lctx->lex, chunk->line)
+		      == ISC_R_SUCCESS);
+
+	result = task_send(lctx);
+	if (result == ISC_R_SUCCESS) {
+		/* chunk_done() will be called from load_quantum(). */
+		isc_mem_put(parent->mctx, chunk, sizeof(*chunk));
+		return;
+	}
+
+ cleanup:
+	if (lctx != NULL)
+		dns_loadctx_detach(&lctx);
+	if (buffer != NULL)
+		isc_buffer_free(&buffer);
+	isc_mem_put(parent->mctx, chunk, sizeof(*chunk));
+	chunk_done(parent, result);
+}
+
+/*%
+ * Try to load 'master_file' in chunks on the tasks of 'pool'.  On
+ * success '*splitp' says whether the load was started that way.
+ */
+static isc_result_t
+load_split(dns_loadctx_t *lctx, const char *master_file,
+	   isc_taskpool_t *pool, isc_boolean_t *splitp)
+{
+	loadchunk_head_t chunks;
+	dns_loadchunk_t *chunk;
+	isc_event_t *event;
+	isc_task_t *task;
+	isc_result_t result;
+	unsigned int count = 0;
+
+	*splitp = ISC_FALSE;
+	ISC_LIST_INIT(chunks);
+
+	result = split_text(lctx, master_file, isc_taskpool_size(pool),
+			    &chunks);
+	if (result != ISC_R_SUCCESS || ISC_LIST_EMPTY(chunks))
+		return (result);
+
+	lctx->filename = isc_mem_strdup(lctx->mctx, master_file);
+	if (lctx->filename == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+
+	/*
+	 * Allocate all the events first so that once the chunks are
+	 * sent nothing can fail.
+	 */
+	for (chunk = ISC_LIST_HEAD(chunks);
+	     chunk != NULL;
+	     chunk = ISC_LIST_NEXT(chunk, link))
+	{
+		chunk->event = isc_event_allocate(lctx->mctx, NULL,
+						  DNS_EVENT_MASTERQUANTUM,
+						  load_chunk, chunk,
+						  sizeof(isc_event_t));
+		if (chunk->event == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		count++;
+	}
+
+	lctx->chunkcallbacks = *lctx->callbacks;
+	lctx->chunkcallbacks.add = chunk_add;
+	lctx->chunkcallbacks.add_private = lctx;
+	lctx->chunks = count;
+	lctx->load = load_parallel;
+
+	while ((chunk = ISC_LIST_HEAD(chunks)) != NULL) {
+		ISC_LIST_UNLINK(chunks, chunk, link);
+		event = chunk->event;
+		chunk->event = NULL;
+		task = NULL;
+		isc_taskpool_gettask(pool, &task);
+		isc_task_send(task, &event);
+		isc_task_detach(&task);
+	}
+	*splitp = ISC_TRUE;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	free_chunks(lctx->mctx, &chunks);
+	return (result);
+}
+
 isc_result_t
 dns_master_loadfile(const char *master_file, dns_name_t *top,
 		    dns_name_t *origin,
@@ -2508,8 +3129,24 @@ dns_master_loadfileinc3(const char *master_file, dns_name_t *top,
 			dns_loaddonefunc_t done, void *done_arg,
 			dns_loadctx_t **lctxp, isc_mem_t *mctx,
 			dns_masterformat_t format)
+{
+	return (dns_master_loadfileinc4(master_file, top, origin, zclass,
+					options, resign, callbacks, task,
+					done, done_arg, lctxp, mctx, format,
+					NULL));
+}
+
+isc_result_t
+dns_master_loadfileinc4(const char *master_file, dns_name_t *top,
+			dns_name_t *origin, dns_rdataclass_t zclass,
+			unsigned int options, isc_uint32_t resign,
+			dns_rdatacallbacks_t *callbacks, isc_task_t *task,
+			dns_loaddonefunc_t done, void *done_arg,
+			dns_loadctx_t **lctxp, isc_mem_t *mctx,
+			dns_masterformat_t format, isc_taskpool_t *pool)
 {
 	dns_loadctx_t *lctx = NULL;
+	isc_boolean_t split = ISC_FALSE;
 	isc_result_t result;
 
 	REQUIRE(task != NULL);
@@ -2521,16 +3158,25 @@ dns_master_loadfileinc3(const char *master_file, dns_name_t *top,
 	if (result != ISC_R_SUCCESS)
 		return (result);
 
-	result = (lctx->openfile)(lctx, master_file);
-	if (result != ISC_R_SUCCESS)
-		goto cleanup;
+	if (format == dns_masterformat_text && pool != NULL) {
+		result = load_split(lctx, master_file, pool, &split);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
 
-	result = task_send(lctx);
-	if (result == ISC_R_SUCCESS) {
-		dns_loadctx_attach(lctx, lctxp);
-		return (DNS_R_CONTINUE);
+	if (!split) {
+		result = (lctx->openfile)(lctx, master_file);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+
+		result = task_send(lctx);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
 	}
 
+	dns_loadctx_attach(lctx, lctxp);
+	return (DNS_R_CONTINUE);
+
  cleanup:
 	dns_loadctx_detach(&lctx);
 	return (result);
@@ -2963,7 +3609,8 @@ load_quantum(isc_task_t *task, isc_event_t *event) {
 	lctx = event->ev_arg;
 	REQUIRE(DNS_LCTX_VALID(lctx));
 
-	if (lctx->canceled)
+	if (lctx->canceled ||
+	    (lctx->parent != NULL && lctx->parent->canceled))
 		result = ISC_R_CANCELED;
 	else
 		result = (lctx->load)(lctx);
@@ -1089,6 +1089,25 @@ dump_rdatasets_raw(isc_mem_t *mctx, dns_name_t *name,
 	return (result);
 }
 
+/*
+ * The "map" format is written as a whole by the database, see
+ * dumptostreaminc(); it is never dumped an rdataset at a time.
+ */
+static isc_result_t
+dump_rdatasets_map(isc_mem_t *mctx, dns_name_t *name,
+		   dns_rdatasetiter_t *rdsiter, dns_totext_ctx_t *ctx,
+		   isc_buffer_t *buffer, FILE *f)
+{
+	UNUSED(mctx);
+	UNUSED(name);
+	UNUSED(rdsiter);
+	UNUSED(ctx);
+	UNUSED(buffer);
+	UNUSED(f);
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 /*
  * Initial size of text conversion buffer.  The buffer is used
  * for several purposes: converting origin names, rdatasets,
@@ -1331,6 +1350,9 @@ dumpctx_create(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	case dns_masterformat_raw:
 		dctx->dumpsets = dump_rdatasets_raw;
 		break;
+	case dns_masterformat_map:
+		dctx->dumpsets = dump_rdatasets_map;
+		break;
 	default:
 		INSIST(0);
 		break;
@@ -1422,6 +1444,7 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			}
 			break;
 		case dns_masterformat_raw:
+		case dns_masterformat_map:
 			r.base = (unsigned char *)&rawheader;
 			r.length = sizeof(rawheader);
 			isc_buffer_region(&buffer, &r);
@@ -1444,9 +1467,10 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			now32 = dctx->now;
 #endif
 			rawversion = 1;
-			if ((dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
+			if (dctx->format == dns_masterformat_raw &&
+			    (dctx->header.flags & DNS_MASTERRAW_COMPAT) != 0)
 				rawversion = 0;
-			isc_buffer_putuint32(&buffer, dns_masterformat_raw);
+			isc_buffer_putuint32(&buffer, dctx->format);
 			isc_buffer_putuint32(&buffer, rawversion);
 			isc_buffer_putuint32(&buffer, now32);
 
@@ -1472,6 +1496,17 @@ dumptostreaminc(dns_dumpctx_t *dctx) {
 			INSIST(0);
 		}
 
+		if (dctx->format == dns_masterformat_map) {
+			/*
+			 * The database writes its own image after the
+			 * header, all at once.
+			 */
+			dctx->first = ISC_FALSE;
+			result = dns_db_serialize(dctx->db, dctx->version,
+						  dctx->f);
+			goto fail;
+		}
+
 		result = dns_dbiterator_first(dctx->dbiter);
 		dctx->first = ISC_FALSE;
 	} else
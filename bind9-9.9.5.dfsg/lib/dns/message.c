@@ -2069,6 +2069,65 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_message_renderrdata(dns_message_t *msg, dns_section_t sectionid,
+			dns_name_t *owner, dns_ttl_t ttl, dns_rdata_t *rdata)
+{
+	isc_buffer_t st; /* for rollbacks */
+	isc_buffer_t rdlen;
+	isc_region_t r;
+	isc_result_t result;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(sectionid != DNS_SECTION_QUESTION);
+	REQUIRE(owner != NULL && rdata != NULL);
+
+	/*
+	 * Shrink the space in the buffer by the reserved amount.
+	 */
+	msg->buffer->length -= msg->reserved;
+	st = *(msg->buffer);
+
+	dns_compress_setmethods(msg->cctx, DNS_COMPRESS_GLOBAL14);
+	result = dns_name_towire(owner, msg->cctx, msg->buffer);
+	if (result != ISC_R_SUCCESS)
+		goto rollback;
+	isc_buffer_availableregion(msg->buffer, &r);
+	if (r.length < 2 + 2 + 4 + 2) {
+		result = ISC_R_NOSPACE;
+		goto rollback;
+	}
+	isc_buffer_putuint16(msg->buffer, rdata->type);
+	isc_buffer_putuint16(msg->buffer, rdata->rdclass);
+	isc_buffer_putuint32(msg->buffer, ttl);
+
+	/*
+	 * Save space for rdlen.
+	 */
+	rdlen = *(msg->buffer);
+	isc_buffer_add(msg->buffer, 2);
+	result = dns_rdata_towire(rdata, msg->cctx, msg->buffer);
+	if (result != ISC_R_SUCCESS)
+		goto rollback;
+	INSIST((msg->buffer->used >= rdlen.used + 2) &&
+	       (msg->buffer->used - rdlen.used - 2 < 65536));
+	isc_buffer_putuint16(&rdlen, (isc_uint16_t)(msg->buffer->used -
+						    rdlen.used - 2));
+
+	msg->buffer->length += msg->reserved;
+	msg->counts[sectionid]++;
+	return (ISC_R_SUCCESS);
+
+ rollback:
+	INSIST(st.used < 65536);
+	dns_compress_rollback(msg->cctx, (isc_uint16_t)st.used);
+	*(msg->buffer) = st;
+	msg->buffer->length += msg->reserved;
+	return (result);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	isc_uint16_t tmp;
@@ -503,6 +503,7 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	NULL,
 	NULL,
 	rdataset_settrust,
+	NULL,
 	NULL
 };
 
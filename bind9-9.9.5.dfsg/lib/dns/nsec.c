@@ -26,6 +26,7 @@
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/nsec.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
@@ -449,3 +450,181 @@ dns_nsec_noexistnodata(dns_rdatatype_t type, dns_name_t *name,
 	*exists = ISC_FALSE;
 	return (ISC_R_SUCCESS);
 }
+
+/*%
+ * Find the NSEC record in the cache at 'name', or failing that the one
+ * at the closest predecessor of 'name'.  The NSEC and its signature
+ * must have been validated, and 'name' must be within the zone that
+ * signed them.  On success 'owner' is the owner of the NSEC and
+ * 'signer' the signing zone.
+ */
+static isc_result_t
+findcoveringnsec(dns_db_t *db, dns_name_t *name, isc_stdtime_t now,
+		 dns_name_t *owner, dns_name_t *signer,
+		 dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset)
+{
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_rrsig_t rrsig;
+	isc_result_t result;
+
+	result = dns_db_find(db, name, NULL, dns_rdatatype_nsec,
+			     DNS_DBFIND_COVERINGNSEC, now, &node, owner,
+			     rdataset, sigrdataset);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+	if (result != ISC_R_SUCCESS && result != DNS_R_COVERINGNSEC)
+		goto failure;
+
+	if (rdataset->trust != dns_trust_secure ||
+	    !dns_rdataset_isassociated(sigrdataset) ||
+	    sigrdataset->trust != dns_trust_secure)
+		goto failure;
+
+	result = dns_rdataset_first(sigrdataset);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	dns_rdataset_current(sigrdataset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &rrsig, NULL);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	if (dns_name_issubdomain(name, &rrsig.signer) &&
+	    dns_name_issubdomain(owner, &rrsig.signer))
+		result = dns_name_copy(&rrsig.signer, signer, NULL);
+	else
+		result = ISC_R_NOTFOUND;
+	dns_rdata_freestruct(&rrsig);
+	if (result == ISC_R_SUCCESS)
+		return (ISC_R_SUCCESS);
+
+ failure:
+	if (dns_rdataset_isassociated(rdataset))
+		dns_rdataset_disassociate(rdataset);
+	if (dns_rdataset_isassociated(sigrdataset))
+		dns_rdataset_disassociate(sigrdataset);
+	return (ISC_R_NOTFOUND);
+}
+
+isc_result_t
+dns_nsec_synthnegative(dns_db_t *db, dns_name_t *name, dns_rdatatype_t type,
+		       isc_stdtime_t now, dns_name_t *owner,
+		       dns_rdataset_t *nsecset, dns_rdataset_t *nsecsig,
+		       dns_name_t *wowner, dns_rdataset_t *wnsecset,
+		       dns_rdataset_t *wnsecsig, dns_name_t *soaname,
+		       dns_rdataset_t *soaset, dns_rdataset_t *soasig,
+		       dns_nseclog_t logit, void *arg)
+{
+	dns_fixedname_t fsigner, fwild, fwsigner;
+	dns_name_t *signer, *wild, *wsigner;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_soa_t soa;
+	dns_dbnode_t *node = NULL;
+	isc_boolean_t exists, data, nxdomain;
+	dns_ttl_t ttl;
+	isc_result_t result;
+
+	REQUIRE(db != NULL && dns_db_iscache(db));
+
+	dns_fixedname_init(&fsigner);
+	signer = dns_fixedname_name(&fsigner);
+	dns_fixedname_init(&fwild);
+	wild = dns_fixedname_name(&fwild);
+	dns_fixedname_init(&fwsigner);
+	wsigner = dns_fixedname_name(&fwsigner);
+
+	result = findcoveringnsec(db, name, now, owner, signer,
+				  nsecset, nsecsig);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+
+	exists = ISC_FALSE;
+	data = ISC_FALSE;
+	result = dns_nsec_noexistnodata(type, name, owner, nsecset,
+					&exists, &data, wild, logit, arg);
+	if (result != ISC_R_SUCCESS || data)
+		goto failure;
+
+	if (exists) {
+		/*
+		 * The NSEC lists every type at the name, but "no ANY
+		 * records" is not something it can prove.
+		 */
+		if (type == dns_rdatatype_any)
+			goto failure;
+		nxdomain = ISC_FALSE;
+	} else {
+		/*
+		 * A DNAME at an ancestor of 'name' would redirect the query
+		 * rather than prove that the name does not exist.
+		 */
+		result = dns_rdataset_first(nsecset);
+		if (result != ISC_R_SUCCESS)
+			goto failure;
+		dns_rdataset_current(nsecset, &rdata);
+		if (dns_name_issubdomain(name, owner) &&
+		    dns_nsec_typepresent(&rdata, dns_rdatatype_dname))
+			goto failure;
+
+		/*
+		 * A wildcard at the closest encloser could still match.
+		 */
+		result = findcoveringnsec(db, wild, now, wowner, wsigner,
+					  wnsecset, wnsecsig);
+		if (result != ISC_R_SUCCESS || !dns_name_equal(signer, wsigner))
+			goto failure;
+		result = dns_nsec_noexistnodata(type, wild, wowner, wnsecset,
+						&exists, &data, NULL,
+						logit, arg);
+		if (result != ISC_R_SUCCESS || exists)
+			goto failure;
+		nxdomain = ISC_TRUE;
+	}
+
+	result = dns_db_find(db, signer, NULL, dns_rdatatype_soa, 0, now,
+			     &node, soaname, soaset, soasig);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+	if (result != ISC_R_SUCCESS || soaset->trust != dns_trust_secure)
+		goto failure;
+
+	/*
+	 * The negative TTL is limited by the SOA MINIMUM as well as by
+	 * what is left of the TTLs of the records the answer is made of.
+	 */
+	dns_rdata_reset(&rdata);
+	result = dns_rdataset_first(soaset);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	dns_rdataset_current(soaset, &rdata);
+	result = dns_rdata_tostruct(&rdata, &soa, NULL);
+	if (result != ISC_R_SUCCESS)
+		goto failure;
+	ttl = ISC_MIN(soaset->ttl, soa.minimum);
+	dns_rdata_freestruct(&soa);
+	ttl = ISC_MIN(ttl, nsecset->ttl);
+	if (nxdomain)
+		ttl = ISC_MIN(ttl, wnsecset->ttl);
+	soaset->ttl = ttl;
+	if (dns_rdataset_isassociated(soasig))
+		soasig->ttl = ttl;
+	nsecset->ttl = nsecsig->ttl = ttl;
+	if (nxdomain)
+		wnsecset->ttl = wnsecsig->ttl = ttl;
+
+	return (nxdomain ? DNS_R_NXDOMAIN : DNS_R_NXRRSET);
+
+ failure:
+	if (dns_rdataset_isassociated(nsecset))
+		dns_rdataset_disassociate(nsecset);
+	if (dns_rdataset_isassociated(nsecsig))
+		dns_rdataset_disassociate(nsecsig);
+	if (dns_rdataset_isassociated(wnsecset))
+		dns_rdataset_disassociate(wnsecset);
+	if (dns_rdataset_isassociated(wnsecsig))
+		dns_rdataset_disassociate(wnsecsig);
+	if (dns_rdataset_isassociated(soaset))
+		dns_rdataset_disassociate(soaset);
+	if (dns_rdataset_isassociated(soasig))
+		dns_rdataset_disassociate(soasig);
+	return (ISC_R_NOTFOUND);
+}
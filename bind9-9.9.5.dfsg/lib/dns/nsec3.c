@@ -54,6 +54,11 @@
 #define INITIAL(x) (((x) & DNS_NSEC3FLAG_INITIAL) != 0)
 #define REMOVE(x) (((x) & DNS_NSEC3FLAG_REMOVE) != 0)
 
+/*%
+ * Number of names handed to isc_iterated_hash_batch() at a time.
+ */
+#define HASHBATCH 16
+
 isc_result_t
 dns_nsec3_buildrdata(dns_db_t *db, dns_dbversion_t *version,
 		     dns_dbnode_t *node, unsigned int hashalg,
@@ -219,6 +224,29 @@ dns_nsec3_typepresent(dns_rdata_t *rdata, dns_rdatatype_t type) {
 	return (present);
 }
 
+/*
+ * Convert the raw hash 'hash' to its base32hex owner name under 'origin'.
+ */
+static isc_result_t
+hashtoname(dns_fixedname_t *result, unsigned char *hash, size_t len,
+	   dns_name_t *origin)
+{
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	isc_buffer_t namebuffer;
+	isc_region_t region;
+
+	/* convert the hash to base32hex */
+	region.base = hash;
+	region.length = (unsigned int)len;
+	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
+	isc_base32hex_totext(&region, 1, "", &namebuffer);
+
+	/* convert the hex to a domain name */
+	dns_fixedname_init(result);
+	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
+				  origin, 0, NULL));
+}
+
 isc_result_t
 dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
@@ -227,11 +255,8 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 		   const unsigned char *salt, size_t saltlength)
 {
 	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
-	unsigned char nametext[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t fixed;
 	dns_name_t *downcased;
-	isc_buffer_t namebuffer;
-	isc_region_t region;
 	size_t len;
 
 	if (rethash == NULL)
@@ -253,16 +278,62 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 	if (hash_length != NULL)
 		*hash_length = len;
 
-	/* convert the hash to base32hex */
-	region.base = rethash;
-	region.length = (unsigned int)len;
-	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
-	isc_base32hex_totext(&region, 1, "", &namebuffer);
+	return (hashtoname(result, rethash, len, origin));
+}
 
-	/* convert the hex to a domain name */
-	dns_fixedname_init(result);
-	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
-				  origin, 0, NULL));
+isc_result_t
+dns_nsec3_hashnames(dns_fixedname_t *results, unsigned char **rethashes,
+		    size_t *hash_length, dns_name_t **names,
+		    unsigned int count, dns_name_t *origin,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength)
+{
+	unsigned char hashes[HASHBATCH][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[HASHBATCH];
+	const unsigned char *in[HASHBATCH];
+	int inlength[HASHBATCH];
+	dns_fixedname_t fixed[HASHBATCH];
+	dns_name_t *downcased;
+	isc_result_t result;
+	unsigned int i, j, n;
+	size_t len = 0;
+
+	REQUIRE(results != NULL);
+	REQUIRE(names != NULL || count == 0);
+
+	for (i = 0; i < count; i += n) {
+		n = ISC_MIN(count - i, HASHBATCH);
+		for (j = 0; j < n; j++) {
+			if (rethashes != NULL)
+				out[j] = rethashes[i + j];
+			else
+				out[j] = hashes[j];
+			memset(out[j], 0, NSEC3_MAX_HASH_LENGTH);
+			dns_fixedname_init(&fixed[j]);
+			downcased = dns_fixedname_name(&fixed[j]);
+			dns_name_downcase(names[i + j], downcased, NULL);
+			in[j] = downcased->ndata;
+			inlength[j] = downcased->length;
+		}
+
+		len = isc_iterated_hash_batch(out, hashalg, iterations,
+					      salt, (int)saltlength,
+					      in, inlength, n);
+		if (len == 0U)
+			return (DNS_R_BADALG);
+
+		for (j = 0; j < n; j++) {
+			result = hashtoname(&results[i + j], out[j], len,
+					    origin);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
+	}
+
+	if (hash_length != NULL)
+		*hash_length = len;
+
+	return (ISC_R_SUCCESS);
 }
 
 unsigned int
@@ -23,10 +23,15 @@
 
 #include <config.h>
 
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h> /* uintptr_t */
+#endif
+
 #include <isc/mem.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/refcount.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
@@ -54,6 +59,13 @@
 
 #define RBT_HASH_SIZE           64
 
+#define CHECK(x) \
+	do { \
+		result = (x); \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup; \
+	} while (0)
+
 #ifdef RBT_MEM_TEST
 #undef RBT_HASH_SIZE
 #define RBT_HASH_SIZE 2 /*%< To give the reallocation code a workout. */
@@ -83,6 +95,7 @@ struct dns_rbt {
 #define DATA(node)              ((node)->data)
 #define HASHNEXT(node)          ((node)->hashnext)
 #define HASHVAL(node)           ((node)->hashval)
+#define UPPERNODE(node)         ((node)->uppernode)
 #define COLOR(node)             ((node)->color)
 #define NAMELEN(node)           ((node)->namelen)
 #define OLDNAMELEN(node)        ((node)->oldnamelen)
@@ -90,6 +103,7 @@ struct dns_rbt {
 #define ATTRS(node)             ((node)->attributes)
 #define IS_ROOT(node)           ISC_TF((node)->is_root == 1)
 #define FINDCALLBACK(node)      ISC_TF((node)->find_callback == 1)
+#define IS_MMAPPED(node)        ISC_TF((node)->is_mmapped == 1)
 
 /*%
  * Structure elements from the rbtdb.c, not
@@ -179,17 +193,23 @@ static void dns_rbt_printnodename(dns_rbtnode_t *node);
 
 static inline dns_rbtnode_t *
 find_up(dns_rbtnode_t *node) {
+#ifndef DNS_RBT_USEHASH
 	dns_rbtnode_t *root;
+#endif
 
 	/*
 	 * Return the node in the level above the argument node that points
 	 * to the level the argument node is in.  If the argument node is in
 	 * the top level, the return value is NULL.
 	 */
+#ifdef DNS_RBT_USEHASH
+	return (UPPERNODE(node));
+#else
 	for (root = node; ! IS_ROOT(root); root = PARENT(root))
 		; /* Nothing. */
 
 	return (PARENT(root));
+#endif
 }
 
 /*
@@ -311,6 +331,338 @@ dns_rbt_nodecount(dns_rbt_t *rbt) {
 	return (rbt->nodecount);
 }
 
+/*
+ * Map file support.
+ *
+ * A serialized tree is a header followed by the nodes, each written
+ * together with its name and offsets exactly as it is laid out in memory,
+ * and the data hanging off them.  Every pointer is written as the offset
+ * of its target from the start of the file, so that once the file has
+ * been mapped the nodes can be used in place after turning the offsets
+ * back into pointers.  Hash chains, lock numbers and reference counts
+ * are not written; they are rebuilt when the tree is loaded.
+ */
+#define RBT_MAP_VERSION		"BIND9 rbt map 1"
+#define RBT_MAP_ENDIAN		0x01020304U
+
+typedef struct file_header {
+	char			version[32];
+	isc_uint32_t		ptrsize;
+	isc_uint32_t		nodesize;
+	isc_uint32_t		endian;
+	isc_uint32_t		nodecount;
+	isc_uint64_t		first_node_offset;
+} file_header_t;
+
+off_t
+dns_rbt_serialize_align(off_t target) {
+	off_t offset;
+
+	offset = target % sizeof(isc_uint64_t);
+	if (offset == 0)
+		return (target);
+	return (target + sizeof(isc_uint64_t) - offset);
+}
+
+/*
+ * Move to the next aligned position at the end of 'file'.  Seeking past
+ * the end leaves a hole that reads back as zeros once something is
+ * written after it, which is always the case here.
+ */
+static isc_result_t
+align_file(FILE *file, off_t *offsetp) {
+	isc_result_t result;
+	off_t offset;
+
+	result = isc_stdio_tell(file, &offset);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	offset = dns_rbt_serialize_align(offset);
+	if ((off_t)(uintptr_t)offset != offset)
+		return (ISC_R_RANGE);
+	result = isc_stdio_seek(file, offset, SEEK_SET);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	*offsetp = offset;
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+serialize_node(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
+	       uintptr_t left, uintptr_t right, uintptr_t down,
+	       uintptr_t upper, uintptr_t data)
+{
+	dns_rbtnode_t temp;
+	isc_result_t result;
+
+	memset(&temp, 0, sizeof(temp));
+	temp.is_root = node->is_root;
+	temp.color = node->color;
+	temp.find_callback = node->find_callback;
+	temp.attributes = node->attributes;
+	temp.nsec = node->nsec;
+	temp.wild = node->wild;
+	temp.namelen = node->namelen;
+	temp.offsetlen = node->offsetlen;
+	temp.oldnamelen = node->oldnamelen;
+	temp.parent = (dns_rbtnode_t *)parent;
+	temp.left = (dns_rbtnode_t *)left;
+	temp.right = (dns_rbtnode_t *)right;
+	temp.down = (dns_rbtnode_t *)down;
+#ifdef DNS_RBT_USEHASH
+	temp.uppernode = (dns_rbtnode_t *)upper;
+#else
+	UNUSED(upper);
+#endif
+	temp.data = (void *)data;
+
+	result = isc_stdio_write(&temp, sizeof(temp), 1, file, NULL);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	return (isc_stdio_write(NAME(node), NODE_SIZE(node) - sizeof(*node),
+				1, file, NULL));
+}
+
+/*
+ * Write 'node' and everything below and beside it.  The node is written
+ * before its children so that it comes first in the file, and rewritten
+ * once the offsets of its children and data are known.
+ */
+static isc_result_t
+serialize_nodes(FILE *file, dns_rbtnode_t *node, uintptr_t parent,
+		uintptr_t upper, dns_rbtdatawriter_t datawriter,
+		void *writer_arg, uintptr_t *where)
+{
+	uintptr_t left = 0, right = 0, down = 0, data = 0;
+	off_t position, end, dataoffset;
+	isc_result_t result;
+
+	if (node == NULL) {
+		*where = 0;
+		return (ISC_R_SUCCESS);
+	}
+
+	CHECK(align_file(file, &position));
+	CHECK(serialize_node(file, node, 0, 0, 0, 0, 0, 0));
+
+	CHECK(serialize_nodes(file, LEFT(node), (uintptr_t)position, upper,
+			      datawriter, writer_arg, &left));
+	CHECK(serialize_nodes(file, RIGHT(node), (uintptr_t)position, upper,
+			      datawriter, writer_arg, &right));
+	CHECK(serialize_nodes(file, DOWN(node), (uintptr_t)position,
+			      (uintptr_t)position, datawriter, writer_arg,
+			      &down));
+
+	if (DATA(node) != NULL) {
+		CHECK(align_file(file, &dataoffset));
+		CHECK((datawriter)(file, DATA(node), writer_arg, &dataoffset));
+		data = (uintptr_t)dataoffset;
+	}
+
+	CHECK(isc_stdio_tell(file, &end));
+	CHECK(isc_stdio_seek(file, position, SEEK_SET));
+	CHECK(serialize_node(file, node, parent, left, right, down, upper,
+			     data));
+	CHECK(isc_stdio_seek(file, end, SEEK_SET));
+
+	*where = (uintptr_t)position;
+
+ cleanup:
+	return (result);
+}
+
+isc_result_t
+dns_rbt_serialize_tree(FILE *file, dns_rbt_t *rbt,
+		       dns_rbtdatawriter_t datawriter, void *writer_arg,
+		       off_t *offset)
+{
+	file_header_t header;
+	off_t position, end;
+	uintptr_t first;
+	isc_result_t result;
+
+	REQUIRE(file != NULL);
+	REQUIRE(VALID_RBT(rbt));
+	REQUIRE(datawriter != NULL);
+	REQUIRE(offset != NULL);
+
+	memset(&header, 0, sizeof(header));
+	CHECK(align_file(file, &position));
+	CHECK(isc_stdio_write(&header, sizeof(header), 1, file, NULL));
+
+	CHECK(serialize_nodes(file, rbt->root, 0, 0, datawriter, writer_arg,
+			      &first));
+
+	strncpy(header.version, RBT_MAP_VERSION, sizeof(header.version));
+	header.ptrsize = sizeof(void *);
+	header.nodesize = sizeof(dns_rbtnode_t);
+	header.endian = RBT_MAP_ENDIAN;
+	header.nodecount = rbt->nodecount;
+	header.first_node_offset = first;
+
+	CHECK(isc_stdio_tell(file, &end));
+	CHECK(isc_stdio_seek(file, position, SEEK_SET));
+	CHECK(isc_stdio_write(&header, sizeof(header), 1, file, NULL));
+	CHECK(isc_stdio_seek(file, end, SEEK_SET));
+
+	*offset = position;
+
+ cleanup:
+	return (result);
+}
+
+/*
+ * Turn the offset in 'ptr' back into a pointer into the mapped file,
+ * making sure an object of 'size' bytes there would lie inside it.
+ */
+#define FIXUP(ptr, type, size) \
+	do { \
+		uintptr_t o = (uintptr_t)(ptr); \
+		if (o != 0) { \
+			if (o >= filesize || filesize - o < (size)) \
+				return (ISC_R_INVALIDFILE); \
+			(ptr) = (type)((unsigned char *)base + o); \
+		} \
+	} while (0)
+
+static isc_result_t
+treefix(dns_rbt_t *rbt, void *base, size_t filesize, dns_rbtnode_t *n,
+	dns_name_t *name, dns_rbtdatafixer_t datafixer, void *fixer_arg,
+	unsigned int maxnodes)
+{
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t nodename, *fullname;
+	size_t offset;
+
+	if (n == NULL)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * The node was checked to fit when its offset was fixed up;
+	 * check that its name and offsets do as well.
+	 */
+	if (rbt->nodecount >= maxnodes)
+		return (ISC_R_INVALIDFILE);
+	offset = (unsigned char *)n - (unsigned char *)base;
+	if (filesize - offset < sizeof(*n) + OLDNAMELEN(n) + 1 ||
+	    filesize - offset < NODE_SIZE(n) ||
+	    NAMELEN(n) == 0 || NAMELEN(n) > OLDNAMELEN(n) ||
+	    OFFSETLEN(n) == 0 || OFFSETLEN(n) > OLDOFFSETLEN(n))
+		return (ISC_R_INVALIDFILE);
+
+	FIXUP(PARENT(n), dns_rbtnode_t *, sizeof(*n));
+	FIXUP(LEFT(n), dns_rbtnode_t *, sizeof(*n));
+	FIXUP(RIGHT(n), dns_rbtnode_t *, sizeof(*n));
+	FIXUP(DOWN(n), dns_rbtnode_t *, sizeof(*n));
+#ifdef DNS_RBT_USEHASH
+	FIXUP(UPPERNODE(n), dns_rbtnode_t *, sizeof(*n));
+	HASHNEXT(n) = NULL;
+#endif
+	FIXUP(DATA(n), void *, 1);
+
+	ISC_LINK_INIT(n, deadlink);
+	DIRTY(n) = 0;
+	LOCKNUM(n) = 0;
+	n->is_mmapped = 1;
+	dns_rbtnode_refinit(n, 0);
+#if DNS_RBT_USEMAGIC
+	n->magic = DNS_RBTNODE_MAGIC;
+#endif
+
+	dns_name_init(&nodename, NULL);
+	NODENAME(n, &nodename);
+	if (name == NULL) {
+		if (!dns_name_isabsolute(&nodename))
+			return (ISC_R_INVALIDFILE);
+		fullname = &nodename;
+	} else {
+		dns_fixedname_init(&fixed);
+		fullname = dns_fixedname_name(&fixed);
+		result = dns_name_concatenate(&nodename, name, fullname, NULL);
+		if (result != ISC_R_SUCCESS)
+			return (ISC_R_INVALIDFILE);
+	}
+
+	hash_node(rbt, n, fullname);
+	rbt->nodecount++;
+
+	if (datafixer != NULL) {
+		result = (datafixer)(n, base, filesize, fixer_arg);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	result = treefix(rbt, base, filesize, LEFT(n), name,
+			 datafixer, fixer_arg, maxnodes);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = treefix(rbt, base, filesize, RIGHT(n), name,
+			 datafixer, fixer_arg, maxnodes);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	return (treefix(rbt, base, filesize, DOWN(n), fullname,
+			datafixer, fixer_arg, maxnodes));
+}
+
+isc_result_t
+dns_rbt_deserialize_tree(void *base_address, size_t filesize,
+			 off_t header_offset, isc_mem_t *mctx,
+			 void (*deleter)(void *, void *), void *deleter_arg,
+			 dns_rbtdatafixer_t datafixer, void *fixer_arg,
+			 dns_rbt_t **rbtp)
+{
+	isc_result_t result;
+	file_header_t *header;
+	dns_rbt_t *rbt = NULL;
+	uintptr_t first;
+
+	REQUIRE(base_address != NULL);
+	REQUIRE(rbtp != NULL && *rbtp == NULL);
+
+	if (header_offset < 0 || (size_t)header_offset > filesize ||
+	    filesize - header_offset < sizeof(*header))
+		return (ISC_R_INVALIDFILE);
+
+	header = (file_header_t *)((unsigned char *)base_address +
+				   header_offset);
+	if (strncmp(header->version, RBT_MAP_VERSION,
+		    sizeof(header->version)) != 0 ||
+	    header->ptrsize != sizeof(void *) ||
+	    header->nodesize != sizeof(dns_rbtnode_t) ||
+	    header->endian != RBT_MAP_ENDIAN)
+		return (ISC_R_INVALIDFILE);
+
+	first = (uintptr_t)header->first_node_offset;
+	if ((isc_uint64_t)first != header->first_node_offset ||
+	    first >= filesize || filesize - first < sizeof(dns_rbtnode_t))
+		return (ISC_R_INVALIDFILE);
+
+	result = dns_rbt_create(mctx, deleter, deleter_arg, &rbt);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (first != 0)
+		rbt->root = (dns_rbtnode_t *)((unsigned char *)base_address +
+					      first);
+	result = treefix(rbt, base_address, filesize, rbt->root, NULL,
+			 datafixer, fixer_arg, header->nodecount);
+	if (result == ISC_R_SUCCESS && rbt->nodecount != header->nodecount)
+		result = ISC_R_INVALIDFILE;
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * The nodes belong to the mapping; just forget them.
+		 */
+		rbt->root = NULL;
+		rbt->nodecount = 0;
+		dns_rbt_destroy(&rbt);
+		return (result);
+	}
+
+	*rbtp = rbt;
+	return (ISC_R_SUCCESS);
+}
+
 static inline isc_result_t
 chain_name(dns_rbtnodechain_t *chain, dns_name_t *name,
 	   isc_boolean_t include_chain_end)
@@ -546,6 +898,9 @@ dns_rbt_addnode(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 				LEFT(new_current)    = LEFT(current);
 				RIGHT(new_current)   = RIGHT(current);
 				COLOR(new_current)   = COLOR(current);
+#ifdef DNS_RBT_USEHASH
+				UPPERNODE(new_current) = UPPERNODE(current);
+#endif
 
 				/*
 				 * Fix pointers that were to the current node.
@@ -575,6 +930,9 @@ dns_rbt_addnode(dns_rbt_t *rbt, dns_name_t *name, dns_rbtnode_t **nodep) {
 				 */
 				current->is_root = 1;
 				PARENT(current) = new_current;
+#ifdef DNS_RBT_USEHASH
+				UPPERNODE(current) = new_current;
+#endif
 				DOWN(new_current) = current;
 				root = &DOWN(new_current);
 
@@ -1327,7 +1685,8 @@ dns_rbt_deletenode(dns_rbt_t *rbt, dns_rbtnode_t *node, isc_boolean_t recurse)
 	node->magic = 0;
 #endif
 	dns_rbtnode_refdestroy(node);
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!IS_MMAPPED(node))
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 
 	/*
@@ -1446,6 +1805,7 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 	DOWN(node) = NULL;
 	DATA(node) = NULL;
 #ifdef DNS_RBT_USEHASH
+	UPPERNODE(node) = NULL;
 	HASHNEXT(node) = NULL;
 	HASHVAL(node) = 0;
 #endif
@@ -1455,6 +1815,7 @@ create_node(isc_mem_t *mctx, dns_name_t *name, dns_rbtnode_t **nodep) {
 	LOCKNUM(node) = 0;
 	WILD(node) = 0;
 	DIRTY(node) = 0;
+	node->is_mmapped = 0;
 	dns_rbtnode_refinit(node, 0);
 	node->find_callback = 0;
 	node->nsec = DNS_RBT_NSEC_NORMAL;
@@ -1683,6 +2044,9 @@ dns_rbt_addonlevel(dns_rbtnode_t *node, dns_rbtnode_t *current, int order,
 		MAKE_BLACK(node);
 		node->is_root = 1;
 		PARENT(node) = current;
+#ifdef DNS_RBT_USEHASH
+		UPPERNODE(node) = current;
+#endif
 		*rootp = node;
 		return;
 	}
@@ -1706,6 +2070,9 @@ dns_rbt_addonlevel(dns_rbtnode_t *node, dns_rbtnode_t *current, int order,
 
 	INSIST(PARENT(node) == NULL);
 	PARENT(node) = current;
+#ifdef DNS_RBT_USEHASH
+	UPPERNODE(node) = UPPERNODE(current);
+#endif
 
 	MAKE_RED(node);
 
@@ -2056,7 +2423,8 @@ dns_rbt_deletetree(dns_rbt_t *rbt, dns_rbtnode_t *node) {
 	node->magic = 0;
 #endif
 
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!IS_MMAPPED(node))
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 	return (result);
 }
@@ -2106,7 +2474,8 @@ dns_rbt_deletetreeflat(dns_rbt_t *rbt, unsigned int quantum,
 	} else
 		parent = RIGHT(node);
 
-	isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
+	if (!IS_MMAPPED(node))
+		isc_mem_put(rbt->mctx, node, NODE_SIZE(node));
 	rbt->nodecount--;
 	node = parent;
 	if (quantum != 0 && --quantum == 0) {
@@ -25,24 +25,34 @@
 
 #include <config.h>
 
+#ifdef HAVE_INTTYPES_H
+#include <inttypes.h> /* uintptr_t */
+#endif
+
 /* #define inline */
 
+#include <isc/atomic.h>
 #include <isc/event.h>
+#include <isc/file.h>
 #include <isc/heap.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/once.h>
 #include <isc/platform.h>
 #include <isc/print.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
 #include <isc/serial.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/task.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
 #include <dns/acache.h>
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/events.h>
@@ -65,6 +75,15 @@
 #include <dns/zone.h>
 #include <dns/zonekey.h>
 
+#ifndef WIN32
+#include <sys/mman.h>
+#else
+#define PROT_READ	0x01
+#define PROT_WRITE	0x02
+#define MAP_PRIVATE	0x0002
+#define MAP_FAILED	((void *)-1)
+#endif
+
 #ifdef DNS_RBTDB_VERSION64
 #include "rbtdb64.h"
 #else
@@ -193,6 +212,57 @@ typedef isc_mutex_t nodelock_t;
 #define NODE_WEAKDOWNGRADE(l)   ((void)0)
 #endif
 
+/*
+ * Lock-free readers.
+ *
+ * Zone databases are read far more often than they are written, yet every
+ * lookup used to take the tree lock and a node lock, so the cache lines
+ * holding the locks of a popular zone bounced between CPUs on every query
+ * even when nobody ever had to wait.  When the efficient rwlock and atomic
+ * reference counters are available, the most common zone lookups
+ * (zone_find(), zone_findrdataset(), currentversion() and detachnode())
+ * therefore take neither lock.  Instead a reader announces itself by
+ * storing the ID of the database in a slot of a small global table indexed
+ * by thread; each slot has a cache line of its own.  A reader whose slot is
+ * already taken, or which finds a writer at work, takes the locks as usual.
+ *
+ * Anything that changes the shape of the trees, a node's rdataset list or a
+ * header a reader may look at, or that replaces the current version, must
+ * call fastread_revoke() before taking its write locks and
+ * fastread_restore() after releasing them.  fastread_revoke() makes new
+ * readers take the locks and waits until those already reading have left,
+ * which takes no longer than a single lookup.  Changes are expected to be
+ * rare, so the wait is cheap.
+ *
+ * A thread must not take any of the database's locks, nor call
+ * fastread_revoke(), while it holds a slot.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && DNS_RBTDB_USERWLOCK && \
+    defined(DNS_RBT_USEISCREFCOUNT)
+#define RBTDB_FASTREAD 1
+#endif
+
+#ifdef RBTDB_FASTREAD
+#define FASTREAD_SLOTS		64	/*%< Must be a power of 2. */
+
+typedef struct fastread_slot {
+	isc_int32_t			owner;
+	char				pad[64 - sizeof(isc_int32_t)];
+} fastread_slot_t;
+
+static fastread_slot_t fastread_slots[FASTREAD_SLOTS];
+static isc_int32_t fastread_lastid;
+
+#define FASTREAD_LOAD(p)	(*(volatile isc_int32_t *)(p))
+#else
+typedef struct fastread_slot fastread_slot_t;
+
+#define fastread_enter(r)	NULL
+#define fastread_leave(r, s)	((void)0)
+#define fastread_revoke(r)	((void)0)
+#define fastread_restore(r)	((void)0)
+#endif
+
 /*%
  * Whether to rate-limit updating the LRU to avoid possible thread contention.
  * Our performance measurement has shown the cost is marginal, so it's defined
@@ -282,6 +352,8 @@ typedef ISC_LIST(dns_rbtnode_t)         rbtnodelist_t;
 #define RDATASET_ATTR_STATCOUNT         0x0040
 #define RDATASET_ATTR_OPTOUT		0x0080
 #define RDATASET_ATTR_NEGATIVE          0x0100
+#define RDATASET_ATTR_MMAPPED           0x0200
+#define RDATASET_ATTR_PREFETCH          0x0400
 
 typedef struct acache_cbarg {
 	dns_rdatasetadditional_t        type;
@@ -322,6 +394,30 @@ struct acachectl {
 	(((header)->attributes & RDATASET_ATTR_OPTOUT) != 0)
 #define NEGATIVE(header) \
 	(((header)->attributes & RDATASET_ATTR_NEGATIVE) != 0)
+#define MMAPPED(header) \
+	(((header)->attributes & RDATASET_ATTR_MMAPPED) != 0)
+#define PREFETCH(header) \
+	(((header)->attributes & RDATASET_ATTR_PREFETCH) != 0)
+
+/*%
+ * How long an expired header is kept around so that it can still be
+ * returned as a stale answer.  NXDOMAIN entries are never served stale.
+ */
+#define STALE_TTL(header, rbtdb) \
+	(NXDOMAIN(header) ? 0 : (rbtdb)->serve_stale_ttl)
+
+/*%
+ * When a header stops being usable even as a stale answer.  Saturates
+ * rather than wrapping for headers that expire near the end of time.
+ */
+#define STALE_EXPIRE(header, rbtdb) \
+	((header)->rdh_ttl > ISC_UINT32_MAX - STALE_TTL(header, rbtdb) ? \
+	 ISC_UINT32_MAX : (header)->rdh_ttl + STALE_TTL(header, rbtdb))
+
+/*%
+ * The longest stale window a cache will keep; 4 weeks.
+ */
+#define MAX_SERVE_STALE_TTL		(28 * 24 * 3600)
 
 #define DEFAULT_NODE_LOCK_COUNT         7       /*%< Should be prime. */
 
@@ -372,6 +468,7 @@ typedef struct dns_rbtdb dns_rbtdb_t;
 typedef struct rbtdb_version {
 	/* Not locked */
 	rbtdb_serial_t                  serial;
+	isc_uint64_t			id;	/* see getversionid() */
 	dns_rbtdb_t *			rbtdb;
 	/*
 	 * Protected in the refcount routines.
@@ -413,6 +510,7 @@ struct dns_rbtdb {
 	rbtdb_nodelock_t *              node_locks;
 	dns_rbtnode_t *                 origin_node;
 	dns_stats_t *			rrsetstats; /* cache DB only */
+	dns_ttl_t			serve_stale_ttl; /* cache DB only */
 	/* Locked by lock. */
 	unsigned int                    active;
 	isc_refcount_t                  references;
@@ -457,6 +555,20 @@ struct dns_rbtdb {
 
 	/* Unlocked */
 	unsigned int                    quantum;
+
+	/*%
+	 * The zone file the trees were loaded from, if it was a map
+	 * format file; nodes and rdatasets still live in it.
+	 */
+	void *                          mmap_location;
+	size_t                          mmap_size;
+
+#ifdef RBTDB_FASTREAD
+	/* 0 if lock-free reading is disabled (cache DB). */
+	isc_int32_t			fastread_id;
+	/* Number of writers holding readers off. */
+	isc_int32_t			fastread_writers;
+#endif
 };
 
 #define RBTDB_ATTR_LOADED               0x01
@@ -479,8 +591,33 @@ typedef struct {
 	rdatasetheader_t *      zonecut_sigrdataset;
 	dns_fixedname_t         zonecut_name;
 	isc_stdtime_t           now;
+	fastread_slot_t *       fastread;
 } rbtdb_search_t;
 
+/*
+ * Node locking during a search: a zone search holding a fast read slot
+ * (see fastread_enter()) takes no node locks.
+ */
+#define SEARCH_NODE_LOCK(s, l, t) \
+	do { \
+		if ((s)->fastread == NULL) \
+			NODE_LOCK((l), (t)); \
+	} while (0)
+#define SEARCH_NODE_UNLOCK(s, l, t) \
+	do { \
+		if ((s)->fastread == NULL) \
+			NODE_UNLOCK((l), (t)); \
+	} while (0)
+
+/*%
+ * An expired cache header may still be returned if the caller asked
+ * for stale answers and it is within the serve-stale window.
+ */
+#define STALEOK(header, s) \
+	(((s)->options & DNS_DBFIND_STALEOK) != 0 && \
+	 ((header)->attributes & RDATASET_ATTR_STALE) == 0 && \
+	 STALE_EXPIRE(header, (s)->rbtdb) >= (s)->now)
+
 /*%
  * Load Context
  */
@@ -538,8 +675,10 @@ static void overmem_purge(dns_rbtdb_t *rbtdb, unsigned int locknum_start,
 static isc_result_t resign_insert(dns_rbtdb_t *rbtdb, int idx,
 				  rdatasetheader_t *newheader);
 static void prune_tree(isc_task_t *task, isc_event_t *event);
+static void delete_callback(void *data, void *arg);
 static void rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust);
 static void rdataset_expire(dns_rdataset_t *rdataset);
+static void rdataset_clearprefetch(dns_rdataset_t *rdataset);
 
 static dns_rdatasetmethods_t rdataset_methods = {
 	rdataset_disassociate,
@@ -556,7 +695,8 @@ static dns_rdatasetmethods_t rdataset_methods = {
 	rdataset_setadditional,
 	rdataset_putadditional,
 	rdataset_settrust,
-	rdataset_expire
+	rdataset_expire,
+	rdataset_clearprefetch
 };
 
 static void rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp);
@@ -664,6 +804,9 @@ static unsigned int init_count;
  *      Database Lock
  *
  * Failure to follow this hierarchy can result in deadlock.
+ *
+ * A fast read slot stands in for the tree lock and node locks in a lookup;
+ * none of the locks above may be taken while holding one.
  */
 
 /*
@@ -672,6 +815,73 @@ static unsigned int init_count;
  * For zone databases the node for the origin of the zone MUST NOT be deleted.
  */
 
+#ifdef RBTDB_FASTREAD
+/*
+ * Try to start a lock-free read of 'rbtdb'.  Returns the slot to be passed
+ * to fastread_leave(), or NULL if the caller must take the locks instead.
+ */
+static inline fastread_slot_t *
+fastread_enter(dns_rbtdb_t *rbtdb) {
+	fastread_slot_t *slot;
+	unsigned long self;
+	isc_uint32_t hash;
+
+	if (rbtdb->fastread_id == 0 ||
+	    FASTREAD_LOAD(&rbtdb->fastread_writers) != 0)
+		return (NULL);
+
+	self = isc_thread_self();
+	hash = (isc_uint32_t)(self ^ (self >> 12)) * 0x9e3779b1U;
+	slot = &fastread_slots[(hash >> 16) & (FASTREAD_SLOTS - 1)];
+	if (isc_atomic_cmpxchg(&slot->owner, 0, rbtdb->fastread_id) != 0)
+		return (NULL);
+
+	/*
+	 * The exchange is a full barrier: either a writer arriving now
+	 * will see our slot, or we see the writer here.
+	 */
+	if (FASTREAD_LOAD(&rbtdb->fastread_writers) != 0) {
+		(void)isc_atomic_cmpxchg(&slot->owner, rbtdb->fastread_id, 0);
+		return (NULL);
+	}
+
+	return (slot);
+}
+
+static inline void
+fastread_leave(dns_rbtdb_t *rbtdb, fastread_slot_t *slot) {
+	(void)isc_atomic_cmpxchg(&slot->owner, rbtdb->fastread_id, 0);
+}
+
+/*
+ * Hold lock-free readers of 'rbtdb' off and wait for those already reading
+ * to leave.  Must be called before 'rbtdb' is changed in a way they could
+ * see, and be paired with fastread_restore().
+ */
+static void
+fastread_revoke(dns_rbtdb_t *rbtdb) {
+	unsigned int i;
+
+	if (rbtdb->fastread_id == 0)
+		return;
+
+	(void)isc_atomic_xadd(&rbtdb->fastread_writers, 1);
+	for (i = 0; i < FASTREAD_SLOTS; i++) {
+		while (FASTREAD_LOAD(&fastread_slots[i].owner) ==
+		       rbtdb->fastread_id)
+			isc_thread_yield();
+	}
+}
+
+static inline void
+fastread_restore(dns_rbtdb_t *rbtdb) {
+	if (rbtdb->fastread_id == 0)
+		return;
+
+	(void)isc_atomic_xadd(&rbtdb->fastread_writers, -1);
+}
+#endif /* RBTDB_FASTREAD */
+
 
 /*
  * DB Routines
@@ -968,6 +1178,9 @@ free_rbtdb(dns_rbtdb_t *rbtdb, isc_boolean_t log, isc_event_t *event) {
 			    rbtdb->node_lock_count * sizeof(isc_heap_t *));
 	}
 
+	if (rbtdb->mmap_location != NULL)
+		isc_file_munmap(rbtdb->mmap_location, rbtdb->mmap_size);
+
 	if (rbtdb->rrsetstats != NULL)
 		dns_stats_detach(&rbtdb->rrsetstats);
 
@@ -1009,6 +1222,7 @@ maybe_free_rbtdb(dns_rbtdb_t *rbtdb) {
 	 * Even though there are no external direct references, there still
 	 * may be nodes in use.
 	 */
+	fastread_revoke(rbtdb);
 	for (i = 0; i < rbtdb->node_lock_count; i++) {
 		NODE_LOCK(&rbtdb->node_locks[i].lock, isc_rwlocktype_write);
 		rbtdb->node_locks[i].exiting = ISC_TRUE;
@@ -1018,6 +1232,7 @@ maybe_free_rbtdb(dns_rbtdb_t *rbtdb) {
 			inactive++;
 		}
 	}
+	fastread_restore(rbtdb);
 
 	if (inactive != 0) {
 		RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
@@ -1060,9 +1275,19 @@ currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 	rbtdb_version_t *version;
 	unsigned int refs;
+	fastread_slot_t *fastread;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 
+	fastread = fastread_enter(rbtdb);
+	if (fastread != NULL) {
+		version = rbtdb->current_version;
+		isc_refcount_increment(&version->references, &refs);
+		fastread_leave(rbtdb, fastread);
+		*versionp = (dns_dbversion_t *)version;
+		return;
+	}
+
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_read);
 	version = rbtdb->current_version;
 	isc_refcount_increment(&version->references, &refs);
@@ -1071,6 +1296,41 @@ currentversion(dns_db_t *db, dns_dbversion_t **versionp) {
 	*versionp = (dns_dbversion_t *)version;
 }
 
+/*%
+ * Version identities come from a counter shared by every database, so
+ * that one is never seen again after its version has gone.  This file
+ * is also built with 64 bit serials (rbtdb64.c), with its own counter;
+ * the low bit tells the two apart.
+ */
+#ifdef DNS_RBTDB_VERSION64
+#define VERSIONID_VARIANT	1
+#else
+#define VERSIONID_VARIANT	0
+#endif
+
+static isc_once_t versionid_once = ISC_ONCE_INIT;
+static isc_mutex_t versionid_lock;
+static isc_uint64_t versionid_next;
+
+static void
+versionid_initialize(void) {
+	RUNTIME_CHECK(isc_mutex_init(&versionid_lock) == ISC_R_SUCCESS);
+	versionid_next = 0;
+}
+
+static isc_uint64_t
+new_versionid(void) {
+	isc_uint64_t id;
+
+	RUNTIME_CHECK(isc_once_do(&versionid_once,
+				  versionid_initialize) == ISC_R_SUCCESS);
+	LOCK(&versionid_lock);
+	id = (versionid_next++ << 1) | VERSIONID_VARIANT;
+	UNLOCK(&versionid_lock);
+
+	return (id);
+}
+
 static inline rbtdb_version_t *
 allocate_version(isc_mem_t *mctx, rbtdb_serial_t serial,
 		 unsigned int references, isc_boolean_t writer)
@@ -1082,6 +1342,7 @@ allocate_version(isc_mem_t *mctx, rbtdb_serial_t serial,
 	if (version == NULL)
 		return (NULL);
 	version->serial = serial;
+	version->id = new_versionid();
 	result = isc_refcount_init(&version->references, references);
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_put(mctx, version, sizeof(*version));
@@ -1295,6 +1556,9 @@ free_rdataset(dns_rbtdb_t *rbtdb, isc_mem_t *mctx, rdatasetheader_t *rdataset)
 	free_acachearray(mctx, rdataset, rdataset->additional_auth);
 	free_acachearray(mctx, rdataset, rdataset->additional_glue);
 
+	if (MMAPPED(rdataset))
+		return;
+
 	if ((rdataset->attributes & RDATASET_ATTR_NONEXISTENT) != 0)
 		size = sizeof(*rdataset);
 	else
@@ -1664,6 +1928,7 @@ reactivate_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		/*
 		 * Upgrade the lock and test if we still need to unlink.
 		 */
+		fastread_revoke(rbtdb);
 		NODE_WEAKUNLOCK(nodelock, locktype);
 		locktype = isc_rwlocktype_write;
 		POST(locktype);
@@ -1679,6 +1944,39 @@ reactivate_node(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 
 	NODE_WEAKUNLOCK(nodelock, locktype);
 	NODE_STRONGUNLOCK(nodelock);
+
+	if (locktype == isc_rwlocktype_write)
+		fastread_restore(rbtdb);
+}
+
+#define KEEP_NODE(n, r) \
+	((n)->data != NULL || (n)->down != NULL || (n) == (r)->origin_node)
+
+/*
+ * The easy and typical case of decrement_reference(): if 'node' has nothing
+ * to be cleaned up and is going to stay in the tree, drop the reference,
+ * set '*nrefsp' to the number of references left and return ISC_TRUE.
+ * Otherwise do nothing and return ISC_FALSE.
+ *
+ * Caller must be holding the node lock or a fast read slot.
+ */
+static inline isc_boolean_t
+decrement_keep(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node, unsigned int *nrefsp) {
+	rbtdb_nodelock_t *nodelock;
+	unsigned int refs, nrefs;
+
+	if (node->dirty || !KEEP_NODE(node, rbtdb))
+		return (ISC_FALSE);
+
+	nodelock = &rbtdb->node_locks[node->locknum];
+	dns_rbtnode_refdecrement(node, &nrefs);
+	INSIST((int)nrefs >= 0);
+	if (nrefs == 0) {
+		isc_refcount_decrement(&nodelock->references, &refs);
+		INSIST((int)refs >= 0);
+	}
+	*nrefsp = nrefs;
+	return (ISC_TRUE);
 }
 
 /*
@@ -1706,19 +2004,11 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 
 	nodelock = &rbtdb->node_locks[bucket];
 
-#define KEEP_NODE(n, r) \
-	((n)->data != NULL || (n)->down != NULL || (n) == (r)->origin_node)
-
 	/* Handle easy and typical case first. */
-	if (!node->dirty && KEEP_NODE(node, rbtdb)) {
-		dns_rbtnode_refdecrement(node, &nrefs);
-		INSIST((int)nrefs >= 0);
-		if (nrefs == 0) {
-			isc_refcount_decrement(&nodelock->references, &refs);
-			INSIST((int)refs >= 0);
-		}
+	if (decrement_keep(rbtdb, node, &nrefs))
 		return ((nrefs == 0) ? ISC_TRUE : ISC_FALSE);
-	}
+
+	fastread_revoke(rbtdb);
 
 	/* Upgrade the lock? */
 	if (nlock == isc_rwlocktype_read) {
@@ -1732,6 +2022,7 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		/* Restore the lock? */
 		if (nlock == isc_rwlocktype_read)
 			NODE_WEAKDOWNGRADE(&nodelock->lock);
+		fastread_restore(rbtdb);
 		return (ISC_FALSE);
 	}
 
@@ -1782,8 +2073,6 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	if (KEEP_NODE(node, rbtdb))
 		goto restore_locks;
 
-#undef KEEP_NODE
-
 	if (write_locked) {
 		/*
 		 * We can now delete the node.
@@ -1883,6 +2172,8 @@ decrement_reference(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		if (write_locked)
 			isc_rwlock_downgrade(&rbtdb->tree_lock);
 
+	fastread_restore(rbtdb);
+
 	return (no_reference);
 }
 
@@ -1904,6 +2195,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 
 	isc_event_free(&event);
 
+	fastread_revoke(rbtdb);
 	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	locknum = node->locknum;
 	NODE_LOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
@@ -1945,6 +2237,7 @@ prune_tree(isc_task_t *task, isc_event_t *event) {
 	} while (node != NULL);
 	NODE_UNLOCK(&rbtdb->node_locks[locknum].lock, isc_rwlocktype_write);
 	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 
 	detach((dns_db_t **)&rbtdb);
 }
@@ -2159,6 +2452,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 	unsigned int locknum;
 	unsigned int refs;
 
+	fastread_revoke(rbtdb);
 	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	for (locknum = 0; locknum < rbtdb->node_lock_count; locknum++) {
 		NODE_LOCK(&rbtdb->node_locks[locknum].lock,
@@ -2170,6 +2464,7 @@ cleanup_dead_nodes_callback(isc_task_t *task, isc_event_t *event) {
 			    isc_rwlocktype_write);
 	}
 	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 	if (again)
 		isc_task_send(task, &event);
 	else {
@@ -2212,6 +2507,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 		goto end;
 	}
 
+	fastread_revoke(rbtdb);
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
 	serial = version->serial;
 	writer = version->writer;
@@ -2437,6 +2733,7 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp, isc_boolean_t commit) {
 		} else
 			RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	}
+	fastread_restore(rbtdb);
 
  end:
 	*versionp = NULL;
@@ -2535,6 +2832,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 		 * unlocking then relocking.
 		 */
 		locktype = isc_rwlocktype_write;
+		fastread_revoke(rbtdb);
 		RWLOCK(&rbtdb->tree_lock, locktype);
 		node = NULL;
 		result = dns_rbt_addnode(tree, name, &node);
@@ -2564,6 +2862,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 					result = add_wildcard_magic(rbtdb, name);
 					if (result != ISC_R_SUCCESS) {
 						RWUNLOCK(&rbtdb->tree_lock, locktype);
+						fastread_restore(rbtdb);
 						return (result);
 					}
 				}
@@ -2572,6 +2871,7 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 				node->nsec = DNS_RBT_NSEC_NSEC3;
 		} else if (result != ISC_R_EXISTS) {
 			RWUNLOCK(&rbtdb->tree_lock, locktype);
+			fastread_restore(rbtdb);
 			return (result);
 		}
 	}
@@ -2581,6 +2881,8 @@ findnodeintree(dns_rbtdb_t *rbtdb, dns_rbt_t *tree, dns_name_t *name,
 
 	reactivate_node(rbtdb, node, locktype);
 	RWUNLOCK(&rbtdb->tree_lock, locktype);
+	if (locktype == isc_rwlocktype_write)
+		fastread_restore(rbtdb);
 
 	*nodep = (dns_dbnode_t *)node;
 
@@ -2630,8 +2932,9 @@ zone_zonecut_callback(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
 	result = DNS_R_CONTINUE;
 	onode = search->rbtdb->origin_node;
 
-	NODE_LOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-		  isc_rwlocktype_read);
+	SEARCH_NODE_LOCK(search,
+			 &(search->rbtdb->node_locks[node->locknum].lock),
+			 isc_rwlocktype_read);
 
 	/*
 	 * Look for an NS or DNAME rdataset active in our version.
@@ -2747,8 +3050,9 @@ zone_zonecut_callback(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
 			search->wild = ISC_TRUE;
 	}
 
-	NODE_UNLOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-		    isc_rwlocktype_read);
+	SEARCH_NODE_UNLOCK(search,
+			   &(search->rbtdb->node_locks[node->locknum].lock),
+			   isc_rwlocktype_read);
 
 	return (result);
 }
@@ -2779,8 +3083,15 @@ bind_rdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 	rdataset->rdclass = rbtdb->common.rdclass;
 	rdataset->type = RBTDB_RDATATYPE_BASE(header->type);
 	rdataset->covers = RBTDB_RDATATYPE_EXT(header->type);
-	rdataset->ttl = header->rdh_ttl - now;
+	if (header->rdh_ttl < now) {
+		/* Expired, but still being served as a stale answer. */
+		rdataset->ttl = 0;
+		rdataset->attributes |= DNS_RDATASETATTR_STALE;
+	} else
+		rdataset->ttl = header->rdh_ttl - now;
 	rdataset->trust = header->trust;
+	if (PREFETCH(header))
+		rdataset->attributes |= DNS_RDATASETATTR_PREFETCH;
 	if (NEGATIVE(header))
 		rdataset->attributes |= DNS_RDATASETATTR_NEGATIVE;
 	if (NXDOMAIN(header))
@@ -2861,16 +3172,18 @@ setup_delegation(rbtdb_search_t *search, dns_dbnode_t **nodep,
 		search->need_cleanup = ISC_FALSE;
 	}
 	if (rdataset != NULL) {
-		NODE_LOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(search->rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 		bind_rdataset(search->rbtdb, node, search->zonecut_rdataset,
 			      search->now, rdataset);
 		if (sigrdataset != NULL && search->zonecut_sigrdataset != NULL)
 			bind_rdataset(search->rbtdb, node,
 				      search->zonecut_sigrdataset,
 				      search->now, sigrdataset);
-		NODE_UNLOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(search->rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 	}
 
 	if (type == dns_rdatatype_dname)
@@ -2973,8 +3286,9 @@ activeempty(rbtdb_search_t *search, dns_rbtnodechain_t *chain,
 						  origin, &node);
 		if (result != ISC_R_SUCCESS)
 			break;
-		NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 		for (header = node->data;
 		     header != NULL;
 		     header = header->next) {
@@ -2982,8 +3296,9 @@ activeempty(rbtdb_search_t *search, dns_rbtnodechain_t *chain,
 			    !IGNORE(header) && EXISTS(header))
 				break;
 		}
-		NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 		if (header != NULL)
 			break;
 		result = dns_rbtnodechain_next(chain, NULL, NULL);
@@ -3040,8 +3355,9 @@ activeemtpynode(rbtdb_search_t *search, dns_name_t *qname, dns_name_t *wname) {
 						  origin, &node);
 		if (result != ISC_R_SUCCESS)
 			break;
-		NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 		for (header = node->data;
 		     header != NULL;
 		     header = header->next) {
@@ -3049,8 +3365,9 @@ activeemtpynode(rbtdb_search_t *search, dns_name_t *qname, dns_name_t *wname) {
 			    !IGNORE(header) && EXISTS(header))
 				break;
 		}
-		NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 		if (header != NULL)
 			break;
 		result = dns_rbtnodechain_prev(&chain, NULL, NULL);
@@ -3067,8 +3384,9 @@ activeemtpynode(rbtdb_search_t *search, dns_name_t *qname, dns_name_t *wname) {
 						  origin, &node);
 		if (result != ISC_R_SUCCESS)
 			break;
-		NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 		for (header = node->data;
 		     header != NULL;
 		     header = header->next) {
@@ -3076,8 +3394,9 @@ activeemtpynode(rbtdb_search_t *search, dns_name_t *qname, dns_name_t *wname) {
 			    !IGNORE(header) && EXISTS(header))
 				break;
 		}
-		NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 		if (header != NULL)
 			break;
 		result = dns_rbtnodechain_next(&chain, NULL, NULL);
@@ -3145,8 +3464,9 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 	done = ISC_FALSE;
 	node = *nodep;
 	do {
-		NODE_LOCK(&(rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 
 		/*
 		 * First we try to figure out if this node is active in
@@ -3171,8 +3491,9 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 		else
 			wild = ISC_FALSE;
 
-		NODE_UNLOCK(&(rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 
 		if (wild) {
 			/*
@@ -3213,7 +3534,8 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 				 * done.
 				 */
 				lock = &rbtdb->node_locks[wnode->locknum].lock;
-				NODE_LOCK(lock, isc_rwlocktype_read);
+				SEARCH_NODE_LOCK(search, lock,
+						 isc_rwlocktype_read);
 				for (header = wnode->data;
 				     header != NULL;
 				     header = header->next) {
@@ -3221,7 +3543,8 @@ find_wildcard(rbtdb_search_t *search, dns_rbtnode_t **nodep,
 					    !IGNORE(header) && EXISTS(header))
 						break;
 				}
-				NODE_UNLOCK(lock, isc_rwlocktype_read);
+				SEARCH_NODE_UNLOCK(search, lock,
+						   isc_rwlocktype_read);
 				if (header != NULL ||
 				    activeempty(search, &wchain, wname)) {
 					if (activeemtpynode(search, qname,
@@ -3468,8 +3791,9 @@ find_closest_nsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 	if (result != ISC_R_SUCCESS)
 		return (result);
 	do {
-		NODE_LOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-			  isc_rwlocktype_read);
+		SEARCH_NODE_LOCK(search,
+				 &(search->rbtdb->node_locks[node->locknum].lock),
+				 isc_rwlocktype_read);
 		found = NULL;
 		foundsig = NULL;
 		empty_node = ISC_TRUE;
@@ -3581,8 +3905,9 @@ find_closest_nsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 						       name, origin, &prevnode,
 						       &nsecchain, &first);
 		}
-		NODE_UNLOCK(&(search->rbtdb->node_locks[node->locknum].lock),
-			    isc_rwlocktype_read);
+		SEARCH_NODE_UNLOCK(search,
+				   &(search->rbtdb->node_locks[node->locknum].lock),
+				   isc_rwlocktype_read);
 		node = prevnode;
 		prevnode = NULL;
 	} while (empty_node && result == ISC_R_SUCCESS);
@@ -3669,7 +3994,9 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	 */
 	wild = ISC_FALSE;
 
-	RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	search.fastread = fastread_enter(search.rbtdb);
+	if (search.fastread == NULL)
+		RWLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * Search down from the root of the tree.  If, while going down, we
@@ -3778,7 +4105,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	 */
 
 	lock = &search.rbtdb->node_locks[node->locknum].lock;
-	NODE_LOCK(lock, isc_rwlocktype_read);
+	SEARCH_NODE_LOCK(&search, lock, isc_rwlocktype_read);
 
 	found = NULL;
 	foundsig = NULL;
@@ -3857,7 +4184,8 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 			 */
 			if (header->type == dns_rdatatype_nsec3 &&
 			   !matchparams(header, &search)) {
-				NODE_UNLOCK(lock, isc_rwlocktype_read);
+				SEARCH_NODE_UNLOCK(&search, lock,
+						   isc_rwlocktype_read);
 				goto partial_match;
 			}
 			/*
@@ -3938,7 +4266,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 		 * we really have a partial match.
 		 */
 		if (!wild) {
-			NODE_UNLOCK(lock, isc_rwlocktype_read);
+			SEARCH_NODE_UNLOCK(&search, lock, isc_rwlocktype_read);
 			goto partial_match;
 		}
 	}
@@ -3954,7 +4282,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 			 *
 			 * Return the delegation.
 			 */
-			NODE_UNLOCK(lock, isc_rwlocktype_read);
+			SEARCH_NODE_UNLOCK(&search, lock, isc_rwlocktype_read);
 			result = setup_delegation(&search, nodep, foundname,
 						  rdataset, sigrdataset);
 			goto tree_exit;
@@ -3975,7 +4303,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 				goto node_exit;
 			}
 
-			NODE_UNLOCK(lock, isc_rwlocktype_read);
+			SEARCH_NODE_UNLOCK(&search, lock, isc_rwlocktype_read);
 			result = find_closest_nsec(&search, nodep, foundname,
 						   rdataset, sigrdataset,
 						   search.rbtdb->tree,
@@ -4059,7 +4387,7 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 		if (result == DNS_R_GLUE &&
 		    (search.options & DNS_DBFIND_VALIDATEGLUE) != 0 &&
 		    !valid_glue(&search, foundname, type, node)) {
-			NODE_UNLOCK(lock, isc_rwlocktype_read);
+			SEARCH_NODE_UNLOCK(&search, lock, isc_rwlocktype_read);
 			result = setup_delegation(&search, nodep, foundname,
 						  rdataset, sigrdataset);
 		    goto tree_exit;
@@ -4090,10 +4418,13 @@ zone_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 		foundname->attributes |= DNS_NAMEATTR_WILDCARD;
 
  node_exit:
-	NODE_UNLOCK(lock, isc_rwlocktype_read);
+	SEARCH_NODE_UNLOCK(&search, lock, isc_rwlocktype_read);
 
  tree_exit:
-	RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
+	if (search.fastread != NULL)
+		fastread_leave(search.rbtdb, search.fastread);
+	else
+		RWUNLOCK(&search.rbtdb->tree_lock, isc_rwlocktype_read);
 
 	/*
 	 * If we found a zonecut but aren't going to use it, we have to
@@ -4178,7 +4509,8 @@ cache_zonecut_callback(dns_rbtnode_t *node, dns_name_t *name, void *arg) {
 			 * the node as dirty, so it will get cleaned
 			 * up later.
 			 */
-			if ((header->rdh_ttl <  search->now - RBTDB_VIRTUAL) &&
+			if ((STALE_EXPIRE(header, search->rbtdb) <
+			     search->now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -4302,8 +4634,8 @@ find_deepest_zonecut(rbtdb_search_t *search, dns_rbtnode_t *node,
 				 * the node as dirty, so it will get cleaned
 				 * up later.
 				 */
-				if ((header->rdh_ttl <  search->now -
-						    RBTDB_VIRTUAL) &&
+				if ((STALE_EXPIRE(header, search->rbtdb) <
+				     search->now - RBTDB_VIRTUAL) &&
 				    (locktype == isc_rwlocktype_write ||
 				     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 					/*
@@ -4479,7 +4811,8 @@ find_coveringnsec(rbtdb_search_t *search, dns_dbnode_t **nodep,
 				 * node as dirty, so it will get cleaned up
 				 * later.
 				 */
-				if ((header->rdh_ttl <  now - RBTDB_VIRTUAL) &&
+				if ((STALE_EXPIRE(header, search->rbtdb) <
+				     now - RBTDB_VIRTUAL) &&
 				    (locktype == isc_rwlocktype_write ||
 				     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 					/*
@@ -4813,6 +5146,7 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain, search.rbtdb->common.mctx);
 	search.now = now;
+	search.fastread = NULL;
 	update = NULL;
 	updatesig = NULL;
 
@@ -4878,14 +5212,15 @@ cache_find(dns_db_t *db, dns_name_t *name, dns_dbversion_t *version,
 	header_prev = NULL;
 	for (header = node->data; header != NULL; header = header_next) {
 		header_next = header->next;
-		if (header->rdh_ttl <  now) {
+		if (header->rdh_ttl < now && !STALEOK(header, &search)) {
 			/*
 			 * This rdataset is stale.  If no one else is using the
 			 * node, we can clean it up right now, otherwise we
 			 * mark it as stale, and the node as dirty, so it will
 			 * get cleaned up later.
 			 */
-			if ((header->rdh_ttl <  now - RBTDB_VIRTUAL) &&
+			if ((STALE_EXPIRE(header, search.rbtdb) <
+			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -5152,6 +5487,7 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 	dns_fixedname_init(&search.zonecut_name);
 	dns_rbtnodechain_init(&search.chain, search.rbtdb->common.mctx);
 	search.now = now;
+	search.fastread = NULL;
 
 	if ((options & DNS_DBFIND_NOEXACT) != 0)
 		rbtoptions |= DNS_RBTFIND_NOEXACT;
@@ -5192,7 +5528,8 @@ cache_findzonecut(dns_db_t *db, dns_name_t *name, unsigned int options,
 			 * mark it as stale, and the node as dirty, so it will
 			 * get cleaned up later.
 			 */
-			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
+			if ((STALE_EXPIRE(header, search.rbtdb) <
+			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -5320,6 +5657,8 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
 	isc_boolean_t want_free = ISC_FALSE;
 	isc_boolean_t inactive = ISC_FALSE;
 	rbtdb_nodelock_t *nodelock;
+	fastread_slot_t *fastread;
+	unsigned int nrefs;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(targetp != NULL && *targetp != NULL);
@@ -5327,6 +5666,22 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
 	node = (dns_rbtnode_t *)(*targetp);
 	nodelock = &rbtdb->node_locks[node->locknum];
 
+	/*
+	 * Try the easy case without the node lock first.
+	 */
+	fastread = fastread_enter(rbtdb);
+	if (fastread != NULL) {
+		if (decrement_keep(rbtdb, node, &nrefs)) {
+			if (nrefs == 0 &&
+			    isc_refcount_current(&nodelock->references) == 0 &&
+			    nodelock->exiting)
+				inactive = ISC_TRUE;
+			fastread_leave(rbtdb, fastread);
+			goto done;
+		}
+		fastread_leave(rbtdb, fastread);
+	}
+
 	NODE_LOCK(&nodelock->lock, isc_rwlocktype_read);
 
 	if (decrement_reference(rbtdb, node, 0, isc_rwlocktype_read,
@@ -5339,6 +5694,7 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp) {
 
 	NODE_UNLOCK(&nodelock->lock, isc_rwlocktype_read);
 
+ done:
 	*targetp = NULL;
 
 	if (inactive) {
@@ -5418,7 +5774,7 @@ expirenode(dns_db_t *db, dns_dbnode_t *node, isc_stdtime_t now) {
 		  isc_rwlocktype_write);
 
 	for (header = rbtnode->data; header != NULL; header = header->next)
-		if (header->rdh_ttl <= now - RBTDB_VIRTUAL) {
+		if (STALE_EXPIRE(header, rbtdb) <= now - RBTDB_VIRTUAL) {
 			/*
 			 * We don't check if refcurrent(rbtnode) == 0 and try
 			 * to free like we do in cache_find(), because
@@ -5561,6 +5917,7 @@ zone_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	rbtdb_version_t *rbtversion = version;
 	isc_boolean_t close_version = ISC_FALSE;
 	rbtdb_rdatatype_t matchtype, sigmatchtype;
+	fastread_slot_t *fastread;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
 	REQUIRE(type != dns_rdatatype_any);
@@ -5573,8 +5930,10 @@ zone_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	serial = rbtversion->serial;
 	now = 0;
 
-	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
-		  isc_rwlocktype_read);
+	fastread = fastread_enter(rbtdb);
+	if (fastread == NULL)
+		NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+			  isc_rwlocktype_read);
 
 	found = NULL;
 	foundsig = NULL;
@@ -5622,8 +5981,11 @@ zone_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 				      sigrdataset);
 	}
 
-	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
-		    isc_rwlocktype_read);
+	if (fastread != NULL)
+		fastread_leave(rbtdb, fastread);
+	else
+		NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+			    isc_rwlocktype_read);
 
 	if (close_version)
 		closeversion(db, (dns_dbversion_t **) (void *)(&rbtversion),
@@ -5675,7 +6037,8 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	for (header = rbtnode->data; header != NULL; header = header_next) {
 		header_next = header->next;
 		if (header->rdh_ttl < now) {
-			if ((header->rdh_ttl < now - RBTDB_VIRTUAL) &&
+			if ((STALE_EXPIRE(header, rbtdb) <
+			     now - RBTDB_VIRTUAL) &&
 			    (locktype == isc_rwlocktype_write ||
 			     NODE_TRYUPGRADE(lock) == ISC_R_SUCCESS)) {
 				/*
@@ -6164,6 +6527,7 @@ add(dns_rbtdb_t *rbtdb, dns_rbtnode_t *rbtnode, rbtdb_version_t *rbtversion,
 			}
 		}
 		if (IS_CACHE(rbtdb) && header->rdh_ttl >= now &&
+		    (options & DNS_DBADD_PREFETCH) == 0 &&
 		    (header->type == dns_rdatatype_a ||
 		     header->type == dns_rdatatype_aaaa ||
 		     header->type == dns_rdatatype_ds ||
@@ -6500,6 +6864,8 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			newheader->attributes |= RDATASET_ATTR_NXDOMAIN;
 		if ((rdataset->attributes & DNS_RDATASETATTR_OPTOUT) != 0)
 			newheader->attributes |= RDATASET_ATTR_OPTOUT;
+		if ((rdataset->attributes & DNS_RDATASETATTR_PREFETCH) != 0)
+			newheader->attributes |= RDATASET_ATTR_PREFETCH;
 		if ((rdataset->attributes & DNS_RDATASETATTR_NOQNAME) != 0) {
 			result = addnoqname(rbtdb, newheader, rdataset);
 			if (result != ISC_R_SUCCESS) {
@@ -6545,6 +6911,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	 */
 	if (IS_CACHE(rbtdb) && isc_mem_isovermem(rbtdb->common.mctx))
 		cache_is_overmem = ISC_TRUE;
+	fastread_revoke(rbtdb);
 	if (delegating || newnsec || cache_is_overmem) {
 		tree_locked = ISC_TRUE;
 		RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
@@ -6566,7 +6933,8 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			cleanup_dead_nodes(rbtdb, rbtnode->locknum);
 
 		header = isc_heap_element(rbtdb->heaps[rbtnode->locknum], 1);
-		if (header && header->rdh_ttl < now - RBTDB_VIRTUAL)
+		if (header != NULL &&
+		    STALE_EXPIRE(header, rbtdb) < now - RBTDB_VIRTUAL)
 			expire_header(rbtdb, header, tree_locked);
 
 		/*
@@ -6611,6 +6979,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	if (tree_locked)
 		RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -6673,6 +7042,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	} else
 		newheader->resign = 0;
 
+	fastread_revoke(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 
@@ -6681,6 +7051,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		free_rdataset(rbtdb, rbtdb->common.mctx, newheader);
 		NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 			    isc_rwlocktype_write);
+		fastread_restore(rbtdb);
 		return (ISC_R_NOMEMORY);
 	}
 
@@ -6735,6 +7106,10 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 			 */
 			newheader->additional_auth = NULL;
 			newheader->additional_glue = NULL;
+			/*
+			 * The copy was allocated, whatever 'header' was.
+			 */
+			newheader->attributes &= ~RDATASET_ATTR_MMAPPED;
 		} else if (result == DNS_R_NXRRSET) {
 			/*
 			 * This subtraction would remove all of the rdata;
@@ -6796,6 +7171,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
  unlock:
 	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		    isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -6844,6 +7220,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	newheader->last_used = 0;
 	newheader->node = rbtnode;
 
+	fastread_revoke(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 
@@ -6852,6 +7229,7 @@ deleterdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 
 	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		    isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 
 	/*
 	 * Update the zone's secure status.  If version is non-NULL
@@ -7053,14 +7431,373 @@ loading_addrdataset(void *arg, dns_name_t *name, dns_rdataset_t *rdataset) {
 	return (result);
 }
 
+/*
+ * Map format files.
+ *
+ * The image of the database following the map file header is this
+ * header, then the three trees as written by dns_rbt_serialize_tree().
+ * The data of each node is the chain of rdataset headers visible in the
+ * version dumped, each followed by its slab, linked through 'next' by
+ * file offsets just as the tree nodes are.
+ */
+#define RBTDB_MAP_VERSION	"BIND9 rbtdb map 1"
+
+typedef struct rbtdb_file_header {
+	char			version[32];
+	isc_uint32_t		ptrsize;
+	isc_uint32_t		headersize;
+	isc_uint64_t		tree;
+	isc_uint64_t		nsec;
+	isc_uint64_t		nsec3;
+} rbtdb_file_header_t;
+
+typedef struct {
+	dns_rbtdb_t *		rbtdb;
+	rbtdb_serial_t		serial;
+} rbtdb_serialize_t;
+
+#define CHECK(x) \
+	do { \
+		result = (x); \
+		if (result != ISC_R_SUCCESS) \
+			goto cleanup; \
+	} while (0)
+
+static isc_result_t
+rbt_datawriter(FILE *rbtfile, unsigned char *data, void *arg, off_t *offsetp) {
+	rbtdb_serialize_t *ctx = arg;
+	rdatasetheader_t *header, *current, temp, *next;
+	nodelock_t *lock;
+	off_t where, previous = 0, start = 0;
+	unsigned int size;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	header = (rdatasetheader_t *)data;
+	lock = &ctx->rbtdb->node_locks[header->node->locknum].lock;
+	NODE_LOCK(lock, isc_rwlocktype_read);
+
+	for (; header != NULL; header = header->next) {
+		/*
+		 * Find the version of this rdataset that is visible in the
+		 * version being written, as the zone iterators do.
+		 */
+		for (current = header; current != NULL;
+		     current = current->down) {
+			if (current->serial <= ctx->serial &&
+			    !IGNORE(current))
+				break;
+		}
+		if (current == NULL || NONEXISTENT(current))
+			continue;
+
+		CHECK(isc_stdio_tell(rbtfile, &where));
+		where = dns_rbt_serialize_align(where);
+		if ((off_t)(uintptr_t)where != where)
+			CHECK(ISC_R_RANGE);
+		if (previous != 0) {
+			/*
+			 * Point the previous header at this one.
+			 */
+			next = (rdatasetheader_t *)(uintptr_t)where;
+			CHECK(isc_stdio_seek(rbtfile, previous +
+				      offsetof(rdatasetheader_t, next),
+				      SEEK_SET));
+			CHECK(isc_stdio_write(&next, sizeof(next), 1,
+					      rbtfile, NULL));
+		} else
+			start = where;
+		CHECK(isc_stdio_seek(rbtfile, where, SEEK_SET));
+
+		temp = *current;
+		temp.serial = 1;
+		temp.attributes &= ~RDATASET_ATTR_MMAPPED;
+		temp.noqname = NULL;
+		temp.closest = NULL;
+		temp.next = NULL;
+		temp.down = NULL;
+		temp.additional_auth = NULL;
+		temp.additional_glue = NULL;
+		temp.node = NULL;
+		temp.last_used = 0;
+		ISC_LINK_INIT(&temp, link);
+		temp.heap_index = 0;
+		CHECK(isc_stdio_write(&temp, sizeof(temp), 1, rbtfile, NULL));
+
+		size = dns_rdataslab_size((unsigned char *)current,
+					  sizeof(*current));
+		CHECK(isc_stdio_write(current + 1, size - sizeof(*current), 1,
+				      rbtfile, NULL));
+		previous = where;
+	}
+
+	*offsetp = start;
+
+ cleanup:
+	NODE_UNLOCK(lock, isc_rwlocktype_read);
+	return (result);
+}
+
+static isc_result_t
+rbt_datafixer(dns_rbtnode_t *rbtnode, void *base, size_t filesize, void *arg)
+{
+	dns_rbtdb_t *rbtdb = arg;
+	rdatasetheader_t *header;
+	uintptr_t offset, next;
+	isc_result_t result;
+#ifndef DNS_RBT_USEHASH
+	dns_name_t name;
+
+	dns_name_init(&name, NULL);
+	dns_rbt_namefromnode(rbtnode, &name);
+	rbtnode->locknum = dns_name_hash(&name, ISC_TRUE) %
+		rbtdb->node_lock_count;
+#else
+	rbtnode->locknum = rbtnode->hashval % rbtdb->node_lock_count;
+#endif
+
+	for (header = rbtnode->data; header != NULL; header = header->next) {
+		offset = (unsigned char *)header - (unsigned char *)base;
+		if (filesize - offset < sizeof(*header) ||
+		    filesize - offset < dns_rdataslab_size((unsigned char *)
+							   header,
+							   sizeof(*header)))
+			return (ISC_R_INVALIDFILE);
+
+		header->node = rbtnode;
+		header->attributes |= RDATASET_ATTR_MMAPPED;
+		header->count = init_count++;
+		header->noqname = NULL;
+		header->closest = NULL;
+		header->down = NULL;
+		header->additional_auth = NULL;
+		header->additional_glue = NULL;
+		header->last_used = 0;
+		ISC_LINK_INIT(header, link);
+		header->heap_index = 0;
+
+		/*
+		 * Headers were written in order, so a link that does not
+		 * point forward is damage (and could loop).
+		 */
+		next = (uintptr_t)header->next;
+		if (next != 0) {
+			if (next <= offset || next >= filesize ||
+			    filesize - next < sizeof(*header))
+				return (ISC_R_INVALIDFILE);
+			header->next = (rdatasetheader_t *)
+				((unsigned char *)base + next);
+		}
+
+		if (RESIGN(header)) {
+			result = resign_insert(rbtdb, rbtnode->locknum, header);
+			if (result != ISC_R_SUCCESS)
+				return (result);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+serialize(dns_db_t *db, dns_dbversion_t *ver, FILE *rbtfile) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_version_t *version = (rbtdb_version_t *)ver;
+	rbtdb_file_header_t header;
+	rbtdb_serialize_t ctx;
+	off_t header_location, tree_location, nsec_location, nsec3_location;
+	off_t end;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+	INSIST(version == NULL || version->rbtdb == rbtdb);
+
+	ctx.rbtdb = rbtdb;
+	if (version == NULL) {
+		RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_read);
+		ctx.serial = rbtdb->current_serial;
+		RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_read);
+	} else
+		ctx.serial = version->serial;
+
+	/*
+	 * Leave room for the header and fill it in at the end.
+	 */
+	memset(&header, 0, sizeof(header));
+	CHECK(isc_stdio_tell(rbtfile, &header_location));
+	header_location = dns_rbt_serialize_align(header_location);
+	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
+	CHECK(isc_stdio_write(&header, sizeof(header), 1, rbtfile, NULL));
+
+	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	result = dns_rbt_serialize_tree(rbtfile, rbtdb->tree, rbt_datawriter,
+					&ctx, &tree_location);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_serialize_tree(rbtfile, rbtdb->nsec,
+						rbt_datawriter, &ctx,
+						&nsec_location);
+	if (result == ISC_R_SUCCESS)
+		result = dns_rbt_serialize_tree(rbtfile, rbtdb->nsec3,
+						rbt_datawriter, &ctx,
+						&nsec3_location);
+	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_read);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	strncpy(header.version, RBTDB_MAP_VERSION, sizeof(header.version));
+	header.ptrsize = sizeof(void *);
+	header.headersize = sizeof(rdatasetheader_t);
+	header.tree = tree_location;
+	header.nsec = nsec_location;
+	header.nsec3 = nsec3_location;
+
+	CHECK(isc_stdio_tell(rbtfile, &end));
+	CHECK(isc_stdio_seek(rbtfile, header_location, SEEK_SET));
+	CHECK(isc_stdio_write(&header, sizeof(header), 1, rbtfile, NULL));
+	CHECK(isc_stdio_seek(rbtfile, end, SEEK_SET));
+
+ cleanup:
+	return (result);
+}
+
+/*
+ * Replace the (empty) trees of a database being loaded with the ones in
+ * the map format file 'f', whose database image starts at 'offset'.
+ */
 static isc_result_t
-beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp, dns_dbload_t **dbloadp) {
+deserialize(void *arg, FILE *f, off_t offset) {
+	rbtdb_load_t *loadctx = arg;
+	dns_rbtdb_t *rbtdb = loadctx->rbtdb;
+	rbtdb_file_header_t *header;
+	dns_rbt_t *tree = NULL, *nsec = NULL, *nsec3 = NULL;
+	dns_rbtnode_t *origin_node = NULL;
+	isc_mem_t *mctx = rbtdb->common.mctx;
+	off_t filesize;
+	size_t size;
+	void *base;
+	unsigned int i;
+	isc_result_t result;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE((rbtdb->attributes & RBTDB_ATTR_LOADING) != 0);
+
+	if (IS_CACHE(rbtdb) || rbtdb->mmap_location != NULL)
+		return (ISC_R_NOTIMPLEMENTED);
+
+	CHECK(isc_stdio_seek(f, 0, SEEK_END));
+	CHECK(isc_stdio_tell(f, &filesize));
+	size = (size_t)filesize;
+	if ((off_t)size != filesize)
+		return (ISC_R_RANGE);
+
+	offset = dns_rbt_serialize_align(offset);
+	if (offset < 0 || (size_t)offset > size ||
+	    size - offset < sizeof(*header))
+		return (ISC_R_INVALIDFILE);
+
+	base = isc_file_mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+			     fileno(f), 0);
+	if (base == NULL || base == MAP_FAILED)
+		return (ISC_R_FAILURE);
+	/*
+	 * The mapping is kept until the database is freed, even if what
+	 * is in it turns out to be unusable.
+	 */
+	rbtdb->mmap_location = base;
+	rbtdb->mmap_size = size;
+
+	header = (rbtdb_file_header_t *)((unsigned char *)base + offset);
+	if (strncmp(header->version, RBTDB_MAP_VERSION,
+		    sizeof(header->version)) != 0 ||
+	    header->ptrsize != sizeof(void *) ||
+	    header->headersize != sizeof(rdatasetheader_t))
+		return (ISC_R_INVALIDFILE);
+
+	CHECK(dns_rbt_deserialize_tree(base, size, (off_t)header->tree, mctx,
+				       delete_callback, rbtdb, rbt_datafixer,
+				       rbtdb, &tree));
+	CHECK(dns_rbt_deserialize_tree(base, size, (off_t)header->nsec, mctx,
+				       delete_callback, rbtdb, rbt_datafixer,
+				       rbtdb, &nsec));
+	CHECK(dns_rbt_deserialize_tree(base, size, (off_t)header->nsec3, mctx,
+				       delete_callback, rbtdb, rbt_datafixer,
+				       rbtdb, &nsec3));
+
+	result = dns_rbt_findnode(tree, &rbtdb->common.origin, NULL,
+				  &origin_node, NULL, DNS_RBTFIND_EMPTYDATA,
+				  NULL, NULL);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_INVALIDFILE;
+		goto cleanup;
+	}
+
+#ifdef BIND9
+	if (rbtdb->rpz_cidr != NULL) {
+		dns_rbtnodechain_t chain;
+		dns_rbtnode_t *node;
+		dns_fixedname_t fixed;
+		dns_name_t *name;
+
+		dns_fixedname_init(&fixed);
+		name = dns_fixedname_name(&fixed);
+		dns_rbtnodechain_init(&chain, mctx);
+		result = dns_rbtnodechain_first(&chain, tree, NULL, NULL);
+		while (result == ISC_R_SUCCESS || result == DNS_R_NEWORIGIN) {
+			node = NULL;
+			dns_rbtnodechain_current(&chain, NULL, NULL, &node);
+			if (node->data != NULL &&
+			    dns_rbt_fullnamefromnode(node, name) ==
+			    ISC_R_SUCCESS)
+				dns_rpz_cidr_addip(rbtdb->rpz_cidr, name);
+			result = dns_rbtnodechain_next(&chain, NULL, NULL);
+		}
+		dns_rbtnodechain_invalidate(&chain);
+	}
+#endif
+
+	/*
+	 * Nothing else can see the database while it is being loaded,
+	 * so the trees can be swapped without the tree lock, just as
+	 * loading_addrdataset() adds to them.
+	 */
+	dns_rbt_destroy(&rbtdb->tree);
+	dns_rbt_destroy(&rbtdb->nsec);
+	dns_rbt_destroy(&rbtdb->nsec3);
+	rbtdb->tree = tree;
+	rbtdb->nsec = nsec;
+	rbtdb->nsec3 = nsec3;
+	rbtdb->origin_node = origin_node;
+
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	if (tree != NULL)
+		dns_rbt_destroy(&tree);
+	if (nsec != NULL)
+		dns_rbt_destroy(&nsec);
+	if (nsec3 != NULL)
+		dns_rbt_destroy(&nsec3);
+	/*
+	 * A tree that failed half way leaves headers in the re-signing
+	 * heaps that nothing refers to any more.
+	 */
+	for (i = 0; i < rbtdb->node_lock_count; i++)
+		while (isc_heap_element(rbtdb->heaps[i], 1) != NULL)
+			isc_heap_delete(rbtdb->heaps[i], 1);
+	return (result);
+}
+
+#undef CHECK
+
+static isc_result_t
+beginload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	rbtdb_load_t *loadctx;
 	dns_rbtdb_t *rbtdb;
 
 	rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(callbacks != NULL);
 
 	loadctx = isc_mem_get(rbtdb->common.mctx, sizeof(*loadctx));
 	if (loadctx == NULL)
@@ -7080,20 +7817,25 @@ beginload(dns_db_t *db, dns_addrdatasetfunc_t *addp, dns_dbload_t **dbloadp) {
 
 	RBTDB_UNLOCK(&rbtdb->lock, isc_rwlocktype_write);
 
-	*addp = loading_addrdataset;
-	*dbloadp = loadctx;
+	callbacks->add = loading_addrdataset;
+	callbacks->add_private = loadctx;
+	if (!IS_CACHE(rbtdb)) {
+		callbacks->deserialize = deserialize;
+		callbacks->deserialize_private = loadctx;
+	}
 
 	return (ISC_R_SUCCESS);
 }
 
 static isc_result_t
-endload(dns_db_t *db, dns_dbload_t **dbloadp) {
+endload(dns_db_t *db, dns_rdatacallbacks_t *callbacks) {
 	rbtdb_load_t *loadctx;
 	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
 
 	REQUIRE(VALID_RBTDB(rbtdb));
-	REQUIRE(dbloadp != NULL);
-	loadctx = *dbloadp;
+	REQUIRE(callbacks != NULL);
+	loadctx = callbacks->add_private;
+	REQUIRE(loadctx != NULL);
 	REQUIRE(loadctx->rbtdb == rbtdb);
 
 	RBTDB_LOCK(&rbtdb->lock, isc_rwlocktype_write);
@@ -7113,7 +7855,10 @@ endload(dns_db_t *db, dns_dbload_t **dbloadp) {
 	if (! IS_CACHE(rbtdb))
 		iszonesecure(db, rbtdb->current_version, rbtdb->origin_node);
 
-	*dbloadp = NULL;
+	callbacks->add = NULL;
+	callbacks->add_private = NULL;
+	callbacks->deserialize = NULL;
+	callbacks->deserialize_private = NULL;
 
 	isc_mem_put(rbtdb->common.mctx, loadctx, sizeof(*loadctx));
 
@@ -7310,6 +8055,7 @@ setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 	header = rdataset->private3;
 	header--;
 
+	fastread_revoke(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[header->node->locknum].lock,
 		  isc_rwlocktype_write);
 
@@ -7333,6 +8079,7 @@ setsigningtime(dns_db_t *db, dns_rdataset_t *rdataset, isc_stdtime_t resign) {
 	}
 	NODE_UNLOCK(&rbtdb->node_locks[header->node->locknum].lock,
 		    isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 	return (result);
 }
 
@@ -7411,6 +8158,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	INSIST(header != NULL);
 	header--;
 
+	fastread_revoke(rbtdb);
 	RWLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
 	NODE_LOCK(&rbtdb->node_locks[node->locknum].lock,
 		  isc_rwlocktype_write);
@@ -7426,6 +8174,7 @@ resigned(dns_db_t *db, dns_rdataset_t *rdataset, dns_dbversion_t *version)
 	NODE_UNLOCK(&rbtdb->node_locks[node->locknum].lock,
 		    isc_rwlocktype_write);
 	RWUNLOCK(&rbtdb->tree_lock, isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 }
 
 static dns_stats_t *
@@ -7438,11 +8187,37 @@ getrrsetstats(dns_db_t *db) {
 	return (rbtdb->rrsetstats);
 }
 
+static isc_result_t
+setservestalettl(dns_db_t *db, dns_ttl_t ttl) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(IS_CACHE(rbtdb));
+
+	/* 0 means disable. */
+	rbtdb->serve_stale_ttl = ISC_MIN(ttl, MAX_SERVE_STALE_TTL);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+getversionid(dns_db_t *db, dns_dbversion_t *version, isc_uint64_t *idp) {
+	dns_rbtdb_t *rbtdb = (dns_rbtdb_t *)db;
+	rbtdb_version_t *rbtversion = version;
+
+	REQUIRE(VALID_RBTDB(rbtdb));
+	REQUIRE(!IS_CACHE(rbtdb));
+	REQUIRE(rbtversion->rbtdb == rbtdb);
+
+	*idp = rbtversion->id;
+	return (ISC_R_SUCCESS);
+}
+
 static dns_dbmethods_t zone_methods = {
 	attach,
 	detach,
 	beginload,
 	endload,
+	serialize,
 	dump,
 	currentversion,
 	newversion,
@@ -7483,7 +8258,9 @@ static dns_dbmethods_t zone_methods = {
 	NULL,
 #endif
 	NULL,
-	NULL
+	NULL,
+	NULL,
+	getversionid
 };
 
 static dns_dbmethods_t cache_methods = {
@@ -7491,6 +8268,7 @@ static dns_dbmethods_t cache_methods = {
 	detach,
 	beginload,
 	endload,
+	NULL,
 	dump,
 	currentversion,
 	newversion,
@@ -7526,6 +8304,8 @@ static dns_dbmethods_t cache_methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
+	setservestalettl,
 	NULL
 };
 
@@ -7605,6 +8385,7 @@ dns_rbtdb_create
 	}
 
 	rbtdb->rrsetstats = NULL;
+	rbtdb->serve_stale_ttl = 0;
 	if (IS_CACHE(rbtdb)) {
 		result = dns_rdatasetstats_create(mctx, &rbtdb->rrsetstats);
 		if (result != ISC_R_SUCCESS)
@@ -7822,6 +8603,20 @@ dns_rbtdb_create
 	 */
 	PREPEND(rbtdb->open_versions, rbtdb->current_version, link);
 
+#ifdef RBTDB_FASTREAD
+	/*
+	 * Caches are written to all the time, so they always take the locks.
+	 * Should two zone databases ever share an ID, a writer of one just
+	 * waits for the readers of the other as well.
+	 */
+	if (!IS_CACHE(rbtdb)) {
+		do {
+			rbtdb->fastread_id =
+				isc_atomic_xadd(&fastread_lastid, 1) + 1;
+		} while (rbtdb->fastread_id == 0);
+	}
+#endif
+
 	rbtdb->common.magic = DNS_DB_MAGIC;
 	rbtdb->common.impmagic = RBTDB_MAGIC;
 
@@ -8112,11 +8907,13 @@ rdataset_settrust(dns_rdataset_t *rdataset, dns_trust_t trust) {
 	rdatasetheader_t *header = rdataset->private3;
 
 	header--;
+	fastread_revoke(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	header->trust = rdataset->trust = trust;
 	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
+	fastread_restore(rbtdb);
 }
 
 static void
@@ -8126,11 +8923,28 @@ rdataset_expire(dns_rdataset_t *rdataset) {
 	rdatasetheader_t *header = rdataset->private3;
 
 	header--;
+	fastread_revoke(rbtdb);
 	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
 	expire_header(rbtdb, header, ISC_FALSE);
 	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
 		  isc_rwlocktype_write);
+	fastread_restore(rbtdb);
+}
+
+static void
+rdataset_clearprefetch(dns_rdataset_t *rdataset) {
+	dns_rbtdb_t *rbtdb = rdataset->private1;
+	dns_rbtnode_t *rbtnode = rdataset->private2;
+	rdatasetheader_t *header = rdataset->private3;
+
+	header--;
+	NODE_LOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+		  isc_rwlocktype_write);
+	header->attributes &= ~RDATASET_ATTR_PREFETCH;
+	NODE_UNLOCK(&rbtdb->node_locks[rbtnode->locknum].lock,
+		  isc_rwlocktype_write);
+	rdataset->attributes &= ~DNS_RDATASETATTR_PREFETCH;
 }
 
 /*
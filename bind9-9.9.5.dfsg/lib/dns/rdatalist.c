@@ -48,6 +48,7 @@ static dns_rdatasetmethods_t methods = {
 	NULL,
 	NULL,
 	NULL,
+	NULL,
 	NULL
 };
 
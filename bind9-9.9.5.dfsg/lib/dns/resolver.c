@@ -4008,6 +4008,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_stdtime_t now;
 	isc_uint32_t ttl;
+	unsigned int options;
 
 	UNUSED(task); /* for now */
 
@@ -4249,8 +4250,11 @@ validated(isc_task_t *task, isc_event_t *event) {
 	if (result != ISC_R_SUCCESS)
 		goto noanswer_response;
 
+	options = 0;
+	if ((fctx->options & DNS_FETCHOPT_PREFETCH) != 0)
+		options = DNS_DBADD_PREFETCH;
 	result = dns_db_addrdataset(fctx->cache, node, NULL, now,
-				    vevent->rdataset, 0, ardataset);
+				    vevent->rdataset, options, ardataset);
 	if (result != ISC_R_SUCCESS &&
 	    result != DNS_R_UNCHANGED)
 		goto noanswer_response;
@@ -4261,7 +4265,7 @@ validated(isc_task_t *task, isc_event_t *event) {
 			eresult = DNS_R_NCACHENXRRSET;
 	} else if (vevent->sigrdataset != NULL) {
 		result = dns_db_addrdataset(fctx->cache, node, NULL, now,
-					    vevent->sigrdataset, 0,
+					    vevent->sigrdataset, options,
 					    asigrdataset);
 		if (result != ISC_R_SUCCESS &&
 		    result != DNS_R_UNCHANGED)
@@ -4301,7 +4305,9 @@ validated(isc_task_t *task, isc_event_t *event) {
 
  answer_response:
 	/*
-	 * Cache any NS/NSEC records that happened to be validated.
+	 * Cache any NS/NSEC/SOA records that happened to be validated.
+	 * The SOA lets the query code synthesize negative answers from
+	 * cached NSEC records.
 	 */
 	result = dns_message_firstname(fctx->rmessage, DNS_SECTION_AUTHORITY);
 	while (result == ISC_R_SUCCESS) {
@@ -4312,7 +4318,8 @@ validated(isc_task_t *task, isc_event_t *event) {
 		     rdataset != NULL;
 		     rdataset = ISC_LIST_NEXT(rdataset, link)) {
 			if ((rdataset->type != dns_rdatatype_ns &&
-			     rdataset->type != dns_rdatatype_nsec) ||
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_soa) ||
 			    rdataset->trust != dns_trust_secure)
 				continue;
 			for (sigrdataset = ISC_LIST_HEAD(name->list);
@@ -4660,6 +4667,14 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 		if (rdataset->ttl > res->view->maxcachettl)
 			rdataset->ttl = res->view->maxcachettl;
 
+		/*
+		 * Mark answers that live long enough to be worth
+		 * refreshing before they expire.
+		 */
+		if (ANSWER(rdataset) && res->view->prefetch_trigger != 0 &&
+		    rdataset->ttl >= res->view->prefetch_eligible)
+			rdataset->attributes |= DNS_RDATASETATTR_PREFETCH;
+
 		/*
 		 * Find the SIG for this rdataset, if we have it.
 		 */
@@ -4866,7 +4881,9 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_adbaddrinfo_t *addrinfo,
 				 * over the existing cache contents.
 				 */
 				options = DNS_DBADD_FORCE;
-			} else
+			} else if ((fctx->options & DNS_FETCHOPT_PREFETCH) != 0)
+				options = DNS_DBADD_PREFETCH;
+			else
 				options = 0;
 
 			if (ANSWER(rdataset) &&
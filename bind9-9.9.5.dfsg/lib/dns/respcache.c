@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/buffer.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/respcache.h>
+
+#define RESPCACHE_MAGIC			ISC_MAGIC('R', 'c', 'h', 'e')
+#define DNS_RESPCACHE_VALID(rc)		ISC_MAGIC_VALID(rc, RESPCACHE_MAGIC)
+
+/*%
+ * Number of independently locked parts of the cache.  Must be a power
+ * of two.
+ */
+#define NSTRIPES	16
+
+/*%
+ * Hash buckets per stripe are sized for about one entry of this many
+ * bytes per bucket, within these limits.
+ */
+#define BUCKETBYTES	512
+#define MINBUCKETS	16
+#define MAXBUCKETS	65536
+
+typedef struct respentry respentry_t;
+struct respentry {
+	unsigned int			hashval;
+	ISC_LINK(respentry_t)		hlink;
+	ISC_LINK(respentry_t)		lru;
+	isc_uint64_t			versionid;	/*%< dns_db_getversionid() */
+	unsigned int			tag;
+	unsigned int			keylen;
+	unsigned int			wirelen;
+	/* The key, then the wire data, follow the structure. */
+};
+
+typedef ISC_LIST(respentry_t) resplist_t;
+
+typedef struct {
+	isc_mutex_t			lock;
+	unsigned int			mask;
+	resplist_t			*buckets;
+	resplist_t			lru;
+	size_t				used;
+	size_t				limit;
+} respstripe_t;
+
+struct dns_respcache {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	unsigned int			nbuckets;
+	respstripe_t			stripes[NSTRIPES];
+};
+
+#define ENTRYSIZE(e)	(sizeof(respentry_t) + (e)->keylen + (e)->wirelen)
+#define ENTRYKEY(e)	((unsigned char *)((e) + 1))
+#define ENTRYWIRE(e)	(ENTRYKEY(e) + (e)->keylen)
+
+static unsigned int
+hash_key(const isc_region_t *key) {
+	unsigned int h = 2166136261U;
+	unsigned int i;
+
+	for (i = 0; i < key->length; i++) {
+		h ^= key->base[i];
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static inline respstripe_t *
+stripe_of(dns_respcache_t *rc, unsigned int hashval) {
+	return (&rc->stripes[hashval & (NSTRIPES - 1)]);
+}
+
+static inline resplist_t *
+bucket_of(respstripe_t *stripe, unsigned int hashval) {
+	return (&stripe->buckets[(hashval / NSTRIPES) & stripe->mask]);
+}
+
+/*
+ * Unlink 'entry' from 'stripe' and put it on 'dead' to be freed once
+ * the stripe lock has been released.
+ */
+static void
+unlink_entry(respstripe_t *stripe, respentry_t *entry, resplist_t *dead) {
+	ISC_LIST_UNLINK(*bucket_of(stripe, entry->hashval), entry, hlink);
+	ISC_LIST_UNLINK(stripe->lru, entry, lru);
+	INSIST(stripe->used >= ENTRYSIZE(entry));
+	stripe->used -= ENTRYSIZE(entry);
+	ISC_LIST_APPEND(*dead, entry, lru);
+}
+
+static void
+free_entries(dns_respcache_t *rc, resplist_t *dead) {
+	respentry_t *entry;
+
+	while ((entry = ISC_LIST_HEAD(*dead)) != NULL) {
+		ISC_LIST_UNLINK(*dead, entry, lru);
+		isc_mem_put(rc->mctx, entry, ENTRYSIZE(entry));
+	}
+}
+
+static respentry_t *
+find_entry(respstripe_t *stripe, const isc_region_t *key,
+	   unsigned int hashval)
+{
+	respentry_t *entry;
+
+	for (entry = ISC_LIST_HEAD(*bucket_of(stripe, hashval));
+	     entry != NULL;
+	     entry = ISC_LIST_NEXT(entry, hlink))
+	{
+		if (entry->hashval == hashval &&
+		    entry->keylen == key->length &&
+		    memcmp(ENTRYKEY(entry), key->base, key->length) == 0)
+			return (entry);
+	}
+	return (NULL);
+}
+
+isc_result_t
+dns_respcache_create(isc_mem_t *mctx, size_t size, dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	unsigned int nbuckets, i, j;
+	isc_result_t result;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size != 0);
+	REQUIRE(rcp != NULL && *rcp == NULL);
+
+	rc = isc_mem_get(mctx, sizeof(*rc));
+	if (rc == NULL)
+		return (ISC_R_NOMEMORY);
+
+	nbuckets = MINBUCKETS;
+	while (nbuckets < MAXBUCKETS &&
+	       (size_t)nbuckets * BUCKETBYTES * NSTRIPES < size)
+		nbuckets <<= 1;
+	rc->nbuckets = nbuckets;
+
+	for (i = 0; i < NSTRIPES; i++) {
+		respstripe_t *stripe = &rc->stripes[i];
+
+		stripe->buckets = isc_mem_get(mctx,
+					      nbuckets * sizeof(resplist_t));
+		if (stripe->buckets == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->buckets,
+				    nbuckets * sizeof(resplist_t));
+			goto cleanup;
+		}
+		for (j = 0; j < nbuckets; j++)
+			ISC_LIST_INIT(stripe->buckets[j]);
+		stripe->mask = nbuckets - 1;
+		ISC_LIST_INIT(stripe->lru);
+		stripe->used = 0;
+		stripe->limit = size / NSTRIPES;
+	}
+
+	rc->mctx = NULL;
+	isc_mem_attach(mctx, &rc->mctx);
+	rc->magic = RESPCACHE_MAGIC;
+	*rcp = rc;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		DESTROYLOCK(&rc->stripes[i].lock);
+		isc_mem_put(mctx, rc->stripes[i].buckets,
+			    nbuckets * sizeof(resplist_t));
+	}
+	isc_mem_put(mctx, rc, sizeof(*rc));
+	return (result);
+}
+
+void
+dns_respcache_flush(dns_respcache_t *rc) {
+	respentry_t *entry;
+	resplist_t dead;
+	unsigned int i;
+
+	REQUIRE(DNS_RESPCACHE_VALID(rc));
+
+	for (i = 0; i < NSTRIPES; i++) {
+		respstripe_t *stripe = &rc->stripes[i];
+
+		ISC_LIST_INIT(dead);
+		LOCK(&stripe->lock);
+		while ((entry = ISC_LIST_HEAD(stripe->lru)) != NULL)
+			unlink_entry(stripe, entry, &dead);
+		UNLOCK(&stripe->lock);
+		free_entries(rc, &dead);
+	}
+}
+
+void
+dns_respcache_destroy(dns_respcache_t **rcp) {
+	dns_respcache_t *rc;
+	unsigned int i;
+
+	REQUIRE(rcp != NULL);
+	rc = *rcp;
+	REQUIRE(DNS_RESPCACHE_VALID(rc));
+
+	dns_respcache_flush(rc);
+
+	rc->magic = 0;
+	for (i = 0; i < NSTRIPES; i++) {
+		INSIST(rc->stripes[i].used == 0);
+		DESTROYLOCK(&rc->stripes[i].lock);
+		isc_mem_put(rc->mctx, rc->stripes[i].buckets,
+			    rc->nbuckets * sizeof(resplist_t));
+	}
+	isc_mem_putanddetach(&rc->mctx, rc, sizeof(*rc));
+	*rcp = NULL;
+}
+
+isc_result_t
+dns_respcache_find(dns_respcache_t *rc, const isc_region_t *key,
+		   dns_db_t *db, dns_dbversion_t *version,
+		   isc_buffer_t *target, unsigned int *tagp)
+{
+	respstripe_t *stripe;
+	respentry_t *entry;
+	resplist_t dead;
+	unsigned int hashval;
+	isc_uint64_t versionid;
+	isc_result_t result;
+
+	REQUIRE(DNS_RESPCACHE_VALID(rc));
+	REQUIRE(key != NULL);
+	REQUIRE(db != NULL && version != NULL);
+	REQUIRE(target != NULL);
+	REQUIRE(tagp != NULL);
+
+	result = dns_db_getversionid(db, version, &versionid);
+	if (result != ISC_R_SUCCESS)
+		return (ISC_R_NOTFOUND);
+
+	hashval = hash_key(key);
+	stripe = stripe_of(rc, hashval);
+	ISC_LIST_INIT(dead);
+
+	LOCK(&stripe->lock);
+	entry = find_entry(stripe, key, hashval);
+	if (entry == NULL) {
+		result = ISC_R_NOTFOUND;
+	} else if (entry->versionid != versionid) {
+		unlink_entry(stripe, entry, &dead);
+		result = ISC_R_NOTFOUND;
+	} else if (isc_buffer_availablelength(target) < entry->wirelen) {
+		result = ISC_R_NOSPACE;
+	} else {
+		isc_buffer_putmem(target, ENTRYWIRE(entry), entry->wirelen);
+		*tagp = entry->tag;
+		if (entry != ISC_LIST_HEAD(stripe->lru)) {
+			ISC_LIST_UNLINK(stripe->lru, entry, lru);
+			ISC_LIST_PREPEND(stripe->lru, entry, lru);
+		}
+		result = ISC_R_SUCCESS;
+	}
+	UNLOCK(&stripe->lock);
+
+	free_entries(rc, &dead);
+	return (result);
+}
+
+isc_result_t
+dns_respcache_add(dns_respcache_t *rc, const isc_region_t *key,
+		  dns_db_t *db, dns_dbversion_t *version, unsigned int tag,
+		  const isc_region_t *wire)
+{
+	respstripe_t *stripe;
+	respentry_t *entry, *old;
+	resplist_t dead;
+	isc_uint64_t versionid;
+	isc_result_t result;
+	size_t size;
+
+	REQUIRE(DNS_RESPCACHE_VALID(rc));
+	REQUIRE(key != NULL);
+	REQUIRE(db != NULL && version != NULL);
+	REQUIRE(wire != NULL);
+
+	if (key->length > DNS_RESPCACHE_MAXKEY ||
+	    wire->length > DNS_RESPCACHE_MAXWIRE)
+		return (ISC_R_RANGE);
+
+	/*
+	 * Only databases whose versions follow their contents will do.
+	 */
+	if (dns_db_iscache(db) || dns_db_ispersistent(db))
+		return (ISC_R_NOTIMPLEMENTED);
+	result = dns_db_getversionid(db, version, &versionid);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	size = sizeof(*entry) + key->length + wire->length;
+	entry = isc_mem_get(rc->mctx, size);
+	if (entry == NULL)
+		return (ISC_R_NOMEMORY);
+
+	entry->hashval = hash_key(key);
+	ISC_LINK_INIT(entry, hlink);
+	ISC_LINK_INIT(entry, lru);
+	entry->versionid = versionid;
+	entry->tag = tag;
+	entry->keylen = key->length;
+	entry->wirelen = wire->length;
+	memmove(ENTRYKEY(entry), key->base, key->length);
+	memmove(ENTRYWIRE(entry), wire->base, wire->length);
+
+	stripe = stripe_of(rc, entry->hashval);
+	ISC_LIST_INIT(dead);
+
+	LOCK(&stripe->lock);
+	old = find_entry(stripe, key, entry->hashval);
+	if (old != NULL)
+		unlink_entry(stripe, old, &dead);
+	if (size > stripe->limit) {
+		/* Bigger than the whole stripe. */
+		ISC_LIST_APPEND(dead, entry, lru);
+	} else {
+		while (stripe->used + size > stripe->limit) {
+			old = ISC_LIST_TAIL(stripe->lru);
+			INSIST(old != NULL);
+			unlink_entry(stripe, old, &dead);
+		}
+		ISC_LIST_PREPEND(*bucket_of(stripe, entry->hashval),
+				 entry, hlink);
+		ISC_LIST_PREPEND(stripe->lru, entry, lru);
+		stripe->used += size;
+	}
+	UNLOCK(&stripe->lock);
+
+	free_entries(rc, &dead);
+	return (ISC_R_SUCCESS);
+}
@@ -37,8 +37,8 @@
 #include <dns/view.h>
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len);
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len);
 
 /*
  * Get a modulus for a hash function that is tolerably likely to be
@@ -131,20 +131,22 @@ delta_rrl_time(isc_stdtime_t ts, isc_stdtime_t now) {
 }
 
 static inline int
-get_age(const dns_rrl_t *rrl, const dns_rrl_entry_t *e, isc_stdtime_t now) {
+get_age(const dns_rrl_shard_t *shard, const dns_rrl_entry_t *e,
+	isc_stdtime_t now)
+{
 	if (!e->ts_valid)
 		return (DNS_RRL_FOREVER);
-	return (delta_rrl_time(e->ts + rrl->ts_bases[e->ts_gen], now));
+	return (delta_rrl_time(e->ts + shard->ts_bases[e->ts_gen], now));
 }
 
 static inline void
-set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
+set_age(dns_rrl_shard_t *shard, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	dns_rrl_entry_t *e_old;
 	unsigned int ts_gen;
 	int i, ts;
 
-	ts_gen = rrl->ts_gen;
-	ts = now - rrl->ts_bases[ts_gen];
+	ts_gen = shard->ts_gen;
+	ts = now - shard->ts_bases[ts_gen];
 	if (ts < 0) {
 		if (ts < -DNS_RRL_MAX_TIME_TRAVEL)
 			ts = DNS_RRL_FOREVER;
@@ -166,7 +168,7 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	 */
 	if (ts >= DNS_RRL_MAX_TS) {
 		ts_gen = (ts_gen + 1) % DNS_RRL_TS_BASES;
-		for (e_old = ISC_LIST_TAIL(rrl->lru), i = 0;
+		for (e_old = ISC_LIST_TAIL(shard->lru), i = 0;
 		     e_old != NULL && (e_old->ts_gen == ts_gen ||
 				       !ISC_LINK_LINKED(e_old, hlink));
 		     e_old = ISC_LIST_PREV(e_old, lru), ++i)
@@ -178,15 +180,15 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 				      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DEBUG1,
 				      "rrl new time base scanned %d entries"
 				      " at %d for %d %d %d %d",
-				      i, now, rrl->ts_bases[ts_gen],
-				      rrl->ts_bases[(ts_gen + 1) %
+				      i, now, shard->ts_bases[ts_gen],
+				      shard->ts_bases[(ts_gen + 1) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 2) %
+				      shard->ts_bases[(ts_gen + 2) %
 					DNS_RRL_TS_BASES],
-				      rrl->ts_bases[(ts_gen + 3) %
+				      shard->ts_bases[(ts_gen + 3) %
 					DNS_RRL_TS_BASES]);
-		rrl->ts_gen = ts_gen;
-		rrl->ts_bases[ts_gen] = now;
+		shard->ts_gen = ts_gen;
+		shard->ts_bases[ts_gen] = now;
 		ts = 0;
 	}
 
@@ -195,18 +197,26 @@ set_age(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_stdtime_t now) {
 	e->ts_valid = ISC_TRUE;
 }
 
+/*
+ * The configured table sizes are for the whole limiter.  Each shard
+ * gets its share, rounded up.
+ */
+static inline int
+shard_entries(int entries) {
+	return ((entries + DNS_RRL_SHARDS - 1) / DNS_RRL_SHARDS);
+}
+
 static isc_result_t
-expand_entries(dns_rrl_t *rrl, int new) {
+expand_entries(dns_rrl_t *rrl, dns_rrl_shard_t *shard, int new) {
 	unsigned int bsize;
 	dns_rrl_block_t *b;
 	dns_rrl_entry_t *e;
 	double rate;
-	int i;
+	int i, max_entries;
 
-	if (rrl->num_entries + new >= rrl->max_entries &&
-	    rrl->max_entries != 0)
-	{
-		new = rrl->max_entries - rrl->num_entries;
+	max_entries = shard_entries(rrl->max_entries);
+	if (shard->num_entries + new >= max_entries && max_entries != 0) {
+		new = max_entries - shard->num_entries;
 		if (new <= 0)
 			return (ISC_R_SUCCESS);
 	}
@@ -216,16 +226,18 @@ expand_entries(dns_rrl_t *rrl, int new) {
 	 * and min-table-size.
 	 */
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) &&
-	    rrl->hash != NULL) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+	    shard->hash != NULL) {
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL entries with"
-			      " %d bins; average search length %.1f",
-			      rrl->num_entries, rrl->num_entries+new,
-			      rrl->hash->length, rate);
+			      " %d bins in shard %d;"
+			      " average search length %.1f",
+			      shard->num_entries, shard->num_entries+new,
+			      shard->hash->length,
+			      (int)(shard - rrl->shards), rate);
 	}
 
 	bsize = sizeof(dns_rrl_block_t) + (new-1)*sizeof(dns_rrl_entry_t);
@@ -243,10 +255,10 @@ expand_entries(dns_rrl_t *rrl, int new) {
 	e = b->entries;
 	for (i = 0; i < new; ++i, ++e) {
 		ISC_LINK_INIT(e, hlink);
-		ISC_LIST_INITANDAPPEND(rrl->lru, e, lru);
+		ISC_LIST_INITANDAPPEND(shard->lru, e, lru);
 	}
-	rrl->num_entries += new;
-	ISC_LIST_INITANDAPPEND(rrl->blocks, b, link);
+	shard->num_entries += new;
+	ISC_LIST_INITANDAPPEND(shard->blocks, b, link);
 
 	return (ISC_R_SUCCESS);
 }
@@ -257,12 +269,12 @@ get_bin(dns_rrl_hash_t *hash, unsigned int hval) {
 }
 
 static void
-free_old_hash(dns_rrl_t *rrl) {
+free_old_hash(dns_rrl_t *rrl, dns_rrl_shard_t *shard) {
 	dns_rrl_hash_t *old_hash;
 	dns_rrl_bin_t *old_bin;
 	dns_rrl_entry_t *e, *e_next;
 
-	old_hash = rrl->old_hash;
+	old_hash = shard->old_hash;
 	for (old_bin = &old_hash->bins[0];
 	     old_bin < &old_hash->bins[old_hash->length];
 	     ++old_bin)
@@ -276,26 +288,26 @@ free_old_hash(dns_rrl_t *rrl) {
 	isc_mem_put(rrl->mctx, old_hash,
 		    sizeof(*old_hash)
 		      + (old_hash->length - 1) * sizeof(old_hash->bins[0]));
-	rrl->old_hash = NULL;
+	shard->old_hash = NULL;
 }
 
 static isc_result_t
-expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
+expand_rrl_hash(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now) {
 	dns_rrl_hash_t *hash;
 	int old_bins, new_bins, hsize;
 	double rate;
 
-	if (rrl->old_hash != NULL)
-		free_old_hash(rrl);
+	if (shard->old_hash != NULL)
+		free_old_hash(rrl, shard);
 
 	/*
 	 * Most searches fail and so go to the end of the chain.
 	 * Use a small hash table load factor.
 	 */
-	old_bins = (rrl->hash == NULL) ? 0 : rrl->hash->length;
+	old_bins = (shard->hash == NULL) ? 0 : shard->hash->length;
 	new_bins = old_bins/8 + old_bins;
-	if (new_bins < rrl->num_entries)
-		new_bins = rrl->num_entries;
+	if (new_bins < shard->num_entries)
+		new_bins = shard->num_entries;
 	new_bins = hash_divisor(new_bins);
 
 	hsize = sizeof(dns_rrl_hash_t) + (new_bins-1)*sizeof(hash->bins[0]);
@@ -310,38 +322,42 @@ expand_rrl_hash(dns_rrl_t *rrl, isc_stdtime_t now) {
 	}
 	memset(hash, 0, hsize);
 	hash->length = new_bins;
-	rrl->hash_gen ^= 1;
-	hash->gen = rrl->hash_gen;
+	shard->hash_gen ^= 1;
+	hash->gen = shard->hash_gen;
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DROP) && old_bins != 0) {
-		rate = rrl->probes;
-		if (rrl->searches != 0)
-			rate /= rrl->searches;
+		rate = shard->probes;
+		if (shard->searches != 0)
+			rate /= shard->searches;
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
 			      DNS_LOGMODULE_REQUEST, DNS_RRL_LOG_DROP,
 			      "increase from %d to %d RRL bins for"
-			      " %d entries; average search length %.1f",
-			      old_bins, new_bins, rrl->num_entries, rate);
+			      " %d entries in shard %d;"
+			      " average search length %.1f",
+			      old_bins, new_bins, shard->num_entries,
+			      (int)(shard - rrl->shards), rate);
 	}
 
-	rrl->old_hash = rrl->hash;
-	if (rrl->old_hash != NULL)
-		rrl->old_hash->check_time = now;
-	rrl->hash = hash;
+	shard->old_hash = shard->hash;
+	if (shard->old_hash != NULL)
+		shard->old_hash->check_time = now;
+	shard->hash = hash;
 
 	return (ISC_R_SUCCESS);
 }
 
 static void
-ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
+ref_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	  int probes, isc_stdtime_t now)
+{
 	/*
 	 * Make the entry most recently used.
 	 */
-	if (ISC_LIST_HEAD(rrl->lru) != e) {
-		if (e == rrl->last_logged)
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
-		ISC_LIST_UNLINK(rrl->lru, e, lru);
-		ISC_LIST_PREPEND(rrl->lru, e, lru);
+	if (ISC_LIST_HEAD(shard->lru) != e) {
+		if (e == shard->last_logged)
+			shard->last_logged = ISC_LIST_PREV(e, lru);
+		ISC_LIST_UNLINK(shard->lru, e, lru);
+		ISC_LIST_PREPEND(shard->lru, e, lru);
 	}
 
 	/*
@@ -350,15 +366,15 @@ ref_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, int probes, isc_stdtime_t now) {
 	 * old hash table.  It will migrate to the new hash table the next
 	 * time it is used or be cut loose when the old hash table is destroyed.
 	 */
-	rrl->probes += probes;
-	++rrl->searches;
-	if (rrl->searches > 100 &&
-	    delta_rrl_time(rrl->hash->check_time, now) > 1) {
-		if (rrl->probes/rrl->searches > 2)
-			expand_rrl_hash(rrl, now);
-		rrl->hash->check_time = now;
-		rrl->probes = 0;
-		rrl->searches = 0;
+	shard->probes += probes;
+	++shard->searches;
+	if (shard->searches > 100 &&
+	    delta_rrl_time(shard->hash->check_time, now) > 1) {
+		if (shard->probes/shard->searches > 2)
+			expand_rrl_hash(rrl, shard, now);
+		shard->hash->check_time = now;
+		shard->probes = 0;
+		shard->searches = 0;
 	}
 }
 
@@ -381,6 +397,39 @@ hash_key(const dns_rrl_key_t *key) {
 	return (hval);
 }
 
+/*
+ * Pick the shard for a key from the high bits of a multiplicative hash,
+ * so that it is independent of the hash table bin chosen within the shard.
+ */
+static inline dns_rrl_shard_t *
+get_shard(dns_rrl_t *rrl, isc_uint32_t hval) {
+	hval *= 2654435761U;
+	return (&rrl->shards[hval >> (32 - DNS_RRL_SHARD_BITS)]);
+}
+
+static inline void
+lock_shards(dns_rrl_shard_t *shard, dns_rrl_shard_t *shard_all) {
+	/*
+	 * Always lock two shards in address order to avoid deadlock.
+	 */
+	if (shard_all == NULL || shard_all == shard) {
+		LOCK(&shard->lock);
+	} else if (shard < shard_all) {
+		LOCK(&shard->lock);
+		LOCK(&shard_all->lock);
+	} else {
+		LOCK(&shard_all->lock);
+		LOCK(&shard->lock);
+	}
+}
+
+static inline void
+unlock_shards(dns_rrl_shard_t *shard, dns_rrl_shard_t *shard_all) {
+	if (shard_all != NULL && shard_all != shard)
+		UNLOCK(&shard_all->lock);
+	UNLOCK(&shard->lock);
+}
+
 /*
  * Construct the hash table key.
  * Use a hash of the DNS query name to save space in the database.
@@ -488,32 +537,28 @@ response_balance(dns_rrl_t *rrl, const dns_rrl_entry_t *e, int age) {
 
 /*
  * Search for an entry for a response and optionally create it.
+ * The caller holds the lock of the shard chosen by get_shard(rrl, hval).
  */
 static dns_rrl_entry_t *
-get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
-	  dns_rdataclass_t qclass, dns_rdatatype_t qtype, dns_name_t *qname,
-	  dns_rrl_rtype_t rtype, isc_stdtime_t now, isc_boolean_t create,
+get_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard,
+	  const dns_rrl_key_t *key, isc_uint32_t hval,
+	  isc_stdtime_t now, isc_boolean_t create,
 	  char *log_buf, unsigned int log_buf_len)
 {
-	dns_rrl_key_t key;
-	isc_uint32_t hval;
 	dns_rrl_entry_t *e;
 	dns_rrl_hash_t *hash;
 	dns_rrl_bin_t *new_bin, *old_bin;
 	int probes, age;
 
-	make_key(rrl, &key, client_addr, qtype, qname, qclass, rtype);
-	hval = hash_key(&key);
-
 	/*
 	 * Look for the entry in the current hash table.
 	 */
-	new_bin = get_bin(rrl->hash, hval);
+	new_bin = get_bin(shard->hash, hval);
 	probes = 1;
 	e = ISC_LIST_HEAD(*new_bin);
 	while (e != NULL) {
-		if (key_cmp(&e->key, &key)) {
-			ref_entry(rrl, e, probes, now);
+		if (key_cmp(&e->key, key)) {
+			ref_entry(rrl, shard, e, probes, now);
 			return (e);
 		}
 		++probes;
@@ -523,15 +568,15 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	/*
 	 * Look in the old hash table.
 	 */
-	if (rrl->old_hash != NULL) {
-		old_bin = get_bin(rrl->old_hash, hval);
+	if (shard->old_hash != NULL) {
+		old_bin = get_bin(shard->old_hash, hval);
 		e = ISC_LIST_HEAD(*old_bin);
 		while (e != NULL) {
-			if (key_cmp(&e->key, &key)) {
+			if (key_cmp(&e->key, key)) {
 				ISC_LIST_UNLINK(*old_bin, e, hlink);
 				ISC_LIST_PREPEND(*new_bin, e, hlink);
-				e->hash_gen = rrl->hash_gen;
-				ref_entry(rrl, e, probes, now);
+				e->hash_gen = shard->hash_gen;
+				ref_entry(rrl, shard, e, probes, now);
 				return (e);
 			}
 			e = ISC_LIST_NEXT(e, hlink);
@@ -540,9 +585,9 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 		/*
 		 * Discard prevous hash table when all of its entries are old.
 		 */
-		age = delta_rrl_time(rrl->old_hash->check_time, now);
+		age = delta_rrl_time(shard->old_hash->check_time, now);
 		if (age > rrl->window)
-			free_old_hash(rrl);
+			free_old_hash(rrl, shard);
 	}
 
 	if (!create)
@@ -554,13 +599,13 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 	 * Try to make more entries if none are idle.
 	 * Steal the oldest entry if we cannot create more.
 	 */
-	for (e = ISC_LIST_TAIL(rrl->lru);
+	for (e = ISC_LIST_TAIL(shard->lru);
 	     e != NULL;
 	     e = ISC_LIST_PREV(e, lru))
 	{
 		if (!ISC_LINK_LINKED(e, hlink))
 			break;
-		age = get_age(rrl, e, now);
+		age = get_age(shard, e, now);
 		if (age <= 1) {
 			e = NULL;
 			break;
@@ -569,24 +614,25 @@ get_entry(dns_rrl_t *rrl, const isc_sockaddr_t *client_addr,
 			break;
 	}
 	if (e == NULL) {
-		expand_entries(rrl, ISC_MIN((rrl->num_entries+1)/2, 1000));
-		e = ISC_LIST_TAIL(rrl->lru);
+		expand_entries(rrl, shard,
+			       ISC_MIN((shard->num_entries+1)/2, 1000));
+		e = ISC_LIST_TAIL(shard->lru);
 	}
 	if (e->logged)
-		log_end(rrl, e, ISC_TRUE, log_buf, log_buf_len);
+		log_end(rrl, shard, e, ISC_TRUE, log_buf, log_buf_len);
 	if (ISC_LINK_LINKED(e, hlink)) {
-		if (e->hash_gen == rrl->hash_gen)
-			hash = rrl->hash;
+		if (e->hash_gen == shard->hash_gen)
+			hash = shard->hash;
 		else
-			hash = rrl->old_hash;
+			hash = shard->old_hash;
 		old_bin = get_bin(hash, hash_key(&e->key));
 		ISC_LIST_UNLINK(*old_bin, e, hlink);
 	}
 	ISC_LIST_PREPEND(*new_bin, e, hlink);
-	e->hash_gen = rrl->hash_gen;
-	e->key = key;
+	e->hash_gen = shard->hash_gen;
+	e->key = *key;
 	e->ts_valid = ISC_FALSE;
-	ref_entry(rrl, e, probes, now);
+	ref_entry(rrl, shard, e, probes, now);
 	return (e);
 }
 
@@ -607,14 +653,20 @@ debit_log(const dns_rrl_entry_t *e, int age, const char *action) {
 		      hash_key(&e->key), age_str, e->responses, action);
 }
 
+/*
+ * Debit the token bucket of an entry.  The caller holds the entry's
+ * shard lock.  'tcp_credit' says whether the client has recently used TCP.
+ * The scaled rates are shared by all shards; concurrent updates of them
+ * store the same value computed from the same qps estimate, or one of two
+ * estimates from adjacent seconds, so they are not locked.
+ */
 static inline dns_rrl_result_t
-debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
-		const isc_sockaddr_t *client_addr, isc_stdtime_t now,
-		char *log_buf, unsigned int log_buf_len)
+debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+		double qps, double scale, isc_boolean_t tcp_credit,
+		isc_stdtime_t now)
 {
 	int rate, new_rate, slip, new_slip, age, log_secs, min;
 	dns_rrl_rate_t *ratep;
-	dns_rrl_entry_t const *credit_e;
 
 	/*
 	 * Pick the rate counter.
@@ -629,12 +681,8 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 		/*
 		 * The limit for clients that have used TCP is not scaled.
 		 */
-		credit_e = get_entry(rrl, client_addr,
-				     0, dns_rdatatype_none, NULL,
-				     DNS_RRL_RTYPE_TCP, now, ISC_FALSE,
-				     log_buf, log_buf_len);
-		if (credit_e != NULL) {
-			age = get_age(rrl, e, now);
+		if (tcp_credit) {
+			age = get_age(shard, e, now);
 			if (age < rrl->window)
 				scale = 1.0;
 		}
@@ -663,7 +711,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	 * Treat entries older than the window as if they were just created
 	 * Credit other entries.
 	 */
-	age = get_age(rrl, e, now);
+	age = get_age(shard, e, now);
 	if (age > 0) {
 		/*
 		 * Credit tokens earned during elapsed time.
@@ -694,7 +742,7 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 			e->log_secs = log_secs;
 		}
 	}
-	set_age(rrl, e, now);
+	set_age(shard, e, now);
 
 	/*
 	 * Debit the entry for this response.
@@ -745,6 +793,11 @@ debit_rrl_entry(dns_rrl_t *rrl, dns_rrl_entry_t *e, double qps, double scale,
 	return (DNS_RRL_RESULT_DROP);
 }
 
+/*
+ * The qname buffers are shared by all shards.  A buffer is attached to an
+ * entry or detached from it only with the entry's shard lock held, so
+ * this unlocked check is stable for the holder of that lock.
+ */
 static inline dns_rrl_qname_buf_t *
 get_qname(dns_rrl_t *rrl, const dns_rrl_entry_t *e) {
 	dns_rrl_qname_buf_t *qbuf;
@@ -761,8 +814,10 @@ free_qname(dns_rrl_t *rrl, dns_rrl_entry_t *e) {
 
 	qbuf = get_qname(rrl, e);
 	if (qbuf != NULL) {
+		LOCK(&rrl->lock);
 		qbuf->e = NULL;
 		ISC_LIST_APPEND(rrl->qname_free, qbuf, link);
+		UNLOCK(&rrl->lock);
 	}
 }
 
@@ -884,6 +939,7 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 			/*
 			 * Capture the qname for the "stop limiting" message.
 			 */
+			LOCK(&rrl->lock);
 			qbuf = ISC_LIST_TAIL(rrl->qname_free);
 			if (qbuf != NULL) {
 				ISC_LIST_UNLINK(rrl->qname_free, qbuf, link);
@@ -904,9 +960,11 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 						      (int)sizeof(*qbuf));
 				}
 			}
+			if (qbuf != NULL)
+				qbuf->e = e;
+			UNLOCK(&rrl->lock);
 			if (qbuf != NULL) {
 				e->log_qname = qbuf->index;
-				qbuf->e = e;
 				dns_fixedname_init(&qbuf->qname);
 				dns_name_copy(qname,
 					      dns_fixedname_name(&qbuf->qname),
@@ -941,8 +999,8 @@ make_log_buf(dns_rrl_t *rrl, dns_rrl_entry_t *e,
 }
 
 static void
-log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
-	char *log_buf, unsigned int log_buf_len)
+log_end(dns_rrl_t *rrl, dns_rrl_shard_t *shard, dns_rrl_entry_t *e,
+	isc_boolean_t early, char *log_buf, unsigned int log_buf_len)
 {
 	if (e->logged) {
 		make_log_buf(rrl, e,
@@ -957,7 +1015,7 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
 			      "%s", log_buf);
 		free_qname(rrl, e);
 		e->logged = ISC_FALSE;
-		--rrl->num_logged;
+		--shard->num_logged;
 	}
 }
 
@@ -965,39 +1023,50 @@ log_end(dns_rrl_t *rrl, dns_rrl_entry_t *e, isc_boolean_t early,
  * Log messages for streams that have stopped being rate limited.
  */
 static void
-log_stops(dns_rrl_t *rrl, isc_stdtime_t now, int limit,
-	  char *log_buf, unsigned int log_buf_len)
+log_stops(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now,
+	  int limit, char *log_buf, unsigned int log_buf_len)
 {
 	dns_rrl_entry_t *e;
 	int age;
 
-	for (e = rrl->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
+	for (e = shard->last_logged; e != NULL; e = ISC_LIST_PREV(e, lru)) {
 		if (!e->logged)
 			continue;
 		if (now != 0) {
-			age = get_age(rrl, e, now);
+			age = get_age(shard, e, now);
 			if (age < DNS_RRL_STOP_LOG_SECS ||
 			    response_balance(rrl, e, age) < 0)
 				break;
 		}
 
-		log_end(rrl, e, now == 0, log_buf, log_buf_len);
-		if (rrl->num_logged <= 0)
+		log_end(rrl, shard, e, now == 0, log_buf, log_buf_len);
+		if (shard->num_logged <= 0)
 			break;
 
 		/*
 		 * Too many messages could stall real work.
 		 */
 		if (--limit < 0) {
-			rrl->last_logged = ISC_LIST_PREV(e, lru);
+			shard->last_logged = ISC_LIST_PREV(e, lru);
 			return;
 		}
 	}
 	if (e == NULL) {
-		INSIST(rrl->num_logged == 0);
-		rrl->log_stops_time = now;
+		INSIST(shard->num_logged == 0);
+		shard->log_stops_time = now;
 	}
-	rrl->last_logged = e;
+	shard->last_logged = e;
+}
+
+/*
+ * Do a shard's maintenance once per second.
+ */
+static inline void
+shard_maintenance(dns_rrl_t *rrl, dns_rrl_shard_t *shard, isc_stdtime_t now,
+		  char *log_buf, unsigned int log_buf_len)
+{
+	if (shard->num_logged > 0 && shard->log_stops_time != now)
+		log_stops(rrl, shard, now, 8, log_buf, log_buf_len);
 }
 
 /*
@@ -1012,11 +1081,15 @@ dns_rrl(dns_view_t *view,
 {
 	dns_rrl_t *rrl;
 	dns_rrl_rtype_t rtype;
+	dns_rrl_key_t key, key_all;
+	isc_uint32_t hval, hval_all;
+	dns_rrl_shard_t *shard, *shard_all, *e_shard;
 	dns_rrl_entry_t *e;
 	isc_netaddr_t netclient;
 	int secs;
 	double qps, scale;
 	int exempt_match;
+	isc_boolean_t tcp_credit;
 	isc_result_t result;
 	dns_rrl_result_t rrl_result;
 
@@ -1031,8 +1104,6 @@ dns_rrl(dns_view_t *view,
 			return (DNS_RRL_RESULT_OK);
 	}
 
-	LOCK(&rrl->lock);
-
 	/*
 	 * Estimate total query per second rate when scaling by qps.
 	 */
@@ -1040,6 +1111,7 @@ dns_rrl(dns_view_t *view,
 		qps = 0.0;
 		scale = 1.0;
 	} else {
+		LOCK(&rrl->lock);
 		++rrl->qps_responses;
 		secs = delta_rrl_time(rrl->qps_time, now);
 		if (secs <= 0) {
@@ -1064,33 +1136,34 @@ dns_rrl(dns_view_t *view,
 				qps = rrl->qps;
 			}
 		}
+		UNLOCK(&rrl->lock);
 		scale = rrl->qps_scale / qps;
 	}
 
-	/*
-	 * Do maintenance once per second.
-	 */
-	if (rrl->num_logged > 0 && rrl->log_stops_time != now)
-		log_stops(rrl, now, 8, log_buf, log_buf_len);
-
 	/*
 	 * Notice TCP responses when scaling limits by qps.
 	 * Do not try to rate limit TCP responses.
 	 */
-	if (is_tcp) {
-		if (scale < 1.0) {
-			e = get_entry(rrl, client_addr,
-				      0, dns_rdatatype_none, NULL,
-				      DNS_RRL_RTYPE_TCP, now, ISC_TRUE,
-				      log_buf, log_buf_len);
-			if (e != NULL) {
+	tcp_credit = ISC_FALSE;
+	if (scale < 1.0) {
+		make_key(rrl, &key, client_addr, dns_rdatatype_none, NULL, 0,
+			 DNS_RRL_RTYPE_TCP);
+		hval = hash_key(&key);
+		shard = get_shard(rrl, hval);
+		LOCK(&shard->lock);
+		e = get_entry(rrl, shard, &key, hval, now, is_tcp,
+			      log_buf, log_buf_len);
+		if (e != NULL) {
+			if (is_tcp) {
 				e->responses = -(rrl->window+1);
-				set_age(rrl, e, now);
+				set_age(shard, e, now);
 			}
+			tcp_credit = ISC_TRUE;
 		}
-		UNLOCK(&rrl->lock);
-		return (ISC_R_SUCCESS);
+		UNLOCK(&shard->lock);
 	}
+	if (is_tcp)
+		return (ISC_R_SUCCESS);
 
 	/*
 	 * Find the right kind of entry, creating it if necessary.
@@ -1113,12 +1186,36 @@ dns_rrl(dns_view_t *view,
 		rtype = DNS_RRL_RTYPE_ERROR;
 		break;
 	}
-	e = get_entry(rrl, client_addr, qclass, qtype, qname, rtype,
-		      now, ISC_TRUE, log_buf, log_buf_len);
+	make_key(rrl, &key, client_addr, qtype, qname, qclass, rtype);
+	hval = hash_key(&key);
+	shard = get_shard(rrl, hval);
+
+	/*
+	 * The all-per-second entry for the client is usually in another
+	 * shard.  Both shards stay locked until the response is decided.
+	 */
+	shard_all = NULL;
+	hval_all = 0;
+	if (rrl->all_per_second.r != 0) {
+		make_key(rrl, &key_all, client_addr, dns_rdatatype_none, NULL,
+			 0, DNS_RRL_RTYPE_ALL);
+		hval_all = hash_key(&key_all);
+		shard_all = get_shard(rrl, hval_all);
+	}
+
+	lock_shards(shard, shard_all);
+
+	shard_maintenance(rrl, shard, now, log_buf, log_buf_len);
+	if (shard_all != NULL && shard_all != shard)
+		shard_maintenance(rrl, shard_all, now, log_buf, log_buf_len);
+
+	e = get_entry(rrl, shard, &key, hval, now, ISC_TRUE,
+		      log_buf, log_buf_len);
 	if (e == NULL) {
-		UNLOCK(&rrl->lock);
+		unlock_shards(shard, shard_all);
 		return (DNS_RRL_RESULT_OK);
 	}
+	e_shard = shard;
 
 	if (isc_log_wouldlog(dns_lctx, DNS_RRL_LOG_DEBUG1)) {
 		/*
@@ -1133,10 +1230,10 @@ dns_rrl(dns_view_t *view,
 			      "%s", log_buf);
 	}
 
-	rrl_result = debit_rrl_entry(rrl, e, qps, scale, client_addr, now,
-				     log_buf, log_buf_len);
+	rrl_result = debit_rrl_entry(rrl, shard, e, qps, scale, tcp_credit,
+				     now);
 
-	if (rrl->all_per_second.r != 0) {
+	if (shard_all != NULL) {
 		/*
 		 * We must debit the all-per-second token bucket if we have
 		 * an all-per-second limit for the IP address.
@@ -1148,21 +1245,19 @@ dns_rrl(dns_view_t *view,
 		dns_rrl_entry_t *e_all;
 		dns_rrl_result_t rrl_all_result;
 
-		e_all = get_entry(rrl, client_addr,
-				  0, dns_rdatatype_none, NULL,
-				  DNS_RRL_RTYPE_ALL, now, ISC_TRUE,
-				  log_buf, log_buf_len);
+		e_all = get_entry(rrl, shard_all, &key_all, hval_all, now,
+				  ISC_TRUE, log_buf, log_buf_len);
 		if (e_all == NULL) {
-			UNLOCK(&rrl->lock);
+			unlock_shards(shard, shard_all);
 			return (DNS_RRL_RESULT_OK);
 		}
-		rrl_all_result = debit_rrl_entry(rrl, e_all, qps, scale,
-						 client_addr, now,
-						 log_buf, log_buf_len);
+		rrl_all_result = debit_rrl_entry(rrl, shard_all, e_all, qps,
+						 scale, tcp_credit, now);
 		if (rrl_all_result != DNS_RRL_RESULT_OK) {
 			int level;
 
 			e = e_all;
+			e_shard = shard_all;
 			rrl_result = rrl_all_result;
 			if (rrl_result == DNS_RRL_RESULT_OK)
 				level = DNS_RRL_LOG_DEBUG2;
@@ -1182,7 +1277,7 @@ dns_rrl(dns_view_t *view,
 	}
 
 	if (rrl_result == DNS_RRL_RESULT_OK) {
-		UNLOCK(&rrl->lock);
+		unlock_shards(shard, shard_all);
 		return (DNS_RRL_RESULT_OK);
 	}
 
@@ -1198,8 +1293,8 @@ dns_rrl(dns_view_t *view,
 			     log_buf, log_buf_len);
 		if (!e->logged) {
 			e->logged = ISC_TRUE;
-			if (++rrl->num_logged <= 1)
-				rrl->last_logged = e;
+			if (++e_shard->num_logged <= 1)
+				e_shard->last_logged = e;
 		}
 		e->log_secs = 0;
 
@@ -1207,7 +1302,7 @@ dns_rrl(dns_view_t *view,
 		 * Avoid holding the lock.
 		 */
 		if (!wouldlog) {
-			UNLOCK(&rrl->lock);
+			unlock_shards(shard, shard_all);
 			e = NULL;
 		}
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_RRL,
@@ -1231,17 +1326,39 @@ dns_rrl(dns_view_t *view,
 		 */
 		if (!e->logged)
 			free_qname(rrl, e);
-		UNLOCK(&rrl->lock);
+		unlock_shards(shard, shard_all);
 	}
 
 	return (rrl_result);
 }
 
+static void
+free_shard(dns_rrl_t *rrl, dns_rrl_shard_t *shard) {
+	dns_rrl_block_t *b;
+	dns_rrl_hash_t *h;
+
+	while (!ISC_LIST_EMPTY(shard->blocks)) {
+		b = ISC_LIST_HEAD(shard->blocks);
+		ISC_LIST_UNLINK(shard->blocks, b, link);
+		isc_mem_put(rrl->mctx, b, b->size);
+	}
+
+	h = shard->hash;
+	if (h != NULL)
+		isc_mem_put(rrl->mctx, h,
+			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+
+	h = shard->old_hash;
+	if (h != NULL)
+		isc_mem_put(rrl->mctx, h,
+			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+
+	DESTROYLOCK(&shard->lock);
+}
+
 void
 dns_rrl_view_destroy(dns_view_t *view) {
 	dns_rrl_t *rrl;
-	dns_rrl_block_t *b;
-	dns_rrl_hash_t *h;
 	char log_buf[DNS_RRL_LOG_BUF_LEN];
 	int i;
 
@@ -1254,8 +1371,11 @@ dns_rrl_view_destroy(dns_view_t *view) {
 	 * Assume the caller takes care of locking the view and anything else.
 	 */
 
-	if (rrl->num_logged > 0)
-		log_stops(rrl, 0, ISC_INT32_MAX, log_buf, sizeof(log_buf));
+	for (i = 0; i < DNS_RRL_SHARDS; ++i) {
+		if (rrl->shards[i].num_logged > 0)
+			log_stops(rrl, &rrl->shards[i], 0, ISC_INT32_MAX,
+				  log_buf, sizeof(log_buf));
+	}
 
 	for (i = 0; i < DNS_RRL_QNAMES; ++i) {
 		if (rrl->qnames[i] == NULL)
@@ -1266,23 +1386,10 @@ dns_rrl_view_destroy(dns_view_t *view) {
 	if (rrl->exempt != NULL)
 		dns_acl_detach(&rrl->exempt);
 
-	DESTROYLOCK(&rrl->lock);
-
-	while (!ISC_LIST_EMPTY(rrl->blocks)) {
-		b = ISC_LIST_HEAD(rrl->blocks);
-		ISC_LIST_UNLINK(rrl->blocks, b, link);
-		isc_mem_put(rrl->mctx, b, b->size);
-	}
+	for (i = 0; i < DNS_RRL_SHARDS; ++i)
+		free_shard(rrl, &rrl->shards[i]);
 
-	h = rrl->hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
-
-	h = rrl->old_hash;
-	if (h != NULL)
-		isc_mem_put(rrl->mctx, h,
-			    sizeof(*h) + (h->length - 1) * sizeof(h->bins[0]));
+	DESTROYLOCK(&rrl->lock);
 
 	isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 }
@@ -1290,7 +1397,10 @@ dns_rrl_view_destroy(dns_view_t *view) {
 isc_result_t
 dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 	dns_rrl_t *rrl;
+	dns_rrl_shard_t *shard;
 	isc_result_t result;
+	isc_stdtime_t now;
+	int i;
 
 	*rrlp = NULL;
 
@@ -1304,19 +1414,34 @@ dns_rrl_init(dns_rrl_t **rrlp, dns_view_t *view, int min_entries) {
 		isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
 		return (result);
 	}
-	isc_stdtime_get(&rrl->ts_bases[0]);
+	for (i = 0; i < DNS_RRL_SHARDS; ++i) {
+		result = isc_mutex_init(&rrl->shards[i].lock);
+		if (result != ISC_R_SUCCESS) {
+			while (--i >= 0)
+				DESTROYLOCK(&rrl->shards[i].lock);
+			DESTROYLOCK(&rrl->lock);
+			isc_mem_putanddetach(&rrl->mctx, rrl, sizeof(*rrl));
+			return (result);
+		}
+	}
+	isc_stdtime_get(&now);
 
 	view->rrl = rrl;
 
-	result = expand_entries(rrl, min_entries);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
-	}
-	result = expand_rrl_hash(rrl, 0);
-	if (result != ISC_R_SUCCESS) {
-		dns_rrl_view_destroy(view);
-		return (result);
+	for (i = 0; i < DNS_RRL_SHARDS; ++i) {
+		shard = &rrl->shards[i];
+		shard->ts_bases[0] = now;
+		result = expand_entries(rrl, shard,
+					shard_entries(min_entries));
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
+		result = expand_rrl_hash(rrl, shard, 0);
+		if (result != ISC_R_SUCCESS) {
+			dns_rrl_view_destroy(view);
+			return (result);
+		}
 	}
 
 	*rrlp = rrl;
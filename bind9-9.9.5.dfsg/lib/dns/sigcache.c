@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/refcount.h>
+#include <isc/serial.h>
+#include <isc/string.h>
+#include <isc/util.h>
+
+#include <dns/sigcache.h>
+
+#define SIGCACHE_MAGIC			ISC_MAGIC('S', 'i', 'g', 'C')
+#define DNS_SIGCACHE_VALID(c)		ISC_MAGIC_VALID(c, SIGCACHE_MAGIC)
+
+/*%
+ * Number of independently locked parts of the cache.  Must be a power
+ * of two.
+ */
+#define NSTRIPES	16
+
+/*%
+ * Number of slots a given digest may be stored in.
+ */
+#define NWAYS		4
+
+typedef struct {
+	isc_boolean_t			used;
+	isc_stdtime_t			expire;
+	unsigned char			digest[DNS_SIGCACHE_DIGESTLENGTH];
+} sigentry_t;
+
+typedef struct {
+	sigentry_t			entries[NWAYS];
+	unsigned int			hand;	/*%< Next to replace */
+} sigslots_t;
+
+typedef struct {
+	isc_mutex_t			lock;
+	sigslots_t			*slots;
+} sigstripe_t;
+
+struct dns_sigcache {
+	unsigned int			magic;
+	isc_mem_t			*mctx;
+	isc_refcount_t			references;
+	unsigned int			nslots;	/*%< Per stripe */
+	sigstripe_t			stripes[NSTRIPES];
+};
+
+/*
+ * The digest is a cryptographic hash, so any of its bytes will do to
+ * pick a stripe and a set of slots.
+ */
+static inline unsigned int
+hash_digest(const unsigned char *digest) {
+	return (((unsigned int)digest[0] << 24) |
+		((unsigned int)digest[1] << 16) |
+		((unsigned int)digest[2] << 8) | digest[3]);
+}
+
+static inline sigstripe_t *
+stripe_of(dns_sigcache_t *cache, unsigned int hashval) {
+	return (&cache->stripes[hashval & (NSTRIPES - 1)]);
+}
+
+static inline sigslots_t *
+slots_of(dns_sigcache_t *cache, sigstripe_t *stripe, unsigned int hashval) {
+	return (&stripe->slots[(hashval / NSTRIPES) & (cache->nslots - 1)]);
+}
+
+isc_result_t
+dns_sigcache_create(isc_mem_t *mctx, unsigned int size,
+		    dns_sigcache_t **cachep)
+{
+	dns_sigcache_t *cache;
+	unsigned int nslots, i;
+	isc_result_t result;
+
+	REQUIRE(mctx != NULL);
+	REQUIRE(size != 0);
+	REQUIRE(cachep != NULL && *cachep == NULL);
+
+	cache = isc_mem_get(mctx, sizeof(*cache));
+	if (cache == NULL)
+		return (ISC_R_NOMEMORY);
+
+	nslots = 1;
+	while (nslots < (1U << 24) && nslots * NWAYS * NSTRIPES < size)
+		nslots <<= 1;
+	cache->nslots = nslots;
+
+	result = isc_refcount_init(&cache->references, 1);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, cache, sizeof(*cache));
+		return (result);
+	}
+
+	for (i = 0; i < NSTRIPES; i++) {
+		sigstripe_t *stripe = &cache->stripes[i];
+
+		stripe->slots = isc_mem_get(mctx, nslots * sizeof(sigslots_t));
+		if (stripe->slots == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+		result = isc_mutex_init(&stripe->lock);
+		if (result != ISC_R_SUCCESS) {
+			isc_mem_put(mctx, stripe->slots,
+				    nslots * sizeof(sigslots_t));
+			goto cleanup;
+		}
+		memset(stripe->slots, 0, nslots * sizeof(sigslots_t));
+	}
+
+	cache->mctx = NULL;
+	isc_mem_attach(mctx, &cache->mctx);
+	cache->magic = SIGCACHE_MAGIC;
+	*cachep = cache;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	while (i-- > 0) {
+		DESTROYLOCK(&cache->stripes[i].lock);
+		isc_mem_put(mctx, cache->stripes[i].slots,
+			    nslots * sizeof(sigslots_t));
+	}
+	isc_refcount_decrement(&cache->references, NULL);
+	isc_refcount_destroy(&cache->references);
+	isc_mem_put(mctx, cache, sizeof(*cache));
+	return (result);
+}
+
+void
+dns_sigcache_attach(dns_sigcache_t *source, dns_sigcache_t **targetp) {
+	REQUIRE(DNS_SIGCACHE_VALID(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references, NULL);
+	*targetp = source;
+}
+
+void
+dns_sigcache_detach(dns_sigcache_t **cachep) {
+	dns_sigcache_t *cache;
+	unsigned int refs, i;
+
+	REQUIRE(cachep != NULL && DNS_SIGCACHE_VALID(*cachep));
+
+	cache = *cachep;
+	*cachep = NULL;
+
+	isc_refcount_decrement(&cache->references, &refs);
+	if (refs != 0)
+		return;
+
+	for (i = 0; i < NSTRIPES; i++) {
+		DESTROYLOCK(&cache->stripes[i].lock);
+		isc_mem_put(cache->mctx, cache->stripes[i].slots,
+			    cache->nslots * sizeof(sigslots_t));
+	}
+	isc_refcount_destroy(&cache->references);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+isc_result_t
+dns_sigcache_find(dns_sigcache_t *cache, const unsigned char *digest) {
+	isc_result_t result = ISC_R_NOTFOUND;
+	unsigned int hashval, i;
+	sigstripe_t *stripe;
+	sigslots_t *slots;
+
+	REQUIRE(DNS_SIGCACHE_VALID(cache));
+	REQUIRE(digest != NULL);
+
+	hashval = hash_digest(digest);
+	stripe = stripe_of(cache, hashval);
+
+	LOCK(&stripe->lock);
+	slots = slots_of(cache, stripe, hashval);
+	for (i = 0; i < NWAYS; i++) {
+		sigentry_t *entry = &slots->entries[i];
+
+		if (entry->used &&
+		    memcmp(entry->digest, digest,
+			   DNS_SIGCACHE_DIGESTLENGTH) == 0) {
+			result = ISC_R_SUCCESS;
+			break;
+		}
+	}
+	UNLOCK(&stripe->lock);
+
+	return (result);
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *cache, const unsigned char *digest,
+		 isc_stdtime_t expire)
+{
+	sigentry_t *victim = NULL, *stale = NULL;
+	unsigned int hashval, i;
+	sigstripe_t *stripe;
+	sigslots_t *slots;
+	isc_stdtime_t now;
+
+	REQUIRE(DNS_SIGCACHE_VALID(cache));
+	REQUIRE(digest != NULL);
+
+	isc_stdtime_get(&now);
+	hashval = hash_digest(digest);
+	stripe = stripe_of(cache, hashval);
+
+	LOCK(&stripe->lock);
+	slots = slots_of(cache, stripe, hashval);
+	for (i = 0; i < NWAYS; i++) {
+		sigentry_t *entry = &slots->entries[i];
+
+		if (!entry->used) {
+			if (victim == NULL)
+				victim = entry;
+			continue;
+		}
+		if (memcmp(entry->digest, digest,
+			   DNS_SIGCACHE_DIGESTLENGTH) == 0) {
+			/* Another thread got here first. */
+			goto unlock;
+		}
+		if (stale == NULL &&
+		    isc_serial_lt(entry->expire, (isc_uint32_t)now))
+			stale = entry;
+	}
+	if (victim == NULL)
+		victim = stale;
+	if (victim == NULL) {
+		victim = &slots->entries[slots->hand];
+		slots->hand = (slots->hand + 1) % NWAYS;
+	}
+	memmove(victim->digest, digest, DNS_SIGCACHE_DIGESTLENGTH);
+	victim->expire = expire;
+	victim->used = ISC_TRUE;
+ unlock:
+	UNLOCK(&stripe->lock);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *cache) {
+	unsigned int i;
+
+	REQUIRE(DNS_SIGCACHE_VALID(cache));
+
+	for (i = 0; i < NSTRIPES; i++) {
+		sigstripe_t *stripe = &cache->stripes[i];
+
+		LOCK(&stripe->lock);
+		memset(stripe->slots, 0, cache->nslots * sizeof(sigslots_t));
+		UNLOCK(&stripe->lock);
+	}
+}
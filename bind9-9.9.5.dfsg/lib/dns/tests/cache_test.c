@@ -0,0 +1,412 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/cache.h>
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/result.h>
+
+#include "dnstest.h"
+
+#define SNAPSHOT "cache_test.snapshot"
+
+static isc_stdtime_t now;
+
+static dns_name_t *
+name(const char *text, dns_fixedname_t *fixed) {
+	isc_buffer_t b;
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	result = dns_name_fromtext(dns_fixedname_name(fixed), &b,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	return (dns_fixedname_name(fixed));
+}
+
+static dns_cache_t *
+newcache(void) {
+	dns_cache_t *cache = NULL;
+	isc_result_t result;
+
+	result = dns_cache_create(mctx, taskmgr, timermgr, dns_rdataclass_in,
+				  "rbt", 0, NULL, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_cache_setfilename(cache, SNAPSHOT);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_cache_setfileformat(cache, dns_masterformat_raw);
+	return (cache);
+}
+
+static void
+addrdataset(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	    dns_rdatatype_t covers, dns_trust_t trust, unsigned int attributes,
+	    unsigned char *data, unsigned int length)
+{
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	isc_result_t result;
+
+	rdata.data = data;
+	rdata.length = length;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = type;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = type;
+	rdatalist.covers = covers;
+	rdatalist.ttl = 600;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	rdataset.trust = trust;
+	rdataset.attributes |= attributes;
+
+	result = dns_db_findnode(db, name(owner, &fixed), ISC_TRUE, &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+findat(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+       unsigned int options, isc_stdtime_t when, dns_rdataset_t *rdataset)
+{
+	dns_fixedname_t fixed, found;
+
+	dns_fixedname_init(&found);
+	return (dns_db_find(db, name(owner, &fixed), NULL, type, options,
+			    when, NULL, dns_fixedname_name(&found), rdataset,
+			    NULL));
+}
+
+static isc_result_t
+find(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+     dns_rdataset_t *rdataset)
+{
+	return (findat(db, owner, type, 0, now, rdataset));
+}
+
+static void
+writesnapshot(unsigned char *image, size_t size) {
+	FILE *f;
+
+	f = fopen(SNAPSHOT, "wb");
+	ATF_REQUIRE(f != NULL);
+	ATF_REQUIRE_EQ(fwrite(image, 1, size, f), size);
+	fclose(f);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(snapshot);
+ATF_TC_HEAD(snapshot, tc) {
+	atf_tc_set_md_var(tc, "descr", "dump a cache as a binary snapshot "
+			  "and load it into another cache");
+}
+ATF_TC_BODY(snapshot, tc) {
+	dns_cache_t *cache;
+	dns_db_t *db = NULL;
+	dns_rdataset_t rdataset;
+	unsigned char addr[4] = { 10, 0, 0, 1 };
+	unsigned char ncache[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	cache = newcache();
+	dns_cache_attachdb(cache, &db);
+	addrdataset(db, "a.example.", dns_rdatatype_a, 0, dns_trust_secure,
+		    0, addr, sizeof(addr));
+	addrdataset(db, "b.example.", 0, dns_rdatatype_aaaa,
+		    dns_trust_authauthority, DNS_RDATASETATTR_NEGATIVE,
+		    ncache, sizeof(ncache));
+	addrdataset(db, "c.example.", 0, dns_rdatatype_any,
+		    dns_trust_authauthority,
+		    DNS_RDATASETATTR_NEGATIVE | DNS_RDATASETATTR_NXDOMAIN,
+		    ncache, sizeof(ncache));
+	dns_db_detach(&db);
+
+	result = dns_cache_dump(cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_cache_detach(&cache);
+
+	cache = newcache();
+	result = dns_cache_load(cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_cache_attachdb(cache, &db);
+
+	dns_rdataset_init(&rdataset);
+	result = find(db, "a.example.", dns_rdatatype_a, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(rdataset.trust, dns_trust_secure);
+	ATF_CHECK(rdataset.ttl <= 600 && rdataset.ttl > 590);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = find(db, "b.example.", dns_rdatatype_aaaa, &rdataset);
+	ATF_REQUIRE_EQ(result, DNS_R_NCACHENXRRSET);
+	ATF_CHECK_EQ(rdataset.trust, dns_trust_authauthority);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = find(db, "c.example.", dns_rdatatype_a, &rdataset);
+	ATF_REQUIRE_EQ(result, DNS_R_NCACHENXDOMAIN);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = find(db, "d.example.", dns_rdatatype_a, &rdataset);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+
+	(void)unlink(SNAPSHOT);
+	dns_test_end();
+}
+
+ATF_TC(badsnapshot);
+ATF_TC_HEAD(badsnapshot, tc) {
+	atf_tc_set_md_var(tc, "descr", "reject a truncated or foreign "
+			  "cache snapshot");
+}
+ATF_TC_BODY(badsnapshot, tc) {
+	dns_cache_t *cache;
+	dns_db_t *db = NULL;
+	unsigned char addr[4] = { 10, 0, 0, 1 };
+	unsigned char image[512];
+	size_t size;
+	FILE *f;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	cache = newcache();
+	dns_cache_attachdb(cache, &db);
+	addrdataset(db, "a.example.", dns_rdatatype_a, 0, dns_trust_answer,
+		    0, addr, sizeof(addr));
+	dns_db_detach(&db);
+	result = dns_cache_dump(cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	f = fopen(SNAPSHOT, "rb");
+	ATF_REQUIRE(f != NULL);
+	size = fread(image, 1, sizeof(image), f);
+	fclose(f);
+	/* The file header and one record's length. */
+	ATF_REQUIRE(size > 16 + 4);
+
+	/* Cut the last record short. */
+	writesnapshot(image, size - 1);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, ISC_R_UNEXPECTEDEND);
+
+	/* Cut inside the length of a record. */
+	writesnapshot(image, 16 + 2);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, ISC_R_UNEXPECTEDEND);
+
+	/* Cut inside the file header. */
+	writesnapshot(image, 8);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, ISC_R_UNEXPECTEDEND);
+
+	/* A record longer than any rdataset could be. */
+	image[16] = image[17] = image[18] = image[19] = 0xff;
+	writesnapshot(image, size);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	/* A master file is not a snapshot. */
+	f = fopen(SNAPSHOT, "w");
+	ATF_REQUIRE(f != NULL);
+	fprintf(f, "a.example. 600 IN A 10.0.0.1\n");
+	fclose(f);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, DNS_R_FORMERR);
+
+	dns_cache_setfileformat(cache, dns_masterformat_text);
+	result = dns_cache_load(cache);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	dns_cache_detach(&cache);
+	(void)unlink(SNAPSHOT);
+	dns_test_end();
+}
+
+ATF_TC(servestale);
+ATF_TC_HEAD(servestale, tc) {
+	atf_tc_set_md_var(tc, "descr", "expired rdatasets are only returned "
+			  "with DNS_DBFIND_STALEOK inside the stale window");
+}
+ATF_TC_BODY(servestale, tc) {
+	dns_cache_t *cache;
+	dns_db_t *db = NULL;
+	dns_rdataset_t rdataset;
+	unsigned char addr[4] = { 10, 0, 0, 1 };
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	cache = newcache();
+	dns_cache_setservestalettl(cache, 3600);
+	dns_cache_attachdb(cache, &db);
+	addrdataset(db, "a.example.", dns_rdatatype_a, 0, dns_trust_answer,
+		    0, addr, sizeof(addr));
+
+	dns_rdataset_init(&rdataset);
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 300, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_STALE) == 0);
+	ATF_CHECK_EQ(rdataset.ttl, 300);
+	dns_rdataset_disassociate(&rdataset);
+
+	/* Expired: only found if stale answers are acceptable. */
+	result = findat(db, "a.example.", dns_rdatatype_a, 0,
+			now + 1200, &rdataset);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 1200, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_STALE) != 0);
+	ATF_CHECK_EQ(rdataset.ttl, 0);
+	dns_rdataset_disassociate(&rdataset);
+
+	/* Past the stale window. */
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 600 + 3601, &rdataset);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* The window is capped at 4 weeks and does not wrap. */
+	dns_cache_setservestalettl(cache, 0xffffffffU);
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 600 + 28 * 24 * 3600 - 60, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdataset_disassociate(&rdataset);
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 600 + 28 * 24 * 3600 + 60, &rdataset);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* Disabled. */
+	dns_cache_setservestalettl(cache, 0);
+	result = findat(db, "a.example.", dns_rdatatype_a, DNS_DBFIND_STALEOK,
+			now + 1200, &rdataset);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(prefetch);
+ATF_TC_HEAD(prefetch, tc) {
+	atf_tc_set_md_var(tc, "descr", "the prefetch attribute is kept in "
+			  "the cache until it is cleared");
+}
+ATF_TC_BODY(prefetch, tc) {
+	dns_cache_t *cache;
+	dns_db_t *db = NULL;
+	dns_rdataset_t rdataset;
+	unsigned char addr[4] = { 10, 0, 0, 1 };
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	cache = newcache();
+	dns_cache_attachdb(cache, &db);
+	addrdataset(db, "a.example.", dns_rdatatype_a, 0, dns_trust_answer,
+		    DNS_RDATASETATTR_PREFETCH, addr, sizeof(addr));
+	addrdataset(db, "b.example.", dns_rdatatype_a, 0, dns_trust_answer,
+		    0, addr, sizeof(addr));
+
+	dns_rdataset_init(&rdataset);
+	result = find(db, "b.example.", dns_rdatatype_a, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_PREFETCH) == 0);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = find(db, "a.example.", dns_rdatatype_a, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_PREFETCH) != 0);
+	dns_rdataset_clearprefetch(&rdataset);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_PREFETCH) == 0);
+	dns_rdataset_disassociate(&rdataset);
+
+	result = find(db, "a.example.", dns_rdatatype_a, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK((rdataset.attributes & DNS_RDATASETATTR_PREFETCH) == 0);
+	dns_rdataset_disassociate(&rdataset);
+
+	dns_db_detach(&db);
+	dns_cache_detach(&cache);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, snapshot);
+	ATF_TP_ADD_TC(tp, badsnapshot);
+	ATF_TP_ADD_TC(tp, servestale);
+	ATF_TP_ADD_TC(tp, prefetch);
+
+	return (atf_no_error());
+}
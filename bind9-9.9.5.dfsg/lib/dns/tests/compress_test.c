@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+
+#include "dnstest.h"
+
+static void
+fromtext(dns_fixedname_t *fixed, const char *text) {
+	isc_buffer_t b;
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	isc_buffer_constinit(&b, text, strlen(text));
+	isc_buffer_add(&b, strlen(text));
+	result = dns_name_fromtext(dns_fixedname_name(fixed), &b,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Decompress 'count' names from 'source' and compare them with 'names'.
+ */
+static void
+check(isc_buffer_t *source, dns_fixedname_t *names, unsigned int count,
+      isc_boolean_t sensitive)
+{
+	dns_decompress_t dctx;
+	dns_fixedname_t fixed;
+	isc_buffer_t target;
+	unsigned char buf[DNS_NAME_MAXWIRE];
+	unsigned int i;
+	isc_result_t result;
+
+	isc_buffer_setactive(source, isc_buffer_usedlength(source));
+	dns_decompress_init(&dctx, -1, DNS_DECOMPRESS_STRICT);
+	dns_decompress_setmethods(&dctx, DNS_COMPRESS_GLOBAL14);
+	for (i = 0; i < count; i++) {
+		dns_fixedname_init(&fixed);
+		isc_buffer_init(&target, buf, sizeof(buf));
+		result = dns_name_fromwire(dns_fixedname_name(&fixed), source,
+					   &dctx, ISC_FALSE, &target);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		if (sensitive)
+			ATF_CHECK(dns_name_caseequal(
+					dns_fixedname_name(&fixed),
+					dns_fixedname_name(&names[i])));
+		else
+			ATF_CHECK(dns_name_equal(dns_fixedname_name(&fixed),
+					dns_fixedname_name(&names[i])));
+	}
+	ATF_CHECK_EQ(isc_buffer_remaininglength(source), 0);
+	dns_decompress_invalidate(&dctx);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(suffix);
+ATF_TC_HEAD(suffix, tc) {
+	atf_tc_set_md_var(tc, "descr", "the longest matching suffix is used");
+}
+ATF_TC_BODY(suffix, tc) {
+	static const char *text[] = {
+		"www.example.com.", "mail.example.com.",
+		"www.example.com.", "a.b.mail.example.com.",
+		"example.com.", "com.", "example.net.", "WWW.Example.COM."
+	};
+	static const unsigned int length[] = { 17, 7, 2, 6, 2, 2, 13, 2 };
+	dns_fixedname_t names[8];
+	dns_compress_t cctx;
+	isc_buffer_t source;
+	unsigned char buf[512];
+	unsigned int i, used;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf, sizeof(buf));
+
+	for (i = 0; i < 8; i++) {
+		fromtext(&names[i], text[i]);
+		used = isc_buffer_usedlength(&source);
+		result = dns_name_towire(dns_fixedname_name(&names[i]),
+					 &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(isc_buffer_usedlength(&source) - used, length[i]);
+	}
+	dns_compress_invalidate(&cctx);
+
+	check(&source, names, 8, ISC_FALSE);
+	dns_test_end();
+}
+
+ATF_TC(sensitive);
+ATF_TC_HEAD(sensitive, tc) {
+	atf_tc_set_md_var(tc, "descr", "case sensitive compression only "
+			  "matches suffixes with the same case");
+}
+ATF_TC_BODY(sensitive, tc) {
+	dns_fixedname_t names[3];
+	dns_compress_t cctx;
+	isc_buffer_t source;
+	unsigned char buf[512];
+	unsigned int used;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	dns_compress_setsensitive(&cctx, ISC_TRUE);
+	isc_buffer_init(&source, buf, sizeof(buf));
+
+	fromtext(&names[0], "www.example.com.");
+	fromtext(&names[1], "www.EXAMPLE.com.");
+	fromtext(&names[2], "ftp.EXAMPLE.com.");
+
+	result = dns_name_towire(dns_fixedname_name(&names[0]), &cctx,
+				 &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Only "com" matches. */
+	used = isc_buffer_usedlength(&source);
+	result = dns_name_towire(dns_fixedname_name(&names[1]), &cctx,
+				 &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&source) - used, 14);
+
+	/* "EXAMPLE.com" was added with the previous name. */
+	used = isc_buffer_usedlength(&source);
+	result = dns_name_towire(dns_fixedname_name(&names[2]), &cctx,
+				 &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&source) - used, 6);
+
+	dns_compress_invalidate(&cctx);
+
+	check(&source, names, 3, ISC_TRUE);
+	dns_test_end();
+}
+
+ATF_TC(rollback);
+ATF_TC_HEAD(rollback, tc) {
+	atf_tc_set_md_var(tc, "descr", "names rolled back are no longer "
+			  "used for compression");
+}
+ATF_TC_BODY(rollback, tc) {
+	dns_fixedname_t names[1000];
+	dns_compress_t cctx;
+	isc_buffer_t source;
+	unsigned char buf[65535], copy[65535];
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int i, mark, used;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 1000; i++) {
+		snprintf(text, sizeof(text), "host%u.zone%u.example.%s.",
+			 i, i % 17, (i % 2) == 0 ? "com" : "net");
+		fromtext(&names[i], text);
+	}
+
+	result = dns_compress_init(&cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_setmethods(&cctx, DNS_COMPRESS_GLOBAL14);
+	isc_buffer_init(&source, buf, sizeof(buf));
+
+	/*
+	 * Render the first half, then render and roll back the second
+	 * half, which grows the table well past its initial size.
+	 */
+	for (i = 0; i < 500; i++) {
+		result = dns_name_towire(dns_fixedname_name(&names[i]),
+					 &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	mark = isc_buffer_usedlength(&source);
+	for (i = 500; i < 1000; i++) {
+		result = dns_name_towire(dns_fixedname_name(&names[i]),
+					 &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	used = isc_buffer_usedlength(&source);
+	memmove(copy, buf + mark, used - mark);
+	dns_compress_rollback(&cctx, (isc_uint16_t)mark);
+	isc_buffer_subtract(&source, used - mark);
+
+	/*
+	 * The rolled back names are rendered exactly as before; "host500"
+	 * no longer matches but "zone7.example.com" does.
+	 */
+	result = dns_name_towire(dns_fixedname_name(&names[500]), &cctx,
+				 &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&source) - mark, 10);
+	for (i = 501; i < 1000; i++) {
+		result = dns_name_towire(dns_fixedname_name(&names[i]),
+					 &cctx, &source);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&source), used);
+	ATF_CHECK(memcmp(copy, buf + mark, used - mark) == 0);
+	dns_compress_invalidate(&cctx);
+
+	check(&source, names, 1000, ISC_FALSE);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, suffix);
+	ATF_TP_ADD_TC(tp, sensitive);
+	ATF_TP_ADD_TC(tp, rollback);
+
+	return (atf_no_error());
+}
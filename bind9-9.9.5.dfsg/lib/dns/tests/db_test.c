@@ -25,10 +25,17 @@
 #include <unistd.h>
 #include <stdlib.h>
 
+#include <isc/thread.h>
+#include <isc/util.h>
+
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
 #include <dns/journal.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
 
 #include "dnstest.h"
 
@@ -40,6 +47,124 @@
 #define	BIGBUFLEN	(64 * 1024)
 #define TEST_ORIGIN	"test"
 
+#define NTHREADS	4
+#define NNAMES		16
+#define NROUNDS		200
+
+static dns_db_t *tdb;
+static isc_boolean_t tdone;
+static int tfailures;
+
+static void
+makename(dns_name_t *name, unsigned int i) {
+	char buf[BUFLEN];
+	isc_result_t result;
+
+	snprintf(buf, sizeof(buf), "n%u.test.", i);
+	result = dns_name_fromstring(name, buf, 0, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+}
+
+/*
+ * Add an A record to name 'i' in a new version, or delete it again.
+ */
+static isc_result_t
+update(unsigned int i, isc_boolean_t add) {
+	unsigned char addr[4] = { 10, 0, 0, 1 };
+	dns_fixedname_t fname;
+	dns_dbversion_t *version = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r;
+	isc_result_t result;
+
+	dns_fixedname_init(&fname);
+	makename(dns_fixedname_name(&fname), i);
+
+	result = dns_db_newversion(tdb, &version);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = dns_db_findnode(tdb, dns_fixedname_name(&fname), ISC_TRUE,
+				 &node);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	if (add) {
+		addr[3] = i;
+		r.base = addr;
+		r.length = sizeof(addr);
+		dns_rdata_fromregion(&rdata, dns_rdataclass_in,
+				     dns_rdatatype_a, &r);
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.rdclass = dns_rdataclass_in;
+		rdatalist.type = dns_rdatatype_a;
+		rdatalist.ttl = 300;
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+		dns_rdataset_init(&rdataset);
+		result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+		if (result == ISC_R_SUCCESS)
+			result = dns_db_addrdataset(tdb, node, version, 0,
+						    &rdataset, 0, NULL);
+	} else
+		result = dns_db_deleterdataset(tdb, node, version,
+					       dns_rdatatype_a, 0);
+	dns_db_detachnode(tdb, &node);
+
+ cleanup:
+	dns_db_closeversion(tdb, &version, ISC_TF(result == ISC_R_SUCCESS));
+	return (result);
+}
+
+/*
+ * Look up every name over and over.  Even names are never changed while
+ * the threads run; odd ones come and go.
+ */
+static isc_threadresult_t
+find_thread(isc_threadarg_t arg) {
+	dns_fixedname_t fname, ffound;
+	dns_dbnode_t *node;
+	dns_rdataset_t rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(arg);
+
+	dns_fixedname_init(&fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+	do {
+		for (i = 0; i < NNAMES; i++) {
+			makename(dns_fixedname_name(&fname), i);
+			node = NULL;
+			result = dns_db_find(tdb, dns_fixedname_name(&fname),
+					     NULL, dns_rdatatype_a, 0, 0,
+					     &node,
+					     dns_fixedname_name(&ffound),
+					     &rdataset, NULL);
+			if (result == ISC_R_SUCCESS) {
+				RUNTIME_CHECK(dns_rdataset_first(&rdataset) ==
+					      ISC_R_SUCCESS);
+				dns_rdataset_current(&rdataset, &rdata);
+				if (rdata.length != 4 || rdata.data[3] != i)
+					tfailures++;
+				dns_rdata_reset(&rdata);
+				dns_rdataset_disassociate(&rdataset);
+			} else if ((i % 2) == 0 ||
+				   (result != DNS_R_NXDOMAIN &&
+				    result != DNS_R_NXRRSET &&
+				    result != DNS_R_EMPTYNAME))
+				tfailures++;
+			if (node != NULL)
+				dns_db_detachnode(tdb, &node);
+		}
+	} while (!tdone);
+
+	return ((isc_threadresult_t)0);
+}
+
 /*
  * Individual unit tests
  */
@@ -77,10 +202,75 @@ ATF_TC_BODY(getoriginnode, tc) {
 	isc_mem_detach(&mctx);
 }
 
+/* Look names up in several threads while the zone is being updated */
+ATF_TC(find_threads);
+ATF_TC_HEAD(find_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_db_find while adding and "
+				       "deleting records in other versions");
+}
+ATF_TC_BODY(find_threads, tc) {
+	dns_fixedname_t fname;
+	isc_result_t result;
+	unsigned int i;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+#endif
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fname);
+	result = dns_name_fromstring(dns_fixedname_name(&fname),
+				     TEST_ORIGIN, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	tdb = NULL;
+	result = dns_db_create(mctx, "rbt", dns_fixedname_name(&fname),
+			       dns_dbtype_zone, dns_rdataclass_in,
+			       0, NULL, &tdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NNAMES; i += 2) {
+		result = update(i, ISC_TRUE);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	tdone = ISC_FALSE;
+	tfailures = 0;
+#ifdef ISC_PLATFORM_USETHREADS
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(find_thread, NULL, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+#endif
+	for (i = 0; i < NROUNDS; i++) {
+		result = update(1 + 2 * (i % (NNAMES / 2)),
+				ISC_TF((i / (NNAMES / 2)) % 2 == 0));
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+#ifdef ISC_PLATFORM_USETHREADS
+		isc_thread_yield();
+#endif
+	}
+	tdone = ISC_TRUE;
+#ifdef ISC_PLATFORM_USETHREADS
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+#else
+	(void)find_thread(NULL);
+#endif
+	ATF_CHECK_EQ(tfailures, 0);
+
+	dns_db_detach(&tdb);
+	dns_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, getoriginnode);
+	ATF_TP_ADD_TC(tp, find_threads);
 	return (atf_no_error());
 }
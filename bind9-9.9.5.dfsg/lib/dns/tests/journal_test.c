@@ -0,0 +1,569 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/file.h>
+#include <isc/stdio.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/diff.h>
+#include <dns/fixedname.h>
+#include <dns/journal.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/soa.h>
+#include <dns/zone.h>
+
+#include "dnstest.h"
+
+#define JOURNAL		"journal_test.jnl"
+#define TRUNCATED	"journal_test.trunc.jnl"
+#define MASTER		"journal_test.db"
+#define NTRANSACTIONS	300
+
+static dns_fixedname_t fixedorigin;
+static dns_name_t *origin;
+
+static void
+setup(void) {
+	isc_result_t result;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_fixedname_init(&fixedorigin);
+	origin = dns_fixedname_name(&fixedorigin);
+	result = dns_name_fromstring(origin, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(TRUNCATED);
+	(void)isc_file_remove(MASTER);
+}
+
+static void
+teardown(void) {
+	(void)isc_file_remove(JOURNAL);
+	(void)isc_file_remove(TRUNCATED);
+	(void)isc_file_remove(MASTER);
+	dns_test_end();
+}
+
+/*
+ * Append a tuple for 'name' with the wire format rdata 'data' to 'diff'.
+ */
+static void
+add_tuple(dns_diff_t *diff, dns_diffop_t op, dns_name_t *name,
+	  dns_rdatatype_t type, unsigned char *data, unsigned int length)
+{
+	dns_difftuple_t *tuple = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r;
+	isc_result_t result;
+
+	r.base = data;
+	r.length = length;
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, type, &r);
+	result = dns_difftuple_create(mctx, op, name, 300, &rdata, &tuple);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_append(diff, &tuple);
+}
+
+static void
+add_soa(dns_diff_t *diff, dns_diffop_t op, isc_uint32_t serial,
+	unsigned char *soa)
+{
+	/* Root MNAME and RNAME, then the five counters. */
+	memset(soa, 0, 22);
+	soa[2] = (serial >> 24) & 0xff;
+	soa[3] = (serial >> 16) & 0xff;
+	soa[4] = (serial >> 8) & 0xff;
+	soa[5] = serial & 0xff;
+	add_tuple(diff, op, origin, dns_rdatatype_soa, soa, 22);
+}
+
+/*
+ * Fill 'diff' with the transaction from serial 'serial' to 'serial' + 1,
+ * which adds the name h<serial>.example.
+ */
+static void
+make_transaction(dns_diff_t *diff, isc_uint32_t serial) {
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	unsigned char soa0[22], soa1[22], a[4];
+	char text[64];
+	isc_result_t result;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_diff_init(mctx, diff);
+	add_soa(diff, DNS_DIFFOP_DEL, serial, soa0);
+	add_soa(diff, DNS_DIFFOP_ADD, serial + 1, soa1);
+	snprintf(text, sizeof(text), "h%u.example.", serial);
+	result = dns_name_fromstring(name, text, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	a[0] = 10;
+	a[1] = 0;
+	a[2] = (serial >> 8) & 0xff;
+	a[3] = serial & 0xff;
+	add_tuple(diff, DNS_DIFFOP_ADD, name, dns_rdatatype_a, a, 4);
+}
+
+/*
+ * Write the transactions from serial 'first' to serial 'last' + 1 to
+ * 'j', adding the name h<serial>.example each time.
+ */
+static void
+write_transactions(dns_journal_t *j, isc_uint32_t first, isc_uint32_t last) {
+	dns_diff_t diff;
+	isc_uint32_t serial;
+	isc_result_t result;
+
+	for (serial = first; serial <= last; serial++) {
+		make_transaction(&diff, serial);
+		result = dns_journal_write_transaction(j, &diff);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_diff_clear(&diff);
+	}
+}
+
+/*
+ * Apply the transaction from serial 'serial' to the current version of
+ * 'db' and commit it.
+ */
+static void
+apply_transaction(dns_db_t *db, isc_uint32_t serial) {
+	dns_dbversion_t *version = NULL;
+	dns_diff_t diff;
+	isc_result_t result;
+
+	make_transaction(&diff, serial);
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	dns_diff_clear(&diff);
+}
+
+/*
+ * Write NTRANSACTIONS transactions, taking the zone from serial 1 to
+ * NTRANSACTIONS + 1.
+ */
+static void
+write_journal(void) {
+	dns_journal_t *j = NULL;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, 1, NTRANSACTIONS);
+	dns_journal_destroy(&j);
+}
+
+static isc_uint32_t
+last_serial(void) {
+	dns_journal_t *j = NULL;
+	isc_uint32_t serial;
+	isc_result_t result;
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	serial = dns_journal_last_serial(j);
+	dns_journal_destroy(&j);
+	return (serial);
+}
+
+/*
+ * Iterate from 'begin' to the end of the journal 'filename', checking
+ * the SOA serials along the way.  Return the number of RRs seen.
+ */
+static isc_result_t
+iterate(const char *filename, isc_uint32_t begin, unsigned int *count) {
+	dns_journal_t *j = NULL;
+	isc_uint32_t end, serial;
+	isc_result_t result;
+	unsigned int n_soa = 0;
+
+	*count = 0;
+	result = dns_journal_open(mctx, filename, DNS_JOURNAL_READ, &j);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	end = dns_journal_last_serial(j);
+	serial = begin;
+	result = dns_journal_iter_init(j, begin, end);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
+	for (result = dns_journal_first_rr(j);
+	     result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(j))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		isc_uint32_t ttl;
+
+		dns_journal_current_rr(j, &name, &ttl, &rdata);
+		if (rdata->type == dns_rdatatype_soa) {
+			/* Deleted SOAs carry the old serial, added the new. */
+			if ((n_soa++ % 2) == 0)
+				ATF_CHECK_EQ(dns_soa_getserial(rdata), serial);
+			else
+				ATF_CHECK_EQ(dns_soa_getserial(rdata),
+					     ++serial);
+		}
+		(*count)++;
+	}
+	if (result == ISC_R_NOMORE) {
+		ATF_CHECK_EQ(serial, end);
+		result = ISC_R_SUCCESS;
+	}
+
+ cleanup:
+	dns_journal_destroy(&j);
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(iterate);
+ATF_TC_HEAD(iterate, tc) {
+	atf_tc_set_md_var(tc, "descr", "find transactions and read RRs "
+				       "from them");
+}
+ATF_TC_BODY(iterate, tc) {
+	dns_journal_t *j = NULL;
+	isc_uint32_t begins[] = { 1, 2, 57, 150, 299, 300, 301 };
+	unsigned int i, count;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	write_journal();
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_READ, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_journal_first_serial(j), 1);
+	ATF_CHECK_EQ(dns_journal_last_serial(j), NTRANSACTIONS + 1);
+	dns_journal_destroy(&j);
+
+	for (i = 0; i < sizeof(begins) / sizeof(begins[0]); i++) {
+		result = iterate(JOURNAL, begins[i], &count);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK_EQ(count, 3 * (NTRANSACTIONS + 1 - begins[i]));
+	}
+
+	result = iterate(JOURNAL, NTRANSACTIONS + 2, &count);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	teardown();
+}
+
+ATF_TC(truncated);
+ATF_TC_HEAD(truncated, tc) {
+	atf_tc_set_md_var(tc, "descr", "a journal shorter than its header "
+				       "claims is not read past its end");
+}
+ATF_TC_BODY(truncated, tc) {
+	FILE *in = NULL, *out = NULL;
+	off_t size;
+	size_t length;
+	unsigned char *buf;
+	unsigned int count;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	write_journal();
+
+	/*
+	 * Copy the first half of the journal, header included.
+	 */
+	result = isc_stdio_open(JOURNAL, "rb", &in);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_seek(in, 0, SEEK_END);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_tell(in, &size);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	length = (size_t)size / 2;
+	buf = isc_mem_get(mctx, length);
+	ATF_REQUIRE(buf != NULL);
+	result = isc_stdio_seek(in, 0, SEEK_SET);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_read(buf, 1, length, in, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_stdio_close(in);
+	result = isc_stdio_open(TRUNCATED, "wb", &out);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_stdio_write(buf, 1, length, out, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(void)isc_stdio_close(out);
+	isc_mem_put(mctx, buf, length);
+
+	/*
+	 * Transactions in the missing half cannot be found or read.
+	 */
+	result = iterate(TRUNCATED, 1, &count);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	result = iterate(TRUNCATED, NTRANSACTIONS - 10, &count);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+
+	teardown();
+}
+
+ATF_TC(rollforward);
+ATF_TC_HEAD(rollforward, tc) {
+	atf_tc_set_md_var(tc, "descr", "apply a journal to a database");
+}
+ATF_TC_BODY(rollforward, tc) {
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_diff_t diff;
+	unsigned char soa[22];
+	isc_uint32_t serial;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	write_journal();
+
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Start from serial 101, so that the first 100 transactions
+	 * are skipped.
+	 */
+	dns_diff_init(mctx, &diff);
+	add_soa(&diff, DNS_DIFFOP_ADD, 101, soa);
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	dns_diff_clear(&diff);
+
+	result = dns_journal_rollforward(mctx, db, 0, JOURNAL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_getsoaserial(db, NULL, &serial);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(serial, NTRANSACTIONS + 1);
+
+	dns_fixedname_init(&fixed);
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "h300.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed),
+				 ISC_FALSE, &node);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	if (node != NULL)
+		dns_db_detachnode(db, &node);
+
+	result = dns_name_fromstring(dns_fixedname_name(&fixed),
+				     "h100.example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed),
+				 ISC_FALSE, &node);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+	teardown();
+}
+
+ATF_TC(group);
+ATF_TC_HEAD(group, tc) {
+	atf_tc_set_md_var(tc, "descr", "group committed transactions appear "
+				       "when the journal is synced");
+}
+ATF_TC_BODY(group, tc) {
+	dns_journal_t *j = NULL;
+	unsigned int count;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+	write_journal();
+
+	result = dns_journal_open(mctx, JOURNAL,
+				  DNS_JOURNAL_WRITE | DNS_JOURNAL_GROUP, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, NTRANSACTIONS + 1, NTRANSACTIONS + 10);
+	ATF_CHECK_EQ(last_serial(), NTRANSACTIONS + 1);
+
+	result = dns_journal_sync(j);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(last_serial(), NTRANSACTIONS + 11);
+	result = iterate(JOURNAL, 1, &count);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 3 * (NTRANSACTIONS + 10));
+
+	/*
+	 * Transactions that were never synced are lost, and the next
+	 * writer carries on from the last synced one.
+	 */
+	write_transactions(j, NTRANSACTIONS + 11, NTRANSACTIONS + 12);
+	dns_journal_destroy(&j);
+	ATF_CHECK_EQ(last_serial(), NTRANSACTIONS + 11);
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_WRITE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, NTRANSACTIONS + 11, NTRANSACTIONS + 11);
+	dns_journal_destroy(&j);
+	ATF_CHECK_EQ(last_serial(), NTRANSACTIONS + 12);
+	result = iterate(JOURNAL, 1, &count);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(count, 3 * (NTRANSACTIONS + 11));
+
+	teardown();
+}
+
+ATF_TC(reset);
+ATF_TC_HEAD(reset, tc) {
+	atf_tc_set_md_var(tc, "descr", "a zone that is ahead of its journal "
+				       "after a failed sync can be journaled "
+				       "again once it is reset");
+}
+ATF_TC_BODY(reset, tc) {
+	dns_journal_t *j = NULL;
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_diff_t diff;
+	unsigned char soa[22], ns[1];
+	isc_uint32_t serial;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup();
+
+	/*
+	 * A zone at serial 2 with a journal from serial 1.
+	 */
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, 1, 1);
+	dns_journal_destroy(&j);
+
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_init(mctx, &diff);
+	add_soa(&diff, DNS_DIFFOP_ADD, 2, soa);
+	ns[0] = 0;
+	add_tuple(&diff, DNS_DIFFOP_ADD, origin, dns_rdatatype_ns, ns, 1);
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	dns_diff_clear(&diff);
+
+	result = dns_zone_create(&zone, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setorigin(zone, origin);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_zone_settype(zone, dns_zone_master);
+	result = dns_zone_setfile(zone, MASTER);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setjournal(zone, JOURNAL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_replacedb(zone, db, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * A group commit of serials 3 and 4 that was applied to the zone
+	 * but whose sync failed.
+	 */
+	result = dns_journal_open(mctx, JOURNAL,
+				  DNS_JOURNAL_WRITE | DNS_JOURNAL_GROUP, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, 2, 3);
+	apply_transaction(db, 2);
+	apply_transaction(db, 3);
+	dns_journal_destroy(&j);
+	ATF_CHECK_EQ(last_serial(), 2);
+
+	/*
+	 * The next update cannot be journaled...
+	 */
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_WRITE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	make_transaction(&diff, 4);
+	result = dns_journal_write_transaction(j, &diff);
+	ATF_CHECK(result != ISC_R_SUCCESS);
+	dns_diff_clear(&diff);
+	dns_journal_destroy(&j);
+
+	/*
+	 * ...until the zone is written out and the journal removed.
+	 */
+	result = dns_zone_resetjournal(zone);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(!isc_file_exists(JOURNAL));
+	dns_db_detach(&db);
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "example.", MASTER);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_getsoaserial(db, NULL, &serial);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(serial, 4);
+	dns_db_detach(&db);
+
+	result = dns_journal_open(mctx, JOURNAL, DNS_JOURNAL_CREATE, &j);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	write_transactions(j, 4, 4);
+	dns_journal_destroy(&j);
+	ATF_CHECK_EQ(last_serial(), 5);
+
+	dns_zone_detach(&zone);
+	teardown();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, iterate);
+	ATF_TP_ADD_TC(tp, truncated);
+	ATF_TP_ADD_TC(tp, rollforward);
+	ATF_TP_ADD_TC(tp, group);
+	ATF_TP_ADD_TC(tp, reset);
+
+	return (atf_no_error());
+}
@@ -25,10 +25,13 @@
 #include <unistd.h>
 
 #include <isc/print.h>
+#include <isc/task.h>
+#include <isc/taskpool.h>
 
 #include <dns/cache.h>
 #include <dns/callbacks.h>
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/master.h>
 #include <dns/masterdump.h>
 #include <dns/name.h>
@@ -564,6 +567,232 @@ ATF_TC_BODY(dumpraw, tc) {
 	dns_test_end();
 }
 
+/* Dump and reload a map format file */
+ATF_TC(dumpmap);
+ATF_TC_HEAD(dumpmap, tc) {
+	atf_tc_set_md_var(tc, "descr", "a map file written by "
+				       "dns_master_dump2() loads into a zone "
+				       "database with the same contents");
+}
+ATF_TC_BODY(dumpmap, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *mapdb = NULL, *cachedb = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_fixedname_t fixed, found;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dns_dbnode_t *node = NULL;
+	FILE *f1, *f2;
+	int c1, c2;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "testdata/master/master1.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &version);
+	result = dns_master_dump2(mctx, db, version,
+				  &dns_master_style_default, "test.map",
+				  dns_masterformat_map);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db),
+			       dns_dbtype_zone, dns_rdataclass_in,
+			       0, NULL, &mapdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load2(mapdb, "test.map", dns_masterformat_map);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* Look up a name in the mapped tree. */
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(name, "b.test.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_fixedname_init(&found);
+	dns_rdataset_init(&rdataset);
+	result = dns_db_find(mapdb, name, NULL, dns_rdatatype_a, 0, 0,
+			     &node, dns_fixedname_name(&found),
+			     &rdataset, NULL);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(rdataset.ttl, 1000);
+	ATF_CHECK_EQ(dns_rdataset_count(&rdataset), 1);
+	if (dns_rdataset_isassociated(&rdataset))
+		dns_rdataset_disassociate(&rdataset);
+	if (node != NULL)
+		dns_db_detachnode(mapdb, &node);
+
+	/* Both databases dump to the same text. */
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_default,
+				 "test.dump");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_master_dump(mctx, mapdb, NULL, &dns_master_style_default,
+				 "test.dump2");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	f1 = fopen("test.dump", "r");
+	f2 = fopen("test.dump2", "r");
+	ATF_REQUIRE(f1 != NULL && f2 != NULL);
+	do {
+		c1 = fgetc(f1);
+		c2 = fgetc(f2);
+	} while (c1 == c2 && c1 != EOF);
+	ATF_CHECK_EQ(c1, c2);
+	fclose(f1);
+	fclose(f2);
+
+	/* A cache cannot be loaded from a map file. */
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db),
+			       dns_dbtype_cache, dns_rdataclass_in,
+			       0, NULL, &cachedb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_load2(cachedb, "test.map", dns_masterformat_map);
+	ATF_CHECK_EQ(result, ISC_R_NOTIMPLEMENTED);
+
+	unlink("test.map");
+	unlink("test.dump");
+	unlink("test.dump2");
+	dns_db_detach(&cachedb);
+	dns_db_detach(&mapdb);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+/*
+ * Text files big enough to be split load the same when parsed in
+ * chunks on several tasks as when parsed serially.
+ */
+static isc_boolean_t split_done;
+static isc_result_t split_result;
+
+static void
+loadsplit_done(void *arg, isc_result_t result) {
+	UNUSED(arg);
+	split_result = result;
+	split_done = ISC_TRUE;
+}
+
+static isc_result_t
+loadsplit_write(const char *filename) {
+	FILE *f;
+	int i;
+
+	f = fopen(filename, "w");
+	if (f == NULL)
+		return (ISC_R_FAILURE);
+	fprintf(f, "$TTL 1000\n"
+		   "@ SOA ns hostmaster ( 1 3600 600 ; comment (\n"
+		   "\t86400 300 )\n"
+		   "@ NS ns\n"
+		   "ns A 10.0.0.1\n");
+	for (i = 0; i < 80000; i++) {
+		if (i % 20000 == 10)
+			fprintf(f, "$ORIGIN sub%d.test.\n", i);
+		if (i % 30000 == 20)
+			fprintf(f, "$TTL %d ; new default\n", i);
+		switch (i % 4) {
+		case 0:
+			fprintf(f, "t%d TXT ( \"a;b(c\" \"d\\\"e)\"\n"
+				   "\t\"f\" ) ; )\n", i);
+			break;
+		case 1:
+			fprintf(f, "m%d 60 MX 10 (\n"
+				   "; a comment (\n"
+				   "\tmx%d )\n", i, i);
+			break;
+		default:
+			fprintf(f, "h%d A 10.1.%d.%d\n\tAAAA ::%x\n",
+				i, (i >> 8) & 0xff, i & 0xff, i & 0xffff);
+			break;
+		}
+	}
+	fclose(f);
+	return (ISC_R_SUCCESS);
+}
+
+ATF_TC(loadsplit);
+ATF_TC_HEAD(loadsplit, tc) {
+	atf_tc_set_md_var(tc, "descr", "a large text file loaded in "
+				       "chunks on a task pool gives the "
+				       "same database as a serial load");
+}
+ATF_TC_BODY(loadsplit, tc) {
+	isc_result_t result;
+	dns_db_t *db = NULL, *splitdb = NULL;
+	dns_rdatacallbacks_t callbacks;
+	dns_loadctx_t *loadctx = NULL;
+	isc_taskpool_t *pool = NULL;
+	FILE *f1, *f2;
+	int c1, c2, i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = loadsplit_write("test.split");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, TEST_ORIGIN,
+				 "test.split");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_db_origin(db),
+			       dns_dbtype_zone, dns_rdataclass_in,
+			       0, NULL, &splitdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_taskpool_create(taskmgr, mctx, 4, 0, &pool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_rdatacallbacks_init(&callbacks);
+	result = dns_db_beginload(splitdb, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	split_done = ISC_FALSE;
+	result = dns_master_loadfileinc4("test.split", dns_db_origin(db),
+					 dns_db_origin(db), dns_rdataclass_in,
+					 DNS_MASTER_ZONE, 0, &callbacks,
+					 maintask, loadsplit_done, NULL,
+					 &loadctx, mctx,
+					 dns_masterformat_text, pool);
+	ATF_REQUIRE_EQ(result, DNS_R_CONTINUE);
+	i = 0;
+	while (!split_done && i++ < 5000)
+		dns_test_nap(1000);
+	ATF_REQUIRE(split_done);
+	ATF_CHECK_EQ(split_result, ISC_R_SUCCESS);
+	result = dns_db_endload(splitdb, &callbacks);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_loadctx_detach(&loadctx);
+
+	result = dns_master_dump(mctx, db, NULL, &dns_master_style_default,
+				 "test.dump");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_master_dump(mctx, splitdb, NULL,
+				 &dns_master_style_default, "test.dump2");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	f1 = fopen("test.dump", "r");
+	f2 = fopen("test.dump2", "r");
+	ATF_REQUIRE(f1 != NULL && f2 != NULL);
+	do {
+		c1 = fgetc(f1);
+		c2 = fgetc(f2);
+	} while (c1 == c2 && c1 != EOF);
+	ATF_CHECK_EQ(c1, c2);
+	fclose(f1);
+	fclose(f2);
+
+	unlink("test.split");
+	unlink("test.dump");
+	unlink("test.dump2");
+	isc_taskpool_destroy(&pool);
+	dns_db_detach(&splitdb);
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
 static const char *warn_expect_value;
 static isc_boolean_t warn_expect_result;
 
@@ -626,6 +855,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, totext);
 	ATF_TP_ADD_TC(tp, loadraw);
 	ATF_TP_ADD_TC(tp, dumpraw);
+	ATF_TP_ADD_TC(tp, dumpmap);
+	ATF_TP_ADD_TC(tp, loadsplit);
 	ATF_TP_ADD_TC(tp, toobig);
 	ATF_TP_ADD_TC(tp, maxrdata);
 	ATF_TP_ADD_TC(tp, neworigin);
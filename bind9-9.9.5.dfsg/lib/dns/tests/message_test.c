@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* $Id$ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/lex.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+typedef struct {
+	const char *	owner;
+	dns_ttl_t	ttl;
+	dns_rdatatype_t	type;
+	const char *	text;
+} record_t;
+
+/*
+ * Names repeat across owners and rdata, so that the output depends on
+ * compression.
+ */
+static const record_t records[] = {
+	{ "example.", 3600, dns_rdatatype_soa,
+	  "ns1.example. hostmaster.example. 1 3600 600 86400 300" },
+	{ "example.", 3600, dns_rdatatype_ns, "ns1.example." },
+	{ "example.", 3600, dns_rdatatype_ns, "ns2.example." },
+	{ "example.", 3600, dns_rdatatype_mx, "10 mail.example." },
+	{ "ns1.example.", 300, dns_rdatatype_a, "10.0.0.1" },
+	{ "ns2.example.", 300, dns_rdatatype_a, "10.0.0.2" },
+	{ "mail.example.", 300, dns_rdatatype_a, "10.0.0.3" },
+	{ "www.example.", 300, dns_rdatatype_cname, "mail.example." },
+	{ "txt.example.", 0, dns_rdatatype_txt, "\"some text\"" },
+	{ "a.b.c.example.", 60, dns_rdatatype_a, "10.0.0.4" },
+};
+#define NRECORDS (sizeof(records) / sizeof(records[0]))
+
+typedef struct {
+	dns_fixedname_t	owner;
+	dns_ttl_t	ttl;
+	dns_rdata_t	rdata;
+	unsigned char	data[512];
+} wirerecord_t;
+
+static void
+fromtext(const record_t *rec, wirerecord_t *wr) {
+	isc_buffer_t source, target;
+	isc_lex_t *lex = NULL;
+	isc_result_t result;
+
+	dns_fixedname_init(&wr->owner);
+	isc_buffer_constinit(&source, rec->owner, strlen(rec->owner));
+	isc_buffer_add(&source, strlen(rec->owner));
+	result = dns_name_fromtext(dns_fixedname_name(&wr->owner), &source,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	wr->ttl = rec->ttl;
+
+	result = isc_lex_create(mctx, 64, &lex);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_constinit(&source, rec->text, strlen(rec->text));
+	isc_buffer_add(&source, strlen(rec->text));
+	result = isc_lex_openbuffer(lex, &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_rdata_init(&wr->rdata);
+	isc_buffer_init(&target, wr->data, sizeof(wr->data));
+	result = dns_rdata_fromtext(&wr->rdata, dns_rdataclass_in, rec->type,
+				    lex, dns_rootname, 0, mctx, &target, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_lex_destroy(&lex);
+}
+
+static void
+render_begin(dns_message_t **msgp, dns_compress_t *cctx,
+	     isc_buffer_t *target)
+{
+	isc_result_t result;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTRENDER, msgp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	(*msgp)->id = 1;
+	(*msgp)->flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_AA;
+	(*msgp)->opcode = dns_opcode_query;
+	(*msgp)->rdclass = dns_rdataclass_in;
+
+	result = dns_compress_init(cctx, -1, mctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_renderbegin(*msgp, cctx, target);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+render_end(dns_message_t **msgp, dns_compress_t *cctx) {
+	isc_result_t result;
+
+	result = dns_message_renderend(*msgp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_compress_invalidate(cctx);
+	dns_message_destroy(msgp);
+}
+
+/*
+ * Render 'wr' into the answer section the way dns_message_renderrdata()
+ * is meant to replace: as a name and rdataset added to the message.
+ */
+static void
+render_section(wirerecord_t *wr, unsigned int count, isc_buffer_t *target) {
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	dns_name_t *name;
+	dns_rdata_t *rdata;
+	dns_rdatalist_t *rdatalist;
+	dns_rdataset_t *rdataset;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned int i;
+
+	render_begin(&msg, &cctx, target);
+	for (i = 0; i < count; i++) {
+		name = NULL;
+		rdata = NULL;
+		rdatalist = NULL;
+		rdataset = NULL;
+		result = dns_message_gettempname(msg, &name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_gettemprdata(msg, &rdata);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_gettemprdatalist(msg, &rdatalist);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_message_gettemprdataset(msg, &rdataset);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+		dns_name_init(name, NULL);
+		dns_name_clone(dns_fixedname_name(&wr[i].owner), name);
+		dns_rdata_init(rdata);
+		dns_rdata_toregion(&wr[i].rdata, &r);
+		dns_rdata_fromregion(rdata, wr[i].rdata.rdclass,
+				     wr[i].rdata.type, &r);
+		rdatalist->type = wr[i].rdata.type;
+		rdatalist->covers = 0;
+		rdatalist->rdclass = dns_rdataclass_in;
+		rdatalist->ttl = wr[i].ttl;
+		ISC_LIST_INIT(rdatalist->rdata);
+		ISC_LINK_INIT(rdatalist, link);
+		ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+		dns_rdataset_init(rdataset);
+		result = dns_rdatalist_tordataset(rdatalist, rdataset);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ISC_LIST_APPEND(name->list, rdataset, link);
+		dns_message_addname(msg, name, DNS_SECTION_ANSWER);
+	}
+	result = dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	render_end(&msg, &cctx);
+}
+
+/*
+ * Parse the message in 'source' and check that its answer section holds
+ * the first 'count' records, in order.
+ */
+static void
+check_parse(isc_buffer_t *source, wirerecord_t *wr, unsigned int count) {
+	dns_message_t *msg = NULL;
+	dns_name_t *name;
+	dns_rdataset_t *rdataset;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_result_t result;
+	unsigned int i = 0;
+
+	result = dns_message_create(mctx, DNS_MESSAGE_INTENTPARSE, &msg);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_message_parse(msg, source, DNS_MESSAGEPARSE_PRESERVEORDER);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(msg->counts[DNS_SECTION_ANSWER], count);
+
+	for (result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_ANSWER))
+	{
+		name = NULL;
+		dns_message_currentname(msg, DNS_SECTION_ANSWER, &name);
+		for (rdataset = ISC_LIST_HEAD(name->list);
+		     rdataset != NULL;
+		     rdataset = ISC_LIST_NEXT(rdataset, link))
+		{
+			ATF_REQUIRE(i < count);
+			ATF_CHECK(dns_name_equal(name,
+				       dns_fixedname_name(&wr[i].owner)));
+			ATF_CHECK_EQ(rdataset->ttl, wr[i].ttl);
+			result = dns_rdataset_first(rdataset);
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			dns_rdataset_current(rdataset, &rdata);
+			ATF_CHECK_EQ(dns_rdata_compare(&rdata,
+						       &wr[i].rdata), 0);
+			dns_rdata_reset(&rdata);
+			i++;
+		}
+	}
+	ATF_CHECK_EQ(i, count);
+
+	dns_message_destroy(&msg);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(renderrdata);
+ATF_TC_HEAD(renderrdata, tc) {
+	atf_tc_set_md_var(tc, "descr", "dns_message_renderrdata() writes "
+				       "what dns_message_rendersection() "
+				       "would");
+}
+ATF_TC_BODY(renderrdata, tc) {
+	wirerecord_t wr[NRECORDS];
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t direct, section;
+	unsigned char dbuf[4096], sbuf[4096];
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NRECORDS; i++)
+		fromtext(&records[i], &wr[i]);
+
+	isc_buffer_init(&direct, dbuf, sizeof(dbuf));
+	render_begin(&msg, &cctx, &direct);
+	for (i = 0; i < NRECORDS; i++) {
+		result = dns_message_renderrdata(msg, DNS_SECTION_ANSWER,
+					dns_fixedname_name(&wr[i].owner),
+					wr[i].ttl, &wr[i].rdata);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	render_end(&msg, &cctx);
+
+	isc_buffer_init(&section, sbuf, sizeof(sbuf));
+	render_section(wr, NRECORDS, &section);
+
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&direct),
+		       isc_buffer_usedlength(&section));
+	ATF_CHECK(memcmp(dbuf, sbuf, isc_buffer_usedlength(&direct)) == 0);
+
+	check_parse(&direct, wr, NRECORDS);
+
+	dns_test_end();
+}
+
+ATF_TC(renderrdata_nospace);
+ATF_TC_HEAD(renderrdata_nospace, tc) {
+	atf_tc_set_md_var(tc, "descr", "a record that does not fit leaves "
+				       "the message as it was");
+}
+ATF_TC_BODY(renderrdata_nospace, tc) {
+	wirerecord_t wr[NRECORDS];
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t target, section;
+	unsigned char buf[128], sbuf[4096];
+	isc_result_t result;
+	unsigned int i, used, written;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NRECORDS; i++)
+		fromtext(&records[i], &wr[i]);
+
+	/*
+	 * Fill a small message until a record does not fit, then try
+	 * the rest, as a transfer does before it starts a new message.
+	 */
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render_begin(&msg, &cctx, &target);
+	written = 0;
+	for (i = 0; i < NRECORDS; i++) {
+		used = isc_buffer_usedlength(&target);
+		result = dns_message_renderrdata(msg, DNS_SECTION_ANSWER,
+					dns_fixedname_name(&wr[i].owner),
+					wr[i].ttl, &wr[i].rdata);
+		if (result == ISC_R_NOSPACE) {
+			ATF_CHECK_EQ(isc_buffer_usedlength(&target), used);
+			break;
+		}
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		written++;
+	}
+	ATF_REQUIRE(written > 0 && written < NRECORDS);
+	result = dns_message_renderrdata(msg, DNS_SECTION_ANSWER,
+				dns_fixedname_name(&wr[NRECORDS - 1].owner),
+				wr[NRECORDS - 1].ttl,
+				&wr[NRECORDS - 1].rdata);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(msg->counts[DNS_SECTION_ANSWER], written);
+	render_end(&msg, &cctx);
+
+	/*
+	 * The failed records must not have left names behind in the
+	 * compression table: the message is the same as one rendered
+	 * from the records that fitted.
+	 */
+	isc_buffer_init(&section, sbuf, sizeof(sbuf));
+	render_section(wr, written, &section);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&target),
+		       isc_buffer_usedlength(&section));
+	ATF_CHECK(memcmp(buf, sbuf, isc_buffer_usedlength(&target)) == 0);
+
+	check_parse(&target, wr, written);
+
+	dns_test_end();
+}
+
+ATF_TC(renderrdata_rollback);
+ATF_TC_HEAD(renderrdata_rollback, tc) {
+	atf_tc_set_md_var(tc, "descr", "names of a record that did not fit "
+				       "are not used for compression");
+}
+ATF_TC_BODY(renderrdata_rollback, tc) {
+	static const record_t rollback[] = {
+		{ "x.example.", 300, dns_rdatatype_a, "10.0.0.1" },
+		{ "longer-owner.example.", 300, dns_rdatatype_txt,
+		  "\"0123456789012345678901234567890123456789"
+		  "0123456789012345678901234567890123456789\"" },
+		{ "longer-owner.example.", 300, dns_rdatatype_a, "10.0.0.2" },
+	};
+	wirerecord_t wr[3];
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t target, section;
+	unsigned char buf[100], sbuf[4096];
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 3; i++)
+		fromtext(&rollback[i], &wr[i]);
+
+	/*
+	 * The owner of the TXT record fits but its rdata does not.  The
+	 * A record with the same owner is then written where the TXT
+	 * record's owner was, and must not point at it.
+	 */
+	isc_buffer_init(&target, buf, sizeof(buf));
+	render_begin(&msg, &cctx, &target);
+	for (i = 0; i < 3; i++) {
+		result = dns_message_renderrdata(msg, DNS_SECTION_ANSWER,
+					dns_fixedname_name(&wr[i].owner),
+					wr[i].ttl, &wr[i].rdata);
+		ATF_CHECK_EQ(result, (i == 1) ? ISC_R_NOSPACE : ISC_R_SUCCESS);
+	}
+	render_end(&msg, &cctx);
+
+	wr[1] = wr[2];
+	isc_buffer_init(&section, sbuf, sizeof(sbuf));
+	render_section(wr, 2, &section);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&target),
+		       isc_buffer_usedlength(&section));
+	ATF_CHECK(memcmp(buf, sbuf, isc_buffer_usedlength(&target)) == 0);
+
+	check_parse(&target, wr, 2);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, renderrdata);
+	ATF_TP_ADD_TC(tp, renderrdata_nospace);
+	ATF_TP_ADD_TC(tp, renderrdata_rollback);
+
+	return (atf_no_error());
+}
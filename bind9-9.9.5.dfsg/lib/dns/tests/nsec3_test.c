@@ -22,9 +22,12 @@
 
 #include <atf-c.h>
 
+#include <string.h>
 #include <unistd.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
 #include <dns/nsec3.h>
 
 #include "dnstest.h"
@@ -75,11 +78,92 @@ ATF_TC_BODY(max_iterations, tc) {
 	iteration_test("testdata/nsec3/min-2048.db", 500);
 }
 
+ATF_TC(hashnames);
+ATF_TC_HEAD(hashnames, tc) {
+	atf_tc_set_md_var(tc, "descr", "check that names hashed together "
+			  "match names hashed one at a time");
+}
+ATF_TC_BODY(hashnames, tc) {
+	/* RFC 5155 Appendix A */
+	const char *names[] = {
+		"example", "a.example", "ai.example", "ns1.example",
+		"ns2.example", "w.example", "*.w.example", "x.w.example",
+		"y.w.example", "x.y.w.example", "XX.EXAMPLE",
+		"2T7B4G4VSA5SMI47K61MV5BV1A22BOJR.example"
+	};
+	const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	unsigned char hashes[20][NSEC3_MAX_HASH_LENGTH];
+	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	unsigned char *rethashes[20];
+	dns_fixedname_t fixed[20], results[20], result1, expected;
+	dns_name_t *name[20];
+	isc_buffer_t b;
+	isc_result_t result;
+	size_t length, length1;
+	unsigned int i, n;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < 20; i++) {
+		const char *text = names[i % (sizeof(names) / sizeof(*names))];
+
+		dns_fixedname_init(&fixed[i]);
+		name[i] = dns_fixedname_name(&fixed[i]);
+		isc_buffer_constinit(&b, text, strlen(text));
+		isc_buffer_add(&b, strlen(text));
+		result = dns_name_fromtext(name[i], &b, dns_rootname, 0, NULL);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		rethashes[i] = hashes[i];
+	}
+
+	for (n = 0; n <= 20; n++) {
+		length = 0;
+		result = dns_nsec3_hashnames(results, (n % 2) ? rethashes : NULL,
+					     &length, name, n, dns_rootname,
+					     dns_hash_sha1, 12, salt,
+					     sizeof(salt));
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		ATF_CHECK(n == 0 || length == 20);
+		for (i = 0; i < n; i++) {
+			result = dns_nsec3_hashname(&result1, hash, &length1,
+						    name[i], dns_rootname,
+						    dns_hash_sha1, 12, salt,
+						    sizeof(salt));
+			ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+			ATF_CHECK(dns_name_equal(dns_fixedname_name(&results[i]),
+					dns_fixedname_name(&result1)));
+			if (n % 2)
+				ATF_CHECK(memcmp(hashes[i], hash,
+						 sizeof(hash)) == 0);
+		}
+	}
+
+	/* "example" is hashed to 0p9mhaveqvm6t7vbl5lop2u3t2rp3tom. */
+	dns_fixedname_init(&expected);
+	isc_buffer_constinit(&b, "0p9mhaveqvm6t7vbl5lop2u3t2rp3tom", 32);
+	isc_buffer_add(&b, 32);
+	result = dns_name_fromtext(dns_fixedname_name(&expected), &b,
+				   dns_rootname, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK(dns_name_equal(dns_fixedname_name(&results[0]),
+				 dns_fixedname_name(&expected)));
+
+	result = dns_nsec3_hashnames(results, NULL, NULL, name, 3,
+				     dns_rootname, 2, 12, salt, sizeof(salt));
+	ATF_CHECK_EQ(result, DNS_R_BADALG);
+
+	dns_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, max_iterations);
+	ATF_TP_ADD_TC(tp, hashnames);
 
 	return (atf_no_error());
 }
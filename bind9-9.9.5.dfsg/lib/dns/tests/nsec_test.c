@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* $Id$ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/buffer.h>
+#include <isc/lex.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/nsec.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include "dnstest.h"
+
+/*
+ * Helper functions
+ */
+
+static isc_stdtime_t now;
+
+static void
+nolog(void *arg, int level, const char *fmt, ...) {
+	UNUSED(arg);
+	UNUSED(level);
+	UNUSED(fmt);
+}
+
+static void
+makename(const char *text, dns_fixedname_t *fixed) {
+	isc_result_t result;
+
+	dns_fixedname_init(fixed);
+	result = dns_name_fromstring(dns_fixedname_name(fixed), text, 0,
+				     NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+/*
+ * Add a record of type 'type' at 'owner' to the cache 'db', with the
+ * rdata given in 'text' and the trust level 'trust'.
+ */
+static void
+add(dns_db_t *db, const char *owner, dns_rdatatype_t type, dns_ttl_t ttl,
+    const char *text, dns_trust_t trust)
+{
+	dns_fixedname_t fixed;
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	isc_lex_t *lex = NULL;
+	isc_buffer_t source, target;
+	unsigned char data[512];
+	isc_result_t result;
+
+	makename(owner, &fixed);
+
+	result = isc_lex_create(mctx, 64, &lex);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_constinit(&source, text, strlen(text));
+	isc_buffer_add(&source, strlen(text));
+	result = isc_lex_openbuffer(lex, &source);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&target, data, sizeof(data));
+	result = dns_rdata_fromtext(&rdata, dns_rdataclass_in, type, lex,
+				    dns_rootname, 0, mctx, &target, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_lex_destroy(&lex);
+
+	rdatalist.type = type;
+	if (type == dns_rdatatype_rrsig)
+		rdatalist.covers = dns_rdata_covers(&rdata);
+	else
+		rdatalist.covers = 0;
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.ttl = ttl;
+	ISC_LIST_INIT(rdatalist.rdata);
+	ISC_LINK_INIT(&rdatalist, link);
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	rdataset.trust = trust;
+
+	result = dns_db_findnode(db, dns_fixedname_name(&fixed), ISC_TRUE,
+				 &node);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detachnode(db, &node);
+	dns_rdataset_disassociate(&rdataset);
+}
+
+/*
+ * Add an NSEC record and its signature by example.
+ */
+static void
+add_nsec(dns_db_t *db, const char *owner, const char *text,
+	 dns_trust_t trust)
+{
+	add(db, owner, dns_rdatatype_nsec, 300, text, trust);
+	add(db, owner, dns_rdatatype_rrsig, 300,
+	    "NSEC 8 2 300 20300101000000 20000101000000 12345 "
+	    "example. AAAA", trust);
+}
+
+/*
+ * A cache holding the validated NSEC chain of example., with a.example.
+ * as its only name and d.example. delegated to an unsigned child, and
+ * the SOA of example. at 'soatrust'.  If 'apex' is ISC_FALSE the NSEC
+ * at the apex, which proves that there is no *.example., is left out.
+ */
+static void
+make_cache(dns_db_t **dbp, dns_trust_t nsectrust, dns_trust_t soatrust,
+	   isc_boolean_t apex)
+{
+	isc_result_t result;
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_cache,
+			       dns_rdataclass_in, 0, NULL, dbp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	add(*dbp, "example.", dns_rdatatype_soa, 300,
+	    "ns.example. hostmaster.example. 1 3600 600 86400 60", soatrust);
+	add(*dbp, "example.", dns_rdatatype_rrsig, 300,
+	    "SOA 8 1 300 20300101000000 20000101000000 12345 "
+	    "example. AAAA", soatrust);
+	if (apex)
+		add_nsec(*dbp, "example.",
+			 "a.example. NS SOA RRSIG NSEC DNSKEY", nsectrust);
+	add_nsec(*dbp, "a.example.", "d.example. A RRSIG NSEC", nsectrust);
+	add_nsec(*dbp, "d.example.", "example. NS RRSIG NSEC", nsectrust);
+}
+
+/*
+ * Run dns_nsec_synthnegative() for 'qname'/'type' and return its
+ * result.  If 'owner' and 'wowner' are not NULL the owners of the NSEC
+ * records used must match them.
+ */
+static isc_result_t
+synth(dns_db_t *db, const char *qname, dns_rdatatype_t type,
+      const char *owner, const char *wowner, dns_ttl_t *ttlp)
+{
+	dns_fixedname_t fqname, fowner, fwowner, fsoaname, fexpect;
+	dns_rdataset_t nsec, nsecsig, wnsec, wnsecsig, soa, soasig;
+	isc_result_t result;
+
+	makename(qname, &fqname);
+	dns_fixedname_init(&fowner);
+	dns_fixedname_init(&fwowner);
+	dns_fixedname_init(&fsoaname);
+	dns_rdataset_init(&nsec);
+	dns_rdataset_init(&nsecsig);
+	dns_rdataset_init(&wnsec);
+	dns_rdataset_init(&wnsecsig);
+	dns_rdataset_init(&soa);
+	dns_rdataset_init(&soasig);
+
+	result = dns_nsec_synthnegative(db, dns_fixedname_name(&fqname),
+					type, now,
+					dns_fixedname_name(&fowner),
+					&nsec, &nsecsig,
+					dns_fixedname_name(&fwowner),
+					&wnsec, &wnsecsig,
+					dns_fixedname_name(&fsoaname),
+					&soa, &soasig, nolog, NULL);
+
+	if (result == ISC_R_NOTFOUND) {
+		ATF_CHECK(!dns_rdataset_isassociated(&nsec));
+		ATF_CHECK(!dns_rdataset_isassociated(&wnsec));
+		ATF_CHECK(!dns_rdataset_isassociated(&soa));
+		return (result);
+	}
+
+	ATF_CHECK(dns_rdataset_isassociated(&nsec));
+	ATF_CHECK(dns_rdataset_isassociated(&nsecsig));
+	ATF_CHECK(dns_rdataset_isassociated(&soa));
+	if (owner != NULL) {
+		makename(owner, &fexpect);
+		ATF_CHECK(dns_name_equal(dns_fixedname_name(&fowner),
+					 dns_fixedname_name(&fexpect)));
+	}
+	if (result == DNS_R_NXDOMAIN) {
+		ATF_CHECK(dns_rdataset_isassociated(&wnsec));
+		ATF_CHECK(dns_rdataset_isassociated(&wnsecsig));
+		if (wowner != NULL) {
+			makename(wowner, &fexpect);
+			ATF_CHECK(dns_name_equal(
+					dns_fixedname_name(&fwowner),
+					dns_fixedname_name(&fexpect)));
+		}
+	}
+	if (ttlp != NULL)
+		*ttlp = soa.ttl;
+
+	if (dns_rdataset_isassociated(&nsec))
+		dns_rdataset_disassociate(&nsec);
+	if (dns_rdataset_isassociated(&nsecsig))
+		dns_rdataset_disassociate(&nsecsig);
+	if (dns_rdataset_isassociated(&wnsec))
+		dns_rdataset_disassociate(&wnsec);
+	if (dns_rdataset_isassociated(&wnsecsig))
+		dns_rdataset_disassociate(&wnsecsig);
+	if (dns_rdataset_isassociated(&soa))
+		dns_rdataset_disassociate(&soa);
+	if (dns_rdataset_isassociated(&soasig))
+		dns_rdataset_disassociate(&soasig);
+	return (result);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(synth_nxdomain);
+ATF_TC_HEAD(synth_nxdomain, tc) {
+	atf_tc_set_md_var(tc, "descr", "NXDOMAIN from a covering NSEC and "
+				       "a wildcard proof");
+}
+ATF_TC_BODY(synth_nxdomain, tc) {
+	dns_db_t *db = NULL;
+	dns_ttl_t ttl = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	make_cache(&db, dns_trust_secure, dns_trust_secure, ISC_TRUE);
+	result = synth(db, "b.example.", dns_rdatatype_a, "a.example.",
+		       "example.", &ttl);
+	ATF_CHECK_EQ(result, DNS_R_NXDOMAIN);
+	/* Limited by the SOA MINIMUM. */
+	ATF_CHECK(ttl <= 60);
+
+	result = synth(db, "x.b.example.", dns_rdatatype_a, "a.example.",
+		       "example.", NULL);
+	ATF_CHECK_EQ(result, DNS_R_NXDOMAIN);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(synth_nodata);
+ATF_TC_HEAD(synth_nodata, tc) {
+	atf_tc_set_md_var(tc, "descr", "NODATA from the NSEC at the name");
+}
+ATF_TC_BODY(synth_nodata, tc) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	make_cache(&db, dns_trust_secure, dns_trust_secure, ISC_TRUE);
+	result = synth(db, "a.example.", dns_rdatatype_mx, "a.example.",
+		       NULL, NULL);
+	ATF_CHECK_EQ(result, DNS_R_NXRRSET);
+
+	/* The NSEC says there is an A record. */
+	result = synth(db, "a.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* It cannot prove that there are no records at all. */
+	result = synth(db, "a.example.", dns_rdatatype_any, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(synth_delegation);
+ATF_TC_HEAD(synth_delegation, tc) {
+	atf_tc_set_md_var(tc, "descr", "the NSEC at a delegation proves "
+				       "nothing below or at the child");
+}
+ATF_TC_BODY(synth_delegation, tc) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	make_cache(&db, dns_trust_secure, dns_trust_secure, ISC_TRUE);
+
+	/* Names below the delegation are in the child zone. */
+	result = synth(db, "x.d.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* So is the data at the delegation point... */
+	result = synth(db, "d.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* ...except the DS, which the parent-side NSEC does cover. */
+	result = synth(db, "d.example.", dns_rdatatype_ds, "d.example.",
+		       NULL, NULL);
+	ATF_CHECK_EQ(result, DNS_R_NXRRSET);
+
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+ATF_TC(synth_insecure);
+ATF_TC_HEAD(synth_insecure, tc) {
+	atf_tc_set_md_var(tc, "descr", "records that are not secure are "
+				       "not used");
+}
+ATF_TC_BODY(synth_insecure, tc) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	make_cache(&db, dns_trust_answer, dns_trust_secure, ISC_TRUE);
+	result = synth(db, "b.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = synth(db, "a.example.", dns_rdatatype_mx, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	dns_db_detach(&db);
+
+	make_cache(&db, dns_trust_secure, dns_trust_answer, ISC_TRUE);
+	result = synth(db, "b.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = synth(db, "a.example.", dns_rdatatype_mx, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	dns_db_detach(&db);
+
+	dns_test_end();
+}
+
+ATF_TC(synth_wildcard);
+ATF_TC_HEAD(synth_wildcard, tc) {
+	atf_tc_set_md_var(tc, "descr", "NXDOMAIN needs proof that there is "
+				       "no wildcard");
+}
+ATF_TC_BODY(synth_wildcard, tc) {
+	dns_db_t *db = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_stdtime_get(&now);
+
+	/*
+	 * Without the apex NSEC nothing shows that *.example. does not
+	 * exist.  NODATA does not depend on it.
+	 */
+	make_cache(&db, dns_trust_secure, dns_trust_secure, ISC_FALSE);
+	result = synth(db, "b.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	result = synth(db, "a.example.", dns_rdatatype_mx, "a.example.",
+		       NULL, NULL);
+	ATF_CHECK_EQ(result, DNS_R_NXRRSET);
+	dns_db_detach(&db);
+
+	/*
+	 * When *.example. exists the name may be synthesized from it.
+	 */
+	make_cache(&db, dns_trust_secure, dns_trust_secure, ISC_FALSE);
+	add_nsec(db, "example.", "*.example. NS SOA RRSIG NSEC DNSKEY",
+		 dns_trust_secure);
+	add_nsec(db, "*.example.", "a.example. A RRSIG NSEC",
+		 dns_trust_secure);
+	result = synth(db, "b.example.", dns_rdatatype_a, NULL, NULL, NULL);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+	dns_db_detach(&db);
+
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, synth_nxdomain);
+	ATF_TP_ADD_TC(tp, synth_nodata);
+	ATF_TP_ADD_TC(tp, synth_delegation);
+	ATF_TP_ADD_TC(tp, synth_insecure);
+	ATF_TP_ADD_TC(tp, synth_wildcard);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/name.h>
+#include <dns/respcache.h>
+
+#include "dnstest.h"
+
+static dns_db_t *db = NULL;
+
+static void
+setup(dns_dbtype_t dbtype) {
+	isc_result_t result;
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_db_create(mctx, "rbt", dns_rootname, dbtype,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+teardown(void) {
+	dns_db_detach(&db);
+	dns_test_end();
+}
+
+static void
+region(isc_region_t *r, const char *s) {
+	DE_CONST(s, r->base);
+	r->length = strlen(s);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(findadd);
+ATF_TC_HEAD(findadd, tc) {
+	atf_tc_set_md_var(tc, "descr", "add responses and find them again");
+}
+ATF_TC_BODY(findadd, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_region_t key, wire;
+	isc_buffer_t b;
+	unsigned char data[64];
+	unsigned int tag = 0;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(dns_dbtype_zone);
+	dns_db_currentversion(db, &version);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	region(&key, "key-1");
+	region(&wire, "0123456789abcdef response one");
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	result = dns_respcache_add(rc, &key, db, version, 42, &wire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, 42);
+	ATF_REQUIRE_EQ(isc_buffer_usedlength(&b), wire.length);
+	ATF_CHECK(memcmp(data, wire.base, wire.length) == 0);
+
+	/* Keys are compared exactly. */
+	region(&key, "KEY-1");
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* Too little space leaves the target untouched. */
+	region(&key, "key-1");
+	isc_buffer_init(&b, data, 10);
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOSPACE);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), 0);
+
+	/* Adding the same key again replaces the entry. */
+	region(&wire, "response two");
+	result = dns_respcache_add(rc, &key, db, version, 7, &wire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(tag, 7);
+	ATF_CHECK_EQ(isc_buffer_usedlength(&b), wire.length);
+
+	dns_respcache_flush(rc);
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_respcache_destroy(&rc);
+	ATF_CHECK_EQ(rc, NULL);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	teardown();
+}
+
+ATF_TC(version);
+ATF_TC_HEAD(version, tc) {
+	atf_tc_set_md_var(tc, "descr", "a new database version hides "
+			  "older responses");
+}
+ATF_TC_BODY(version, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_dbversion_t *v1 = NULL, *v2 = NULL;
+	isc_region_t key, wire;
+	isc_buffer_t b;
+	unsigned char data[64];
+	unsigned int tag;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(dns_dbtype_zone);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &v1);
+	region(&key, "key");
+	region(&wire, "old response");
+	result = dns_respcache_add(rc, &key, db, v1, 0, &wire);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Commit a new version while the cache still holds the old one.
+	 */
+	result = dns_db_newversion(db, &v2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &v2, ISC_TRUE);
+	dns_db_currentversion(db, &v2);
+	ATF_REQUIRE(v1 != v2);
+
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, v2, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	/* The stale entry has been dropped. */
+	result = dns_respcache_find(rc, &key, db, v1, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+	dns_db_closeversion(db, &v1, ISC_FALSE);
+	dns_db_closeversion(db, &v2, ISC_FALSE);
+	dns_respcache_destroy(&rc);
+	teardown();
+}
+
+ATF_TC(noref);
+ATF_TC_HEAD(noref, tc) {
+	atf_tc_set_md_var(tc, "descr", "entries do not keep databases "
+			  "alive, nor match their successors");
+}
+ATF_TC_BODY(noref, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_db_t *zdb = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_mem_t *dbmctx = NULL;
+	isc_region_t key, wire;
+	isc_buffer_t b;
+	unsigned char data[64];
+	unsigned int tag, i;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(dns_dbtype_zone);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mem_create(0, 0, &dbmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	region(&key, "key");
+	region(&wire, "response");
+	for (i = 0; i < 3; i++) {
+		/*
+		 * Each database is freed as soon as it is detached, and the
+		 * next one may well be given the same memory.
+		 */
+		result = dns_db_create(dbmctx, "rbt", dns_rootname,
+				       dns_dbtype_zone, dns_rdataclass_in,
+				       0, NULL, &zdb);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		dns_db_currentversion(zdb, &version);
+
+		isc_buffer_init(&b, data, sizeof(data));
+		result = dns_respcache_find(rc, &key, zdb, version, &b, &tag);
+		ATF_CHECK_EQ(result, ISC_R_NOTFOUND);
+
+		result = dns_respcache_add(rc, &key, zdb, version, i, &wire);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_respcache_find(rc, &key, zdb, version, &b, &tag);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+		dns_db_closeversion(zdb, &version, ISC_FALSE);
+		dns_db_detach(&zdb);
+		ATF_CHECK_EQ(isc_mem_references(dbmctx), 1);
+	}
+
+	dns_respcache_destroy(&rc);
+	isc_mem_destroy(&dbmctx);
+	teardown();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "least recently used responses are "
+			  "evicted to stay within the size limit");
+}
+ATF_TC_BODY(evict, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_region_t key, wire;
+	isc_buffer_t b;
+	unsigned char data[DNS_RESPCACHE_MAXWIRE];
+	char name[32];
+	unsigned int i, found, tag;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(dns_dbtype_zone);
+	dns_db_currentversion(db, &version);
+
+	/* Room for no more than a few hundred responses. */
+	result = dns_respcache_create(mctx, 256 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	memset(data, 'x', sizeof(data));
+	wire.base = data;
+	wire.length = 1000;
+	for (i = 0; i < 2000; i++) {
+		snprintf(name, sizeof(name), "key-%u", i);
+		region(&key, name);
+		result = dns_respcache_add(rc, &key, db, version, i, &wire);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	found = 0;
+	for (i = 0; i < 2000; i++) {
+		snprintf(name, sizeof(name), "key-%u", i);
+		region(&key, name);
+		isc_buffer_init(&b, data, sizeof(data));
+		result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+		if (result == ISC_R_SUCCESS) {
+			ATF_CHECK_EQ(tag, i);
+			found++;
+		}
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found <= 256);
+
+	/* The most recent response is still there. */
+	region(&key, "key-1999");
+	isc_buffer_init(&b, data, sizeof(data));
+	result = dns_respcache_find(rc, &key, db, version, &b, &tag);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+
+	/* Oversized responses are refused. */
+	wire.length = DNS_RESPCACHE_MAXWIRE + 1;
+	result = dns_respcache_add(rc, &key, db, version, 0, &wire);
+	ATF_CHECK_EQ(result, ISC_R_RANGE);
+
+	dns_respcache_destroy(&rc);
+	dns_db_closeversion(db, &version, ISC_FALSE);
+	teardown();
+}
+
+ATF_TC(cachedb);
+ATF_TC_HEAD(cachedb, tc) {
+	atf_tc_set_md_var(tc, "descr", "responses from a cache database "
+			  "are not kept");
+}
+ATF_TC_BODY(cachedb, tc) {
+	dns_respcache_t *rc = NULL;
+	dns_db_t *zdb = NULL;
+	dns_dbversion_t *version = NULL;
+	isc_region_t key, wire;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	setup(dns_dbtype_cache);
+
+	/*
+	 * A cache has no versions of its own; borrow one from a zone.
+	 */
+	result = dns_db_create(mctx, "rbt", dns_rootname, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &zdb);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_currentversion(zdb, &version);
+
+	result = dns_respcache_create(mctx, 1024 * 1024, &rc);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	region(&key, "key");
+	region(&wire, "response");
+	result = dns_respcache_add(rc, &key, db, version, 0, &wire);
+	ATF_CHECK_EQ(result, ISC_R_NOTIMPLEMENTED);
+
+	dns_respcache_destroy(&rc);
+	dns_db_closeversion(zdb, &version, ISC_FALSE);
+	dns_db_detach(&zdb);
+	teardown();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, findadd);
+	ATF_TP_ADD_TC(tp, version);
+	ATF_TP_ADD_TC(tp, noref);
+	ATF_TP_ADD_TC(tp, evict);
+	ATF_TP_ADD_TC(tp, cachedb);
+
+	return (atf_no_error());
+}
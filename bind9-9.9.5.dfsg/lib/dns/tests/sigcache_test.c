@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/sha2.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/sigcache.h>
+
+#include "dnstest.h"
+
+static void
+make_digest(unsigned char *digest, unsigned int n) {
+	isc_sha256_t sha256;
+	unsigned char data[4];
+
+	data[0] = (n >> 24) & 0xff;
+	data[1] = (n >> 16) & 0xff;
+	data[2] = (n >> 8) & 0xff;
+	data[3] = n & 0xff;
+	isc_sha256_init(&sha256);
+	isc_sha256_update(&sha256, data, sizeof(data));
+	isc_sha256_final(digest, &sha256);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(findadd);
+ATF_TC_HEAD(findadd, tc) {
+	atf_tc_set_md_var(tc, "descr", "add verifications and find them again");
+}
+ATF_TC_BODY(findadd, tc) {
+	dns_sigcache_t *cache = NULL, *cache2 = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 1024, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	for (i = 0; i < 100; i++) {
+		make_digest(digest, i);
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_NOTFOUND);
+		dns_sigcache_add(cache, digest, now + 3600);
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_SUCCESS);
+	}
+	for (i = 0; i < 100; i++) {
+		make_digest(digest, i);
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_SUCCESS);
+	}
+
+	/* Adding an entry twice keeps a single copy. */
+	make_digest(digest, 0);
+	dns_sigcache_add(cache, digest, now + 3600);
+	ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_SUCCESS);
+
+	/* A second reference keeps the cache alive. */
+	dns_sigcache_attach(cache, &cache2);
+	dns_sigcache_detach(&cache);
+	ATF_REQUIRE_EQ(cache, NULL);
+	ATF_CHECK_EQ(dns_sigcache_find(cache2, digest), ISC_R_SUCCESS);
+
+	dns_sigcache_flush(cache2);
+	for (i = 0; i < 100; i++) {
+		make_digest(digest, i);
+		ATF_CHECK_EQ(dns_sigcache_find(cache2, digest),
+			     ISC_R_NOTFOUND);
+	}
+
+	dns_sigcache_detach(&cache2);
+	ATF_REQUIRE_EQ(cache2, NULL);
+	dns_test_end();
+}
+
+ATF_TC(evict);
+ATF_TC_HEAD(evict, tc) {
+	atf_tc_set_md_var(tc, "descr", "the cache stays within its size");
+}
+ATF_TC_BODY(evict, tc) {
+	dns_sigcache_t *cache = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i, found;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_sigcache_create(mctx, 256, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	for (i = 0; i < 10000; i++) {
+		make_digest(digest, i);
+		dns_sigcache_add(cache, digest, now + 3600);
+		/* The newest entry is never the one evicted. */
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_SUCCESS);
+	}
+
+	found = 0;
+	for (i = 0; i < 10000; i++) {
+		make_digest(digest, i);
+		if (dns_sigcache_find(cache, digest) == ISC_R_SUCCESS)
+			found++;
+	}
+	ATF_CHECK(found > 0);
+	ATF_CHECK(found <= 256);
+
+	dns_sigcache_detach(&cache);
+	dns_test_end();
+}
+
+ATF_TC(expired);
+ATF_TC_HEAD(expired, tc) {
+	atf_tc_set_md_var(tc, "descr", "expired signatures are replaced first");
+}
+ATF_TC_BODY(expired, tc) {
+	dns_sigcache_t *cache = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now;
+	isc_result_t result;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * The smallest cache has a single set of slots per stripe, and
+	 * digests that agree in their first byte share a stripe.
+	 */
+	result = dns_sigcache_create(mctx, 1, &cache);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	isc_stdtime_get(&now);
+	memset(digest, 0, sizeof(digest));
+	for (i = 1; i <= 4; i++) {
+		digest[31] = i;
+		dns_sigcache_add(cache, digest, (i == 2) ? now - 60 : now + 60);
+	}
+	for (i = 1; i <= 4; i++) {
+		digest[31] = i;
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest), ISC_R_SUCCESS);
+	}
+
+	digest[31] = 5;
+	dns_sigcache_add(cache, digest, now + 60);
+	for (i = 1; i <= 5; i++) {
+		digest[31] = i;
+		ATF_CHECK_EQ(dns_sigcache_find(cache, digest),
+			     (i == 2) ? ISC_R_NOTFOUND : ISC_R_SUCCESS);
+	}
+
+	dns_sigcache_detach(&cache);
+	dns_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, findadd);
+	ATF_TP_ADD_TC(tp, evict);
+	ATF_TP_ADD_TC(tp, expired);
+
+	return (atf_no_error());
+}
@@ -0,0 +1,383 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* $Id$ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <isc/condition.h>
+#include <isc/mutex.h>
+#include <isc/sockaddr.h>
+#include <isc/task.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/diff.h>
+#include <dns/events.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/xfrin.h>
+#include <dns/zone.h>
+
+#include "dnstest.h"
+
+#ifdef ISC_PLATFORM_USETHREADS
+
+/*
+ * A zone manager on its own single threaded task manager, so that the
+ * zone's load task can be held up without stalling the transfer.
+ */
+static isc_taskmgr_t *loadtaskmgr = NULL;
+static dns_zonemgr_t *loadzonemgr = NULL;
+
+static isc_mutex_t lock;
+static isc_condition_t cond;
+static isc_boolean_t released;
+static isc_boolean_t drained;
+static isc_boolean_t xfrdone;
+static isc_result_t xfrresult;
+static dns_xfrin_ctx_t *xfr = NULL;
+
+/*
+ * Hold the load task until released.
+ */
+static void
+block(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&lock);
+	while (!released)
+		WAIT(&cond, &lock);
+	UNLOCK(&lock);
+	isc_event_free(&event);
+}
+
+static void
+drain(isc_task_t *task, isc_event_t *event) {
+	UNUSED(task);
+
+	LOCK(&lock);
+	drained = ISC_TRUE;
+	UNLOCK(&lock);
+	isc_event_free(&event);
+}
+
+static void
+done(dns_zone_t *zone, isc_result_t result) {
+	UNUSED(zone);
+
+	LOCK(&lock);
+	xfrdone = ISC_TRUE;
+	xfrresult = result;
+	UNLOCK(&lock);
+	dns_xfrin_detach(&xfr);
+}
+
+/*
+ * Wait up to five seconds for '*flag' to be set.
+ */
+static isc_boolean_t
+waitfor(isc_boolean_t *flag) {
+	isc_boolean_t set = ISC_FALSE;
+	int i;
+
+	for (i = 0; i < 5000 && !set; i++) {
+		LOCK(&lock);
+		set = *flag;
+		UNLOCK(&lock);
+		if (!set)
+			dns_test_nap(1000);
+	}
+	return (set);
+}
+
+static void
+sendevent(isc_task_t *task, isc_taskaction_t action) {
+	isc_event_t *event;
+
+	event = isc_event_allocate(mctx, task, ISC_TASKEVENT_TEST,
+				   action, NULL, sizeof(isc_event_t));
+	ATF_REQUIRE(event != NULL);
+	isc_task_send(task, &event);
+}
+
+static void
+add_tuple(dns_diff_t *diff, dns_name_t *name, dns_rdatatype_t type,
+	  unsigned char *data, unsigned int length)
+{
+	dns_difftuple_t *tuple = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_result_t result;
+
+	rdata.data = data;
+	rdata.length = length;
+	rdata.rdclass = dns_rdataclass_in;
+	rdata.type = type;
+	result = dns_difftuple_create(mctx, DNS_DIFFOP_ADD, name, 300,
+				      &rdata, &tuple);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_diff_append(diff, &tuple);
+}
+
+/*
+ * Append the wire form of a SOA record for example. with serial
+ * 'serial' to 'b'.
+ */
+static void
+put_soa(isc_buffer_t *b, isc_uint32_t serial) {
+	isc_buffer_putmem(b, (const unsigned char *)"\007example\000", 9);
+	isc_buffer_putuint16(b, dns_rdatatype_soa);
+	isc_buffer_putuint16(b, dns_rdataclass_in);
+	isc_buffer_putuint32(b, 300);
+	isc_buffer_putuint16(b, 22);
+	isc_buffer_putuint8(b, 0);
+	isc_buffer_putuint8(b, 0);
+	isc_buffer_putuint32(b, serial);
+	isc_buffer_putuint32(b, 0);
+	isc_buffer_putuint32(b, 0);
+	isc_buffer_putuint32(b, 0);
+	isc_buffer_putuint32(b, 0);
+}
+
+/*
+ * Read the IXFR request on 'fd' and answer it with a transaction from
+ * serial 1 to 2 followed by one that is out of sequence.
+ */
+static void
+serve(int fd) {
+	unsigned char query[512], response[512];
+	isc_buffer_t b;
+	size_t n, length;
+	ssize_t r;
+
+	for (n = 0; n < 2; n += r) {
+		r = recv(fd, query + n, 2 - n, 0);
+		ATF_REQUIRE(r > 0);
+	}
+	length = (query[0] << 8) | query[1];
+	ATF_REQUIRE(length >= 12 && length <= sizeof(query));
+	for (n = 0; n < length; n += r) {
+		r = recv(fd, query + n, length - n, 0);
+		ATF_REQUIRE(r > 0);
+	}
+
+	isc_buffer_init(&b, response, sizeof(response));
+	isc_buffer_add(&b, 2);
+	isc_buffer_putmem(&b, query, 2);	/* ID */
+	isc_buffer_putuint16(&b, 0x8400);	/* QR, AA */
+	isc_buffer_putuint16(&b, 1);
+	isc_buffer_putuint16(&b, 7);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putmem(&b, (const unsigned char *)"\007example\000", 9);
+	isc_buffer_putuint16(&b, dns_rdatatype_ixfr);
+	isc_buffer_putuint16(&b, dns_rdataclass_in);
+	put_soa(&b, 3);
+	put_soa(&b, 1);
+	put_soa(&b, 2);
+	isc_buffer_putmem(&b, (const unsigned char *)"\002h1\007example\000",
+			  12);
+	isc_buffer_putuint16(&b, dns_rdatatype_a);
+	isc_buffer_putuint16(&b, dns_rdataclass_in);
+	isc_buffer_putuint32(&b, 300);
+	isc_buffer_putuint16(&b, 4);
+	isc_buffer_putuint32(&b, 0x0a000001);
+	put_soa(&b, 2);			/* commits 1 to 2 */
+	put_soa(&b, 4);
+	put_soa(&b, 9);			/* out of sequence */
+	response[0] = ((b.used - 2) >> 8) & 0xff;
+	response[1] = (b.used - 2) & 0xff;
+
+	r = send(fd, response, b.used, 0);
+	ATF_REQUIRE_EQ(r, (ssize_t)b.used);
+}
+
+static isc_uint32_t
+zone_serial(dns_zone_t *zone) {
+	dns_db_t *db = NULL;
+	isc_uint32_t serial = 0;
+	isc_result_t result;
+
+	result = dns_zone_getdb(zone, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_getsoaserial(db, NULL, &serial);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+	return (serial);
+}
+#endif
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(failqueued);
+ATF_TC_HEAD(failqueued, tc) {
+	atf_tc_set_md_var(tc, "descr", "a transfer that fails with batches "
+				       "queued for the database update stage "
+				       "leaves the zone unchanged after it "
+				       "is reported");
+}
+ATF_TC_BODY(failqueued, tc) {
+#ifdef ISC_PLATFORM_USETHREADS
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_diff_t diff;
+	dns_fixedname_t fixed;
+	dns_name_t *origin;
+	isc_task_t *loadtask = NULL;
+	isc_sockaddr_t addr;
+	struct sockaddr_in sin;
+	socklen_t len;
+	unsigned char soa[22], ns[1];
+	int s, fd;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_condition_init(&cond);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	released = drained = xfrdone = ISC_FALSE;
+
+	result = isc_taskmgr_create(mctx, 1, 0, &loadtaskmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_create(mctx, loadtaskmgr, timermgr, socketmgr,
+				    &loadzonemgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_setsize(loadzonemgr, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * example. at serial 1.
+	 */
+	dns_fixedname_init(&fixed);
+	origin = dns_fixedname_name(&fixed);
+	result = dns_name_fromstring(origin, "example.", 0, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_db_create(mctx, "rbt", origin, dns_dbtype_zone,
+			       dns_rdataclass_in, 0, NULL, &db);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	memset(soa, 0, sizeof(soa));
+	soa[5] = 1;
+	ns[0] = 0;
+	dns_diff_init(mctx, &diff);
+	add_tuple(&diff, origin, dns_rdatatype_soa, soa, sizeof(soa));
+	add_tuple(&diff, origin, dns_rdatatype_ns, ns, sizeof(ns));
+	result = dns_db_newversion(db, &version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_diff_apply(&diff, db, version);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &version, ISC_TRUE);
+	dns_diff_clear(&diff);
+
+	result = dns_test_makezone("example.", &zone, NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_managezone(loadzonemgr, zone);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_replacedb(zone, db, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+	ATF_CHECK_EQ(zone_serial(zone), 1);
+
+	/*
+	 * Hold up the database update stage.
+	 */
+	dns_zone_getloadtask(zone, &loadtask);
+	ATF_REQUIRE(loadtask != NULL);
+	sendevent(loadtask, block);
+
+	/*
+	 * A master on the loopback interface.
+	 */
+	s = socket(AF_INET, SOCK_STREAM, 0);
+	ATF_REQUIRE(s >= 0);
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	ATF_REQUIRE_EQ(bind(s, (struct sockaddr *)&sin, sizeof(sin)), 0);
+	ATF_REQUIRE_EQ(listen(s, 1), 0);
+	len = sizeof(sin);
+	ATF_REQUIRE_EQ(getsockname(s, (struct sockaddr *)&sin, &len), 0);
+	isc_sockaddr_fromin(&addr, &sin.sin_addr, ntohs(sin.sin_port));
+
+	result = dns_xfrin_create(zone, dns_rdatatype_ixfr, &addr, NULL,
+				  mctx, timermgr, socketmgr, maintask,
+				  done, &xfr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	fd = accept(s, NULL, NULL);
+	ATF_REQUIRE(fd >= 0);
+	serve(fd);
+
+	/*
+	 * The failure is reported while the 1 to 2 transaction is queued.
+	 */
+	ATF_REQUIRE(waitfor(&xfrdone));
+	ATF_CHECK_EQ(xfrresult, DNS_R_BADIXFR);
+
+	/*
+	 * Let the update stage run.  The zone must not change.
+	 */
+	sendevent(loadtask, drain);
+	LOCK(&lock);
+	released = ISC_TRUE;
+	BROADCAST(&cond);
+	UNLOCK(&lock);
+	ATF_REQUIRE(waitfor(&drained));
+	ATF_CHECK_EQ(zone_serial(zone), 1);
+
+	close(fd);
+	close(s);
+	isc_task_detach(&loadtask);
+	dns_zonemgr_releasezone(loadzonemgr, zone);
+	dns_zone_detach(&zone);
+	dns_zonemgr_shutdown(loadzonemgr);
+	dns_zonemgr_detach(&loadzonemgr);
+	isc_taskmgr_destroy(&loadtaskmgr);
+	DESTROYLOCK(&lock);
+	(void)isc_condition_destroy(&cond);
+	dns_test_end();
+#else
+	UNUSED(tc);
+#endif
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, failqueued);
+
+	return (atf_no_error());
+}
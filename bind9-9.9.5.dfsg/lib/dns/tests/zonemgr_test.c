@@ -25,13 +25,24 @@
 #include <unistd.h>
 
 #include <isc/buffer.h>
+#include <isc/sockaddr.h>
 #include <isc/task.h>
 #include <isc/timer.h>
 
+#include <dns/db.h>
+#include <dns/dbiterator.h>
+#include <dns/dispatch.h>
+#include <dns/dnssec.h>
+#include <dns/fixedname.h>
 #include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
 
+#include <dst/dst.h>
+
 #include "dnstest.h"
 
 /*
@@ -226,6 +237,224 @@ ATF_TC_BODY(zonemgr_unreachable, tc) {
 	dns_test_end();
 }
 
+ATF_TC(zonemgr_signingworkers);
+ATF_TC_HEAD(zonemgr_signingworkers, tc) {
+	atf_tc_set_md_var(tc, "descr", "set the number of signing workers");
+}
+ATF_TC_BODY(zonemgr_signingworkers, tc) {
+	dns_zonemgr_t *zonemgr = NULL;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
+				    &zonemgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ATF_CHECK_EQ(dns_zonemgr_getsigningworkers(zonemgr), 1);
+
+	result = dns_zonemgr_setsigningworkers(zonemgr, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_zonemgr_getsigningworkers(zonemgr), 4);
+
+	/* Growing and shrinking again must both work. */
+	result = dns_zonemgr_setsigningworkers(zonemgr, 8);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_zonemgr_getsigningworkers(zonemgr), 8);
+
+	result = dns_zonemgr_setsigningworkers(zonemgr, 2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_CHECK_EQ(dns_zonemgr_getsigningworkers(zonemgr), 2);
+
+	dns_zonemgr_shutdown(zonemgr);
+	dns_zonemgr_detach(&zonemgr);
+	ATF_REQUIRE_EQ(zonemgr, NULL);
+
+	dns_test_end();
+}
+
+#ifdef OPENSSL
+/*
+ * Check the signatures of every RRset in 'db' with 'key'.  Return the
+ * number of RRsets that are not signed yet; count those with a
+ * signature that does not verify in '*bad'.
+ */
+static unsigned int
+checksigs(dns_db_t *db, dst_key_t *key, unsigned int *bad) {
+	dns_dbiterator_t *dbiter = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset, sigrdataset;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	unsigned int unsigned_count = 0;
+	isc_result_t result, vresult;
+
+	dns_fixedname_init(&fixed);
+	name = dns_fixedname_name(&fixed);
+	dns_rdataset_init(&rdataset);
+	dns_rdataset_init(&sigrdataset);
+	*bad = 0;
+
+	result = dns_db_createiterator(db, 0, &dbiter);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (result = dns_dbiterator_first(dbiter);
+	     result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		result = dns_dbiterator_current(dbiter, &node, name);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = dns_db_allrdatasets(db, node, NULL, 0, &rdsiter);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			if (rdataset.type == dns_rdatatype_rrsig) {
+				dns_rdataset_disassociate(&rdataset);
+				continue;
+			}
+			result = dns_db_findrdataset(db, node, NULL,
+						     dns_rdatatype_rrsig,
+						     rdataset.type, 0,
+						     &sigrdataset, NULL);
+			if (result != ISC_R_SUCCESS) {
+				unsigned_count++;
+				dns_rdataset_disassociate(&rdataset);
+				continue;
+			}
+			for (result = dns_rdataset_first(&sigrdataset);
+			     result == ISC_R_SUCCESS;
+			     result = dns_rdataset_next(&sigrdataset))
+			{
+				dns_rdata_t sigrdata = DNS_RDATA_INIT;
+
+				dns_rdataset_current(&sigrdataset, &sigrdata);
+				vresult = dns_dnssec_verify(name, &rdataset,
+							    key, ISC_FALSE,
+							    mctx, &sigrdata);
+				if (vresult != ISC_R_SUCCESS)
+					(*bad)++;
+			}
+			dns_rdataset_disassociate(&sigrdataset);
+			dns_rdataset_disassociate(&rdataset);
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(db, &node);
+	}
+	ATF_CHECK_EQ(result, ISC_R_NOMORE);
+	dns_dbiterator_destroy(&dbiter);
+
+	return (unsigned_count);
+}
+#endif
+
+ATF_TC(zonemgr_signbatch);
+ATF_TC_HEAD(zonemgr_signbatch, tc) {
+	atf_tc_set_md_var(tc, "descr", "signatures computed by several "
+				       "signing workers verify");
+}
+ATF_TC_BODY(zonemgr_signbatch, tc) {
+#ifdef OPENSSL
+	dns_zonemgr_t *zonemgr = NULL;
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	dns_dispatch_t *dispatch = NULL;
+	dns_view_t *view = NULL;
+	dns_zone_t *zone = NULL;
+	dns_db_t *db = NULL;
+	dst_key_t *key = NULL;
+	isc_sockaddr_t any;
+	unsigned int attrs, left, bad = 0;
+	int i;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = dns_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_zonemgr_create(mctx, taskmgr, timermgr, socketmgr,
+				    &zonemgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_setsize(zonemgr, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zonemgr_setsigningworkers(zonemgr, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Zone maintenance needs a view with a resolver.
+	 */
+	result = dns_view_create(mctx, dns_rdataclass_in, "view", &view);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_dispatchmgr_create(mctx, NULL, &dispatchmgr);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_sockaddr_any(&any);
+	attrs = DNS_DISPATCHATTR_IPV4 | DNS_DISPATCHATTR_UDP;
+	result = dns_dispatch_getudp(dispatchmgr, socketmgr, taskmgr,
+				     &any, 512, 6, 1024, 17, 19, attrs,
+				     attrs, &dispatch);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_view_createresolver(view, taskmgr, 1, 1, socketmgr,
+					 timermgr, 0, dispatchmgr,
+					 dispatch, NULL);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_makezone("example.com", &zone, view, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_setkeydirectory(zone, "testdata/zonemgr");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_zone_setsignatures(zone, 100);
+	result = dns_zonemgr_managezone(zonemgr, zone);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "example.com",
+				 "testdata/zonemgr/example.com.data");
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = dns_zone_replacedb(zone, db, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	dns_db_detach(&db);
+
+	result = dst_key_fromfile(dns_zone_getorigin(zone), 7065,
+				  DST_ALG_RSASHA1, DST_TYPE_PUBLIC,
+				  "testdata/zonemgr", mctx, &key);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Sign the zone and wait for every RRset to be signed.
+	 */
+	result = dns_zone_signwithkey(zone, DST_ALG_RSASHA1, 7065,
+				      ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 300; i++) {
+		result = dns_zone_getdb(zone, &db);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		left = checksigs(db, key, &bad);
+		dns_db_detach(&db);
+		if (left == 0)
+			break;
+		dns_test_nap(100000);
+	}
+	ATF_CHECK_EQ(left, 0);
+	ATF_CHECK_EQ(bad, 0);
+
+	dst_key_free(&key);
+	dns_zonemgr_releasezone(zonemgr, zone);
+	dns_zone_detach(&zone);
+	dns_zonemgr_shutdown(zonemgr);
+	dns_zonemgr_detach(&zonemgr);
+	dns_view_detach(&view);
+	dns_dispatch_detach(&dispatch);
+	dns_dispatchmgr_destroy(&dispatchmgr);
+
+	dns_test_end();
+#else
+	UNUSED(tc);
+#endif
+}
 
 /*
  * Main
@@ -235,6 +464,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, zonemgr_managezone);
 	ATF_TP_ADD_TC(tp, zonemgr_createzone);
 	ATF_TP_ADD_TC(tp, zonemgr_unreachable);
+	ATF_TP_ADD_TC(tp, zonemgr_signingworkers);
+	ATF_TP_ADD_TC(tp, zonemgr_signbatch);
 	return (atf_no_error());
 }
 
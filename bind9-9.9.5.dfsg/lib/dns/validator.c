@@ -1459,11 +1459,12 @@ isselfsigned(dns_validator_t *val) {
 			if (result != ISC_R_SUCCESS)
 				continue;
 
-			result = dns_dnssec_verify3(name, rdataset, dstkey,
+			result = dns_dnssec_verify4(name, rdataset, dstkey,
 						    ISC_TRUE,
 						    val->view->maxbits,
 						    mctx, &sigrdata,
-						    dns_fixedname_name(&fixed));
+						    dns_fixedname_name(&fixed),
+						    val->view->sigcache);
 			dst_key_free(&dstkey);
 			if (result != ISC_R_SUCCESS)
 				continue;
@@ -1499,9 +1500,10 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	dns_fixedname_init(&fixed);
 	wild = dns_fixedname_name(&fixed);
  again:
-	result = dns_dnssec_verify3(val->event->name, val->event->rdataset,
+	result = dns_dnssec_verify4(val->event->name, val->event->rdataset,
 				    key, ignore, val->view->maxbits,
-				    val->view->mctx, rdata, wild);
+				    val->view->mctx, rdata, wild,
+				    val->view->sigcache);
 	if ((result == DNS_R_SIGEXPIRED || result == DNS_R_SIGFUTURE) &&
 	    val->view->acceptexpired)
 	{
@@ -54,8 +54,10 @@
 #include <dns/rdataset.h>
 #include <dns/request.h>
 #include <dns/resolver.h>
+#include <dns/respcache.h>
 #include <dns/result.h>
 #include <dns/rpz.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 #include <dns/tsig.h>
 #include <dns/zone.h>
@@ -186,9 +188,16 @@ dns_view_create(isc_mem_t *mctx, dns_rdataclass_t rdclass,
 	view->denyanswernames = NULL;
 	view->answernames_exclude = NULL;
 	view->rrl = NULL;
+	view->respcache = NULL;
+	view->sigcache = NULL;
 	view->provideixfr = ISC_TRUE;
 	view->maxcachettl = 7 * 24 * 3600;
 	view->maxncachettl = 3 * 3600;
+	view->prefetch_trigger = 0;
+	view->prefetch_eligible = 0;
+	view->staleanswersok = ISC_FALSE;
+	view->staleanswerttl = 1;
+	view->synthfromdnssec = ISC_TRUE;
 	view->dstport = 53;
 	view->preferred_glue = 0;
 	view->flush = ISC_FALSE;
@@ -336,6 +345,8 @@ destroy(dns_view_t *view) {
 			dns_acache_putdb(view->acache, view->cachedb);
 		dns_acache_detach(&view->acache);
 	}
+	if (view->respcache != NULL)
+		dns_respcache_destroy(&view->respcache);
 	dns_rpz_view_destroy(view);
 #ifdef USE_RRL
 	dns_rrl_view_destroy(view);
@@ -344,6 +355,7 @@ destroy(dns_view_t *view) {
 #endif /* USE_RRL */
 #else /* BIND9 */
 	INSIST(view->acache == NULL);
+	INSIST(view->respcache == NULL);
 	INSIST(ISC_LIST_EMPTY(view->rpz_zones));
 	INSIST(view->rrl == NULL);
 #endif /* BIND9 */
@@ -434,6 +446,8 @@ destroy(dns_view_t *view) {
 		isc_stats_detach(&view->resstats);
 	if (view->resquerystats != NULL)
 		dns_stats_detach(&view->resquerystats);
+	if (view->sigcache != NULL)
+		dns_sigcache_detach(&view->sigcache);
 	if (view->secroots_priv != NULL)
 		dns_keytable_detach(&view->secroots_priv);
 #ifdef BIND9
@@ -511,6 +525,8 @@ view_flushanddetach(dns_view_t **viewp, isc_boolean_t flush) {
 #ifdef BIND9
 		if (view->acache != NULL)
 			dns_acache_shutdown(view->acache);
+		if (view->respcache != NULL)
+			dns_respcache_flush(view->respcache);
 		if (view->flush)
 			dns_zt_flushanddetach(&view->zonetable);
 		else
@@ -1782,6 +1798,17 @@ dns_view_getresquerystats(dns_view_t *view, dns_stats_t **statsp) {
 		dns_stats_attach(view->resquerystats, statsp);
 }
 
+void
+dns_view_setsigcache(dns_view_t *view, dns_sigcache_t *cache) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+
+	if (view->sigcache != NULL)
+		dns_sigcache_detach(&view->sigcache);
+	if (cache != NULL)
+		dns_sigcache_attach(cache, &view->sigcache);
+}
+
 isc_result_t
 dns_view_initsecroots(dns_view_t *view, isc_mem_t *mctx) {
 	REQUIRE(DNS_VIEW_VALID(view));
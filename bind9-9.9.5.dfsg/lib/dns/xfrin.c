@@ -29,6 +29,7 @@
 #include <isc/timer.h>
 #include <isc/util.h>
 
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/diff.h>
 #include <dns/events.h>
@@ -88,6 +89,31 @@ typedef enum {
 	XFRST_AXFR_END
 } xfrin_state_t;
 
+/*%
+ * Received records are handed to the database update stage in batches
+ * of up to XFRIN_BATCH tuples.  Reading from the master is paused while
+ * XFRIN_MAXLOADS batches are waiting to be applied.
+ */
+#define XFRIN_BATCH		2048
+#define XFRIN_MAXLOADS		4
+
+/*%
+ * What the database update stage is to do with a batch.
+ */
+typedef enum {
+	xfrin_load_axfr,		/*%< Add to the new database */
+	xfrin_load_axfrend,		/*%< Add, then end the load */
+	xfrin_load_ixfr,		/*%< Apply and journal */
+	xfrin_load_ixfrcommit		/*%< Apply, journal and commit */
+} xfrin_loadop_t;
+
+typedef struct xfrin_loadevent {
+	ISC_EVENT_COMMON(struct xfrin_loadevent);
+	xfrin_loadop_t		op;
+	dns_diff_t		diff;
+	isc_result_t		result;
+} xfrin_loadevent_t;
+
 /*%
  * Incoming zone transfer context.
  */
@@ -100,12 +126,16 @@ struct dns_xfrin_ctx {
 	int			refcount;
 
 	isc_task_t 		*task;
+	isc_task_t 		*loadtask;	/*%< Database update stage */
 	isc_timer_t		*timer;
 	isc_socketmgr_t 	*socketmgr;
 
 	int			connects; 	/*%< Connect in progress */
 	int			sends;		/*%< Send in progress */
 	int			recvs;	  	/*%< Receive in progress */
+	int			loads;		/*%< Batches being applied */
+	isc_boolean_t		paused;		/*%< Reading waits for loads */
+	isc_boolean_t		restart;	/*%< AXFR retry waits for loads */
 	isc_boolean_t		shuttingdown;
 
 	dns_name_t 		name; 		/*%< Name of zone to transfer */
@@ -137,6 +167,8 @@ struct dns_xfrin_ctx {
 	dns_dbversion_t 	*ver;
 	dns_diff_t 		diff;		/*%< Pending database changes */
 	int 			difflen;	/*%< Number of pending tuples */
+	isc_result_t		loadresult;	/*%< Update stage result */
+	isc_result_t		failresult;	/*%< Reported once loads end */
 
 	xfrin_state_t 		state;
 	isc_uint32_t 		end_serial;
@@ -161,10 +193,7 @@ struct dns_xfrin_ctx {
 	 * but keeping them separate makes it a bit simpler to clean
 	 * things up when destroying the context.
 	 */
-	struct {
-		dns_addrdatasetfunc_t add_func;
-		dns_dbload_t	      *add_private;
-	} axfr;
+	dns_rdatacallbacks_t	axfr;
 
 	struct {
 		isc_uint32_t 	request_serial;
@@ -213,10 +242,17 @@ static isc_result_t ixfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 				 dns_rdata_t *rdata);
 static isc_result_t ixfr_commit(dns_xfrin_ctx_t *xfr);
 
+static isc_result_t xfrin_sendload(dns_xfrin_ctx_t *xfr, xfrin_loadop_t op);
+static void xfrin_load(isc_task_t *task, isc_event_t *event);
+static void xfrin_loaddone(isc_task_t *task, isc_event_t *event);
+static void xfrin_loadfree(isc_event_t *event);
+
 static isc_result_t xfr_rr(dns_xfrin_ctx_t *xfr, dns_name_t *name,
 			   isc_uint32_t ttl, dns_rdata_t *rdata);
 
 static isc_result_t xfrin_start(dns_xfrin_ctx_t *xfr);
+static void xfrin_retryaxfr(dns_xfrin_ctx_t *xfr);
+static isc_result_t xfrin_finish(dns_xfrin_ctx_t *xfr);
 
 static void xfrin_connect_done(isc_task_t *task, isc_event_t *event);
 static isc_result_t xfrin_send_request(dns_xfrin_ctx_t *xfr);
@@ -228,6 +264,7 @@ static void maybe_free(dns_xfrin_ctx_t *xfr);
 
 static void
 xfrin_fail(dns_xfrin_ctx_t *xfr, isc_result_t result, const char *msg);
+static void xfrin_faildone(dns_xfrin_ctx_t *xfr);
 static isc_result_t
 render(dns_message_t *msg, isc_mem_t *mctx, isc_buffer_t *buf);
 
@@ -260,8 +297,8 @@ axfr_init(dns_xfrin_ctx_t *xfr) {
 		dns_db_detach(&xfr->db);
 
 	CHECK(axfr_makedb(xfr, &xfr->db));
-	CHECK(dns_db_beginload(xfr->db, &xfr->axfr.add_func,
-			       &xfr->axfr.add_private));
+	dns_rdatacallbacks_init(&xfr->axfr);
+	CHECK(dns_db_beginload(xfr->db, &xfr->axfr));
 	result = ISC_R_SUCCESS;
  failure:
 	return (result);
@@ -295,7 +332,7 @@ axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op,
 				   name, ttl, rdata, &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100)
+	if (++xfr->difflen >= XFRIN_BATCH)
 		CHECK(axfr_apply(xfr));
 	result = ISC_R_SUCCESS;
  failure:
@@ -307,27 +344,12 @@ axfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
  */
 static isc_result_t
 axfr_apply(dns_xfrin_ctx_t *xfr) {
-	isc_result_t result;
-
-	CHECK(dns_diff_load(&xfr->diff,
-			    xfr->axfr.add_func, xfr->axfr.add_private));
-	xfr->difflen = 0;
-	dns_diff_clear(&xfr->diff);
-	result = ISC_R_SUCCESS;
- failure:
-	return (result);
+	return (xfrin_sendload(xfr, xfrin_load_axfr));
 }
 
 static isc_result_t
 axfr_commit(dns_xfrin_ctx_t *xfr) {
-	isc_result_t result;
-
-	CHECK(axfr_apply(xfr));
-	CHECK(dns_db_endload(xfr->db, &xfr->axfr.add_private));
-
-	result = ISC_R_SUCCESS;
- failure:
-	return (result);
+	return (xfrin_sendload(xfr, xfrin_load_axfrend));
 }
 
 static isc_result_t
@@ -383,7 +405,7 @@ ixfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 	CHECK(dns_difftuple_create(xfr->diff.mctx, op,
 				   name, ttl, rdata, &tuple));
 	dns_diff_append(&xfr->diff, &tuple);
-	if (++xfr->difflen > 100)
+	if (++xfr->difflen >= XFRIN_BATCH)
 		CHECK(ixfr_apply(xfr));
 	result = ISC_R_SUCCESS;
  failure:
@@ -391,45 +413,195 @@ ixfr_putdata(dns_xfrin_ctx_t *xfr, dns_diffop_t op,
 }
 
 /*
- * Apply a set of IXFR changes to the database.
+ * Apply a set of IXFR changes to the database.  Changes are normally
+ * sent once per transaction; only very large transactions are split.
  */
 static isc_result_t
 ixfr_apply(dns_xfrin_ctx_t *xfr) {
+	return (xfrin_sendload(xfr, xfrin_load_ixfr));
+}
+
+static isc_result_t
+ixfr_commit(dns_xfrin_ctx_t *xfr) {
+	return (xfrin_sendload(xfr, xfrin_load_ixfrcommit));
+}
+
+/**************************************************************************/
+/*
+ * Database update stage
+ *
+ * Parsing, TSIG verification and the transfer state machine run on
+ * xfr->task.  The resulting changes are written to the database and
+ * journal on the zone's load task, so that the next message is read
+ * and parsed while the previous one is being stored.  The update stage
+ * owns xfr->ver, xfr->axfr and xfr->ixfr.journal while xfr->loads is
+ * nonzero; xfr->task only touches them when no batch is outstanding.
+ */
+
+static isc_result_t
+load_diff(dns_xfrin_ctx_t *xfr, xfrin_loadop_t op, dns_diff_t *diff) {
 	isc_result_t result;
 
-	if (xfr->ver == NULL) {
-		CHECK(dns_db_newversion(xfr->db, &xfr->ver));
+	switch (op) {
+	case xfrin_load_axfr:
+	case xfrin_load_axfrend:
+		CHECK(dns_diff_load(diff, xfr->axfr.add,
+				    xfr->axfr.add_private));
+		if (op == xfrin_load_axfrend)
+			CHECK(dns_db_endload(xfr->db, &xfr->axfr));
+		break;
+	case xfrin_load_ixfr:
+	case xfrin_load_ixfrcommit:
+		if (xfr->ver == NULL) {
+			CHECK(dns_db_newversion(xfr->db, &xfr->ver));
+			if (xfr->ixfr.journal != NULL)
+				CHECK(dns_journal_begin_transaction(
+							xfr->ixfr.journal));
+		}
+		CHECK(dns_diff_apply(diff, xfr->db, xfr->ver));
 		if (xfr->ixfr.journal != NULL)
-			CHECK(dns_journal_begin_transaction(xfr->ixfr.journal));
-	}
-	CHECK(dns_diff_apply(&xfr->diff, xfr->db, xfr->ver));
-	if (xfr->ixfr.journal != NULL) {
-		result = dns_journal_writediff(xfr->ixfr.journal, &xfr->diff);
-		if (result != ISC_R_SUCCESS)
-			goto failure;
+			CHECK(dns_journal_writediff(xfr->ixfr.journal, diff));
+		if (op == xfrin_load_ixfrcommit) {
+			/* XXX enter ready-to-commit state here */
+			if (xfr->ixfr.journal != NULL)
+				CHECK(dns_journal_commit(xfr->ixfr.journal));
+			dns_db_closeversion(xfr->db, &xfr->ver, ISC_TRUE);
+			dns_zone_markdirty(xfr->zone);
+		}
+		break;
+	default:
+		INSIST(0);
 	}
-	dns_diff_clear(&xfr->diff);
-	xfr->difflen = 0;
 	result = ISC_R_SUCCESS;
  failure:
+	dns_diff_clear(diff);
 	return (result);
 }
 
+/*
+ * Hand the pending changes in xfr->diff to the database update stage.
+ * Zones without a load task apply them immediately.
+ */
 static isc_result_t
-ixfr_commit(dns_xfrin_ctx_t *xfr) {
+xfrin_sendload(dns_xfrin_ctx_t *xfr, xfrin_loadop_t op) {
+	xfrin_loadevent_t *lev;
+	isc_event_t *event;
+
+	xfr->difflen = 0;
+	if (xfr->loadtask == NULL)
+		return (load_diff(xfr, op, &xfr->diff));
+
+	event = isc_event_allocate(xfr->mctx, xfr, DNS_EVENT_XFRINLOAD,
+				   xfrin_load, xfr, sizeof(xfrin_loadevent_t));
+	if (event == NULL)
+		return (ISC_R_NOMEMORY);
+	event->ev_destroy = xfrin_loadfree;
+	lev = (xfrin_loadevent_t *)event;
+	lev->op = op;
+	lev->result = ISC_R_UNSET;
+	dns_diff_init(xfr->mctx, &lev->diff);
+	ISC_LIST_APPENDLIST(lev->diff.tuples, xfr->diff.tuples, link);
+
+	xfr->loads++;
+	isc_task_send(xfr->loadtask, &event);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Free a batch, including one purged before it was applied.
+ */
+static void
+xfrin_loadfree(isc_event_t *event) {
+	xfrin_loadevent_t *lev = (xfrin_loadevent_t *)event;
+	isc_mem_t *mctx = event->ev_destroy_arg;
+
+	dns_diff_clear(&lev->diff);
+	isc_mem_put(mctx, event, event->ev_size);
+}
+
+/*
+ * Apply one batch on the load task.  Once a batch fails the rest are
+ * discarded, so that a later commit cannot store a partial transaction.
+ */
+static void
+xfrin_load(isc_task_t *task, isc_event_t *event) {
+	xfrin_loadevent_t *lev = (xfrin_loadevent_t *)event;
+	dns_xfrin_ctx_t *xfr = event->ev_arg;
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == DNS_EVENT_XFRINLOAD);
+
+	if (xfr->loadresult == ISC_R_SUCCESS)
+		xfr->loadresult = load_diff(xfr, lev->op, &lev->diff);
+	else
+		dns_diff_clear(&lev->diff);
+	lev->result = xfr->loadresult;
+
+	event->ev_action = xfrin_loaddone;
+	isc_task_send(xfr->task, &event);
+}
+
+/*
+ * A batch has been applied; back on xfr->task.
+ */
+static void
+xfrin_loaddone(isc_task_t *task, isc_event_t *event) {
+	xfrin_loadevent_t *lev = (xfrin_loadevent_t *)event;
+	dns_xfrin_ctx_t *xfr = event->ev_arg;
 	isc_result_t result;
 
-	CHECK(ixfr_apply(xfr));
-	if (xfr->ver != NULL) {
-		/* XXX enter ready-to-commit state here */
-		if (xfr->ixfr.journal != NULL)
-			CHECK(dns_journal_commit(xfr->ixfr.journal));
-		dns_db_closeversion(xfr->db, &xfr->ver, ISC_TRUE);
-		dns_zone_markdirty(xfr->zone);
+	REQUIRE(VALID_XFRIN(xfr));
+
+	UNUSED(task);
+
+	INSIST(event->ev_type == DNS_EVENT_XFRINLOAD);
+	result = lev->result;
+	isc_event_free(&event);
+
+	INSIST(xfr->loads > 0);
+	if (xfr->shuttingdown) {
+		/*
+		 * The transfer has failed.  Report it once the last batch
+		 * is out of the update stage; this batch is still counted,
+		 * so the callback cannot free xfr.
+		 */
+		if (xfr->loads == 1)
+			xfrin_faildone(xfr);
+		xfr->loads--;
+		maybe_free(xfr);
+		return;
 	}
-	result = ISC_R_SUCCESS;
+	xfr->loads--;
+
+	CHECK(result);
+	CHECK(isc_timer_touch(xfr->timer));
+
+	if (xfr->restart) {
+		if (xfr->loads == 0)
+			xfrin_retryaxfr(xfr);
+		return;
+	}
+
+	switch (xfr->state) {
+	case XFRST_AXFR_END:
+	case XFRST_IXFR_END:
+		if (xfr->loads == 0)
+			CHECK(xfrin_finish(xfr));
+		break;
+	default:
+		if (xfr->paused && xfr->loads < XFRIN_MAXLOADS) {
+			xfr->paused = ISC_FALSE;
+			CHECK(dns_tcpmsg_readmessage(&xfr->tcpmsg, xfr->task,
+						     xfrin_recv_done, xfr));
+			xfr->recvs++;
+		}
+		break;
+	}
+	return;
+
  failure:
-	return (result);
+	xfrin_fail(xfr, result, "failed while applying changes");
 }
 
 /**************************************************************************/
@@ -724,13 +896,16 @@ xfrin_reset(dns_xfrin_ctx_t *xfr) {
 	dns_diff_clear(&xfr->diff);
 	xfr->difflen = 0;
 
+	INSIST(xfr->loads == 0);
+	xfr->loadresult = ISC_R_SUCCESS;
+	xfr->paused = ISC_FALSE;
+	xfr->restart = ISC_FALSE;
+
 	if (xfr->ixfr.journal != NULL)
 		dns_journal_destroy(&xfr->ixfr.journal);
 
-	if (xfr->axfr.add_private != NULL) {
-		(void)dns_db_endload(xfr->db, &xfr->axfr.add_private);
-		xfr->axfr.add_func = NULL;
-	}
+	if (xfr->axfr.add_private != NULL)
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
 
 	if (xfr->tcpmsg_valid) {
 		dns_tcpmsg_invalidate(&xfr->tcpmsg);
@@ -753,16 +928,35 @@ xfrin_fail(dns_xfrin_ctx_t *xfr, isc_result_t result, const char *msg) {
 	}
 	xfrin_cancelio(xfr);
 	/*
-	 * Close the journal.
+	 * Discard the batches the database update stage has not started.
+	 * If it is applying one, the caller is told of the failure only
+	 * when that is done, so that the zone does not change afterwards.
 	 */
+	if (xfr->loads > 0)
+		xfr->loads -= isc_task_purgerange(xfr->loadtask, xfr,
+						  DNS_EVENT_XFRINLOAD,
+						  DNS_EVENT_XFRINLOAD, NULL);
+	if (! xfr->shuttingdown)
+		xfr->failresult = result;
+	if (xfr->loads == 0)
+		xfrin_faildone(xfr);
+	xfr->shuttingdown = ISC_TRUE;
+	maybe_free(xfr);
+}
+
+/*
+ * Close the journal and report a failed transfer to the caller.
+ */
+static void
+xfrin_faildone(dns_xfrin_ctx_t *xfr) {
+	INSIST(xfr->loads <= 1);
+
 	if (xfr->ixfr.journal != NULL)
 		dns_journal_destroy(&xfr->ixfr.journal);
 	if (xfr->done != NULL) {
-		(xfr->done)(xfr->zone, result);
+		(xfr->done)(xfr->zone, xfr->failresult);
 		xfr->done = NULL;
 	}
-	xfr->shuttingdown = ISC_TRUE;
-	maybe_free(xfr);
 }
 
 static isc_result_t
@@ -794,6 +988,8 @@ xfrin_create(isc_mem_t *mctx,
 	dns_zone_iattach(zone, &xfr->zone);
 	xfr->task = NULL;
 	isc_task_attach(task, &xfr->task);
+	xfr->loadtask = NULL;
+	dns_zone_getloadtask(zone, &xfr->loadtask);
 	xfr->timer = NULL;
 	xfr->socketmgr = socketmgr;
 	xfr->done = NULL;
@@ -801,6 +997,9 @@ xfrin_create(isc_mem_t *mctx,
 	xfr->connects = 0;
 	xfr->sends = 0;
 	xfr->recvs = 0;
+	xfr->loads = 0;
+	xfr->paused = ISC_FALSE;
+	xfr->restart = ISC_FALSE;
 	xfr->shuttingdown = ISC_FALSE;
 
 	dns_name_init(&xfr->name, NULL);
@@ -823,6 +1022,8 @@ xfrin_create(isc_mem_t *mctx,
 	xfr->ver = NULL;
 	dns_diff_init(xfr->mctx, &xfr->diff);
 	xfr->difflen = 0;
+	xfr->loadresult = ISC_R_SUCCESS;
+	xfr->failresult = ISC_R_UNSET;
 
 	if (reqtype == dns_rdatatype_soa)
 		xfr->state = XFRST_SOAQUERY;
@@ -847,8 +1048,7 @@ xfrin_create(isc_mem_t *mctx,
 	/* ixfr.current_serial */
 	xfr->ixfr.journal = NULL;
 
-	xfr->axfr.add_func = NULL;
-	xfr->axfr.add_private = NULL;
+	dns_rdatacallbacks_init(&xfr->axfr);
 
 	CHECK(dns_name_dup(zonename, mctx, &xfr->name));
 
@@ -884,6 +1084,8 @@ xfrin_create(isc_mem_t *mctx,
 		dns_tsigkey_detach(&xfr->tsigkey);
 	if (xfr->db != NULL)
 		dns_db_detach(&xfr->db);
+	if (xfr->loadtask != NULL)
+		isc_task_detach(&xfr->loadtask);
 	isc_task_detach(&xfr->task);
 	dns_zone_idetach(&xfr->zone);
 	isc_mem_putanddetach(&xfr->mctx, xfr, sizeof(*xfr));
@@ -1230,10 +1432,15 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		       isc_result_totext(result));
  try_axfr:
 		dns_message_destroy(&msg);
-		xfrin_reset(xfr);
-		xfr->reqtype = dns_rdatatype_soa;
-		xfr->state = XFRST_SOAQUERY;
-		(void)xfrin_start(xfr);
+		if (xfr->loads > 0) {
+			/*
+			 * Retry once the changes already sent to the
+			 * database update stage have been dealt with.
+			 */
+			xfr->restart = ISC_TRUE;
+			return;
+		}
+		xfrin_retryaxfr(xfr);
 		return;
 	}
 
@@ -1344,33 +1551,23 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		CHECK(xfrin_send_request(xfr));
 		break;
 	case XFRST_AXFR_END:
-		CHECK(axfr_finalize(xfr));
-		/* FALLTHROUGH */
 	case XFRST_IXFR_END:
 		/*
-		 * Close the journal.
-		 */
-		if (xfr->ixfr.journal != NULL)
-			dns_journal_destroy(&xfr->ixfr.journal);
-
-		/*
-		 * Inform the caller we succeeded.
-		 */
-		if (xfr->done != NULL) {
-			(xfr->done)(xfr->zone, ISC_R_SUCCESS);
-			xfr->done = NULL;
-		}
-		/*
-		 * We should have no outstanding events at this
-		 * point, thus maybe_free() should succeed.
+		 * Otherwise xfrin_loaddone() finishes the transfer once
+		 * the last batch has been applied.
 		 */
-		xfr->shuttingdown = ISC_TRUE;
-		maybe_free(xfr);
+		if (xfr->loads == 0)
+			CHECK(xfrin_finish(xfr));
 		break;
 	default:
 		/*
-		 * Read the next message.
+		 * Read the next message, unless the database update
+		 * stage has fallen too far behind.
 		 */
+		if (xfr->loads >= XFRIN_MAXLOADS) {
+			xfr->paused = ISC_TRUE;
+			break;
+		}
 		CHECK(dns_tcpmsg_readmessage(&xfr->tcpmsg, xfr->task,
 					     xfrin_recv_done, xfr));
 		xfr->recvs++;
@@ -1384,6 +1581,54 @@ xfrin_recv_done(isc_task_t *task, isc_event_t *ev) {
 		xfrin_fail(xfr, result, "failed while receiving responses");
 }
 
+/*
+ * Restart the transfer as a SOA query followed by AXFR.
+ */
+static void
+xfrin_retryaxfr(dns_xfrin_ctx_t *xfr) {
+	xfrin_reset(xfr);
+	xfr->reqtype = dns_rdatatype_soa;
+	xfr->state = XFRST_SOAQUERY;
+	(void)xfrin_start(xfr);
+}
+
+/*
+ * All changes have been stored; install the new database if this
+ * was an AXFR and report success.
+ */
+static isc_result_t
+xfrin_finish(dns_xfrin_ctx_t *xfr) {
+	isc_result_t result;
+
+	INSIST(xfr->loads == 0);
+
+	if (xfr->state == XFRST_AXFR_END)
+		CHECK(axfr_finalize(xfr));
+
+	/*
+	 * Close the journal.
+	 */
+	if (xfr->ixfr.journal != NULL)
+		dns_journal_destroy(&xfr->ixfr.journal);
+
+	/*
+	 * Inform the caller we succeeded.
+	 */
+	if (xfr->done != NULL) {
+		(xfr->done)(xfr->zone, ISC_R_SUCCESS);
+		xfr->done = NULL;
+	}
+	/*
+	 * We should have no outstanding events at this
+	 * point, thus maybe_free() should succeed.
+	 */
+	xfr->shuttingdown = ISC_TRUE;
+	maybe_free(xfr);
+	result = ISC_R_SUCCESS;
+ failure:
+	return (result);
+}
+
 static void
 xfrin_timeout(isc_task_t *task, isc_event_t *event) {
 	dns_xfrin_ctx_t *xfr = (dns_xfrin_ctx_t *) event->ev_arg;
@@ -1408,7 +1653,7 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 
 	if (! xfr->shuttingdown || xfr->refcount != 0 ||
 	    xfr->connects != 0 || xfr->sends != 0 ||
-	    xfr->recvs != 0)
+	    xfr->recvs != 0 || xfr->loads != 0)
 		return;
 
 	/*
@@ -1437,6 +1682,9 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 	if (xfr->task != NULL)
 		isc_task_detach(&xfr->task);
 
+	if (xfr->loadtask != NULL)
+		isc_task_detach(&xfr->loadtask);
+
 	if (xfr->tsigkey != NULL)
 		dns_tsigkey_detach(&xfr->tsigkey);
 
@@ -1449,7 +1697,7 @@ maybe_free(dns_xfrin_ctx_t *xfr) {
 		dns_journal_destroy(&xfr->ixfr.journal);
 
 	if (xfr->axfr.add_private != NULL)
-		(void)dns_db_endload(xfr->db, &xfr->axfr.add_private);
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
 
 	if (xfr->tcpmsg_valid)
 		dns_tcpmsg_invalidate(&xfr->tcpmsg);
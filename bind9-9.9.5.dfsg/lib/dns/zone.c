@@ -22,6 +22,7 @@
 #include <config.h>
 #include <errno.h>
 
+#include <isc/condition.h>
 #include <isc/file.h>
 #include <isc/hex.h>
 #include <isc/mutex.h>
@@ -152,6 +153,7 @@ typedef struct dns_nsec3chain dns_nsec3chain_t;
 typedef ISC_LIST(dns_nsec3chain_t) dns_nsec3chainlist_t;
 typedef struct dns_keyfetch dns_keyfetch_t;
 typedef struct dns_asyncload dns_asyncload_t;
+typedef struct dns_signbatch dns_signbatch_t;
 
 #define DNS_ZONE_CHECKLOCK
 #ifdef DNS_ZONE_CHECKLOCK
@@ -262,6 +264,7 @@ struct dns_zone {
 	isc_sockaddr_t		notifyfrom;
 	isc_task_t		*task;
 	isc_task_t		*loadtask;
+	dns_asyncload_t		*asyncload;	/*%< initial load in progress */
 	isc_sockaddr_t		notifysrc4;
 	isc_sockaddr_t		notifysrc6;
 	isc_sockaddr_t		xfrsource4;
@@ -376,6 +379,14 @@ struct dns_zone {
 	 */
 	dns_forwardlist_t	forwards;
 
+	/*%
+	 * Dynamic updates waiting to be group committed, and whether
+	 * a batch of them is being processed.
+	 */
+	isc_boolean_t		groupcommit;
+	isc_boolean_t		updating;
+	isc_eventlist_t		updates;
+
 	dns_zone_t		*raw;
 	dns_zone_t		*secure;
 
@@ -478,6 +489,7 @@ struct dns_zonemgr {
 	isc_socketmgr_t *	socketmgr;
 	isc_taskpool_t *	zonetasks;
 	isc_taskpool_t *	loadtasks;
+	isc_taskpool_t *	signtasks;	/* Locked by rwlock */
 	isc_task_t *		task;
 	isc_pool_t *		mctxpool;
 	isc_ratelimiter_t *	notifyrl;
@@ -495,6 +507,7 @@ struct dns_zonemgr {
 	isc_uint32_t		transfersin;
 	isc_uint32_t		transfersperns;
 	unsigned int		serialqueryrate;
+	unsigned int		signworkers;	/* Locked by rwlock */
 
 	/* Locked by iolock */
 	isc_uint32_t		iolimit;
@@ -549,6 +562,7 @@ struct dns_load {
 	dns_db_t		*db;
 	isc_time_t		loadtime;
 	dns_rdatacallbacks_t	callbacks;
+	dns_asyncload_t		*asyncload;
 };
 
 /*%
@@ -681,6 +695,7 @@ static void zone_shutdown(isc_task_t *, isc_event_t *);
 static void zone_loaddone(void *arg, isc_result_t result);
 static isc_result_t zone_startload(dns_db_t *db, dns_zone_t *zone,
 				   isc_time_t loadtime);
+static void zone_asyncloaded(dns_asyncload_t *asl, isc_task_t *task);
 static void zone_namerd_tostr(dns_zone_t *zone, char *buf, size_t length);
 static void zone_name_tostr(dns_zone_t *zone, char *buf, size_t length);
 static void zone_rdclass_tostr(dns_zone_t *zone, char *buf, size_t length);
@@ -887,6 +902,7 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->notifycnt = 0;
 	zone->task = NULL;
 	zone->loadtask = NULL;
+	zone->asyncload = NULL;
 	zone->update_acl = NULL;
 	zone->forward_acl = NULL;
 	zone->notify_acl = NULL;
@@ -942,6 +958,9 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx) {
 	zone->added = ISC_FALSE;
 	zone->is_rpz = ISC_FALSE;
 	ISC_LIST_INIT(zone->forwards);
+	zone->groupcommit = ISC_FALSE;
+	zone->updating = ISC_FALSE;
+	ISC_LIST_INIT(zone->updates);
 	zone->raw = NULL;
 	zone->secure = NULL;
 	zone->sourceserial = 0;
@@ -1761,6 +1780,8 @@ static void
 zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	dns_asyncload_t *asl = event->ev_arg;
 	dns_zone_t *zone = asl->zone;
+	dns_zone_t *self = NULL;
+	isc_boolean_t pending;
 	isc_result_t result = ISC_R_SUCCESS;
 
 	UNUSED(task);
@@ -1774,8 +1795,37 @@ zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING))
 		goto cleanup;
 
+	/*
+	 * If zone_startload() takes 'asl' the load carries on in the
+	 * background, and zone_loaddone() finishes it.  Hold a reference
+	 * of our own as that may happen before we look again.
+	 */
+	dns_zone_iattach(zone, &self);
+	LOCK_ZONE(zone);
+	zone->asyncload = asl;
+	UNLOCK_ZONE(zone);
+
 	zone_load(zone, 0);
 
+	LOCK_ZONE(zone);
+	pending = ISC_TF(zone->asyncload == asl);
+	zone->asyncload = NULL;
+	UNLOCK_ZONE(zone);
+	dns_zone_idetach(&self);
+
+	if (pending)
+		zone_asyncloaded(asl, task);
+	return;
+
+ cleanup:
+	isc_mem_put(zone->mctx, asl, sizeof (*asl));
+	dns_zone_idetach(&zone);
+}
+
+static void
+zone_asyncloaded(dns_asyncload_t *asl, isc_task_t *task) {
+	dns_zone_t *zone = asl->zone;
+
 	LOCK_ZONE(zone);
 	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_LOADPENDING);
 	UNLOCK_ZONE(zone);
@@ -1784,7 +1834,6 @@ zone_asyncload(isc_task_t *task, isc_event_t *event) {
 	if (asl->loaded != NULL)
 		(asl->loaded)(asl->loaded_arg, zone, task);
 
- cleanup:
 	isc_mem_put(zone->mctx, asl, sizeof (*asl));
 	dns_zone_idetach(&zone);
 }
@@ -1911,14 +1960,15 @@ zone_gotreadhandle(isc_task_t *task, isc_event_t *event) {
 
 	options = get_master_options(load->zone);
 
-	result = dns_master_loadfileinc3(load->zone->masterfile,
+	result = dns_master_loadfileinc4(load->zone->masterfile,
 					 dns_db_origin(load->db),
 					 dns_db_origin(load->db),
 					 load->zone->rdclass, options, 0,
 					 &load->callbacks, task,
 					 zone_loaddone, load,
 					 &load->zone->lctx, load->zone->mctx,
-					 load->zone->masterformat);
+					 load->zone->masterformat,
+					 load->zone->zmgr->loadtasks);
 	if (result != ISC_R_SUCCESS && result != DNS_R_CONTINUE &&
 	    result != DNS_R_SEENINCLUDE)
 		goto fail;
@@ -2032,7 +2082,12 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 	if (DNS_ZONE_OPTION(zone, DNS_ZONEOPT_MANYERRORS))
 		options |= DNS_MASTER_MANYERRORS;
 
-	if (zone->zmgr != NULL && zone->db != NULL && zone->loadtask != NULL) {
+	/*
+	 * Reloads, and initial loads started by dns_zone_asyncload(),
+	 * are done incrementally on the zone's load task.
+	 */
+	if (zone->zmgr != NULL && zone->loadtask != NULL &&
+	    (zone->db != NULL || zone->asyncload != NULL)) {
 		load = isc_mem_get(zone->mctx, sizeof(*load));
 		if (load == NULL)
 			return (ISC_R_NOMEMORY);
@@ -2041,6 +2096,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		load->zone = NULL;
 		load->db = NULL;
 		load->loadtime = loadtime;
+		load->asyncload = NULL;
 		load->magic = LOAD_MAGIC;
 
 		isc_mem_attach(zone->mctx, &load->mctx);
@@ -2049,8 +2105,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 		dns_rdatacallbacks_init(&load->callbacks);
 		load->callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &load->callbacks.zone);
-		result = dns_db_beginload(db, &load->callbacks.add,
-					  &load->callbacks.add_private);
+		result = dns_db_beginload(db, &load->callbacks);
 		if (result != ISC_R_SUCCESS)
 			goto cleanup;
 		result = zonemgr_getio(zone->zmgr, ISC_TRUE, zone->loadtask,
@@ -2061,19 +2116,19 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 			 * We can't report multiple errors so ignore
 			 * the result of dns_db_endload().
 			 */
-			(void)dns_db_endload(load->db,
-					     &load->callbacks.add_private);
+			(void)dns_db_endload(load->db, &load->callbacks);
 			goto cleanup;
 		} else
 			result = DNS_R_CONTINUE;
+		load->asyncload = zone->asyncload;
+		zone->asyncload = NULL;
 	} else {
 		dns_rdatacallbacks_t callbacks;
 
 		dns_rdatacallbacks_init(&callbacks);
 		callbacks.rawdata = zone_setrawdata;
 		zone_iattach(zone, &callbacks.zone);
-		result = dns_db_beginload(db, &callbacks.add,
-					  &callbacks.add_private);
+		result = dns_db_beginload(db, &callbacks);
 		if (result != ISC_R_SUCCESS) {
 			zone_idetach(&callbacks.zone);
 			return (result);
@@ -2083,7 +2138,7 @@ zone_startload(dns_db_t *db, dns_zone_t *zone, isc_time_t loadtime) {
 					      zone->rdclass, options, 0,
 					      &callbacks, zone->mctx,
 					      zone->masterformat);
-		tresult = dns_db_endload(db, &callbacks.add_private);
+		tresult = dns_db_endload(db, &callbacks);
 		if (result == ISC_R_SUCCESS)
 			result = tresult;
 		zone_idetach(&callbacks.zone);
@@ -5544,12 +5599,340 @@ del_sigs(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	return (result);
 }
 
+/*%
+ * Signatures are generated in batches.  The zone task queues the RRsets
+ * to be signed with signbatch_add(), and signbatch_flush() signs them on
+ * the zone task and, when the zone manager has more than one signing
+ * worker, on tasks from its signing task pool at the same time.  The
+ * RRSIGs are then added to the version in the order they were queued.
+ *
+ * The zone task only ever waits for jobs that a helper has already
+ * taken, so helpers speed things up when worker threads are idle but
+ * are never needed for progress.  A helper whose event runs late finds
+ * nothing left to do; the batch is reference counted so that it can
+ * still look.
+ */
+#define SIGNBATCH_SIZE 64
+
+typedef struct dns_signjob {
+	dns_fixedname_t		name;
+	dns_rdataset_t		rdataset;
+	dst_key_t		*key;
+	isc_stdtime_t		expire;
+	isc_result_t		result;
+	dns_rdata_t		rdata;
+	unsigned char		data[1024]; /* XXX */
+} dns_signjob_t;
+
+struct dns_signbatch {
+	isc_mem_t		*mctx;
+	dns_zone_t		*zone;
+	dns_db_t		*db;
+	dns_dbversion_t		*version;
+	dns_diff_t		*diff;
+	isc_stdtime_t		inception;
+	isc_uint32_t		spread;
+	isc_mutex_t		lock;
+	isc_condition_t		cond;
+	/* Locked by lock. */
+	unsigned int		refs;
+	unsigned int		helpers;	/* helper events not yet run */
+	unsigned int		running;	/* jobs being signed by helpers */
+	unsigned int		next;		/* first job not yet taken */
+	unsigned int		count;
+	dns_signjob_t		jobs[SIGNBATCH_SIZE];
+};
+
+static void
+signbatch_free(dns_signbatch_t *batch) {
+	isc_mem_t *mctx = batch->mctx;
+
+	DESTROYLOCK(&batch->lock);
+	(void)isc_condition_destroy(&batch->cond);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+	isc_mem_detach(&mctx);
+}
+
+/*
+ * Create a batch whose signatures are added to 'version' of 'db' and
+ * recorded in 'diff'.  If 'spread' is not zero, the expiry time of each
+ * signature is brought forward by a random amount of up to 'spread'
+ * seconds.
+ */
+static isc_result_t
+signbatch_create(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *version,
+		 dns_diff_t *diff, isc_stdtime_t inception,
+		 isc_uint32_t spread, dns_signbatch_t **batchp)
+{
+	dns_signbatch_t *batch;
+	isc_result_t result;
+
+	REQUIRE(batchp != NULL && *batchp == NULL);
+
+	batch = isc_mem_get(zone->mctx, sizeof(*batch));
+	if (batch == NULL)
+		return (ISC_R_NOMEMORY);
+	result = isc_mutex_init(&batch->lock);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
+		return (result);
+	}
+	if (isc_condition_init(&batch->cond) != ISC_R_SUCCESS) {
+		DESTROYLOCK(&batch->lock);
+		isc_mem_put(zone->mctx, batch, sizeof(*batch));
+		return (ISC_R_UNEXPECTED);
+	}
+	batch->mctx = NULL;
+	isc_mem_attach(zone->mctx, &batch->mctx);
+	batch->zone = zone;
+	batch->db = db;
+	batch->version = version;
+	batch->diff = diff;
+	batch->inception = inception;
+	batch->spread = spread;
+	batch->refs = 1;
+	batch->helpers = 0;
+	batch->running = 0;
+	batch->next = 0;
+	batch->count = 0;
+
+	*batchp = batch;
+	return (ISC_R_SUCCESS);
+}
+
+static void
+signjob_sign(dns_signbatch_t *batch, dns_signjob_t *job) {
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, job->data, sizeof(job->data));
+	job->result = dns_dnssec_sign(dns_fixedname_name(&job->name),
+				      &job->rdataset, job->key,
+				      &batch->inception, &job->expire,
+				      batch->mctx, &buffer, &job->rdata);
+}
+
+/*
+ * Take and sign jobs until there are none left.  Called with the
+ * batch locked.
+ */
+static void
+signbatch_work(dns_signbatch_t *batch, isc_boolean_t helper) {
+	dns_signjob_t *job;
+
+	while (batch->next < batch->count) {
+		job = &batch->jobs[batch->next++];
+		if (helper)
+			batch->running++;
+		UNLOCK(&batch->lock);
+		signjob_sign(batch, job);
+		LOCK(&batch->lock);
+		if (helper && --batch->running == 0)
+			SIGNAL(&batch->cond);
+	}
+}
+
+static void
+signbatch_help(isc_task_t *task, isc_event_t *event) {
+	dns_signbatch_t *batch = event->ev_arg;
+	isc_boolean_t destroy;
+
+	UNUSED(task);
+
+	isc_event_free(&event);
+
+	LOCK(&batch->lock);
+	INSIST(batch->helpers > 0);
+	batch->helpers--;
+	signbatch_work(batch, ISC_TRUE);
+	INSIST(batch->refs > 0);
+	destroy = ISC_TF(--batch->refs == 0);
+	UNLOCK(&batch->lock);
+
+	if (destroy)
+		signbatch_free(batch);
+}
+
+/*
+ * Sign the queued jobs and add the signatures to the version.
+ */
+static isc_result_t
+signbatch_flush(dns_signbatch_t *batch) {
+	dns_zonemgr_t *zmgr = batch->zone->zmgr;
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_event_t *event;
+	isc_task_t *task;
+	dns_signjob_t *job;
+	unsigned int i, count, want;
+
+	LOCK(&batch->lock);
+	count = batch->count;
+	UNLOCK(&batch->lock);
+	if (count == 0U)
+		return (ISC_R_SUCCESS);
+
+	/*
+	 * Ask for help with all but one job, which we will be doing.
+	 */
+	if (zmgr != NULL && count > 1U) {
+		RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+		want = ISC_MIN(zmgr->signworkers, count) - 1;
+		LOCK(&batch->lock);
+		while (zmgr->signtasks != NULL && batch->helpers < want) {
+			event = isc_event_allocate(batch->mctx, batch,
+						   DNS_EVENT_ZONESIGN,
+						   signbatch_help, batch,
+						   sizeof(isc_event_t));
+			if (event == NULL)
+				break;
+			batch->helpers++;
+			batch->refs++;
+			task = NULL;
+			isc_taskpool_gettask(zmgr->signtasks, &task);
+			isc_task_send(task, &event);
+			isc_task_detach(&task);
+		}
+		UNLOCK(&batch->lock);
+		RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	}
+
+	LOCK(&batch->lock);
+	signbatch_work(batch, ISC_FALSE);
+	while (batch->running > 0)
+		WAIT(&batch->cond, &batch->lock);
+	UNLOCK(&batch->lock);
+
+	for (i = 0; i < count; i++) {
+		job = &batch->jobs[i];
+		if (result == ISC_R_SUCCESS)
+			result = job->result;
+		/* Update the database and journal with the RRSIG. */
+		/* XXX inefficient - will cause dataset merging */
+		if (result == ISC_R_SUCCESS)
+			result = update_one_rr(batch->db, batch->version,
+					       batch->diff,
+					       DNS_DIFFOP_ADDRESIGN,
+					       dns_fixedname_name(&job->name),
+					       job->rdataset.ttl, &job->rdata);
+		dns_rdataset_disassociate(&job->rdataset);
+	}
+
+	LOCK(&batch->lock);
+	batch->next = batch->count = 0;
+	UNLOCK(&batch->lock);
+
+	return (result);
+}
+
+/*
+ * Queue the signing of 'rdataset', the 'type' RRset of 'name', with
+ * 'key'.  It is not queued again if it already is.
+ */
+static isc_result_t
+signbatch_add(dns_signbatch_t *batch, dns_name_t *name,
+	      dns_rdataset_t *rdataset, dst_key_t *key, isc_stdtime_t expire)
+{
+	dns_signjob_t *job;
+	isc_uint32_t jitter;
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++) {
+		job = &batch->jobs[i];
+		if (job->key == key &&
+		    job->rdataset.type == rdataset->type &&
+		    dns_name_equal(dns_fixedname_name(&job->name), name))
+			return (ISC_R_SUCCESS);
+	}
+
+	if (batch->count == SIGNBATCH_SIZE) {
+		isc_result_t result = signbatch_flush(batch);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+	}
+
+	if (batch->spread != 0U) {
+		isc_random_get(&jitter);
+		expire -= jitter % batch->spread;
+	}
+
+	job = &batch->jobs[batch->count];
+	dns_fixedname_init(&job->name);
+	dns_name_copy(name, dns_fixedname_name(&job->name), NULL);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	job->key = key;
+	job->expire = expire;
+	job->result = ISC_R_UNEXPECTED;
+	dns_rdata_init(&job->rdata);
+
+	/*
+	 * Helpers still running from an earlier flush may start on the
+	 * job straight away.
+	 */
+	LOCK(&batch->lock);
+	batch->count++;
+	UNLOCK(&batch->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Throw away any jobs that were not flushed and drop our reference.
+ */
+static void
+signbatch_destroy(dns_signbatch_t **batchp) {
+	dns_signbatch_t *batch;
+	isc_boolean_t destroy;
+	unsigned int i;
+
+	REQUIRE(batchp != NULL && *batchp != NULL);
+
+	batch = *batchp;
+	*batchp = NULL;
+
+	LOCK(&batch->lock);
+	/* Stop helpers from taking any more jobs. */
+	batch->next = batch->count;
+	while (batch->running > 0)
+		WAIT(&batch->cond, &batch->lock);
+	for (i = 0; i < batch->count; i++)
+		dns_rdataset_disassociate(&batch->jobs[i].rdataset);
+	batch->next = batch->count = 0;
+	INSIST(batch->refs > 0);
+	destroy = ISC_TF(--batch->refs == 0);
+	UNLOCK(&batch->lock);
+
+	if (destroy)
+		signbatch_free(batch);
+}
+
+/*
+ * When the whole zone is (re)signed, e.g. with a new key, the expiry
+ * times of the signatures are spread over up to one re-signing
+ * interval so that they do not all fall due for re-signing together.
+ * Each must still be re-signed after now, and an hour is always
+ * allowed as before.
+ */
+static isc_uint32_t
+signing_spread(dns_zone_t *zone) {
+	isc_uint32_t spread = zone->sigresigninginterval;
+
+	if (zone->sigvalidityinterval < zone->sigresigninginterval + 7200)
+		return (3600);
+	if (spread > zone->sigvalidityinterval -
+		     zone->sigresigninginterval - 3600)
+		spread = zone->sigvalidityinterval -
+			 zone->sigresigninginterval - 3600;
+	if (spread < 3600)
+		spread = 3600;
+	return (spread);
+}
+
 static isc_result_t
 add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 	 dns_rdatatype_t type, dns_diff_t *diff, dst_key_t **keys,
 	 unsigned int nkeys, isc_mem_t *mctx, isc_stdtime_t inception,
 	 isc_stdtime_t expire, isc_boolean_t check_ksk,
-	 isc_boolean_t keyset_kskonly)
+	 isc_boolean_t keyset_kskonly, dns_signbatch_t *batch)
 {
 	isc_result_t result;
 	dns_dbnode_t *node = NULL;
@@ -5620,6 +6003,12 @@ add_sigs(dns_db_t *db, dns_dbversion_t *ver, dns_name_t *name,
 		} else if (REVOKE(keys[i]) && type != dns_rdatatype_dnskey)
 				continue;
 
+		if (batch != NULL) {
+			CHECK(signbatch_add(batch, name, &rdataset, keys[i],
+					    expire));
+			continue;
+		}
+
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, keys[i],
@@ -5652,6 +6041,7 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_name_t *name;
 	dns_rdataset_t rdataset;
 	dns_rdatatype_t covers;
+	dns_signbatch_t *batch = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	isc_boolean_t check_ksk, keyset_kskonly = ISC_FALSE;
 	isc_result_t result;
@@ -5712,6 +6102,15 @@ zone_resigninc(dns_zone_t *zone) {
 	expire = soaexpire - jitter % 3600;
 	stop = now + 5;
 
+	result = signbatch_create(zone, db, version, zonediff.diff, inception,
+				  0, &batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_resigninc:signbatch_create -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	check_ksk = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_UPDATECHECKKSK);
 	keyset_kskonly = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_DNSKEYKSKONLY);
 
@@ -5750,7 +6149,7 @@ zone_resigninc(dns_zone_t *zone) {
 
 		result = add_sigs(db, version, name, covers, zonediff.diff,
 				  zone_keys, nkeys, zone->mctx, inception,
-				  expire, check_ksk, keyset_kskonly);
+				  expire, check_ksk, keyset_kskonly, batch);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "zone_resigninc:add_sigs -> %s",
@@ -5772,6 +6171,14 @@ zone_resigninc(dns_zone_t *zone) {
 	if (result != ISC_R_NOMORE && result != ISC_R_SUCCESS)
 		goto failure;
 
+	result = signbatch_flush(batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_resigninc:signbatch_flush -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	result = del_sigs(zone, db, version, &zone->origin, dns_rdatatype_soa,
 			  &zonediff, zone_keys, nkeys, now, ISC_TRUE);
 	if (result != ISC_R_SUCCESS) {
@@ -5808,7 +6215,8 @@ zone_resigninc(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
 			     "zone_resigninc:add_sigs -> %s",
@@ -5823,6 +6231,8 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_db_closeversion(db, &version, ISC_TRUE);
 
  failure:
+	if (batch != NULL)
+		signbatch_destroy(&batch);
 	dns_diff_clear(&_sig_diff);
 	for (i = 0; i < nkeys; i++)
 		dst_key_free(&zone_keys[i]);
@@ -5945,18 +6355,14 @@ add_nsec(dns_db_t *db, dns_dbversion_t *version, dns_name_t *name,
 static isc_result_t
 sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	    dns_dbversion_t *version, isc_boolean_t build_nsec3,
-	    isc_boolean_t build_nsec, dst_key_t *key,
-	    isc_stdtime_t inception, isc_stdtime_t expire,
+	    isc_boolean_t build_nsec, dst_key_t *key, isc_stdtime_t expire,
 	    unsigned int minimum, isc_boolean_t is_ksk,
 	    isc_boolean_t keyset_kskonly, isc_boolean_t *delegation,
-	    dns_diff_t *diff, isc_int32_t *signatures, isc_mem_t *mctx)
+	    dns_diff_t *diff, isc_int32_t *signatures, dns_signbatch_t *batch)
 {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
-	dns_rdata_t rdata = DNS_RDATA_INIT;
-	isc_buffer_t buffer;
-	unsigned char data[1024];
 	isc_boolean_t seen_soa, seen_ns, seen_rr, seen_dname, seen_nsec,
 		      seen_nsec3, seen_ds;
 	isc_boolean_t bottom;
@@ -5969,7 +6375,6 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 	}
 
 	dns_rdataset_init(&rdataset);
-	isc_buffer_init(&buffer, data, sizeof(data));
 	seen_rr = seen_soa = seen_ns = seen_dname = seen_nsec =
 	seen_nsec3 = seen_ds = ISC_FALSE;
 	for (result = dns_rdatasetiter_first(iterator);
@@ -6040,15 +6445,8 @@ sign_a_node(dns_db_t *db, dns_name_t *name, dns_dbnode_t *node,
 			goto next_rdataset;
 		if (signed_with_key(db, node, version, rdataset.type, key))
 			goto next_rdataset;
-		/* Calculate the signature, creating a RRSIG RDATA. */
-		isc_buffer_clear(&buffer);
-		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception,
-				      &expire, mctx, &buffer, &rdata));
-		/* Update the database and journal with the RRSIG. */
-		/* XXX inefficient - will cause dataset merging */
-		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
-				    name, rdataset.ttl, &rdata));
-		dns_rdata_reset(&rdata);
+		/* Queue the signature; signbatch_flush() adds the RRSIG. */
+		CHECK(signbatch_add(batch, name, &rdataset, key, expire));
 		(*signatures)--;
  next_rdataset:
 		dns_rdataset_disassociate(&rdataset);
@@ -6500,7 +6898,7 @@ update_sigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 	    dst_key_t *zone_keys[], unsigned int nkeys, dns_zone_t *zone,
 	    isc_stdtime_t inception, isc_stdtime_t expire, isc_stdtime_t now,
 	    isc_boolean_t check_ksk, isc_boolean_t keyset_kskonly,
-	    zonediff_t *zonediff)
+	    zonediff_t *zonediff, dns_signbatch_t *batch)
 {
 	dns_difftuple_t *tuple;
 	isc_result_t result;
@@ -6520,7 +6918,7 @@ update_sigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 		result = add_sigs(db, version, &tuple->name,
 				  tuple->rdata.type, zonediff->diff,
 				  zone_keys, nkeys, zone->mctx, inception,
-				  expire, check_ksk, keyset_kskonly);
+				  expire, check_ksk, keyset_kskonly, batch);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "update_sigs:add_sigs -> %s",
@@ -6540,6 +6938,15 @@ update_sigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
 			tuple = next;
 		} while (tuple != NULL);
 	}
+	if (batch != NULL) {
+		result = signbatch_flush(batch);
+		if (result != ISC_R_SUCCESS) {
+			dns_zone_log(zone, ISC_LOG_ERROR,
+				     "update_sigs:signbatch_flush -> %s",
+				     dns_result_totext(result));
+			return (result);
+		}
+	}
 	return (ISC_R_SUCCESS);
 }
 
@@ -6564,6 +6971,7 @@ zone_nsec3chain(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_nsec3chain_t *nsec3chain = NULL, *nextnsec3chain;
 	dns_nsec3chainlist_t cleanup;
+	dns_signbatch_t *batch = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	isc_int32_t signatures;
 	isc_boolean_t check_ksk, keyset_kskonly;
@@ -6638,6 +7046,15 @@ zone_nsec3chain(dns_zone_t *zone) {
 	isc_random_get(&jitter);
 	expire = soaexpire - jitter % 3600;
 
+	result = signbatch_create(zone, db, version, zonediff.diff, inception,
+				  signing_spread(zone), &batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_nsec3chain:signbatch_create -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	check_ksk = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_UPDATECHECKKSK);
 	keyset_kskonly = DNS_ZONE_OPTION(zone, DNS_ZONEOPT_DNSKEYKSKONLY);
 
@@ -7132,7 +7549,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 		dns_dbiterator_pause(nsec3chain->dbiterator);
 	result = update_sigs(&nsec3_diff, db, version, zone_keys,
 			     nkeys, zone, inception, expire, now,
-			     check_ksk, keyset_kskonly, &zonediff);
+			     check_ksk, keyset_kskonly, &zonediff,
+			     batch);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain:"
 			     "update_sigs -> %s", dns_result_totext(result));
@@ -7145,7 +7563,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 	 */
 	result = update_sigs(&param_diff, db, version, zone_keys,
 			     nkeys, zone, inception, expire, now,
-			     check_ksk, keyset_kskonly, &zonediff);
+			     check_ksk, keyset_kskonly, &zonediff,
+			     batch);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain:"
 			     "update_sigs -> %s", dns_result_totext(result));
@@ -7165,7 +7584,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 
 	result = update_sigs(&nsec_diff, db, version, zone_keys,
 			     nkeys, zone, inception, expire, now,
-			     check_ksk, keyset_kskonly, &zonediff);
+			     check_ksk, keyset_kskonly, &zonediff,
+			     batch);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain:"
 			     "update_sigs -> %s", dns_result_totext(result));
@@ -7203,7 +7623,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain:"
 			     "add_sigs -> %s", dns_result_totext(result));
@@ -7253,6 +7674,8 @@ zone_nsec3chain(dns_zone_t *zone) {
 	if (result != ISC_R_SUCCESS)
 		dns_zone_log(zone, ISC_LOG_ERROR, "zone_nsec3chain: %s",
 			     dns_result_totext(result));
+	if (batch != NULL)
+		signbatch_destroy(&batch);
 	/*
 	 * On error roll back the current nsec3chain.
 	 */
@@ -7416,6 +7839,7 @@ zone_sign(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_signing_t *signing, *nextsigning;
 	dns_signinglist_t cleanup;
+	dns_signbatch_t *batch = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	isc_int32_t signatures;
 	isc_boolean_t check_ksk, keyset_kskonly, is_ksk;
@@ -7489,6 +7913,15 @@ zone_sign(dns_zone_t *zone) {
 	isc_random_get(&jitter);
 	expire = soaexpire - jitter % 3600;
 
+	result = signbatch_create(zone, db, version, zonediff.diff, inception,
+				  signing_spread(zone), &batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_sign:signbatch_create -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	/*
 	 * We keep pulling nodes off each iterator in turn until
 	 * we have no more nodes to pull off or we reach the limits
@@ -7533,6 +7966,10 @@ zone_sign(dns_zone_t *zone) {
 		delegation = ISC_FALSE;
 
 		if (first && signing->delete) {
+			/*
+			 * Queued signatures may be using the key.
+			 */
+			CHECK(signbatch_flush(batch));
 			/*
 			 * Remove the key we are deleting from consideration.
 			 */
@@ -7651,11 +8088,11 @@ zone_sign(dns_zone_t *zone) {
 				is_ksk = ISC_FALSE;
 
 			CHECK(sign_a_node(db, name, node, version, build_nsec3,
-					  build_nsec, zone_keys[i], inception,
-					  expire, zone->minimum, is_ksk,
+					  build_nsec, zone_keys[i], expire,
+					  zone->minimum, is_ksk,
 					  ISC_TF(both && keyset_kskonly),
 					  &delegation, zonediff.diff,
-					  &signatures, zone->mctx));
+					  &signatures, batch));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -7733,10 +8170,19 @@ zone_sign(dns_zone_t *zone) {
 		first = ISC_TRUE;
 	}
 
+	result = signbatch_flush(batch);
+	if (result != ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "zone_sign:signbatch_flush -> %s",
+			     dns_result_totext(result));
+		goto failure;
+	}
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = update_sigs(&post_diff, db, version, zone_keys,
 				     nkeys, zone, inception, expire, now,
-				     check_ksk, keyset_kskonly, &zonediff);
+				     check_ksk, keyset_kskonly, &zonediff,
+				     batch);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR, "zone_sign:"
 				     "update_sigs -> %s",
@@ -7781,7 +8227,8 @@ zone_sign(dns_zone_t *zone) {
 	 */
 	result = add_sigs(db, version, &zone->origin, dns_rdatatype_soa,
 			  zonediff.diff, zone_keys, nkeys, zone->mctx,
-			  inception, soaexpire, check_ksk, keyset_kskonly);
+			  inception, soaexpire, check_ksk, keyset_kskonly,
+			  NULL);
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
 			     "zone_sign:add_sigs -> %s",
@@ -7835,6 +8282,9 @@ zone_sign(dns_zone_t *zone) {
 	}
 
  failure:
+	if (batch != NULL)
+		signbatch_destroy(&batch);
+
 	/*
 	 * Rollback the cleanup list.
 	 */
@@ -9121,6 +9571,34 @@ dns_zone_dump(dns_zone_t *zone) {
 	return (result);
 }
 
+isc_result_t
+dns_zone_resetjournal(dns_zone_t *zone) {
+	isc_result_t result;
+	char *journal = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	result = dns_zone_dump(zone);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	LOCK_ZONE(zone);
+	if (zone->journal != NULL)
+		journal = isc_mem_strdup(zone->mctx, zone->journal);
+	UNLOCK_ZONE(zone);
+	if (journal == NULL)
+		return (ISC_R_SUCCESS);
+
+	result = isc_file_remove(journal);
+	if (result == ISC_R_FILENOTFOUND)
+		result = ISC_R_SUCCESS;
+	if (result == ISC_R_SUCCESS)
+		dns_zone_log(zone, ISC_LOG_WARNING,
+			     "zone dumped and journal '%s' removed", journal);
+	isc_mem_free(zone->mctx, journal);
+	return (result);
+}
+
 static void
 zone_needdump(dns_zone_t *zone, unsigned int delay) {
 	const char me[] = "zone_needdump";
@@ -12213,6 +12691,52 @@ dns_zone_setupdatedisabled(dns_zone_t *zone, isc_boolean_t state) {
 	zone->update_disabled = state;
 }
 
+isc_boolean_t
+dns_zone_getgroupcommit(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	return (zone->groupcommit);
+}
+
+void
+dns_zone_setgroupcommit(dns_zone_t *zone, isc_boolean_t state) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	zone->groupcommit = state;
+}
+
+isc_boolean_t
+dns_zone_queueupdate(dns_zone_t *zone, isc_event_t *event) {
+	isc_boolean_t first;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(event != NULL);
+
+	LOCK_ZONE(zone);
+	first = ISC_TF(!zone->updating);
+	if (first)
+		zone->updating = ISC_TRUE;
+	else
+		ISC_LIST_APPEND(zone->updates, event, ev_link);
+	UNLOCK_ZONE(zone);
+	return (first);
+}
+
+isc_event_t *
+dns_zone_nextupdate(dns_zone_t *zone) {
+	isc_event_t *event;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	INSIST(zone->updating);
+	event = ISC_LIST_HEAD(zone->updates);
+	if (event != NULL)
+		ISC_LIST_UNLINK(zone->updates, event, ev_link);
+	else
+		zone->updating = ISC_FALSE;
+	UNLOCK_ZONE(zone);
+	return (event);
+}
+
 isc_boolean_t
 dns_zone_getzeronosoattl(dns_zone_t *zone) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -12533,6 +13057,15 @@ dns_zone_gettask(dns_zone_t *zone, isc_task_t **target) {
 	isc_task_attach(zone->task, target);
 }
 
+void
+dns_zone_getloadtask(dns_zone_t *zone, isc_task_t **target) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(target != NULL && *target == NULL);
+
+	if (zone->loadtask != NULL)
+		isc_task_attach(zone->loadtask, target);
+}
+
 void
 dns_zone_setidlein(dns_zone_t *zone, isc_uint32_t idlein) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -13934,7 +14467,7 @@ zone_loaddone(void *arg, isc_result_t result) {
 
 	ENTER;
 
-	tresult = dns_db_endload(load->db, &load->callbacks.add_private);
+	tresult = dns_db_endload(load->db, &load->callbacks);
 	if (tresult != ISC_R_SUCCESS &&
 	    (result == ISC_R_SUCCESS || result == DNS_R_SEENINCLUDE))
 		result = tresult;
@@ -13980,6 +14513,8 @@ zone_loaddone(void *arg, isc_result_t result) {
 	if (load->zone->lctx != NULL)
 		dns_loadctx_detach(&load->zone->lctx);
 	dns_zone_idetach(&load->zone);
+	if (load->asyncload != NULL)
+		zone_asyncloaded(load->asyncload, zone->loadtask);
 	isc_mem_putanddetach(&load->mctx, load, sizeof(*load));
 }
 
@@ -14508,6 +15043,8 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_taskmgr_t *taskmgr,
 	zmgr->socketmgr = socketmgr;
 	zmgr->zonetasks = NULL;
 	zmgr->loadtasks = NULL;
+	zmgr->signtasks = NULL;
+	zmgr->signworkers = 1;
 	zmgr->mctxpool = NULL;
 	zmgr->task = NULL;
 	zmgr->notifyrl = NULL;
@@ -14782,6 +15319,11 @@ dns_zonemgr_shutdown(dns_zonemgr_t *zmgr) {
 		isc_taskpool_destroy(&zmgr->zonetasks);
 	if (zmgr->loadtasks != NULL)
 		isc_taskpool_destroy(&zmgr->loadtasks);
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	if (zmgr->signtasks != NULL)
+		isc_taskpool_destroy(&zmgr->signtasks);
+	zmgr->signworkers = 1;
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	if (zmgr->mctxpool != NULL)
 		isc_pool_destroy(&zmgr->mctxpool);
 
@@ -15106,6 +15648,48 @@ dns_zonemgr_getiolimit(dns_zonemgr_t *zmgr) {
 	return (zmgr->iolimit);
 }
 
+isc_result_t
+dns_zonemgr_setsigningworkers(dns_zonemgr_t *zmgr, unsigned int workers) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_taskpool_t *pool = NULL;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+	REQUIRE(workers > 0);
+
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+	/*
+	 * The zone's own task does its share of the work, so the pool
+	 * needs one task fewer.  The pool is only ever grown.
+	 */
+	if (workers > 1 && zmgr->signtasks == NULL)
+		result = isc_taskpool_create(zmgr->taskmgr, zmgr->mctx,
+					     workers - 1, 0, &pool);
+	else if (workers > 1)
+		result = isc_taskpool_expand(&zmgr->signtasks, workers - 1,
+					     &pool);
+	if (result == ISC_R_SUCCESS) {
+		if (pool != NULL)
+			zmgr->signtasks = pool;
+		zmgr->signworkers = workers;
+	}
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
+
+	return (result);
+}
+
+unsigned int
+dns_zonemgr_getsigningworkers(dns_zonemgr_t *zmgr) {
+	unsigned int workers;
+
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	RWLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+	workers = zmgr->signworkers;
+	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_read);
+
+	return (workers);
+}
+
 /*
  * Get permission to request a file handle from the OS.
  * An event will be sent to action when one is available.
@@ -16140,7 +16724,7 @@ sign_apex(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 		result = add_sigs(db, ver, &zone->origin, dns_rdatatype_dnskey,
 				  zonediff->diff, zone_keys, nkeys, zone->mctx,
 				  inception, soaexpire, check_ksk,
-				  keyset_kskonly);
+				  keyset_kskonly, NULL);
 		if (result != ISC_R_SUCCESS) {
 			dns_zone_log(zone, ISC_LOG_ERROR,
 				     "sign_apex:add_sigs -> %s",
@@ -16151,7 +16735,7 @@ sign_apex(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
 
 	result = update_sigs(diff, db, ver, zone_keys, nkeys, zone,
 			     inception, soaexpire, now, check_ksk,
-			     keyset_kskonly, zonediff);
+			     keyset_kskonly, zonediff, NULL);
 
 	if (result != ISC_R_SUCCESS) {
 		dns_zone_log(zone, ISC_LOG_ERROR,
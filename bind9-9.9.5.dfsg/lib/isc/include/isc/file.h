@@ -336,6 +336,24 @@ isc_file_getsizefd(int fd, off_t *size);
  * - ISC_R_SUCCESS on success
  */
 
+void *
+isc_file_mmap(void *addr, size_t len, int prot,
+	      int flags, int fd, off_t offset);
+/*%<
+ * Portable front-end to mmap().  Where mmap() is not available it is
+ * simulated by reading the file into allocated memory, in which case
+ * 'addr', 'prot' and 'flags' are ignored.
+ *
+ * Returns:
+ * - the address of the mapping, or MAP_FAILED ((void *)-1) on error
+ */
+
+int
+isc_file_munmap(void *addr, size_t len);
+/*%<
+ * Release a mapping made by isc_file_mmap().
+ */
+
 ISC_LANG_ENDDECLS
 
 #endif /* ISC_FILE_H */
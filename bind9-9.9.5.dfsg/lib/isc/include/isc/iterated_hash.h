@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2008  Internet Systems Consortium, Inc. ("ISC")
+ * Copyright (C) 2008, 2014  Internet Systems Consortium, Inc. ("ISC")
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -41,6 +41,21 @@ int isc_iterated_hash(unsigned char out[NSEC3_MAX_HASH_LENGTH],
 		      const unsigned char *salt, int saltlength,
 		      const unsigned char *in, int inlength);
 
+int isc_iterated_hash_batch(unsigned char **out, unsigned int hashalg,
+			    int iterations, const unsigned char *salt,
+			    int saltlength, const unsigned char **in,
+			    const int *inlength, unsigned int count);
+/*
+ * Compute the iterated hash of each of the 'count' inputs in[i] of
+ * length inlength[i] into out[i], as isc_iterated_hash() would, using
+ * the same salt and number of iterations for all of them.  Where the
+ * CPU allows it several inputs are hashed side by side, so callers
+ * that have many names to hash should hand them over together.
+ *
+ * 'saltlength' and every inlength[i] must be at most 255.  Returns
+ * the length of the hashes, or 0 if 'hashalg' is not supported.
+ */
+
 
 ISC_LANG_ENDDECLS
 
@@ -332,6 +332,12 @@ isc_mem_createx2(size_t max_size, size_t target_size,
  * inadvisable to use this flag unless the user is very sure about the race
  * condition and the access to the object is highly performance sensitive.
  *
+ * In threaded builds, a context that uses ISC_MEMFLAG_INTERNAL and locking
+ * gives each thread a small cache of recently freed small blocks, so most
+ * small allocations don't take the context lock.  Blocks held in these
+ * caches are counted as in use; see isc_mem_inuse().  Caching is turned
+ * off for contexts created while isc_mem_debugging is non-zero.
+ *
  * Requires:
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
@@ -393,6 +399,11 @@ isc_mem_getquota(isc_mem_t *);
  * Set/get the memory quota of 'mctx'.  This is a hard limit
  * on the amount of memory that may be allocated from mctx;
  * if it is exceeded, allocations will fail.
+ *
+ * Setting the quota takes back the small blocks held in the caller's
+ * per-thread cache and in those of exited threads; other threads give
+ * theirs back the next time they refill or spill their cache.  It does
+ * not call the water callback.
  */
 /*@}*/
 
@@ -401,7 +412,9 @@ isc_mem_inuse(isc_mem_t *mctx);
 /*%<
  * Get an estimate of the number of memory in use in 'mctx', in bytes.
  * This includes quantization overhead, but does not include memory
- * allocated from the system but not yet used.
+ * allocated from the system but not yet used.  It does include small
+ * blocks held in per-thread caches, which are limited to a few tens of
+ * kilobytes per thread.
  */
 
 isc_boolean_t
@@ -597,6 +610,11 @@ isc_mempool_associatelock(isc_mempool_t *mpctx, isc_mutex_t *lock);
  * by other than mempool routines once it is given to a pool, since that can
  * easily cause double locking.
  *
+ * In threaded builds, a pool with a lock gives each thread a small cache
+ * of items while the pool has no allocation limit (see
+ * isc_mempool_setmaxalloc()).  Items in these caches are counted as
+ * allocated.
+ *
  * Requires:
  *
  *\li	mpctpx is a valid pool.
@@ -95,6 +95,7 @@
 #define isc_socket_detach isc__socket_detach
 #define isc_socketmgr_create isc__socketmgr_create
 #define isc_socketmgr_create2 isc__socketmgr_create2
+#define isc_socketmgr_create3 isc__socketmgr_create3
 #define isc_socketmgr_destroy isc__socketmgr_destroy
 #define isc_socket_open isc__socket_open
 #define isc_socket_close isc__socket_close
@@ -167,6 +168,7 @@
 #define isc_timer_attach isc__timer_attach
 #define isc_timer_detach isc__timer_detach
 #define isc_timermgr_create isc__timermgr_create
+#define isc_timermgr_create2 isc__timermgr_create2
 #define isc_timermgr_poke isc__timermgr_poke
 #define isc_timermgr_destroy isc__timermgr_destroy
 
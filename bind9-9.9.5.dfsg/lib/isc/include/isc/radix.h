@@ -104,6 +104,8 @@ typedef struct isc_radix_node {
 #define RADIX_TREE_MAGIC         ISC_MAGIC('R','d','x','T');
 #define RADIX_TREE_VALID(a)      ISC_MAGIC_VALID(a, RADIX_TREE_MAGIC);
 
+typedef struct isc_radix_table isc_radix_table_t;
+
 typedef struct isc_radix_tree {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -111,6 +113,8 @@ typedef struct isc_radix_tree {
 	isc_uint32_t maxbits;		/* for IP, 32 bit addresses */
 	int num_active_node;		/* for debugging purposes */
 	int num_added_node;		/* total number of nodes */
+	isc_radix_table_t *table[2];	/* compiled IPv4 and IPv6 lookups,
+					   see isc_radix_compile() */
 } isc_radix_tree_t;
 
 isc_result_t
@@ -120,6 +124,9 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
  * Search 'radix' for the best match to 'prefix'.
  * Return the node found in '*target'.
  *
+ * If 'radix' has been compiled and 'prefix' is a complete IPv4 or IPv6
+ * address, the compiled lookup table is used instead of the tree.
+ *
  * Requires:
  * \li	'radix' to be valid.
  * \li	'target' is not NULL and "*target" is NULL.
@@ -158,6 +165,26 @@ isc_radix_remove(isc_radix_tree_t *radix, isc_radix_node_t *node);
  * \li	'node' to be valid.
  */
 
+isc_result_t
+isc_radix_compile(isc_radix_tree_t *radix);
+/*%<
+ * Flatten the prefixes in 'radix' into a lookup table for each address
+ * family, so that searches for complete addresses no longer walk the
+ * tree.  The table is a multibit trie whose nodes each cover four bits
+ * of the address, with the result of the search for every address
+ * worked out in advance.  Inserting or removing a node discards the
+ * tables; compile again afterwards if required.
+ *
+ * The tree must not be searched by other threads while it is compiled.
+ *
+ * Requires:
+ * \li	'radix' to be valid.
+ *
+ * Returns:
+ * \li	ISC_R_NOMEMORY
+ * \li	ISC_R_SUCCESS
+ */
+
 isc_result_t
 isc_radix_create(isc_mem_t *mctx, isc_radix_tree_t **target, int maxbits);
 /*%<
@@ -84,6 +84,13 @@ ISC_LANG_BEGINDECLS
  */
 #define ISC_SOCKET_REUSEADDRESS		0x01U
 
+/*%
+ * In isc_socket_bind() set socket option SO_REUSEPORT prior to calling
+ * bind() so that several sockets can be bound to the same address and
+ * port, with the kernel spreading incoming datagrams between them.
+ */
+#define ISC_SOCKET_REUSEPORT		0x02U
+
 /*%
  * Statistics counters.  Used as isc_statscounter_t values.
  */
@@ -150,7 +157,13 @@ enum {
 	isc_sockstatscounter_unixrecvfail = 50,
 	isc_sockstatscounter_fdwatchrecvfail = 51,
 
-	isc_sockstatscounter_max = 52
+	isc_sockstatscounter_udp4recvbatch = 52,
+	isc_sockstatscounter_udp6recvbatch = 53,
+
+	isc_sockstatscounter_udp4sendbatch = 54,
+	isc_sockstatscounter_udp6sendbatch = 55,
+
+	isc_sockstatscounter_max = 56
 };
 
 /***
@@ -639,6 +652,9 @@ isc_socket_bind(isc_socket_t *sock, isc_sockaddr_t *addressp,
  * \li	ISC_R_ADDRNOTAVAIL
  * \li	ISC_R_ADDRINUSE
  * \li	ISC_R_BOUND
+ * \li	ISC_R_NOTIMPLEMENTED	-- ISC_SOCKET_REUSEPORT was requested but
+ *				   the system does not support it.
+ * \li	Other errors if SO_REUSEPORT could not be set.
  * \li	ISC_R_UNEXPECTED
  */
 
@@ -960,11 +976,23 @@ isc_socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 isc_result_t
 isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		      unsigned int maxsocks);
+
+isc_result_t
+isc_socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		      unsigned int maxsocks, unsigned int nwatchers);
 /*%<
  * Create a socket manager.  If "maxsocks" is non-zero, it specifies the
  * maximum number of sockets that the created manager should handle.
  * isc_socketmgr_create() is equivalent of isc_socketmgr_create2() with
  * "maxsocks" being zero.
+ * isc_socketmgr_create3() additionally starts "nwatchers" threads
+ * waiting for socket events; each socket is watched by one of them,
+ * chosen by its descriptor, and its I/O completions are sent directly
+ * from that thread to the task that requested them.
+ * isc_socketmgr_create2() is equivalent of isc_socketmgr_create3() with
+ * "nwatchers" being one.  Where multiple watchers are not supported
+ * (anything but epoll, or a non-threaded build) "nwatchers" is ignored
+ * and a single watcher is used.
  * isc_socketmgr_createinctx() also associates the new manager with the
  * specified application context.
  *
@@ -980,6 +1008,8 @@ isc_socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
  *
  *\li	'actx' is a valid application context (for createinctx()).
  *
+ *\li	'nwatchers' is greater than zero (for create3()).
+ *
  * Ensures:
  *
  *\li	'*managerp' is a valid isc_socketmgr_t.
@@ -210,6 +210,32 @@ isc_task_create(isc_taskmgr_t *manager, unsigned int quantum,
  *\li	#ISC_R_SHUTTINGDOWN
  */
 
+isc_result_t
+isc_task_create_bound(isc_taskmgr_t *manager, unsigned int quantum,
+		      isc_task_t **taskp, int threadid);
+/*%<
+ * Create a task bound to worker thread 'threadid'.
+ *
+ * Notes:
+ *
+ *\li	Tasks created with isc_task_create() are assigned to the task
+ *	manager's worker threads round-robin.  A task created with
+ *	isc_task_create_bound() is normally run by worker 'threadid' (modulo
+ *	the number of workers), which is useful for keeping related objects
+ *	on the same thread.  An idle worker may still steal a bound task
+ *	from a busy one.
+ *
+ *\li	In all other respects this is the same as isc_task_create().
+ *
+ * Requires:
+ *
+ *\li	'manager' is a valid task manager.
+ *
+ *\li	taskp != NULL && *taskp == NULL
+ *
+ *\li	threadid >= 0
+ */
+
 void
 isc_task_attach(isc_task_t *source, isc_task_t **targetp);
 /*%<
@@ -350,10 +350,26 @@ isc_timermgr_createinctx(isc_mem_t *mctx, isc_appctx_t *actx,
 
 isc_result_t
 isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		     unsigned int nshards);
 /*%<
  * Create a timer manager.  isc_timermgr_createinctx() also associates
  * the new manager with the specified application context.
  *
+ * isc_timermgr_create2() with a non-zero 'nshards' keeps the timers in
+ * hierarchical timing wheels split into 'nshards' independently locked
+ * shards, instead of in a single heap under the manager lock.  Arming,
+ * resetting and stopping a timer then take constant time, and threads
+ * working on timers in different shards do not contend; in exchange,
+ * due times are rounded up to the next 10 milliseconds.  This suits
+ * a manager with a great many timers, most of which are reset before
+ * they fire.  Without threads, 'nshards' is ignored, as it is by a
+ * timer manager implementation registered with isc_timer_register().
+ * isc_timermgr_create() is equivalent to isc_timermgr_create2() with
+ * 'nshards' of 0.
+ *
  * Notes:
  *
  *\li	All memory will be allocated in memory context 'mctx'.
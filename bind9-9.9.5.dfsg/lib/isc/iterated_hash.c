@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2006, 2008, 2009  Internet Systems Consortium, Inc. ("ISC")
+ * Copyright (C) 2006, 2008, 2009, 2014  Internet Systems Consortium, Inc. ("ISC")
  *
  * Permission to use, copy, modify, and/or distribute this software for any
  * purpose with or without fee is hereby granted, provided that the above
@@ -19,9 +19,29 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #include <isc/sha1.h>
 #include <isc/iterated_hash.h>
+#include <isc/once.h>
+#include <isc/util.h>
+
+/*
+ * Several names are hashed side by side in the lanes of SSE2 or AVX2
+ * registers.  SSE2 is part of the x86_64 base architecture; AVX2 is
+ * compiled in with the target attribute and used only when the CPU
+ * reports it.
+ */
+#if defined(__GNUC__) && \
+    (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+#define SHA1_SSE2 1
+#include <emmintrin.h>
+#if !defined(__clang__) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define SHA1_AVX2 1
+#include <immintrin.h>
+#endif
+#endif
 
 int
 isc_iterated_hash(unsigned char out[ISC_SHA1_DIGESTLENGTH],
@@ -46,3 +66,322 @@ isc_iterated_hash(unsigned char out[ISC_SHA1_DIGESTLENGTH],
 
 	return (ISC_SHA1_DIGESTLENGTH);
 }
+
+#ifdef SHA1_SSE2
+
+/*
+ * Longest padded message: a 255 octet name and a 255 octet salt.
+ */
+#define SHA1_MAXBLOCKS	9
+#define SHA1_MAXLANES	8
+
+#define K0	0x5a827999U
+#define K1	0x6ed9eba1U
+#define K2	0x8f1bbcdcU
+#define K3	0xca62c1d6U
+
+static const isc_uint32_t sha1_iv[5] = {
+	0x67452301U, 0xefcdab89U, 0x98badcfeU, 0x10325476U, 0xc3d2e1f0U
+};
+
+static inline isc_uint32_t
+load_be32(const unsigned char *p) {
+	return (((isc_uint32_t)p[0] << 24) | ((isc_uint32_t)p[1] << 16) |
+		((isc_uint32_t)p[2] << 8) | (isc_uint32_t)p[3]);
+}
+
+static inline void
+store_be32(unsigned char *p, isc_uint32_t v) {
+	p[0] = (unsigned char)(v >> 24);
+	p[1] = (unsigned char)(v >> 16);
+	p[2] = (unsigned char)(v >> 8);
+	p[3] = (unsigned char)v;
+}
+
+/*
+ * Pad 'length' octets already in 'buf' to whole SHA-1 blocks and
+ * return the number of blocks.
+ */
+static unsigned int
+sha1_pad(unsigned char *buf, unsigned int length) {
+	unsigned int blocks = (length + 8) / 64 + 1;
+	isc_uint64_t bits = (isc_uint64_t)length * 8;
+	unsigned int i;
+
+	buf[length] = 0x80;
+	memset(buf + length + 1, 0, blocks * 64 - length - 1);
+	for (i = 0; i < 8; i++)
+		buf[blocks * 64 - 1 - i] = (unsigned char)(bits >> (i * 8));
+	return (blocks);
+}
+
+/*
+ * The SHA-1 round function over a vector type.  'w' holds the 16
+ * message words of the block, one lane per message, and is used as
+ * the rolling message schedule.
+ */
+#define SHA1_ROUNDS(V, h, w) \
+	do { \
+		V a = h[0], b = h[1], c = h[2], d = h[3], e = h[4]; \
+		V f, t; \
+		int i; \
+		for (i = 0; i < 80; i++) { \
+			if (i >= 16) { \
+				t = XOR(XOR(w[(i + 13) & 15], w[(i + 8) & 15]), \
+					XOR(w[(i + 2) & 15], w[i & 15])); \
+				w[i & 15] = ROL(t, 1); \
+			} \
+			if (i < 20) \
+				f = ADD(OR(AND(b, c), ANDNOT(b, d)), \
+					SET1(K0)); \
+			else if (i < 40) \
+				f = ADD(XOR(XOR(b, c), d), SET1(K1)); \
+			else if (i < 60) \
+				f = ADD(OR(AND(b, c), AND(d, OR(b, c))), \
+					SET1(K2)); \
+			else \
+				f = ADD(XOR(XOR(b, c), d), SET1(K3)); \
+			t = ADD(ADD(ROL(a, 5), f), ADD(e, w[i & 15])); \
+			e = d; \
+			d = c; \
+			c = ROL(b, 30); \
+			b = a; \
+			a = t; \
+		} \
+		h[0] = ADD(h[0], a); \
+		h[1] = ADD(h[1], b); \
+		h[2] = ADD(h[2], c); \
+		h[3] = ADD(h[3], d); \
+		h[4] = ADD(h[4], e); \
+	} while (0)
+
+/*
+ * Hash 'lanes' names at once.  The first hash covers name and salt,
+ * whose length differs between lanes; it is done in the vector unit
+ * when every lane needs the same number of blocks, and one lane at a
+ * time otherwise.  Every further iteration hashes a previous digest
+ * and the salt: the digest words are the vector state itself and the
+ * salt and padding words are the same in every lane, so the message
+ * schedule is built without touching memory.
+ */
+#define SHA1_LANES(NAME, V, N) \
+static void \
+NAME(unsigned char **out, int iterations, \
+     const unsigned char *salt, int saltlength, \
+     const unsigned char **in, const int *inlength) \
+{ \
+	unsigned char msg[N][SHA1_MAXBLOCKS * 64]; \
+	isc_uint32_t words[SHA1_MAXBLOCKS * 16]; \
+	isc_uint32_t state[5][N]; \
+	unsigned int blocks = 0, b, j, l; \
+	isc_boolean_t same = ISC_TRUE; \
+	V h[5], w[16]; \
+	int n; \
+ \
+	for (l = 0; l < N; l++) { \
+		memmove(msg[l], in[l], inlength[l]); \
+		memmove(msg[l] + inlength[l], salt, saltlength); \
+		b = sha1_pad(msg[l], inlength[l] + saltlength); \
+		if (l == 0) \
+			blocks = b; \
+		else if (b != blocks) \
+			same = ISC_FALSE; \
+	} \
+	if (same) { \
+		for (j = 0; j < 5; j++) \
+			h[j] = SET1(sha1_iv[j]); \
+		for (b = 0; b < blocks; b++) { \
+			for (j = 0; j < 16; j++) \
+				w[j] = GATHER(msg, b * 64 + j * 4); \
+			SHA1_ROUNDS(V, h, w); \
+		} \
+	} else { \
+		for (l = 0; l < N; l++) { \
+			isc_sha1_t ctx; \
+			unsigned char digest[ISC_SHA1_DIGESTLENGTH]; \
+ \
+			isc_sha1_init(&ctx); \
+			isc_sha1_update(&ctx, in[l], inlength[l]); \
+			isc_sha1_update(&ctx, salt, saltlength); \
+			isc_sha1_final(&ctx, digest); \
+			for (j = 0; j < 5; j++) \
+				state[j][l] = load_be32(digest + j * 4); \
+		} \
+		for (j = 0; j < 5; j++) \
+			h[j] = LOAD(state[j]); \
+	} \
+ \
+	memset(msg[0], 0, ISC_SHA1_DIGESTLENGTH); \
+	memmove(msg[0] + ISC_SHA1_DIGESTLENGTH, salt, saltlength); \
+	blocks = sha1_pad(msg[0], ISC_SHA1_DIGESTLENGTH + saltlength); \
+	for (j = 0; j < blocks * 16; j++) \
+		words[j] = load_be32(msg[0] + j * 4); \
+	for (n = 0; n < iterations; n++) { \
+		V d[5]; \
+ \
+		for (j = 0; j < 5; j++) \
+			d[j] = h[j]; \
+		for (j = 0; j < 5; j++) \
+			h[j] = SET1(sha1_iv[j]); \
+		for (b = 0; b < blocks; b++) { \
+			for (j = 0; j < 16; j++) \
+				w[j] = (b == 0 && j < 5) ? d[j] : \
+					SET1(words[b * 16 + j]); \
+			SHA1_ROUNDS(V, h, w); \
+		} \
+	} \
+ \
+	for (j = 0; j < 5; j++) \
+		STORE(state[j], h[j]); \
+	for (l = 0; l < N; l++) \
+		for (j = 0; j < 5; j++) \
+			store_be32(out[l] + j * 4, state[j][l]); \
+}
+
+#define ADD(a, b)	_mm_add_epi32(a, b)
+#define AND(a, b)	_mm_and_si128(a, b)
+#define ANDNOT(a, b)	_mm_andnot_si128(a, b)
+#define OR(a, b)	_mm_or_si128(a, b)
+#define XOR(a, b)	_mm_xor_si128(a, b)
+#define ROL(a, n)	_mm_or_si128(_mm_slli_epi32(a, n), \
+				     _mm_srli_epi32(a, 32 - (n)))
+#define SET1(v)		_mm_set1_epi32((int)(v))
+#define LOAD(p)		_mm_loadu_si128((const __m128i *)(p))
+#define STORE(p, v)	_mm_storeu_si128((__m128i *)(p), v)
+#define GATHER(m, o) \
+	_mm_set_epi32((int)load_be32(m[3] + (o)), (int)load_be32(m[2] + (o)), \
+		      (int)load_be32(m[1] + (o)), (int)load_be32(m[0] + (o)))
+
+SHA1_LANES(sha1_sse2, __m128i, 4)
+
+#undef ADD
+#undef AND
+#undef ANDNOT
+#undef OR
+#undef XOR
+#undef ROL
+#undef SET1
+#undef LOAD
+#undef STORE
+#undef GATHER
+
+#ifdef SHA1_AVX2
+#define ADD(a, b)	_mm256_add_epi32(a, b)
+#define AND(a, b)	_mm256_and_si256(a, b)
+#define ANDNOT(a, b)	_mm256_andnot_si256(a, b)
+#define OR(a, b)	_mm256_or_si256(a, b)
+#define XOR(a, b)	_mm256_xor_si256(a, b)
+#define ROL(a, n)	_mm256_or_si256(_mm256_slli_epi32(a, n), \
+					_mm256_srli_epi32(a, 32 - (n)))
+#define SET1(v)		_mm256_set1_epi32((int)(v))
+#define LOAD(p)		_mm256_loadu_si256((const __m256i *)(p))
+#define STORE(p, v)	_mm256_storeu_si256((__m256i *)(p), v)
+#define GATHER(m, o) \
+	_mm256_set_epi32((int)load_be32(m[7] + (o)), \
+			 (int)load_be32(m[6] + (o)), \
+			 (int)load_be32(m[5] + (o)), \
+			 (int)load_be32(m[4] + (o)), \
+			 (int)load_be32(m[3] + (o)), \
+			 (int)load_be32(m[2] + (o)), \
+			 (int)load_be32(m[1] + (o)), \
+			 (int)load_be32(m[0] + (o)))
+
+__attribute__((target("avx2")))
+SHA1_LANES(sha1_avx2, __m256i, 8)
+
+#undef ADD
+#undef AND
+#undef ANDNOT
+#undef OR
+#undef XOR
+#undef ROL
+#undef SET1
+#undef LOAD
+#undef STORE
+#undef GATHER
+
+static isc_once_t once = ISC_ONCE_INIT;
+static isc_boolean_t have_avx2 = ISC_FALSE;
+
+static void
+check_cpu(void) {
+	have_avx2 = ISC_TF(__builtin_cpu_supports("avx2"));
+}
+#endif /* SHA1_AVX2 */
+
+/*
+ * Hash 'count' (at most 'lanes') names with a kernel of 'lanes' lanes,
+ * filling the unused lanes with copies of the first name.
+ */
+static void
+hash_lanes(void (*kernel)(unsigned char **, int, const unsigned char *, int,
+			  const unsigned char **, const int *),
+	   unsigned int lanes, unsigned char **out, int iterations,
+	   const unsigned char *salt, int saltlength,
+	   const unsigned char **in, const int *inlength, unsigned int count)
+{
+	unsigned char spare[SHA1_MAXLANES][ISC_SHA1_DIGESTLENGTH];
+	unsigned char *o[SHA1_MAXLANES];
+	const unsigned char *i[SHA1_MAXLANES];
+	int il[SHA1_MAXLANES];
+	unsigned int l;
+
+	for (l = 0; l < lanes; l++) {
+		if (l < count) {
+			o[l] = out[l];
+			i[l] = in[l];
+			il[l] = inlength[l];
+		} else {
+			o[l] = spare[l];
+			i[l] = in[0];
+			il[l] = inlength[0];
+		}
+	}
+	(*kernel)(o, iterations, salt, saltlength, i, il);
+}
+#endif /* SHA1_SSE2 */
+
+int
+isc_iterated_hash_batch(unsigned char **out, unsigned int hashalg,
+			int iterations, const unsigned char *salt,
+			int saltlength, const unsigned char **in,
+			const int *inlength, unsigned int count)
+{
+	unsigned int done = 0;
+
+	REQUIRE(saltlength >= 0 && saltlength <= 255);
+
+	if (hashalg != 1)
+		return (0);
+
+	for (done = 0; done < count; done++)
+		REQUIRE(inlength[done] >= 0 && inlength[done] <= 255);
+	done = 0;
+
+#ifdef SHA1_SSE2
+#ifdef SHA1_AVX2
+	RUNTIME_CHECK(isc_once_do(&once, check_cpu) == ISC_R_SUCCESS);
+	while (have_avx2 && count - done > 4) {
+		unsigned int n = ISC_MIN(count - done, 8);
+
+		hash_lanes(sha1_avx2, 8, out + done, iterations, salt,
+			   saltlength, in + done, inlength + done, n);
+		done += n;
+	}
+#endif
+	while (count - done > 1) {
+		unsigned int n = ISC_MIN(count - done, 4);
+
+		hash_lanes(sha1_sse2, 4, out + done, iterations, salt,
+			   saltlength, in + done, inlength + done, n);
+		done += n;
+	}
+#endif
+
+	for (; done < count; done++)
+		(void)isc_iterated_hash(out[done], hashalg, iterations,
+					salt, saltlength,
+					in[done], inlength[done]);
+
+	return (ISC_SHA1_DIGESTLENGTH);
+}
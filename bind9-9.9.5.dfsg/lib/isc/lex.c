@@ -947,6 +947,19 @@ isc_lex_setsourcename(isc_lex_t *lex, const char *name) {
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc_lex_setsourceline(isc_lex_t *lex, unsigned long line) {
+	inputsource *source;
+
+	REQUIRE(VALID_LEX(lex));
+	source = HEAD(lex->sources);
+
+	if (source == NULL)
+		return(ISC_R_NOTFOUND);
+	source->line = line;
+	return (ISC_R_SUCCESS);
+}
+
 isc_boolean_t
 isc_lex_isfile(isc_lex_t *lex) {
 	inputsource *source;
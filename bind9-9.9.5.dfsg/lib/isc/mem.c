@@ -34,6 +34,7 @@
 #include <isc/ondestroy.h>
 #include <isc/string.h>
 #include <isc/mutex.h>
+#include <isc/thread.h>
 #include <isc/print.h>
 #include <isc/util.h>
 #include <isc/xml.h>
@@ -57,6 +58,22 @@ LIBISC_EXTERNAL_DATA unsigned int isc_mem_debugging = ISC_MEM_DEBUGGING;
 #define TABLE_INCREMENT		1024
 #define DEBUGLIST_COUNT		1024
 
+/*
+ * Per-thread caches are only useful (and only possible) with threads.
+ */
+#if defined(ISC_PLATFORM_USETHREADS) && !defined(ISC_MEM_NOTCACHE)
+#define USE_TCACHE
+#endif
+
+#ifdef USE_TCACHE
+#define TCACHE_SLOTS		64		/*%< threads that get a cache */
+#define TCACHE_MAXSIZE		512		/*%< largest cached block */
+#define TCACHE_NCLASSES		(TCACHE_MAXSIZE / ALIGNMENT_SIZE + 1)
+#define TCACHE_FILL		8		/*%< blocks moved at a time */
+#define TCACHE_DEPTH		16		/*%< blocks kept per size */
+#define TCACHE_MAXBYTES		32768		/*%< bytes kept per thread */
+#endif
+
 /*
  * Types.
  */
@@ -104,6 +121,32 @@ struct stats {
 	unsigned long		freefrags;
 };
 
+#ifdef USE_TCACHE
+/*%
+ * A thread's cache of small blocks for one memory context.  The blocks
+ * have already been taken from the context, so the context counts them
+ * as in use (under their rounded-up size) until they are given back.
+ * Only the owning thread touches the blocks, so they are not locked;
+ * 'gen' is only read or written with the context locked.
+ */
+typedef struct mem_tcache {
+	element *		items[TCACHE_NCLASSES];
+	unsigned int		count[TCACHE_NCLASSES];
+	size_t			bytes;
+	unsigned int		gen;	/*%< context's tcache_gen when filled */
+} mem_tcache_t;
+
+/*%
+ * A thread's cache of items for one memory pool.  The items are counted
+ * as allocated by the pool until they are given back.
+ */
+typedef struct mempool_tcache {
+	element *		items;
+	unsigned int		count;
+	unsigned int		gen;	/*%< pool's tcache_gen when filled */
+} mempool_tcache_t;
+#endif
+
 #define MEM_MAGIC		ISC_MAGIC('M', 'e', 'm', 'C')
 #define VALID_CONTEXT(c)	ISC_MAGIC_VALID(c, MEM_MAGIC)
 
@@ -123,6 +166,23 @@ static isc_mutex_t		lock;
  */
 static isc_uint64_t		totallost;
 
+#ifdef USE_TCACHE
+/*%
+ * Each thread that allocates is given a cache slot number, kept in
+ * thread-specific data as a pointer into tcache_ids[].  tcache_ids[
+ * TCACHE_SLOTS] means that no slot was free.  The slot is given back
+ * when the thread exits, and its caches pass to the next thread that
+ * takes it.  The free slot list and tcache_owned[] are locked by the
+ * global lock.
+ */
+static isc_thread_key_t		tcache_key;
+static unsigned int		tcache_ids[TCACHE_SLOTS + 1];
+static isc_boolean_t		tcache_owned[TCACHE_SLOTS];
+static unsigned int		tcache_free[TCACHE_SLOTS];
+static unsigned int		tcache_nfree;
+static unsigned int		tcache_next;
+#endif
+
 struct isc__mem {
 	isc_mem_t		common;
 	isc_ondestroy_t		ondestroy;
@@ -166,6 +226,10 @@ struct isc__mem {
 #endif
 
 	unsigned int		memalloc_failures;
+#ifdef USE_TCACHE
+	mem_tcache_t **		tcaches;	/*%< per thread slot */
+	unsigned int		tcache_gen;	/*%< bumped on limit changes */
+#endif
 	ISC_LINK(isc__mem_t)	link;
 };
 
@@ -189,6 +253,11 @@ struct isc__mempool {
 	unsigned int	fillcount;	/*%< # of items to fetch on each fill */
 	/*%< Stats only. */
 	unsigned int	gets;		/*%< # of requests to this pool */
+#ifdef USE_TCACHE
+	/*%< Per thread slot, owned by that thread; set with the lock. */
+	mempool_tcache_t *tcaches;
+	unsigned int	tcache_gen;	/*%< bumped when maxalloc changes */
+#endif
 	/*%< Debugging only. */
 #if ISC_MEMPOOL_NAMES
 	char		name[16];	/*%< printed name in stats reports */
@@ -862,6 +931,320 @@ mem_putstats(isc__mem_t *ctx, void *ptr, size_t size) {
 	}
 }
 
+/*!
+ * Check the high water mark after memory was allocated; the context must
+ * be locked.  Returns ISC_TRUE if the water function should be called.
+ */
+static inline isc_boolean_t
+check_hiwater(isc__mem_t *ctx) {
+	isc_boolean_t call_water = ISC_FALSE;
+
+	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+	    !ctx->is_overmem) {
+		ctx->is_overmem = ISC_TRUE;
+	}
+	if (ctx->hi_water != 0U && !ctx->hi_called &&
+	    ctx->inuse > ctx->hi_water) {
+		call_water = ISC_TRUE;
+	}
+	if (ctx->inuse > ctx->maxinuse) {
+		ctx->maxinuse = ctx->inuse;
+		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
+		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
+			fprintf(stderr, "maxinuse = %lu\n",
+				(unsigned long)ctx->inuse);
+	}
+
+	return (call_water);
+}
+
+/*!
+ * Check the low water mark after memory was freed; the context must be
+ * locked.  Returns ISC_TRUE if the water function should be called.
+ */
+static inline isc_boolean_t
+check_lowater(isc__mem_t *ctx) {
+	isc_boolean_t call_water = ISC_FALSE;
+
+	/*
+	 * The check against ctx->lo_water == 0 is for the condition
+	 * when the context was pushed over hi_water but then had
+	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
+	 */
+	if (ctx->is_overmem &&
+	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+		ctx->is_overmem = ISC_FALSE;
+	}
+	if (ctx->hi_called &&
+	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
+		if (ctx->water != NULL)
+			call_water = ISC_TRUE;
+	}
+
+	return (call_water);
+}
+
+#ifdef USE_TCACHE
+/*!
+ * Return this thread's cache slot, or -1 if it has none.
+ */
+static inline int
+tcache_slot(void) {
+	unsigned int *id;
+	unsigned int slot;
+
+	id = isc_thread_key_getspecific(tcache_key);
+	if (id == NULL) {
+		LOCK(&lock);
+		if (tcache_nfree > 0)
+			slot = tcache_free[--tcache_nfree];
+		else if (tcache_next < TCACHE_SLOTS)
+			slot = tcache_next++;
+		else
+			slot = TCACHE_SLOTS;
+		if (slot != TCACHE_SLOTS)
+			tcache_owned[slot] = ISC_TRUE;
+		UNLOCK(&lock);
+		id = &tcache_ids[slot];
+		(void)isc_thread_key_setspecific(tcache_key, id);
+	}
+
+	if (*id == TCACHE_SLOTS)
+		return (-1);
+	return ((int)*id);
+}
+
+/*!
+ * Thread exit: give the thread's slot back.
+ */
+static void
+tcache_release(void *arg) {
+	unsigned int *id = arg;
+
+	if (*id == TCACHE_SLOTS)
+		return;
+	LOCK(&lock);
+	INSIST(tcache_nfree < TCACHE_SLOTS);
+	tcache_owned[*id] = ISC_FALSE;
+	tcache_free[tcache_nfree++] = *id;
+	UNLOCK(&lock);
+}
+
+/*!
+ * Can a block of 'size' bytes from 'ctx' go through a thread cache?
+ * The answer must not change between the get and the put of a block.
+ */
+static inline isc_boolean_t
+tcache_eligible(isc__mem_t *ctx, size_t size) {
+	size_t new_size = quantize(size);
+
+	return (ISC_TF(ctx->tcaches != NULL && new_size <= TCACHE_MAXSIZE &&
+		       size < ctx->max_size && new_size < ctx->max_size));
+}
+
+/*!
+ * Give 'count' blocks of 'new_size' bytes from the thread cache 'tc'
+ * back to the context; the context must be locked.
+ */
+static inline void
+tcache_drain(isc__mem_t *ctx, mem_tcache_t *tc, size_t new_size,
+	     unsigned int count)
+{
+	unsigned int cls = new_size / ALIGNMENT_SIZE;
+	element *item;
+
+	while (count-- > 0 && tc->items[cls] != NULL) {
+		item = tc->items[cls];
+		tc->items[cls] = item->next;
+		tc->count[cls]--;
+		tc->bytes -= new_size;
+		mem_putunlocked(ctx, item, new_size);
+	}
+}
+
+/*!
+ * Give every block in the thread cache 'tc' back to the context; the
+ * context must be locked.
+ */
+static void
+tcache_drainall(isc__mem_t *ctx, mem_tcache_t *tc) {
+	unsigned int cls;
+
+	for (cls = 1; cls < TCACHE_NCLASSES; cls++)
+		tcache_drain(ctx, tc, cls * ALIGNMENT_SIZE, tc->count[cls]);
+	INSIST(tc->bytes == 0U);
+	tc->gen = ctx->tcache_gen;
+}
+
+/*!
+ * The quota or water marks of 'ctx' changed, so blocks idling in thread
+ * caches should stop counting against them.  Empty the caches that no
+ * running thread owns and the caller's own ('self', or -1); the other
+ * threads empty theirs the next time they lock 'ctx' to refill or spill
+ * their cache (see tcache_checkgen()).  Both the global lock and the
+ * context must be locked.
+ */
+static void
+tcache_limitchanged(isc__mem_t *ctx, int self) {
+	unsigned int i;
+
+	ctx->tcache_gen++;
+	for (i = 0; i < TCACHE_SLOTS; i++) {
+		if (ctx->tcaches[i] == NULL ||
+		    (tcache_owned[i] && (int)i != self))
+			continue;
+		tcache_drainall(ctx, ctx->tcaches[i]);
+	}
+}
+
+/*!
+ * If a limit of 'ctx' changed since the thread cache 'tc' was filled,
+ * empty it; the context must be locked.  Until then the thread only
+ * hands out blocks that the context already counts as in use, so this
+ * can't take it over its quota.
+ */
+static inline void
+tcache_checkgen(isc__mem_t *ctx, mem_tcache_t *tc) {
+	if (tc->gen != ctx->tcache_gen)
+		tcache_drainall(ctx, tc);
+}
+
+/*!
+ * Return the calling thread's cache for 'ctx', creating it if needed,
+ * or NULL if the thread can't have one.
+ */
+static inline mem_tcache_t *
+tcache_self(isc__mem_t *ctx) {
+	mem_tcache_t *tc;
+	int slot;
+
+	slot = tcache_slot();
+	if (slot < 0)
+		return (NULL);
+
+	/*
+	 * Only this thread sets its slot, so it can read it unlocked;
+	 * tcache_limitchanged() walks the slots with the context locked.
+	 */
+	tc = ctx->tcaches[slot];
+	if (tc == NULL) {
+		tc = (ctx->memalloc)(ctx->arg, sizeof(*tc));
+		if (tc == NULL)
+			return (NULL);
+		memset(tc, 0, sizeof(*tc));
+		MCTXLOCK(ctx, &ctx->lock);
+		tc->gen = ctx->tcache_gen;
+		ctx->tcaches[slot] = tc;
+		MCTXUNLOCK(ctx, &ctx->lock);
+	}
+
+	return (tc);
+}
+
+/*!
+ * Get a block of 'new_size' (already quantized) bytes from the thread
+ * cache 'tc', refilling it from the context when it is empty.
+ */
+static inline void *
+tcache_get(isc__mem_t *ctx, mem_tcache_t *tc, size_t new_size) {
+	unsigned int cls = new_size / ALIGNMENT_SIZE;
+	isc_boolean_t call_water = ISC_FALSE;
+	element *item;
+	unsigned int i;
+
+	if (tc->items[cls] == NULL) {
+		MCTXLOCK(ctx, &ctx->lock);
+		tcache_checkgen(ctx, tc);
+		for (i = 0; i < TCACHE_FILL; i++) {
+			item = mem_getunlocked(ctx, new_size);
+			if (item == NULL)
+				break;
+			item->next = tc->items[cls];
+			tc->items[cls] = item;
+			tc->count[cls]++;
+			tc->bytes += new_size;
+		}
+		call_water = check_hiwater(ctx);
+		MCTXUNLOCK(ctx, &ctx->lock);
+
+		if (call_water)
+			(ctx->water)(ctx->water_arg, ISC_MEM_HIWATER);
+		if (tc->items[cls] == NULL)
+			return (NULL);
+	}
+
+	item = tc->items[cls];
+	tc->items[cls] = item->next;
+	tc->count[cls]--;
+	tc->bytes -= new_size;
+
+#if ISC_MEM_FILL
+	memset(item, 0xbe, new_size); /* Mnemonic for "beef". */
+#endif
+
+	return (item);
+}
+
+/*!
+ * Put a block of 'size' bytes (rounding up to 'new_size') into the
+ * thread cache 'tc', handing some back to the context when the cache
+ * gets too big.
+ */
+static inline void
+tcache_put(isc__mem_t *ctx, mem_tcache_t *tc, void *mem, size_t size,
+	   size_t new_size)
+{
+	unsigned int cls = new_size / ALIGNMENT_SIZE;
+	isc_boolean_t call_water = ISC_FALSE;
+	element *item = mem;
+
+#if ISC_MEM_FILL
+#if ISC_MEM_CHECKOVERRUN
+	check_overrun(mem, size, new_size);
+#endif
+	memset(mem, 0xde, new_size); /* Mnemonic for "dead". */
+#else
+	UNUSED(size);
+#endif
+
+	item->next = tc->items[cls];
+	tc->items[cls] = item;
+	tc->count[cls]++;
+	tc->bytes += new_size;
+
+	if (tc->count[cls] > TCACHE_DEPTH || tc->bytes > TCACHE_MAXBYTES) {
+		MCTXLOCK(ctx, &ctx->lock);
+		tcache_checkgen(ctx, tc);
+		tcache_drain(ctx, tc, new_size, TCACHE_FILL);
+		call_water = check_lowater(ctx);
+		MCTXUNLOCK(ctx, &ctx->lock);
+
+		if (call_water)
+			(ctx->water)(ctx->water_arg, ISC_MEM_LOWATER);
+	}
+}
+
+/*!
+ * Give back every thread's cached blocks and free the caches.  Nothing
+ * else may be using 'ctx'.
+ */
+static void
+tcache_destroy(isc__mem_t *ctx) {
+	mem_tcache_t *tc;
+	unsigned int i;
+
+	for (i = 0; i < TCACHE_SLOTS; i++) {
+		tc = ctx->tcaches[i];
+		if (tc == NULL)
+			continue;
+		tcache_drainall(ctx, tc);
+		(ctx->memfree)(ctx->arg, tc);
+	}
+	(ctx->memfree)(ctx->arg, ctx->tcaches);
+	ctx->tcaches = NULL;
+}
+#endif /* USE_TCACHE */
+
 /*
  * Private.
  */
@@ -882,9 +1265,23 @@ default_memfree(void *arg, void *ptr) {
 
 static void
 initialize_action(void) {
+#ifdef USE_TCACHE
+	unsigned int i;
+#endif
+
 	RUNTIME_CHECK(isc_mutex_init(&lock) == ISC_R_SUCCESS);
 	ISC_LIST_INIT(contexts);
 	totallost = 0;
+#ifdef USE_TCACHE
+	RUNTIME_CHECK(isc_thread_key_create(&tcache_key,
+					    tcache_release) == 0);
+	for (i = 0; i <= TCACHE_SLOTS; i++)
+		tcache_ids[i] = i;
+	for (i = 0; i < TCACHE_SLOTS; i++)
+		tcache_owned[i] = ISC_FALSE;
+	tcache_nfree = 0;
+	tcache_next = 0;
+#endif
 }
 
 /*
@@ -969,6 +1366,10 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 	ctx->basic_table_size = 0;
 	ctx->lowest = NULL;
 	ctx->highest = NULL;
+#ifdef USE_TCACHE
+	ctx->tcaches = NULL;
+	ctx->tcache_gen = 0;
+#endif
 
 	ctx->stats = (memalloc)(arg,
 				(ctx->max_size+1) * sizeof(struct stats));
@@ -993,6 +1394,23 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 		       ctx->max_size * sizeof(element *));
 	}
 
+#ifdef USE_TCACHE
+	/*
+	 * Give small allocations per-thread caches, unless memory is being
+	 * debugged and so every allocation needs to be seen.
+	 */
+	if ((flags & ISC_MEMFLAG_INTERNAL) != 0 &&
+	    (flags & ISC_MEMFLAG_NOLOCK) == 0 && isc_mem_debugging == 0) {
+		ctx->tcaches = (memalloc)(arg,
+					  TCACHE_SLOTS * sizeof(mem_tcache_t *));
+		if (ctx->tcaches == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto error;
+		}
+		memset(ctx->tcaches, 0, TCACHE_SLOTS * sizeof(mem_tcache_t *));
+	}
+#endif
+
 #if ISC_MEM_TRACKLINES
 	if ((isc_mem_debugging & ISC_MEM_DEBUGRECORD) != 0) {
 		unsigned int i;
@@ -1023,6 +1441,10 @@ isc__mem_createx2(size_t init_max_size, size_t target_size,
 			(memfree)(arg, ctx->stats);
 		if (ctx->freelists != NULL)
 			(memfree)(arg, ctx->freelists);
+#ifdef USE_TCACHE
+		if (ctx->tcaches != NULL)
+			(memfree)(arg, ctx->tcaches);
+#endif
 #if ISC_MEM_TRACKLINES
 		if (ctx->debuglist != NULL)
 			(ctx->memfree)(ctx->arg, ctx->debuglist);
@@ -1056,6 +1478,11 @@ destroy(isc__mem_t *ctx) {
 	unsigned int i;
 	isc_ondestroy_t ondest;
 
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL)
+		tcache_destroy(ctx);
+#endif
+
 	LOCK(&lock);
 	ISC_LIST_UNLINK(contexts, ctx, link);
 	totallost += ctx->inuse;
@@ -1205,6 +1632,13 @@ isc___mem_putanddetach(isc_mem_t **ctxp, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef USE_TCACHE
+	/*
+	 * Cached blocks are accounted under their rounded-up size.
+	 */
+	if (tcache_eligible(ctx, size))
+		size = quantize(size);
+#endif
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		mem_putunlocked(ctx, ptr, size);
@@ -1270,12 +1704,24 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
 	void *ptr;
 	isc_boolean_t call_water = ISC_FALSE;
+#ifdef USE_TCACHE
+	mem_tcache_t *tc;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 
 	if ((isc_mem_debugging & (ISC_MEM_DEBUGSIZE|ISC_MEM_DEBUGCTX)) != 0)
 		return (isc__mem_allocate(ctx0, size FLARG_PASS));
 
+#ifdef USE_TCACHE
+	if (tcache_eligible(ctx, size)) {
+		size = quantize(size);
+		tc = tcache_self(ctx);
+		if (tc != NULL)
+			return (tcache_get(ctx, tc, size));
+	}
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		ptr = mem_getunlocked(ctx, size);
@@ -1287,21 +1733,7 @@ isc___mem_get(isc_mem_t *ctx0, size_t size FLARG) {
 	}
 
 	ADD_TRACE(ctx, ptr, size, file, line);
-	if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-	    !ctx->is_overmem) {
-		ctx->is_overmem = ISC_TRUE;
-	}
-	if (ctx->hi_water != 0U && !ctx->hi_called &&
-	    ctx->inuse > ctx->hi_water) {
-		call_water = ISC_TRUE;
-	}
-	if (ctx->inuse > ctx->maxinuse) {
-		ctx->maxinuse = ctx->inuse;
-		if (ctx->hi_water != 0U && ctx->inuse > ctx->hi_water &&
-		    (isc_mem_debugging & ISC_MEM_DEBUGUSAGE) != 0)
-			fprintf(stderr, "maxinuse = %lu\n",
-				(unsigned long)ctx->inuse);
-	}
+	call_water = check_hiwater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water)
@@ -1316,6 +1748,9 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	isc_boolean_t call_water = ISC_FALSE;
 	size_info *si;
 	size_t oldsize;
+#ifdef USE_TCACHE
+	mem_tcache_t *tc;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(ptr != NULL);
@@ -1332,6 +1767,17 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 		return;
 	}
 
+#ifdef USE_TCACHE
+	if (tcache_eligible(ctx, size)) {
+		tc = tcache_self(ctx);
+		if (tc != NULL) {
+			tcache_put(ctx, tc, ptr, size, quantize(size));
+			return;
+		}
+		size = quantize(size);
+	}
+#endif
+
 	if ((ctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
 		MCTXLOCK(ctx, &ctx->lock);
 		mem_putunlocked(ctx, ptr, size);
@@ -1342,21 +1788,7 @@ isc___mem_put(isc_mem_t *ctx0, void *ptr, size_t size FLARG) {
 	}
 
 	DELETE_TRACE(ctx, ptr, size, file, line);
-
-	/*
-	 * The check against ctx->lo_water == 0 is for the condition
-	 * when the context was pushed over hi_water but then had
-	 * isc_mem_setwater() called with 0 for hi_water and lo_water.
-	 */
-	if (ctx->is_overmem &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
-		ctx->is_overmem = ISC_FALSE;
-	}
-	if (ctx->hi_called &&
-	    (ctx->inuse < ctx->lo_water || ctx->lo_water == 0U)) {
-		if (ctx->water != NULL)
-			call_water = ISC_TRUE;
-	}
+	call_water = check_lowater(ctx);
 	MCTXUNLOCK(ctx, &ctx->lock);
 
 	if (call_water)
@@ -1708,13 +2140,35 @@ isc__mem_setdestroycheck(isc_mem_t *ctx0, isc_boolean_t flag) {
 ISC_MEMFUNC_SCOPE void
 isc__mem_setquota(isc_mem_t *ctx0, size_t quota) {
 	isc__mem_t *ctx = (isc__mem_t *)ctx0;
+#ifdef USE_TCACHE
+	int self = -1;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL) {
+		self = tcache_slot();
+		LOCK(&lock);
+	}
+#endif
 	MCTXLOCK(ctx, &ctx->lock);
 
 	ctx->quota = quota;
+#ifdef USE_TCACHE
+	/*
+	 * If the drained blocks bring 'inuse' below the low water mark,
+	 * the callback is left to the next put that gives memory back to
+	 * the context; it is not called from here.
+	 */
+	if (ctx->tcaches != NULL)
+		tcache_limitchanged(ctx, self);
+#endif
 
 	MCTXUNLOCK(ctx, &ctx->lock);
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL)
+		UNLOCK(&lock);
+#endif
 }
 
 ISC_MEMFUNC_SCOPE size_t
@@ -1755,11 +2209,24 @@ isc__mem_setwater(isc_mem_t *ctx0, isc_mem_water_t water, void *water_arg,
 	isc_boolean_t callwater = ISC_FALSE;
 	isc_mem_water_t oldwater;
 	void *oldwater_arg;
+#ifdef USE_TCACHE
+	int self = -1;
+#endif
 
 	REQUIRE(VALID_CONTEXT(ctx));
 	REQUIRE(hiwater >= lowater);
 
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL) {
+		self = tcache_slot();
+		LOCK(&lock);
+	}
+#endif
 	MCTXLOCK(ctx, &ctx->lock);
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL)
+		tcache_limitchanged(ctx, self);
+#endif
 	oldwater = ctx->water;
 	oldwater_arg = ctx->water_arg;
 	if (water == NULL) {
@@ -1781,6 +2248,10 @@ isc__mem_setwater(isc_mem_t *ctx0, isc_mem_water_t water, void *water_arg,
 		ctx->hi_called = ISC_FALSE;
 	}
 	MCTXUNLOCK(ctx, &ctx->lock);
+#ifdef USE_TCACHE
+	if (ctx->tcaches != NULL)
+		UNLOCK(&lock);
+#endif
 
 	if (callwater && oldwater != NULL)
 		(oldwater)(oldwater_arg, ISC_MEM_LOWATER);
@@ -1868,6 +2339,10 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	mpctx->name[0] = 0;
 #endif
 	mpctx->items = NULL;
+#ifdef USE_TCACHE
+	mpctx->tcaches = NULL;
+	mpctx->tcache_gen = 0;
+#endif
 
 	*mpctxp = (isc_mempool_t *)mpctx;
 
@@ -1879,6 +2354,111 @@ isc__mempool_create(isc_mem_t *mctx0, size_t size, isc_mempool_t **mpctxp) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Fill the pool's free list from its memory context.  The pool must be
+ * locked if it has a lock.
+ */
+static void
+mempool_fill(isc__mempool_t *mpctx) {
+	isc__mem_t *mctx = mpctx->mctx;
+	element *item;
+	unsigned int i;
+
+	MCTXLOCK(mctx, &mctx->lock);
+	for (i = 0; i < mpctx->fillcount; i++) {
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			item = mem_getunlocked(mctx, mpctx->size);
+		} else {
+			item = mem_get(mctx, mpctx->size);
+			if (item != NULL)
+				mem_getstats(mctx, mpctx->size);
+		}
+		if (item == NULL)
+			break;
+		item->next = mpctx->items;
+		mpctx->items = item;
+		mpctx->freecount++;
+	}
+	MCTXUNLOCK(mctx, &mctx->lock);
+}
+
+/*
+ * Take back an item that is no longer allocated, keeping it on the free
+ * list unless that is full.  The pool must be locked if it has a lock.
+ */
+static void
+mempool_release(isc__mempool_t *mpctx, element *item) {
+	isc__mem_t *mctx = mpctx->mctx;
+
+	if (mpctx->freecount >= mpctx->freemax) {
+		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
+			MCTXLOCK(mctx, &mctx->lock);
+			mem_putunlocked(mctx, item, mpctx->size);
+			MCTXUNLOCK(mctx, &mctx->lock);
+		} else {
+			mem_put(mctx, item, mpctx->size);
+			MCTXLOCK(mctx, &mctx->lock);
+			mem_putstats(mctx, item, mpctx->size);
+			MCTXUNLOCK(mctx, &mctx->lock);
+		}
+		return;
+	}
+
+	mpctx->freecount++;
+	item->next = mpctx->items;
+	mpctx->items = item;
+}
+
+#ifdef USE_TCACHE
+/*
+ * Give up to 'count' items from the thread cache 'pc' back to the pool.
+ * The pool must be locked.
+ */
+static inline void
+mempool_drain(isc__mempool_t *mpctx, mempool_tcache_t *pc,
+	      unsigned int count)
+{
+	element *item;
+
+	while (count-- > 0 && pc->items != NULL) {
+		item = pc->items;
+		pc->items = item->next;
+		pc->count--;
+		INSIST(mpctx->allocated > 0);
+		mpctx->allocated--;
+		mempool_release(mpctx, item);
+	}
+}
+/*
+ * Return the calling thread's cache for 'mpctx', or NULL if the item
+ * has to come from the shared free list.  Pools with an allocation
+ * limit are not cached, so the limit can't be taken up by idle items;
+ * a cache filled before the limit was set is emptied here.
+ */
+static inline mempool_tcache_t *
+mempool_tcache(isc__mempool_t *mpctx) {
+	mempool_tcache_t *pc;
+	int slot;
+
+	if (mpctx->tcaches == NULL)
+		return (NULL);
+	slot = tcache_slot();
+	if (slot < 0)
+		return (NULL);
+	pc = &mpctx->tcaches[slot];
+	if (pc->gen != mpctx->tcache_gen) {
+		LOCK(mpctx->lock);
+		mempool_drain(mpctx, pc, pc->count);
+		pc->gen = mpctx->tcache_gen;
+		UNLOCK(mpctx->lock);
+	}
+	if (mpctx->maxalloc != UINT_MAX)
+		return (NULL);
+	return (pc);
+}
+
+#endif /* USE_TCACHE */
+
 ISC_MEMFUNC_SCOPE void
 isc__mempool_setname(isc_mempool_t *mpctx0, const char *name) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
@@ -1911,6 +2491,24 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	REQUIRE(mpctxp != NULL);
 	mpctx = (isc__mempool_t *)*mpctxp;
 	REQUIRE(VALID_MEMPOOL(mpctx));
+
+#ifdef USE_TCACHE
+	/*
+	 * Take back the items still sitting in thread caches.
+	 */
+	if (mpctx->tcaches != NULL) {
+		unsigned int i;
+
+		if (mpctx->lock != NULL)
+			LOCK(mpctx->lock);
+		for (i = 0; i < TCACHE_SLOTS; i++)
+			mempool_drain(mpctx, &mpctx->tcaches[i],
+				      mpctx->tcaches[i].count);
+		if (mpctx->lock != NULL)
+			UNLOCK(mpctx->lock);
+	}
+#endif
+
 #if ISC_MEMPOOL_NAMES
 	if (mpctx->allocated > 0)
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
@@ -1954,6 +2552,12 @@ isc__mempool_destroy(isc_mempool_t **mpctxp) {
 	mctx->poolcnt--;
 	MCTXUNLOCK(mctx, &mctx->lock);
 
+#ifdef USE_TCACHE
+	if (mpctx->tcaches != NULL)
+		isc_mem_put((isc_mem_t *)mctx, mpctx->tcaches,
+			    TCACHE_SLOTS * sizeof(mempool_tcache_t));
+#endif
+
 	mpctx->common.impmagic = 0;
 	mpctx->common.magic = 0;
 
@@ -1974,6 +2578,23 @@ isc__mempool_associatelock(isc_mempool_t *mpctx0, isc_mutex_t *lock) {
 	REQUIRE(lock != NULL);
 
 	mpctx->lock = lock;
+
+#ifdef USE_TCACHE
+	/*
+	 * A pool with a lock is shared between threads, so give each
+	 * thread a cache of items.  This is only an optimization, so
+	 * failing to allocate the caches is not an error.  Contexts
+	 * without caches are being debugged; leave their pools alone too.
+	 */
+	if (mpctx->mctx->tcaches != NULL) {
+		mpctx->tcaches = isc_mem_get((isc_mem_t *)mpctx->mctx,
+					     TCACHE_SLOTS *
+					     sizeof(mempool_tcache_t));
+		if (mpctx->tcaches != NULL)
+			memset(mpctx->tcaches, 0,
+			       TCACHE_SLOTS * sizeof(mempool_tcache_t));
+	}
+#endif
 }
 
 ISC_MEMFUNC_SCOPE void *
@@ -1981,12 +2602,51 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	element *item;
 	isc__mem_t *mctx;
+#ifdef USE_TCACHE
+	mempool_tcache_t *pc;
 	unsigned int i;
+#endif
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
 	mctx = mpctx->mctx;
 
+#ifdef USE_TCACHE
+	pc = mempool_tcache(mpctx);
+	if (pc != NULL) {
+		if (pc->items == NULL) {
+			/*
+			 * Move a batch of items into this thread's cache;
+			 * they count as allocated from now on.
+			 */
+			LOCK(mpctx->lock);
+			for (i = 0; i < TCACHE_FILL; i++) {
+				if (mpctx->items == NULL)
+					mempool_fill(mpctx);
+				item = mpctx->items;
+				if (item == NULL)
+					break;
+				mpctx->items = item->next;
+				INSIST(mpctx->freecount > 0);
+				mpctx->freecount--;
+				mpctx->gets++;
+				mpctx->allocated++;
+				item->next = pc->items;
+				pc->items = item;
+				pc->count++;
+			}
+			UNLOCK(mpctx->lock);
+		}
+
+		item = pc->items;
+		if (item != NULL) {
+			pc->items = item->next;
+			pc->count--;
+		}
+		return (item);
+	}
+#endif
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2015,22 +2675,7 @@ isc___mempool_get(isc_mempool_t *mpctx0 FLARG) {
 	 * We need to dip into the well.  Lock the memory context here and
 	 * fill up our free list.
 	 */
-	MCTXLOCK(mctx, &mctx->lock);
-	for (i = 0; i < mpctx->fillcount; i++) {
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			item = mem_getunlocked(mctx, mpctx->size);
-		} else {
-			item = mem_get(mctx, mpctx->size);
-			if (item != NULL)
-				mem_getstats(mctx, mpctx->size);
-		}
-		if (item == NULL)
-			break;
-		item->next = mpctx->items;
-		mpctx->items = item;
-		mpctx->freecount++;
-	}
-	MCTXUNLOCK(mctx, &mctx->lock);
+	mempool_fill(mpctx);
 
 	/*
 	 * If we didn't get any items, return NULL.
@@ -2063,13 +2708,32 @@ ISC_MEMFUNC_SCOPE void
 isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
 	isc__mem_t *mctx;
+#ifdef USE_TCACHE
+	mempool_tcache_t *pc;
 	element *item;
+#endif
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
 	mctx = mpctx->mctx;
 
+#ifdef USE_TCACHE
+	pc = mempool_tcache(mpctx);
+	if (pc != NULL) {
+		item = (element *)mem;
+		item->next = pc->items;
+		pc->items = item;
+		pc->count++;
+		if (pc->count > TCACHE_DEPTH) {
+			LOCK(mpctx->lock);
+			mempool_drain(mpctx, pc, TCACHE_FILL);
+			UNLOCK(mpctx->lock);
+		}
+		return;
+	}
+#endif
+
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
@@ -2083,31 +2747,10 @@ isc___mempool_put(isc_mempool_t *mpctx0, void *mem FLARG) {
 #endif /* ISC_MEM_TRACKLINES */
 
 	/*
-	 * If our free list is full, return this to the mctx directly.
-	 */
-	if (mpctx->freecount >= mpctx->freemax) {
-		if ((mctx->flags & ISC_MEMFLAG_INTERNAL) != 0) {
-			MCTXLOCK(mctx, &mctx->lock);
-			mem_putunlocked(mctx, mem, mpctx->size);
-			MCTXUNLOCK(mctx, &mctx->lock);
-		} else {
-			mem_put(mctx, mem, mpctx->size);
-			MCTXLOCK(mctx, &mctx->lock);
-			mem_putstats(mctx, mem, mpctx->size);
-			MCTXUNLOCK(mctx, &mctx->lock);
-		}
-		if (mpctx->lock != NULL)
-			UNLOCK(mpctx->lock);
-		return;
-	}
-
-	/*
-	 * Otherwise, attach it to our free list and bump the counter.
+	 * Return this to the mctx directly if our free list is full,
+	 * otherwise attach it to our free list and bump the counter.
 	 */
-	mpctx->freecount++;
-	item = (element *)mem;
-	item->next = mpctx->items;
-	mpctx->items = item;
+	mempool_release(mpctx, (element *)mem);
 
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
@@ -2171,18 +2814,51 @@ isc__mempool_getfreecount(isc_mempool_t *mpctx0) {
 ISC_MEMFUNC_SCOPE void
 isc__mempool_setmaxalloc(isc_mempool_t *mpctx0, unsigned int limit) {
 	isc__mempool_t *mpctx = (isc__mempool_t *)mpctx0;
+#ifdef USE_TCACHE
+	unsigned int i;
+	int self = -1;
+#endif
 
 	REQUIRE(limit > 0);
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+#ifdef USE_TCACHE
+	if (mpctx->tcaches != NULL) {
+		self = tcache_slot();
+		LOCK(&lock);
+	}
+#endif
 	if (mpctx->lock != NULL)
 		LOCK(mpctx->lock);
 
 	mpctx->maxalloc = limit;
 
+#ifdef USE_TCACHE
+	/*
+	 * Take back the items in caches that no running thread owns, and
+	 * in the caller's; other threads give theirs back the next time
+	 * they use the pool.
+	 */
+	if (mpctx->tcaches != NULL) {
+		mpctx->tcache_gen++;
+		for (i = 0; i < TCACHE_SLOTS; i++) {
+			mempool_tcache_t *pc = &mpctx->tcaches[i];
+
+			if (tcache_owned[i] && (int)i != self)
+				continue;
+			mempool_drain(mpctx, pc, pc->count);
+			pc->gen = mpctx->tcache_gen;
+		}
+	}
+#endif
+
 	if (mpctx->lock != NULL)
 		UNLOCK(mpctx->lock);
+#ifdef USE_TCACHE
+	if (mpctx->tcaches != NULL)
+		UNLOCK(&lock);
+#endif
 }
 
 ISC_MEMFUNC_SCOPE unsigned int
@@ -45,6 +45,12 @@ _comp_with_mask(void *addr, void *dest, u_int mask);
 static void
 _clear_radix(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func);
 
+static void
+_free_tables(isc_radix_tree_t *radix);
+
+static isc_radix_node_t *
+_table_search(isc_radix_table_t *table, const u_char *addr);
+
 static isc_result_t
 _new_prefix(isc_mem_t *mctx, isc_prefix_t **target, int family, void *dest,
 	    int bitlen)
@@ -155,6 +161,8 @@ isc_radix_create(isc_mem_t *mctx, isc_radix_tree_t **target, int maxbits) {
 	radix->head = NULL;
 	radix->num_active_node = 0;
 	radix->num_added_node = 0;
+	radix->table[0] = NULL;
+	radix->table[1] = NULL;
 	RUNTIME_CHECK(maxbits <= RADIX_MAXBITS); /* XXX */
 	radix->magic = RADIX_TREE_MAGIC;
 	*target = radix;
@@ -171,6 +179,8 @@ _clear_radix(isc_radix_tree_t *radix, isc_radix_destroyfunc_t func) {
 
 	REQUIRE(radix != NULL);
 
+	_free_tables(radix);
+
 	if (radix->head != NULL) {
 		isc_radix_node_t *Xstack[RADIX_MAXBITS+1];
 		isc_radix_node_t **Xsp = Xstack;
@@ -240,6 +250,7 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 {
 	isc_radix_node_t *node;
 	isc_radix_node_t *stack[RADIX_MAXBITS + 1];
+	isc_radix_table_t *table;
 	u_char *addr;
 	isc_uint32_t bitlen;
 	int tfamily = -1;
@@ -252,6 +263,18 @@ isc_radix_search(isc_radix_tree_t *radix, isc_radix_node_t **target,
 
 	*target = NULL;
 
+	if ((prefix->family == AF_INET && prefix->bitlen == 32) ||
+	    (prefix->family == AF_INET6 && prefix->bitlen == 128)) {
+		table = radix->table[ISC_IS6(prefix->family)];
+		if (table != NULL) {
+			*target = _table_search(table,
+						isc_prefix_touchar(prefix));
+			if (*target == NULL)
+				return (ISC_R_NOTFOUND);
+			return (ISC_R_SUCCESS);
+		}
+	}
+
 	if (radix->head == NULL) {
 		return (ISC_R_NOTFOUND);
 	}
@@ -319,6 +342,8 @@ isc_radix_insert(isc_radix_tree_t *radix, isc_radix_node_t **target,
 
 	INSIST(prefix != NULL);
 
+	_free_tables(radix);
+
 	bitlen = prefix->bitlen;
 	fam = prefix->family;
 
@@ -618,6 +643,8 @@ isc_radix_remove(isc_radix_tree_t *radix, isc_radix_node_t *node) {
 	REQUIRE(radix != NULL);
 	REQUIRE(node != NULL);
 
+	_free_tables(radix);
+
 	if (node->r && node->l) {
 		/*
 		 * This might be a placeholder node -- have to check and
@@ -699,6 +726,263 @@ isc_radix_remove(isc_radix_tree_t *radix, isc_radix_node_t *node) {
 	}
 }
 
+/*
+ * Compiled lookup tables.
+ *
+ * Each table is a multibit trie over the addresses of one family.  A
+ * trie node is an array of TABLE_FANOUT entries indexed by the next
+ * TABLE_STRIDE bits of the address, small enough to fit in a cache
+ * line.  An entry either points to a child node, or holds the result
+ * of a search for every address that reaches it: 0 for no match, or
+ * one more than the index of the matching radix node in 'results'.
+ * Prefixes are "pushed down" as the trie is built, so that a search
+ * stops at the first entry which is not a child, and never backtracks.
+ */
+#define TABLE_STRIDE	4
+#define TABLE_FANOUT	(1 << TABLE_STRIDE)
+#define TABLE_CHILD	0x80000000U
+
+struct isc_radix_table {
+	isc_mem_t *mctx;
+	int family;			/* index into node_num[] */
+	isc_uint32_t *entries;		/* TABLE_FANOUT per trie node */
+	unsigned int nnodes;
+	unsigned int allocated;		/* in trie nodes */
+	isc_radix_node_t **results;
+	unsigned int nresults;
+};
+
+static inline unsigned int
+_table_index(const u_char *addr, unsigned int depth) {
+	unsigned int byte = addr[depth >> 3];
+
+	return ((depth & 4) != 0 ? (byte & 0x0f) : (byte >> 4));
+}
+
+static isc_radix_node_t *
+_table_search(isc_radix_table_t *table, const u_char *addr) {
+	unsigned int node = 0, depth = 0;
+	isc_uint32_t entry;
+
+	for (;;) {
+		entry = table->entries[node * TABLE_FANOUT +
+				       _table_index(addr, depth)];
+		if ((entry & TABLE_CHILD) == 0)
+			break;
+		node = entry & ~TABLE_CHILD;
+		depth += TABLE_STRIDE;
+	}
+
+	if (entry == 0)
+		return (NULL);
+	return (table->results[entry - 1]);
+}
+
+static isc_result_t
+_table_newnode(isc_radix_table_t *table, isc_uint32_t fill,
+	       unsigned int *nodep)
+{
+	isc_uint32_t *entries;
+	unsigned int allocated, i;
+
+	if (table->nnodes == table->allocated) {
+		allocated = table->allocated * 2;
+		entries = isc_mem_get(table->mctx, allocated * TABLE_FANOUT *
+						   sizeof(isc_uint32_t));
+		if (entries == NULL)
+			return (ISC_R_NOMEMORY);
+		memmove(entries, table->entries, table->nnodes *
+			TABLE_FANOUT * sizeof(isc_uint32_t));
+		isc_mem_put(table->mctx, table->entries, table->allocated *
+			    TABLE_FANOUT * sizeof(isc_uint32_t));
+		table->entries = entries;
+		table->allocated = allocated;
+	}
+
+	for (i = 0; i < TABLE_FANOUT; i++)
+		table->entries[table->nnodes * TABLE_FANOUT + i] = fill;
+	*nodep = table->nnodes++;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Store 'result' in 'count' entries of trie node 'node' starting at
+ * 'first', and below them, wherever it is an earlier match than the
+ * one already there.
+ */
+static void
+_table_apply(isc_radix_table_t *table, unsigned int node,
+	     unsigned int first, unsigned int count, isc_uint32_t result)
+{
+	isc_uint32_t *entry;
+	int num = table->results[result - 1]->node_num[table->family];
+	unsigned int i;
+
+	for (i = first; i < first + count; i++) {
+		entry = &table->entries[node * TABLE_FANOUT + i];
+		if ((*entry & TABLE_CHILD) != 0)
+			_table_apply(table, *entry & ~TABLE_CHILD,
+				     0, TABLE_FANOUT, result);
+		else if (*entry == 0 ||
+			 table->results[*entry - 1]->node_num[table->family] >
+			 num)
+			*entry = result;
+	}
+}
+
+static isc_result_t
+_table_insert(isc_radix_table_t *table, const u_char *addr,
+	      unsigned int bitlen, isc_uint32_t result)
+{
+	unsigned int node = 0, depth = 0, child, index, rest;
+	isc_uint32_t entry;
+	isc_result_t tresult;
+
+	while (bitlen - depth > TABLE_STRIDE) {
+		index = node * TABLE_FANOUT + _table_index(addr, depth);
+		entry = table->entries[index];
+		if ((entry & TABLE_CHILD) == 0) {
+			/* The new node inherits the shorter match. */
+			tresult = _table_newnode(table, entry, &child);
+			if (tresult != ISC_R_SUCCESS)
+				return (tresult);
+			entry = TABLE_CHILD | child;
+			table->entries[index] = entry;
+		}
+		node = entry & ~TABLE_CHILD;
+		depth += TABLE_STRIDE;
+	}
+
+	/*
+	 * The remaining bits of the prefix select a run of entries
+	 * in this node.
+	 */
+	rest = bitlen - depth;
+	index = 0;
+	if (rest > 0)
+		index = _table_index(addr, depth) &
+			((TABLE_FANOUT - 1) << (TABLE_STRIDE - rest));
+	_table_apply(table, node, index, 1 << (TABLE_STRIDE - rest), result);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+_table_destroy(isc_radix_table_t **tablep) {
+	isc_radix_table_t *table = *tablep;
+
+	if (table->entries != NULL)
+		isc_mem_put(table->mctx, table->entries, table->allocated *
+			    TABLE_FANOUT * sizeof(isc_uint32_t));
+	if (table->results != NULL)
+		isc_mem_put(table->mctx, table->results,
+			    table->nresults * sizeof(isc_radix_node_t *));
+	isc_mem_put(table->mctx, table, sizeof(*table));
+	*tablep = NULL;
+}
+
+static isc_result_t
+_table_create(isc_radix_tree_t *radix, int family, isc_radix_table_t **tablep)
+{
+	isc_radix_table_t *table;
+	isc_radix_node_t *node;
+	isc_result_t result;
+	unsigned int i, maxbits, root;
+
+	maxbits = (family == 1) ? 128 : 32;
+
+	table = isc_mem_get(radix->mctx, sizeof(*table));
+	if (table == NULL)
+		return (ISC_R_NOMEMORY);
+	table->mctx = radix->mctx;
+	table->family = family;
+	table->entries = NULL;
+	table->nnodes = 0;
+	table->allocated = 0;
+	table->results = NULL;
+	table->nresults = 0;
+
+	/*
+	 * Collect the nodes which can match an address of this family.
+	 */
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[family] != -1 &&
+		    node->prefix->bitlen <= maxbits)
+			table->nresults++;
+	} RADIX_WALK_END;
+	if (table->nresults > 0) {
+		table->results = isc_mem_get(radix->mctx, table->nresults *
+					     sizeof(isc_radix_node_t *));
+		if (table->results == NULL) {
+			result = ISC_R_NOMEMORY;
+			goto cleanup;
+		}
+	}
+	i = 0;
+	RADIX_WALK(radix->head, node) {
+		if (node->node_num[family] != -1 &&
+		    node->prefix->bitlen <= maxbits)
+			table->results[i++] = node;
+	} RADIX_WALK_END;
+	INSIST(i == table->nresults);
+
+	table->allocated = 16;
+	table->entries = isc_mem_get(radix->mctx, table->allocated *
+				     TABLE_FANOUT * sizeof(isc_uint32_t));
+	if (table->entries == NULL) {
+		table->allocated = 0;
+		result = ISC_R_NOMEMORY;
+		goto cleanup;
+	}
+	result = _table_newnode(table, 0, &root);
+	INSIST(result == ISC_R_SUCCESS && root == 0);
+
+	for (i = 0; i < table->nresults; i++) {
+		node = table->results[i];
+		result = _table_insert(table, isc_prefix_touchar(node->prefix),
+				       node->prefix->bitlen, i + 1);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup;
+	}
+
+	*tablep = table;
+	return (ISC_R_SUCCESS);
+
+ cleanup:
+	_table_destroy(&table);
+	return (result);
+}
+
+static void
+_free_tables(isc_radix_tree_t *radix) {
+	if (radix->table[0] != NULL)
+		_table_destroy(&radix->table[0]);
+	if (radix->table[1] != NULL)
+		_table_destroy(&radix->table[1]);
+}
+
+isc_result_t
+isc_radix_compile(isc_radix_tree_t *radix) {
+	isc_radix_table_t *table4 = NULL, *table6 = NULL;
+	isc_result_t result;
+
+	REQUIRE(radix != NULL);
+
+	result = _table_create(radix, 0, &table4);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+	result = _table_create(radix, 1, &table6);
+	if (result != ISC_R_SUCCESS) {
+		_table_destroy(&table4);
+		return (result);
+	}
+
+	_free_tables(radix);
+	radix->table[0] = table4;
+	radix->table[1] = table6;
+	return (ISC_R_SUCCESS);
+}
+
 /*
 Local Variables:
 c-basic-offset: 4
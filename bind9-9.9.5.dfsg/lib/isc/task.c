@@ -119,6 +119,9 @@ struct isc__task {
 	LINK(isc__task_t)		link;
 	LINK(isc__task_t)		ready_link;
 	LINK(isc__task_t)		ready_priority_link;
+	/* Locked by the lock of the worker queue the task is on. */
+	unsigned int			threadid;
+	LINK(isc__task_t)		queue_link;
 };
 
 #define TASK_F_SHUTTINGDOWN		0x01
@@ -132,6 +135,35 @@ struct isc__task {
 
 typedef ISC_LIST(isc__task_t)	isc__tasklist_t;
 
+#ifdef USE_WORKER_THREADS
+/*%
+ * Each worker thread owns a ready queue.  A task is bound to one of the
+ * queues when it is created, and is normally run by that queue's worker;
+ * a worker whose own queue is empty steals ready tasks from the other
+ * queues before going to sleep.  Making a task ready or running it thus
+ * only needs the lock of one queue, not the task manager lock.
+ *
+ * Privileged tasks are still kept on the manager's ready_tasks and
+ * ready_priority_tasks lists, under the task manager lock.  While the
+ * manager is paused, in exclusive mode or in privileged mode the worker
+ * queues are disabled and the workers only run tasks from those lists.
+ */
+typedef struct isc__taskqueue {
+	/* Not locked. */
+	isc__taskmgr_t *		manager;
+	unsigned int			threadid;
+	isc_mutex_t			lock;
+	/* Locked by queue lock. */
+	isc__tasklist_t			ready_tasks;
+	isc_condition_t			work_available;
+	unsigned int			dispatched;
+	isc_boolean_t			enabled;
+	isc_boolean_t			running;
+	isc_boolean_t			idle;
+	isc_boolean_t			wakeup;
+} isc__taskqueue_t;
+#endif /* USE_WORKER_THREADS */
+
 struct isc__taskmgr {
 	/* Not locked. */
 	isc_taskmgr_t			common;
@@ -141,8 +173,15 @@ struct isc__taskmgr {
 	unsigned int			workers;
 	isc_thread_t *			threads;
 #endif /* ISC_PLATFORM_USETHREADS */
+#ifdef USE_WORKER_THREADS
+	unsigned int			nqueues;
+	isc__taskqueue_t *		queues;
+#endif /* USE_WORKER_THREADS */
 	/* Locked by task manager lock. */
 	unsigned int			default_quantum;
+#ifdef USE_WORKER_THREADS
+	unsigned int			next_threadid;
+#endif /* USE_WORKER_THREADS */
 	LIST(isc__task_t)		tasks;
 	isc__tasklist_t			ready_tasks;
 	isc__tasklist_t			ready_priority_tasks;
@@ -152,7 +191,9 @@ struct isc__taskmgr {
 	isc_condition_t			exclusive_granted;
 	isc_condition_t			paused;
 #endif /* ISC_PLATFORM_USETHREADS */
+#ifndef USE_WORKER_THREADS
 	unsigned int			tasks_running;
+#endif /* USE_WORKER_THREADS */
 	isc_boolean_t			pause_requested;
 	isc_boolean_t			exclusive_requested;
 	isc_boolean_t			exiting;
@@ -252,6 +293,17 @@ pop_readyq(isc__taskmgr_t *manager);
 static inline void
 push_readyq(isc__taskmgr_t *manager, isc__task_t *task);
 
+#ifdef USE_WORKER_THREADS
+static inline void
+push_localq(isc__taskmgr_t *manager, isc__task_t *task);
+
+static inline void
+wake_queue(isc__taskmgr_t *manager, unsigned int threadid);
+
+static void
+wake_queues(isc__taskmgr_t *manager);
+#endif /* USE_WORKER_THREADS */
+
 static struct isc__taskmethods {
 	isc_taskmethods_t methods;
 
@@ -322,6 +374,7 @@ task_finished(isc__task_t *task) {
 		 * can exit.
 		 */
 		BROADCAST(&manager->work_available);
+		wake_queues(manager);
 	}
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
@@ -332,11 +385,10 @@ task_finished(isc__task_t *task) {
 	isc_mem_put(manager->mctx, task, sizeof(*task));
 }
 
-ISC_TASKFUNC_SCOPE isc_result_t
-isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
-		 isc_task_t **taskp)
+static isc_result_t
+task_create(isc__taskmgr_t *manager, unsigned int quantum, int threadid,
+	    isc_task_t **taskp)
 {
-	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 	isc__task_t *task;
 	isc_boolean_t exiting;
 	isc_result_t result;
@@ -366,12 +418,28 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	INIT_LINK(task, link);
 	INIT_LINK(task, ready_link);
 	INIT_LINK(task, ready_priority_link);
+	INIT_LINK(task, queue_link);
 
 	exiting = ISC_FALSE;
 	LOCK(&manager->lock);
 	if (!manager->exiting) {
 		if (task->quantum == 0)
 			task->quantum = manager->default_quantum;
+#ifdef USE_WORKER_THREADS
+		/*
+		 * Unbound tasks are spread over the worker queues
+		 * round-robin.
+		 */
+		if (threadid < 0)
+			task->threadid = manager->next_threadid++ %
+					 manager->workers;
+		else
+			task->threadid = (unsigned int)threadid %
+					 manager->workers;
+#else
+		UNUSED(threadid);
+		task->threadid = 0;
+#endif /* USE_WORKER_THREADS */
 		APPEND(manager->tasks, task, link);
 	} else
 		exiting = ISC_TRUE;
@@ -391,6 +459,23 @@ isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
 	return (ISC_R_SUCCESS);
 }
 
+ISC_TASKFUNC_SCOPE isc_result_t
+isc__task_create(isc_taskmgr_t *manager0, unsigned int quantum,
+		 isc_task_t **taskp)
+{
+	return (task_create((isc__taskmgr_t *)manager0, quantum, -1, taskp));
+}
+
+isc_result_t
+isc_task_create_bound(isc_taskmgr_t *manager0, unsigned int quantum,
+		      isc_task_t **taskp, int threadid)
+{
+	REQUIRE(threadid >= 0);
+
+	return (task_create((isc__taskmgr_t *)manager0, quantum, threadid,
+			    taskp));
+}
+
 ISC_TASKFUNC_SCOPE void
 isc__task_attach(isc_task_t *source0, isc_task_t **targetp) {
 	isc__task_t *source = (isc__task_t *)source0;
@@ -466,11 +551,18 @@ task_ready(isc__task_t *task) {
 
 	XTRACE("task_ready");
 
+#ifdef USE_WORKER_THREADS
+	if (!has_privilege) {
+		push_localq(manager, task);
+		return;
+	}
+#endif /* USE_WORKER_THREADS */
+
 	LOCK(&manager->lock);
 	push_readyq(manager, task);
 #ifdef USE_WORKER_THREADS
-	if (manager->mode == isc_taskmgrmode_normal || has_privilege)
-		SIGNAL(&manager->work_available);
+	SIGNAL(&manager->work_available);
+	wake_queue(manager, task->threadid);
 #endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 }
@@ -977,14 +1069,492 @@ push_readyq(isc__taskmgr_t *manager, isc__task_t *task) {
 			ready_priority_link);
 }
 
+#ifdef USE_WORKER_THREADS
+/*
+ * Push 'task' onto the ready queue of the worker it is bound to, and wake
+ * that worker up if it is idle.  If the worker is busy and already has a
+ * backlog, poke its neighbor as well so that the task can be stolen if
+ * the neighbor has nothing else to do.
+ *
+ * Caller must NOT hold the queue lock.
+ */
+static inline void
+push_localq(isc__taskmgr_t *manager, isc__task_t *task) {
+	isc__taskqueue_t *queue = &manager->queues[task->threadid];
+	isc_boolean_t backlog;
+
+	LOCK(&queue->lock);
+	backlog = ISC_TF(!queue->idle && !EMPTY(queue->ready_tasks));
+	ENQUEUE(queue->ready_tasks, task, queue_link);
+	if (queue->idle)
+		SIGNAL(&queue->work_available);
+	UNLOCK(&queue->lock);
+
+	if (backlog && manager->workers > 1)
+		wake_queue(manager, (task->threadid + 1) % manager->workers);
+}
+
+/*
+ * Tell the worker owning queue 'threadid' to look for work outside its
+ * own queue (the global ready queues, or other workers' queues) before it
+ * next goes to sleep, waking it up if it is already sleeping.
+ *
+ * Caller must NOT hold the queue lock.
+ */
+static inline void
+wake_queue(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
+
+	LOCK(&queue->lock);
+	queue->wakeup = ISC_TRUE;
+	if (queue->idle)
+		SIGNAL(&queue->work_available);
+	UNLOCK(&queue->lock);
+}
+
+/*
+ * Wake up every worker.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+wake_queues(isc__taskmgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->workers; i++)
+		wake_queue(manager, i);
+}
+
+/*
+ * Enable or disable the worker queues according to the current state of
+ * the manager.  The queues can only be used in normal execution mode
+ * when neither a pause nor exclusive access has been requested.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+update_queues(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	isc_boolean_t enabled;
+	unsigned int i;
+
+	enabled = ISC_TF(manager->mode == isc_taskmgrmode_normal &&
+			 !manager->pause_requested &&
+			 !manager->exclusive_requested);
+
+	for (i = 0; i < manager->workers; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		if (queue->enabled != enabled) {
+			queue->enabled = enabled;
+			queue->wakeup = ISC_TRUE;
+			SIGNAL(&queue->work_available);
+		}
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Return the number of workers that are currently running a task.
+ *
+ * Caller must hold the task manager lock.
+ */
+static unsigned int
+running_tasks(isc__taskmgr_t *manager) {
+	isc__taskqueue_t *queue;
+	unsigned int i, running = 0;
+
+	for (i = 0; i < manager->workers; i++) {
+		queue = &manager->queues[i];
+		LOCK(&queue->lock);
+		if (queue->running)
+			running++;
+		UNLOCK(&queue->lock);
+	}
+
+	return (running);
+}
+
+/*
+ * If we are in privileged execution mode and there are no tasks
+ * remaining on the current ready queue and none running, then we're
+ * stuck.  Automatically drop privileges at that point and continue with
+ * the regular ready queues.
+ *
+ * Caller must hold the task manager lock.
+ */
+static void
+check_privileged(isc__taskmgr_t *manager) {
+	if (manager->mode == isc_taskmgrmode_normal ||
+	    manager->pause_requested || manager->exclusive_requested ||
+	    !empty_readyq(manager) || running_tasks(manager) != 0)
+		return;
+
+	manager->mode = isc_taskmgrmode_normal;
+	update_queues(manager);
+	BROADCAST(&manager->work_available);
+}
+#endif /* USE_WORKER_THREADS */
+
+/*
+ * Run 'task', which must be in the ready state, until either its event
+ * queue is empty or its quantum has expired.  Returns the number of
+ * events dispatched.
+ *
+ * On return, '*requeuep' is set if the task has been left in the ready
+ * state and must be put back onto a ready queue, and '*finishedp' is set
+ * if the task is done and task_finished() must be called.
+ *
+ * Caller must not hold any locks.
+ */
+static unsigned int
+run_task(isc__task_t *task, isc_boolean_t *requeuep,
+	 isc_boolean_t *finishedp)
+{
+	unsigned int dispatch_count = 0;
+	isc_boolean_t done = ISC_FALSE;
+	isc_event_t *event;
+
+	*requeuep = ISC_FALSE;
+	*finishedp = ISC_FALSE;
+
+	LOCK(&task->lock);
+	INSIST(task->state == task_state_ready);
+	task->state = task_state_running;
+	XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+			      ISC_MSG_RUNNING, "running"));
+	isc_stdtime_get(&task->now);
+	do {
+		if (!EMPTY(task->events)) {
+			event = HEAD(task->events);
+			DEQUEUE(task->events, event, ev_link);
+
+			/*
+			 * Execute the event action.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_EXECUTE,
+					      "execute action"));
+			if (event->ev_action != NULL) {
+				UNLOCK(&task->lock);
+				(event->ev_action)((isc_task_t *)task, event);
+				LOCK(&task->lock);
+			}
+			dispatch_count++;
+		}
+
+		if (task->references == 0 &&
+		    EMPTY(task->events) &&
+		    !TASK_SHUTTINGDOWN(task)) {
+			isc_boolean_t was_idle;
+
+			/*
+			 * There are no references and no
+			 * pending events for this task,
+			 * which means it will not become
+			 * runnable again via an external
+			 * action (such as sending an event
+			 * or detaching).
+			 *
+			 * We initiate shutdown to prevent
+			 * it from becoming a zombie.
+			 *
+			 * We do this here instead of in
+			 * the "if EMPTY(task->events)" block
+			 * below because:
+			 *
+			 *	If we post no shutdown events,
+			 *	we want the task to finish.
+			 *
+			 *	If we did post shutdown events,
+			 *	will still want the task's
+			 *	quantum to be applied.
+			 */
+			was_idle = task_shutdown(task);
+			INSIST(!was_idle);
+		}
+
+		if (EMPTY(task->events)) {
+			/*
+			 * Nothing else to do for this task
+			 * right now.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_EMPTY, "empty"));
+			if (task->references == 0 &&
+			    TASK_SHUTTINGDOWN(task)) {
+				/*
+				 * The task is done.
+				 */
+				XTRACE(isc_msgcat_get(isc_msgcat,
+						      ISC_MSGSET_TASK,
+						      ISC_MSG_DONE, "done"));
+				*finishedp = ISC_TRUE;
+				task->state = task_state_done;
+			} else
+				task->state = task_state_idle;
+			done = ISC_TRUE;
+		} else if (dispatch_count >= task->quantum) {
+			/*
+			 * Our quantum has expired, but
+			 * there is more work to be done.
+			 * We'll requeue it to the ready
+			 * queue later.
+			 *
+			 * We don't check quantum until
+			 * dispatching at least one event,
+			 * so the minimum quantum is one.
+			 */
+			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					      ISC_MSG_QUANTUM, "quantum"));
+			task->state = task_state_ready;
+			*requeuep = ISC_TRUE;
+			done = ISC_TRUE;
+		}
+	} while (!done);
+	UNLOCK(&task->lock);
+
+	return (dispatch_count);
+}
+
+#ifdef USE_WORKER_THREADS
+/*
+ * Look for a task on the manager's global ready queues, which hold the
+ * privileged tasks.  If the worker queues are disabled, wait until either
+ * a task can be run from the global queues or the worker queues are
+ * enabled again.  '*exitingp' is set if the manager has finished and the
+ * worker should exit.
+ *
+ * On success, the worker owning 'queue' is marked as running.
+ */
+static isc__task_t *
+pop_globalq(isc__taskmgr_t *manager, isc__taskqueue_t *queue,
+	    isc_boolean_t *exitingp)
+{
+	isc__task_t *task = NULL;
+
+	*exitingp = ISC_FALSE;
+
+	LOCK(&manager->lock);
+	while (!FINISHED(manager)) {
+		if (!manager->pause_requested &&
+		    !manager->exclusive_requested)
+		{
+			task = pop_readyq(manager);
+			if (task != NULL) {
+				/*
+				 * Mark ourselves as running while still
+				 * holding the manager lock, so that a
+				 * concurrent pause or exclusive request
+				 * will see us.
+				 */
+				LOCK(&queue->lock);
+				queue->running = ISC_TRUE;
+				UNLOCK(&queue->lock);
+				break;
+			}
+			if (manager->mode == isc_taskmgrmode_normal)
+				break;
+			check_privileged(manager);
+			if (manager->mode == isc_taskmgrmode_normal)
+				break;
+		}
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
+					    ISC_MSG_WAIT, "wait"));
+		WAIT(&manager->work_available, &manager->lock);
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_AWAKE, "awake"));
+	}
+	if (task == NULL && FINISHED(manager))
+		*exitingp = ISC_TRUE;
+	UNLOCK(&manager->lock);
+
+	return (task);
+}
+
+/*
+ * Steal a ready task from another worker whose own worker is busy.  The
+ * stolen task is rebound to 'threadid'.
+ *
+ * On success, the worker owning queue 'threadid' is marked as running.
+ */
+static isc__task_t *
+steal_task(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue;
+	isc__task_t *task = NULL;
+	unsigned int i;
+
+	for (i = 1; task == NULL && i < manager->workers; i++) {
+		queue = &manager->queues[(threadid + i) % manager->workers];
+		LOCK(&queue->lock);
+		if (queue->enabled && queue->running) {
+			task = HEAD(queue->ready_tasks);
+			if (task != NULL)
+				DEQUEUE(queue->ready_tasks, task, queue_link);
+		}
+		UNLOCK(&queue->lock);
+	}
+
+	if (task == NULL)
+		return (NULL);
+
+	XTTRACE(task, "stolen");
+
+	queue = &manager->queues[threadid];
+	task->threadid = threadid;
+	LOCK(&queue->lock);
+	if (queue->enabled)
+		queue->running = ISC_TRUE;
+	else {
+		/*
+		 * The queues have been disabled while we were stealing;
+		 * keep the task until they are enabled again.
+		 */
+		ENQUEUE(queue->ready_tasks, task, queue_link);
+		task = NULL;
+	}
+	UNLOCK(&queue->lock);
+
+	return (task);
+}
+
+/*
+ * Return the next task for worker 'threadid' to run, waiting until there
+ * is one.  Returns NULL when the manager has finished.
+ *
+ * The worker's own queue is tried first.  The global ready queues are
+ * checked when the worker queue is empty or disabled, and every
+ * DEFAULT_TASKMGR_QUANTUM tasks so that privileged tasks are not
+ * starved; the other workers' queues are checked before going to sleep.
+ */
+static isc__task_t *
+next_task(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
+	isc__task_t *task;
+	isc_boolean_t exiting, empty;
+
+	for (;;) {
+		LOCK(&queue->lock);
+		if (queue->enabled &&
+		    queue->dispatched < DEFAULT_TASKMGR_QUANTUM)
+		{
+			task = HEAD(queue->ready_tasks);
+			if (task != NULL) {
+				DEQUEUE(queue->ready_tasks, task, queue_link);
+				queue->dispatched++;
+				queue->running = ISC_TRUE;
+				UNLOCK(&queue->lock);
+				return (task);
+			}
+		}
+		queue->dispatched = 0;
+		queue->wakeup = ISC_FALSE;
+		UNLOCK(&queue->lock);
+
+		task = pop_globalq(manager, queue, &exiting);
+		if (task != NULL || exiting)
+			return (task);
+
+		LOCK(&queue->lock);
+		empty = ISC_TF(EMPTY(queue->ready_tasks));
+		UNLOCK(&queue->lock);
+		if (!empty)
+			continue;
+
+		task = steal_task(manager, threadid);
+		if (task != NULL)
+			return (task);
+
+		LOCK(&queue->lock);
+		while (queue->enabled && EMPTY(queue->ready_tasks) &&
+		       !queue->wakeup)
+		{
+			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+						    ISC_MSGSET_GENERAL,
+						    ISC_MSG_WAIT, "wait"));
+			queue->idle = ISC_TRUE;
+			WAIT(&queue->work_available, &queue->lock);
+			queue->idle = ISC_FALSE;
+			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
+						    ISC_MSGSET_TASK,
+						    ISC_MSG_AWAKE, "awake"));
+		}
+		UNLOCK(&queue->lock);
+	}
+}
+
+/*
+ * Worker 'threadid' has finished running a task.  If the worker queues
+ * are disabled, someone may be waiting for the running tasks to drain,
+ * so take the manager lock and let them know.
+ */
+static void
+task_done(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__taskqueue_t *queue = &manager->queues[threadid];
+	isc_boolean_t enabled;
+	unsigned int running;
+
+	LOCK(&queue->lock);
+	queue->running = ISC_FALSE;
+	enabled = queue->enabled;
+	UNLOCK(&queue->lock);
+
+	if (enabled)
+		return;
+
+	LOCK(&manager->lock);
+	running = running_tasks(manager);
+	if (manager->exclusive_requested && running == 1) {
+		SIGNAL(&manager->exclusive_granted);
+	} else if (manager->pause_requested && running == 0) {
+		SIGNAL(&manager->paused);
+	}
+	check_privileged(manager);
+	UNLOCK(&manager->lock);
+}
+
+static void
+dispatch(isc__taskmgr_t *manager, unsigned int threadid) {
+	isc__task_t *task;
+	isc_boolean_t requeue, finished;
+
+	REQUIRE(VALID_MANAGER(manager));
+
+	/*
+	 * For reasons similar to those given in the comment in
+	 * isc_task_send() above, it is safe for us to dequeue
+	 * the task while only holding the queue (or manager) lock,
+	 * and then change the task to running state while only
+	 * holding the task lock.
+	 */
+	while ((task = next_task(manager, threadid)) != NULL) {
+		INSIST(VALID_TASK(task));
+		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
+					    ISC_MSG_WORKING, "working"));
+
+		(void)run_task(task, &requeue, &finished);
+
+		if (finished)
+			task_finished(task);
+
+		task_done(manager, threadid);
+
+		if (requeue) {
+			/*
+			 * A task which has used up its quantum goes to the
+			 * back of the ready queue it belongs on.
+			 */
+			task_ready(task);
+		}
+	}
+}
+#else /* USE_WORKER_THREADS */
 static void
 dispatch(isc__taskmgr_t *manager) {
 	isc__task_t *task;
-#ifndef USE_WORKER_THREADS
 	unsigned int total_dispatch_count = 0;
 	isc__tasklist_t new_ready_tasks;
 	isc__tasklist_t new_priority_tasks;
-#endif /* USE_WORKER_THREADS */
 
 	REQUIRE(VALID_MANAGER(manager));
 
@@ -992,10 +1562,10 @@ dispatch(isc__taskmgr_t *manager) {
 	 * Again we're trying to hold the lock for as short a time as possible
 	 * and to do as little locking and unlocking as possible.
 	 *
-	 * In both while loops, the appropriate lock must be held before the
-	 * while body starts.  Code which acquired the lock at the top of
-	 * the loop would be more readable, but would result in a lot of
-	 * extra locking.  Compare:
+	 * In the while loop, the lock must be held before the while body
+	 * starts.  Code which acquired the lock at the top of the loop would
+	 * be more readable, but would result in a lot of extra locking.
+	 * Compare:
 	 *
 	 * Straightforward:
 	 *
@@ -1038,50 +1608,20 @@ dispatch(isc__taskmgr_t *manager) {
 	 * unlocks.  The while expression is always protected by the lock.
 	 */
 
-#ifndef USE_WORKER_THREADS
 	ISC_LIST_INIT(new_ready_tasks);
 	ISC_LIST_INIT(new_priority_tasks);
-#endif
 	LOCK(&manager->lock);
 
 	while (!FINISHED(manager)) {
-#ifdef USE_WORKER_THREADS
-		/*
-		 * For reasons similar to those given in the comment in
-		 * isc_task_send() above, it is safe for us to dequeue
-		 * the task while only holding the manager lock, and then
-		 * change the task to running state while only holding the
-		 * task lock.
-		 *
-		 * If a pause has been requested, don't do any work
-		 * until it's been released.
-		 */
-		while ((empty_readyq(manager) || manager->pause_requested ||
-			manager->exclusive_requested) && !FINISHED(manager))
-		{
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_GENERAL,
-						    ISC_MSG_WAIT, "wait"));
-			WAIT(&manager->work_available, &manager->lock);
-			XTHREADTRACE(isc_msgcat_get(isc_msgcat,
-						    ISC_MSGSET_TASK,
-						    ISC_MSG_AWAKE, "awake"));
-		}
-#else /* USE_WORKER_THREADS */
 		if (total_dispatch_count >= DEFAULT_TASKMGR_QUANTUM ||
 		    empty_readyq(manager))
 			break;
-#endif /* USE_WORKER_THREADS */
 		XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TASK,
 					    ISC_MSG_WORKING, "working"));
 
 		task = pop_readyq(manager);
 		if (task != NULL) {
-			unsigned int dispatch_count = 0;
-			isc_boolean_t done = ISC_FALSE;
-			isc_boolean_t requeue = ISC_FALSE;
-			isc_boolean_t finished = ISC_FALSE;
-			isc_event_t *event;
+			isc_boolean_t requeue, finished;
 
 			INSIST(VALID_TASK(task));
 
@@ -1093,184 +1633,38 @@ dispatch(isc__taskmgr_t *manager) {
 			manager->tasks_running++;
 			UNLOCK(&manager->lock);
 
-			LOCK(&task->lock);
-			INSIST(task->state == task_state_ready);
-			task->state = task_state_running;
-			XTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-					      ISC_MSG_RUNNING, "running"));
-			isc_stdtime_get(&task->now);
-			do {
-				if (!EMPTY(task->events)) {
-					event = HEAD(task->events);
-					DEQUEUE(task->events, event, ev_link);
-
-					/*
-					 * Execute the event action.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							    ISC_MSGSET_TASK,
-							    ISC_MSG_EXECUTE,
-							    "execute action"));
-					if (event->ev_action != NULL) {
-						UNLOCK(&task->lock);
-						(event->ev_action)(
-							(isc_task_t *)task,
-							event);
-						LOCK(&task->lock);
-					}
-					dispatch_count++;
-#ifndef USE_WORKER_THREADS
-					total_dispatch_count++;
-#endif /* USE_WORKER_THREADS */
-				}
-
-				if (task->references == 0 &&
-				    EMPTY(task->events) &&
-				    !TASK_SHUTTINGDOWN(task)) {
-					isc_boolean_t was_idle;
-
-					/*
-					 * There are no references and no
-					 * pending events for this task,
-					 * which means it will not become
-					 * runnable again via an external
-					 * action (such as sending an event
-					 * or detaching).
-					 *
-					 * We initiate shutdown to prevent
-					 * it from becoming a zombie.
-					 *
-					 * We do this here instead of in
-					 * the "if EMPTY(task->events)" block
-					 * below because:
-					 *
-					 *	If we post no shutdown events,
-					 *	we want the task to finish.
-					 *
-					 *	If we did post shutdown events,
-					 *	will still want the task's
-					 *	quantum to be applied.
-					 */
-					was_idle = task_shutdown(task);
-					INSIST(!was_idle);
-				}
-
-				if (EMPTY(task->events)) {
-					/*
-					 * Nothing else to do for this task
-					 * right now.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_EMPTY,
-							      "empty"));
-					if (task->references == 0 &&
-					    TASK_SHUTTINGDOWN(task)) {
-						/*
-						 * The task is done.
-						 */
-						XTRACE(isc_msgcat_get(
-							       isc_msgcat,
-							       ISC_MSGSET_TASK,
-							       ISC_MSG_DONE,
-							       "done"));
-						finished = ISC_TRUE;
-						task->state = task_state_done;
-					} else
-						task->state = task_state_idle;
-					done = ISC_TRUE;
-				} else if (dispatch_count >= task->quantum) {
-					/*
-					 * Our quantum has expired, but
-					 * there is more work to be done.
-					 * We'll requeue it to the ready
-					 * queue later.
-					 *
-					 * We don't check quantum until
-					 * dispatching at least one event,
-					 * so the minimum quantum is one.
-					 */
-					XTRACE(isc_msgcat_get(isc_msgcat,
-							      ISC_MSGSET_TASK,
-							      ISC_MSG_QUANTUM,
-							      "quantum"));
-					task->state = task_state_ready;
-					requeue = ISC_TRUE;
-					done = ISC_TRUE;
-				}
-			} while (!done);
-			UNLOCK(&task->lock);
+			total_dispatch_count += run_task(task, &requeue,
+							 &finished);
 
 			if (finished)
 				task_finished(task);
 
 			LOCK(&manager->lock);
 			manager->tasks_running--;
-#ifdef USE_WORKER_THREADS
-			if (manager->exclusive_requested &&
-			    manager->tasks_running == 1) {
-				SIGNAL(&manager->exclusive_granted);
-			} else if (manager->pause_requested &&
-				   manager->tasks_running == 0) {
-				SIGNAL(&manager->paused);
-			}
-#endif /* USE_WORKER_THREADS */
 			if (requeue) {
 				/*
-				 * We know we're awake, so we don't have
-				 * to wakeup any sleeping threads if the
-				 * ready queue is empty before we requeue.
-				 *
-				 * A possible optimization if the queue is
-				 * empty is to 'goto' the 'if (task != NULL)'
-				 * block, avoiding the ENQUEUE of the task
-				 * and the subsequent immediate DEQUEUE
-				 * (since it is the only executable task).
-				 * We don't do this because then we'd be
-				 * skipping the exit_requested check.  The
-				 * cost of ENQUEUE is low anyway, especially
-				 * when you consider that we'd have to do
-				 * an extra EMPTY check to see if we could
-				 * do the optimization.  If the ready queue
-				 * were usually nonempty, the 'optimization'
-				 * might even hurt rather than help.
+				 * Tasks which have used up their quantum
+				 * are put back onto the ready queues once
+				 * this round of dispatching is over, so
+				 * that other tasks get their turn.
 				 */
-#ifdef USE_WORKER_THREADS
-				push_readyq(manager, task);
-#else
 				ENQUEUE(new_ready_tasks, task, ready_link);
 				if ((task->flags & TASK_F_PRIVILEGED) != 0)
 					ENQUEUE(new_priority_tasks, task,
 						ready_priority_link);
-#endif
 			}
 		}
-
-#ifdef USE_WORKER_THREADS
-		/*
-		 * If we are in privileged execution mode and there are no
-		 * tasks remaining on the current ready queue, then
-		 * we're stuck.  Automatically drop privileges at that
-		 * point and continue with the regular ready queue.
-		 */
-		if (manager->tasks_running == 0 && empty_readyq(manager)) {
-			manager->mode = isc_taskmgrmode_normal;
-			if (!empty_readyq(manager))
-				BROADCAST(&manager->work_available);
-		}
-#endif
 	}
 
-#ifndef USE_WORKER_THREADS
 	ISC_LIST_APPENDLIST(manager->ready_tasks, new_ready_tasks, ready_link);
 	ISC_LIST_APPENDLIST(manager->ready_priority_tasks, new_priority_tasks,
 			    ready_priority_link);
 	if (empty_readyq(manager))
 		manager->mode = isc_taskmgrmode_normal;
-#endif
 
 	UNLOCK(&manager->lock);
 }
+#endif /* USE_WORKER_THREADS */
 
 #ifdef USE_WORKER_THREADS
 static isc_threadresult_t
@@ -1278,12 +1672,12 @@ static isc_threadresult_t
 WINAPI
 #endif
 run(void *uap) {
-	isc__taskmgr_t *manager = uap;
+	isc__taskqueue_t *queue = uap;
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_STARTING, "starting"));
 
-	dispatch(manager);
+	dispatch(queue->manager, queue->threadid);
 
 	XTHREADTRACE(isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 				    ISC_MSG_EXITING, "exiting"));
@@ -1296,6 +1690,22 @@ run(void *uap) {
 }
 #endif /* USE_WORKER_THREADS */
 
+#ifdef USE_WORKER_THREADS
+static void
+queues_free(isc__taskmgr_t *manager, isc_mem_t *mctx) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nqueues; i++) {
+		INSIST(EMPTY(manager->queues[i].ready_tasks));
+		(void)isc_condition_destroy(&manager->queues[i].work_available);
+		DESTROYLOCK(&manager->queues[i].lock);
+	}
+	isc_mem_put(mctx, manager->queues,
+		    manager->nqueues * sizeof(isc__taskqueue_t));
+	manager->queues = NULL;
+}
+#endif /* USE_WORKER_THREADS */
+
 static void
 manager_free(isc__taskmgr_t *manager) {
 	isc_mem_t *mctx;
@@ -1305,6 +1715,7 @@ manager_free(isc__taskmgr_t *manager) {
 	(void)isc_condition_destroy(&manager->work_available);
 	(void)isc_condition_destroy(&manager->paused);
 	isc_mem_free(manager->mctx, manager->threads);
+	queues_free(manager, manager->mctx);
 #endif /* USE_WORKER_THREADS */
 	DESTROYLOCK(&manager->lock);
 	manager->common.impmagic = 0;
@@ -1325,6 +1736,9 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	isc_result_t result;
 	unsigned int i, started = 0;
 	isc__taskmgr_t *manager;
+#ifdef USE_WORKER_THREADS
+	isc__taskqueue_t *queue;
+#endif /* USE_WORKER_THREADS */
 
 	/*
 	 * Create a new task manager.
@@ -1392,6 +1806,41 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 		result = ISC_R_UNEXPECTED;
 		goto cleanup_exclusivegranted;
 	}
+	manager->queues = isc_mem_get(mctx, workers * sizeof(isc__taskqueue_t));
+	if (manager->queues == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto cleanup_paused;
+	}
+	for (manager->nqueues = 0; manager->nqueues < workers;
+	     manager->nqueues++)
+	{
+		queue = &manager->queues[manager->nqueues];
+		result = isc_mutex_init(&queue->lock);
+		if (result != ISC_R_SUCCESS)
+			goto cleanup_queues;
+		if (isc_condition_init(&queue->work_available) !=
+		    ISC_R_SUCCESS)
+		{
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_condition_init() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			DESTROYLOCK(&queue->lock);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_queues;
+		}
+		queue->manager = manager;
+		queue->threadid = manager->nqueues;
+		INIT_LIST(queue->ready_tasks);
+		queue->dispatched = 0;
+		queue->enabled = ISC_TRUE;
+		queue->running = ISC_FALSE;
+		queue->idle = ISC_FALSE;
+		queue->wakeup = ISC_FALSE;
+	}
+	manager->next_threadid = 0;
 #endif /* USE_WORKER_THREADS */
 	if (default_quantum == 0)
 		default_quantum = DEFAULT_DEFAULT_QUANTUM;
@@ -1399,7 +1848,9 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	INIT_LIST(manager->tasks);
 	INIT_LIST(manager->ready_tasks);
 	INIT_LIST(manager->ready_priority_tasks);
+#ifndef USE_WORKER_THREADS
 	manager->tasks_running = 0;
+#endif /* USE_WORKER_THREADS */
 	manager->exclusive_requested = ISC_FALSE;
 	manager->pause_requested = ISC_FALSE;
 	manager->exiting = ISC_FALSE;
@@ -1410,10 +1861,10 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 #ifdef USE_WORKER_THREADS
 	LOCK(&manager->lock);
 	/*
-	 * Start workers.
+	 * Start workers.  Each worker is handed the queue it owns.
 	 */
 	for (i = 0; i < workers; i++) {
-		if (isc_thread_create(run, manager,
+		if (isc_thread_create(run, &manager->queues[manager->workers],
 				      &manager->threads[manager->workers]) ==
 		    ISC_R_SUCCESS) {
 			manager->workers++;
@@ -1438,6 +1889,10 @@ isc__taskmgr_create(isc_mem_t *mctx, unsigned int workers,
 	return (ISC_R_SUCCESS);
 
 #ifdef USE_WORKER_THREADS
+ cleanup_queues:
+	queues_free(manager, mctx);
+ cleanup_paused:
+	(void)isc_condition_destroy(&manager->paused);
  cleanup_exclusivegranted:
 	(void)isc_condition_destroy(&manager->exclusive_granted);
  cleanup_workavailable:
@@ -1514,6 +1969,9 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * If privileged mode was on, turn it off.
 	 */
 	manager->mode = isc_taskmgrmode_normal;
+#ifdef USE_WORKER_THREADS
+	update_queues(manager);
+#endif /* USE_WORKER_THREADS */
 
 	/*
 	 * Post shutdown event(s) to every task (if they haven't already been
@@ -1534,6 +1992,7 @@ isc__taskmgr_destroy(isc_taskmgr_t **managerp) {
 	 * it will cause the workers to see manager->exiting.
 	 */
 	BROADCAST(&manager->work_available);
+	wake_queues(manager);
 	UNLOCK(&manager->lock);
 
 	/*
@@ -1569,6 +2028,10 @@ isc__taskmgr_setmode(isc_taskmgr_t *manager0, isc_taskmgrmode_t mode) {
 
 	LOCK(&manager->lock);
 	manager->mode = mode;
+#ifdef USE_WORKER_THREADS
+	update_queues(manager);
+	BROADCAST(&manager->work_available);
+#endif /* USE_WORKER_THREADS */
 	UNLOCK(&manager->lock);
 }
 
@@ -1623,10 +2086,11 @@ ISC_TASKFUNC_SCOPE void
 isc__taskmgr_pause(isc_taskmgr_t *manager0) {
 	isc__taskmgr_t *manager = (isc__taskmgr_t *)manager0;
 	LOCK(&manager->lock);
-	while (manager->tasks_running > 0) {
+	manager->pause_requested = ISC_TRUE;
+	update_queues(manager);
+	while (running_tasks(manager) > 0) {
 		WAIT(&manager->paused, &manager->lock);
 	}
-	manager->pause_requested = ISC_TRUE;
 	UNLOCK(&manager->lock);
 }
 
@@ -1637,6 +2101,7 @@ isc__taskmgr_resume(isc_taskmgr_t *manager0) {
 	LOCK(&manager->lock);
 	if (manager->pause_requested) {
 		manager->pause_requested = ISC_FALSE;
+		update_queues(manager);
 		BROADCAST(&manager->work_available);
 	}
 	UNLOCK(&manager->lock);
@@ -1684,7 +2149,8 @@ isc__task_beginexclusive(isc_task_t *task0) {
 		return (ISC_R_LOCKBUSY);
 	}
 	manager->exclusive_requested = ISC_TRUE;
-	while (manager->tasks_running > 1) {
+	update_queues(manager);
+	while (running_tasks(manager) > 1) {
 		WAIT(&manager->exclusive_granted, &manager->lock);
 	}
 	UNLOCK(&manager->lock);
@@ -1704,6 +2170,7 @@ isc__task_endexclusive(isc_task_t *task0) {
 	LOCK(&manager->lock);
 	REQUIRE(manager->exclusive_requested);
 	manager->exclusive_requested = ISC_FALSE;
+	update_queues(manager);
 	BROADCAST(&manager->work_available);
 	UNLOCK(&manager->lock);
 #else
@@ -1804,7 +2271,12 @@ isc_taskmgr_renderxml(isc_taskmgr_t *mgr0, xmlTextWriterPtr writer) {
 	TRY0(xmlTextWriterEndElement(writer)); /* default-quantum */
 
 	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "tasks-running"));
+#ifdef USE_WORKER_THREADS
+	TRY0(xmlTextWriterWriteFormatString(writer, "%d",
+					    running_tasks(mgr)));
+#else
 	TRY0(xmlTextWriterWriteFormatString(writer, "%d", mgr->tasks_running));
+#endif /* USE_WORKER_THREADS */
 	TRY0(xmlTextWriterEndElement(writer)); /* tasks-running */
 
 	TRY0(xmlTextWriterEndElement(writer)); /* thread-model */
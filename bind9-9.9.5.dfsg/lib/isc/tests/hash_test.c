@@ -27,6 +27,7 @@
 
 #include <isc/hmacmd5.h>
 #include <isc/hmacsha.h>
+#include <isc/iterated_hash.h>
 #include <isc/md5.h>
 #include <isc/sha1.h>
 #include <isc/util.h>
@@ -1642,6 +1643,168 @@ ATF_TC_BODY(isc_hmacsha512, tc) {
 }
 
 
+/* NSEC3 iterated hash tests */
+ATF_TC(isc_iterated_hash);
+ATF_TC_HEAD(isc_iterated_hash, tc) {
+	atf_tc_set_md_var(tc, "descr", "NSEC3 hashes from RFC5155 "
+				       "appendix A, singly and batched");
+}
+ATF_TC_BODY(isc_iterated_hash, tc) {
+	unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	unsigned char wire[12][256], hash[12][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[12];
+	const unsigned char *in[12];
+	int inlength[12];
+	unsigned int n, j;
+	int len;
+
+	/*
+	 * Owner names in wire format and their hashes with 12
+	 * iterations and salt aabbccdd.
+	 */
+	hash_testcase_t testcases[] = {
+		{
+			TEST_INPUT("\007example\000"),
+			"0x065368ABEED7EC6E9FEBA96B8C8BC3E8B791F716", 1
+		},
+		{
+			TEST_INPUT("\001a\007example\000"),
+			"0x196DD8C3306783A8190F52C262D2B7E5E836E7F5", 1
+		},
+		{
+			TEST_INPUT("\002ai\007example\000"),
+			"0x84DDA71446CD56F0C116A57254BAEF69D09BCE12", 1
+		},
+		{
+			TEST_INPUT("\003ns1\007example\000"),
+			"0x174EB2409FE28BCB4887A1836F957F0A8425E27B", 1
+		},
+		{
+			TEST_INPUT("\003ns2\007example\000"),
+			"0xD0093A31DFD7EDE41760091876D16A1A3009C8BB", 1
+		},
+		{
+			TEST_INPUT("\001w\007example\000"),
+			"0xA23CD75BF90CC4F3BA069B979E04FFC8EE891511", 1
+		},
+		{
+			TEST_INPUT("\001*\001w\007example\000"),
+			"0xD946BD1D8C17BF6F2DFE2E196B1B2EDF13DA25D7", 1
+		},
+		{
+			TEST_INPUT("\001x\001w\007example\000"),
+			"0x593D6419D08C5BC35DCA0A4DCB7ED5C131BE2525", 1
+		},
+		{
+			TEST_INPUT("\001y\001w\007example\000"),
+			"0x9C8D77614ECFD0B2E0D423BE31A9715223D4BE0C", 1
+		},
+		{
+			TEST_INPUT("\001x\001y\001w\007example\000"),
+			"0x17F3DF17B2B2ADAEF615257DE4D2020B80AC6C7C", 1
+		},
+		{
+			TEST_INPUT("\002xx\007example\000"),
+			"0xE988472F544AE4B65D4839212FECD3C4CC2B563F", 1
+		},
+		{
+			TEST_INPUT("\0402t7b4g4vsa5smi47k61mv5bv1a22bojr"
+				   "\007example\000"),
+			"0xA622AD9ECB5A1AC131C85275FAA238B92851FA32", 1
+		}
+	};
+
+	UNUSED(tc);
+
+	for (n = 0; n < 12; n++) {
+		len = isc_iterated_hash(hash[n], 1, 12, salt, sizeof(salt),
+					(const unsigned char *)
+					testcases[n].input,
+					(int)testcases[n].input_len);
+		ATF_REQUIRE_EQ(len, ISC_SHA1_DIGESTLENGTH);
+		tohexstr(hash[n], ISC_SHA1_DIGESTLENGTH, str);
+		ATF_CHECK_STREQ(str, testcases[n].result);
+	}
+
+	/*
+	 * Every batch size up to 12 takes each path through the
+	 * batched code.
+	 */
+	for (n = 1; n <= 12; n++) {
+		for (j = 0; j < n; j++) {
+			memmove(wire[j], testcases[j].input,
+				testcases[j].input_len);
+			in[j] = wire[j];
+			inlength[j] = (int)testcases[j].input_len;
+			out[j] = hash[j];
+			memset(hash[j], 0, sizeof(hash[j]));
+		}
+		len = isc_iterated_hash_batch(out, 1, 12, salt, sizeof(salt),
+					      in, inlength, n);
+		ATF_REQUIRE_EQ(len, ISC_SHA1_DIGESTLENGTH);
+		for (j = 0; j < n; j++) {
+			tohexstr(hash[j], ISC_SHA1_DIGESTLENGTH, str);
+			ATF_CHECK_STREQ(str, testcases[j].result);
+		}
+	}
+
+	ATF_CHECK_EQ(isc_iterated_hash(hash[0], 2, 12, salt, sizeof(salt),
+				       in[0], inlength[0]), 0);
+	ATF_CHECK_EQ(isc_iterated_hash_batch(out, 2, 12, salt, sizeof(salt),
+					     in, inlength, 12), 0);
+}
+
+ATF_TC(isc_iterated_hash_batch);
+ATF_TC_HEAD(isc_iterated_hash_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "batched NSEC3 hashes match "
+				       "single ones");
+}
+ATF_TC_BODY(isc_iterated_hash_batch, tc) {
+	static const int saltlengths[] = { 0, 4, 35, 36, 100, 255 };
+	static const int iterations[] = { 0, 1, 10, 150 };
+	unsigned char names[19][255], saltbuf[255];
+	unsigned char batched[19][NSEC3_MAX_HASH_LENGTH];
+	unsigned char single[NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[19];
+	const unsigned char *in[19];
+	int inlength[19];
+	unsigned int s, it, n, j, k;
+
+	UNUSED(tc);
+
+	for (j = 0; j < sizeof(saltbuf); j++)
+		saltbuf[j] = (unsigned char)(j * 7 + 1);
+	for (j = 0; j < 19; j++) {
+		for (k = 0; k < sizeof(names[j]); k++)
+			names[j][k] = (unsigned char)(j * 31 + k);
+		in[j] = names[j];
+		out[j] = batched[j];
+	}
+
+	for (s = 0; s < sizeof(saltlengths) / sizeof(saltlengths[0]); s++)
+	for (it = 0; it < sizeof(iterations) / sizeof(iterations[0]); it++)
+	for (n = 1; n <= 19; n += 3) {
+		/*
+		 * Alternate between names that need the same number of
+		 * blocks and names that do not.
+		 */
+		for (j = 0; j < n; j++)
+			inlength[j] = (n % 2 == 0) ? 13 + j : 13 + j * 13;
+		ATF_REQUIRE_EQ(isc_iterated_hash_batch(out, 1, iterations[it],
+						       saltbuf,
+						       saltlengths[s], in,
+						       inlength, n),
+			       ISC_SHA1_DIGESTLENGTH);
+		for (j = 0; j < n; j++) {
+			(void)isc_iterated_hash(single, 1, iterations[it],
+						saltbuf, saltlengths[s],
+						in[j], inlength[j]);
+			ATF_CHECK(memcmp(single, batched[j],
+					 ISC_SHA1_DIGESTLENGTH) == 0);
+		}
+	}
+}
+
 /* HMAC-MD5 Test */
 ATF_TC(isc_hmacmd5);
 ATF_TC_HEAD(isc_hmacmd5, tc) {
@@ -1794,6 +1957,8 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, isc_hmacsha256);
 	ATF_TP_ADD_TC(tp, isc_hmacsha384);
 	ATF_TP_ADD_TC(tp, isc_hmacsha512);
+	ATF_TP_ADD_TC(tp, isc_iterated_hash);
+	ATF_TP_ADD_TC(tp, isc_iterated_hash_batch);
 	ATF_TP_ADD_TC(tp, isc_md5);
 	ATF_TP_ADD_TC(tp, isc_sha1);
 	ATF_TP_ADD_TC(tp, isc_sha224);
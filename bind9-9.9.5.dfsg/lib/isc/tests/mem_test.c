@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* $Id$ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/thread.h>
+#include <isc/util.h>
+
+#define NTHREADS	4
+#define NITEMS		300
+#define NROUNDS		50
+
+static isc_mem_t *tmctx;
+static isc_mempool_t *tmpool;
+
+/*
+ * Allocate and free batches of blocks of assorted sizes, large enough
+ * that blocks keep moving between the thread's cache and the context.
+ */
+static isc_threadresult_t
+mem_thread(isc_threadarg_t arg) {
+	void *items[NITEMS];
+	size_t sizes[NITEMS];
+	unsigned int i, round;
+	unsigned int seed = *(unsigned int *)arg;
+
+	for (round = 0; round < NROUNDS; round++) {
+		for (i = 0; i < NITEMS; i++) {
+			seed = seed * 1103515245 + 12345;
+			sizes[i] = (seed >> 16) % 600;
+			items[i] = isc_mem_get(tmctx, sizes[i]);
+			ATF_REQUIRE(items[i] != NULL);
+			memset(items[i], round & 0xff, sizes[i]);
+		}
+		for (i = 0; i < NITEMS; i++)
+			isc_mem_put(tmctx, items[i], sizes[i]);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+static isc_threadresult_t
+mempool_thread(isc_threadarg_t arg) {
+	void *items[NITEMS];
+	unsigned int i, round;
+
+	UNUSED(arg);
+
+	for (round = 0; round < NROUNDS; round++) {
+		for (i = 0; i < NITEMS; i++) {
+			items[i] = isc_mempool_get(tmpool);
+			ATF_REQUIRE(items[i] != NULL);
+			memset(items[i], round & 0xff, 24);
+		}
+		for (i = 0; i < NITEMS; i++)
+			isc_mempool_put(tmpool, items[i]);
+	}
+
+	return ((isc_threadresult_t)0);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+static isc_mutex_t limitlock;
+static isc_boolean_t cached, limited;
+static unsigned int thread_allocated;
+
+/*
+ * Leave some items in this thread's cache, wait for the main thread to
+ * set a limit on the pool, then use the pool once more.
+ */
+static isc_threadresult_t
+limit_thread(isc_threadarg_t arg) {
+	void *items[10];
+	isc_boolean_t done = ISC_FALSE;
+	unsigned int i;
+
+	UNUSED(arg);
+
+	for (i = 0; i < 10; i++)
+		items[i] = isc_mempool_get(tmpool);
+	for (i = 0; i < 10; i++)
+		isc_mempool_put(tmpool, items[i]);
+
+	LOCK(&limitlock);
+	cached = ISC_TRUE;
+	UNLOCK(&limitlock);
+	while (!done) {
+		usleep(1000);
+		LOCK(&limitlock);
+		done = limited;
+		UNLOCK(&limitlock);
+	}
+
+	items[0] = isc_mempool_get(tmpool);
+	thread_allocated = isc_mempool_getallocated(tmpool);
+	isc_mempool_put(tmpool, items[0]);
+
+	return ((isc_threadresult_t)0);
+}
+
+static size_t thread_inuse;
+
+/*
+ * The same for a memory context: leave blocks of one size in this
+ * thread's cache, then get a block of another size after the quota
+ * is set.
+ */
+static isc_threadresult_t
+quota_thread(isc_threadarg_t arg) {
+	void *items[10];
+	isc_boolean_t done = ISC_FALSE;
+	unsigned int i;
+
+	UNUSED(arg);
+
+	for (i = 0; i < 10; i++)
+		items[i] = isc_mem_get(tmctx, 100);
+	for (i = 0; i < 10; i++)
+		isc_mem_put(tmctx, items[i], 100);
+
+	LOCK(&limitlock);
+	cached = ISC_TRUE;
+	UNLOCK(&limitlock);
+	while (!done) {
+		usleep(1000);
+		LOCK(&limitlock);
+		done = limited;
+		UNLOCK(&limitlock);
+	}
+
+	items[0] = isc_mem_get(tmctx, 16);
+	thread_inuse = isc_mem_inuse(tmctx);
+	isc_mem_put(tmctx, items[0], 16);
+
+	return ((isc_threadresult_t)0);
+}
+#endif
+
+static int hiwater, lowater;
+
+static void
+water(void *arg, int mark) {
+	isc_mem_t *mctx = arg;
+
+	if (mark == ISC_MEM_HIWATER)
+		hiwater++;
+	else
+		lowater++;
+	isc_mem_waterack(mctx, mark);
+}
+
+/*
+ * Individual unit tests
+ */
+
+/* Allocate from one context in several threads */
+ATF_TC(mem_threads);
+ATF_TC_HEAD(mem_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "isc_mem_get/put from several threads");
+}
+ATF_TC_BODY(mem_threads, tc) {
+	isc_result_t result;
+	unsigned int seeds[NTHREADS];
+	int i;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+#endif
+
+	UNUSED(tc);
+
+	tmctx = NULL;
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < NTHREADS; i++)
+		seeds[i] = i + 1;
+#ifdef ISC_PLATFORM_USETHREADS
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(mem_thread, &seeds[i], &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+#else
+	for (i = 0; i < NTHREADS; i++)
+		(void)mem_thread(&seeds[i]);
+#endif
+
+	/*
+	 * Everything was given back, so only cached blocks can remain
+	 * in use; destroying the context checks that every block is
+	 * accounted for.
+	 */
+	ATF_CHECK(isc_mem_inuse(tmctx) <= (NTHREADS + 1) * 32768U);
+
+	/*
+	 * The threads have exited, so changing the quota takes back the
+	 * blocks left in their caches.
+	 */
+	isc_mem_setquota(tmctx, 1000000);
+	ATF_CHECK_EQ(isc_mem_inuse(tmctx), 0);
+	isc_mem_destroy(&tmctx);
+}
+
+/* Use a locked memory pool from several threads */
+ATF_TC(mempool_threads);
+ATF_TC_HEAD(mempool_threads, tc) {
+	atf_tc_set_md_var(tc, "descr", "isc_mempool_get/put from several "
+				       "threads");
+}
+ATF_TC_BODY(mempool_threads, tc) {
+	isc_result_t result;
+	isc_mutex_t lock;
+	void *item;
+	int i;
+#ifdef ISC_PLATFORM_USETHREADS
+	isc_thread_t threads[NTHREADS];
+#endif
+
+	UNUSED(tc);
+
+	tmctx = NULL;
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	tmpool = NULL;
+	result = isc_mempool_create(tmctx, 24, &tmpool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mempool_setfreemax(tmpool, 64);
+	isc_mempool_setfillcount(tmpool, 16);
+	isc_mempool_associatelock(tmpool, &lock);
+
+#ifdef ISC_PLATFORM_USETHREADS
+	for (i = 0; i < NTHREADS; i++) {
+		result = isc_thread_create(mempool_thread, NULL, &threads[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < NTHREADS; i++)
+		isc_thread_join(threads[i], NULL);
+#else
+	for (i = 0; i < NTHREADS; i++)
+		(void)mempool_thread(NULL);
+#endif
+
+	/* Only items in the threads' caches may still count. */
+	ATF_CHECK(isc_mempool_getallocated(tmpool) <= NTHREADS * 16U);
+
+	/*
+	 * A limit takes back the items left in the exited threads' caches
+	 * and turns the caches off; the limit must hold exactly.
+	 */
+	isc_mempool_setmaxalloc(tmpool, 1);
+	ATF_CHECK_EQ(isc_mempool_getallocated(tmpool), 0);
+	item = isc_mempool_get(tmpool);
+	ATF_CHECK(item != NULL);
+	ATF_CHECK(isc_mempool_get(tmpool) == NULL);
+	if (item != NULL)
+		isc_mempool_put(tmpool, item);
+
+	/* Destroying the pool takes back what the caches still hold. */
+	isc_mempool_destroy(&tmpool);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&tmctx);
+}
+
+#ifdef ISC_PLATFORM_USETHREADS
+/* A limit set while another thread holds cached items */
+ATF_TC(mempool_limit);
+ATF_TC_HEAD(mempool_limit, tc) {
+	atf_tc_set_md_var(tc, "descr", "a running thread gives back its "
+				       "cached items when a limit is set");
+}
+ATF_TC_BODY(mempool_limit, tc) {
+	isc_result_t result;
+	isc_mutex_t lock;
+	isc_thread_t thread;
+	isc_boolean_t ready = ISC_FALSE;
+
+	UNUSED(tc);
+
+	tmctx = NULL;
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&limitlock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	tmpool = NULL;
+	result = isc_mempool_create(tmctx, 24, &tmpool);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_mempool_associatelock(tmpool, &lock);
+
+	cached = limited = ISC_FALSE;
+	result = isc_thread_create(limit_thread, NULL, &thread);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	while (!ready) {
+		usleep(1000);
+		LOCK(&limitlock);
+		ready = cached;
+		UNLOCK(&limitlock);
+	}
+
+	/* The running thread's cache is emptied the next time it is used. */
+	ATF_CHECK(isc_mempool_getallocated(tmpool) > 0);
+	isc_mempool_setmaxalloc(tmpool, 100);
+	ATF_CHECK(isc_mempool_getallocated(tmpool) > 0);
+
+	LOCK(&limitlock);
+	limited = ISC_TRUE;
+	UNLOCK(&limitlock);
+	isc_thread_join(thread, NULL);
+
+	ATF_CHECK_EQ(thread_allocated, 1);
+	ATF_CHECK_EQ(isc_mempool_getallocated(tmpool), 0);
+
+	isc_mempool_destroy(&tmpool);
+	DESTROYLOCK(&limitlock);
+	DESTROYLOCK(&lock);
+	isc_mem_destroy(&tmctx);
+}
+#endif
+
+#ifdef ISC_PLATFORM_USETHREADS
+/* A quota set while another thread holds cached blocks */
+ATF_TC(mem_quota);
+ATF_TC_HEAD(mem_quota, tc) {
+	atf_tc_set_md_var(tc, "descr", "a running thread gives back its "
+				       "cached blocks when the quota is set");
+}
+ATF_TC_BODY(mem_quota, tc) {
+	isc_result_t result;
+	isc_thread_t thread;
+	isc_boolean_t ready = ISC_FALSE;
+	size_t inuse;
+
+	UNUSED(tc);
+
+	tmctx = NULL;
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_mutex_init(&limitlock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	cached = limited = ISC_FALSE;
+	result = isc_thread_create(quota_thread, NULL, &thread);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	while (!ready) {
+		usleep(1000);
+		LOCK(&limitlock);
+		ready = cached;
+		UNLOCK(&limitlock);
+	}
+
+	/*
+	 * The running thread's cache is emptied the next time it locks
+	 * the context, here to refill another size.
+	 */
+	inuse = isc_mem_inuse(tmctx);
+	ATF_CHECK(inuse > 0);
+	isc_mem_setquota(tmctx, 1000000);
+	ATF_CHECK_EQ(isc_mem_inuse(tmctx), inuse);
+
+	LOCK(&limitlock);
+	limited = ISC_TRUE;
+	UNLOCK(&limitlock);
+	isc_thread_join(thread, NULL);
+
+	/* Only the batch of the second size was left. */
+	ATF_CHECK(thread_inuse > 0);
+	ATF_CHECK(thread_inuse < inuse);
+
+	isc_mem_setquota(tmctx, 0);
+	ATF_CHECK_EQ(isc_mem_inuse(tmctx), 0);
+
+	DESTROYLOCK(&limitlock);
+	isc_mem_destroy(&tmctx);
+}
+#endif
+
+/* Water marks are still reported */
+ATF_TC(mem_water);
+ATF_TC_HEAD(mem_water, tc) {
+	atf_tc_set_md_var(tc, "descr", "high and low water with small blocks");
+}
+ATF_TC_BODY(mem_water, tc) {
+	isc_result_t result;
+	void *items[2000];
+	int i;
+
+	UNUSED(tc);
+
+	tmctx = NULL;
+	result = isc_mem_create(0, 0, &tmctx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	hiwater = lowater = 0;
+	isc_mem_setwater(tmctx, water, tmctx, 100000, 50000);
+
+	for (i = 0; i < 2000; i++) {
+		items[i] = isc_mem_get(tmctx, 100);
+		ATF_REQUIRE(items[i] != NULL);
+	}
+	ATF_CHECK_EQ(hiwater, 1);
+	ATF_CHECK(isc_mem_isovermem(tmctx));
+	ATF_CHECK(isc_mem_inuse(tmctx) >= 2000 * 100);
+
+	for (i = 0; i < 2000; i++)
+		isc_mem_put(tmctx, items[i], 100);
+	ATF_CHECK_EQ(lowater, 1);
+	ATF_CHECK(!isc_mem_isovermem(tmctx));
+	ATF_CHECK(isc_mem_inuse(tmctx) < 50000);
+
+	isc_mem_setwater(tmctx, NULL, NULL, 0, 0);
+	isc_mem_destroy(&tmctx);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, mem_threads);
+	ATF_TP_ADD_TC(tp, mempool_threads);
+#ifdef ISC_PLATFORM_USETHREADS
+	ATF_TP_ADD_TC(tp, mempool_limit);
+	ATF_TP_ADD_TC(tp, mem_quota);
+#endif
+	ATF_TP_ADD_TC(tp, mem_water);
+
+	return (atf_no_error());
+}
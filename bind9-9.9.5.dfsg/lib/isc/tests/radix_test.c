@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include "isctest.h"
+
+#define NPREFIXES	2000
+#define NQUERIES	20000
+
+/*
+ * Helper functions
+ */
+
+/*
+ * Make a random address, half of the time inside a range common to
+ * many of the prefixes so that they overlap.
+ */
+static void
+random_addr(isc_netaddr_t *na, int family) {
+	unsigned char buf[16];
+	isc_uint32_t r;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(buf); i++) {
+		isc_random_get(&r);
+		buf[i] = r & 0xff;
+	}
+	isc_random_get(&r);
+	if ((r & 1) != 0) {
+		buf[0] = 10;
+		buf[1] &= 0x03;
+	}
+
+	if (family == AF_INET6) {
+		struct in6_addr in6;
+
+		memmove(&in6, buf, sizeof(in6));
+		isc_netaddr_fromin6(na, &in6);
+	} else {
+		struct in_addr in;
+
+		memmove(&in, buf, sizeof(in));
+		isc_netaddr_fromin(na, &in);
+	}
+}
+
+static void
+insert(isc_radix_tree_t *radix, const isc_netaddr_t *na, unsigned int bits) {
+	isc_radix_node_t *node = NULL;
+	isc_prefix_t pfx;
+	isc_result_t result;
+
+	NETADDR_TO_PREFIX_T(na, pfx, bits);
+	result = isc_radix_insert(radix, &node, NULL, &pfx);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_refcount_destroy(&pfx.refcount);
+}
+
+static void
+fill(isc_radix_tree_t *radix, unsigned int n) {
+	isc_netaddr_t na;
+	isc_uint32_t r;
+	unsigned int i;
+	int family;
+
+	for (i = 0; i < n; i++) {
+		if (i == n / 2) {
+			/* "any" */
+			insert(radix, NULL, 0);
+			continue;
+		}
+		isc_random_get(&r);
+		family = (r & 1) != 0 ? AF_INET6 : AF_INET;
+		random_addr(&na, family);
+		isc_random_get(&r);
+		if (family == AF_INET6)
+			insert(radix, &na, 8 + r % 121);
+		else
+			insert(radix, &na, 4 + r % 29);
+	}
+}
+
+static isc_radix_node_t *
+search(isc_radix_tree_t *radix, const isc_netaddr_t *na) {
+	isc_radix_node_t *node = NULL;
+	isc_prefix_t pfx;
+	isc_result_t result;
+
+	NETADDR_TO_PREFIX_T(na, pfx, na->family == AF_INET6 ? 128 : 32);
+	result = isc_radix_search(radix, &node, &pfx);
+	isc_refcount_destroy(&pfx.refcount);
+	if (result == ISC_R_NOTFOUND)
+		ATF_CHECK_EQ(node, NULL);
+	else
+		ATF_CHECK(result == ISC_R_SUCCESS && node != NULL);
+	return (node);
+}
+
+/*
+ * Check that searches of 'radix' find the same nodes whether it is
+ * compiled or not.
+ */
+static void
+compare(isc_radix_tree_t *radix) {
+	isc_netaddr_t *addrs;
+	isc_radix_node_t **nodes;
+	isc_result_t result;
+	unsigned int i, found = 0;
+
+	addrs = isc_mem_get(mctx, NQUERIES * sizeof(*addrs));
+	ATF_REQUIRE(addrs != NULL);
+	nodes = isc_mem_get(mctx, NQUERIES * sizeof(*nodes));
+	ATF_REQUIRE(nodes != NULL);
+
+	for (i = 0; i < NQUERIES; i++) {
+		random_addr(&addrs[i], (i & 1) != 0 ? AF_INET6 : AF_INET);
+		nodes[i] = search(radix, &addrs[i]);
+	}
+
+	result = isc_radix_compile(radix);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	ATF_REQUIRE(radix->table[0] != NULL && radix->table[1] != NULL);
+
+	for (i = 0; i < NQUERIES; i++) {
+		ATF_CHECK_EQ(search(radix, &addrs[i]), nodes[i]);
+		if (nodes[i] != NULL)
+			found++;
+	}
+	ATF_CHECK(found > 0);
+
+	isc_mem_put(mctx, nodes, NQUERIES * sizeof(*nodes));
+	isc_mem_put(mctx, addrs, NQUERIES * sizeof(*addrs));
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(compile);
+ATF_TC_HEAD(compile, tc) {
+	atf_tc_set_md_var(tc, "descr", "compiled searches find the same "
+				       "first match as the tree");
+}
+ATF_TC_BODY(compile, tc) {
+	isc_radix_tree_t *radix = NULL;
+	isc_netaddr_t na;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* An empty tree. */
+	result = isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_radix_compile(radix);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	random_addr(&na, AF_INET);
+	ATF_CHECK_EQ(search(radix, &na), NULL);
+	isc_radix_destroy(radix, NULL);
+
+	radix = NULL;
+	result = isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	fill(radix, NPREFIXES);
+	compare(radix);
+	isc_radix_destroy(radix, NULL);
+
+	isc_test_end();
+}
+
+ATF_TC(update);
+ATF_TC_HEAD(update, tc) {
+	atf_tc_set_md_var(tc, "descr", "inserting into a compiled tree");
+}
+ATF_TC_BODY(update, tc) {
+	isc_radix_tree_t *radix = NULL;
+	isc_radix_node_t *node;
+	isc_netaddr_t na;
+	isc_result_t result;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_FALSE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_radix_create(mctx, &radix, RADIX_MAXBITS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	random_addr(&na, AF_INET);
+	insert(radix, &na, 32);
+	result = isc_radix_compile(radix);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/* A new prefix is found once the table has gone. */
+	random_addr(&na, AF_INET6);
+	ATF_CHECK_EQ(search(radix, &na), NULL);
+	insert(radix, &na, 128);
+	ATF_CHECK(radix->table[0] == NULL && radix->table[1] == NULL);
+	node = search(radix, &na);
+	ATF_REQUIRE(node != NULL);
+	ATF_CHECK_EQ(node->prefix->bitlen, 128);
+
+	fill(radix, NPREFIXES);
+	compare(radix);
+	isc_radix_destroy(radix, NULL);
+
+	isc_test_end();
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, compile);
+	ATF_TP_ADD_TC(tp, update);
+
+	return (atf_no_error());
+}
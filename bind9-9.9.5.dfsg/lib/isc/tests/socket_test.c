@@ -26,6 +26,7 @@
 #include <time.h>
 
 #include <isc/socket.h>
+#include <isc/stats.h>
 
 #include "../task_p.h"
 #include "isctest.h"
@@ -56,6 +57,63 @@ event_done(isc_task_t *task, isc_event_t *event) {
 	isc_event_free(&event);
 }
 
+static isc_socket_t *newsock = NULL;
+
+static void
+accept_done(isc_task_t *task, isc_event_t *event) {
+	isc_socket_newconnev_t *dev = (isc_socket_newconnev_t *)event;
+	completion_t *completion = event->ev_arg;
+
+	UNUSED(task);
+
+	completion->result = dev->result;
+	if (dev->result == ISC_R_SUCCESS)
+		newsock = dev->newsocket;
+	completion->done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+static void
+connect_done(isc_task_t *task, isc_event_t *event) {
+	isc_socket_connev_t *dev = (isc_socket_connev_t *)event;
+	completion_t *completion = event->ev_arg;
+
+	UNUSED(task);
+
+	completion->result = dev->result;
+	completion->done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
+/*
+ * A sendv() completion hands the buffers back in the event; record them
+ * in the order they come and take them off the list, as a caller that
+ * reuses its buffers must.
+ */
+#define SENDV_BUFS	3
+static isc_buffer_t *sendv_bufs[SENDV_BUFS + 1];
+static unsigned int sendv_nbufs;
+
+static void
+sendv_done(isc_task_t *task, isc_event_t *event) {
+	isc_socketevent_t *dev = (isc_socketevent_t *)event;
+	completion_t *completion = event->ev_arg;
+	isc_buffer_t *b;
+
+	UNUSED(task);
+
+	sendv_nbufs = 0;
+	while ((b = ISC_LIST_HEAD(dev->bufferlist)) != NULL) {
+		ISC_LIST_DEQUEUE(dev->bufferlist, b, link);
+		if (sendv_nbufs <= SENDV_BUFS)
+			sendv_bufs[sendv_nbufs] = b;
+		sendv_nbufs++;
+	}
+	completion->result = dev->result;
+	completion->done = ISC_TRUE;
+	isc_event_free(&event);
+}
+
 static isc_result_t
 waitfor(completion_t *completion) {
 	int i = 0;
@@ -243,12 +301,402 @@ ATF_TC_BODY(udp_dup, tc) {
 	isc_test_end();
 }
 
+/* Test several queued UDP receives being satisfied at once */
+ATF_TC(udp_batch);
+ATF_TC_HEAD(udp_batch, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv with queued receives");
+}
+ATF_TC_BODY(udp_batch, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	char sendbuf[BUFSIZ], recvbuf[8][BUFSIZ];
+	completion_t completion[8], sendcompletion[8];
+	isc_boolean_t seen[8];
+	isc_region_t r;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 5444);
+	isc_sockaddr_fromin(&addr2, &in, 5445);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Queue all of the receives before anything is sent so that the
+	 * datagrams can be read in as few system calls as possible.
+	 */
+	for (i = 0; i < 8; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		seen[i] = ISC_FALSE;
+	}
+
+	for (i = 0; i < 8; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %u", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&sendcompletion[i]);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &sendcompletion[i], &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		unsigned int n;
+
+		waitfor(&sendcompletion[i]);
+		ATF_CHECK_EQ(sendcompletion[i].result, ISC_R_SUCCESS);
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(sscanf(recvbuf[i], "Hello %u", &n), 1);
+		ATF_REQUIRE(n < 8);
+		ATF_CHECK(!seen[n]);
+		seen[n] = ISC_TRUE;
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
+#ifdef HAVE_RECVMMSG
+/* Pick the UDPv4 receive batch count out of the socket statistics */
+static void
+getrecvbatch(isc_statscounter_t counter, isc_uint64_t value, void *arg) {
+	isc_uint64_t *valuep = arg;
+
+	if (counter == isc_sockstatscounter_udp4recvbatch)
+		*valuep = value;
+}
+#endif
+
+/* Test datagrams that are already waiting being read ahead */
+ATF_TC(udp_readahead);
+ATF_TC_HEAD(udp_readahead, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP recv on a busy socket");
+}
+ATF_TC_BODY(udp_readahead, tc) {
+	isc_result_t result;
+	isc_sockaddr_t addr1, addr2;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_stats_t *stats = NULL;
+	char sendbuf[BUFSIZ], recvbuf[8][BUFSIZ];
+	completion_t completion[8], sendcompletion[8];
+	isc_region_t r;
+	unsigned int i, n;
+#ifdef HAVE_RECVMMSG
+	isc_uint64_t batches = 0;
+#endif
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_stats_create(mctx, &stats, isc_sockstatscounter_max);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	isc_socketmgr_setstats(socketmgr, stats);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr1, &in, 5444);
+	isc_sockaddr_fromin(&addr2, &in, 5445);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr1, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_udp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s2, &addr2, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Send everything before receiving anything, so that the datagrams
+	 * are waiting when the receives are made.
+	 */
+	for (i = 0; i < 8; i++) {
+		snprintf(sendbuf, sizeof(sendbuf), "Hello %u", i);
+		r.base = (void *) sendbuf;
+		r.length = strlen(sendbuf) + 1;
+		completion_init(&sendcompletion[i]);
+		result = isc_socket_sendto(s1, &r, task, event_done,
+					   &sendcompletion[i], &addr2, NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+	for (i = 0; i < 8; i++) {
+		waitfor(&sendcompletion[i]);
+		ATF_CHECK_EQ(sendcompletion[i].result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s2, &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(sscanf(recvbuf[i], "Hello %u", &n), 1);
+		ATF_CHECK_EQ(n, i);
+	}
+
+#ifdef HAVE_RECVMMSG
+	/*
+	 * The first receive finds the socket busy; the other seven are
+	 * read with one system call.
+	 */
+	isc_stats_dump(stats, getrecvbatch, &batches, ISC_STATSDUMP_VERBOSE);
+	ATF_CHECK_EQ(batches, 1);
+#endif
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_stats_detach(&stats);
+	isc_test_end();
+}
+
+/* Test UDP sendto/recv over a socket manager with several watchers */
+ATF_TC(udp_watchers);
+ATF_TC_HEAD(udp_watchers, tc) {
+	atf_tc_set_md_var(tc, "descr", "UDP sendto/recv with multiple "
+				       "socket watchers");
+}
+ATF_TC_BODY(udp_watchers, tc) {
+	isc_result_t result;
+	isc_socketmgr_t *mgr = NULL;
+	isc_sockaddr_t addr[8];
+	struct in_addr in;
+	isc_socket_t *s[8];
+	isc_task_t *task = NULL;
+	char sendbuf[8][BUFSIZ], recvbuf[8][BUFSIZ];
+	completion_t completion[8], sendcompletion[8];
+	isc_region_t r;
+	unsigned int i;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socketmgr_create3(mctx, &mgr, 0, 4);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	/*
+	 * Consecutive descriptors land on different watchers; each socket
+	 * sends to the next one in the ring.
+	 */
+	in.s_addr = inet_addr("127.0.0.1");
+	for (i = 0; i < 8; i++) {
+		s[i] = NULL;
+		isc_sockaddr_fromin(&addr[i], &in, 5450 + i);
+		result = isc_socket_create(mgr, PF_INET, isc_sockettype_udp,
+					   &s[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+		result = isc_socket_bind(s[i], &addr[i],
+					 ISC_SOCKET_REUSEADDRESS);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		r.base = (void *) recvbuf[i];
+		r.length = BUFSIZ;
+		completion_init(&completion[i]);
+		result = isc_socket_recv(s[i], &r, 1, task, event_done,
+					 &completion[i]);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		snprintf(sendbuf[i], sizeof(sendbuf[i]), "Hello %u", i);
+		r.base = (void *) sendbuf[i];
+		r.length = strlen(sendbuf[i]) + 1;
+		completion_init(&sendcompletion[i]);
+		result = isc_socket_sendto(s[i], &r, task, event_done,
+					   &sendcompletion[i],
+					   &addr[(i + 1) % 8], NULL);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < 8; i++) {
+		waitfor(&sendcompletion[i]);
+		ATF_CHECK(sendcompletion[i].done);
+		ATF_CHECK_EQ(sendcompletion[i].result, ISC_R_SUCCESS);
+		waitfor(&completion[i]);
+		ATF_CHECK(completion[i].done);
+		ATF_CHECK_EQ(completion[i].result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf[i], sendbuf[(i + 7) % 8]);
+	}
+
+	isc_task_detach(&task);
+
+	for (i = 0; i < 8; i++)
+		isc_socket_detach(&s[i]);
+
+	isc_socketmgr_destroy(&mgr);
+
+	isc_test_end();
+}
+
+/* Test TCP sendv of several buffers, reusing them for a second send */
+ATF_TC(tcp_sendv);
+ATF_TC_HEAD(tcp_sendv, tc) {
+	atf_tc_set_md_var(tc, "descr", "TCP sendv hands back its buffers");
+}
+ATF_TC_BODY(tcp_sendv, tc) {
+	static const char *text[SENDV_BUFS] = { "abc", "defg", "hi" };
+	isc_result_t result;
+	isc_sockaddr_t addr;
+	struct in_addr in;
+	isc_socket_t *s1 = NULL, *s2 = NULL;
+	isc_task_t *task = NULL;
+	isc_buffer_t bufs[SENDV_BUFS];
+	isc_bufferlist_t list;
+	char data[SENDV_BUFS][8], recvbuf[BUFSIZ];
+	completion_t completion, acompletion;
+	isc_region_t r;
+	unsigned int i, round;
+
+	UNUSED(tc);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	in.s_addr = inet_addr("127.0.0.1");
+	isc_sockaddr_fromin(&addr, &in, 5444);
+
+	result = isc_task_create(taskmgr, 0, &task);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_tcp, &s1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_bind(s1, &addr, ISC_SOCKET_REUSEADDRESS);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_socket_listen(s1, 1);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	newsock = NULL;
+	completion_init(&acompletion);
+	result = isc_socket_accept(s1, task, accept_done, &acompletion);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_socket_create(socketmgr, PF_INET, isc_sockettype_tcp, &s2);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	completion_init(&completion);
+	result = isc_socket_connect(s2, &addr, task, connect_done,
+				    &completion);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	waitfor(&completion);
+	ATF_REQUIRE(completion.done);
+	ATF_REQUIRE_EQ(completion.result, ISC_R_SUCCESS);
+	waitfor(&acompletion);
+	ATF_REQUIRE(acompletion.done);
+	ATF_REQUIRE_EQ(acompletion.result, ISC_R_SUCCESS);
+	ATF_REQUIRE(newsock != NULL);
+
+	for (i = 0; i < SENDV_BUFS; i++) {
+		isc_buffer_init(&bufs[i], data[i], sizeof(data[i]));
+		isc_buffer_putmem(&bufs[i], (const unsigned char *)text[i],
+				  strlen(text[i]));
+	}
+
+	for (round = 0; round < 2; round++) {
+		/*
+		 * The buffers can only go on the list again if the
+		 * previous completion took them off it.
+		 */
+		ISC_LIST_INIT(list);
+		for (i = 0; i < SENDV_BUFS; i++)
+			ISC_LIST_APPEND(list, &bufs[i], link);
+
+		completion_init(&completion);
+		result = isc_socket_sendv(s2, &list, task, sendv_done,
+					  &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		/* The socket took the buffers off the caller's list. */
+		ATF_CHECK(ISC_LIST_EMPTY(list));
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_REQUIRE_EQ(sendv_nbufs, SENDV_BUFS);
+		for (i = 0; i < SENDV_BUFS; i++)
+			ATF_CHECK(sendv_bufs[i] == &bufs[i]);
+
+		memset(recvbuf, 0, sizeof(recvbuf));
+		r.base = (void *) recvbuf;
+		r.length = 9;
+		completion_init(&completion);
+		result = isc_socket_recv(newsock, &r, 9, task, event_done,
+					 &completion);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+		waitfor(&completion);
+		ATF_CHECK(completion.done);
+		ATF_CHECK_EQ(completion.result, ISC_R_SUCCESS);
+		ATF_CHECK_STREQ(recvbuf, "abcdefghi");
+	}
+
+	isc_task_detach(&task);
+
+	isc_socket_detach(&newsock);
+	isc_socket_detach(&s1);
+	isc_socket_detach(&s2);
+
+	isc_test_end();
+}
+
 /*
  * Main
  */
 ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, udp_sendto);
 	ATF_TP_ADD_TC(tp, udp_dup);
+	ATF_TP_ADD_TC(tp, udp_batch);
+	ATF_TP_ADD_TC(tp, udp_readahead);
+	ATF_TP_ADD_TC(tp, udp_watchers);
+	ATF_TP_ADD_TC(tp, tcp_sendv);
 
 	return (atf_no_error());
 }
@@ -402,6 +402,72 @@ ATF_TC_BODY(privilege_drop, tc) {
 	isc_test_end();
 }
 
+/*
+ * Send many events to tasks bound to each of the worker threads, and
+ * make sure every one of them is processed whichever worker ends up
+ * running it.
+ */
+ATF_TC(bound_tasks);
+ATF_TC_HEAD(bound_tasks, tc) {
+	atf_tc_set_md_var(tc, "descr", "process events on bound tasks");
+}
+ATF_TC_BODY(bound_tasks, tc) {
+	isc_result_t result;
+	isc_task_t *tasks[16];
+	isc_event_t *event;
+	int values[16 * 8];
+	int i, j, ntasks, nevents, seen;
+
+	UNUSED(tc);
+
+	counter = 1;
+	result = isc_mutex_init(&set_lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	ntasks = (ncpus * 2 < 16) ? ncpus * 2 : 16;
+	nevents = ntasks * 8;
+	for (i = 0; i < ntasks; i++) {
+		tasks[i] = NULL;
+		result = isc_task_create_bound(taskmgr, 0, &tasks[i], i);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	for (i = 0; i < nevents; i++) {
+		values[i] = 0;
+		event = isc_event_allocate(mctx, tasks[i % ntasks],
+					   ISC_TASKEVENT_TEST, set,
+					   &values[i], sizeof (isc_event_t));
+		ATF_REQUIRE(event != NULL);
+		isc_task_send(tasks[i % ntasks], &event);
+	}
+
+	i = 0;
+	do {
+#ifndef ISC_PLATFORM_USETHREADS
+		while (isc__taskmgr_ready(taskmgr))
+			isc__taskmgr_dispatch(taskmgr);
+#endif
+		isc_test_nap(1000);
+		LOCK(&set_lock);
+		seen = counter - 1;
+		UNLOCK(&set_lock);
+	} while (seen < nevents && i++ < 5000);
+
+	ATF_CHECK_EQ(seen, nevents);
+	for (j = 0; j < nevents; j++)
+		ATF_CHECK(values[j] != 0);
+
+	for (i = 0; i < ntasks; i++) {
+		isc_task_destroy(&tasks[i]);
+		ATF_REQUIRE_EQ(tasks[i], NULL);
+	}
+
+	isc_test_end();
+}
+
 /*
  * Main
  */
@@ -410,6 +476,7 @@ ATF_TP_ADD_TCS(tp) {
 	ATF_TP_ADD_TC(tp, all_events);
 	ATF_TP_ADD_TC(tp, privileged_events);
 	ATF_TP_ADD_TC(tp, privilege_drop);
+	ATF_TP_ADD_TC(tp, bound_tasks);
 
 	return (atf_no_error());
 }
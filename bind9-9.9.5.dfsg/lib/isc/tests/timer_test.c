@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2014  Internet Systems Consortium, Inc. ("ISC")
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND ISC DISCLAIMS ALL WARRANTIES WITH
+ * REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+ * AND FITNESS.  IN NO EVENT SHALL ISC BE LIABLE FOR ANY SPECIAL, DIRECT,
+ * INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+ * LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE
+ * OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+ * PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*! \file */
+
+#include <config.h>
+
+#include <atf-c.h>
+
+#include <unistd.h>
+
+#include <isc/task.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/util.h>
+
+#include "../task_p.h"
+#include "../timer_p.h"
+#include "isctest.h"
+
+#define NTIMERS		1000
+
+/*
+ * Helper functions
+ */
+
+static isc_mutex_t lock;
+static unsigned int nevents;
+static unsigned int nearly;
+static isc_eventtype_t lasttype;
+
+/* timer event handler, counts events and those delivered early */
+static void
+count(isc_task_t *task, isc_event_t *event) {
+	isc_timerevent_t *tevent = (isc_timerevent_t *)event;
+	isc_time_t now;
+
+	UNUSED(task);
+
+	isc_time_now(&now);
+	LOCK(&lock);
+	if (isc_time_compare(&now, &tevent->due) < 0)
+		nearly++;
+	nevents++;
+	lasttype = event->ev_type;
+	UNLOCK(&lock);
+	isc_event_free(&event);
+}
+
+static unsigned int
+events(void) {
+	unsigned int n;
+
+	LOCK(&lock);
+	n = nevents;
+	UNLOCK(&lock);
+	return (n);
+}
+
+/* wait up to 'msec' milliseconds for 'n' events */
+static void
+waitfor(isc_timermgr_t *manager, unsigned int n, unsigned int msec) {
+	unsigned int i = 0;
+
+	UNUSED(manager);
+
+	while (events() < n && i++ < msec) {
+#ifndef ISC_PLATFORM_USETHREADS
+		isc__timermgr_dispatch(manager);
+		while (isc__taskmgr_ready(taskmgr))
+			isc__taskmgr_dispatch(taskmgr);
+#endif
+		isc_test_nap(1000);
+	}
+}
+
+static void
+setup(unsigned int nshards, isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_result_t result;
+
+	result = isc_mutex_init(&lock);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	nevents = 0;
+	nearly = 0;
+	lasttype = 0;
+
+	result = isc_test_begin(NULL, ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_timermgr_create2(mctx, managerp, nshards);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	result = isc_task_create(taskmgr, 0, taskp);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+}
+
+static void
+teardown(isc_timermgr_t **managerp, isc_task_t **taskp) {
+	isc_task_detach(taskp);
+	isc_timermgr_destroy(managerp);
+	isc_test_end();
+	DESTROYLOCK(&lock);
+}
+
+static void
+ticker(unsigned int nshards) {
+	isc_timermgr_t *manager = NULL;
+	isc_timer_t *timer = NULL;
+	isc_task_t *task = NULL;
+	isc_interval_t interval;
+	isc_result_t result;
+	unsigned int n;
+
+	setup(nshards, &manager, &task);
+
+	isc_interval_set(&interval, 0, 20000000);
+	result = isc_timer_create(manager, isc_timertype_ticker, NULL,
+				  &interval, task, count, NULL, &timer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	waitfor(manager, 5, 2000);
+	ATF_CHECK(events() >= 5);
+	ATF_CHECK_EQ(lasttype, ISC_TIMEREVENT_TICK);
+
+	/* An inactive timer stays quiet. */
+	result = isc_timer_reset(timer, isc_timertype_inactive, NULL, NULL,
+				 ISC_TRUE);
+	ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	n = events();
+	isc_test_nap(100000);
+	ATF_CHECK_EQ(events(), n);
+	ATF_CHECK_EQ(nearly, 0);
+
+	isc_timer_detach(&timer);
+	teardown(&manager, &task);
+}
+
+static void
+onceidle(unsigned int nshards) {
+	isc_timermgr_t *manager = NULL;
+	isc_timer_t *timer = NULL;
+	isc_task_t *task = NULL;
+	isc_interval_t interval;
+	isc_time_t expires;
+	isc_result_t result;
+	unsigned int i;
+
+	setup(nshards, &manager, &task);
+
+	/* A life timer fires once, at its expiry time. */
+	isc_interval_set(&interval, 0, 100000000);
+	result = isc_time_nowplusinterval(&expires, &interval);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	result = isc_timer_create(manager, isc_timertype_once, &expires,
+				  NULL, task, count, NULL, &timer);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+
+	waitfor(manager, 1, 2000);
+	ATF_CHECK_EQ(events(), 1);
+	ATF_CHECK_EQ(lasttype, ISC_TIMEREVENT_LIFE);
+
+	/* An idle timer does not fire while it is being touched. */
+	isc_interval_set(&interval, 0, 50000000);
+	result = isc_timer_reset(timer, isc_timertype_once, NULL, &interval,
+				 ISC_TRUE);
+	ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	for (i = 0; i < 10; i++) {
+		isc_test_nap(20000);
+		result = isc_timer_touch(timer);
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+	ATF_CHECK_EQ(events(), 1);
+
+	waitfor(manager, 2, 2000);
+	ATF_CHECK_EQ(events(), 2);
+	ATF_CHECK_EQ(lasttype, ISC_TIMEREVENT_IDLE);
+	ATF_CHECK_EQ(nearly, 0);
+
+	isc_timer_detach(&timer);
+	teardown(&manager, &task);
+}
+
+static void
+many(unsigned int nshards) {
+	isc_timermgr_t *manager = NULL;
+	isc_timer_t *timers[NTIMERS];
+	isc_task_t *task = NULL;
+	isc_interval_t interval;
+	isc_result_t result;
+	unsigned int i, msec;
+
+	setup(nshards, &manager, &task);
+
+	/*
+	 * Most of the timers are due within half a second; every fourth
+	 * one is due after the root timing wheel has come round.
+	 */
+	for (i = 0; i < NTIMERS; i++) {
+		if (i % 4 == 0)
+			msec = 2600 + i % 300;
+		else
+			msec = (i * 7) % 500;
+		isc_interval_set(&interval, msec / 1000,
+				 (msec % 1000) * 1000000 + 1);
+		timers[i] = NULL;
+		result = isc_timer_create(manager, isc_timertype_once, NULL,
+					  &interval, task, count, NULL,
+					  &timers[i]);
+		ATF_REQUIRE_EQ(result, ISC_R_SUCCESS);
+	}
+
+	/* Stop half of them, and push back a quarter of the rest. */
+	for (i = 0; i < NTIMERS; i++) {
+		if (i % 2 == 1)
+			result = isc_timer_reset(timers[i],
+						 isc_timertype_inactive,
+						 NULL, NULL, ISC_TRUE);
+		else if (i % 8 == 2) {
+			isc_interval_set(&interval, 0, 600000000);
+			result = isc_timer_reset(timers[i],
+						 isc_timertype_once, NULL,
+						 &interval, ISC_TRUE);
+		} else
+			continue;
+		ATF_CHECK_EQ(result, ISC_R_SUCCESS);
+	}
+
+	waitfor(manager, NTIMERS / 2, 5000);
+	isc_test_nap(100000);
+	ATF_CHECK_EQ(events(), NTIMERS / 2);
+	ATF_CHECK_EQ(nearly, 0);
+
+	for (i = 0; i < NTIMERS; i++)
+		isc_timer_detach(&timers[i]);
+	teardown(&manager, &task);
+}
+
+/*
+ * Individual unit tests
+ */
+
+ATF_TC(ticker);
+ATF_TC_HEAD(ticker, tc) {
+	atf_tc_set_md_var(tc, "descr", "ticker timers, heap and wheel");
+}
+ATF_TC_BODY(ticker, tc) {
+	UNUSED(tc);
+
+	ticker(0);
+	ticker(4);
+}
+
+ATF_TC(onceidle);
+ATF_TC_HEAD(onceidle, tc) {
+	atf_tc_set_md_var(tc, "descr", "life and idle timers, heap and wheel");
+}
+ATF_TC_BODY(onceidle, tc) {
+	UNUSED(tc);
+
+	onceidle(0);
+	onceidle(4);
+}
+
+ATF_TC(many);
+ATF_TC_HEAD(many, tc) {
+	atf_tc_set_md_var(tc, "descr", "many timers stopped and reset, "
+				       "heap and wheel");
+}
+ATF_TC_BODY(many, tc) {
+	UNUSED(tc);
+
+	many(0);
+	many(4);
+}
+
+/*
+ * Main
+ */
+ATF_TP_ADD_TCS(tp) {
+	ATF_TP_ADD_TC(tp, ticker);
+	ATF_TP_ADD_TC(tp, onceidle);
+	ATF_TP_ADD_TC(tp, many);
+
+	return (atf_no_error());
+}
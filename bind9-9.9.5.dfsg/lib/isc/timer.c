@@ -73,6 +73,8 @@
 
 typedef struct isc__timer isc__timer_t;
 typedef struct isc__timermgr isc__timermgr_t;
+typedef struct isc__timershard isc__timershard_t;
+typedef ISC_LIST(isc__timer_t) isc__timerlist_t;
 
 struct isc__timer {
 	/*! Not locked. */
@@ -82,7 +84,7 @@ struct isc__timer {
 	/*! Locked by timer lock. */
 	unsigned int			references;
 	isc_time_t			idle;
-	/*! Locked by manager lock. */
+	/*! Locked by manager lock, or by the shard lock if in a shard. */
 	isc_timertype_t			type;
 	isc_time_t			expires;
 	isc_interval_t			interval;
@@ -92,6 +94,50 @@ struct isc__timer {
 	unsigned int			index;
 	isc_time_t			due;
 	LINK(isc__timer_t)		link;
+	/*! Timing wheel only; locked by the shard lock. */
+	isc__timershard_t *		shard;
+	isc_uint64_t			tick;
+	isc__timerlist_t *		slot;
+	LINK(isc__timer_t)		slotlink;
+};
+
+/*%
+ * A manager created with shards keeps its timers in hierarchical timing
+ * wheels instead of a heap, so that scheduling or descheduling a timer
+ * takes constant time.  Time is counted in ticks of WHEEL_TICK
+ * microseconds since the manager was created, and due times are rounded
+ * up to a whole tick.  The root wheel has a slot for each of the next
+ * WHEEL_ROOTSIZE ticks; each of the levels above it covers
+ * WHEEL_LEVELSIZE times the range of the one below, and its slots are
+ * moved ("cascaded") down a level as the root wheel comes round.  A
+ * timer due beyond the range of the top level waits in its furthest
+ * slot until it comes into range.
+ *
+ * Each shard is a complete set of wheels with its own lock, so that
+ * threads arming different timers seldom contend.  A timer stays in the
+ * shard it was given when it was created.
+ */
+#define WHEEL_TICK		10000		/* microseconds */
+#define WHEEL_ROOTBITS		8
+#define WHEEL_ROOTSIZE		(1 << WHEEL_ROOTBITS)
+#define WHEEL_ROOTMASK		(WHEEL_ROOTSIZE - 1)
+#define WHEEL_LEVELBITS		6
+#define WHEEL_LEVELSIZE		(1 << WHEEL_LEVELBITS)
+#define WHEEL_LEVELMASK		(WHEEL_LEVELSIZE - 1)
+#define WHEEL_LEVELS		4
+#define WHEEL_RANGE \
+	((isc_uint64_t)1 << (WHEEL_ROOTBITS + WHEEL_LEVELS * WHEEL_LEVELBITS))
+#define WHEEL_NEVER		(~(isc_uint64_t)0)
+
+struct isc__timershard {
+	isc_mutex_t			lock;
+	/* Locked by shard lock. */
+	unsigned int			nscheduled;
+	isc_uint64_t			tick;	/*%< Next tick to expire */
+	isc_uint64_t			next;	/*%< Next tick the run
+						     thread will look at */
+	isc__timerlist_t		root[WHEEL_ROOTSIZE];
+	isc__timerlist_t		levels[WHEEL_LEVELS][WHEEL_LEVELSIZE];
 };
 
 #define TIMER_MANAGER_MAGIC		ISC_MAGIC('T', 'I', 'M', 'M')
@@ -102,11 +148,17 @@ struct isc__timermgr {
 	isc_timermgr_t			common;
 	isc_mem_t *			mctx;
 	isc_mutex_t			lock;
+	isc_time_t			epoch;
+	unsigned int			nshards;
+	isc__timershard_t *		shards;
 	/* Locked by manager lock. */
 	isc_boolean_t			done;
 	LIST(isc__timer_t)		timers;
 	unsigned int			nscheduled;
 	isc_time_t			due;
+	unsigned int			nextshard;
+	isc_boolean_t			scanning;
+	isc_boolean_t			rescan;
 #ifdef USE_TIMER_THREAD
 	isc_condition_t			wakeup;
 	isc_thread_t			thread;
@@ -147,6 +199,9 @@ ISC_TIMERFUNC_SCOPE void
 isc__timer_detach(isc_timer_t **timerp);
 ISC_TIMERFUNC_SCOPE isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp);
+ISC_TIMERFUNC_SCOPE isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		      unsigned int nshards);
 ISC_TIMERFUNC_SCOPE void
 isc__timermgr_poke(isc_timermgr_t *manager0);
 ISC_TIMERFUNC_SCOPE void
@@ -197,6 +252,34 @@ static struct isc__timermgrmethods {
 static isc__timermgr_t *timermgr = NULL;
 #endif /* USE_SHARED_MANAGER */
 
+static inline isc_result_t
+nextdue(isc__timer_t *timer, isc_time_t *now, isc_time_t *duep) {
+	isc_result_t result;
+
+	/*
+	 * Compute the new due time.
+	 */
+	if (timer->type != isc_timertype_once) {
+		result = isc_time_add(now, &timer->interval, duep);
+		if (result != ISC_R_SUCCESS)
+			return (result);
+		if (timer->type == isc_timertype_limited &&
+		    isc_time_compare(&timer->expires, duep) < 0)
+			*duep = timer->expires;
+	} else {
+		if (isc_time_isepoch(&timer->idle))
+			*duep = timer->expires;
+		else if (isc_time_isepoch(&timer->expires))
+			*duep = timer->idle;
+		else if (isc_time_compare(&timer->idle, &timer->expires) < 0)
+			*duep = timer->idle;
+		else
+			*duep = timer->expires;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static inline isc_result_t
 schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	isc_result_t result;
@@ -228,26 +311,9 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 			   isc_time_seconds(&manager->due) != 0);
 #endif
 
-	/*
-	 * Compute the new due time.
-	 */
-	if (timer->type != isc_timertype_once) {
-		result = isc_time_add(now, &timer->interval, &due);
-		if (result != ISC_R_SUCCESS)
-			return (result);
-		if (timer->type == isc_timertype_limited &&
-		    isc_time_compare(&timer->expires, &due) < 0)
-			due = timer->expires;
-	} else {
-		if (isc_time_isepoch(&timer->idle))
-			due = timer->expires;
-		else if (isc_time_isepoch(&timer->expires))
-			due = timer->idle;
-		else if (isc_time_compare(&timer->idle, &timer->expires) < 0)
-			due = timer->idle;
-		else
-			due = timer->expires;
-	}
+	result = nextdue(timer, now, &due);
+	if (result != ISC_R_SUCCESS)
+		return (result);
 
 	/*
 	 * Schedule the timer.
@@ -331,6 +397,122 @@ schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t signal_ok) {
 	return (ISC_R_SUCCESS);
 }
 
+static inline isc_uint64_t
+wheel_tick(isc__timermgr_t *manager, const isc_time_t *t,
+	   isc_boolean_t roundup)
+{
+	isc_uint64_t usec;
+
+	usec = isc_time_microdiff(t, &manager->epoch);
+	if (roundup)
+		usec += WHEEL_TICK - 1;
+	return (usec / WHEEL_TICK);
+}
+
+static void
+wheel_insert(isc__timershard_t *shard, isc__timer_t *timer) {
+	isc__timerlist_t *slot;
+	isc_uint64_t tick, delta;
+	unsigned int level, shift;
+
+	/*
+	 * The caller must be holding the shard lock.
+	 */
+
+	tick = timer->tick;
+	if (tick < shard->tick)
+		tick = shard->tick;
+	delta = tick - shard->tick;
+
+	if (delta < WHEEL_ROOTSIZE)
+		slot = &shard->root[tick & WHEEL_ROOTMASK];
+	else {
+		if (delta >= WHEEL_RANGE) {
+			delta = WHEEL_RANGE - 1;
+			tick = shard->tick + delta;
+		}
+		shift = WHEEL_ROOTBITS;
+		for (level = 0; level < WHEEL_LEVELS - 1; level++) {
+			if (delta < ((isc_uint64_t)1 <<
+				     (shift + WHEEL_LEVELBITS)))
+				break;
+			shift += WHEEL_LEVELBITS;
+		}
+		slot = &shard->levels[level][(tick >> shift) & WHEEL_LEVELMASK];
+	}
+
+	APPEND(*slot, timer, slotlink);
+	timer->slot = slot;
+}
+
+static isc_result_t
+wheel_schedule(isc__timer_t *timer, isc_time_t *now, isc_boolean_t *wakeupp) {
+	isc__timershard_t *shard = timer->shard;
+	isc_result_t result;
+	isc_time_t due;
+
+	/*
+	 * The caller must be holding the shard lock, and must call
+	 * wheel_wakeup() after releasing it if '*wakeupp' is set.
+	 */
+
+	REQUIRE(timer->type != isc_timertype_inactive);
+
+	result = nextdue(timer, now, &due);
+	if (result != ISC_R_SUCCESS)
+		return (result);
+
+	if (timer->index > 0)
+		UNLINK(*timer->slot, timer, slotlink);
+	else {
+		timer->index = 1;
+		shard->nscheduled++;
+	}
+	timer->due = due;
+	timer->tick = wheel_tick(timer->manager, &due, ISC_TRUE);
+	wheel_insert(shard, timer);
+
+	/*
+	 * The run thread needs waking only if it would otherwise sleep
+	 * past this timer.
+	 */
+	if (timer->tick < shard->next) {
+		shard->next = timer->tick;
+		*wakeupp = ISC_TRUE;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+wheel_wakeup(isc__timermgr_t *manager) {
+#ifdef USE_TIMER_THREAD
+	LOCK(&manager->lock);
+	if (manager->scanning)
+		manager->rescan = ISC_TRUE;
+	else
+		SIGNAL(&manager->wakeup);
+	UNLOCK(&manager->lock);
+#else
+	UNUSED(manager);
+#endif
+}
+
+static inline void
+wheel_deschedule(isc__timer_t *timer) {
+	/*
+	 * The caller must be holding the shard lock.
+	 */
+
+	if (timer->index > 0) {
+		UNLINK(*timer->slot, timer, slotlink);
+		timer->slot = NULL;
+		timer->index = 0;
+		INSIST(timer->shard->nscheduled > 0);
+		timer->shard->nscheduled--;
+	}
+}
+
 static inline void
 deschedule(isc__timer_t *timer) {
 #ifdef USE_TIMER_THREAD
@@ -342,6 +524,11 @@ deschedule(isc__timer_t *timer) {
 	 * The caller must ensure locking.
 	 */
 
+	if (timer->shard != NULL) {
+		wheel_deschedule(timer);
+		return;
+	}
+
 	manager = timer->manager;
 	if (timer->index > 0) {
 #ifdef USE_TIMER_THREAD
@@ -372,6 +559,8 @@ destroy(isc__timer_t *timer) {
 	 */
 
 	LOCK(&manager->lock);
+	if (timer->shard != NULL)
+		LOCK(&timer->shard->lock);
 
 	(void)isc_task_purgerange(timer->task,
 				  timer,
@@ -379,6 +568,8 @@ destroy(isc__timer_t *timer) {
 				  ISC_TIMEREVENT_LASTEVENT,
 				  NULL);
 	deschedule(timer);
+	if (timer->shard != NULL)
+		UNLOCK(&timer->shard->lock);
 	UNLINK(manager->timers, timer, link);
 
 	UNLOCK(&manager->lock);
@@ -471,6 +662,9 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 */
 	DE_CONST(arg, timer->arg);
 	timer->index = 0;
+	timer->shard = NULL;
+	timer->tick = 0;
+	timer->slot = NULL;
 	result = isc_mutex_init(&timer->lock);
 	if (result != ISC_R_SUCCESS) {
 		isc_task_detach(&timer->task);
@@ -478,6 +672,7 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 		return (result);
 	}
 	ISC_LINK_INIT(timer, link);
+	ISC_LINK_INIT(timer, slotlink);
 	timer->common.impmagic = TIMER_MAGIC;
 	timer->common.magic = ISCAPI_TIMER_MAGIC;
 	timer->common.methods = (isc_timermethods_t *)&timermethods;
@@ -489,7 +684,12 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 	 * there are no external references to it yet.
 	 */
 
-	if (type != isc_timertype_inactive)
+	if (manager->nshards > 0) {
+		timer->shard = &manager->shards[manager->nextshard];
+		manager->nextshard = (manager->nextshard + 1) %
+				     manager->nshards;
+		result = ISC_R_SUCCESS;
+	} else if (type != isc_timertype_inactive)
 		result = schedule(timer, &now, ISC_TRUE);
 	else
 		result = ISC_R_SUCCESS;
@@ -498,6 +698,21 @@ isc__timer_create(isc_timermgr_t *manager0, isc_timertype_t type,
 
 	UNLOCK(&manager->lock);
 
+	if (timer->shard != NULL && type != isc_timertype_inactive) {
+		isc_boolean_t wakeup = ISC_FALSE;
+
+		LOCK(&timer->shard->lock);
+		result = wheel_schedule(timer, &now, &wakeup);
+		UNLOCK(&timer->shard->lock);
+		if (wakeup)
+			wheel_wakeup(manager);
+		if (result != ISC_R_SUCCESS) {
+			LOCK(&manager->lock);
+			UNLINK(manager->timers, timer, link);
+			UNLOCK(&manager->lock);
+		}
+	}
+
 	if (result != ISC_R_SUCCESS) {
 		timer->common.impmagic = 0;
 		timer->common.magic = 0;
@@ -521,6 +736,7 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 	isc_time_t now;
 	isc__timermgr_t *manager;
 	isc_result_t result;
+	isc_boolean_t wakeup = ISC_FALSE;
 
 	/*
 	 * Change the timer's type, expires, and interval values to the given
@@ -555,7 +771,10 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		isc_time_settoepoch(&now);
 	}
 
-	LOCK(&manager->lock);
+	if (timer->shard != NULL)
+		LOCK(&timer->shard->lock);
+	else
+		LOCK(&manager->lock);
 	LOCK(&timer->lock);
 
 	if (purge)
@@ -578,12 +797,19 @@ isc__timer_reset(isc_timer_t *timer0, isc_timertype_t type,
 		if (type == isc_timertype_inactive) {
 			deschedule(timer);
 			result = ISC_R_SUCCESS;
-		} else
+		} else if (timer->shard != NULL)
+			result = wheel_schedule(timer, &now, &wakeup);
+		else
 			result = schedule(timer, &now, ISC_TRUE);
 	}
 
 	UNLOCK(&timer->lock);
-	UNLOCK(&manager->lock);
+	if (timer->shard != NULL) {
+		UNLOCK(&timer->shard->lock);
+		if (wakeup)
+			wheel_wakeup(manager);
+	} else
+		UNLOCK(&manager->lock);
 
 	return (result);
 }
@@ -677,14 +903,101 @@ isc__timer_detach(isc_timer_t **timerp) {
 	*timerp = NULL;
 }
 
-static void
-dispatch(isc__timermgr_t *manager, isc_time_t *now) {
-	isc_boolean_t done = ISC_FALSE, post_event, need_schedule;
+/*
+ * Post the event for a timer which has come due, and return whether it
+ * needs scheduling again.
+ */
+static isc_boolean_t
+fire(isc__timermgr_t *manager, isc__timer_t *timer, isc_time_t *now) {
+	isc_boolean_t post_event, need_schedule;
 	isc_timerevent_t *event;
 	isc_eventtype_t type = 0;
+	isc_boolean_t idle;
+
+	/*!
+	 * The caller must be holding the lock that covers 'timer'.
+	 */
+
+	if (timer->type == isc_timertype_ticker) {
+		type = ISC_TIMEREVENT_TICK;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_TRUE;
+	} else if (timer->type == isc_timertype_limited) {
+		int cmp;
+		cmp = isc_time_compare(now, &timer->expires);
+		if (cmp >= 0) {
+			type = ISC_TIMEREVENT_LIFE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			type = ISC_TIMEREVENT_TICK;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_TRUE;
+		}
+	} else if (!isc_time_isepoch(&timer->expires) &&
+		   isc_time_compare(now, &timer->expires) >= 0) {
+		type = ISC_TIMEREVENT_LIFE;
+		post_event = ISC_TRUE;
+		need_schedule = ISC_FALSE;
+	} else {
+		idle = ISC_FALSE;
+
+		LOCK(&timer->lock);
+		if (!isc_time_isepoch(&timer->idle) &&
+		    isc_time_compare(now, &timer->idle) >= 0) {
+			idle = ISC_TRUE;
+		}
+		UNLOCK(&timer->lock);
+		if (idle) {
+			type = ISC_TIMEREVENT_IDLE;
+			post_event = ISC_TRUE;
+			need_schedule = ISC_FALSE;
+		} else {
+			/*
+			 * Idle timer has been touched; reschedule.
+			 */
+			XTRACEID(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+						ISC_MSG_IDLERESCHED,
+						"idle reschedule"),
+				 timer);
+			post_event = ISC_FALSE;
+			need_schedule = ISC_TRUE;
+		}
+	}
+
+	if (post_event) {
+		XTRACEID(isc_msgcat_get(isc_msgcat, ISC_MSGSET_TIMER,
+					ISC_MSG_POSTING, "posting"), timer);
+		/*
+		 * XXX We could preallocate this event.
+		 */
+		event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
+							       timer,
+							       type,
+							       timer->action,
+							       timer->arg,
+							       sizeof(*event));
+
+		if (event != NULL) {
+			event->due = timer->due;
+			isc_task_send(timer->task, ISC_EVENT_PTR(&event));
+		} else
+			UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_TIMER,
+							ISC_MSG_EVENTNOTALLOC,
+							"couldn't "
+							"allocate event"));
+	}
+
+	return (need_schedule);
+}
+
+static void
+dispatch(isc__timermgr_t *manager, isc_time_t *now) {
+	isc_boolean_t done = ISC_FALSE, need_schedule;
 	isc__timer_t *timer;
 	isc_result_t result;
-	isc_boolean_t idle;
 
 	/*!
 	 * The caller must be holding the manager lock.
@@ -694,84 +1007,7 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 		timer = isc_heap_element(manager->heap, 1);
 		INSIST(timer != NULL && timer->type != isc_timertype_inactive);
 		if (isc_time_compare(now, &timer->due) >= 0) {
-			if (timer->type == isc_timertype_ticker) {
-				type = ISC_TIMEREVENT_TICK;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_TRUE;
-			} else if (timer->type == isc_timertype_limited) {
-				int cmp;
-				cmp = isc_time_compare(now, &timer->expires);
-				if (cmp >= 0) {
-					type = ISC_TIMEREVENT_LIFE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					type = ISC_TIMEREVENT_TICK;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_TRUE;
-				}
-			} else if (!isc_time_isepoch(&timer->expires) &&
-				   isc_time_compare(now,
-						    &timer->expires) >= 0) {
-				type = ISC_TIMEREVENT_LIFE;
-				post_event = ISC_TRUE;
-				need_schedule = ISC_FALSE;
-			} else {
-				idle = ISC_FALSE;
-
-				LOCK(&timer->lock);
-				if (!isc_time_isepoch(&timer->idle) &&
-				    isc_time_compare(now,
-						     &timer->idle) >= 0) {
-					idle = ISC_TRUE;
-				}
-				UNLOCK(&timer->lock);
-				if (idle) {
-					type = ISC_TIMEREVENT_IDLE;
-					post_event = ISC_TRUE;
-					need_schedule = ISC_FALSE;
-				} else {
-					/*
-					 * Idle timer has been touched;
-					 * reschedule.
-					 */
-					XTRACEID(isc_msgcat_get(isc_msgcat,
-								ISC_MSGSET_TIMER,
-								ISC_MSG_IDLERESCHED,
-								"idle reschedule"),
-						 timer);
-					post_event = ISC_FALSE;
-					need_schedule = ISC_TRUE;
-				}
-			}
-
-			if (post_event) {
-				XTRACEID(isc_msgcat_get(isc_msgcat,
-							ISC_MSGSET_TIMER,
-							ISC_MSG_POSTING,
-							"posting"), timer);
-				/*
-				 * XXX We could preallocate this event.
-				 */
-				event = (isc_timerevent_t *)isc_event_allocate(manager->mctx,
-							   timer,
-							   type,
-							   timer->action,
-							   timer->arg,
-							   sizeof(*event));
-
-				if (event != NULL) {
-					event->due = timer->due;
-					isc_task_send(timer->task,
-						      ISC_EVENT_PTR(&event));
-				} else
-					UNEXPECTED_ERROR(__FILE__, __LINE__, "%s",
-						 isc_msgcat_get(isc_msgcat,
-							 ISC_MSGSET_TIMER,
-							 ISC_MSG_EVENTNOTALLOC,
-							 "couldn't "
-							 "allocate event"));
-			}
+			need_schedule = fire(manager, timer, now);
 
 			timer->index = 0;
 			isc_heap_delete(manager->heap, 1);
@@ -797,12 +1033,166 @@ dispatch(isc__timermgr_t *manager, isc_time_t *now) {
 }
 
 #ifdef USE_TIMER_THREAD
-static isc_threadresult_t
-#ifdef _WIN32			/* XXXDCL */
-WINAPI
-#endif
-run(void *uap) {
-	isc__timermgr_t *manager = uap;
+static void
+wheel_cascade(isc__timershard_t *shard, isc__timerlist_t *slot) {
+	isc__timerlist_t list;
+	isc__timer_t *timer;
+
+	INIT_LIST(list);
+	ISC_LIST_APPENDLIST(list, *slot, slotlink);
+	while ((timer = HEAD(list)) != NULL) {
+		UNLINK(list, timer, slotlink);
+		wheel_insert(shard, timer);
+	}
+}
+
+static void
+wheel_expire(isc__timermgr_t *manager, isc__timershard_t *shard,
+	     isc_time_t *now, isc_uint64_t nowtick)
+{
+	isc__timerlist_t expired;
+	isc__timer_t *timer;
+	isc_boolean_t wakeup;
+	isc_result_t result;
+	isc_uint64_t tick;
+	unsigned int level, shift, index;
+
+	/*
+	 * The caller must be holding the shard lock.
+	 */
+
+	while (shard->tick <= nowtick) {
+		if (shard->nscheduled == 0) {
+			shard->tick = nowtick + 1;
+			break;
+		}
+
+		tick = shard->tick;
+		if ((tick & WHEEL_ROOTMASK) == 0) {
+			shift = WHEEL_ROOTBITS;
+			for (level = 0; level < WHEEL_LEVELS; level++) {
+				index = (unsigned int)(tick >> shift) &
+					WHEEL_LEVELMASK;
+				wheel_cascade(shard,
+					      &shard->levels[level][index]);
+				if (index != 0)
+					break;
+				shift += WHEEL_LEVELBITS;
+			}
+		}
+
+		/*
+		 * Advance before firing, so that timers rescheduled for
+		 * the current tick land in the next one.
+		 */
+		INIT_LIST(expired);
+		ISC_LIST_APPENDLIST(expired, shard->root[tick & WHEEL_ROOTMASK],
+				    slotlink);
+		shard->tick = tick + 1;
+
+		while ((timer = HEAD(expired)) != NULL) {
+			UNLINK(expired, timer, slotlink);
+			INSIST(timer->type != isc_timertype_inactive);
+			if (isc_time_compare(now, &timer->due) < 0) {
+				/* Not in range of the wheels until now. */
+				wheel_insert(shard, timer);
+				continue;
+			}
+
+			timer->slot = NULL;
+			timer->index = 0;
+			shard->nscheduled--;
+
+			if (fire(manager, timer, now)) {
+				wakeup = ISC_FALSE;
+				result = wheel_schedule(timer, now, &wakeup);
+				if (result != ISC_R_SUCCESS)
+					UNEXPECTED_ERROR(__FILE__, __LINE__,
+							 "%s: %u",
+						isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_TIMER,
+							ISC_MSG_SCHEDFAIL,
+							"couldn't schedule "
+							"timer"),
+							 result);
+			}
+		}
+	}
+
+	/*
+	 * Work out when this shard next needs looking at: at the next
+	 * occupied slot of the root wheel, or when the root wheel comes
+	 * round and the levels above it are cascaded.
+	 */
+	if (shard->nscheduled == 0)
+		shard->next = WHEEL_NEVER;
+	else {
+		tick = shard->tick;
+		while ((tick & WHEEL_ROOTMASK) != 0 &&
+		       EMPTY(shard->root[tick & WHEEL_ROOTMASK]))
+			tick++;
+		shard->next = tick;
+	}
+}
+
+static void
+wheel_run(isc__timermgr_t *manager) {
+	isc__timershard_t *shard;
+	isc_interval_t interval;
+	isc_time_t now, when;
+	isc_result_t result;
+	isc_uint64_t nowtick, next, usec;
+	unsigned int i;
+
+	LOCK(&manager->lock);
+	while (!manager->done) {
+		/*
+		 * Anyone scheduling a timer while we are scanning the
+		 * shards sets 'rescan' rather than signalling us.
+		 */
+		manager->scanning = ISC_TRUE;
+		manager->rescan = ISC_FALSE;
+		UNLOCK(&manager->lock);
+
+		TIME_NOW(&now);
+		nowtick = wheel_tick(manager, &now, ISC_FALSE);
+		next = WHEEL_NEVER;
+		for (i = 0; i < manager->nshards; i++) {
+			shard = &manager->shards[i];
+			LOCK(&shard->lock);
+			wheel_expire(manager, shard, &now, nowtick);
+			if (shard->next < next)
+				next = shard->next;
+			UNLOCK(&shard->lock);
+		}
+
+		LOCK(&manager->lock);
+		manager->scanning = ISC_FALSE;
+		if (manager->done || manager->rescan)
+			continue;
+
+		if (next != WHEEL_NEVER) {
+			usec = next * WHEEL_TICK;
+			isc_interval_set(&interval,
+					 (unsigned int)(usec / 1000000),
+					 (unsigned int)(usec % 1000000) * 1000);
+			result = isc_time_add(&manager->epoch, &interval,
+					      &when);
+		} else
+			result = ISC_R_RANGE;
+		if (result == ISC_R_SUCCESS) {
+			result = WAITUNTIL(&manager->wakeup, &manager->lock,
+					   &when);
+			INSIST(result == ISC_R_SUCCESS ||
+			       result == ISC_R_TIMEDOUT);
+		} else
+			WAIT(&manager->wakeup, &manager->lock);
+	}
+	UNLOCK(&manager->lock);
+}
+
+static void
+heap_run(isc__timermgr_t *manager) {
 	isc_time_t now;
 	isc_result_t result;
 
@@ -834,6 +1224,19 @@ run(void *uap) {
 				      ISC_MSG_WAKEUP, "wakeup"));
 	}
 	UNLOCK(&manager->lock);
+}
+
+static isc_threadresult_t
+#ifdef _WIN32			/* XXXDCL */
+WINAPI
+#endif
+run(void *uap) {
+	isc__timermgr_t *manager = uap;
+
+	if (manager->nshards > 0)
+		wheel_run(manager);
+	else
+		heap_run(manager);
 
 #ifdef OPENSSL_LEAKS
 	ERR_remove_state(0);
@@ -867,8 +1270,67 @@ set_index(void *what, unsigned int index) {
 	timer->index = index;
 }
 
+static isc_result_t
+create_shards(isc_mem_t *mctx, isc__timermgr_t *manager,
+	      unsigned int nshards)
+{
+	isc__timershard_t *shard;
+	isc_result_t result;
+	unsigned int i, j;
+
+	manager->shards = isc_mem_get(mctx, nshards * sizeof(*shard));
+	if (manager->shards == NULL)
+		return (ISC_R_NOMEMORY);
+
+	for (i = 0; i < nshards; i++) {
+		shard = &manager->shards[i];
+		result = isc_mutex_init(&shard->lock);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				DESTROYLOCK(&manager->shards[i].lock);
+			isc_mem_put(mctx, manager->shards,
+				    nshards * sizeof(*shard));
+			manager->shards = NULL;
+			return (result);
+		}
+		shard->nscheduled = 0;
+		shard->tick = 0;
+		shard->next = WHEEL_NEVER;
+		for (j = 0; j < WHEEL_ROOTSIZE; j++)
+			INIT_LIST(shard->root[j]);
+		for (j = 0; j < WHEEL_LEVELS * WHEEL_LEVELSIZE; j++)
+			INIT_LIST(shard->levels[j / WHEEL_LEVELSIZE]
+					       [j % WHEEL_LEVELSIZE]);
+	}
+	manager->nshards = nshards;
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+destroy_shards(isc_mem_t *mctx, isc__timermgr_t *manager) {
+	unsigned int i;
+
+	for (i = 0; i < manager->nshards; i++) {
+		INSIST(manager->shards[i].nscheduled == 0);
+		DESTROYLOCK(&manager->shards[i].lock);
+	}
+	if (manager->shards != NULL)
+		isc_mem_put(mctx, manager->shards,
+			    manager->nshards * sizeof(isc__timershard_t));
+	manager->shards = NULL;
+	manager->nshards = 0;
+}
+
 ISC_TIMERFUNC_SCOPE isc_result_t
 isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
+	return (isc__timermgr_create2(mctx, managerp, 0));
+}
+
+ISC_TIMERFUNC_SCOPE isc_result_t
+isc__timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		      unsigned int nshards)
+{
 	isc__timermgr_t *manager;
 	isc_result_t result;
 
@@ -878,6 +1340,13 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
 
+#ifndef USE_TIMER_THREAD
+	/*
+	 * The timing wheels are only driven by the run thread.
+	 */
+	nshards = 0;
+#endif
+
 #ifdef USE_SHARED_MANAGER
 	if (timermgr != NULL) {
 		timermgr->refs++;
@@ -898,6 +1367,12 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	INIT_LIST(manager->timers);
 	manager->nscheduled = 0;
 	isc_time_settoepoch(&manager->due);
+	TIME_NOW(&manager->epoch);
+	manager->nshards = 0;
+	manager->shards = NULL;
+	manager->nextshard = 0;
+	manager->scanning = ISC_FALSE;
+	manager->rescan = ISC_FALSE;
 	manager->heap = NULL;
 	result = isc_heap_create(mctx, sooner, set_index, 0, &manager->heap);
 	if (result != ISC_R_SUCCESS) {
@@ -911,10 +1386,20 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 		isc_mem_put(mctx, manager, sizeof(*manager));
 		return (result);
 	}
+	if (nshards > 0) {
+		result = create_shards(mctx, manager, nshards);
+		if (result != ISC_R_SUCCESS) {
+			DESTROYLOCK(&manager->lock);
+			isc_heap_destroy(&manager->heap);
+			isc_mem_put(mctx, manager, sizeof(*manager));
+			return (result);
+		}
+	}
 	isc_mem_attach(mctx, &manager->mctx);
 #ifdef USE_TIMER_THREAD
 	if (isc_condition_init(&manager->wakeup) != ISC_R_SUCCESS) {
 		isc_mem_detach(&manager->mctx);
+		destroy_shards(mctx, manager);
 		DESTROYLOCK(&manager->lock);
 		isc_heap_destroy(&manager->heap);
 		isc_mem_put(mctx, manager, sizeof(*manager));
@@ -928,6 +1413,7 @@ isc__timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	    ISC_R_SUCCESS) {
 		isc_mem_detach(&manager->mctx);
 		(void)isc_condition_destroy(&manager->wakeup);
+		destroy_shards(mctx, manager);
 		DESTROYLOCK(&manager->lock);
 		isc_heap_destroy(&manager->heap);
 		isc_mem_put(mctx, manager, sizeof(*manager));
@@ -1018,6 +1504,7 @@ isc__timermgr_destroy(isc_timermgr_t **managerp) {
 #ifdef USE_TIMER_THREAD
 	(void)isc_condition_destroy(&manager->wakeup);
 #endif /* USE_TIMER_THREAD */
+	destroy_shards(manager->mctx, manager);
 	DESTROYLOCK(&manager->lock);
 	isc_heap_destroy(&manager->heap);
 	manager->common.impmagic = 0;
@@ -85,6 +85,18 @@ isc_timermgr_create(isc_mem_t *mctx, isc_timermgr_t **managerp) {
 	return (result);
 }
 
+isc_result_t
+isc_timermgr_create2(isc_mem_t *mctx, isc_timermgr_t **managerp,
+		     unsigned int nshards)
+{
+	/*
+	 * A registered implementation takes no shard count.
+	 */
+	UNUSED(nshards);
+
+	return (isc_timermgr_create(mctx, managerp));
+}
+
 void
 isc_timermgr_destroy(isc_timermgr_t **managerp) {
 	REQUIRE(*managerp != NULL && ISCAPI_TIMERMGR_VALID(*managerp));
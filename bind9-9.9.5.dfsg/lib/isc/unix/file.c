@@ -58,6 +58,7 @@
 #include <unistd.h>		/* Required for mkstemp on NetBSD. */
 
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 
@@ -614,3 +615,15 @@ isc_file_splitpath(isc_mem_t *mctx, char *path, char **dirname, char **basename)
 
 	return (ISC_R_SUCCESS);
 }
+
+void *
+isc_file_mmap(void *addr, size_t len, int prot,
+	      int flags, int fd, off_t offset)
+{
+	return (mmap(addr, len, prot, flags, fd, offset));
+}
+
+int
+isc_file_munmap(void *addr, size_t len) {
+	return (munmap(addr, len));
+}
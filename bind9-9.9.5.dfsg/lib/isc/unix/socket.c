@@ -282,6 +282,39 @@ typedef isc_event_t intev_t;
 #endif
 #endif
 
+/*%
+ * Batched UDP I/O.  Once a UDP socket is seen to have datagrams waiting,
+ * it reads up to MAXBATCH_RECV of them at a time with recvmmsg() and
+ * hands them to receive requests as they arrive.  Send requests that
+ * back up behind a full socket buffer are flushed up to MAXBATCH_SEND at
+ * a time with sendmmsg().
+ */
+#if defined(HAVE_RECVMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_RECVMMSG	1
+#endif
+#if defined(HAVE_SENDMMSG) && defined(ISC_NET_BSD44MSGHDR)
+#define USE_SENDMMSG	1
+#endif
+#define MAXBATCH_RECV	32
+#define MAXBATCH_SEND	32
+
+#ifdef USE_RECVMMSG
+/*%
+ * Datagrams read ahead of the receive requests on a busy UDP socket.
+ * Locked by the socket lock.
+ */
+typedef struct recvbatch {
+	unsigned int		next;		/* next datagram to hand out */
+	unsigned int		count;		/* datagrams read */
+	size_t			size;		/* space per datagram */
+	unsigned char		*data;		/* MAXBATCH_RECV * size */
+	char			*cmsgbuf;	/* MAXBATCH_RECV cmsg bufs */
+	struct mmsghdr		msgs[MAXBATCH_RECV];
+	struct iovec		iov[MAXBATCH_RECV];
+	isc_sockaddr_t		from[MAXBATCH_RECV];
+} recvbatch_t;
+#endif
+
 /*%
  * The size to raise the receive buffer to (from BIND 8).
  */
@@ -345,6 +378,12 @@ struct isc__socket {
 	ISC_SOCKADDR_LEN_T	recvcmsgbuflen;
 	char			*sendcmsgbuf;
 	ISC_SOCKADDR_LEN_T	sendcmsgbuflen;
+#ifdef USE_RECVMMSG
+	recvbatch_t		*recvbatch;	/* set once, read unlocked */
+#endif
+#ifdef USE_SENDMMSG
+	char			*sendmmsgbuf;	/* MAXBATCH_SEND cmsg bufs */
+#endif
 
 	void			*fdwatcharg;
 	isc_sockfdwatch_t	fdwatchcb;
@@ -355,6 +394,30 @@ struct isc__socket {
 #define SOCKET_MANAGER_MAGIC	ISC_MAGIC('I', 'O', 'm', 'g')
 #define VALID_MANAGER(m)	ISC_MAGIC_VALID(m, SOCKET_MANAGER_MAGIC)
 
+/*%
+ * A socket watcher: the state one watcher thread polls.  Descriptors are
+ * spread across the manager's watchers by number (see FDWATCHER()), and
+ * a watcher dispatches the I/O events of its descriptors straight to the
+ * sockets' tasks.  Each watcher has its own control pipe and, with epoll,
+ * its own epoll instance.  The other event mechanisms always use a single
+ * watcher.
+ */
+typedef struct isc__socketwatcher {
+	/* Not locked. */
+	isc__socketmgr_t	*manager;
+#ifdef USE_EPOLL
+	int			epoll_fd;
+	int			nevents;
+	struct epoll_event	*events;
+#endif	/* USE_EPOLL */
+#ifdef USE_WATCHER_THREAD
+	int			pipe_fds[2];
+	isc_thread_t		thread;
+#endif	/* USE_WATCHER_THREAD */
+} isc__socketwatcher_t;
+
+#define FDWATCHER(m, fd)	(&(m)->watchers[(fd) % (m)->nwatchers])
+
 struct isc__socketmgr {
 	/* Not locked. */
 	isc_socketmgr_t		common;
@@ -367,11 +430,6 @@ struct isc__socketmgr {
 	int			nevents;
 	struct kevent		*events;
 #endif	/* USE_KQUEUE */
-#ifdef USE_EPOLL
-	int			epoll_fd;
-	int			nevents;
-	struct epoll_event	*events;
-#endif	/* USE_EPOLL */
 #ifdef USE_DEVPOLL
 	int			devpoll_fd;
 	int			nevents;
@@ -381,9 +439,8 @@ struct isc__socketmgr {
 	int			fd_bufsize;
 #endif	/* USE_SELECT */
 	unsigned int		maxsocks;
-#ifdef ISC_PLATFORM_USETHREADS
-	int			pipe_fds[2];
-#endif
+	unsigned int		nwatchers;
+	isc__socketwatcher_t	*watchers;
 
 	/* Locked by fdlock. */
 	isc__socket_t	       **fds;
@@ -403,12 +460,17 @@ struct isc__socketmgr {
 #endif	/* USE_SELECT */
 	int			reserved;	/* unlocked */
 #ifdef USE_WATCHER_THREAD
-	isc_thread_t		watcher;
 	isc_condition_t		shutdown_ok;
 #else /* USE_WATCHER_THREAD */
 	unsigned int		refs;
 #endif /* USE_WATCHER_THREAD */
 	int			maxudp;
+#ifdef USE_RECVMMSG
+	isc_boolean_t		norecvmmsg;	/* unlocked, set once */
+#endif
+#ifdef USE_SENDMMSG
+	isc_boolean_t		nosendmmsg;	/* unlocked, set once */
+#endif
 };
 
 #ifdef USE_SHARED_MANAGER
@@ -447,11 +509,13 @@ static void internal_fdwatch_write(isc_task_t *, isc_event_t *);
 static void internal_fdwatch_read(isc_task_t *, isc_event_t *);
 static void process_cmsg(isc__socket_t *, struct msghdr *, isc_socketevent_t *);
 static void build_msghdr_send(isc__socket_t *, isc_socketevent_t *,
-			      struct msghdr *, struct iovec *, size_t *);
+			      struct msghdr *, struct iovec *, char *,
+			      size_t *);
 static void build_msghdr_recv(isc__socket_t *, isc_socketevent_t *,
-			      struct msghdr *, struct iovec *, size_t *);
+			      struct msghdr *, struct iovec *, char *,
+			      size_t *);
 #ifdef USE_WATCHER_THREAD
-static isc_boolean_t process_ctlfd(isc__socketmgr_t *manager);
+static isc_boolean_t process_ctlfd(isc__socketwatcher_t *watcher);
 #endif
 
 /*%
@@ -476,6 +540,9 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp);
 ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks);
+ISC_SOCKETFUNC_SCOPE isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nwatchers);
 ISC_SOCKETFUNC_SCOPE void
 isc__socketmgr_destroy(isc_socketmgr_t **managerp);
 ISC_SOCKETFUNC_SCOPE isc_result_t
@@ -630,7 +697,9 @@ enum {
 	STATID_ACCEPTFAIL = 6,
 	STATID_ACCEPT = 7,
 	STATID_SENDFAIL = 8,
-	STATID_RECVFAIL = 9
+	STATID_RECVFAIL = 9,
+	STATID_RECVBATCH = 10,
+	STATID_SENDBATCH = 11
 };
 static const isc_statscounter_t udp4statsindex[] = {
 	isc_sockstatscounter_udp4open,
@@ -642,7 +711,9 @@ static const isc_statscounter_t udp4statsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_udp4sendfail,
-	isc_sockstatscounter_udp4recvfail
+	isc_sockstatscounter_udp4recvfail,
+	isc_sockstatscounter_udp4recvbatch,
+	isc_sockstatscounter_udp4sendbatch
 };
 static const isc_statscounter_t udp6statsindex[] = {
 	isc_sockstatscounter_udp6open,
@@ -654,7 +725,9 @@ static const isc_statscounter_t udp6statsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_udp6sendfail,
-	isc_sockstatscounter_udp6recvfail
+	isc_sockstatscounter_udp6recvfail,
+	isc_sockstatscounter_udp6recvbatch,
+	isc_sockstatscounter_udp6sendbatch
 };
 static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4open,
@@ -666,7 +739,9 @@ static const isc_statscounter_t tcp4statsindex[] = {
 	isc_sockstatscounter_tcp4acceptfail,
 	isc_sockstatscounter_tcp4accept,
 	isc_sockstatscounter_tcp4sendfail,
-	isc_sockstatscounter_tcp4recvfail
+	isc_sockstatscounter_tcp4recvfail,
+	-1,
+	-1
 };
 static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6open,
@@ -678,7 +753,9 @@ static const isc_statscounter_t tcp6statsindex[] = {
 	isc_sockstatscounter_tcp6acceptfail,
 	isc_sockstatscounter_tcp6accept,
 	isc_sockstatscounter_tcp6sendfail,
-	isc_sockstatscounter_tcp6recvfail
+	isc_sockstatscounter_tcp6recvfail,
+	-1,
+	-1
 };
 static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixopen,
@@ -690,7 +767,9 @@ static const isc_statscounter_t unixstatsindex[] = {
 	isc_sockstatscounter_unixacceptfail,
 	isc_sockstatscounter_unixaccept,
 	isc_sockstatscounter_unixsendfail,
-	isc_sockstatscounter_unixrecvfail
+	isc_sockstatscounter_unixrecvfail,
+	-1,
+	-1
 };
 static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
@@ -702,7 +781,9 @@ static const isc_statscounter_t fdwatchstatsindex[] = {
 	-1,
 	-1,
 	isc_sockstatscounter_fdwatchsendfail,
-	isc_sockstatscounter_fdwatchrecvfail
+	isc_sockstatscounter_fdwatchrecvfail,
+	-1,
+	-1
 };
 
 #if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL) || \
@@ -836,7 +917,8 @@ watch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		event.events = EPOLLOUT;
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
-	if (epoll_ctl(manager->epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1 &&
+	if (epoll_ctl(FDWATCHER(manager, fd)->epoll_fd, EPOLL_CTL_ADD, fd,
+		      &event) == -1 &&
 	    errno != EEXIST) {
 		result = isc__errno2result(errno);
 	}
@@ -904,7 +986,8 @@ unwatch_fd(isc__socketmgr_t *manager, int fd, int msg) {
 		event.events = EPOLLOUT;
 	memset(&event.data, 0, sizeof(event.data));
 	event.data.fd = fd;
-	if (epoll_ctl(manager->epoll_fd, EPOLL_CTL_DEL, fd, &event) == -1 &&
+	if (epoll_ctl(FDWATCHER(manager, fd)->epoll_fd, EPOLL_CTL_DEL, fd,
+		      &event) == -1 &&
 	    errno != ENOENT) {
 		char strbuf[ISC_STRERRORSIZE];
 		isc__strerror(errno, strbuf, sizeof(strbuf));
@@ -1028,12 +1111,12 @@ wakeup_socket(isc__socketmgr_t *manager, int fd, int msg) {
 
 #ifdef USE_WATCHER_THREAD
 /*
- * Poke the select loop when there is something for us to do.
+ * Poke a watcher's select loop when there is something for it to do.
  * The write is required (by POSIX) to complete.  That is, we
  * will not get partial writes.
  */
 static void
-select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+poke_watcher(isc__socketwatcher_t *watcher, int fd, int msg) {
 	int cc;
 	int buf[2];
 	char strbuf[ISC_STRERRORSIZE];
@@ -1042,7 +1125,7 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 	buf[1] = msg;
 
 	do {
-		cc = write(mgr->pipe_fds[1], buf, sizeof(buf));
+		cc = write(watcher->pipe_fds[1], buf, sizeof(buf));
 #ifdef ENOSR
 		/*
 		 * Treat ENOSR as EAGAIN but loop slowly as it is
@@ -1069,15 +1152,23 @@ select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
 }
 
 /*
- * Read a message on the internal fd.
+ * Poke the watcher that is responsible for 'fd'.
+ */
+static void
+select_poke(isc__socketmgr_t *mgr, int fd, int msg) {
+	poke_watcher(FDWATCHER(mgr, fd), fd, msg);
+}
+
+/*
+ * Read a message on a watcher's internal fd.
  */
 static void
-select_readmsg(isc__socketmgr_t *mgr, int *fd, int *msg) {
+select_readmsg(isc__socketwatcher_t *watcher, int *fd, int *msg) {
 	int buf[2];
 	int cc;
 	char strbuf[ISC_STRERRORSIZE];
 
-	cc = read(mgr->pipe_fds[0], buf, sizeof(buf));
+	cc = read(watcher->pipe_fds[0], buf, sizeof(buf));
 	if (cc < 0) {
 		*msg = SELECT_POKE_NOTHING;
 		*fd = -1;	/* Silence compiler. */
@@ -1305,12 +1396,16 @@ process_cmsg(isc__socket_t *sock, struct msghdr *msg, isc_socketevent_t *dev) {
  * Nothing can be NULL, and the done event must list at least one buffer
  * on the buffer linked list for this function to be meaningful.
  *
+ * Any control data is built in 'cmsgbuf', which must be at least
+ * sock->sendcmsgbuflen bytes long.
+ *
  * If write_countp != NULL, *write_countp will hold the number of bytes
  * this transaction can send.
  */
 static void
 build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
-		  struct msghdr *msg, struct iovec *iov, size_t *write_countp)
+		  struct msghdr *msg, struct iovec *iov, char *cmsgbuf,
+		  size_t *write_countp)
 {
 	unsigned int iovcount;
 	isc_buffer_t *buffer;
@@ -1399,9 +1494,9 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 
 		msg->msg_controllen = cmsg_space(sizeof(struct in6_pktinfo));
 		INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
-		msg->msg_control = (void *)sock->sendcmsgbuf;
+		msg->msg_control = (void *)cmsgbuf;
 
-		cmsgp = (struct cmsghdr *)sock->sendcmsgbuf;
+		cmsgp = (struct cmsghdr *)cmsgbuf;
 		cmsgp->cmsg_level = IPPROTO_IPV6;
 		cmsgp->cmsg_type = IPV6_PKTINFO;
 		cmsgp->cmsg_len = cmsg_len(sizeof(struct in6_pktinfo));
@@ -1413,8 +1508,7 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
 		 * ignores setsockopt(IPV6_USE_MIN_MTU) when IPV6_PKTINFO
 		 * is used.
 		 */
-		cmsgp = (struct cmsghdr *)(sock->sendcmsgbuf +
-					   msg->msg_controllen);
+		cmsgp = (struct cmsghdr *)(cmsgbuf + msg->msg_controllen);
 		msg->msg_controllen += cmsg_space(sizeof(use_min_mtu));
 		INSIST(msg->msg_controllen <= sock->sendcmsgbuflen);
 
@@ -1443,12 +1537,16 @@ build_msghdr_send(isc__socket_t *sock, isc_socketevent_t *dev,
  * Nothing can be NULL, and the done event must list at least one buffer
  * on the buffer linked list for this function to be meaningful.
  *
+ * Control data is received into 'cmsgbuf', which must be at least
+ * sock->recvcmsgbuflen bytes long.
+ *
  * If read_countp != NULL, *read_countp will hold the number of bytes
  * this transaction can receive.
  */
 static void
 build_msghdr_recv(isc__socket_t *sock, isc_socketevent_t *dev,
-		  struct msghdr *msg, struct iovec *iov, size_t *read_countp)
+		  struct msghdr *msg, struct iovec *iov, char *cmsgbuf,
+		  size_t *read_countp)
 {
 	unsigned int iovcount;
 	isc_buffer_t *buffer;
@@ -1554,7 +1652,7 @@ build_msghdr_recv(isc__socket_t *sock, isc_socketevent_t *dev,
 	msg->msg_flags = 0;
 #if defined(USE_CMSG)
 	if (sock->type == isc_sockettype_udp) {
-		msg->msg_control = sock->recvcmsgbuf;
+		msg->msg_control = cmsgbuf;
 		msg->msg_controllen = sock->recvcmsgbuflen;
 	}
 #endif /* USE_CMSG */
@@ -1643,31 +1741,22 @@ dump_msg(struct msghdr *msg) {
 #define DOIO_SOFT		1	/* i/o ok, soft error, no event sent */
 #define DOIO_HARD		2	/* i/o error, event sent */
 #define DOIO_EOF		3	/* EOF, no event sent */
+#define DOIO_NOBATCH		4	/* batched i/o unavailable, no i/o done */
 
+/*
+ * Process the outcome of a receive into 'dev' described by 'msghdr':
+ * 'cc' and 'recv_errno' are the return value and errno of the recvmsg()
+ * call (or the per-message length of a recvmmsg() call), and 'read_count'
+ * is the number of bytes build_msghdr_recv() made room for.
+ */
 static int
-doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_RECV];
-	size_t read_count;
+process_recv(isc__socket_t *sock, isc_socketevent_t *dev,
+	     struct msghdr *msghdr, int cc, int recv_errno, size_t read_count)
+{
 	size_t actual_count;
-	struct msghdr msghdr;
 	isc_buffer_t *buffer;
-	int recv_errno;
 	char strbuf[ISC_STRERRORSIZE];
 
-	build_msghdr_recv(sock, dev, &msghdr, iov, &read_count);
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
-	cc = recvmsg(sock->fd, &msghdr, 0);
-	recv_errno = errno;
-
-#if defined(ISC_SOCKET_DEBUG)
-	dump_msg(&msghdr);
-#endif
-
 	if (cc < 0) {
 		if (SOFT_ERROR(recv_errno))
 			return (DOIO_SOFT);
@@ -1747,7 +1836,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	}
 
 	if (sock->type == isc_sockettype_udp) {
-		dev->address.length = msghdr.msg_namelen;
+		dev->address.length = msghdr->msg_namelen;
 		if (isc_sockaddr_getport(&dev->address) == 0) {
 			if (isc_log_wouldlog(isc_lctx, IOEVENT_LEVEL)) {
 				socket_log(sock, &dev->address, IOEVENT,
@@ -1786,7 +1875,7 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	 * out the interesting bits.
 	 */
 	if (sock->type == isc_sockettype_udp)
-		process_cmsg(sock, &msghdr, dev);
+		process_cmsg(sock, msghdr, dev);
 
 	/*
 	 * update the buffers (if any) and the i/o count
@@ -1826,6 +1915,285 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	size_t read_count;
+	struct msghdr msghdr;
+	int recv_errno;
+
+	build_msghdr_recv(sock, dev, &msghdr, iov, sock->recvcmsgbuf,
+			  &read_count);
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	cc = recvmsg(sock->fd, &msghdr, 0);
+	recv_errno = errno;
+
+#if defined(ISC_SOCKET_DEBUG)
+	dump_msg(&msghdr);
+#endif
+
+	return (process_recv(sock, dev, &msghdr, cc, recv_errno, read_count));
+}
+
+#ifdef USE_RECVMMSG
+/*
+ * Return the number of bytes a receive into 'dev' has room for.
+ */
+static size_t
+recv_space(isc_socketevent_t *dev) {
+	isc_buffer_t *buffer;
+	size_t space = 0;
+
+	buffer = ISC_LIST_HEAD(dev->bufferlist);
+	if (buffer == NULL)
+		return (dev->region.length - dev->n);
+	while (buffer != NULL) {
+		space += isc_buffer_availablelength(buffer);
+		buffer = ISC_LIST_NEXT(buffer, link);
+	}
+	return (space);
+}
+
+/*
+ * Start reading ahead on the UDP socket 'sock', with room for datagrams
+ * as large as 'dev' can take.  Failure to allocate just leaves the socket
+ * reading one datagram at a time.
+ *
+ * Caller must hold the socket lock.
+ */
+static void
+recvbatch_create(isc__socket_t *sock, isc_socketevent_t *dev) {
+	recvbatch_t *batch;
+	isc_buffer_t *buffer;
+	size_t size = 0;
+
+	INSIST(sock->type == isc_sockettype_udp);
+
+	if (sock->recvbatch != NULL || sock->manager->norecvmmsg)
+		return;
+
+	/*
+	 * Size by the whole of 'dev': it may already hold the datagram that
+	 * showed the socket to be busy.
+	 */
+	buffer = ISC_LIST_HEAD(dev->bufferlist);
+	if (buffer == NULL)
+		size = dev->region.length;
+	while (buffer != NULL) {
+		size += isc_buffer_length(buffer);
+		buffer = ISC_LIST_NEXT(buffer, link);
+	}
+	if (size == 0U)
+		return;
+
+	batch = isc_mem_get(sock->manager->mctx, sizeof(*batch));
+	if (batch == NULL)
+		return;
+	batch->next = 0;
+	batch->count = 0;
+	batch->size = size;
+	batch->cmsgbuf = NULL;
+	batch->data = isc_mem_get(sock->manager->mctx,
+				  size * MAXBATCH_RECV);
+	if (batch->data == NULL)
+		goto fail;
+	if (sock->recvcmsgbuflen != 0U) {
+		batch->cmsgbuf = isc_mem_get(sock->manager->mctx,
+					     sock->recvcmsgbuflen *
+					     MAXBATCH_RECV);
+		if (batch->cmsgbuf == NULL)
+			goto fail;
+	}
+
+	sock->recvbatch = batch;
+	return;
+
+ fail:
+	if (batch->data != NULL)
+		isc_mem_put(sock->manager->mctx, batch->data,
+			    size * MAXBATCH_RECV);
+	isc_mem_put(sock->manager->mctx, batch, sizeof(*batch));
+}
+
+static void
+recvbatch_free(isc__socket_t *sock) {
+	recvbatch_t *batch = sock->recvbatch;
+
+	if (batch->cmsgbuf != NULL)
+		isc_mem_put(sock->manager->mctx, batch->cmsgbuf,
+			    sock->recvcmsgbuflen * MAXBATCH_RECV);
+	isc_mem_put(sock->manager->mctx, batch->data,
+		    batch->size * MAXBATCH_RECV);
+	isc_mem_put(sock->manager->mctx, batch, sizeof(*batch));
+	sock->recvbatch = NULL;
+}
+
+/*
+ * Read as many datagrams as are waiting on 'sock', up to MAXBATCH_RECV,
+ * into its (empty) read-ahead buffers with one recvmmsg() call.  Returns
+ * the recvmmsg() result; on error '*errnop' is set.
+ */
+static int
+recvbatch_fill(isc__socket_t *sock, int *errnop) {
+	recvbatch_t *batch = sock->recvbatch;
+	struct msghdr *msg;
+	unsigned int i;
+	int cc;
+
+	INSIST(batch->next == batch->count);
+
+	for (i = 0; i < MAXBATCH_RECV; i++) {
+		msg = &batch->msgs[i].msg_hdr;
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_name = (void *)&batch->from[i].type.sa;
+		msg->msg_namelen = sizeof(batch->from[i].type);
+		batch->iov[i].iov_base = batch->data + i * batch->size;
+		batch->iov[i].iov_len = batch->size;
+		msg->msg_iov = &batch->iov[i];
+		msg->msg_iovlen = 1;
+#if defined(USE_CMSG)
+		if (batch->cmsgbuf != NULL) {
+			msg->msg_control = batch->cmsgbuf +
+					   i * sock->recvcmsgbuflen;
+			msg->msg_controllen = sock->recvcmsgbuflen;
+		}
+#endif
+		batch->msgs[i].msg_len = 0;
+	}
+
+	batch->next = 0;
+	batch->count = 0;
+	cc = recvmmsg(sock->fd, batch->msgs, MAXBATCH_RECV, 0, NULL);
+	*errnop = errno;
+	if (cc > 0)
+		batch->count = cc;
+	if (cc > 1)
+		inc_stats(sock->manager->stats,
+			  sock->statsindex[STATID_RECVBATCH]);
+	return (cc);
+}
+
+/*
+ * Copy the next read-ahead datagram on 'sock' into 'dev', as if
+ * recvmsg() had put it there.
+ */
+static int
+recvbatch_take(isc__socket_t *sock, isc_socketevent_t *dev) {
+	recvbatch_t *batch = sock->recvbatch;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	struct msghdr msghdr, *msg;
+	size_t read_count, len, n;
+	unsigned char *data;
+	unsigned int i;
+	int cc;
+
+	INSIST(batch->next < batch->count);
+
+	msg = &batch->msgs[batch->next].msg_hdr;
+	len = batch->msgs[batch->next].msg_len;
+	data = batch->iov[batch->next].iov_base;
+	batch->next++;
+
+	build_msghdr_recv(sock, dev, &msghdr, iov, NULL, &read_count);
+	memmove(&dev->address.type, &batch->from[batch->next - 1].type,
+		msg->msg_namelen);
+	msghdr.msg_namelen = msg->msg_namelen;
+	msghdr.msg_control = msg->msg_control;
+	msghdr.msg_controllen = msg->msg_controllen;
+	msghdr.msg_flags = msg->msg_flags;
+
+	cc = 0;
+	for (i = 0; i < (unsigned int)msghdr.msg_iovlen && len > 0U; i++) {
+		n = ISC_MIN(len, iov[i].iov_len);
+		memmove(iov[i].iov_base, data, n);
+		data += n;
+		len -= n;
+		cc += (int)n;
+	}
+#ifdef MSG_TRUNC
+	if (len > 0U)
+		msghdr.msg_flags |= MSG_TRUNC;
+#endif
+
+	return (process_recv(sock, dev, &msghdr, cc, 0, read_count));
+}
+
+/*
+ * Receive into 'dev' on a UDP socket that reads ahead, refilling the
+ * read-ahead buffers when they run dry.  Returns as doio_recv() does.
+ *
+ * Caller must hold the socket lock.  The read-ahead buffers belong to
+ * the socket, so the recvmmsg() that refills them and the copy out of
+ * them both run under that lock, and a refill holds it for up to
+ * MAXBATCH_RECV datagrams.  This serializes every receive on the
+ * socket, where a plain UDP socket_recv() reads without the lock; the
+ * trade is one system call per batch instead of one per datagram.
+ */
+static int
+doio_recvbatch(isc__socket_t *sock, isc_socketevent_t *dev) {
+	recvbatch_t *batch = sock->recvbatch;
+	struct iovec iov[MAXSCATTERGATHER_RECV];
+	struct msghdr msghdr;
+	size_t read_count;
+	int cc, recv_errno, io_state;
+
+	for (;;) {
+		while (batch->next < batch->count) {
+			io_state = recvbatch_take(sock, dev);
+			/*
+			 * A datagram that was dropped leaves 'dev' free
+			 * for the next one.
+			 */
+			if (io_state != DOIO_SOFT)
+				return (io_state);
+		}
+
+		/*
+		 * Requests with more room than the read-ahead buffers have
+		 * are read directly, so that a large datagram is not cut
+		 * short.
+		 */
+		if (sock->manager->norecvmmsg || recv_space(dev) > batch->size)
+			return (doio_recv(sock, dev));
+
+		cc = recvbatch_fill(sock, &recv_errno);
+		if (cc > 0)
+			continue;
+		if (cc == 0)
+			return (DOIO_SOFT);
+		if (recv_errno == ENOSYS) {
+			sock->manager->norecvmmsg = ISC_TRUE;
+			return (doio_recv(sock, dev));
+		}
+		build_msghdr_recv(sock, dev, &msghdr, iov, NULL, &read_count);
+		return (process_recv(sock, dev, &msghdr, cc, recv_errno,
+				     read_count));
+	}
+}
+
+#define RECVBATCH(sock)		((sock)->recvbatch != NULL)
+#else
+#define RECVBATCH(sock)		ISC_FALSE
+#endif /* USE_RECVMMSG */
+
+/*
+ * Receive into 'dev' with the socket lock held, from the read-ahead
+ * buffers if the socket has them.
+ */
+static inline int
+doio_recvlocked(isc__socket_t *sock, isc_socketevent_t *dev) {
+#ifdef USE_RECVMMSG
+	if (sock->recvbatch != NULL)
+		return (doio_recvbatch(sock, dev));
+#endif
+	return (doio_recv(sock, dev));
+}
+
 /*
  * Returns:
  *	DOIO_SUCCESS	The operation succeeded.  dev->result contains
@@ -1840,29 +2208,16 @@ doio_recv(isc__socket_t *sock, isc_socketevent_t *dev) {
  *	No other return values are possible.
  */
 static int
-doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
-	int cc;
-	struct iovec iov[MAXSCATTERGATHER_SEND];
-	size_t write_count;
-	struct msghdr msghdr;
+process_send(isc__socket_t *sock, isc_socketevent_t *dev, int cc,
+	     int send_errno, size_t write_count)
+{
 	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
-	int attempts = 0;
-	int send_errno;
 	char strbuf[ISC_STRERRORSIZE];
 
-	build_msghdr_send(sock, dev, &msghdr, iov, &write_count);
-
- resend:
-	cc = sendmsg(sock->fd, &msghdr, 0);
-	send_errno = errno;
-
 	/*
 	 * Check for error or block condition.
 	 */
 	if (cc < 0) {
-		if (send_errno == EINTR && ++attempts < NRETRIES)
-			goto resend;
-
 		if (SOFT_ERROR(send_errno))
 			return (DOIO_SOFT);
 
@@ -1944,6 +2299,106 @@ doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
 	return (DOIO_SUCCESS);
 }
 
+static int
+doio_send(isc__socket_t *sock, isc_socketevent_t *dev) {
+	int cc;
+	struct iovec iov[MAXSCATTERGATHER_SEND];
+	size_t write_count;
+	struct msghdr msghdr;
+	int attempts = 0;
+	int send_errno;
+
+	build_msghdr_send(sock, dev, &msghdr, iov, sock->sendcmsgbuf,
+			  &write_count);
+
+ resend:
+	cc = sendmsg(sock->fd, &msghdr, 0);
+	send_errno = errno;
+
+	if (cc < 0 && send_errno == EINTR && ++attempts < NRETRIES)
+		goto resend;
+
+	return (process_send(sock, dev, cc, send_errno, write_count));
+}
+
+#ifdef USE_SENDMMSG
+/*
+ * Write up to MAXBATCH_SEND of the send requests queued on the UDP socket
+ * 'sock' with a single sendmmsg() call, posting the done events of those
+ * that complete.  If the kernel stops part way through the batch, the
+ * remaining requests stay queued and the next call reports the error.
+ *
+ * Returns DOIO_SUCCESS if progress was made, DOIO_SOFT if the socket
+ * would block, or DOIO_NOBATCH if batching is not available and the caller
+ * should fall back to doio_send().
+ */
+static int
+doio_sendmmsg(isc__socket_t *sock) {
+	int cc;
+	unsigned int i, n;
+	struct mmsghdr msgs[MAXBATCH_SEND];
+	struct iovec iov[MAXBATCH_SEND][MAXSCATTERGATHER_SEND];
+	size_t write_count[MAXBATCH_SEND];
+	isc_socketevent_t *devs[MAXBATCH_SEND];
+	isc_socketevent_t *dev;
+	char *cmsgbuf = NULL;
+	int attempts = 0;
+	int send_errno;
+
+	INSIST(sock->type == isc_sockettype_udp);
+
+	if (sock->sendcmsgbuflen != 0U && sock->sendmmsgbuf == NULL) {
+		sock->sendmmsgbuf = isc_mem_get(sock->manager->mctx,
+						sock->sendcmsgbuflen *
+						MAXBATCH_SEND);
+		if (sock->sendmmsgbuf == NULL)
+			return (DOIO_NOBATCH);
+	}
+
+	n = 0;
+	dev = ISC_LIST_HEAD(sock->send_list);
+	while (dev != NULL && n < MAXBATCH_SEND) {
+		if (sock->sendmmsgbuf != NULL)
+			cmsgbuf = sock->sendmmsgbuf +
+				  n * sock->sendcmsgbuflen;
+		build_msghdr_send(sock, dev, &msgs[n].msg_hdr, iov[n],
+				  cmsgbuf, &write_count[n]);
+		msgs[n].msg_len = 0;
+		devs[n++] = dev;
+		dev = ISC_LIST_NEXT(dev, ev_link);
+	}
+
+ resend:
+	cc = sendmmsg(sock->fd, msgs, n, 0);
+	send_errno = errno;
+
+	if (cc < 0) {
+		if (send_errno == EINTR && ++attempts < NRETRIES)
+			goto resend;
+		if (send_errno == ENOSYS) {
+			sock->manager->nosendmmsg = ISC_TRUE;
+			return (DOIO_NOBATCH);
+		}
+		if (process_send(sock, devs[0], cc, send_errno,
+				 write_count[0]) == DOIO_SOFT)
+			return (DOIO_SOFT);
+		send_senddone_event(sock, &devs[0]);
+		return (DOIO_SUCCESS);
+	}
+
+	if (cc > 1)
+		inc_stats(sock->manager->stats,
+			  sock->statsindex[STATID_SENDBATCH]);
+	for (i = 0; i < (unsigned int)cc; i++) {
+		if (process_send(sock, devs[i], (int)msgs[i].msg_len, 0,
+				 write_count[i]) == DOIO_SUCCESS)
+			send_senddone_event(sock, &devs[i]);
+	}
+
+	return (DOIO_SUCCESS);
+}
+#endif /* USE_SENDMMSG */
+
 /*
  * Kill.
  *
@@ -2005,8 +2460,8 @@ closesocket(isc__socketmgr_t *manager, isc__socket_t *sock, int fd) {
 			UNLOCK(&manager->fdlock[lockid]);
 		}
 #ifdef ISC_PLATFORM_USETHREADS
-		if (manager->maxfd < manager->pipe_fds[0])
-			manager->maxfd = manager->pipe_fds[0];
+		if (manager->maxfd < manager->watchers[0].pipe_fds[0])
+			manager->maxfd = manager->watchers[0].pipe_fds[0];
 #endif
 	}
 	UNLOCK(&manager->lock);
@@ -2076,6 +2531,12 @@ allocate_socket(isc__socketmgr_t *manager, isc_sockettype_t type,
 
 	sock->recvcmsgbuf = NULL;
 	sock->sendcmsgbuf = NULL;
+#ifdef USE_RECVMMSG
+	sock->recvbatch = NULL;
+#endif
+#ifdef USE_SENDMMSG
+	sock->sendmmsgbuf = NULL;
+#endif
 
 	/*
 	 * Set up cmsg buffers.
@@ -2200,6 +2661,15 @@ free_socket(isc__socket_t **socketp) {
 	if (sock->sendcmsgbuf != NULL)
 		isc_mem_put(sock->manager->mctx, sock->sendcmsgbuf,
 			    sock->sendcmsgbuflen);
+#ifdef USE_RECVMMSG
+	if (sock->recvbatch != NULL)
+		recvbatch_free(sock);
+#endif
+#ifdef USE_SENDMMSG
+	if (sock->sendmmsgbuf != NULL)
+		isc_mem_put(sock->manager->mctx, sock->sendmmsgbuf,
+			    sock->sendcmsgbuflen * MAXBATCH_SEND);
+#endif
 
 	sock->common.magic = 0;
 	sock->common.impmagic = 0;
@@ -3375,8 +3845,16 @@ internal_recv(isc_task_t *me, isc_event_t *ev) {
 	 * limits here, currently.
 	 */
 	dev = ISC_LIST_HEAD(sock->recv_list);
+#ifdef USE_RECVMMSG
+	/*
+	 * Several requests waiting on one readiness event: read ahead.
+	 */
+	if (dev != NULL && sock->type == isc_sockettype_udp &&
+	    ISC_LIST_NEXT(dev, ev_link) != NULL)
+		recvbatch_create(sock, dev);
+#endif
 	while (dev != NULL) {
-		switch (doio_recv(sock, dev)) {
+		switch (doio_recvlocked(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
 
@@ -3444,6 +3922,20 @@ internal_send(isc_task_t *me, isc_event_t *ev) {
 	 */
 	dev = ISC_LIST_HEAD(sock->send_list);
 	while (dev != NULL) {
+#ifdef USE_SENDMMSG
+		if (sock->type == isc_sockettype_udp &&
+		    ISC_LIST_NEXT(dev, ev_link) != NULL &&
+		    !sock->manager->nosendmmsg)
+		{
+			switch (doio_sendmmsg(sock)) {
+			case DOIO_SOFT:
+				goto poke;
+			case DOIO_SUCCESS:
+				dev = ISC_LIST_HEAD(sock->send_list);
+				continue;
+			}
+		}
+#endif
 		switch (doio_send(sock, dev)) {
 		case DOIO_SOFT:
 			goto poke;
@@ -3620,7 +4112,9 @@ check_write:
 
 #ifdef USE_KQUEUE
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
+process_fds(isc__socketwatcher_t *watcher, struct kevent *events, int nevents)
+{
+	isc__socketmgr_t *manager = watcher->manager;
 	int i;
 	isc_boolean_t readable, writable;
 	isc_boolean_t done = ISC_FALSE;
@@ -3643,7 +4137,7 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].ident < manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].ident == (uintptr_t)manager->pipe_fds[0]) {
+		if (events[i].ident == (uintptr_t)watcher->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -3655,22 +4149,24 @@ process_fds(isc__socketmgr_t *manager, struct kevent *events, int nevents) {
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(watcher);
 #endif
 
 	return (done);
 }
 #elif defined(USE_EPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
+process_fds(isc__socketwatcher_t *watcher, struct epoll_event *events,
+	    int nevents)
 {
+	isc__socketmgr_t *manager = watcher->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
 	isc_boolean_t have_ctlevent = ISC_FALSE;
 #endif
 
-	if (nevents == manager->nevents) {
+	if (nevents == watcher->nevents) {
 		manager_log(manager, ISC_LOGCATEGORY_GENERAL,
 			    ISC_LOGMODULE_SOCKET, ISC_LOG_INFO,
 			    "maximum number of FD events (%d) received",
@@ -3680,7 +4176,7 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].data.fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].data.fd == manager->pipe_fds[0]) {
+		if (events[i].data.fd == watcher->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -3703,14 +4199,16 @@ process_fds(isc__socketmgr_t *manager, struct epoll_event *events, int nevents)
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(watcher);
 #endif
 
 	return (done);
 }
 #elif defined(USE_DEVPOLL)
 static isc_boolean_t
-process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
+process_fds(isc__socketwatcher_t *watcher, struct pollfd *events, int nevents)
+{
+	isc__socketmgr_t *manager = watcher->manager;
 	int i;
 	isc_boolean_t done = ISC_FALSE;
 #ifdef USE_WATCHER_THREAD
@@ -3727,7 +4225,7 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 	for (i = 0; i < nevents; i++) {
 		REQUIRE(events[i].fd < (int)manager->maxsocks);
 #ifdef USE_WATCHER_THREAD
-		if (events[i].fd == manager->pipe_fds[0]) {
+		if (events[i].fd == watcher->pipe_fds[0]) {
 			have_ctlevent = ISC_TRUE;
 			continue;
 		}
@@ -3739,23 +4237,24 @@ process_fds(isc__socketmgr_t *manager, struct pollfd *events, int nevents) {
 
 #ifdef USE_WATCHER_THREAD
 	if (have_ctlevent)
-		done = process_ctlfd(manager);
+		done = process_ctlfd(watcher);
 #endif
 
 	return (done);
 }
 #elif defined(USE_SELECT)
 static void
-process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
+process_fds(isc__socketwatcher_t *watcher, int maxfd, fd_set *readfds,
 	    fd_set *writefds)
 {
+	isc__socketmgr_t *manager = watcher->manager;
 	int i;
 
 	REQUIRE(maxfd <= (int)manager->maxsocks);
 
 	for (i = 0; i < maxfd; i++) {
 #ifdef USE_WATCHER_THREAD
-		if (i == manager->pipe_fds[0] || i == manager->pipe_fds[1])
+		if (i == watcher->pipe_fds[0] || i == watcher->pipe_fds[1])
 			continue;
 #endif /* USE_WATCHER_THREAD */
 		process_fd(manager, i, FD_ISSET(i, readfds),
@@ -3766,11 +4265,12 @@ process_fds(isc__socketmgr_t *manager, int maxfd, fd_set *readfds,
 
 #ifdef USE_WATCHER_THREAD
 static isc_boolean_t
-process_ctlfd(isc__socketmgr_t *manager) {
+process_ctlfd(isc__socketwatcher_t *watcher) {
+	isc__socketmgr_t *manager = watcher->manager;
 	int msg, fd;
 
 	for (;;) {
-		select_readmsg(manager, &fd, &msg);
+		select_readmsg(watcher, &fd, &msg);
 
 		manager_log(manager, IOEVENT,
 			    isc_msgcat_get(isc_msgcat, ISC_MSGSET_SOCKET,
@@ -3807,14 +4307,15 @@ process_ctlfd(isc__socketmgr_t *manager) {
 
 /*
  * This is the thread that will loop forever, always in a select or poll
- * call.
+ * call.  There is one per watcher.
  *
  * When select returns something to do, track down what thread gets to do
  * this I/O and post the event to it.
  */
 static isc_threadresult_t
 watcher(void *uap) {
-	isc__socketmgr_t *manager = uap;
+	isc__socketwatcher_t *sw = uap;
+	isc__socketmgr_t *manager = sw->manager;
 	isc_boolean_t done;
 	int cc;
 #ifdef USE_KQUEUE
@@ -3838,7 +4339,7 @@ watcher(void *uap) {
 	/*
 	 * Get the control fd here.  This will never change.
 	 */
-	ctlfd = manager->pipe_fds[0];
+	ctlfd = sw->pipe_fds[0];
 #endif
 	done = ISC_FALSE;
 	while (!done) {
@@ -3847,8 +4348,8 @@ watcher(void *uap) {
 			cc = kevent(manager->kqueue_fd, NULL, 0,
 				    manager->events, manager->nevents, NULL);
 #elif defined(USE_EPOLL)
-			cc = epoll_wait(manager->epoll_fd, manager->events,
-					manager->nevents, -1);
+			cc = epoll_wait(sw->epoll_fd, sw->events,
+					sw->nevents, -1);
 #elif defined(USE_DEVPOLL)
 			dvp.dp_fds = manager->events;
 			dvp.dp_nfds = manager->nevents;
@@ -3911,17 +4412,19 @@ watcher(void *uap) {
 #endif
 		} while (cc < 0);
 
-#if defined(USE_KQUEUE) || defined (USE_EPOLL) || defined (USE_DEVPOLL)
-		done = process_fds(manager, manager->events, cc);
+#if defined(USE_EPOLL)
+		done = process_fds(sw, sw->events, cc);
+#elif defined(USE_KQUEUE) || defined (USE_DEVPOLL)
+		done = process_fds(sw, manager->events, cc);
 #elif defined(USE_SELECT)
-		process_fds(manager, maxfd, manager->read_fds_copy,
+		process_fds(sw, maxfd, manager->read_fds_copy,
 			    manager->write_fds_copy);
 
 		/*
 		 * Process reads on internal, control fd.
 		 */
 		if (FD_ISSET(ctlfd, manager->read_fds_copy))
-			done = process_ctlfd(manager);
+			done = process_ctlfd(sw);
 #endif
 	}
 
@@ -3957,70 +4460,112 @@ isc___socketmgr_maxudp(isc_socketmgr_t *manager0, int maxudp) {
  * Create a new socket manager.
  */
 
+#ifdef USE_EPOLL
 static isc_result_t
-setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+setup_epoll(isc_mem_t *mctx, isc__socketwatcher_t *sw) {
 	isc_result_t result;
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
 	char strbuf[ISC_STRERRORSIZE];
+#ifdef USE_WATCHER_THREAD
+	struct epoll_event event;
 #endif
 
-#ifdef USE_KQUEUE
-	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
-				      manager->nevents);
-	if (manager->events == NULL)
+	sw->nevents = ISC_SOCKET_MAXEVENTS;
+	sw->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+				 sw->nevents);
+	if (sw->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->kqueue_fd = kqueue();
-	if (manager->kqueue_fd == -1) {
+	sw->epoll_fd = epoll_create(sw->nevents);
+	if (sw->epoll_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "kqueue %s: %s",
+				 "epoll_create %s: %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+		isc_mem_put(mctx, sw->events,
+			    sizeof(struct epoll_event) * sw->nevents);
 		return (result);
 	}
-
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	if (result != ISC_R_SUCCESS) {
-		close(manager->kqueue_fd);
-		isc_mem_put(mctx, manager->events,
-			    sizeof(struct kevent) * manager->nevents);
+	/*
+	 * The control pipe belongs to this watcher whatever its number,
+	 * so it is added directly rather than through watch_fd().
+	 */
+	memset(&event, 0, sizeof(event));
+	event.events = EPOLLIN;
+	event.data.fd = sw->pipe_fds[0];
+	if (epoll_ctl(sw->epoll_fd, EPOLL_CTL_ADD, sw->pipe_fds[0],
+		      &event) == -1) {
+		result = isc__errno2result(errno);
+		close(sw->epoll_fd);
+		isc_mem_put(mctx, sw->events,
+			    sizeof(struct epoll_event) * sw->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
-#elif defined(USE_EPOLL)
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+cleanup_epoll(isc_mem_t *mctx, isc__socketwatcher_t *sw) {
+	/* Closing the epoll instance also drops the control pipe. */
+	close(sw->epoll_fd);
+	isc_mem_put(mctx, sw->events,
+		    sizeof(struct epoll_event) * sw->nevents);
+}
+#endif	/* USE_EPOLL */
+
+static isc_result_t
+setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
+	isc_result_t result;
+#if defined(USE_KQUEUE) || defined(USE_DEVPOLL)
+	char strbuf[ISC_STRERRORSIZE];
+#endif
+#ifdef USE_EPOLL
+	unsigned int i;
+#endif
+
+#ifdef USE_KQUEUE
 	manager->nevents = ISC_SOCKET_MAXEVENTS;
-	manager->events = isc_mem_get(mctx, sizeof(struct epoll_event) *
+	manager->events = isc_mem_get(mctx, sizeof(struct kevent) *
 				      manager->nevents);
 	if (manager->events == NULL)
 		return (ISC_R_NOMEMORY);
-	manager->epoll_fd = epoll_create(manager->nevents);
-	if (manager->epoll_fd == -1) {
+	manager->kqueue_fd = kqueue();
+	if (manager->kqueue_fd == -1) {
 		result = isc__errno2result(errno);
 		isc__strerror(errno, strbuf, sizeof(strbuf));
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "epoll_create %s: %s",
+				 "kqueue %s: %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"),
 				 strbuf);
 		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+			    sizeof(struct kevent) * manager->nevents);
 		return (result);
 	}
+
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(manager, manager->watchers[0].pipe_fds[0],
+			  SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
-		close(manager->epoll_fd);
+		close(manager->kqueue_fd);
 		isc_mem_put(mctx, manager->events,
-			    sizeof(struct epoll_event) * manager->nevents);
+			    sizeof(struct kevent) * manager->nevents);
 		return (result);
 	}
 #endif	/* USE_WATCHER_THREAD */
+#elif defined(USE_EPOLL)
+	for (i = 0; i < manager->nwatchers; i++) {
+		result = setup_epoll(mctx, &manager->watchers[i]);
+		if (result != ISC_R_SUCCESS) {
+			while (i-- > 0)
+				cleanup_epoll(mctx, &manager->watchers[i]);
+			return (result);
+		}
+	}
 #elif defined(USE_DEVPOLL)
 	/*
 	 * XXXJT: /dev/poll seems to reject large numbers of events,
@@ -4059,7 +4604,8 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 		return (result);
 	}
 #ifdef USE_WATCHER_THREAD
-	result = watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = watch_fd(manager, manager->watchers[0].pipe_fds[0],
+			  SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
 		close(manager->devpoll_fd);
 		isc_mem_put(mctx, manager->events,
@@ -4117,8 +4663,9 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 	memset(manager->write_fds, 0, manager->fd_bufsize);
 
 #ifdef USE_WATCHER_THREAD
-	(void)watch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
-	manager->maxfd = manager->pipe_fds[0];
+	(void)watch_fd(manager, manager->watchers[0].pipe_fds[0],
+		       SELECT_POKE_READ);
+	manager->maxfd = manager->watchers[0].pipe_fds[0];
 #else /* USE_WATCHER_THREAD */
 	manager->maxfd = 0;
 #endif /* USE_WATCHER_THREAD */
@@ -4129,26 +4676,29 @@ setup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
 
 static void
 cleanup_watcher(isc_mem_t *mctx, isc__socketmgr_t *manager) {
-#ifdef USE_WATCHER_THREAD
+#ifdef USE_EPOLL
+	unsigned int i;
+#endif
+#if defined(USE_WATCHER_THREAD) && !defined(USE_EPOLL)
 	isc_result_t result;
 
-	result = unwatch_fd(manager, manager->pipe_fds[0], SELECT_POKE_READ);
+	result = unwatch_fd(manager, manager->watchers[0].pipe_fds[0],
+			    SELECT_POKE_READ);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR(__FILE__, __LINE__,
 				 "epoll_ctl(DEL) %s",
 				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
 						ISC_MSG_FAILED, "failed"));
 	}
-#endif	/* USE_WATCHER_THREAD */
+#endif	/* USE_WATCHER_THREAD && !USE_EPOLL */
 
 #ifdef USE_KQUEUE
 	close(manager->kqueue_fd);
 	isc_mem_put(mctx, manager->events,
 		    sizeof(struct kevent) * manager->nevents);
 #elif defined(USE_EPOLL)
-	close(manager->epoll_fd);
-	isc_mem_put(mctx, manager->events,
-		    sizeof(struct epoll_event) * manager->nevents);
+	for (i = 0; i < manager->nwatchers; i++)
+		cleanup_epoll(mctx, &manager->watchers[i]);
 #elif defined(USE_DEVPOLL)
 	close(manager->devpoll_fd);
 	isc_mem_put(mctx, manager->events,
@@ -4175,8 +4725,16 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
 ISC_SOCKETFUNC_SCOPE isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
+{
+	return (isc__socketmgr_create3(mctx, managerp, maxsocks, 1));
+}
+
+ISC_SOCKETFUNC_SCOPE isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nwatchers)
 {
 	int i;
+	unsigned int w;
 	isc__socketmgr_t *manager;
 #ifdef USE_WATCHER_THREAD
 	char strbuf[ISC_STRERRORSIZE];
@@ -4184,6 +4742,7 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	isc_result_t result;
 
 	REQUIRE(managerp != NULL && *managerp == NULL);
+	REQUIRE(nwatchers > 0);
 
 #ifdef USE_SHARED_MANAGER
 	if (socketmgr != NULL) {
@@ -4199,6 +4758,12 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 	if (maxsocks == 0)
 		maxsocks = ISC_SOCKET_MAXSOCKETS;
+#if !defined(USE_EPOLL) || !defined(USE_WATCHER_THREAD)
+	/*
+	 * Only epoll can spread the descriptors over several watchers.
+	 */
+	nwatchers = 1;
+#endif
 
 	manager = isc_mem_get(mctx, sizeof(*manager));
 	if (manager == NULL)
@@ -4209,6 +4774,12 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	manager->maxsocks = maxsocks;
 	manager->reserved = 0;
 	manager->maxudp = 0;
+#ifdef USE_RECVMMSG
+	manager->norecvmmsg = ISC_FALSE;
+#endif
+#ifdef USE_SENDMMSG
+	manager->nosendmmsg = ISC_FALSE;
+#endif
 	manager->fds = isc_mem_get(mctx,
 				   manager->maxsocks * sizeof(isc__socket_t *));
 	if (manager->fds == NULL) {
@@ -4220,6 +4791,16 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		result = ISC_R_NOMEMORY;
 		goto free_manager;
 	}
+	manager->watchers = isc_mem_get(mctx,
+					nwatchers * sizeof(isc__socketwatcher_t));
+	if (manager->watchers == NULL) {
+		result = ISC_R_NOMEMORY;
+		goto free_manager;
+	}
+	memset(manager->watchers, 0, nwatchers * sizeof(isc__socketwatcher_t));
+	manager->nwatchers = nwatchers;
+	for (w = 0; w < nwatchers; w++)
+		manager->watchers[w].manager = manager;
 	manager->stats = NULL;
 
 	manager->common.methods = &socketmgrmethods;
@@ -4259,24 +4840,35 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	}
 
 	/*
-	 * Create the special fds that will be used to wake up the
-	 * select/poll loop when something internal needs to be done.
+	 * Create the special fds that will be used to wake up each
+	 * watcher's select/poll loop when something internal needs to be
+	 * done.
 	 */
-	if (pipe(manager->pipe_fds) != 0) {
-		isc__strerror(errno, strbuf, sizeof(strbuf));
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "pipe() %s: %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"),
-				 strbuf);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup_condition;
-	}
+	for (w = 0; w < nwatchers; w++) {
+		isc__socketwatcher_t *sw = &manager->watchers[w];
+
+		if (pipe(sw->pipe_fds) != 0) {
+			isc__strerror(errno, strbuf, sizeof(strbuf));
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "pipe() %s: %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"),
+					 strbuf);
+			while (w-- > 0) {
+				(void)close(manager->watchers[w].pipe_fds[0]);
+				(void)close(manager->watchers[w].pipe_fds[1]);
+			}
+			result = ISC_R_UNEXPECTED;
+			goto cleanup_condition;
+		}
 
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[0]) == ISC_R_SUCCESS);
+		RUNTIME_CHECK(make_nonblock(sw->pipe_fds[0]) == ISC_R_SUCCESS);
 #if 0
-	RUNTIME_CHECK(make_nonblock(manager->pipe_fds[1]) == ISC_R_SUCCESS);
+		RUNTIME_CHECK(make_nonblock(sw->pipe_fds[1]) == ISC_R_SUCCESS);
 #endif
+	}
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_SHARED_MANAGER
@@ -4292,17 +4884,28 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 	memset(manager->fdstate, 0, manager->maxsocks * sizeof(int));
 #ifdef USE_WATCHER_THREAD
 	/*
-	 * Start up the select/poll thread.
+	 * Start up the select/poll threads.
 	 */
-	if (isc_thread_create(watcher, manager, &manager->watcher) !=
-	    ISC_R_SUCCESS) {
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_create() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
-		cleanup_watcher(mctx, manager);
-		result = ISC_R_UNEXPECTED;
-		goto cleanup;
+	for (w = 0; w < nwatchers; w++) {
+		isc__socketwatcher_t *sw = &manager->watchers[w];
+
+		if (isc_thread_create(watcher, sw, &sw->thread) !=
+		    ISC_R_SUCCESS) {
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_create() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+			while (w-- > 0) {
+				sw = &manager->watchers[w];
+				poke_watcher(sw, 0, SELECT_POKE_SHUTDOWN);
+				(void)isc_thread_join(sw->thread, NULL);
+			}
+			cleanup_watcher(mctx, manager);
+			result = ISC_R_UNEXPECTED;
+			goto cleanup;
+		}
 	}
 #endif /* USE_WATCHER_THREAD */
 	isc_mem_attach(mctx, &manager->mctx);
@@ -4316,8 +4919,10 @@ isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 
 cleanup:
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
+	for (w = 0; w < nwatchers; w++) {
+		(void)close(manager->watchers[w].pipe_fds[0]);
+		(void)close(manager->watchers[w].pipe_fds[1]);
+	}
 #endif	/* USE_WATCHER_THREAD */
 
 #ifdef USE_WATCHER_THREAD
@@ -4346,6 +4951,10 @@ free_manager:
 		isc_mem_put(mctx, manager->fds,
 			    manager->maxsocks * sizeof(isc_socket_t *));
 	}
+	if (manager->watchers != NULL) {
+		isc_mem_put(mctx, manager->watchers,
+			    nwatchers * sizeof(isc__socketwatcher_t));
+	}
 	isc_mem_put(mctx, manager, sizeof(*manager));
 
 	return (result);
@@ -4380,6 +4989,9 @@ ISC_SOCKETFUNC_SCOPE void
 isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	isc__socketmgr_t *manager;
 	int i;
+#ifdef USE_WATCHER_THREAD
+	unsigned int w;
+#endif
 	isc_mem_t *mctx;
 
 	/*
@@ -4420,22 +5032,27 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 
 	UNLOCK(&manager->lock);
 
+#ifdef USE_WATCHER_THREAD
 	/*
-	 * Here, poke our select/poll thread.  Do this by closing the write
-	 * half of the pipe, which will send EOF to the read half.
-	 * This is currently a no-op in the non-threaded case.
+	 * Here, poke our select/poll threads and wait for them to exit.
 	 */
-	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
-
-#ifdef USE_WATCHER_THREAD
+	for (w = 0; w < manager->nwatchers; w++)
+		poke_watcher(&manager->watchers[w], 0, SELECT_POKE_SHUTDOWN);
+	for (w = 0; w < manager->nwatchers; w++) {
+		if (isc_thread_join(manager->watchers[w].thread, NULL) !=
+		    ISC_R_SUCCESS)
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "isc_thread_join() %s",
+					 isc_msgcat_get(isc_msgcat,
+							ISC_MSGSET_GENERAL,
+							ISC_MSG_FAILED,
+							"failed"));
+	}
+#else
 	/*
-	 * Wait for thread to exit.
+	 * This is currently a no-op in the non-threaded case.
 	 */
-	if (isc_thread_join(manager->watcher, NULL) != ISC_R_SUCCESS)
-		UNEXPECTED_ERROR(__FILE__, __LINE__,
-				 "isc_thread_join() %s",
-				 isc_msgcat_get(isc_msgcat, ISC_MSGSET_GENERAL,
-						ISC_MSG_FAILED, "failed"));
+	select_poke(manager, 0, SELECT_POKE_SHUTDOWN);
 #endif /* USE_WATCHER_THREAD */
 
 	/*
@@ -4444,10 +5061,14 @@ isc__socketmgr_destroy(isc_socketmgr_t **managerp) {
 	cleanup_watcher(manager->mctx, manager);
 
 #ifdef USE_WATCHER_THREAD
-	(void)close(manager->pipe_fds[0]);
-	(void)close(manager->pipe_fds[1]);
+	for (w = 0; w < manager->nwatchers; w++) {
+		(void)close(manager->watchers[w].pipe_fds[0]);
+		(void)close(manager->watchers[w].pipe_fds[1]);
+	}
 	(void)isc_condition_destroy(&manager->shutdown_ok);
 #endif /* USE_WATCHER_THREAD */
+	isc_mem_put(manager->mctx, manager->watchers,
+		    manager->nwatchers * sizeof(isc__socketwatcher_t));
 
 	for (i = 0; i < (int)manager->maxsocks; i++)
 		if (manager->fdstate[i] == CLOSE_PENDING) /* no need to lock */
@@ -4493,14 +5114,25 @@ socket_recv(isc__socket_t *sock, isc_socketevent_t *dev, isc_task_t *task,
 
 	dev->ev_sender = task;
 
-	if (sock->type == isc_sockettype_udp) {
+	if (sock->type == isc_sockettype_udp && !RECVBATCH(sock)) {
 		io_state = doio_recv(sock, dev);
+#ifdef USE_RECVMMSG
+		/*
+		 * The datagram was already waiting, so the socket is busy:
+		 * read ahead from now on.
+		 */
+		if (io_state == DOIO_SUCCESS && !sock->manager->norecvmmsg) {
+			LOCK(&sock->lock);
+			have_lock = ISC_TRUE;
+			recvbatch_create(sock, dev);
+		}
+#endif
 	} else {
 		LOCK(&sock->lock);
 		have_lock = ISC_TRUE;
 
 		if (ISC_LIST_EMPTY(sock->recv_list))
-			io_state = doio_recv(sock, dev);
+			io_state = doio_recvlocked(sock, dev);
 		else
 			io_state = DOIO_SOFT;
 	}
@@ -5094,6 +5726,27 @@ isc__socket_bind(isc_socket_t *sock0, isc_sockaddr_t *sockaddr,
 						ISC_MSG_FAILED, "failed"));
 		/* Press on... */
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+#ifdef SO_REUSEPORT
+		if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT,
+			       (void *)&on, sizeof(on)) < 0) {
+			int reuse_errno = errno;
+
+			UNLOCK(&sock->lock);
+			/* Kernels without the option reject it this way. */
+			if (reuse_errno == ENOPROTOOPT)
+				return (ISC_R_NOTIMPLEMENTED);
+			isc__strerror(reuse_errno, strbuf, sizeof(strbuf));
+			UNEXPECTED_ERROR(__FILE__, __LINE__,
+					 "setsockopt(%d, SO_REUSEPORT): %s",
+					 sock->fd, strbuf);
+			return (isc__errno2result(reuse_errno));
+		}
+#else
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+#endif
+	}
 #ifdef AF_UNIX
  bind_socket:
 #endif
@@ -5834,9 +6487,10 @@ isc__socketmgr_waitevents(isc_socketmgr_t *manager0, struct timeval *tvp,
 		timeout = tvp->tv_sec * 1000 + (tvp->tv_usec + 999) / 1000;
 	else
 		timeout = -1;
-	swait_private.nevents = epoll_wait(manager->epoll_fd,
-					   manager->events,
-					   manager->nevents, timeout);
+	swait_private.nevents = epoll_wait(manager->watchers[0].epoll_fd,
+					   manager->watchers[0].events,
+					   manager->watchers[0].nevents,
+					   timeout);
 	n = swait_private.nevents;
 #elif defined(USE_DEVPOLL)
 	dvp.dp_fds = manager->events;
@@ -5878,11 +6532,17 @@ isc__socketmgr_dispatch(isc_socketmgr_t *manager0, isc_socketwait_t *swait) {
 	if (manager == NULL)
 		return (ISC_R_NOTFOUND);
 
-#if defined(USE_KQUEUE) || defined(USE_EPOLL) || defined(USE_DEVPOLL)
-	(void)process_fds(manager, manager->events, swait->nevents);
+#if defined(USE_EPOLL)
+	(void)process_fds(&manager->watchers[0], manager->watchers[0].events,
+			  swait->nevents);
+	return (ISC_R_SUCCESS);
+#elif defined(USE_KQUEUE) || defined(USE_DEVPOLL)
+	(void)process_fds(&manager->watchers[0], manager->events,
+			  swait->nevents);
 	return (ISC_R_SUCCESS);
 #elif defined(USE_SELECT)
-	process_fds(manager, swait->maxfd, swait->readset, swait->writeset);
+	process_fds(&manager->watchers[0], swait->maxfd, swait->readset,
+		    swait->writeset);
 	return (ISC_R_SUCCESS);
 #endif
 }
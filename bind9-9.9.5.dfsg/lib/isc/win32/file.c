@@ -672,3 +672,40 @@ isc_file_mode(const char *file, mode_t *modep) {
 		*modep = (stats.st_mode & 07777);
 	return (result);
 }
+
+void *
+isc_file_mmap(void *addr, size_t len, int prot,
+	      int flags, int fd, off_t offset)
+{
+	void *buf;
+	int ret;
+	off_t end;
+
+	UNUSED(addr);
+	UNUSED(prot);
+	UNUSED(flags);
+
+	end = lseek(fd, 0, SEEK_END);
+	lseek(fd, offset, SEEK_SET);
+	if (end - offset < (off_t) len)
+		len = end - offset;
+
+	buf = malloc(len);
+	if (buf == NULL)
+		return ((void *) -1);
+
+	ret = read(fd, buf, (unsigned int) len);
+	if (ret != (int) len) {
+		free(buf);
+		buf = (void *) -1;
+	}
+
+	return (buf);
+}
+
+int
+isc_file_munmap(void *addr, size_t len) {
+	UNUSED(len);
+	free(addr);
+	return (0);
+}
@@ -2615,6 +2615,19 @@ isc__socketmgr_create(isc_mem_t *mctx, isc_socketmgr_t **managerp) {
 	return (isc_socketmgr_create2(mctx, managerp, 0));
 }
 
+/*
+ * The completion port already spreads I/O over several threads, so
+ * 'nwatchers' is ignored.
+ */
+isc_result_t
+isc__socketmgr_create3(isc_mem_t *mctx, isc_socketmgr_t **managerp,
+		       unsigned int maxsocks, unsigned int nwatchers)
+{
+	REQUIRE(nwatchers > 0);
+
+	return (isc_socketmgr_create2(mctx, managerp, maxsocks));
+}
+
 isc_result_t
 isc__socketmgr_create2(isc_mem_t *mctx, isc_socketmgr_t **managerp,
 		       unsigned int maxsocks)
@@ -3214,6 +3227,10 @@ isc__socket_bind(isc_socket_t *sock, isc_sockaddr_t *sockaddr,
 		UNLOCK(&sock->lock);
 		return (ISC_R_FAMILYMISMATCH);
 	}
+	if ((options & ISC_SOCKET_REUSEPORT) != 0) {
+		UNLOCK(&sock->lock);
+		return (ISC_R_NOTIMPLEMENTED);
+	}
 	/*
 	 * Only set SO_REUSEADDR when we want a specific port.
 	 */
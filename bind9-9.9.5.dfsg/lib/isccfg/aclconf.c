@@ -483,6 +483,10 @@ nested_acl:
 		INSIST(dacl->length <= dacl->alloc);
 	}
 
+	result = dns_acl_compile(dacl);
+	if (result != ISC_R_SUCCESS)
+		goto cleanup;
+
 	dns_acl_attach(dacl, target);
 	result = ISC_R_SUCCESS;
 